@@ -9,34 +9,200 @@
 #include <sstream>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Analysis/InlineCost.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Transforms/Coroutines/CoroCleanup.h>
+#include <llvm/Transforms/Coroutines/CoroEarly.h>
+#include <llvm/Transforms/Coroutines/CoroElide.h>
+#include <llvm/Transforms/Coroutines/CoroSplit.h>
+#include <llvm/Transforms/IPO/Inliner.h>
+#include <llvm/Transforms/InstCombine/InstCombine.h>
+#include <llvm/Transforms/Scalar/EarlyCSE.h>
+#include <llvm/Transforms/Scalar/IndVarSimplify.h>
+#include <llvm/Transforms/Scalar/LoopPassManager.h>
+#include <llvm/Transforms/Scalar/LoopRotation.h>
+#include <llvm/Transforms/Scalar/LoopUnrollPass.h>
+#include <llvm/Transforms/Scalar/SimplifyCFG.h>
+#include <llvm/Transforms/Scalar/SROA.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <llvm/Transforms/Vectorize/LoopVectorize.h>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <vector>
 #include <regex>
 
-// 外部声明
-extern FILE *yyin;
-extern int yyparse();
-extern std::shared_ptr<ProgramNode> root;
+// 映射（map<K,V>）运行时的头部布局，哈希表的结构说明见后面的“映射类型 map<K,V>”部分
+
+// 映射头部的字段序号
+enum MapField {
+    MAP_CTRL = 0,           // 控制字节数组
+    MAP_KEYS,               // 键数组
+    MAP_VALUES,             // 值数组
+    MAP_HASHES,             // 字符串键的哈希值数组（其他键类型为 null）
+    MAP_SIZE,               // 键值对数量
+    MAP_CAPACITY,           // 槽数量（8 的倍数，2 的幂）
+    MAP_GROWTH_LEFT,        // 扩容前还能插入的键数量
+    MAP_VALUE_SIZE,         // 值的字节数（扩容时按字节复制值）
+    MAP_REFS                // 引用计数（与动态数组相同）
+};
+
+static const uint64_t MAP_CTRL_EMPTY = 0x80;                // 空槽的控制字节
+
+// 在 64 位整数中按 8 字节一组并行处理字节（整数解析判断并合并 8 个数字）
+static const uint64_t BYTE_LSB = 0x0101010101010101ULL;     // 每个字节的最低位
+static const uint64_t BYTE_MSB = 0x8080808080808080ULL;     // 每个字节的最高位
+
+// 动态数组（list<T>）头部的字段序号
+enum ListField {
+    LIST_DATA = 0,          // 元素数组（连续存储）
+    LIST_SIZE,              // 元素数量
+    LIST_CAPACITY,          // 已分配的元素数量
+    LIST_REFS               // 引用计数（变量、参数、临时值和线程各持有一个引用）
+};
+
+// 标准输入缓冲区（__ppx_stdin）的字段序号
+enum StdinField {
+    STDIN_DATA = 0,         // 缓冲区（首次读取时分配 STDIN_CHUNK_SIZE 字节）
+    STDIN_POS,              // 下一个未读字节的位置
+    STDIN_LEN               // 缓冲区中有效字节的数量
+};
+
+// 文件（file）头部的字段序号
+enum FileField {
+    FILE_DATA = 0,          // 读写缓冲区，或 mmap 映射的整个文件
+    FILE_POS,               // 读取时下一个未读字节的位置
+    FILE_LEN,               // 缓冲区中有效字节的数量（写入时为待写出的字节数）
+    FILE_CAPACITY,          // 缓冲区大小（读取一行时不够会扩容）
+    FILE_PATH,              // 打开时的路径（用于异常消息）
+    FILE_FD,                // 文件描述符，关闭后为 -1
+    FILE_WRITABLE,          // 以 "w" 或 "a" 打开
+    FILE_MAPPED             // FILE_DATA 为 mmap 映射
+};
+
+// 通道（chan<T>）头部的字段序号（字段之间的填充见 getChannelStructType）
+enum ChannelField {
+    CHAN_CELLS = 0,         // 槽数组 { seq, value }
+    CHAN_MASK,              // 槽数量 - 1
+    CHAN_CLOSED,            // close 之后为 1
+    CHAN_REFS,              // 引用计数
+    CHAN_ENQUEUE_POS = 5,   // 下一个写入位置（单独的缓存行）
+    CHAN_DEQUEUE_POS = 7    // 下一个读出位置（单独的缓存行）
+};
+
+// 通道槽的字段序号
+enum ChannelCellField {
+    CELL_SEQ = 0,           // 序号：等于位置时可写入，等于位置 + 1 时可读出
+    CELL_VALUE              // 元素（以 i64 保存）
+};
+
+// spawn 任务结构体的字段序号
+enum TaskField {
+    TASK_THREAD = 0,        // pthread_t
+    TASK_REFS,              // 引用计数（future 的引用，线程结束前另持有一个）
+    TASK_STATE,             // TaskState
+    TASK_RESULT,            // 函数的返回值（void 函数为占位的 i8）
+    TASK_ARGS               // 参数依次排列
+};
+
+// spawn 任务的状态
+enum TaskState {
+    TASK_JOINABLE = 0,      // 尚未 join
+    TASK_DETACHED,          // 线程已分离（spawn 作为表达式语句）
+    TASK_JOINED             // 已经 join，结果交给了调用者
+};
+
+// 生成器帧池的字段序号
+enum GeneratorPoolField {
+    GEN_POOL_LOCK = 0,      // 自旋锁（0 为空闲）
+    GEN_POOL_FREE           // 各级空闲链表的表头（空闲块的前 8 字节指向下一个空闲块）
+};
+
+// LLVM 类型对应的 PPX 类型名
+static std::string typeNameOf(llvm::Type *type) {
+    if (type->isIntegerTy(32)) return "int";
+    if (type->isDoubleTy()) return "double";
+    if (type->isIntegerTy(1)) return "bool";
+    if (type->isIntegerTy(8)) return "char";
+    if (type->isPointerTy()) return "string";
+    if (auto vecTy = llvm::dyn_cast<llvm::FixedVectorType>(type)) {
+        return "vec<" + typeNameOf(vecTy->getElementType()) + "," + std::to_string(vecTy->getNumElements()) + ">";
+    }
+    return "unknown";
+}
+
+// 值类型能否转换为向量类型 target：int、double、bool、char 标量广播，元素个数相同的向量逐元素转换
+static bool convertibleToVec(llvm::Type *type, llvm::Type *target) {
+    auto *vecTy = llvm::dyn_cast<llvm::FixedVectorType>(target);
+    if (!vecTy) {
+        return false;
+    }
+    if (auto *fromTy = llvm::dyn_cast<llvm::FixedVectorType>(type)) {
+        return fromTy->getNumElements() == vecTy->getNumElements();
+    }
+    return type->isIntegerTy() || type->isDoubleTy();
+}
+
+// 创建映射和动态数组的运行时函数（linkonce_odr，多个模块中的相同定义在链接时合并）
+static llvm::Function *createRuntimeFunction(llvm::Module *module, const std::string &name,
+                                             llvm::FunctionType *type) {
+    llvm::Function *function =
+        llvm::Function::Create(type, llvm::Function::LinkOnceODRLinkage, name, module);
+    function->addFnAttr(llvm::Attribute::NoUnwind);
+    return function;
+}
+
+// 生成运行时函数体时保存并恢复插入点和浮点运算标志
+// 运行时函数在所有调用方和模块之间共享同一个定义，不能继承调用方的 @fastmath 或 -ffast-math，
+// 否则函数体的结果取决于哪个函数先生成它；函数体总是按严格的浮点语义生成
+class RuntimeFunctionGuard {
+public:
+    explicit RuntimeFunctionGuard(llvm::IRBuilderBase &builder) : insertPoint(builder), fastMath(builder) {
+        builder.clearFastMathFlags();
+    }
+
+private:
+    llvm::IRBuilderBase::InsertPointGuard insertPoint;
+    llvm::IRBuilderBase::FastMathFlagGuard fastMath;
+};
+
+// 目标平台是否为 macOS：C 库的 errno、stdin 符号名和 O_* 常量与 Linux 不同
+static bool targetIsDarwin() {
+    return llvm::Triple(llvm::sys::getDefaultTargetTriple()).isOSDarwin();
+}
 
 // 构造和析构函数
 CodeGenerator::CodeGenerator(const std::string &moduleName) {
-    // 初始化LLVM
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
-    llvm::InitializeNativeTargetAsmParser();
+    // 初始化LLVM（目标注册表是进程级的，多个线程中的生成器只初始化一次）
+    static std::once_flag targetsInitialized;
+    std::call_once(targetsInitialized, []() {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        llvm::InitializeNativeTargetAsmParser();
+    });
     // 创建LLVM上下文和模块
     context = std::make_unique<llvm::LLVMContext>();
     module = std::make_unique<llvm::Module>(moduleName, *context);
     builder = std::make_unique<llvm::IRBuilder<>>(*context);
     // 初始化错误管理（使用全局计数器）
     resetErrorCounts();
-    currentFunction = nullptr;
-    currentFunctionLineNumber = 0;
-    // 异常消息全局变量初始化
-    currentExceptionMsg = nullptr;  
+    // 顶层语句（全局变量等）使用顶层上下文
+    fn = &topLevelContext;
+    irThreads = 1;
+    codegenThreads = 1;
+    stackArrayLimit = CodeGenConstants::STACK_ARRAY_LIMIT;
+    incrementCount = 0;
+    mathErrno = true;
     // 初始化当前目录为当前工作目录
     char cwd[1024];
     if (getcwd(cwd, sizeof(cwd)) != nullptr) {
@@ -48,6 +214,123 @@ CodeGenerator::CodeGenerator(const std::string &moduleName) {
     declareBuiltinFunctions();
 }
 
+// 将类型转换到另一个 LLVMContext（并行生成时镜像声明使用）
+static llvm::Type *translateType(llvm::Type *type, llvm::LLVMContext &ctx) {
+    switch (type->getTypeID()) {
+        case llvm::Type::VoidTyID:
+            return llvm::Type::getVoidTy(ctx);
+        case llvm::Type::FloatTyID:
+            return llvm::Type::getFloatTy(ctx);
+        case llvm::Type::DoubleTyID:
+            return llvm::Type::getDoubleTy(ctx);
+        case llvm::Type::IntegerTyID:
+            return llvm::IntegerType::get(ctx, type->getIntegerBitWidth());
+        case llvm::Type::PointerTyID:
+            return llvm::PointerType::get(ctx, type->getPointerAddressSpace());
+        case llvm::Type::ArrayTyID:
+            return llvm::ArrayType::get(translateType(type->getArrayElementType(), ctx),
+                                        type->getArrayNumElements());
+        case llvm::Type::FixedVectorTyID: {
+            auto *vecType = llvm::cast<llvm::FixedVectorType>(type);
+            return llvm::FixedVectorType::get(translateType(vecType->getElementType(), ctx),
+                                              vecType->getNumElements());
+        }
+        case llvm::Type::StructTyID: {
+            auto *structType = llvm::cast<llvm::StructType>(type);
+            std::vector<llvm::Type *> elements;
+            for (llvm::Type *element : structType->elements()) {
+                elements.push_back(translateType(element, ctx));
+            }
+            return llvm::StructType::get(ctx, elements, structType->isPacked());
+        }
+        case llvm::Type::FunctionTyID: {
+            auto *funcType = llvm::cast<llvm::FunctionType>(type);
+            std::vector<llvm::Type *> params;
+            for (llvm::Type *param : funcType->params()) {
+                params.push_back(translateType(param, ctx));
+            }
+            return llvm::FunctionType::get(translateType(funcType->getReturnType(), ctx),
+                                           params, funcType->isVarArg());
+        }
+        default:
+            return nullptr;
+    }
+}
+
+// 并行工作生成器：拥有独立的 LLVMContext/Module，
+// 以外部声明的形式镜像主模块中的全局变量和函数，只负责生成分配给它的函数体
+CodeGenerator::CodeGenerator(CodeGenerator &parent, unsigned index) {
+    context = std::make_unique<llvm::LLVMContext>();
+    module = std::make_unique<llvm::Module>(
+        parent.module->getName().str() + ".part" + std::to_string(index), *context);
+    module->setDataLayout(parent.module->getDataLayout());
+    builder = std::make_unique<llvm::IRBuilder<>>(*context);
+    // 不重置错误计数，诊断信息汇总到主生成器
+    fn = &topLevelContext;
+    irThreads = 1;
+    codegenThreads = 1;
+    stackArrayLimit = parent.stackArrayLimit;
+    incrementCount = 0;
+    fastMathFlags = parent.fastMathFlags;
+    mathErrno = parent.mathErrno;
+    builder->setFastMathFlags(fastMathFlags);
+    currentDirectory = parent.currentDirectory;
+    sourceDirectory = parent.sourceDirectory;
+    loadedModules = parent.loadedModules;
+    moduleAliases = parent.moduleAliases;
+    functionPrototypes = parent.functionPrototypes;
+    declareBuiltinFunctions();
+
+    // 镜像全局变量（私有的字符串常量只在定义它的模块内使用，无需镜像）
+    std::map<const llvm::GlobalValue *, llvm::GlobalValue *> mirrored;
+    for (auto &global : parent.module->globals()) {
+        if (!global.hasName() || global.hasPrivateLinkage() ||
+            global.getName().str().rfind("llvm.", 0) == 0) {
+            continue;
+        }
+        mirrored[&global] = new llvm::GlobalVariable(
+            *module, translateType(global.getValueType(), *context), global.isConstant(),
+            llvm::GlobalValue::ExternalLinkage, nullptr, global.getName());
+    }
+
+    // 镜像函数声明（内置函数已由 declareBuiltinFunctions 声明）
+    for (auto &function : parent.module->functions()) {
+        llvm::Function *decl = module->getFunction(function.getName());
+        if (!decl) {
+            decl = llvm::Function::Create(
+                llvm::cast<llvm::FunctionType>(translateType(function.getFunctionType(), *context)),
+                llvm::Function::ExternalLinkage, function.getName(), module.get());
+            auto argIt = function.arg_begin();
+            for (auto &arg : decl->args()) {
+                arg.setName((argIt++)->getName());
+            }
+        }
+        mirrored[&function] = decl;
+    }
+
+    // 按镜像关系重建符号表
+    for (const auto &entry : parent.globalValues) {
+        globalValues[entry.first] = llvm::cast<llvm::GlobalVariable>(mirrored[entry.second]);
+    }
+    globalTypes = parent.globalTypes;
+    for (const auto &entry : parent.functions) {
+        functions[entry.first] = llvm::cast<llvm::Function>(mirrored[entry.second]);
+    }
+    for (const auto &moduleEntry : parent.moduleFunctions) {
+        for (const auto &entry : moduleEntry.second) {
+            moduleFunctions[moduleEntry.first][entry.first] =
+                llvm::cast<llvm::Function>(mirrored[entry.second]);
+        }
+    }
+    lazyFunctionBodies = parent.lazyFunctionBodies;
+    for (const auto &moduleEntry : parent.moduleGlobals) {
+        for (const auto &entry : moduleEntry.second) {
+            moduleGlobals[moduleEntry.first][entry.first] =
+                llvm::cast<llvm::GlobalVariable>(mirrored[entry.second]);
+        }
+    }
+}
+
 CodeGenerator::~CodeGenerator() {}
 
 // 设置源文件路径（供外部调用，使用error模块）
@@ -132,21 +415,32 @@ static bool isValidFilePath(const std::string& path) {
 void CodeGenerator::pushTempMemory(llvm::Value *ptr) {
     if (!ptr || !ptr->getType()->isPointerTy())
         return;
-    tempMemoryStack.push_back(ptr);
+    fn->tempMemoryStack.push_back(ptr);
 }
 
 void CodeGenerator::removeTempMemory(llvm::Value *ptr) {
     if (!ptr)
         return;
     // 从临时内存栈中移除指定指针，当它被赋值给变量时，所有权转移
-    auto it = std::find(tempMemoryStack.begin(), tempMemoryStack.end(), ptr);
-    if (it != tempMemoryStack.end()) {
-        tempMemoryStack.erase(it);
+    auto it = std::find(fn->tempMemoryStack.begin(), fn->tempMemoryStack.end(), ptr);
+    if (it != fn->tempMemoryStack.end()) {
+        fn->tempMemoryStack.erase(it);
     }
 }
 
 void CodeGenerator::clearTempMemory() {
-    if (tempMemoryStack.empty())
+    clearTempMemorySince(0, 0);
+}
+
+// 短路求值的右侧只在条件成立时执行，右侧的临时内存必须在右侧的分支中释放
+void CodeGenerator::clearTempMemorySince(size_t memoryMark, size_t referenceMark) {
+    // 逆序释放临时的引用计数值
+    while (fn->tempReferences.size() > referenceMark) {
+        emitRelease(fn->tempReferences.back().first, fn->tempReferences.back().second);
+        fn->tempReferences.pop_back();
+    }
+
+    if (fn->tempMemoryStack.size() <= memoryMark)
         return;
 
     // 获取free函数
@@ -155,17 +449,15 @@ void CodeGenerator::clearTempMemory() {
         std::cerr << "Warning: free function not found, cannot auto-release "
                      "temp memory"
                   << std::endl;
-        tempMemoryStack.clear();
+        fn->tempMemoryStack.resize(memoryMark);
         return;
     }
 
     // 逆序释放所有临时内存
-    for (auto it = tempMemoryStack.rbegin(); it != tempMemoryStack.rend();
-         ++it) {
-        builder->CreateCall(freeFunc, {*it});
+    while (fn->tempMemoryStack.size() > memoryMark) {
+        builder->CreateCall(freeFunc, {fn->tempMemoryStack.back()});
+        fn->tempMemoryStack.pop_back();
     }
-
-    tempMemoryStack.clear();
 }
 
 void CodeGenerator::trackOwnedString(const std::string& varName, llvm::Value* ptr) {
@@ -176,19 +468,19 @@ void CodeGenerator::trackOwnedString(const std::string& varName, llvm::Value* pt
     freeOwnedString(varName);
     
     // 跟踪新的字符串
-    ownedStringMemory[varName] = ptr;
+    fn->ownedStringMemory[varName] = ptr;
 }
 
 void CodeGenerator::freeOwnedString(const std::string& varName) {
-    auto it = ownedStringMemory.find(varName);
-    if (it == ownedStringMemory.end())
+    auto it = fn->ownedStringMemory.find(varName);
+    if (it == fn->ownedStringMemory.end())
         return;
     
     // 获取free函数
     llvm::Function *freeFunc = module->getFunction("free");
     if (!freeFunc) {
         std::cerr << "Warning: free function not found" << std::endl;
-        ownedStringMemory.erase(it);
+        fn->ownedStringMemory.erase(it);
         return;
     }
     
@@ -196,7 +488,125 @@ void CodeGenerator::freeOwnedString(const std::string& varName) {
     builder->CreateCall(freeFunc, {it->second});
     
     // 从跟踪中移除
-    ownedStringMemory.erase(it);
+    fn->ownedStringMemory.erase(it);
+}
+
+// 字符串可能是动态数组或映射的元素（如 names[0]、split(s, ",")[0]、m[k]），元素被覆盖、容器被释放后指针失效。
+// 绑定到局部变量、写入全局变量或作为返回值时保存一份副本（加入临时内存，随后和其他临时字符串一样转移所有权）
+llvm::Value *CodeGenerator::copyBorrowedString(llvm::Value *value, const std::string &typeName) {
+    if (typeName != "string" || !value->getType()->isPointerTy() ||
+        std::find(fn->tempMemoryStack.begin(), fn->tempMemoryStack.end(), value) != fn->tempMemoryStack.end()) {
+        return value;
+    }
+    if (!fn->borrowedStrings.count(value) && fn->tempReferences.empty()) {
+        return value;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+    llvm::Value *copy = builder->CreateCall(strdupFunc, {value}, "str_copy");
+    pushTempMemory(copy);
+    return copy;
+}
+
+// 引用计数
+//
+// 动态数组、映射和 future 由引用计数管理：新建的值先作为临时引用，语句结束时由 clearTempMemory 释放；
+// 写入变量时取走临时引用（所有权转移）或把引用计数加一。持有引用的局部变量和参数在入口块置空，
+// 赋值时释放旧值，函数返回前统一释放（返回值先加一，交给调用者作为临时引用）。
+// 通过异常离开函数时不释放（与临时字符串相同）
+
+bool CodeGenerator::isCountedType(const std::string &typeName) {
+    return isListType(typeName) || isMapType(typeName) || isFutureType(typeName) || isChanType(typeName);
+}
+
+void CodeGenerator::emitRetain(llvm::Value *value, const std::string &typeName) {
+    if (isFutureType(typeName)) {
+        builder->CreateCall(getFutureRetainFunction(), {value});
+        return;
+    }
+    if (isChanType(typeName)) {
+        builder->CreateCall(getChannelRetainFunction(), {value});
+        return;
+    }
+    builder->CreateCall(isMapType(typeName) ? getMapRetainFunction() : getListRetainFunction(), {value});
+}
+
+void CodeGenerator::emitRelease(llvm::Value *value, const std::string &typeName) {
+    if (isFutureType(typeName)) {
+        builder->CreateCall(getFutureReleaseFunction(futureValueType(typeName)), {value});
+        return;
+    }
+    if (isChanType(typeName)) {
+        builder->CreateCall(getChannelReleaseFunction(), {value, builder->getInt1(chanElementType(typeName) == "string")});
+        return;
+    }
+    if (isMapType(typeName)) {
+        builder->CreateCall(getMapReleaseFunction(), {value, builder->getInt1(mapKeyType(typeName) == "string"),
+                                                      builder->getInt1(mapValueType(typeName) == "string")});
+        return;
+    }
+    builder->CreateCall(getListReleaseFunction(), {value, builder->getInt1(listElementType(typeName) == "string")});
+}
+
+void CodeGenerator::pushTempReference(llvm::Value *value, const std::string &typeName) {
+    if (value && isCountedType(typeName)) {
+        fn->tempReferences.push_back({value, typeName});
+    }
+}
+
+bool CodeGenerator::takeTempReference(llvm::Value *value) {
+    for (auto it = fn->tempReferences.rbegin(); it != fn->tempReferences.rend(); ++it) {
+        if (it->first == value) {
+            fn->tempReferences.erase(std::next(it).base());
+            return true;
+        }
+    }
+    return false;
+}
+
+void CodeGenerator::ownReference(llvm::Value *value, const std::string &typeName) {
+    if (!takeTempReference(value)) {
+        emitRetain(value, typeName);
+    }
+}
+
+// 生成器的局部变量位于协程帧中，在 coro.begin 之后置空
+void CodeGenerator::trackReferenceSlot(llvm::AllocaInst *slot, const std::string &typeName) {
+    llvm::Instruction *after = slot;
+    if (fn->generator.handle) {
+        after = llvm::cast<llvm::Instruction>(fn->generator.handle);
+    }
+    llvm::IRBuilder<> initBuilder(after->getParent(), std::next(after->getIterator()));
+    initBuilder.CreateStore(llvm::Constant::getNullValue(slot->getAllocatedType()), slot);
+    fn->referenceSlots.push_back({slot, typeName});
+}
+
+// 先取得新值的引用再释放旧值，a = a 时不会提前释放
+void CodeGenerator::storeReference(llvm::Value *slot, llvm::Value *value, const std::string &typeName) {
+    ownReference(value, typeName);
+    llvm::Value *oldValue = builder->CreateLoad(value->getType(), slot, "old_ref");
+    builder->CreateStore(value, slot);
+    emitRelease(oldValue, typeName);
+}
+
+void CodeGenerator::releaseReferenceSlots(llvm::Function *function) {
+    if (fn->referenceSlots.empty()) {
+        return;
+    }
+    std::vector<llvm::ReturnInst *> exits;
+    for (auto &block : *function) {
+        if (auto *ret = llvm::dyn_cast_or_null<llvm::ReturnInst>(block.getTerminator())) {
+            exits.push_back(ret);
+        }
+    }
+    llvm::IRBuilderBase::InsertPointGuard guard(*builder);
+    for (llvm::ReturnInst *ret : exits) {
+        builder->SetInsertPoint(ret);
+        for (auto it = fn->referenceSlots.rbegin(); it != fn->referenceSlots.rend(); ++it) {
+            llvm::Value *value = builder->CreateLoad(it->first->getAllocatedType(), it->first, "local_ref");
+            emitRelease(value, it->second);
+        }
+    }
 }
 
 // 模块管理函数
@@ -275,30 +685,18 @@ bool CodeGenerator::loadModule(const std::string &moduleName) {
         return false;
     }
 
-    // 保存当前的 yyin 和 root
-    FILE *oldYyin = yyin;
-    std::shared_ptr<ProgramNode> oldRoot = root;
-
     // 打开模块文件
-    yyin = fopen(moduleFile.c_str(), "r");
-    if (!yyin) {
+    FILE *moduleInput = fopen(moduleFile.c_str(), "r");
+    if (!moduleInput) {
         std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Cannot open module file: " << moduleFile << std::endl;
-        yyin = oldYyin;  // 恢复原始状态
         return false;
     }
 
     // 解析模块
-    root = nullptr;
-    int parseResult = yyparse();
-    // 保存模块的AST
-    std::shared_ptr<ProgramNode> moduleRoot = root; 
-
-    // 立即恢复全局状态
-    fclose(yyin);
-    yyin = oldYyin;
-    root = oldRoot;
+    std::shared_ptr<ProgramNode> moduleRoot = parseProgram(moduleInput);
+    fclose(moduleInput);
 
-    if (parseResult != 0 || !moduleRoot) {
+    if (!moduleRoot) {
         std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Failed to parse module: " << moduleName << std::endl;
         return false;
     }
@@ -321,15 +719,16 @@ bool CodeGenerator::loadModule(const std::string &moduleName) {
         }
         
         // 只处理函数声明和全局变量声明
+        // 函数只声明原型，函数体在调用点解析到该函数时才生成
         if (auto funcDecl = dynamic_cast<FunctionDeclNode *>(stmt.get())) {
-            codegenFunctionDecl(funcDecl);
+            llvm::Function* func = declareFunction(funcDecl);
             // 将函数添加到模块命名空间
-            llvm::Function* func = module->getFunction(funcDecl->name);
             if (func) {
                 moduleFunctions[moduleName][funcDecl->name] = func;
+                lazyFunctionBodies[funcDecl->name] = funcDecl;
                 if (g_verbose) {
                     std::cout << "[Module] Registered function: " << moduleName 
-                              << "." << funcDecl->name << std::endl;
+                              << "." << funcDecl->name << " (body deferred)" << std::endl;
                 }
             }
         } else if (auto varDecl = dynamic_cast<VarDeclNode *>(stmt.get())) {
@@ -348,7 +747,8 @@ bool CodeGenerator::loadModule(const std::string &moduleName) {
 
     // 标记为已加载
     loadedModules.insert(moduleName);
-    // moduleRoot 是 shared_ptr，会自动管理内存
+    // 保留模块 AST，延迟生成的函数体仍然引用其中的节点
+    moduleASTs.push_back(moduleRoot);
     if (g_verbose) {
         std::cout << "[Module] Module loaded successfully: " << moduleName
                   << std::endl;
@@ -369,9 +769,61 @@ llvm::Function* CodeGenerator::findModuleFunction(const std::string& moduleName,
         return nullptr;
     }
     
+    requestFunctionBody(funcName);
     return funcIt->second;
 }
 
+// 调用点解析到尚未生成函数体的模块函数时，将其加入工作表（每个函数只加入一次）
+void CodeGenerator::requestFunctionBody(const std::string& funcName) {
+    auto it = lazyFunctionBodies.find(funcName);
+    if (it == lazyFunctionBodies.end()) {
+        return;
+    }
+    lazyFunctionBodies.erase(it);
+    lazyFunctionWorklist.push_back(funcName);
+}
+
+// 生成工作表中的模块函数体
+// 函数体内的调用会继续向工作表追加函数，直到被用到的函数全部生成；未被调用的原型从模块中删除
+void CodeGenerator::generateRequestedFunctionBodies() {
+    size_t generated = 0;
+    while (!lazyFunctionWorklist.empty()) {
+        std::string funcName = lazyFunctionWorklist.back();
+        lazyFunctionWorklist.pop_back();
+        
+        auto protoIt = functionPrototypes.find(funcName);
+        llvm::Function* func = module->getFunction(funcName);
+        if (protoIt == functionPrototypes.end() || !func || !func->isDeclaration()) {
+            continue;
+        }
+        if (g_verbose) {
+            std::cout << "[Module] Generating deferred function body: " << funcName << std::endl;
+        }
+        codegenFunctionBody(protoIt->second, func);
+        generated++;
+    }
+    
+    size_t skipped = 0;
+    for (const auto &entry : lazyFunctionBodies) {
+        llvm::Function* func = module->getFunction(entry.first);
+        if (func && func->isDeclaration() && func->use_empty()) {
+            func->eraseFromParent();
+        }
+        functions.erase(entry.first);
+        functionPrototypes.erase(entry.first);
+        for (auto &moduleEntry : moduleFunctions) {
+            moduleEntry.second.erase(entry.first);
+        }
+        skipped++;
+    }
+    lazyFunctionBodies.clear();
+    
+    if (g_verbose && (generated > 0 || skipped > 0)) {
+        std::cout << "[Module] Generated " << generated << " module function(s), skipped "
+                  << skipped << " unused" << std::endl;
+    }
+}
+
 // 在模块中查找全局变量
 llvm::GlobalVariable* CodeGenerator::findModuleGlobal(const std::string& moduleName, const std::string& varName) {
     auto moduleIt = moduleGlobals.find(moduleName);
@@ -436,6 +888,12 @@ llvm::Type *CodeGenerator::getType(const std::string &typeName) {
         return llvm::PointerType::get(*context, 0);
     } else if (typeName == "void") {
         return llvm::Type::getVoidTy(*context);
+    } else if (isReferenceType(typeName)) {
+        // 映射、动态数组、文件、通道和 future 按引用传递：指向头部的指针
+        return llvm::PointerType::get(*context, 0);
+    } else if (isValidVecType(typeName)) {
+        // SIMD 向量按值传递：<N x T>
+        return llvm::FixedVectorType::get(getType(vecElementType(typeName)), vecLaneCount(typeName));
     } else {
         std::cerr << "Warning: Unknown type '" << typeName
                   << "', using void type" << std::endl;
@@ -452,6 +910,64 @@ llvm::AllocaInst *CodeGenerator::createEntryBlockAlloca(
     return tmpBuilder.CreateAlloca(type, nullptr, varName);
 }
 
+// 局部数组（包括数组字面量临时量）都在入口块 alloca，生存期为整个函数调用。
+// 函数体生成完成后，把超过 stackArrayLimit 字节的数组改为入口处 calloc，
+// 并在每个 ret 和 exit 调用（未捕获的异常、运行时错误）之前 free。
+// break/continue 不离开函数，try 内的 throw 通过 longjmp 回到同一函数，最终都经过这些出口
+void CodeGenerator::moveLargeArraysToHeap(llvm::Function *function) {
+    const llvm::DataLayout &layout = module->getDataLayout();
+    std::vector<llvm::AllocaInst *> largeArrays;
+    for (auto &inst : function->getEntryBlock()) {
+        auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst);
+        // setjmp 缓冲区不是用户数组，保持在栈上
+        if (alloca && alloca->getAllocatedType()->isArrayTy() && alloca->getName() != "jmp_buf" &&
+            layout.getTypeAllocSize(alloca->getAllocatedType()) > stackArrayLimit) {
+            largeArrays.push_back(alloca);
+        }
+    }
+    if (largeArrays.empty()) {
+        return;
+    }
+
+    std::vector<llvm::Instruction *> exits;
+    for (auto &block : *function) {
+        for (auto &inst : block) {
+            if (llvm::isa<llvm::ReturnInst>(&inst)) {
+                exits.push_back(&inst);
+            } else if (auto *call = llvm::dyn_cast<llvm::CallInst>(&inst)) {
+                llvm::Function *callee = call->getCalledFunction();
+                if (callee && callee->getName() == "exit") {
+                    exits.push_back(&inst);
+                }
+            }
+        }
+    }
+
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::FunctionCallee callocFunc = module->getOrInsertFunction("calloc", ptrTy, i64, i64);
+    llvm::Function *freeFunc = module->getFunction("free");
+    for (llvm::AllocaInst *alloca : largeArrays) {
+        uint64_t size = layout.getTypeAllocSize(alloca->getAllocatedType());
+        if (g_verbose) {
+            std::cout << "[IR Gen] Array '" << alloca->getName().str() << "' (" << size
+                      << " bytes) in function '" << function->getName().str()
+                      << "' exceeds stack limit, allocating on heap" << std::endl;
+        }
+        // 数组元素的 GEP 带有源元素类型，直接替换基址指针即可
+        llvm::IRBuilder<> entryBuilder(alloca);
+        llvm::Value *heap = entryBuilder.CreateCall(
+            callocFunc, {llvm::ConstantInt::get(i64, 1), llvm::ConstantInt::get(i64, size)},
+            alloca->getName() + "_heap");
+        alloca->replaceAllUsesWith(heap);
+        alloca->eraseFromParent();
+        for (llvm::Instruction *exit : exits) {
+            llvm::IRBuilder<> exitBuilder(exit);
+            exitBuilder.CreateCall(freeFunc, {heap});
+        }
+    }
+}
+
 // 声明内置函数
 void CodeGenerator::declareBuiltinFunctions() {
     // printf函数
@@ -644,7 +1160,8 @@ llvm::Value *CodeGenerator::codegenInterpolatedString(InterpolatedStringNode *no
     
     for (size_t i = 0; i < node->expressions.size(); i++) {
         const auto& expr = node->expressions[i];
-        llvm::Value* exprValue = codegenExpr(expr.get());
+        llvm::Value* viewLength = nullptr;
+        llvm::Value* exprValue = codegenStringView(expr.get(), viewLength);
         if (!exprValue) {
             std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Failed to generate code for expression in interpolated string" << std::endl;
             return nullptr;
@@ -663,12 +1180,28 @@ llvm::Value *CodeGenerator::codegenInterpolatedString(InterpolatedStringNode *no
             formatSpec = getFormatSpecForType(exprType);
         }
         
+        // 向量格式化为 [a, b, ...]，格式说明符作用于每个元素
+        if (exprType->isVectorTy()) {
+            bool customSpec = i < node->formatSpecs.size() && !node->formatSpecs[i].empty();
+            std::string laneSpec = customSpec ? formatSpec : getFormatSpecForType(exprType->getScalarType());
+            formatSpecs.push_back(formatVecLanes(exprValue, laneSpec, exprValues));
+            continue;
+        }
+
         // 布尔值需要特殊处理转为字符串
         if (exprType->isIntegerTy(1)) {
             llvm::Value *trueStr = builder->CreateGlobalString("true", "", 0, module.get());
             llvm::Value *falseStr = builder->CreateGlobalString("false", "", 0, module.get());
             exprValue = builder->CreateSelect(exprValue, trueStr, falseStr, "bool_str");
         }
+
+        // 字符串切片按长度格式化（精度参数在字符串之前）
+        if (viewLength && formatSpec == "%s") {
+            formatSpec = "%.*s";
+            exprValues.push_back(builder->CreateTrunc(viewLength, builder->getInt32Ty()));
+        } else if (viewLength) {
+            exprValue = materializeStringView(exprValue, viewLength);
+        }
         
         exprValues.push_back(exprValue);
         formatSpecs.push_back(formatSpec);
@@ -748,14 +1281,19 @@ llvm::Value *CodeGenerator::codegenBoolLiteral(BoolLiteralNode *node) {
 // 生成标识符引用
 llvm::Value *CodeGenerator::codegenIdentifier(IdentifierNode *node) {
     // 标记变量已被使用
-    usedVariables.insert(node->name);
+    fn->usedVariables.insert(node->name);
     
     // 先查找局部变量
-    llvm::AllocaInst *alloca = namedValues[node->name];
+    llvm::AllocaInst *alloca = fn->namedValues[node->name];
     if (alloca) {
         return builder->CreateLoad(alloca->getAllocatedType(), alloca,
                                    node->name.c_str());
     }
+    auto constArray = fn->constArrays.find(node->name);
+    if (constArray != fn->constArrays.end()) {
+        return builder->CreateLoad(constArray->second->getValueType(), constArray->second,
+                                   node->name.c_str());
+    }
 
     // 再查找全局变量
     llvm::GlobalVariable *globalVar = globalValues[node->name];
@@ -765,7 +1303,7 @@ llvm::Value *CodeGenerator::codegenIdentifier(IdentifierNode *node) {
     }
 
     // 检查是否是声明失败的变量（抑制级联错误）
-    if (failedDeclarations.find(node->name) != failedDeclarations.end()) {
+    if (fn->failedDeclarations.find(node->name) != fn->failedDeclarations.end()) {
         // 静默返回，不报告重复错误
         return nullptr;
     }
@@ -785,11 +1323,19 @@ llvm::Value *CodeGenerator::codegenBinaryOp(BinaryOpNode *node) {
         return codegenLogicalOp(node);
     }
 
-    llvm::Value *left = codegenExpr(node->left.get());
-    llvm::Value *right = codegenExpr(node->right.get());
+    // 字符串切片以视图参与拼接和比较，不复制
+    llvm::Value *leftLength = nullptr;
+    llvm::Value *rightLength = nullptr;
+    llvm::Value *left = codegenStringView(node->left.get(), leftLength);
+    llvm::Value *right = codegenStringView(node->right.get(), rightLength);
     if (!left || !right)
         return nullptr;
 
+    // SIMD 向量逐元素运算
+    if (left->getType()->isVectorTy() || right->getType()->isVectorTy()) {
+        return codegenVecBinaryOp(node->op, left, right, node->lineNumber);
+    }
+
     // 类型提升：bool(i1) -> int(i32)
     if (left->getType()->isIntegerTy(1)) {
         left = builder->CreateZExt(left, llvm::Type::getInt32Ty(*context),
@@ -833,34 +1379,18 @@ llvm::Value *CodeGenerator::codegenBinaryOp(BinaryOpNode *node) {
     // 字符串拼接处理
     if (node->op == "+" && left->getType()->isPointerTy() &&
         right->getType()->isPointerTy()) {
-        // 调用 strlen 获取两个字符串的长度
-        llvm::Function *strlenFunc = module->getFunction("strlen");
-        llvm::Value *len1 = builder->CreateCall(strlenFunc, {left}, "len1");
-        llvm::Value *len2 = builder->CreateCall(strlenFunc, {right}, "len2");
-
-        // 计算新字符串需要的总长度 (len1 + len2 + 1 for null terminator)
-        llvm::Value *totalLen = builder->CreateAdd(len1, len2, "totallen");
-        totalLen = builder->CreateAdd(
-            totalLen, llvm::ConstantInt::get(*context, llvm::APInt(64, 1)),
-            "totallen_plus1");
-
-        // 分配内存
-        llvm::Function *mallocFunc = module->getFunction("malloc");
-        llvm::Value *newStr =
-            builder->CreateCall(mallocFunc, {totalLen}, "newstr");
-
-        // 复制第一个字符串
-        llvm::Function *strcpyFunc = module->getFunction("strcpy");
-        builder->CreateCall(strcpyFunc, {newStr, left});
-
-        // 拼接第二个字符串
-        llvm::Function *strcatFunc = module->getFunction("strcat");
-        builder->CreateCall(strcatFunc, {newStr, right});
-
-        // 追踪临时内存，稍后自动释放
-        pushTempMemory(newStr);
+        return emitStringConcat(left, leftLength, right, rightLength);
+    }
 
-        return newStr;
+    // 字符串按内容比较（映射和动态数组仍比较引用）
+    if ((node->op == "==" || node->op == "!=" || node->op == "<" || node->op == ">" ||
+         node->op == "<=" || node->op == ">=") &&
+        left->getType()->isPointerTy() && right->getType()->isPointerTy()) {
+        std::string leftType = declaredTypeOf(node->left.get());
+        std::string rightType = declaredTypeOf(node->right.get());
+        if (!isReferenceType(leftType) && !isReferenceType(rightType)) {
+            return emitStringCompare(node->op, left, leftLength, right, rightLength);
+        }
     }
 
     bool isFloat = left->getType()->isDoubleTy();
@@ -1002,6 +1532,8 @@ llvm::Value *CodeGenerator::codegenLogicalOp(BinaryOpNode *node) {
 
         // 右侧求值块
         builder->SetInsertPoint(rhsBB);
+        size_t memoryMark = fn->tempMemoryStack.size();
+        size_t referenceMark = fn->tempReferences.size();
         llvm::Value *rightVal = codegenExpr(node->right.get());
         if (!rightVal)
             return nullptr;
@@ -1019,6 +1551,7 @@ llvm::Value *CodeGenerator::codegenLogicalOp(BinaryOpNode *node) {
                     "tobool");
             }
         }
+        clearTempMemorySince(memoryMark, referenceMark);
         builder->CreateBr(mergeBB);
         rhsBB = builder->GetInsertBlock();
 
@@ -1060,6 +1593,8 @@ llvm::Value *CodeGenerator::codegenLogicalOp(BinaryOpNode *node) {
 
         // 右侧求值块
         builder->SetInsertPoint(rhsBB);
+        size_t memoryMark = fn->tempMemoryStack.size();
+        size_t referenceMark = fn->tempReferences.size();
         llvm::Value *rightVal = codegenExpr(node->right.get());
         if (!rightVal)
             return nullptr;
@@ -1077,6 +1612,7 @@ llvm::Value *CodeGenerator::codegenLogicalOp(BinaryOpNode *node) {
                     "tobool");
             }
         }
+        clearTempMemorySince(memoryMark, referenceMark);
         builder->CreateBr(mergeBB);
         rhsBB = builder->GetInsertBlock();
 
@@ -1104,10 +1640,16 @@ llvm::Value *CodeGenerator::codegenUnaryOp(UnaryOpNode *node) {
     }
 
     if (node->op == "-") {
-        return operand->getType()->isDoubleTy()
+        // 向量逐元素取负
+        return operand->getType()->getScalarType()->isDoubleTy()
                    ? builder->CreateFNeg(operand, "negtmp")
                    : builder->CreateNeg(operand, "negtmp");
     }
+    if (node->op == "!" && operand->getType()->isVectorTy()) {
+        reportError("Operator '!' is not supported for vector type '" + typeNameOf(operand->getType()) + "'",
+                    node->lineNumber);
+        return nullptr;
+    }
     if (node->op == "!")
         return builder->CreateNot(operand, "nottmp");
 
@@ -1124,6 +1666,55 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
 
     // 如果有object字段，这是成员函数调用（如 module.function()）
     if (node->object) {
+        // 动态数组的方法写法：a.push(v)、a.pop()、a.reserve(n)
+        std::string objectType = declaredTypeOf(node->object.get());
+        if (isListType(objectType)) {
+            if (node->functionName == "push" || node->functionName == "pop" || node->functionName == "reserve") {
+                return codegenListBuiltin(node, node->object.get(), 0, objectType);
+            }
+            if (isArrayBuiltin(node->functionName) || isVectorBuiltin(node->functionName)) {
+                return codegenArrayBuiltin(node, node->object.get(), 0);
+            }
+            reportError("Unknown list method '" + node->functionName + "'", node->lineNumber);
+            return nullptr;
+        }
+
+        // 通道和 future 的方法写法：c.send(v)、c.recv()、c.close()、h.join()
+        ExprNode *subject = nullptr;
+        size_t firstArg = 0;
+        if (isChanType(objectType) || isFutureType(objectType)) {
+            if (threadBuiltinCall(node, subject, firstArg)) {
+                return codegenThreadBuiltin(node, subject, firstArg);
+            }
+            reportError(std::string(isChanType(objectType) ? "Unknown channel method '" : "Unknown future method '") +
+                        node->functionName + "'", node->lineNumber);
+            return nullptr;
+        }
+
+        // 向量的方法写法：v.sum()、v.dot(w)、v.store(a, i)
+        if (isVecType(objectType)) {
+            if (simdBuiltinCall(node, subject, firstArg)) {
+                return codegenSimdBuiltin(node, subject, firstArg);
+            }
+            reportError("Unknown vector method '" + node->functionName + "'", node->lineNumber);
+            return nullptr;
+        }
+
+        // 定长数组的方法写法：a.sort()、a.binary_search(x) 等
+        if (arrayBuiltinCall(node, subject, firstArg)) {
+            return codegenArrayBuiltin(node, subject, firstArg);
+        }
+
+        // 字符串的方法写法：s.find(sub)、s.split(sep) 等
+        if (stringBuiltinCall(node, subject, firstArg)) {
+            return codegenStringBuiltin(node, subject, firstArg);
+        }
+
+        // 文件的方法写法：f.read_line()、f.write(s)、f.close() 等
+        if (fileBuiltinCall(node, subject, firstArg)) {
+            return codegenFileBuiltin(node, subject, firstArg);
+        }
+        
         // 检查是否是模块函数调用
         if (auto identNode = dynamic_cast<IdentifierNode*>(node->object.get())) {
             std::string moduleName = identNode->name;
@@ -1166,7 +1757,12 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
                 if (moduleFunc->getReturnType()->isVoidTy()) {
                     return builder->CreateCall(moduleFunc, args);
                 }
-                return builder->CreateCall(moduleFunc, args, "module_call");
+                llvm::Value *result = builder->CreateCall(moduleFunc, args, "module_call");
+                auto protoIt = functionPrototypes.find(moduleFunc->getName().str());
+                if (protoIt != functionPrototypes.end() && protoIt->second->returnType) {
+                    pushTempReference(result, protoIt->second->returnType->typeName);
+                }
+                return result;
             } else {
                 reportError("Function '" + node->functionName + "' not found in module '" + moduleName + "'", node->lineNumber);
                 return nullptr;
@@ -1189,7 +1785,8 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
             return builder->CreateCall(printfFunc, args, "printcall");
         }
 
-        llvm::Value *arg = codegenExpr(node->arguments[0].get());
+        llvm::Value *argLength = nullptr;
+        llvm::Value *arg = codegenStringView(node->arguments[0].get(), argLength);
         if (!arg)
             return nullptr;
 
@@ -1216,6 +1813,12 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
             args.push_back(builder->CreateGlobalString(nowrap ? "%f" : "%f\n",
                                                        "", 0, module.get()));
             args.push_back(arg);
+        } else if (argLength) {
+            // 字符串切片：按长度输出
+            args.push_back(builder->CreateGlobalString(nowrap ? "%.*s" : "%.*s\n",
+                                                       "", 0, module.get()));
+            args.push_back(builder->CreateTrunc(argLength, builder->getInt32Ty()));
+            args.push_back(arg);
         } else if (arg->getType()->isPointerTy()) {
             args.push_back(builder->CreateGlobalString(nowrap ? "%s" : "%s\n",
                                                        "", 0, module.get()));
@@ -1247,6 +1850,10 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
                     builder->CreateGlobalString("%s", "", 0, module.get()));
                 args.push_back(str);
             }
+        } else if (arg->getType()->isVectorTy()) {
+            // 向量：[a, b, ...]
+            std::string format = formatVecLanes(arg, getFormatSpecForType(arg->getType()->getScalarType()), args);
+            args.insert(args.begin(), builder->CreateGlobalString(nowrap ? format : format + "\n", "", 0, module.get()));
         } else {
             args.push_back(builder->CreateGlobalString(
                 nowrap ? "(unknown type)" : "(unknown type)\n", "", 0,
@@ -1259,7 +1866,8 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
     // input() 函数
     if (node->functionName == "input") {
         llvm::Function *printfFunc = getPrintfFunction();
-        llvm::Function *getcharFunc = module->getFunction("getchar");
+        // 先取 read_ints 等批量读取后留在缓冲区中的字节
+        llvm::Function *getcharFunc = getStdinGetcFunction();
         llvm::Function *mallocFunc = module->getFunction("malloc");
 
         // 如果有参数,先打印提示信息
@@ -1282,18 +1890,18 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
 
         // 创建索引变量
         llvm::AllocaInst *indexAlloca = createEntryBlockAlloca(
-            currentFunction, "input_index", llvm::Type::getInt32Ty(*context));
+            fn->function, "input_index", llvm::Type::getInt32Ty(*context));
         builder->CreateStore(
             llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 0),
             indexAlloca);
 
         // 创建循环读取字符
         llvm::BasicBlock *loopBB =
-            llvm::BasicBlock::Create(*context, "input_loop", currentFunction);
+            llvm::BasicBlock::Create(*context, "input_loop", fn->function);
         llvm::BasicBlock *storeBB =
-            llvm::BasicBlock::Create(*context, "store_char", currentFunction);
+            llvm::BasicBlock::Create(*context, "store_char", fn->function);
         llvm::BasicBlock *afterBB =
-            llvm::BasicBlock::Create(*context, "after_input", currentFunction);
+            llvm::BasicBlock::Create(*context, "after_input", fn->function);
 
         builder->CreateBr(loopBB);
 
@@ -1363,16 +1971,39 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
             return nullptr;
         }
 
-        llvm::Value *str = codegenExpr(node->arguments[0].get());
+        // 动态数组：元素数量
+        if (isListType(declaredTypeOf(node->arguments[0].get()))) {
+            llvm::Value *list = codegenExpr(node->arguments[0].get());
+            if (!list) {
+                return nullptr;
+            }
+            llvm::Value *size = builder->CreateLoad(
+                llvm::Type::getInt64Ty(*context),
+                builder->CreateStructGEP(getListStructType(), list, LIST_SIZE), "list_size");
+            return builder->CreateTrunc(size, llvm::Type::getInt32Ty(*context), "len");
+        }
+
+        // 映射：键值对数量
+        if (isMapType(declaredTypeOf(node->arguments[0].get()))) {
+            llvm::Value *map = codegenExpr(node->arguments[0].get());
+            if (!map) {
+                return nullptr;
+            }
+            llvm::Value *size = builder->CreateLoad(
+                llvm::Type::getInt64Ty(*context),
+                builder->CreateStructGEP(getMapStructType(), map, MAP_SIZE), "map_size");
+            return builder->CreateTrunc(size, llvm::Type::getInt32Ty(*context), "len");
+        }
+
+        llvm::Value *viewLength = nullptr;
+        llvm::Value *str = codegenStringView(node->arguments[0].get(), viewLength);
         if (!str || !str->getType()->isPointerTy()) {
             // 参数必须是字符串(指针类型)
             return nullptr;
         }
 
-        // 调用 strlen 函数
-        llvm::Function *strlenFunc = module->getFunction("strlen");
-        llvm::Value *length64 =
-            builder->CreateCall(strlenFunc, {str}, "strlen");
+        // 字符串切片直接使用视图长度，其余调用 strlen 函数
+        llvm::Value *length64 = stringViewLength(str, viewLength);
 
         // strlen 返回 i64，转换为 i32
         llvm::Value *length32 = builder->CreateTrunc(
@@ -1381,6 +2012,89 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
         return length32;
     }
 
+    // has() 函数：映射中是否存在键
+    if (node->functionName == "has") {
+        if (node->arguments.size() != 2) {
+            reportError("has() expects 2 arguments (map, key)", node->lineNumber);
+            return nullptr;
+        }
+        std::string mapType = declaredTypeOf(node->arguments[0].get());
+        if (!isMapType(mapType)) {
+            reportError("has() expects a map as its first argument", node->lineNumber);
+            return nullptr;
+        }
+        llvm::Value *map = codegenExpr(node->arguments[0].get());
+        llvm::Value *key = codegenExpr(node->arguments[1].get());
+        if (!map || !key) {
+            return nullptr;
+        }
+        key = convertMapKey(key, mapType, node->lineNumber);
+        if (!key) {
+            return nullptr;
+        }
+        std::string keyType = mapKeyType(mapType);
+        llvm::Value *hash = builder->CreateCall(getMapHashFunction(keyType), {key}, "hash");
+        llvm::Value *slot = builder->CreateCall(getMapFindFunction(keyType), {map, key, hash}, "slot");
+        return builder->CreateICmpSGE(slot, llvm::ConstantInt::get(slot->getType(), 0), "has");
+    }
+
+    // push()/pop()/reserve()：第一个参数是动态数组时为内置函数，否则按普通函数调用
+    if ((node->functionName == "push" || node->functionName == "pop" || node->functionName == "reserve") &&
+        !node->arguments.empty() && isListType(declaredTypeOf(node->arguments[0].get()))) {
+        return codegenListBuiltin(node, node->arguments[0].get(), 1, declaredTypeOf(node->arguments[0].get()));
+    }
+
+    // 字符串内置函数：find()/contains()/count()/starts_with()/ends_with()/split()/replace()/trim()/to_upper()/to_lower()
+    {
+        ExprNode *subject = nullptr;
+        size_t firstArg = 0;
+        if (stringBuiltinCall(node, subject, firstArg)) {
+            return codegenStringBuiltin(node, subject, firstArg);
+        }
+    }
+
+    // 线程内置函数：join()/send()/recv()/close()（第一个参数为 future 或通道，close 先于文件内置函数判断）
+    {
+        ExprNode *subject = nullptr;
+        size_t firstArg = 0;
+        if (threadBuiltinCall(node, subject, firstArg)) {
+            return codegenThreadBuiltin(node, subject, firstArg);
+        }
+    }
+
+    // 文件内置函数：open()/read_line()/read_all(f)/write()/flush()/close()/eof()
+    {
+        ExprNode *handle = nullptr;
+        size_t firstArg = 0;
+        if (fileBuiltinCall(node, handle, firstArg)) {
+            return codegenFileBuiltin(node, handle, firstArg);
+        }
+    }
+
+    // 向量内置函数：sum(v)/min(v)/max(v)/dot(v, w)/store(v, a, i)（第一个参数为向量）
+    {
+        ExprNode *subject = nullptr;
+        size_t firstArg = 0;
+        if (simdBuiltinCall(node, subject, firstArg)) {
+            return codegenSimdBuiltin(node, subject, firstArg);
+        }
+    }
+
+    // 数组内置函数：sort()/sort_desc()/binary_search()/min_index()/max_index()/unique()，
+    // 以及 sum()/min()/max()/dot()/fill()/copy()/scale()/axpy()
+    {
+        ExprNode *array = nullptr;
+        size_t firstArg = 0;
+        if (arrayBuiltinCall(node, array, firstArg)) {
+            return codegenArrayBuiltin(node, array, firstArg);
+        }
+    }
+
+    // 数值输入内置函数：parse_int()/parse_double()/read_ints()/read_doubles()/read_all()
+    if (inputBuiltinCall(node)) {
+        return codegenInputBuiltin(node);
+    }
+
     // to_int() 函数
     if (node->functionName == "to_int") {
         if (node->arguments.empty()) {
@@ -1568,9 +2282,7 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
             }
         }
 
-        // 调用 C 标准库的 pow 函数
-        llvm::Function *powFunc = module->getFunction("pow");
-        return builder->CreateCall(powFunc, {base, exp}, "pow_result");
+        return codegenPow(base, exp);
     }
 
     llvm::Function *calleeFunc = module->getFunction(node->functionName);
@@ -1578,46 +2290,87 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
         reportError("Undefined function '" + node->functionName + "'", node->lineNumber);
         return nullptr;
     }
+    if (isGeneratorFunction(node->functionName)) {
+        reportError("Generator '" + node->functionName + "' can only be iterated by a for loop", node->lineNumber);
+        return nullptr;
+    }
+    requestFunctionBody(node->functionName);
+
+    std::vector<llvm::Value *> args;
+    if (!codegenCallArguments(node, calleeFunc, args)) {
+        return nullptr;
+    }
+
+    // void 函数不应该有返回值名称
+    if (calleeFunc->getReturnType()->isVoidTy()) {
+        return builder->CreateCall(calleeFunc, args);
+    }
+    // 返回的动态数组是调用者的临时值
+    llvm::Value *result = builder->CreateCall(calleeFunc, args, "calltmp");
+    auto protoIt = functionPrototypes.find(node->functionName);
+    if (protoIt != functionPrototypes.end() && protoIt->second->returnType) {
+        pushTempReference(result, protoIt->second->returnType->typeName);
+    }
+    return result;
+}
 
+// 检查用户函数调用的参数个数和类型，按参数类型生成实参（spawn 与普通调用共用）
+bool CodeGenerator::codegenCallArguments(FunctionCallNode *node, llvm::Function *callee,
+                                         std::vector<llvm::Value *> &args) {
     // 检查参数数量（对可变参数函数需要特殊处理）
-    if (!calleeFunc->isVarArg()) {
+    if (!callee->isVarArg()) {
         // 普通函数：参数数量必须完全匹配
-        if (calleeFunc->arg_size() != node->arguments.size()) {
+        if (callee->arg_size() != node->arguments.size()) {
             std::string msg = "Function '" + node->functionName + "' expects " +
-                              std::to_string(calleeFunc->arg_size()) + " argument(s) but got " +
+                              std::to_string(callee->arg_size()) + " argument(s) but got " +
                               std::to_string(node->arguments.size());
             reportError(msg, node->lineNumber);
-            return nullptr;
+            return false;
         }
     } else {
         // 可变参数函数：至少要有固定参数数量
-        if (node->arguments.size() < calleeFunc->arg_size()) {
+        if (node->arguments.size() < callee->arg_size()) {
             std::string msg = "Variadic function '" + node->functionName + "' expects at least " +
-                              std::to_string(calleeFunc->arg_size()) + " argument(s) but got " +
+                              std::to_string(callee->arg_size()) + " argument(s) but got " +
                               std::to_string(node->arguments.size());
             reportError(msg, node->lineNumber);
-            return nullptr;
+            return false;
         }
     }
 
-    std::vector<llvm::Value *> args;
     unsigned idx = 0;
+    auto protoIt = functionPrototypes.find(node->functionName);
     for (auto &arg : node->arguments) {
         // 特殊处理：如果参数是数组标识符且期望指针类型，传递数组地址而不是加载值
         llvm::Value *argVal = nullptr;
         
+        // 映射和动态数组与其他类型都以指针传递，需要按声明类型检查（同类型的字面量除外）
+        std::string paramTypeName;
+        if (protoIt != functionPrototypes.end() && idx < protoIt->second->parameters.size()) {
+            paramTypeName = protoIt->second->parameters[idx]->type->typeName;
+        }
+        std::string argTypeName = declaredTypeOf(arg.get());
+        bool literalOfParamType = (dynamic_cast<MapLiteralNode *>(arg.get()) && isMapType(paramTypeName)) ||
+                                  (dynamic_cast<ArrayLiteralNode *>(arg.get()) && isListType(paramTypeName));
+        if (!paramTypeName.empty() && !argTypeName.empty() && !literalOfParamType && argTypeName != paramTypeName &&
+            (isReferenceType(paramTypeName) || isReferenceType(argTypeName))) {
+            reportError("Type mismatch for argument " + std::to_string(idx) + " in function '" + node->functionName +
+                        "': expected '" + paramTypeName + "' but got '" + argTypeName + "'", node->lineNumber);
+            return false;
+        }
+        
         // 检查是否期望指针类型（对于数组参数）
         bool expectsPointer = false;
-        if (idx < calleeFunc->arg_size()) {
-            llvm::Type *expectedType = calleeFunc->getFunctionType()->getParamType(idx);
+        if (idx < callee->arg_size()) {
+            llvm::Type *expectedType = callee->getFunctionType()->getParamType(idx);
             expectsPointer = expectedType->isPointerTy();
         }
         
         // 如果参数是标识符且期望指针
         if (expectsPointer) {
             if (auto identNode = dynamic_cast<IdentifierNode*>(arg.get())) {
-                auto it = namedValues.find(identNode->name);
-                if (it != namedValues.end()) {
+                auto it = fn->namedValues.find(identNode->name);
+                if (it != fn->namedValues.end() && it->second) {
                     llvm::AllocaInst *alloca = it->second;
                     // 检查是否是数组类型
                     if (alloca->getAllocatedType()->isArrayTy()) {
@@ -1627,22 +2380,49 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
                         indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(32, 0)));
                         argVal = builder->CreateInBoundsGEP(
                             alloca->getAllocatedType(), alloca, indices, "array_param");
+                        fn->usedVariables.insert(identNode->name);
+                    }
+                }
+                // 全局数组直接传递其地址
+                llvm::GlobalVariable *readOnlyArray = nullptr;
+                auto constArray = fn->constArrays.find(identNode->name);
+                if (constArray != fn->constArrays.end()) {
+                    readOnlyArray = constArray->second;
+                } else if (it == fn->namedValues.end()) {
+                    auto globalArray = globalValues.find(identNode->name);
+                    if (globalArray != globalValues.end() && globalArray->second->getValueType()->isArrayTy()) {
+                        if (globalArray->second->isConstant()) {
+                            readOnlyArray = globalArray->second;
+                        } else {
+                            argVal = globalArray->second;
+                        }
                     }
                 }
+                // 只读的常量数组复制到栈上再传递（被调函数可能修改数组参数）
+                if (readOnlyArray) {
+                    llvm::Type *arrayType = readOnlyArray->getValueType();
+                    llvm::AllocaInst *copy = createEntryBlockAlloca(
+                        builder->GetInsertBlock()->getParent(), identNode->name + "_copy", arrayType);
+                    const llvm::DataLayout &layout = module->getDataLayout();
+                    llvm::Align align = layout.getPrefTypeAlign(arrayType);
+                    builder->CreateMemCpy(copy, align, readOnlyArray, align, layout.getTypeAllocSize(arrayType));
+                    fn->usedVariables.insert(identNode->name);
+                    argVal = copy;
+                }
             }
         }
         
-        // 如果没有特殊处理，正常生成表达式
+        // 如果没有特殊处理，正常生成表达式（映射和动态数组字面量按参数声明的类型生成）
         if (!argVal) {
-            argVal = codegenExpr(arg.get());
+            argVal = codegenTypedExpr(arg.get(), paramTypeName);
         }
         
         if (!argVal)
-            return nullptr;
+            return false;
 
         // 对于可变参数函数，只有固定参数需要类型检查
         // 可变参数部分直接传递
-        if (idx >= calleeFunc->arg_size()) {
+        if (idx >= callee->arg_size()) {
             // 这是可变参数部分，直接添加
             args.push_back(argVal);
             idx++;
@@ -1651,7 +2431,7 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
 
         // 获取期望的参数类型
         llvm::Type *expectedType =
-            calleeFunc->getFunctionType()->getParamType(idx);
+            callee->getFunctionType()->getParamType(idx);
 
         // 检查并转换类型
         if (argVal->getType() != expectedType) {
@@ -1664,65 +2444,217 @@ llvm::Value *CodeGenerator::codegenFunctionCall(FunctionCallNode *node) {
                 std::string msg = "Type mismatch for argument " + std::to_string(idx) + 
                                   " in function '" + node->functionName + "'";
                 reportError(msg, node->lineNumber);
-                return nullptr;
+                return false;
             }
         }
 
         args.push_back(argVal);
         idx++;
     }
-
-    // void 函数不应该有返回值名称
-    if (calleeFunc->getReturnType()->isVoidTy()) {
-        return builder->CreateCall(calleeFunc, args);
-    }
-    return builder->CreateCall(calleeFunc, args, "calltmp");
+    return true;
 }
 
 // 生成数组访问
-llvm::Value *CodeGenerator::codegenArrayAccess(ArrayAccessNode *node) {
-    llvm::Value *index = codegenExpr(node->index.get());
-    if (!index) {
+// 下标链 a[i][j]... 的根是定长数组时返回其地址，arrayType 为数组类型：局部数组为栈上的 alloca 或只读的全局常量，
+// 数组参数为保存调用者传入指针的槽位（由 emitFixedArrayElementPtr 载入），全局数组为全局变量本身
+llvm::Value *CodeGenerator::fixedArrayOf(ArrayAccessNode *node, llvm::Type *&arrayType) {
+    ExprNode *root = node->array.get();
+    while (auto inner = dynamic_cast<ArrayAccessNode *>(root)) {
+        root = inner->array.get();
+    }
+    auto ident = dynamic_cast<IdentifierNode *>(root);
+    if (!ident) {
         return nullptr;
     }
-    
-    // 检查索引类型必须是整数
-    if (!index->getType()->isIntegerTy()) {
-        reportError("Array index must be integer type", node->lineNumber);
+    auto constIt = fn->constArrays.find(ident->name);
+    if (constIt != fn->constArrays.end()) {
+        arrayType = constIt->second->getValueType();
+        return constIt->second;
+    }
+    auto it = fn->namedValues.find(ident->name);
+    if (it == fn->namedValues.end()) {
+        auto global = globalValues.find(ident->name);
+        if (global == globalValues.end() || !global->second->getValueType()->isArrayTy()) {
+            return nullptr;
+        }
+        arrayType = global->second->getValueType();
+        return global->second;
+    }
+    if (!it->second) {
+        return nullptr;
+    }
+    if (it->second->getAllocatedType()->isArrayTy()) {
+        arrayType = it->second->getAllocatedType();
+        return it->second;
+    }
+    auto param = fn->arrayParams.find(ident->name);
+    if (param == fn->arrayParams.end()) {
+        return nullptr;
+    }
+    arrayType = param->second;
+    return it->second;
+}
+
+// 定长数组元素地址：多维数组按行主序连续存储，a[i0][i1]...[ik] 的每个下标与对应维度做一次无符号比较
+// （同时排除负数），合并为一次条件跳转；通过后计算线性下标 ((i0*D1 + i1)*D2 + ...) 并生成单个 GEP。
+// 各维度的比较相互独立，外层下标的比较在内层循环中是循环不变量，优化时可以提到循环外；
+// 线性下标带 nuw/nsw 标记，向量化时可以直接得到行步长
+// 返回时插入点位于检查通过的分支，errorBB 为已输出错误信息、尚未终结的越界分支
+llvm::Value *CodeGenerator::emitFixedArrayElementPtr(ArrayAccessNode *node, llvm::Type *&elementType,
+                                                     llvm::BasicBlock *&errorBB) {
+    llvm::Type *arrayType = nullptr;
+    llvm::Value *base = fixedArrayOf(node, arrayType);
+    auto slot = llvm::dyn_cast<llvm::AllocaInst>(base);
+    if (slot && !slot->getAllocatedType()->isArrayTy()) {
+        // 数组参数：槽位中保存的是数组首地址
+        base = builder->CreateLoad(slot->getAllocatedType(), slot, slot->getName() + "_ptr");
+    }
+
+    // 从外层到内层收集下标
+    std::vector<ExprNode *> indexExprs;
+    for (ArrayAccessNode *current = node; current;
+         current = dynamic_cast<ArrayAccessNode *>(current->array.get())) {
+        indexExprs.insert(indexExprs.begin(), current->index.get());
+    }
+
+    // 各维度长度来自声明时的 arrayDimensions（嵌套的 LLVM 数组类型）
+    std::vector<uint64_t> dimensions;
+    elementType = arrayType;
+    for (size_t i = 0; i < indexExprs.size(); i++) {
+        if (!elementType->isArrayTy()) {
+            reportError("Dimension mismatch in array access", node->lineNumber);
+            return nullptr;
+        }
+        dimensions.push_back(elementType->getArrayNumElements());
+        elementType = elementType->getArrayElementType();
+    }
+
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    std::vector<llvm::Value *> indices;
+    for (ExprNode *indexExpr : indexExprs) {
+        llvm::Value *index = codegenExpr(indexExpr);
+        if (!index) {
+            return nullptr;
+        }
+        if (!index->getType()->isIntegerTy()) {
+            reportError("Array index must be integer type", node->lineNumber);
+            return nullptr;
+        }
+        indices.push_back(builder->CreateSExtOrTrunc(index, i64, "index64"));
+    }
+
+    llvm::Value *inBounds = nullptr;
+    for (size_t i = 0; i < indices.size(); i++) {
+        llvm::Value *dimInBounds = builder->CreateICmpULT(
+            indices[i], llvm::ConstantInt::get(i64, dimensions[i]), "dim_in_bounds");
+        inBounds = inBounds ? builder->CreateLogicalAnd(inBounds, dimInBounds, "in_bounds") : dimInBounds;
+    }
+    // @nocheck：条件为常量 true，越界分支不可达，由后端删除
+    if (omitRuntimeCheck()) {
+        inBounds = builder->getTrue();
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *accessBB = llvm::BasicBlock::Create(*context, "array_access", function);
+    errorBB = llvm::BasicBlock::Create(*context, "bounds_error", function);
+    builder->CreateCondBr(inBounds, accessBB, errorBB);
+
+    builder->SetInsertPoint(errorBB);
+    llvm::Value *errorMsg = builder->CreateGlobalString(
+        "Runtime Error: Array index out of bounds\n", "", 0, module.get());
+    builder->CreateCall(getPrintfFunction(), {errorMsg});
+
+    builder->SetInsertPoint(accessBB);
+    llvm::Value *linearIndex = indices[0];
+    for (size_t i = 1; i < indices.size(); i++) {
+        linearIndex = builder->CreateMul(linearIndex, llvm::ConstantInt::get(i64, dimensions[i]),
+                                         "row_offset", true, true);
+        linearIndex = builder->CreateAdd(linearIndex, indices[i], "linear_index", true, true);
+    }
+    return builder->CreateInBoundsGEP(elementType, base, linearIndex, "arrayptr");
+}
+
+llvm::Value *CodeGenerator::codegenArrayAccess(ArrayAccessNode *node) {
+    // 映射按键读取，动态数组按下标读取
+    std::string containerType = declaredTypeOf(node->array.get());
+    if (isMapType(containerType)) {
+        return codegenMapGet(node, containerType);
+    }
+    if (isListType(containerType)) {
+        return codegenListGet(node, containerType);
+    }
+    if (isVecType(containerType)) {
+        return codegenVecLane(node);
+    }
+
+    // 定长数组（含多维）：越界时报告运行时错误并返回默认值
+    llvm::Type *fixedArrayType = nullptr;
+    if (fixedArrayOf(node, fixedArrayType)) {
+        // 读取元素视为使用了数组变量
+        ExprNode *root = node;
+        while (auto access = dynamic_cast<ArrayAccessNode *>(root)) {
+            root = access->array.get();
+        }
+        fn->usedVariables.insert(static_cast<IdentifierNode *>(root)->name);
+
+        llvm::Type *elementType = nullptr;
+        llvm::BasicBlock *errorBB = nullptr;
+        llvm::Value *ptr = emitFixedArrayElementPtr(node, elementType, errorBB);
+        if (!ptr) {
+            return nullptr;
+        }
+        llvm::Value *loadedVal = builder->CreateLoad(elementType, ptr, "arrayval");
+        llvm::BasicBlock *accessBB = builder->GetInsertBlock();
+        llvm::BasicBlock *mergeBB =
+            llvm::BasicBlock::Create(*context, "bounds_merge", accessBB->getParent());
+        builder->CreateBr(mergeBB);
+        builder->SetInsertPoint(errorBB);
+        builder->CreateBr(mergeBB);
+
+        builder->SetInsertPoint(mergeBB);
+        llvm::PHINode *phi = builder->CreatePHI(elementType, 2, "array_result");
+        phi->addIncoming(loadedVal, accessBB);
+        phi->addIncoming(llvm::Constant::getNullValue(elementType), errorBB);
+        return phi;
+    }
+
+    llvm::Value *index = codegenExpr(node->index.get());
+    if (!index) {
+        return nullptr;
+    }
+    
+    // 检查索引类型必须是整数
+    if (!index->getType()->isIntegerTy()) {
+        reportError("Array index must be integer type", node->lineNumber);
         return nullptr;
     }
 
-    // 获取数组变量或子数组
+    // 获取数组参数（指针）或字符串变量
     llvm::Value *arrayPtr = nullptr;
     llvm::Type *arrayType = nullptr;
     llvm::Type *elementType = nullptr;
-    bool isFromVariable = false;
     
     if (auto identNode = dynamic_cast<IdentifierNode*>(node->array.get())) {
         // 直接访问变量
         std::string arrayVarName = identNode->name;
         
         // 检查是否是声明失败的变量（抑制级联错误）
-        if (failedDeclarations.find(arrayVarName) != failedDeclarations.end()) {
+        if (fn->failedDeclarations.find(arrayVarName) != fn->failedDeclarations.end()) {
             return nullptr;  // 静默返回，不报告重复错误
         }
         
-        auto it = namedValues.find(arrayVarName);
-        if (it == namedValues.end()) {
+        auto it = fn->namedValues.find(arrayVarName);
+        if (it == fn->namedValues.end()) {
             reportError("Undefined array variable '" + arrayVarName + "'", node->lineNumber);
             return nullptr;
         }
         
         arrayPtr = it->second;
-        isFromVariable = true;
         
         if (auto allocaInst = llvm::dyn_cast<llvm::AllocaInst>(arrayPtr)) {
             arrayType = allocaInst->getAllocatedType();
             
-            if (arrayType->isArrayTy()) {
-                llvm::ArrayType *arrType = llvm::cast<llvm::ArrayType>(arrayType);
-                elementType = arrType->getElementType();
-            } else if (arrayType->isPointerTy()) {
+            if (arrayType->isPointerTy()) {
                 // 数组参数（作为指针传递）
                 // 元素类型通过加载指针获得
                 // 对于不透明指针，我们需要知道元素类型，暂时假设为 i32
@@ -1736,77 +2668,9 @@ llvm::Value *CodeGenerator::codegenArrayAccess(ArrayAccessNode *node) {
             return nullptr;
         }
     } else if (dynamic_cast<ArrayAccessNode*>(node->array.get())) {
-        // 链式访问：matrix[0][1] 或 cube[0][0][0]
-        // 使用辅助函数递归收集所有索引
-        std::vector<llvm::Value*> allIndices;
-        std::string baseVarName;
-        
-        // 递归收集索引
-        ArrayAccessNode* current = node;
-        while (current) {
-            llvm::Value *idx = codegenExpr(current->index.get());
-            if (!idx) return nullptr;
-            allIndices.insert(allIndices.begin(), idx);  // 前插
-            
-            if (auto innerAccess = dynamic_cast<ArrayAccessNode*>(current->array.get())) {
-                current = innerAccess;
-            } else if (auto ident = dynamic_cast<IdentifierNode*>(current->array.get())) {
-                baseVarName = ident->name;
-                break;
-            } else {
-                reportError("Unsupported nested array access", node->lineNumber);
-                return nullptr;
-            }
-        }
-        
-        // 获取基础数组
-        auto it = namedValues.find(baseVarName);
-        if (it == namedValues.end()) {
-            reportError("Undefined array variable '" + baseVarName + "'", node->lineNumber);
-            return nullptr;
-        }
-        
-        llvm::Value *basePtr = it->second;
-        llvm::Type *currentType = nullptr;
-        
-        if (auto allocaInst = llvm::dyn_cast<llvm::AllocaInst>(basePtr)) {
-            currentType = allocaInst->getAllocatedType();
-        } else {
-            reportError("Not an array variable", node->lineNumber);
-            return nullptr;
-        }
-        
-        // 逐层访问
-        llvm::Value *currentPtr = basePtr;
-        for (size_t i = 0; i < allIndices.size() - 1; i++) {
-            if (!currentType->isArrayTy()) {
-                reportError("Dimension mismatch in array access", node->lineNumber);
-                return nullptr;
-            }
-            
-            llvm::ArrayType *arrType = llvm::cast<llvm::ArrayType>(currentType);
-            std::vector<llvm::Value*> indices;
-            indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-            indices.push_back(allIndices[i]);
-            
-            currentPtr = builder->CreateGEP(currentType, currentPtr, indices, "sub_ptr");
-            currentType = arrType->getElementType();
-        }
-        
-        // 设置最终访问
-        arrayPtr = currentPtr;
-        arrayType = currentType;
-        
-        if (arrayType->isArrayTy()) {
-            llvm::ArrayType *arrType = llvm::cast<llvm::ArrayType>(arrayType);
-            elementType = arrType->getElementType();
-        } else {
-            elementType = arrayType;
-        }
-        
-        // 使用收集的最后一个索引
-        index = allIndices.back();
-        isFromVariable = false;
+        // 链式访问只支持局部定长数组（已在上面处理）
+        reportError("Dimension mismatch in array access", node->lineNumber);
+        return nullptr;
     } else {
         reportError("Unsupported array access pattern", node->lineNumber);
         return nullptr;
@@ -1820,8 +2684,8 @@ llvm::Value *CodeGenerator::codegenArrayAccess(ArrayAccessNode *node) {
         arrayVarName = identNode->name;
 
         // 从类型信息表查询变量类型
-        auto typeIt = variableTypes.find(arrayVarName);
-        if (typeIt != variableTypes.end()) {
+        auto typeIt = fn->variableTypes.find(arrayVarName);
+        if (typeIt != fn->variableTypes.end()) {
             std::string varType = typeIt->second;
 
             // 如果是字符串类型(string/char*)，元素类型是i8
@@ -1865,12 +2729,14 @@ llvm::Value *CodeGenerator::codegenArrayAccess(ArrayAccessNode *node) {
 
     llvm::Value *isOutOfBounds = isNegative;
 
-    // 检查2: 对于字符串类型，检查索引是否超出长度
+    // 检查2: 对于字符串类型，检查索引是否超出长度（变量中保存的是字符串指针）
+    llvm::Value *loadedPtr = nullptr;
     if (isStringType) {
         llvm::Function *strlenFunc = module->getFunction("strlen");
         if (strlenFunc) {
+            loadedPtr = builder->CreateLoad(arrayType, arrayPtr, "loaded_ptr");
             llvm::Value *length64 =
-                builder->CreateCall(strlenFunc, {arrayPtr}, "strlen");
+                builder->CreateCall(strlenFunc, {loadedPtr}, "strlen");
             llvm::Value *length32 = builder->CreateTrunc(
                 length64, llvm::Type::getInt32Ty(*context), "len32");
 
@@ -1895,6 +2761,9 @@ llvm::Value *CodeGenerator::codegenArrayAccess(ArrayAccessNode *node) {
         }
     }
 
+    if (omitRuntimeCheck()) {
+        isOutOfBounds = builder->getFalse();
+    }
     builder->CreateCondBr(isOutOfBounds, errorBB, accessBB);
 
     // 错误分支：打印错误信息并返回默认值
@@ -1915,21 +2784,11 @@ llvm::Value *CodeGenerator::codegenArrayAccess(ArrayAccessNode *node) {
     builder->SetInsertPoint(accessBB);
     
     llvm::Value *ptr = nullptr;
-    if (arrayType && arrayType->isArrayTy() && isFromVariable) {
-        // 从变量直接访问数组：使用 GEP(array, 0, index)
-        std::vector<llvm::Value*> indices;
-        indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-        indices.push_back(index);
-        ptr = builder->CreateGEP(arrayType, arrayPtr, indices, "arrayptr");
-    } else if (arrayType && arrayType->isArrayTy() && !isFromVariable) {
-        // 从子数组访问（链式访问）：arrayPtr 已经是子数组指针
-        std::vector<llvm::Value*> indices;
-        indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-        indices.push_back(index);
-        ptr = builder->CreateGEP(arrayType, arrayPtr, indices, "arrayptr");
-    } else if (arrayType && arrayType->isPointerTy()) {
+    if (arrayType && arrayType->isPointerTy()) {
         // 数组参数（指针类型）：需要先加载指针值，然后使用 GEP
-        llvm::Value *loadedPtr = builder->CreateLoad(arrayType, arrayPtr, "loaded_ptr");
+        if (!loadedPtr) {
+            loadedPtr = builder->CreateLoad(arrayType, arrayPtr, "loaded_ptr");
+        }
         ptr = builder->CreateGEP(elementType, loadedPtr, index, "arrayptr");
     } else {
         // 指针类型（字符串等）：使用 GEP(ptr, index)
@@ -1993,8 +2852,8 @@ llvm::Value *CodeGenerator::codegenMemberAccess(MemberAccessNode *node) {
         
         // 如果不是模块访问，可能是对象成员访问
         // 检查变量是否存在
-        auto varIt = namedValues.find(objectName);
-        if (varIt != namedValues.end()) {
+        auto varIt = fn->namedValues.find(objectName);
+        if (varIt != fn->namedValues.end()) {
             // 变量存在，但PiPiXia目前不支持结构体/类
             reportError("Member access on object '" + objectName + "' is not supported. PiPiXia currently does not support structures or classes", node->lineNumber);
             return nullptr;
@@ -2032,6 +2891,8 @@ llvm::Value *CodeGenerator::codegenExpr(ExprNode *node) {
         return codegenBoolLiteral(boolLit);
     if (auto arrayLit = dynamic_cast<ArrayLiteralNode *>(node))
         return codegenArrayLiteral(arrayLit);
+    if (auto mapLit = dynamic_cast<MapLiteralNode *>(node))
+        return codegenMapLiteral(mapLit, "");
     if (auto ident = dynamic_cast<IdentifierNode *>(node))
         return codegenIdentifier(ident);
     if (auto binOp = dynamic_cast<BinaryOpNode *>(node))
@@ -2042,8 +2903,16 @@ llvm::Value *CodeGenerator::codegenExpr(ExprNode *node) {
         return codegenFunctionCall(funcCall);
     if (auto arrayAccess = dynamic_cast<ArrayAccessNode *>(node))
         return codegenArrayAccess(arrayAccess);
+    if (auto slice = dynamic_cast<SliceNode *>(node))
+        return codegenSlice(slice);
     if (auto memberAccess = dynamic_cast<MemberAccessNode *>(node))
         return codegenMemberAccess(memberAccess);
+    if (auto spawn = dynamic_cast<SpawnNode *>(node))
+        return codegenSpawn(spawn, false);
+    if (auto channel = dynamic_cast<ChannelNode *>(node))
+        return codegenChannel(channel);
+    if (auto vec = dynamic_cast<VecNode *>(node))
+        return codegenVec(vec);
 
     reportError("Unknown expression node type", 0);
     return nullptr;
@@ -2051,6 +2920,151 @@ llvm::Value *CodeGenerator::codegenExpr(ExprNode *node) {
 
 // 表达式代码生成 - 数组字面量
 
+// 按书写顺序求值数组字面量的元素（每个元素只求值一次），并按 dimensions 检查各维长度；
+// 元素的 offset 为按行主序展开后的位置，字面量中没有给出的元素不出现在 elements 中
+bool CodeGenerator::evaluateArrayLiteral(ArrayLiteralNode *literal, const std::vector<uint64_t> &dimensions,
+                                         size_t depth, uint64_t base, std::vector<ArrayLiteralElement> &elements) {
+    if (literal->elements.size() > dimensions[depth]) {
+        reportError("Array size mismatch: declared size is " + std::to_string(dimensions[depth]) +
+                    " but initializer has " + std::to_string(literal->elements.size()) + " elements",
+                    literal->lineNumber);
+        return false;
+    }
+    uint64_t stride = 1;
+    for (size_t d = depth + 1; d < dimensions.size(); d++) {
+        stride *= dimensions[d];
+    }
+    bool innerLevel = depth + 1 < dimensions.size();
+    for (size_t i = 0; i < literal->elements.size(); i++) {
+        auto subLiteral = dynamic_cast<ArrayLiteralNode *>(literal->elements[i].get());
+        if ((subLiteral != nullptr) != innerLevel) {
+            reportError("Inconsistent array dimensions", literal->lineNumber);
+            return false;
+        }
+        if (subLiteral) {
+            if (!evaluateArrayLiteral(subLiteral, dimensions, depth + 1, base + i * stride, elements)) {
+                return false;
+            }
+            continue;
+        }
+        llvm::Value *value = codegenExpr(literal->elements[i].get());
+        if (!value) {
+            return false;
+        }
+        elements.push_back({base + i * stride, value});
+    }
+    return true;
+}
+
+// 由按行主序排列的元素常量重建嵌套的 ConstantArray
+static llvm::Constant *buildArrayConstant(llvm::Type *type, const std::vector<llvm::Constant *> &flat, size_t &next) {
+    if (!type->isArrayTy()) {
+        return flat[next++];
+    }
+    std::vector<llvm::Constant *> items;
+    for (uint64_t i = 0; i < type->getArrayNumElements(); i++) {
+        items.push_back(buildArrayConstant(type->getArrayElementType(), flat, next));
+    }
+    return llvm::ConstantArray::get(llvm::cast<llvm::ArrayType>(type), items);
+}
+
+// 数组字面量的常量部分：元素先转换为数组的元素类型，常量元素填入对应位置，
+// 非常量元素和未给出的元素为 0；allConstant 表示所有元素都是常量
+llvm::Constant *CodeGenerator::arrayLiteralConstant(llvm::ArrayType *type, std::vector<ArrayLiteralElement> &elements,
+                                                    bool &allConstant, int lineNumber) {
+    llvm::Type *scalarType = type;
+    uint64_t count = 1;
+    while (scalarType->isArrayTy()) {
+        count *= scalarType->getArrayNumElements();
+        scalarType = scalarType->getArrayElementType();
+    }
+
+    std::vector<llvm::Constant *> flat(count, llvm::Constant::getNullValue(scalarType));
+    allConstant = true;
+    for (auto &element : elements) {
+        if (element.value->getType()->isPointerTy() != scalarType->isPointerTy()) {
+            reportError("Array element type mismatch: expected '" + typeNameOf(scalarType) + "' but got '" +
+                        typeNameOf(element.value->getType()) + "'", lineNumber);
+            return nullptr;
+        }
+        element.value = convertToType(element.value, scalarType);
+        if (auto constant = llvm::dyn_cast<llvm::Constant>(element.value)) {
+            flat[element.offset] = constant;
+        } else {
+            allConstant = false;
+        }
+    }
+    size_t next = 0;
+    return buildArrayConstant(type, flat, next);
+}
+
+// 用数组字面量初始化 dest 处的定长数组：常量部分放在 private unnamed_addr 全局常量中，
+// 用一次 llvm.memcpy 复制（全为 0 时用 memset），之后只写入非常量元素
+void CodeGenerator::emitArrayLiteralInit(llvm::Value *dest, llvm::ArrayType *type, llvm::Constant *constantPart,
+                                         std::vector<ArrayLiteralElement> &elements, const std::string &name) {
+    const llvm::DataLayout &layout = module->getDataLayout();
+    uint64_t size = layout.getTypeAllocSize(type);
+    llvm::Align align = layout.getPrefTypeAlign(type);
+    if (constantPart->isNullValue()) {
+        builder->CreateMemSet(dest, builder->getInt8(0), size, align);
+    } else {
+        auto skeleton = new llvm::GlobalVariable(*module, type, true, llvm::GlobalValue::PrivateLinkage,
+                                                 constantPart, name + ".init");
+        skeleton->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        skeleton->setAlignment(align);
+        builder->CreateMemCpy(dest, align, skeleton, align, size);
+    }
+
+    llvm::Type *scalarType = type;
+    while (scalarType->isArrayTy()) {
+        scalarType = scalarType->getArrayElementType();
+    }
+    for (const auto &element : elements) {
+        if (!llvm::isa<llvm::Constant>(element.value)) {
+            llvm::Value *elemPtr = builder->CreateInBoundsGEP(scalarType, dest, builder->getInt64(element.offset), "elem_ptr");
+            builder->CreateStore(element.value, elemPtr);
+        }
+    }
+}
+
+// 定长数组全局变量的初始值（在全局构造函数或 REPL 入口函数中调用）：元素全为常量时直接成为全局变量的初始值，
+// 不生成代码，常量数组因此留在只读数据中；否则按局部数组的方式写入。返回 false 表示不是定长数组
+bool CodeGenerator::emitGlobalArrayInit(const GlobalInitializer &init) {
+    auto arrayType = llvm::dyn_cast<llvm::ArrayType>(init.variable->getValueType());
+    if (!arrayType) {
+        return false;
+    }
+    // 声明时已检查初始值是数组字面量
+    auto literal = static_cast<ArrayLiteralNode *>(init.initializer);
+    std::vector<uint64_t> dimensions;
+    for (llvm::Type *level = arrayType; level->isArrayTy(); level = level->getArrayElementType()) {
+        dimensions.push_back(level->getArrayNumElements());
+    }
+    std::vector<ArrayLiteralElement> elements;
+    if (!evaluateArrayLiteral(literal, dimensions, 0, 0, elements)) {
+        return true;
+    }
+    bool allConstant = false;
+    llvm::Constant *constantPart = arrayLiteralConstant(arrayType, elements, allConstant, literal->lineNumber);
+    if (!constantPart) {
+        return true;
+    }
+    if (allConstant) {
+        init.variable->setInitializer(constantPart);
+        if (g_verbose) {
+            std::cout << "[IR Gen] Global array '" << init.variable->getName().str()
+                      << "' is initialized statically" << std::endl;
+        }
+        return true;
+    }
+    if (init.variable->isConstant()) {
+        reportError("Global constant array elements must be constants", literal->lineNumber);
+        return true;
+    }
+    emitArrayLiteralInit(init.variable, arrayType, constantPart, elements, init.variable->getName().str());
+    return true;
+}
+
 llvm::Value *CodeGenerator::codegenArrayLiteral(ArrayLiteralNode *node) {
     // 处理空数组：生成默认类型（int）的空数组
     if (node->elements.empty()) {
@@ -2069,94 +3083,32 @@ llvm::Value *CodeGenerator::codegenArrayLiteral(ArrayLiteralNode *node) {
         return builder->CreateGEP(arrayType, arrayAlloca, indices, "empty_array_ptr");
     }
     
-    // 检查是否是嵌套数组（多维）
-    bool isNestedArray = dynamic_cast<ArrayLiteralNode*>(node->elements[0].get()) != nullptr;
-    
-    if (isNestedArray) {
-        // 多维数组：递归处理
-        // 先生成第一个子数组确定类型
-        auto firstSubArray = dynamic_cast<ArrayLiteralNode*>(node->elements[0].get());
-        llvm::Value *firstSubValue = codegenArrayLiteral(firstSubArray);
-        if (!firstSubValue) return nullptr;
-        
-        // 获取子数组类型（这是一个指针，指向子数组的第一个元素）
-        // 我们需要重建完整的子数组类型
-        llvm::Value *firstSubElem = codegenExpr(firstSubArray->elements[0].get());
-        if (!firstSubElem) {
-            reportError("Failed to generate code for first sub-array element", node->lineNumber);
-            return nullptr;
-        }
-        llvm::Type *firstSubElemType = firstSubElem->getType();
-        llvm::ArrayType *subArrayType = llvm::ArrayType::get(firstSubElemType, firstSubArray->elements.size());
-        
-        size_t outerSize = node->elements.size();
-        llvm::ArrayType *arrayType = llvm::ArrayType::get(subArrayType, outerSize);
-        
-        // 在函数入口块分配数组
-        llvm::Function *function = builder->GetInsertBlock()->getParent();
-        llvm::IRBuilder<> tmpBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
-        llvm::AllocaInst *arrayAlloca = tmpBuilder.CreateAlloca(arrayType, nullptr, "multi_array");
-        
-        // 初始化每个子数组
-        for (size_t i = 0; i < outerSize; i++) {
-            auto subArrayNode = dynamic_cast<ArrayLiteralNode*>(node->elements[i].get());
-            if (!subArrayNode) {
-                reportError("Inconsistent array dimensions", node->lineNumber);
-                return nullptr;
-            }
-            
-            // 逐个复制子数组元素到目标位置
-            for (size_t j = 0; j < subArrayNode->elements.size(); j++) {
-                llvm::Value *elem = codegenExpr(subArrayNode->elements[j].get());
-                if (!elem) return nullptr;
-                
-                // 计算目标元素的位置：array[i][j]
-                std::vector<llvm::Value*> elemIndices;
-                elemIndices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-                elemIndices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, i)));
-                elemIndices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, j)));
-                llvm::Value *elemPtr = builder->CreateGEP(arrayType, arrayAlloca, elemIndices, "elem_ptr");
-                builder->CreateStore(elem, elemPtr);
-            }
-        }
-        
-        // 返回数组首元素指针
-        std::vector<llvm::Value*> indices;
-        indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-        indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-        return builder->CreateGEP(arrayType, arrayAlloca, indices, "array_ptr");
-        
-    } else {
-        // 一维数组：原有逻辑
-        llvm::Value *firstElem = codegenExpr(node->elements[0].get());
-        if (!firstElem) return nullptr;
-        
-        llvm::Type *elemType = firstElem->getType();
-        size_t arraySize = node->elements.size();
-        
-        llvm::ArrayType *arrayType = llvm::ArrayType::get(elemType, arraySize);
-        
-        llvm::Function *function = builder->GetInsertBlock()->getParent();
-        llvm::IRBuilder<> tmpBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
-        llvm::AllocaInst *arrayAlloca = tmpBuilder.CreateAlloca(arrayType, nullptr, "array_lit");
-        
-        for (size_t i = 0; i < arraySize; i++) {
-            llvm::Value *elem = (i == 0) ? firstElem : codegenExpr(node->elements[i].get());
-            if (!elem) return nullptr;
-            
-            std::vector<llvm::Value*> indices;
-            indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-            indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, i)));
-            
-            llvm::Value *elemPtr = builder->CreateGEP(arrayType, arrayAlloca, indices, "elem_ptr");
-            builder->CreateStore(elem, elemPtr);
-        }
-        
-        std::vector<llvm::Value*> indices;
-        indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-        indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-        return builder->CreateGEP(arrayType, arrayAlloca, indices, "array_ptr");
+    // 维度和元素类型由字面量决定：各维长度取第一个子数组的长度，元素类型取第一个元素的类型
+    std::vector<uint64_t> dimensions;
+    for (ArrayLiteralNode *level = node; level && !level->elements.empty();
+         level = dynamic_cast<ArrayLiteralNode *>(level->elements[0].get())) {
+        dimensions.push_back(level->elements.size());
+    }
+    std::vector<ArrayLiteralElement> elements;
+    if (!evaluateArrayLiteral(node, dimensions, 0, 0, elements)) {
+        return nullptr;
+    }
+    llvm::Type *arrayType = elements.empty() ? llvm::Type::getInt32Ty(*context) : elements[0].value->getType();
+    for (auto it = dimensions.rbegin(); it != dimensions.rend(); ++it) {
+        arrayType = llvm::ArrayType::get(arrayType, *it);
     }
+
+    bool allConstant = false;
+    llvm::Constant *constantPart =
+        arrayLiteralConstant(llvm::cast<llvm::ArrayType>(arrayType), elements, allConstant, node->lineNumber);
+    if (!constantPart) {
+        return nullptr;
+    }
+    // 字面量可能作为数组参数传给会修改它的函数，复制到栈上的临时数组
+    llvm::AllocaInst *arrayAlloca =
+        createEntryBlockAlloca(builder->GetInsertBlock()->getParent(), "array_lit", arrayType);
+    emitArrayLiteralInit(arrayAlloca, llvm::cast<llvm::ArrayType>(arrayType), constantPart, elements, "array_lit");
+    return arrayAlloca;
 }
 
 // 语句代码生成实现
@@ -2187,6 +3139,12 @@ void CodeGenerator::codegenVarDecl(VarDeclNode *node) {
         isArrayType = true;
     } else {
         // 普通类型
+        if (!checkVecType(node->type->typeName, node->lineNumber)) {
+            if (fn->function) {
+                fn->failedDeclarations.insert(node->name);
+            }
+            return;
+        }
         type = getType(node->type->typeName);
         if (!type) {
             reportError("Unknown type '" + node->type->typeName + "'", node->lineNumber);
@@ -2195,7 +3153,7 @@ void CodeGenerator::codegenVarDecl(VarDeclNode *node) {
     }
 
     // 检查是否在函数内
-    if (!currentFunction) {
+    if (!fn->function) {
         // 检查全局变量是否已定义
         if (globalValues.find(node->name) != globalValues.end()) {
             reportError("Global variable '" + node->name + "' is already defined", node->lineNumber);
@@ -2205,6 +3163,22 @@ void CodeGenerator::codegenVarDecl(VarDeclNode *node) {
         // 全局变量/常量：创建全局变量
         llvm::Constant *initVal = nullptr;
 
+        if (isArrayType && node->initializer && !dynamic_cast<ArrayLiteralNode *>(node->initializer.get())) {
+            reportError("Array initializer must be an array literal", node->lineNumber);
+            return;
+        }
+        if (node->initializer && (type->isVectorTy() || isArrayType)) {
+            // 向量的初始值在全局构造函数中求值（标量广播到所有元素）；
+            // 定长数组的字面量全为常量时在 emitGlobalArrayInit 中直接成为全局变量的初始值
+            auto globalVar = new llvm::GlobalVariable(
+                *module, type, node->isConst, llvm::GlobalValue::InternalLinkage,
+                llvm::Constant::getNullValue(type), node->name);
+            globalValues[node->name] = globalVar;
+            globalTypes[node->name] = node->type->typeName;
+            globalInitializers.push_back({globalVar, node->initializer.get(), node->type->typeName});
+            return;
+        }
+
         if (node->initializer) {
             // 对于全局变量，初始化器必须是常量表达式
             if (auto intLit =
@@ -2311,9 +3285,10 @@ void CodeGenerator::codegenVarDecl(VarDeclNode *node) {
                             *module, type, node->isConst, llvm::GlobalValue::InternalLinkage,
                             initVal, node->name);
                         globalValues[node->name] = globalVar;
+                        globalTypes[node->name] = node->type->typeName;
                         
                         // 添加到动态初始化列表
-                        globalInitializers.push_back({globalVar, node->initializer.get()});
+                        globalInitializers.push_back({globalVar, node->initializer.get(), node->type->typeName});
                         
                         if (g_verbose) {
                             std::cout << "[IR Gen] Global variable '" << node->name 
@@ -2357,9 +3332,10 @@ void CodeGenerator::codegenVarDecl(VarDeclNode *node) {
                     *module, type, node->isConst, llvm::GlobalValue::InternalLinkage,
                     initVal, node->name);
                 globalValues[node->name] = globalVar;
+                globalTypes[node->name] = node->type->typeName;
                 
                 // 添加到动态初始化列表
-                globalInitializers.push_back({globalVar, node->initializer.get()});
+                globalInitializers.push_back({globalVar, node->initializer.get(), node->type->typeName});
                 
                 if (g_verbose) {
                     std::cout << "[IR Gen] Global variable '" << node->name 
@@ -2376,102 +3352,95 @@ void CodeGenerator::codegenVarDecl(VarDeclNode *node) {
             *module, type, node->isConst, llvm::GlobalValue::InternalLinkage,
             initVal, node->name);
         globalValues[node->name] = globalVar;
+        globalTypes[node->name] = node->type->typeName;
         return;
     }
 
     // 检查局部变量是否已定义
-    if (namedValues.find(node->name) != namedValues.end()) {
+    if (fn->namedValues.find(node->name) != fn->namedValues.end() ||
+        fn->constArrays.find(node->name) != fn->constArrays.end()) {
         reportError("Local variable '" + node->name + "' is already defined in this scope", node->lineNumber);
         return;
     }
     
     // 检查是否遮蔽全局变量（-Wshadow）
-    if (g_enableShadowWarnings && globalValues.find(node->name) != globalValues.end()) {
+    if (currentDiagnostics().enableShadowWarnings && globalValues.find(node->name) != globalValues.end()) {
         reportWarning("Local variable '" + node->name + "' shadows a global variable", node->lineNumber);
     }
 
+    // 数组字面量初始化（支持多维）：先按书写顺序求值全部元素，再分为常量部分和需要运行时写入的元素
+    auto arrayLit = isArrayType ? dynamic_cast<ArrayLiteralNode *>(node->initializer.get()) : nullptr;
+    std::vector<ArrayLiteralElement> literalElements;
+    llvm::Constant *literalConstant = nullptr;
+    bool literalAllConstant = false;
+    if (arrayLit) {
+        std::vector<uint64_t> dimensions(node->type->arrayDimensions.begin(), node->type->arrayDimensions.end());
+        if (evaluateArrayLiteral(arrayLit, dimensions, 0, 0, literalElements)) {
+            literalConstant = arrayLiteralConstant(llvm::cast<llvm::ArrayType>(type), literalElements,
+                                                   literalAllConstant, node->lineNumber);
+        }
+        if (!literalConstant) {
+            // 记录声明失败的变量，抑制后续的"未定义变量"级联错误
+            fn->failedDeclarations.insert(node->name);
+            return;
+        }
+    }
+
+    // 元素全为常量的常量数组直接读取只读数据中的全局常量，不在栈上复制
+    if (arrayLit && node->isConst && literalAllConstant) {
+        auto constArray = new llvm::GlobalVariable(*module, type, true, llvm::GlobalValue::PrivateLinkage,
+                                                   literalConstant, node->name + ".const");
+        constArray->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        fn->constArrays[node->name] = constArray;
+        fn->localConstVariables.insert(node->name);
+        fn->declaredVariables[node->name] = node->lineNumber;
+        fn->variableTypes[node->name] = node->type->typeName;
+        if (g_verbose) {
+            std::cout << "[IR Gen] Constant array '" << node->name << "' is read in place from read-only data" << std::endl;
+        }
+        return;
+    }
+
     // 局部变量：创建 alloca
     llvm::AllocaInst *alloca =
-        createEntryBlockAlloca(currentFunction, node->name, type);
+        createEntryBlockAlloca(fn->function, node->name, type);
+    if (!isArrayType && isCountedType(node->type->typeName)) {
+        trackReferenceSlot(alloca, node->type->typeName);
+    }
 
     if (node->initializer) {
-        if (isArrayType && dynamic_cast<ArrayLiteralNode*>(node->initializer.get())) {
-            // 数组字面量初始化（支持多维）
-            auto arrayLit = dynamic_cast<ArrayLiteralNode*>(node->initializer.get());
-            llvm::ArrayType *arrType = llvm::cast<llvm::ArrayType>(type);
-            
-            // 检查数组大小是否匹配
-            size_t declaredSize = arrType->getNumElements();
-            size_t actualSize = arrayLit->elements.size();
-            if (actualSize > declaredSize) {
-                std::string msg = "Array size mismatch: declared size is " + std::to_string(declaredSize) +
-                                  " but initializer has " + std::to_string(actualSize) + " elements";
-                reportError(msg, node->lineNumber);
-                // 记录声明失败的变量，抑制后续的"未定义变量"级联错误
-                failedDeclarations.insert(node->name);
-                return;
-            }
-            
-            // 检查是否是嵌套数组
-            bool isNested = !arrayLit->elements.empty() && 
-                           dynamic_cast<ArrayLiteralNode*>(arrayLit->elements[0].get()) != nullptr;
-            
-            if (isNested) {
-                // 多维数组：使用辅助函数递归初始化
-                std::function<void(ArrayLiteralNode*, std::vector<llvm::Value*>)> initNestedArray;
-                
-                initNestedArray = [&](ArrayLiteralNode* arrLit, std::vector<llvm::Value*> currentIndices) {
-                    for (size_t i = 0; i < arrLit->elements.size(); i++) {
-                        std::vector<llvm::Value*> newIndices = currentIndices;
-                        newIndices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, i)));
-                        
-                        if (auto subArrayLit = dynamic_cast<ArrayLiteralNode*>(arrLit->elements[i].get())) {
-                            // 仍然是嵌套数组，继续递归
-                            initNestedArray(subArrayLit, newIndices);
-                        } else {
-                            // 到达最深层，存储元素
-                            llvm::Value *elem = codegenExpr(arrLit->elements[i].get());
-                            if (!elem) continue;
-                            
-                            // 计算完整索引：[0, i1, i2, ..., in]
-                            std::vector<llvm::Value*> fullIndices;
-                            fullIndices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-                            fullIndices.insert(fullIndices.end(), newIndices.begin(), newIndices.end());
-                            
-                            llvm::Value *elemPtr = builder->CreateGEP(arrType, alloca, fullIndices, "elem_ptr");
-                            builder->CreateStore(elem, elemPtr);
-                        }
-                    }
-                };
-                
-                // 开始递归初始化
-                std::vector<llvm::Value*> baseIndices;
-                initNestedArray(arrayLit, baseIndices);
-            } else {
-                // 一维数组：原有逻辑
-                for (size_t i = 0; i < arrayLit->elements.size() && i < arrType->getNumElements(); i++) {
-                    llvm::Value *elem = codegenExpr(arrayLit->elements[i].get());
-                    if (!elem) continue;
-                    
-                    std::vector<llvm::Value*> indices;
-                    indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-                    indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, i)));
-                    
-                    llvm::Value *elemPtr = builder->CreateGEP(arrType, alloca, indices, "arr_elem");
-                    builder->CreateStore(elem, elemPtr);
-                }
-            }
+        if (arrayLit) {
+            emitArrayLiteralInit(alloca, llvm::cast<llvm::ArrayType>(type), literalConstant, literalElements, node->name);
         } else {
             // 普通变量初始化
-            llvm::Value *initVal = codegenExpr(node->initializer.get());
+            llvm::Value *initVal = codegenTypedExpr(node->initializer.get(), node->type->typeName);
             if (initVal) {
                 // 编译时类型检查：检测类型不匹配错误
                 bool typeError = false;
                 std::string declaredTypeName = node->type->typeName;
                 llvm::Type *initType = initVal->getType();
+                bool literalOfDeclaredType =
+                    (dynamic_cast<MapLiteralNode *>(node->initializer.get()) && isMapType(declaredTypeName)) ||
+                    (dynamic_cast<ArrayLiteralNode *>(node->initializer.get()) && isListType(declaredTypeName));
+                std::string initTypeName = literalOfDeclaredType ? declaredTypeName : declaredTypeOf(node->initializer.get());
+                bool containerInvolved = isReferenceType(declaredTypeName) || isReferenceType(initTypeName);
                 
+                // 检查映射、动态数组与其他类型之间以及元素类型不同的容器之间的赋值
+                if (containerInvolved && initTypeName != declaredTypeName &&
+                    !(initTypeName.empty() && initType->isPointerTy())) {
+                    std::string sourceName = initTypeName.empty() ? typeNameOf(initType) : initTypeName;
+                    reportError("Type mismatch: cannot assign '" + sourceName + "' to '" + declaredTypeName + "'", node->lineNumber);
+                    typeError = true;
+                }
+                // 检查向量与标量、元素个数不同的向量之间的赋值（标量可以广播到向量）
+                else if ((initType->isVectorTy() || type->isVectorTy()) && initType != type &&
+                         !initType->isPointerTy() && !convertibleToVec(initType, type)) {
+                    reportError("Type mismatch: cannot assign '" + typeNameOf(initType) + "' to '" + declaredTypeName + "'",
+                                node->lineNumber);
+                    typeError = true;
+                }
                 // 检查字符串赋值给非字符串类型
-                if (initType->isPointerTy() && !type->isPointerTy()) {
+                else if (initType->isPointerTy() && !type->isPointerTy()) {
                     // 字符串（指针）赋值给整数/浮点等
                     reportError("Type mismatch: cannot assign string to '" + declaredTypeName + "'", node->lineNumber);
                     typeError = true;
@@ -2490,20 +3459,25 @@ void CodeGenerator::codegenVarDecl(VarDeclNode *node) {
                 
                 if (typeError) {
                     // 记录声明失败的变量，抑制后续的"未定义变量"错误
-                    failedDeclarations.insert(node->name);
+                    fn->failedDeclarations.insert(node->name);
                     return;
                 }
                 
                 if (initVal->getType() != type) {
                     initVal = convertToType(initVal, type);
                 }
-                builder->CreateStore(initVal, alloca);
+                initVal = copyBorrowedString(initVal, declaredTypeName);
+                if (isCountedType(declaredTypeName)) {
+                    storeReference(alloca, initVal, declaredTypeName);
+                } else {
+                    builder->CreateStore(initVal, alloca);
+                }
 
                 // 如果初始化值是临时内存，从临时栈中移除并跟踪所有权
                 if (initVal->getType()->isPointerTy()) {
                     // 检查是否是从临时内存转移所有权
-                    auto it = std::find(tempMemoryStack.begin(), tempMemoryStack.end(), initVal);
-                    if (it != tempMemoryStack.end()) {
+                    auto it = std::find(fn->tempMemoryStack.begin(), fn->tempMemoryStack.end(), initVal);
+                    if (it != fn->tempMemoryStack.end()) {
                         // 是临时内存，转移所有权给变量
                         removeTempMemory(initVal);
                         trackOwnedString(node->name, initVal);
@@ -2513,19 +3487,19 @@ void CodeGenerator::codegenVarDecl(VarDeclNode *node) {
         }
     }
 
-    namedValues[node->name] = alloca;
+    fn->namedValues[node->name] = alloca;
     
     // 跟踪局部常量变量
     if (node->isConst) {
-        localConstVariables.insert(node->name);
+        fn->localConstVariables.insert(node->name);
     }
     
     // 记录变量声明（用于未使用变量警告）
-    declaredVariables[node->name] = node->lineNumber;
+    fn->declaredVariables[node->name] = node->lineNumber;
 
     // 保存变量类型信息（用于数组访问）
     if (node->type) {
-        variableTypes[node->name] = node->type->typeName;
+        fn->variableTypes[node->name] = node->type->typeName;
     }
     
     // 清理变量声明中产生的临时内存
@@ -2539,8 +3513,69 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
 
     // 检查是否是数组元素赋值
     auto arrayAccess = dynamic_cast<ArrayAccessNode *>(node->target.get());
+    if (arrayAccess && isMapType(declaredTypeOf(arrayAccess->array.get()))) {
+        // 映射元素赋值: m[key] = value
+        codegenMapSet(node, declaredTypeOf(arrayAccess->array.get()));
+        return;
+    }
+    if (arrayAccess && isListType(declaredTypeOf(arrayAccess->array.get()))) {
+        // 动态数组元素赋值: list[index] = value
+        codegenListSet(node, declaredTypeOf(arrayAccess->array.get()));
+        return;
+    }
+    if (arrayAccess && isVecType(declaredTypeOf(arrayAccess->array.get()))) {
+        // 向量元素赋值: v[i] = value
+        codegenVecLaneSet(node, arrayAccess);
+        return;
+    }
+    llvm::Type *fixedArrayType = nullptr;
+    if (arrayAccess && fixedArrayOf(arrayAccess, fixedArrayType)) {
+        // 定长数组元素赋值（含多维）：越界时报告运行时错误，不写入
+        ExprNode *root = arrayAccess;
+        while (auto access = dynamic_cast<ArrayAccessNode *>(root)) {
+            root = access->array.get();
+        }
+        const std::string &arrayName = static_cast<IdentifierNode *>(root)->name;
+        auto global = globalValues.find(arrayName);
+        bool constGlobal = fn->namedValues.find(arrayName) == fn->namedValues.end() &&
+                           global != globalValues.end() && global->second->isConstant();
+        if (constGlobal || fn->localConstVariables.find(arrayName) != fn->localConstVariables.end()) {
+            reportError("Cannot reassign constant '" + arrayName + "'", node->lineNumber);
+            return;
+        }
+        if (fn->arrayParams.count(arrayName)) {
+            // 写入数组参数修改的是调用者的数组，视为使用了参数
+            fn->usedVariables.insert(arrayName);
+        }
+        llvm::Value *value = codegenExpr(node->value.get());
+        if (!value) {
+            reportError("Invalid assignment value for array element", node->lineNumber);
+            return;
+        }
+        llvm::Type *elementType = nullptr;
+        llvm::BasicBlock *errorBB = nullptr;
+        llvm::Value *ptr = emitFixedArrayElementPtr(arrayAccess, elementType, errorBB);
+        if (!ptr) {
+            return;
+        }
+        if (node->op != "=") {
+            llvm::Value *oldVal = builder->CreateLoad(elementType, ptr, "oldval");
+            value = applyCompoundAssign(node->op, oldVal, value);
+        }
+        if (value->getType() != elementType) {
+            value = convertToType(value, elementType);
+        }
+        builder->CreateStore(value, ptr);
+        llvm::BasicBlock *doneBB =
+            llvm::BasicBlock::Create(*context, "array_store_done", builder->GetInsertBlock()->getParent());
+        builder->CreateBr(doneBB);
+        builder->SetInsertPoint(errorBB);
+        builder->CreateBr(doneBB);
+        builder->SetInsertPoint(doneBB);
+        return;
+    }
     if (arrayAccess) {
-        // 处理数组元素赋值: arr[index] = value
+        // 处理数组参数和字符串的元素赋值: arr[index] = value
         llvm::Value *index = codegenExpr(arrayAccess->index.get());
         if (!index) {
             reportError("Invalid index in array assignment", node->lineNumber);
@@ -2556,8 +3591,8 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
             std::string arrayVarName = identNode->name;
             
             // 从符号表中查找
-            auto it = namedValues.find(arrayVarName);
-            if (it == namedValues.end()) {
+            auto it = fn->namedValues.find(arrayVarName);
+            if (it == fn->namedValues.end()) {
                 reportError("Undefined array variable '" + arrayVarName + "'", node->lineNumber);
                 return;
             }
@@ -2568,11 +3603,8 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
             if (auto allocaInst = llvm::dyn_cast<llvm::AllocaInst>(arrayPtr)) {
                 arrayType = allocaInst->getAllocatedType();
                 
-                // 判断是数组、数组参数还是字符串
-                if (arrayType->isArrayTy()) {
-                    llvm::ArrayType *arrType = llvm::cast<llvm::ArrayType>(arrayType);
-                    elementType = arrType->getElementType();
-                } else if (arrayType->isPointerTy()) {
+                // 判断是数组参数还是字符串
+                if (arrayType->isPointerTy()) {
                     // 数组参数（作为指针传递）
                     // 对于不透明指针，我们需要知道元素类型，暂时假设为 i32
                     // TODO: 需要更好的类型跟踪系统
@@ -2599,13 +3631,7 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
 
         // 创建GEP获取元素指针
         llvm::Value *ptr = nullptr;
-        if (arrayType && arrayType->isArrayTy()) {
-            // 数组类型：使用 GEP(array, 0, index)
-            std::vector<llvm::Value*> indices;
-            indices.push_back(llvm::ConstantInt::get(*context, llvm::APInt(64, 0)));
-            indices.push_back(index);
-            ptr = builder->CreateGEP(arrayType, arrayPtr, indices, "arrayptr");
-        } else if (arrayType && arrayType->isPointerTy()) {
+        if (arrayType && arrayType->isPointerTy()) {
             // 数组参数（指针类型）：需要先加载指针值，然后使用 GEP
             llvm::Value *loadedPtr = builder->CreateLoad(arrayType, arrayPtr, "loaded_ptr");
             ptr = builder->CreateGEP(elementType, loadedPtr, index, "arrayptr");
@@ -2618,51 +3644,7 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
         if (node->op != "=") {
             // 先加载当前值
             llvm::Value *oldVal = builder->CreateLoad(elementType, ptr, "oldval");
-            bool isFloat = oldVal->getType()->isDoubleTy();
-
-            // 类型匹配
-            if (value->getType() != oldVal->getType()) {
-                value = convertToType(value, oldVal->getType());
-            }
-
-            // 执行复合操作
-            if (node->op == "+=") {
-                value = isFloat
-                            ? builder->CreateFAdd(oldVal, value, "addassign")
-                            : builder->CreateAdd(oldVal, value, "addassign");
-            } else if (node->op == "-=") {
-                value = isFloat
-                            ? builder->CreateFSub(oldVal, value, "subassign")
-                            : builder->CreateSub(oldVal, value, "subassign");
-            } else if (node->op == "*=") {
-                value = isFloat
-                            ? builder->CreateFMul(oldVal, value, "mulassign")
-                            : builder->CreateMul(oldVal, value, "mulassign");
-            } else if (node->op == "/=") {
-                value = isFloat
-                            ? builder->CreateFDiv(oldVal, value, "divassign")
-                            : builder->CreateSDiv(oldVal, value, "divassign");
-            } else if (node->op == "//=") {
-                // 整除赋值：先转换为整数再执行整除
-                llvm::Value *leftInt = oldVal;
-                llvm::Value *rightInt = value;
-                if (oldVal->getType()->isDoubleTy()) {
-                    leftInt = builder->CreateFPToSI(
-                        oldVal, llvm::Type::getInt32Ty(*context),
-                        "floordiv_left");
-                }
-                if (value->getType()->isDoubleTy()) {
-                    rightInt = builder->CreateFPToSI(
-                        value, llvm::Type::getInt32Ty(*context),
-                        "floordiv_right");
-                }
-                value =
-                    builder->CreateSDiv(leftInt, rightInt, "floordivassign");
-            } else if (node->op == "%=") {
-                value = isFloat
-                            ? builder->CreateFRem(oldVal, value, "modassign")
-                            : builder->CreateSRem(oldVal, value, "modassign");
-            }
+            value = applyCompoundAssign(node->op, oldVal, value);
         }
 
         if (value->getType() != elementType) {
@@ -2682,10 +3664,10 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
     }
 
     // 先检查局部变量
-    llvm::AllocaInst *alloca = namedValues[ident->name];
+    llvm::AllocaInst *alloca = fn->namedValues[ident->name];
     
     // 检查是否是局部常量（不允许重新赋值）
-    if (alloca && localConstVariables.find(ident->name) != localConstVariables.end()) {
+    if (alloca && fn->localConstVariables.find(ident->name) != fn->localConstVariables.end()) {
         reportError("Cannot reassign constant '" + ident->name + "'", node->lineNumber);
         return;
     }
@@ -2704,8 +3686,14 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
             return;
         }
 
+        // 向量变量：逐元素运算后写回
+        if (auto *vecTy = llvm::dyn_cast<llvm::FixedVectorType>(globalVar->getValueType())) {
+            codegenVecAssign(node, globalVar, vecTy);
+            return;
+        }
+
         // 处理全局变量赋值
-        llvm::Value *value = codegenExpr(node->value.get());
+        llvm::Value *value = codegenTypedExpr(node->value.get(), declaredTypeOf(ident));
         if (!value) {
             reportError("Invalid assignment value for variable '" + ident->name + "'", node->lineNumber);
             return;
@@ -2939,17 +3927,28 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
             }
         }
 
-        builder->CreateStore(value, globalVar);
+        std::string globalType = declaredTypeOf(ident);
+        value = copyBorrowedString(value, globalType);
+        if (isCountedType(globalType)) {
+            storeReference(globalVar, value, globalType);
+        } else {
+            builder->CreateStore(value, globalVar);
+        }
 
         // 如果赋值的是临时内存，从临时栈中移除（转移所有权）
         if (value->getType()->isPointerTy()) {
             removeTempMemory(value);
         }
+        clearTempMemory();
         return;
     }
 
     // 处理局部变量赋值
-    llvm::Value *value = codegenExpr(node->value.get());
+    if (auto *vecTy = llvm::dyn_cast<llvm::FixedVectorType>(alloca->getAllocatedType())) {
+        codegenVecAssign(node, alloca, vecTy);
+        return;
+    }
+    llvm::Value *value = codegenTypedExpr(node->value.get(), declaredTypeOf(ident));
     if (!value) {
         std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Invalid assignment value for variable '" << ident->name << "'" << std::endl;
         return;
@@ -3172,14 +4171,20 @@ void CodeGenerator::codegenAssignment(AssignmentNode *node) {
         }
     }
 
-    builder->CreateStore(value, alloca);
+    std::string localType = declaredTypeOf(ident);
+    value = copyBorrowedString(value, localType);
+    if (isCountedType(localType)) {
+        storeReference(alloca, value, localType);
+    } else {
+        builder->CreateStore(value, alloca);
+    }
 
     // 如果赋值的是临时内存（如字符串拼接结果），从临时栈中移除并跟踪所有权
     // 因为现在变量拥有这块内存的所有权
     if (value->getType()->isPointerTy()) {
         // 检查是否是从临时内存转移所有权
-        auto it = std::find(tempMemoryStack.begin(), tempMemoryStack.end(), value);
-        if (it != tempMemoryStack.end()) {
+        auto it = std::find(fn->tempMemoryStack.begin(), fn->tempMemoryStack.end(), value);
+        if (it != fn->tempMemoryStack.end()) {
             // 是临时内存，转移所有权给变量
             removeTempMemory(value);
             trackOwnedString(ident->name, value);
@@ -3238,6 +4243,9 @@ void CodeGenerator::codegenIfStmt(IfStmtNode *node) {
             condVal, llvm::ConstantInt::get(condVal->getType(), 0), "ifcond");
     }
 
+    // 清理条件表达式求值产生的临时内存（两个分支都不再使用）
+    clearTempMemory();
+
     llvm::Function *function = builder->GetInsertBlock()->getParent();
     llvm::BasicBlock *thenBB =
         llvm::BasicBlock::Create(*context, "then", function);
@@ -3305,7 +4313,7 @@ void CodeGenerator::codegenWhileStmt(WhileStmtNode *node) {
     LoopContext loopCtx;
     loopCtx.continueBlock = condBB;  // continue 跳转到条件检查
     loopCtx.breakBlock = afterBB;    // break 跳转到循环后
-    loopContextStack.push_back(loopCtx);
+    fn->loopContextStack.push_back(loopCtx);
 
     builder->CreateBr(condBB);
     builder->SetInsertPoint(condBB);
@@ -3313,7 +4321,7 @@ void CodeGenerator::codegenWhileStmt(WhileStmtNode *node) {
     // 求值条件表达式
     llvm::Value *condVal = codegenExpr(node->condition.get());
     if (!condVal) {
-        loopContextStack.pop_back();
+        fn->loopContextStack.pop_back();
         return;
     }
 
@@ -3342,12 +4350,42 @@ void CodeGenerator::codegenWhileStmt(WhileStmtNode *node) {
 
     function->insert(function->end(), afterBB);
     builder->SetInsertPoint(afterBB);
+    attachLoopHints(node->annotations, node->lineNumber, condBB);
     
     // 弹出循环上下文
-    loopContextStack.pop_back();
+    fn->loopContextStack.pop_back();
 }
 
 void CodeGenerator::codegenForStmt(ForStmtNode *node) {
+    // for x in 容器
+    if (node->iterable) {
+        // for line in lines(path) / lines(f) / f.lines()
+        if (auto call = dynamic_cast<FunctionCallNode *>(node->iterable.get())) {
+            ExprNode *handle = nullptr;
+            size_t firstArg = 0;
+            if (call->functionName == "lines" && fileBuiltinCall(call, handle, firstArg)) {
+                codegenLinesForStmt(node, call);
+                return;
+            }
+            if (isGeneratorFunction(call->functionName)) {
+                codegenGeneratorForStmt(node, call);
+                return;
+            }
+        }
+        std::string containerType = declaredTypeOf(node->iterable.get());
+        if (isMapType(containerType)) {
+            codegenMapForStmt(node, containerType);
+        } else if (isListType(containerType)) {
+            codegenListForStmt(node, containerType);
+        } else if (isChanType(containerType)) {
+            codegenChannelForStmt(node, containerType);
+        } else {
+            std::string typeName = containerType.empty() ? "unknown" : containerType;
+            reportError("Cannot iterate over a value of type '" + typeName + "'", node->lineNumber);
+        }
+        return;
+    }
+
     if (g_verbose) {
         std::cout << "[IR Gen] For loop: " << node->variable << " in range"
                   << std::endl;
@@ -3356,13 +4394,13 @@ void CodeGenerator::codegenForStmt(ForStmtNode *node) {
     llvm::Function *function = builder->GetInsertBlock()->getParent();
 
     // 检查循环变量名是否与已存在的局部变量冲突（警告而非错误）
-    if (g_enableShadowWarnings && namedValues.find(node->variable) != namedValues.end()) {
+    if (currentDiagnostics().enableShadowWarnings && fn->namedValues.find(node->variable) != fn->namedValues.end()) {
         reportWarning("For loop variable '" + node->variable + "' shadows an existing local variable", node->lineNumber);
     }
 
     llvm::AllocaInst *loopVar = createEntryBlockAlloca(
         function, node->variable, llvm::Type::getInt32Ty(*context));
-    namedValues[node->variable] = loopVar;
+    fn->namedValues[node->variable] = loopVar;
 
     llvm::Value *startVal = codegenExpr(node->start.get());
     builder->CreateStore(startVal, loopVar);
@@ -3389,7 +4427,7 @@ void CodeGenerator::codegenForStmt(ForStmtNode *node) {
     LoopContext loopCtx;
     loopCtx.continueBlock = incrBB;  // continue 跳转到递增块
     loopCtx.breakBlock = afterBB;    // break 跳转到循环后
-    loopContextStack.push_back(loopCtx);
+    fn->loopContextStack.push_back(loopCtx);
 
     builder->CreateBr(condBB);
     builder->SetInsertPoint(condBB);
@@ -3427,12 +4465,13 @@ void CodeGenerator::codegenForStmt(ForStmtNode *node) {
 
     function->insert(function->end(), afterBB);
     builder->SetInsertPoint(afterBB);
+    attachLoopHints(node->annotations, node->lineNumber, condBB);
     
     // 弹出循环上下文
-    loopContextStack.pop_back();
+    fn->loopContextStack.pop_back();
 
     // 清理循环变量，使其作用域仅限于循环内
-    namedValues.erase(node->variable);
+    fn->namedValues.erase(node->variable);
 }
 
 void CodeGenerator::codegenReturnStmt(ReturnStmtNode *node) {
@@ -3440,15 +4479,34 @@ void CodeGenerator::codegenReturnStmt(ReturnStmtNode *node) {
         std::cout << "[IR Gen] Return statement" << std::endl;
     }
 
+    // 生成器中的 return 结束生成：销毁正在迭代的内层生成器后跳到最终挂起点
+    if (fn->generator.handle) {
+        if (node->value) {
+            reportError("Generator '" + fn->function->getName().str() +
+                        "' cannot return a value, use 'yield' to produce values", node->lineNumber);
+            return;
+        }
+        destroyActiveGenerators();
+        clearTempMemory();
+        builder->CreateBr(fn->generator.finalBlock);
+        return;
+    }
+
     if (node->value) {
-        llvm::Value *retVal = codegenExpr(node->value.get());
+        // 返回映射字面量时按函数声明的返回类型生成
+        std::string returnTypeName;
+        auto protoIt = fn->function ? functionPrototypes.find(fn->function->getName().str()) : functionPrototypes.end();
+        if (protoIt != functionPrototypes.end() && protoIt->second->returnType) {
+            returnTypeName = protoIt->second->returnType->typeName;
+        }
+        llvm::Value *retVal = codegenTypedExpr(node->value.get(), returnTypeName);
         if (!retVal) {
             reportError("Invalid return value", node->lineNumber);
             return;
         }
 
         // 获取当前函数的返回类型
-        llvm::Type *expectedRetType = currentFunction->getReturnType();
+        llvm::Type *expectedRetType = fn->function->getReturnType();
 
         // 检查返回类型是否匹配
         if (retVal->getType() != expectedRetType) {
@@ -3456,58 +4514,100 @@ void CodeGenerator::codegenReturnStmt(ReturnStmtNode *node) {
             if (expectedRetType->isVoidTy()) {
                 // 指向函数声明行，提示需要添加返回类型
                 reportError("Cannot return a value from void function '" + 
-                           currentFunction->getName().str() + "'", currentFunctionLineNumber);
+                           fn->function->getName().str() + "'", fn->lineNumber);
                 return;
             }
 
             llvm::Value *converted = convertToType(retVal, expectedRetType);
+            if (converted->getType() != expectedRetType &&
+                (expectedRetType->isVectorTy() || converted->getType()->isVectorTy())) {
+                reportError("Type mismatch: cannot return '" + typeNameOf(converted->getType()) +
+                            "' from function returning '" + typeNameOf(expectedRetType) + "'", node->lineNumber);
+                return;
+            }
             if (converted->getType() != expectedRetType) {
                 reportWarning("Return type mismatch in function", node->lineNumber);
             }
             retVal = converted;
         }
 
+        // 返回的动态数组和映射交给调用者：临时值直接转移，变量的值加一（函数出口释放变量持有的引用）
+        retVal = copyBorrowedString(retVal, returnTypeName);
+        if (isCountedType(returnTypeName)) {
+            ownReference(retVal, returnTypeName);
+        }
+
         // 如果返回值是临时内存，从临时栈中移除（转移所有权给调用者）
+        bool ownedResult = false;
         if (retVal->getType()->isPointerTy()) {
+            ownedResult = std::find(fn->tempMemoryStack.begin(), fn->tempMemoryStack.end(), retVal) !=
+                          fn->tempMemoryStack.end();
             removeTempMemory(retVal);
         }
         
         // 在返回前清理其他临时内存
         // 这对于提前返回的函数非常重要，防止内存泄漏
         clearTempMemory();
+
+        // 在生成器的 for 循环中返回：字符串可能属于生成器（如循环变量），销毁生成器前复制一份
+        if (!fn->activeGenerators.empty()) {
+            if (returnTypeName == "string" && !ownedResult) {
+                llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+                llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+                retVal = builder->CreateCall(strdupFunc, {retVal}, "result_copy");
+            }
+            destroyActiveGenerators();
+        }
         
         builder->CreateRet(retVal);
     } else {
         // 检查void返回是否匹配
-        if (currentFunction && !currentFunction->getReturnType()->isVoidTy()) {
+        if (fn->function && !fn->function->getReturnType()->isVoidTy()) {
             std::cerr << "Warning: Empty return in non-void function"
                       << std::endl;
         }
         
         // 即使是void返回，也要清理临时内存
         clearTempMemory();
+        destroyActiveGenerators();
         
         builder->CreateRetVoid();
     }
 }
 
 void CodeGenerator::codegenExprStmt(ExprStmtNode *node) {
-    codegenExpr(node->expression.get());
+    // 结果不被使用的 spawn 分离线程，不产生 future
+    if (auto spawn = dynamic_cast<SpawnNode *>(node->expression.get())) {
+        codegenSpawn(spawn, true);
+    } else {
+        codegenExpr(node->expression.get());
+    }
     // 清理表达式语句产生的临时内存
     clearTempMemory();
 }
 
-void CodeGenerator::codegenFunctionDecl(FunctionDeclNode *node) {
-    if (g_verbose) {
-        std::cout << "[IR Gen] Generating function: " << node->name << " -> "
-                  << (node->returnType ? node->returnType->typeName : "void")
-                  << std::endl;
+// 声明函数原型（不生成函数体）
+// 所有原型先于函数体声明，函数可以调用文件中后定义的函数，函数体之间也因此互不依赖
+llvm::Function *CodeGenerator::declareFunction(FunctionDeclNode *node) {
+    // 同一声明节点已经预先声明过原型
+    auto protoIt = functionPrototypes.find(node->name);
+    if (protoIt != functionPrototypes.end() && protoIt->second == node) {
+        return module->getFunction(node->name);
     }
 
     // 检查函数是否已定义
     if (module->getFunction(node->name)) {
         reportError("Function '" + node->name + "' is already defined", node->lineNumber);
-        return;
+        return nullptr;
+    }
+
+    // 向量类型的参数和返回值需要有效的元素类型和元素个数
+    bool validTypes = !node->returnType || checkVecType(node->returnType->typeName, node->lineNumber);
+    for (auto &param : node->parameters) {
+        validTypes = checkVecType(param->type->typeName, node->lineNumber) && validTypes;
+    }
+    if (!validTypes) {
+        return nullptr;
     }
 
     llvm::Type *retType = node->returnType ? getType(node->returnType->typeName)
@@ -3537,41 +4637,104 @@ void CodeGenerator::codegenFunctionDecl(FunctionDeclNode *node) {
         arg.setName(node->parameters[idx++]->name);
     }
 
+    functionPrototypes[node->name] = node;
+    functions[node->name] = function;
+    return function;
+}
+
+void CodeGenerator::codegenFunctionDecl(FunctionDeclNode *node) {
+    llvm::Function *function = declareFunction(node);
+    if (!function) {
+        return;
+    }
+    codegenFunctionBody(node, function);
+}
+
+// 生成函数体，所有函数级状态保存在独立的 FunctionContext 中
+void CodeGenerator::codegenFunctionBody(FunctionDeclNode *node, llvm::Function *function) {
+    if (g_verbose) {
+        std::cout << "[IR Gen] Generating function: " << node->name << " -> "
+                  << (node->returnType ? node->returnType->typeName : "void")
+                  << std::endl;
+    }
+
+    llvm::Type *retType = function->getReturnType();
+
+    // 保存外层插入点（函数声明可能出现在代码块中）
+    llvm::BasicBlock *prevInsertBlock = builder->GetInsertBlock();
+
     llvm::BasicBlock *entryBB =
         llvm::BasicBlock::Create(*context, "entry", function);
     builder->SetInsertPoint(entryBB);
 
-    llvm::Function *prevFunction = currentFunction;
-    int prevFunctionLineNumber = currentFunctionLineNumber;
-    currentFunction = function;
-    currentFunctionLineNumber = node->lineNumber;  // 存储函数声明行号
-    namedValues.clear();
-    variableTypes.clear(); // 清理类型信息，避免函数间类型污染
+    FunctionContext funcContext;
+    funcContext.function = function;
+    funcContext.lineNumber = node->lineNumber;  // 存储函数声明行号
+    FunctionContext *prevContext = fn;
+    fn = &funcContext;
+
+    // 函数体的浮点运算标志：全局选项加上函数的 @fastmath，函数结束后恢复外层的标志
+    llvm::FastMathFlags prevFastMathFlags = builder->getFastMathFlags();
+    builder->setFastMathFlags(functionFastMathFlags(node));
+
+    // 生成器：参数在 coro.begin 之后保存，跨越挂起点的参数和局部变量由 CoroSplit 放入协程帧
+    std::string returnTypeName = node->returnType ? node->returnType->typeName : "";
+    bool isGenerator = isGenType(returnTypeName);
+    if (isGenerator) {
+        emitGeneratorEntry(function, returnTypeName);
+    }
 
     // 为每个参数创建alloca并存储参数值
     std::vector<std::pair<std::string, int>> functionParams;  // 参数名和行号
+    size_t paramIndex = 0;
     for (auto &arg : function->args()) {
         llvm::Type *allocaType = arg.getType();
-        
-        // 对于数组参数（传递为指针），直接使用指针类型的alloca
-        // 不需要特殊处理，因为指针已经可以用于数组访问
-        
         std::string paramName = std::string(arg.getName());
+
+        // 数组参数（传递为指针）：alloca 保存指针，另外记录声明的数组类型，下标访问按各维长度检查边界
+        if (paramIndex < node->parameters.size() && !node->parameters[paramIndex]->type->arrayDimensions.empty()) {
+            const auto &paramDecl = node->parameters[paramIndex]->type;
+            if (llvm::Type *arrayType = getType(paramDecl->typeName)) {
+                for (auto dim = paramDecl->arrayDimensions.rbegin(); dim != paramDecl->arrayDimensions.rend(); ++dim) {
+                    arrayType = llvm::ArrayType::get(arrayType, *dim);
+                }
+                fn->arrayParams[paramName] = llvm::cast<llvm::ArrayType>(arrayType);
+            }
+        }
         
         // 检查参数是否遮蔽全局变量（-Wshadow）
-        if (g_enableShadowWarnings && globalValues.find(paramName) != globalValues.end()) {
+        if (currentDiagnostics().enableShadowWarnings && globalValues.find(paramName) != globalValues.end()) {
             reportWarning("Parameter '" + paramName + "' shadows a global variable", node->lineNumber);
         }
         
         llvm::AllocaInst *alloca = createEntryBlockAlloca(
             function, paramName, allocaType);
         builder->CreateStore(&arg, alloca);
-        namedValues[paramName] = alloca;
+        fn->namedValues[paramName] = alloca;
+
+        // 动态数组和映射参数持有一个引用：函数中可以给参数赋值，也可以把它返回
+        if (paramIndex < node->parameters.size() && node->parameters[paramIndex]->type->arrayDimensions.empty() &&
+            isCountedType(node->parameters[paramIndex]->type->typeName)) {
+            const std::string &paramType = node->parameters[paramIndex]->type->typeName;
+            trackReferenceSlot(alloca, paramType);
+            emitRetain(&arg, paramType);
+        }
+        
+        // 映射、动态数组、文件和字符串参数记录类型（用于下标访问、切片、len、has、push、文件操作和 for ... in）
+        if (paramIndex < node->parameters.size() && (isReferenceType(node->parameters[paramIndex]->type->typeName) ||
+                                                     node->parameters[paramIndex]->type->typeName == "string")) {
+            fn->variableTypes[paramName] = node->parameters[paramIndex]->type->typeName;
+        }
+        paramIndex++;
         
         // 记录参数用于未使用参数检查
         functionParams.push_back({paramName, node->lineNumber});
     }
 
+    if (isGenerator) {
+        emitGeneratorStart(node);
+    }
+
     if (node->body) {
         codegenBlock(node->body.get());
     }
@@ -3579,7 +4742,9 @@ void CodeGenerator::codegenFunctionDecl(FunctionDeclNode *node) {
     // 在函数结束前清理临时内存
     // 如果函数没有显式 return 语句，需要在这里清理临时内存
     bool hasExplicitReturn = builder->GetInsertBlock()->getTerminator() != nullptr;
-    if (!hasExplicitReturn) {
+    if (isGenerator) {
+        emitGeneratorFinish();
+    } else if (!hasExplicitReturn) {
         // 清理函数体执行过程中产生的临时内存
         clearTempMemory();
         
@@ -3592,31 +4757,33 @@ void CodeGenerator::codegenFunctionDecl(FunctionDeclNode *node) {
         }
     }
 
+    // 生成器的局部数组跨越挂起点时位于协程帧中，不在出口释放；生成器的动态数组和映射在清理块中释放
+    if (!isGenerator) {
+        releaseReferenceSlots(function);
+        moveLargeArraysToHeap(function);
+    }
     llvm::verifyFunction(*function, &llvm::errs());
     
     // 检查未使用的变量（在函数结束时）
-    for (const auto& decl : declaredVariables) {
-        if (usedVariables.find(decl.first) == usedVariables.end()) {
+    for (const auto& decl : fn->declaredVariables) {
+        if (fn->usedVariables.find(decl.first) == fn->usedVariables.end()) {
             reportWarning("Unused variable '" + decl.first + "'", decl.second);
         }
     }
     
     // 检查未使用的参数
     for (const auto& param : functionParams) {
-        if (usedVariables.find(param.first) == usedVariables.end()) {
+        if (fn->usedVariables.find(param.first) == fn->usedVariables.end()) {
             reportWarning("Unused parameter '" + param.first + "'", param.second);
         }
     }
     
-    // 清理函数级别的跟踪数据
-    declaredVariables.clear();
-    usedVariables.clear();
-    localConstVariables.clear();
-    failedDeclarations.clear();
-    
-    currentFunction = prevFunction;
-    currentFunctionLineNumber = prevFunctionLineNumber;  // 恢复之前函数的行号
-    functions[node->name] = function;
+    // 恢复外层上下文
+    fn = prevContext;
+    builder->setFastMathFlags(prevFastMathFlags);
+    if (prevInsertBlock) {
+        builder->SetInsertPoint(prevInsertBlock);
+    }
 }
 
 void CodeGenerator::codegenStmt(StmtNode *node) {
@@ -3629,11 +4796,13 @@ void CodeGenerator::codegenStmt(StmtNode *node) {
     else if (auto ifStmt = dynamic_cast<IfStmtNode *>(node))
         codegenIfStmt(ifStmt);
     else if (auto whileStmt = dynamic_cast<WhileStmtNode *>(node))
-        codegenWhileStmt(whileStmt);
+        codegenAnnotatedLoop(whileStmt, whileStmt->annotations);
     else if (auto forStmt = dynamic_cast<ForStmtNode *>(node))
-        codegenForStmt(forStmt);
+        codegenAnnotatedLoop(forStmt, forStmt->annotations);
     else if (auto returnStmt = dynamic_cast<ReturnStmtNode *>(node))
         codegenReturnStmt(returnStmt);
+    else if (auto yieldStmt = dynamic_cast<YieldStmtNode *>(node))
+        codegenYieldStmt(yieldStmt);
     else if (auto breakStmt = dynamic_cast<BreakStmtNode *>(node))
         codegenBreakStmt(breakStmt);
     else if (auto continueStmt = dynamic_cast<ContinueStmtNode *>(node))
@@ -3750,6 +4919,11 @@ llvm::Value *CodeGenerator::convertToType(llvm::Value *value,
         }
         return value;
     }
+
+    // 7. SIMD 向量：标量广播到所有元素，元素个数相同的向量逐元素转换
+    if (convertibleToVec(sourceType, targetType)) {
+        return convertToVec(value, llvm::cast<llvm::FixedVectorType>(targetType));
+    }
     
     // 默认：无法转换，返回原值
     return value;
@@ -3857,6 +5031,10 @@ llvm::Value *CodeGenerator::convertToString(llvm::Value *value) {
 llvm::Value *CodeGenerator::createDivisionWithZeroCheck(llvm::Value *left, llvm::Value *right,
                                                         const std::string &errorMsg,
                                                         bool isIntegerDivision) {
+    if (omitRuntimeCheck()) {
+        return isIntegerDivision ? builder->CreateSDiv(left, right, "div_result")
+                                 : builder->CreateFDiv(left, right, "div_result");
+    }
     llvm::Function *function = builder->GetInsertBlock()->getParent();
     llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "div_error", function);
     llvm::BasicBlock *computeBB = llvm::BasicBlock::Create(*context, "div_compute", function);
@@ -3930,6 +5108,10 @@ llvm::Value *CodeGenerator::createDivisionWithZeroCheck(llvm::Value *left, llvm:
 // 除零检查辅助函数 - 取模
 llvm::Value *CodeGenerator::createModuloWithZeroCheck(llvm::Value *left, llvm::Value *right,
                                                       const std::string &errorMsg) {
+    if (omitRuntimeCheck()) {
+        return right->getType()->isDoubleTy() ? builder->CreateFRem(left, right, "mod_result")
+                                              : builder->CreateSRem(left, right, "mod_result");
+    }
     llvm::Function *function = builder->GetInsertBlock()->getParent();
     llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "mod_error", function);
     llvm::BasicBlock *computeBB = llvm::BasicBlock::Create(*context, "mod_compute", function);
@@ -3998,149 +5180,8428 @@ llvm::Value *CodeGenerator::createModuloWithZeroCheck(llvm::Value *left, llvm::V
     }
 }
 
-// 创建全局构造函数来初始化需要动态初始化的全局变量
-void CodeGenerator::createGlobalConstructor() {
-    // 如果没有需要动态初始化的全局变量，直接返回
-    if (globalInitializers.empty()) {
-        return;
-    }
-    
-    if (g_verbose) {
-        std::cout << "[IR Gen] Creating global constructor for " 
-                  << globalInitializers.size() << " dynamic initializers" << std::endl;
-    }
-    
-    // 创建全局构造函数类型: void ()
-    llvm::FunctionType *ctorType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), false);
-    
-    // 创建全局构造函数
-    llvm::Function *ctor = llvm::Function::Create(
-        ctorType, llvm::Function::InternalLinkage,
-        "__global_init", module.get());
-    
-    // 创建基本块
-    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", ctor);
-    builder->SetInsertPoint(entryBB);
-    
-    // 保存当前函数上下文
-    llvm::Function *savedFunction = currentFunction;
-    currentFunction = ctor;
-    
-    // 为每个需要动态初始化的全局变量生成初始化代码
-    for (const auto &init : globalInitializers) {
-        // 生成初始化表达式的代码
-        llvm::Value *initValue = codegenExpr(init.initializer);
-        
-        if (initValue) {
-            // 存储到全局变量
-            builder->CreateStore(initValue, init.variable);
-            
-            if (g_verbose) {
-                std::cout << "[IR Gen] Initialized global variable dynamically" << std::endl;
-            }
-        } else {
-            std::cerr << "Warning: Failed to generate initializer for global variable" 
-                      << std::endl;
-        }
-        
-        // 清理初始化过程中产生的临时内存
-        clearTempMemory();
-    }
-    
-    // 恢复函数上下文
-    currentFunction = savedFunction;
-    
-    // 返回
-    builder->CreateRetVoid();
-    
-    // 将全局构造函数注册到 llvm.global_ctors
-    // llvm.global_ctors 是一个特殊的全局数组，包含程序启动时要调用的函数
-    llvm::Type *i32Type = llvm::Type::getInt32Ty(*context);
-    llvm::PointerType *voidFuncPtrType = llvm::PointerType::get(*context, 0);
-    llvm::PointerType *i8PtrType = llvm::PointerType::get(*context, 0);
-    
-    // 结构体类型: { i32, void ()*, i8* }
-    llvm::StructType *ctorStructType = llvm::StructType::get(
-        i32Type, voidFuncPtrType, i8PtrType);
-    
-    // 创建构造函数数组元素: { 65535, @__global_init, null }
-    // 优先级 65535 表示在所有用户代码之前运行
-    llvm::Constant *ctorStruct = llvm::ConstantStruct::get(
-        ctorStructType,
-        llvm::ConstantInt::get(i32Type, 65535),  // 优先级
-        ctor,                                     // 构造函数指针
-        llvm::Constant::getNullValue(i8PtrType)  // 关联数据（null）
-    );
-    
-    // 创建全局数组: [@__global_init]
-    llvm::ArrayType *ctorArrayType = llvm::ArrayType::get(ctorStructType, 1);
-    llvm::Constant *ctorArray = llvm::ConstantArray::get(
-        ctorArrayType, {ctorStruct});
-    
-    // 创建 llvm.global_ctors 全局变量
-    new llvm::GlobalVariable(
-        *module,
-        ctorArrayType,
-        false,  // 不是常量
-        llvm::GlobalValue::AppendingLinkage,  // 使用 appending linkage
-        ctorArray,
-        "llvm.global_ctors"
-    );
-    
-    if (g_verbose) {
-        std::cout << "[IR Gen] Global constructor registered" << std::endl;
+// 复合赋值（+=、-=、*=、/=、//=、%=）：value 先转换为 oldVal 的类型
+llvm::Value *CodeGenerator::applyCompoundAssign(const std::string &op, llvm::Value *oldVal,
+                                                llvm::Value *value) {
+    bool isFloat = oldVal->getType()->isDoubleTy();
+
+    // 类型匹配
+    if (value->getType() != oldVal->getType()) {
+        value = convertToType(value, oldVal->getType());
+    }
+
+    if (op == "+=") {
+        return isFloat ? builder->CreateFAdd(oldVal, value, "addassign")
+                       : builder->CreateAdd(oldVal, value, "addassign");
+    } else if (op == "-=") {
+        return isFloat ? builder->CreateFSub(oldVal, value, "subassign")
+                       : builder->CreateSub(oldVal, value, "subassign");
+    } else if (op == "*=") {
+        return isFloat ? builder->CreateFMul(oldVal, value, "mulassign")
+                       : builder->CreateMul(oldVal, value, "mulassign");
+    } else if (op == "/=") {
+        return isFloat ? builder->CreateFDiv(oldVal, value, "divassign")
+                       : builder->CreateSDiv(oldVal, value, "divassign");
+    } else if (op == "//=") {
+        // 整除赋值：先转换为整数再执行整除
+        llvm::Value *leftInt = oldVal;
+        llvm::Value *rightInt = value;
+        if (oldVal->getType()->isDoubleTy()) {
+            leftInt = builder->CreateFPToSI(oldVal, llvm::Type::getInt32Ty(*context), "floordiv_left");
+        }
+        if (value->getType()->isDoubleTy()) {
+            rightInt = builder->CreateFPToSI(value, llvm::Type::getInt32Ty(*context), "floordiv_right");
+        }
+        return builder->CreateSDiv(leftInt, rightInt, "floordivassign");
+    } else if (op == "%=") {
+        return isFloat ? builder->CreateFRem(oldVal, value, "modassign")
+                       : builder->CreateSRem(oldVal, value, "modassign");
     }
+    return value;
 }
 
-// 代码生成主入口
-bool CodeGenerator::generate(ProgramNode *root) {
-    if (!root)
-        return false;
-
-    for (auto &stmt : root->statements) {
-        codegenStmt(stmt.get());
-    }
-    
-    // 创建全局构造函数（如果有需要动态初始化的全局变量）
-    createGlobalConstructor();
-    
-    // 检查是否存在main函数
-    if (!module->getFunction("main")) {
-        // 使用文件最后一行作为错误位置，便于显示代码上下文
-        int lastLine = static_cast<int>(g_sourceLines.size());
-        reportError("No 'main' function defined - program needs an entry point", lastLine > 0 ? lastLine : 1);
-    }
-
-    // 检查是否有编译错误
-    if (hasErrors()) {
-        std::cerr << "\nLLVM IR generation failed with " << g_errorCount << " error(s)";
-        if (g_warningCount > 0) {
-            std::cerr << " and " << g_warningCount << " warning(s)";
-        }
-        std::cerr << std::endl;
-        return false;
-    }
+// 原子读写 i64（通道的位置、序号和关闭标志，动态数组和映射的引用计数）
+static llvm::Value *createAtomicLoad(llvm::IRBuilder<> &builder, llvm::Value *ptr, llvm::AtomicOrdering ordering,
+                                     const std::string &name) {
+    llvm::LoadInst *load = builder.CreateAlignedLoad(builder.getInt64Ty(), ptr, llvm::MaybeAlign(8), name);
+    load->setAtomic(ordering);
+    return load;
+}
 
-    // 显示警告统计（如果有）
-    if (g_warningCount > 0) {
-        std::cerr << "LLVM IR generated with " << g_warningCount << " warning(s)" << std::endl;
-    }
+static void createAtomicStore(llvm::IRBuilder<> &builder, llvm::Value *value, llvm::Value *ptr,
+                              llvm::AtomicOrdering ordering) {
+    llvm::StoreInst *store = builder.CreateAlignedStore(value, ptr, llvm::MaybeAlign(8));
+    store->setAtomic(ordering);
+}
 
-    std::string errorStr;
-    llvm::raw_string_ostream errorStream(errorStr);
-    if (llvm::verifyModule(*module, &errorStream)) {
-        std::cerr << "Module verification failed:" << std::endl
-                  << errorStr << std::endl;
-        return false;
-    }
+// 引用计数加上 delta，返回修改前的值（解释器不支持 atomicrmw，使用 cmpxchg 循环）。
+// 之后的代码生成在新的基本块中
+static llvm::Value *createCounterUpdate(llvm::IRBuilder<> &builder, llvm::Value *counter, int64_t delta,
+                                        llvm::AtomicOrdering ordering) {
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::Type *i64 = builder.getInt64Ty();
+    llvm::BasicBlock *loadBB = builder.GetInsertBlock();
+    llvm::BasicBlock *retryBB = llvm::BasicBlock::Create(builder.getContext(), "retry", function);
+    llvm::BasicBlock *updatedBB = llvm::BasicBlock::Create(builder.getContext(), "updated", function);
+    llvm::Value *initial = createAtomicLoad(builder, counter, llvm::AtomicOrdering::Monotonic, "refs");
+    builder.CreateBr(retryBB);
+
+    builder.SetInsertPoint(retryBB);
+    llvm::PHINode *refs = builder.CreatePHI(i64, 2, "expected");
+    refs->addIncoming(initial, loadBB);
+    llvm::Value *exchange = builder.CreateAtomicCmpXchg(counter, refs, builder.CreateAdd(refs, llvm::ConstantInt::get(i64, delta, true)),
+                                                        llvm::MaybeAlign(8), ordering, llvm::AtomicOrdering::Monotonic);
+    refs->addIncoming(builder.CreateExtractValue(exchange, 0, "current"), retryBB);
+    builder.CreateCondBr(builder.CreateExtractValue(exchange, 1, "updated"), updatedBB, retryBB);
+
+    builder.SetInsertPoint(updatedBB);
+    return refs;
+}
 
-    return true;
+// 映射类型 map<K,V>
+//
+// 映射的运行时以 IR 函数的形式按需生成到使用它的模块中（linkonce_odr：并行生成的模块、
+// 交互式模式的增量模块可以各自定义，由链接器/JIT 合并），不依赖额外的运行时库，
+// -interp 解释器也可以直接执行。
+//
+// 哈希表采用 Swiss table 风格的开放寻址：
+// - 头部 { ctrl, keys, values, hashes, size, capacity, growthLeft, valueSize }，映射值是指向头部的指针
+// - ctrl 每个槽一个控制字节：最高位为 1 表示空槽，否则低 7 位保存哈希值的低 7 位（H2）
+// - 槽按 8 个一组探测（起始组由哈希值的高位 H1 决定）：一次读取一组的 8 个控制字节（<8 x i8>），
+//   用一条向量比较找出组内 H2 相同的槽（x86-64 上为 pcmpeqb + pmovmskb），只对这些槽比较键；
+//   组内有空槽时探测结束。-interp 逐元素执行同样的比较
+// - 组按三角数序列探测（g, g+1, g+3, g+6, ...），容量为 2 的幂时可以访问到所有组
+// - 字符串键保存完整的哈希值：查找时先比较哈希值再 strcmp，扩容时不重新计算哈希
+// - 负载因子上限为 7/8，growthLeft 为 0 时容量翻倍并重新插入所有键
+// 映射不支持删除键，按引用传递，与动态数组一样由引用计数管理（见“引用计数”）
+
+bool CodeGenerator::isMapType(const std::string &typeName) {
+    return typeName.rfind("map<", 0) == 0;
 }
 
-// 输出接口
+std::string CodeGenerator::mapKeyType(const std::string &mapType) {
+    size_t comma = mapType.find(',');
+    return mapType.substr(4, comma - 4);
+}
 
-void CodeGenerator::printIR() { module->print(llvm::outs(), nullptr); }
+std::string CodeGenerator::mapValueType(const std::string &mapType) {
+    size_t comma = mapType.find(',');
+    return mapType.substr(comma + 1, mapType.size() - comma - 2);
+}
+
+// 表达式的声明类型名：变量取声明时的类型，函数调用取原型的返回类型，无法确定时返回空
+std::string CodeGenerator::declaredTypeOf(ExprNode *node) {
+    if (auto ident = dynamic_cast<IdentifierNode *>(node)) {
+        auto local = fn->namedValues.find(ident->name);
+        if ((local != fn->namedValues.end() && local->second) || fn->constArrays.count(ident->name)) {
+            auto typeIt = fn->variableTypes.find(ident->name);
+            return typeIt != fn->variableTypes.end() ? typeIt->second : "";
+        }
+        auto globalIt = globalTypes.find(ident->name);
+        return globalIt != globalTypes.end() ? globalIt->second : "";
+    }
+    if (auto call = dynamic_cast<FunctionCallNode *>(node)) {
+        ExprNode *subject = nullptr;
+        size_t firstArg = 0;
+        if (stringBuiltinCall(call, subject, firstArg)) {
+            return stringBuiltinType(call->functionName);
+        }
+        if (threadBuiltinCall(call, subject, firstArg)) {
+            return threadBuiltinType(call, subject);
+        }
+        if (simdBuiltinCall(call, subject, firstArg)) {
+            return simdBuiltinType(call, subject);
+        }
+        if (fileBuiltinCall(call, subject, firstArg)) {
+            return fileBuiltinType(call->functionName);
+        }
+        if (arrayBuiltinCall(call, subject, firstArg)) {
+            return arrayBuiltinType(call, subject);
+        }
+        if (inputBuiltinCall(call)) {
+            return inputBuiltinType(call->functionName);
+        }
+        auto protoIt = functionPrototypes.find(call->functionName);
+        if (!call->object && protoIt != functionPrototypes.end() && protoIt->second->returnType) {
+            return protoIt->second->returnType->typeName;
+        }
+        return "";
+    }
+    if (auto slice = dynamic_cast<SliceNode *>(node)) {
+        std::string objectType = declaredTypeOf(slice->object.get());
+        return isListType(objectType) || objectType == "string" ? objectType : "";
+    }
+    if (auto spawn = dynamic_cast<SpawnNode *>(node)) {
+        auto protoIt = functionPrototypes.find(spawn->call->functionName);
+        if (protoIt == functionPrototypes.end()) {
+            return "";
+        }
+        FunctionDeclNode *decl = protoIt->second;
+        return "future<" + (decl->returnType ? decl->returnType->typeName : std::string("void")) + ">";
+    }
+    if (auto channel = dynamic_cast<ChannelNode *>(node)) {
+        return "chan<" + channel->elementType + ">";
+    }
+    if (auto vec = dynamic_cast<VecNode *>(node)) {
+        return vec->typeName();
+    }
+    if (auto unary = dynamic_cast<UnaryOpNode *>(node)) {
+        std::string operandType = declaredTypeOf(unary->operand.get());
+        return unary->op == "-" && isVecType(operandType) ? operandType : "";
+    }
+    if (auto binary = dynamic_cast<BinaryOpNode *>(node)) {
+        // 向量运算的结果类型（另一侧为 double 标量时的提升只能在生成代码时确定）
+        std::string leftType = declaredTypeOf(binary->left.get());
+        std::string rightType = declaredTypeOf(binary->right.get());
+        if (!isVecType(leftType) && !isVecType(rightType)) {
+            return "";
+        }
+        const std::string &op = binary->op;
+        if (op == "==" || op == "!=") {
+            return "bool";
+        }
+        std::string vecType = isVecType(leftType) ? leftType : rightType;
+        std::string lanes = std::to_string(vecLaneCount(vecType));
+        if (op == "/" || (isVecType(leftType) && isVecType(rightType) && leftType != rightType)) {
+            return "vec<double," + lanes + ">";
+        }
+        return op == "//" ? "vec<int," + lanes + ">" : vecType;
+    }
+    if (dynamic_cast<StringLiteralNode *>(node) || dynamic_cast<InterpolatedStringNode *>(node)) {
+        return "string";
+    }
+    return "";
+}
+
+llvm::StructType *CodeGenerator::getMapStructType() {
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    return llvm::StructType::get(*context, {ptrTy, ptrTy, ptrTy, ptrTy, i64, i64, i64, i64, i64});
+}
+
+// 读取一组 8 个控制字节（<8 x i8>，组按 8 字节对齐）
+llvm::Value *CodeGenerator::emitMapLoadGroup(llvm::Value *ctrl, llvm::Value *base) {
+    llvm::Type *groupTy = llvm::FixedVectorType::get(builder->getInt8Ty(), 8);
+    return builder->CreateAlignedLoad(groupTy, builder->CreateGEP(builder->getInt8Ty(), ctrl, base),
+                                      llvm::MaybeAlign(8), "ctrl_group");
+}
+
+// 逐字节比较的结果压缩为位掩码：第 k 位对应组内第 k 个槽
+llvm::Value *CodeGenerator::emitMapGroupMask(llvm::Value *matches) {
+    llvm::Value *bits = builder->CreateBitCast(matches, builder->getInt8Ty());
+    return builder->CreateZExt(bits, builder->getInt64Ty(), "group_mask");
+}
+
+// 组内控制字节等于 H2 的槽（空槽的最高位为 1，不会与 H2 相等）
+llvm::Value *CodeGenerator::emitMapGroupMatch(llvm::Value *group, llvm::Value *h2) {
+    llvm::Value *pattern = builder->CreateVectorSplat(8, builder->CreateTrunc(h2, builder->getInt8Ty()), "h2_pattern");
+    return emitMapGroupMask(builder->CreateICmpEQ(group, pattern, "h2_match"));
+}
+
+// 组内的空槽：控制字节的最高位为 1（作为有符号数小于 0）
+llvm::Value *CodeGenerator::emitMapGroupEmpty(llvm::Value *group) {
+    llvm::Value *zero = llvm::Constant::getNullValue(group->getType());
+    return emitMapGroupMask(builder->CreateICmpSLT(group, zero, "empty_match"));
+}
+
+// 掩码中最低的置位对应的槽在组内的序号（掩码不为 0）
+llvm::Value *CodeGenerator::emitMapFirstSlot(llvm::Value *mask) {
+    llvm::Function *cttz = llvm::Intrinsic::getOrInsertDeclaration(module.get(), llvm::Intrinsic::cttz, {builder->getInt64Ty()});
+    return builder->CreateCall(cttz, {mask, builder->getTrue()}, "slot_index");
+}
+
+// ptr __ppx_map_new(i64 keySize, i64 valueSize, i64 capacity, i1 hashed)
+llvm::Function *CodeGenerator::getMapNewFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_map_new")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *i1 = llvm::Type::getInt1Ty(*context);
+    llvm::StructType *mapTy = getMapStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_map_new", llvm::FunctionType::get(ptrTy, {i64, i64, i64, i1}, false));
+    auto args = function->arg_begin();
+    llvm::Value *keySize = &*args++;
+    llvm::Value *valueSize = &*args++;
+    llvm::Value *capacity = &*args++;
+    llvm::Value *hashed = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *hashesBB = llvm::BasicBlock::Create(*context, "alloc_hashes", function);
+    llvm::BasicBlock *initBB = llvm::BasicBlock::Create(*context, "init", function);
+    llvm::FunctionCallee callocFunc = module->getOrInsertFunction("calloc", ptrTy, i64, i64);
+    llvm::Function *mallocFunc = module->getFunction("malloc");
+
+    builder->SetInsertPoint(entryBB);
+    uint64_t headerSize = module->getDataLayout().getTypeAllocSize(mapTy);
+    llvm::Value *map = builder->CreateCall(mallocFunc, {llvm::ConstantInt::get(i64, headerSize)}, "map");
+    llvm::Value *ctrl = builder->CreateCall(mallocFunc, {capacity}, "ctrl");
+    builder->CreateMemSet(ctrl, builder->getInt8(MAP_CTRL_EMPTY), capacity, llvm::MaybeAlign(1));
+    llvm::Value *keys = builder->CreateCall(callocFunc, {capacity, keySize}, "keys");
+    llvm::Value *values = builder->CreateCall(callocFunc, {capacity, valueSize}, "values");
+    builder->CreateCondBr(hashed, hashesBB, initBB);
+
+    builder->SetInsertPoint(hashesBB);
+    llvm::Value *hashArray = builder->CreateCall(callocFunc, {capacity, llvm::ConstantInt::get(i64, 8)}, "hashes");
+    builder->CreateBr(initBB);
+
+    builder->SetInsertPoint(initBB);
+    llvm::PHINode *hashes = builder->CreatePHI(ptrTy, 2, "hashes");
+    hashes->addIncoming(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptrTy)), entryBB);
+    hashes->addIncoming(hashArray, hashesBB);
+    llvm::Value *growthLeft = builder->CreateSub(capacity, builder->CreateLShr(capacity, 3), "growth_left");
+    builder->CreateStore(ctrl, builder->CreateStructGEP(mapTy, map, MAP_CTRL));
+    builder->CreateStore(keys, builder->CreateStructGEP(mapTy, map, MAP_KEYS));
+    builder->CreateStore(values, builder->CreateStructGEP(mapTy, map, MAP_VALUES));
+    builder->CreateStore(hashes, builder->CreateStructGEP(mapTy, map, MAP_HASHES));
+    builder->CreateStore(llvm::ConstantInt::get(i64, 0), builder->CreateStructGEP(mapTy, map, MAP_SIZE));
+    builder->CreateStore(capacity, builder->CreateStructGEP(mapTy, map, MAP_CAPACITY));
+    builder->CreateStore(growthLeft, builder->CreateStructGEP(mapTy, map, MAP_GROWTH_LEFT));
+    builder->CreateStore(valueSize, builder->CreateStructGEP(mapTy, map, MAP_VALUE_SIZE));
+    builder->CreateStore(llvm::ConstantInt::get(i64, 1), builder->CreateStructGEP(mapTy, map, MAP_REFS));
+    builder->CreateRet(map);
+    return function;
+}
+
+// i64 __ppx_map_empty_slot(ptr map, i64 hash)：按哈希值的探测序列找到第一个空槽
+llvm::Function *CodeGenerator::getMapEmptySlotFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_map_empty_slot")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *mapTy = getMapStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_map_empty_slot", llvm::FunctionType::get(i64, {ptrTy, i64}, false));
+    llvm::Value *map = function->getArg(0);
+    llvm::Value *hash = function->getArg(1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *probeBB = llvm::BasicBlock::Create(*context, "probe", function);
+    llvm::BasicBlock *foundBB = llvm::BasicBlock::Create(*context, "found", function);
+    llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*context, "next_group", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *ctrl = builder->CreateLoad(ptrTy, builder->CreateStructGEP(mapTy, map, MAP_CTRL), "ctrl");
+    llvm::Value *capacity = builder->CreateLoad(i64, builder->CreateStructGEP(mapTy, map, MAP_CAPACITY), "capacity");
+    llvm::Value *groupMask = builder->CreateSub(builder->CreateLShr(capacity, 3), llvm::ConstantInt::get(i64, 1), "group_mask");
+    llvm::Value *firstGroup = builder->CreateAnd(builder->CreateLShr(hash, 7), groupMask, "first_group");
+    builder->CreateBr(probeBB);
+
+    builder->SetInsertPoint(probeBB);
+    llvm::PHINode *group = builder->CreatePHI(i64, 2, "group");
+    llvm::PHINode *step = builder->CreatePHI(i64, 2, "step");
+    llvm::Value *base = builder->CreateShl(group, 3, "group_base");
+    llvm::Value *empty = emitMapGroupEmpty(emitMapLoadGroup(ctrl, base));
+    builder->CreateCondBr(builder->CreateICmpNE(empty, llvm::ConstantInt::get(i64, 0)), foundBB, nextBB);
+
+    builder->SetInsertPoint(foundBB);
+    builder->CreateRet(builder->CreateAdd(base, emitMapFirstSlot(empty), "slot"));
+
+    builder->SetInsertPoint(nextBB);
+    llvm::Value *nextStep = builder->CreateAdd(step, llvm::ConstantInt::get(i64, 1), "next_step");
+    llvm::Value *nextGroup = builder->CreateAnd(builder->CreateAdd(group, nextStep), groupMask, "next_group");
+    builder->CreateBr(probeBB);
+
+    group->addIncoming(firstGroup, entryBB);
+    group->addIncoming(nextGroup, nextBB);
+    step->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    step->addIncoming(nextStep, nextBB);
+    return function;
+}
+
+// i64 __ppx_map_hash.K(K key)：整数类键直接混合，double 先把 -0.0 规范为 0.0，字符串使用 FNV-1a
+llvm::Function *CodeGenerator::getMapHashFunction(const std::string &keyType) {
+    std::string name = "__ppx_map_hash." + keyType;
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *keyTy = getType(keyType);
+    llvm::Function *function = createRuntimeFunction(module.get(), name, llvm::FunctionType::get(i64, {keyTy}, false));
+    llvm::Value *key = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    builder->SetInsertPoint(entryBB);
+
+    llvm::Value *bits = nullptr;
+    if (keyType == "string") {
+        llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "fnv_loop", function);
+        llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "fnv_body", function);
+        llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "fnv_done", function);
+        builder->CreateBr(loopBB);
+
+        builder->SetInsertPoint(loopBB);
+        llvm::PHINode *hash = builder->CreatePHI(i64, 2, "fnv");
+        llvm::PHINode *index = builder->CreatePHI(i64, 2, "index");
+        llvm::Value *c = builder->CreateLoad(builder->getInt8Ty(), builder->CreateGEP(builder->getInt8Ty(), key, index), "c");
+        builder->CreateCondBr(builder->CreateICmpEQ(c, builder->getInt8(0)), doneBB, bodyBB);
+
+        builder->SetInsertPoint(bodyBB);
+        llvm::Value *mixed = builder->CreateXor(hash, builder->CreateZExt(c, i64));
+        llvm::Value *nextHash = builder->CreateMul(mixed, llvm::ConstantInt::get(i64, 0x100000001b3ULL), "fnv_next");
+        llvm::Value *nextIndex = builder->CreateAdd(index, llvm::ConstantInt::get(i64, 1));
+        builder->CreateBr(loopBB);
+
+        hash->addIncoming(llvm::ConstantInt::get(i64, 0xcbf29ce484222325ULL), entryBB);
+        hash->addIncoming(nextHash, bodyBB);
+        index->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+        index->addIncoming(nextIndex, bodyBB);
+
+        builder->SetInsertPoint(doneBB);
+        bits = hash;
+    } else if (keyType == "double") {
+        llvm::Value *normalized = builder->CreateFAdd(key, llvm::ConstantFP::get(keyTy, 0.0), "normalized");
+        bits = builder->CreateBitCast(normalized, i64);
+    } else if (keyType == "int") {
+        bits = builder->CreateSExt(key, i64);
+    } else {
+        bits = builder->CreateZExt(key, i64);
+    }
+
+    // 混合高低位（MurmurHash3 fmix64），H1 和 H2 都依赖键的所有位
+    llvm::Value *h = builder->CreateXor(bits, builder->CreateLShr(bits, 33));
+    h = builder->CreateMul(h, llvm::ConstantInt::get(i64, 0xff51afd7ed558ccdULL));
+    h = builder->CreateXor(h, builder->CreateLShr(h, 33));
+    h = builder->CreateMul(h, llvm::ConstantInt::get(i64, 0xc4ceb9fe1a85ec53ULL));
+    h = builder->CreateXor(h, builder->CreateLShr(h, 33), "hash");
+    builder->CreateRet(h);
+    return function;
+}
+
+// i64 __ppx_map_find.K(ptr map, K key, i64 hash)：返回键所在的槽，不存在时返回 -1
+llvm::Function *CodeGenerator::getMapFindFunction(const std::string &keyType) {
+    std::string name = "__ppx_map_find." + keyType;
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *keyTy = getType(keyType);
+    llvm::StructType *mapTy = getMapStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(i64, {ptrTy, keyTy, i64}, false));
+    llvm::Value *map = function->getArg(0);
+    llvm::Value *key = function->getArg(1);
+    llvm::Value *hash = function->getArg(2);
+    bool isString = keyType == "string";
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *probeBB = llvm::BasicBlock::Create(*context, "probe", function);
+    llvm::BasicBlock *matchBB = llvm::BasicBlock::Create(*context, "match_loop", function);
+    llvm::BasicBlock *candidateBB = llvm::BasicBlock::Create(*context, "candidate", function);
+    llvm::BasicBlock *compareBB = isString ? llvm::BasicBlock::Create(*context, "compare", function) : nullptr;
+    llvm::BasicBlock *foundBB = llvm::BasicBlock::Create(*context, "found", function);
+    llvm::BasicBlock *mismatchBB = llvm::BasicBlock::Create(*context, "mismatch", function);
+    llvm::BasicBlock *checkEmptyBB = llvm::BasicBlock::Create(*context, "check_empty", function);
+    llvm::BasicBlock *notFoundBB = llvm::BasicBlock::Create(*context, "not_found", function);
+    llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*context, "next_group", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *ctrl = builder->CreateLoad(ptrTy, builder->CreateStructGEP(mapTy, map, MAP_CTRL), "ctrl");
+    llvm::Value *keys = builder->CreateLoad(ptrTy, builder->CreateStructGEP(mapTy, map, MAP_KEYS), "keys");
+    llvm::Value *hashes = isString ? builder->CreateLoad(ptrTy, builder->CreateStructGEP(mapTy, map, MAP_HASHES), "hashes") : nullptr;
+    llvm::Value *capacity = builder->CreateLoad(i64, builder->CreateStructGEP(mapTy, map, MAP_CAPACITY), "capacity");
+    llvm::Value *groupMask = builder->CreateSub(builder->CreateLShr(capacity, 3), llvm::ConstantInt::get(i64, 1), "group_mask");
+    llvm::Value *h2 = builder->CreateAnd(hash, llvm::ConstantInt::get(i64, 0x7f), "h2");
+    llvm::Value *firstGroup = builder->CreateAnd(builder->CreateLShr(hash, 7), groupMask, "first_group");
+    builder->CreateBr(probeBB);
+
+    // 读取一组控制字节，找出 H2 相同的候选槽
+    builder->SetInsertPoint(probeBB);
+    llvm::PHINode *group = builder->CreatePHI(i64, 2, "group");
+    llvm::PHINode *step = builder->CreatePHI(i64, 2, "step");
+    llvm::Value *base = builder->CreateShl(group, 3, "group_base");
+    llvm::Value *ctrlGroup = emitMapLoadGroup(ctrl, base);
+    llvm::Value *firstMatch = emitMapGroupMatch(ctrlGroup, h2);
+    builder->CreateBr(matchBB);
+
+    builder->SetInsertPoint(matchBB);
+    llvm::PHINode *matches = builder->CreatePHI(i64, 2, "matches");
+    builder->CreateCondBr(builder->CreateICmpEQ(matches, llvm::ConstantInt::get(i64, 0)), checkEmptyBB, candidateBB);
+
+    // 比较候选槽的键（字符串键先比较完整哈希值）
+    builder->SetInsertPoint(candidateBB);
+    llvm::Value *slot = builder->CreateAdd(base, emitMapFirstSlot(matches), "slot");
+    if (isString) {
+        llvm::Value *stored = builder->CreateLoad(i64, builder->CreateGEP(i64, hashes, slot), "stored_hash");
+        builder->CreateCondBr(builder->CreateICmpEQ(stored, hash), compareBB, mismatchBB);
+
+        builder->SetInsertPoint(compareBB);
+        llvm::FunctionCallee strcmpFunc = module->getOrInsertFunction(
+            "strcmp", builder->getInt32Ty(), ptrTy, ptrTy);
+        llvm::Value *storedKey = builder->CreateLoad(ptrTy, builder->CreateGEP(ptrTy, keys, slot), "stored_key");
+        llvm::Value *cmp = builder->CreateCall(strcmpFunc, {storedKey, key}, "cmp");
+        builder->CreateCondBr(builder->CreateICmpEQ(cmp, builder->getInt32(0)), foundBB, mismatchBB);
+    } else {
+        llvm::Value *storedKey = builder->CreateLoad(keyTy, builder->CreateGEP(keyTy, keys, slot), "stored_key");
+        llvm::Value *equal = keyTy->isDoubleTy() ? builder->CreateFCmpOEQ(storedKey, key)
+                                                 : builder->CreateICmpEQ(storedKey, key);
+        builder->CreateCondBr(equal, foundBB, mismatchBB);
+    }
+
+    builder->SetInsertPoint(foundBB);
+    builder->CreateRet(slot);
+
+    // 清除最低的候选位，继续比较组内其他候选槽
+    builder->SetInsertPoint(mismatchBB);
+    llvm::Value *rest = builder->CreateAnd(matches, builder->CreateSub(matches, llvm::ConstantInt::get(i64, 1)), "rest");
+    builder->CreateBr(matchBB);
+
+    matches->addIncoming(firstMatch, probeBB);
+    matches->addIncoming(rest, mismatchBB);
+
+    // 组内有空槽说明键不存在
+    builder->SetInsertPoint(checkEmptyBB);
+    llvm::Value *empty = emitMapGroupEmpty(ctrlGroup);
+    builder->CreateCondBr(builder->CreateICmpNE(empty, llvm::ConstantInt::get(i64, 0)), notFoundBB, nextBB);
+
+    builder->SetInsertPoint(notFoundBB);
+    builder->CreateRet(llvm::ConstantInt::get(i64, -1, true));
+
+    builder->SetInsertPoint(nextBB);
+    llvm::Value *nextStep = builder->CreateAdd(step, llvm::ConstantInt::get(i64, 1), "next_step");
+    llvm::Value *nextGroup = builder->CreateAnd(builder->CreateAdd(group, nextStep), groupMask, "next_group");
+    builder->CreateBr(probeBB);
+
+    group->addIncoming(firstGroup, entryBB);
+    group->addIncoming(nextGroup, nextBB);
+    step->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    step->addIncoming(nextStep, nextBB);
+    return function;
+}
+
+// void __ppx_map_rehash.K(ptr map)：容量翻倍，按控制字节把所有键值对移动到新表
+llvm::Function *CodeGenerator::getMapRehashFunction(const std::string &keyType) {
+    std::string name = "__ppx_map_rehash." + keyType;
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *keyTy = getType(keyType);
+    llvm::StructType *mapTy = getMapStructType();
+    bool isString = keyType == "string";
+    llvm::Function *hashFunc = getMapHashFunction(keyType);
+    llvm::Function *emptySlotFunc = getMapEmptySlotFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(builder->getVoidTy(), {ptrTy}, false));
+    llvm::Value *map = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *checkBB = llvm::BasicBlock::Create(*context, "check", function);
+    llvm::BasicBlock *moveBB = llvm::BasicBlock::Create(*context, "move", function);
+    llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*context, "next", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::FunctionCallee callocFunc = module->getOrInsertFunction("calloc", ptrTy, i64, i64);
+    llvm::Function *mallocFunc = module->getFunction("malloc");
+    llvm::Function *freeFunc = module->getFunction("free");
+
+    builder->SetInsertPoint(entryBB);
+    auto field = [&](MapField index) { return builder->CreateStructGEP(mapTy, map, index); };
+    llvm::Value *oldCtrl = builder->CreateLoad(ptrTy, field(MAP_CTRL), "old_ctrl");
+    llvm::Value *oldKeys = builder->CreateLoad(ptrTy, field(MAP_KEYS), "old_keys");
+    llvm::Value *oldValues = builder->CreateLoad(ptrTy, field(MAP_VALUES), "old_values");
+    llvm::Value *oldHashes = isString ? builder->CreateLoad(ptrTy, field(MAP_HASHES), "old_hashes") : nullptr;
+    llvm::Value *oldCapacity = builder->CreateLoad(i64, field(MAP_CAPACITY), "old_capacity");
+    llvm::Value *size = builder->CreateLoad(i64, field(MAP_SIZE), "size");
+    llvm::Value *valueSize = builder->CreateLoad(i64, field(MAP_VALUE_SIZE), "value_size");
+
+    llvm::Value *capacity = builder->CreateShl(oldCapacity, 1, "capacity");
+    llvm::Value *ctrl = builder->CreateCall(mallocFunc, {capacity}, "ctrl");
+    builder->CreateMemSet(ctrl, builder->getInt8(MAP_CTRL_EMPTY), capacity, llvm::MaybeAlign(1));
+    uint64_t keySize = module->getDataLayout().getTypeAllocSize(keyTy);
+    llvm::Value *keys = builder->CreateCall(callocFunc, {capacity, llvm::ConstantInt::get(i64, keySize)}, "keys");
+    llvm::Value *values = builder->CreateCall(callocFunc, {capacity, valueSize}, "values");
+    llvm::Value *hashes = isString ? builder->CreateCall(callocFunc, {capacity, llvm::ConstantInt::get(i64, 8)}, "hashes") : nullptr;
+    builder->CreateStore(ctrl, field(MAP_CTRL));
+    builder->CreateStore(keys, field(MAP_KEYS));
+    builder->CreateStore(values, field(MAP_VALUES));
+    if (isString) {
+        builder->CreateStore(hashes, field(MAP_HASHES));
+    }
+    builder->CreateStore(capacity, field(MAP_CAPACITY));
+    llvm::Value *growthLeft = builder->CreateSub(builder->CreateSub(capacity, builder->CreateLShr(capacity, 3)), size);
+    builder->CreateStore(growthLeft, field(MAP_GROWTH_LEFT));
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *index = builder->CreatePHI(i64, 2, "index");
+    builder->CreateCondBr(builder->CreateICmpULT(index, oldCapacity), checkBB, doneBB);
+
+    builder->SetInsertPoint(checkBB);
+    llvm::Value *c = builder->CreateLoad(i8, builder->CreateGEP(i8, oldCtrl, index), "ctrl_byte");
+    llvm::Value *isFull = builder->CreateICmpEQ(builder->CreateAnd(c, builder->getInt8(MAP_CTRL_EMPTY)), builder->getInt8(0));
+    builder->CreateCondBr(isFull, moveBB, nextBB);
+
+    // 字符串键使用保存的哈希值，其他键重新计算（代价很小）
+    builder->SetInsertPoint(moveBB);
+    llvm::Value *key = builder->CreateLoad(keyTy, builder->CreateGEP(keyTy, oldKeys, index), "key");
+    llvm::Value *hash = nullptr;
+    if (isString) {
+        hash = builder->CreateLoad(i64, builder->CreateGEP(i64, oldHashes, index), "hash");
+    } else {
+        hash = builder->CreateCall(hashFunc, {key}, "hash");
+    }
+    llvm::Value *slot = builder->CreateCall(emptySlotFunc, {map, hash}, "slot");
+    builder->CreateStore(c, builder->CreateGEP(i8, ctrl, slot));
+    builder->CreateStore(key, builder->CreateGEP(keyTy, keys, slot));
+    if (isString) {
+        builder->CreateStore(hash, builder->CreateGEP(i64, hashes, slot));
+    }
+    llvm::Value *src = builder->CreateGEP(i8, oldValues, builder->CreateMul(index, valueSize));
+    llvm::Value *dst = builder->CreateGEP(i8, values, builder->CreateMul(slot, valueSize));
+    builder->CreateMemCpy(dst, llvm::MaybeAlign(1), src, llvm::MaybeAlign(1), valueSize);
+    builder->CreateBr(nextBB);
+
+    builder->SetInsertPoint(nextBB);
+    llvm::Value *nextIndex = builder->CreateAdd(index, llvm::ConstantInt::get(i64, 1), "next_index");
+    builder->CreateBr(loopBB);
+
+    index->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    index->addIncoming(nextIndex, nextBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateCall(freeFunc, {oldCtrl});
+    builder->CreateCall(freeFunc, {oldKeys});
+    builder->CreateCall(freeFunc, {oldValues});
+    if (isString) {
+        builder->CreateCall(freeFunc, {oldHashes});
+    }
+    builder->CreateRetVoid();
+    return function;
+}
+
+// i64 __ppx_map_insert.K(ptr map, K key)：返回键所在的槽，键不存在时先插入（字符串键复制一份）
+llvm::Function *CodeGenerator::getMapInsertFunction(const std::string &keyType) {
+    std::string name = "__ppx_map_insert." + keyType;
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *keyTy = getType(keyType);
+    llvm::StructType *mapTy = getMapStructType();
+    bool isString = keyType == "string";
+    llvm::Function *hashFunc = getMapHashFunction(keyType);
+    llvm::Function *findFunc = getMapFindFunction(keyType);
+    llvm::Function *rehashFunc = getMapRehashFunction(keyType);
+    llvm::Function *emptySlotFunc = getMapEmptySlotFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(i64, {ptrTy, keyTy}, false));
+    llvm::Value *map = function->getArg(0);
+    llvm::Value *key = function->getArg(1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *existsBB = llvm::BasicBlock::Create(*context, "exists", function);
+    llvm::BasicBlock *insertBB = llvm::BasicBlock::Create(*context, "insert", function);
+    llvm::BasicBlock *growBB = llvm::BasicBlock::Create(*context, "grow", function);
+    llvm::BasicBlock *placeBB = llvm::BasicBlock::Create(*context, "place", function);
+
+    builder->SetInsertPoint(entryBB);
+    auto field = [&](MapField index) { return builder->CreateStructGEP(mapTy, map, index); };
+    llvm::Value *hash = builder->CreateCall(hashFunc, {key}, "hash");
+    llvm::Value *found = builder->CreateCall(findFunc, {map, key, hash}, "found");
+    builder->CreateCondBr(builder->CreateICmpSGE(found, llvm::ConstantInt::get(i64, 0)), existsBB, insertBB);
+
+    builder->SetInsertPoint(existsBB);
+    builder->CreateRet(found);
+
+    builder->SetInsertPoint(insertBB);
+    llvm::Value *growthLeft = builder->CreateLoad(i64, field(MAP_GROWTH_LEFT), "growth_left");
+    builder->CreateCondBr(builder->CreateICmpEQ(growthLeft, llvm::ConstantInt::get(i64, 0)), growBB, placeBB);
+
+    builder->SetInsertPoint(growBB);
+    builder->CreateCall(rehashFunc, {map});
+    builder->CreateBr(placeBB);
+
+    // 扩容后表的位置可能改变，重新读取字段
+    builder->SetInsertPoint(placeBB);
+    llvm::Value *slot = builder->CreateCall(emptySlotFunc, {map, hash}, "slot");
+    llvm::Value *ctrl = builder->CreateLoad(ptrTy, field(MAP_CTRL), "ctrl");
+    llvm::Value *h2 = builder->CreateTrunc(builder->CreateAnd(hash, llvm::ConstantInt::get(i64, 0x7f)), builder->getInt8Ty(), "h2");
+    builder->CreateStore(h2, builder->CreateGEP(builder->getInt8Ty(), ctrl, slot));
+    llvm::Value *keys = builder->CreateLoad(ptrTy, field(MAP_KEYS), "keys");
+    llvm::Value *storedKey = key;
+    if (isString) {
+        llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+        storedKey = builder->CreateCall(strdupFunc, {key}, "key_copy");
+        llvm::Value *hashes = builder->CreateLoad(ptrTy, field(MAP_HASHES), "hashes");
+        builder->CreateStore(hash, builder->CreateGEP(i64, hashes, slot));
+    }
+    builder->CreateStore(storedKey, builder->CreateGEP(keyTy, keys, slot));
+    llvm::Value *size = builder->CreateLoad(i64, field(MAP_SIZE), "size");
+    builder->CreateStore(builder->CreateAdd(size, llvm::ConstantInt::get(i64, 1)), field(MAP_SIZE));
+    llvm::Value *left = builder->CreateLoad(i64, field(MAP_GROWTH_LEFT), "growth_left");
+    builder->CreateStore(builder->CreateSub(left, llvm::ConstantInt::get(i64, 1)), field(MAP_GROWTH_LEFT));
+    builder->CreateRet(slot);
+    return function;
+}
+
+// void __ppx_map_retain(ptr map)：引用计数加一（空指针不变）
+llvm::Function *CodeGenerator::getMapRetainFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_map_retain")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::StructType *mapTy = getMapStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_map_retain", llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy}, false));
+    llvm::Value *map = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *retainBB = llvm::BasicBlock::Create(*context, "retain", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(map), doneBB, retainBB);
+
+    builder->SetInsertPoint(retainBB);
+    createCounterUpdate(*builder, builder->CreateStructGEP(mapTy, map, MAP_REFS), 1, llvm::AtomicOrdering::Monotonic);
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_map_release(ptr map, i1 stringKeys, i1 stringValues)：引用计数减一（空指针不变），
+// 最后一个引用释放时释放已占用槽中的字符串键和值、各个数组和头部
+llvm::Function *CodeGenerator::getMapReleaseFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_map_release")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *i1 = llvm::Type::getInt1Ty(*context);
+    llvm::StructType *mapTy = getMapStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_map_release",
+        llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy, i1, i1}, false));
+    auto args = function->arg_begin();
+    llvm::Value *map = &*args++;
+    llvm::Value *stringKeys = &*args++;
+    llvm::Value *stringValues = &*args++;
+    llvm::Function *freeFunc = module->getFunction("free");
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *releaseBB = llvm::BasicBlock::Create(*context, "release", function);
+    llvm::BasicBlock *lastBB = llvm::BasicBlock::Create(*context, "last", function);
+    llvm::BasicBlock *slotCondBB = llvm::BasicBlock::Create(*context, "slot_cond", function);
+    llvm::BasicBlock *slotBodyBB = llvm::BasicBlock::Create(*context, "slot_body", function);
+    llvm::BasicBlock *freeKeyBB = llvm::BasicBlock::Create(*context, "free_key", function);
+    llvm::BasicBlock *checkValueBB = llvm::BasicBlock::Create(*context, "check_value", function);
+    llvm::BasicBlock *freeValueBB = llvm::BasicBlock::Create(*context, "free_value", function);
+    llvm::BasicBlock *slotNextBB = llvm::BasicBlock::Create(*context, "slot_next", function);
+    llvm::BasicBlock *freeMapBB = llvm::BasicBlock::Create(*context, "free_map", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(map), doneBB, releaseBB);
+
+    // 减一使用 acq_rel：其他线程对映射的写入在释放之前可见
+    builder->SetInsertPoint(releaseBB);
+    llvm::Value *refs = createCounterUpdate(*builder, builder->CreateStructGEP(mapTy, map, MAP_REFS), -1,
+                                            llvm::AtomicOrdering::AcquireRelease);
+    builder->CreateCondBr(builder->CreateICmpEQ(refs, llvm::ConstantInt::get(i64, 1), "last"), lastBB, doneBB);
+
+    builder->SetInsertPoint(lastBB);
+    auto field = [&](MapField index) { return builder->CreateStructGEP(mapTy, map, index); };
+    llvm::Value *ctrl = builder->CreateLoad(ptrTy, field(MAP_CTRL), "ctrl");
+    llvm::Value *keys = builder->CreateLoad(ptrTy, field(MAP_KEYS), "keys");
+    llvm::Value *values = builder->CreateLoad(ptrTy, field(MAP_VALUES), "values");
+    llvm::Value *hashes = builder->CreateLoad(ptrTy, field(MAP_HASHES), "hashes");
+    llvm::Value *capacity = builder->CreateLoad(i64, field(MAP_CAPACITY), "capacity");
+    builder->CreateCondBr(builder->CreateOr(stringKeys, stringValues), slotCondBB, freeMapBB);
+
+    // 逐槽释放字符串键和值（空槽的键和值为 null 或已移走，不释放）
+    builder->SetInsertPoint(slotCondBB);
+    llvm::PHINode *slot = builder->CreatePHI(i64, 2, "slot");
+    slot->addIncoming(llvm::ConstantInt::get(i64, 0), lastBB);
+    builder->CreateCondBr(builder->CreateICmpULT(slot, capacity), slotBodyBB, freeMapBB);
+
+    builder->SetInsertPoint(slotBodyBB);
+    llvm::Value *c = builder->CreateLoad(i8, builder->CreateGEP(i8, ctrl, slot), "ctrl_byte");
+    llvm::Value *isFull = builder->CreateICmpEQ(builder->CreateAnd(c, builder->getInt8(MAP_CTRL_EMPTY)), builder->getInt8(0));
+    builder->CreateCondBr(builder->CreateAnd(isFull, stringKeys), freeKeyBB, checkValueBB);
+
+    builder->SetInsertPoint(freeKeyBB);
+    builder->CreateCall(freeFunc, {builder->CreateLoad(ptrTy, builder->CreateGEP(ptrTy, keys, slot), "key")});
+    builder->CreateBr(checkValueBB);
+
+    builder->SetInsertPoint(checkValueBB);
+    builder->CreateCondBr(builder->CreateAnd(isFull, stringValues), freeValueBB, slotNextBB);
+
+    builder->SetInsertPoint(freeValueBB);
+    builder->CreateCall(freeFunc, {builder->CreateLoad(ptrTy, builder->CreateGEP(ptrTy, values, slot), "value")});
+    builder->CreateBr(slotNextBB);
+
+    builder->SetInsertPoint(slotNextBB);
+    slot->addIncoming(builder->CreateAdd(slot, llvm::ConstantInt::get(i64, 1)), slotNextBB);
+    builder->CreateBr(slotCondBB);
+
+    builder->SetInsertPoint(freeMapBB);
+    builder->CreateCall(freeFunc, {ctrl});
+    builder->CreateCall(freeFunc, {keys});
+    builder->CreateCall(freeFunc, {values});
+    builder->CreateCall(freeFunc, {hashes});
+    builder->CreateCall(freeFunc, {map});
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// 按声明类型生成表达式：[:] 等映射字面量的键值类型、[...] 是否为动态数组来自上下文
+llvm::Value *CodeGenerator::codegenTypedExpr(ExprNode *node, const std::string &typeName) {
+    if (auto mapLit = dynamic_cast<MapLiteralNode *>(node)) {
+        return codegenMapLiteral(mapLit, isMapType(typeName) ? typeName : "");
+    }
+    if (auto arrayLit = dynamic_cast<ArrayLiteralNode *>(node)) {
+        if (isListType(typeName)) {
+            return codegenListLiteral(arrayLit, typeName);
+        }
+    }
+    return codegenExpr(node);
+}
+
+// 生成映射字面量：mapType 为空时由第一个键值对推断类型
+llvm::Value *CodeGenerator::codegenMapLiteral(MapLiteralNode *node, const std::string &mapType) {
+    std::vector<llvm::Value *> keys;
+    std::vector<llvm::Value *> values;
+    for (size_t i = 0; i < node->keys.size(); i++) {
+        llvm::Value *key = codegenExpr(node->keys[i].get());
+        llvm::Value *value = codegenExpr(node->values[i].get());
+        if (!key || !value) {
+            return nullptr;
+        }
+        keys.push_back(key);
+        values.push_back(value);
+    }
+
+    std::string type = mapType;
+    if (type.empty()) {
+        if (keys.empty()) {
+            reportError("Cannot infer the type of empty map literal '[:]', declare the variable as map<K,V>", node->lineNumber);
+            return nullptr;
+        }
+        type = "map<" + typeNameOf(keys[0]->getType()) + "," + typeNameOf(values[0]->getType()) + ">";
+    }
+    std::string keyType = mapKeyType(type);
+    std::string valueType = mapValueType(type);
+
+    if (g_verbose) {
+        std::cout << "[IR Gen] Map literal: " << type << " with " << keys.size() << " entries" << std::endl;
+    }
+
+    // 按元素数量预留容量，初始化时不需要扩容
+    uint64_t capacity = CodeGenConstants::MAP_INITIAL_CAPACITY;
+    while (capacity - capacity / 8 < keys.size()) {
+        capacity *= 2;
+    }
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    const llvm::DataLayout &dataLayout = module->getDataLayout();
+    llvm::Value *map = builder->CreateCall(getMapNewFunction(), {
+        llvm::ConstantInt::get(i64, dataLayout.getTypeAllocSize(getType(keyType))),
+        llvm::ConstantInt::get(i64, dataLayout.getTypeAllocSize(getType(valueType))),
+        llvm::ConstantInt::get(i64, capacity),
+        builder->getInt1(keyType == "string")}, "map");
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        emitMapStore(map, keys[i], values[i], type, "=", node->lineNumber);
+    }
+    pushTempReference(map, type);
+    return map;
+}
+
+// 检查键的类型并转换为映射的键类型
+llvm::Value *CodeGenerator::convertMapKey(llvm::Value *key, const std::string &mapType, int lineNumber) {
+    std::string keyType = mapKeyType(mapType);
+    if ((keyType == "string") != key->getType()->isPointerTy()) {
+        reportError("Map key type mismatch: expected '" + keyType + "' but got '" +
+                    typeNameOf(key->getType()) + "'", lineNumber);
+        return nullptr;
+    }
+    llvm::Type *keyTy = getType(keyType);
+    if (key->getType() != keyTy) {
+        key = convertToType(key, keyTy);
+    }
+    return key;
+}
+
+// 插入或更新键值对；op 为复合赋值运算符时以旧值（新键为 0）计算新值
+void CodeGenerator::emitMapStore(llvm::Value *map, llvm::Value *key, llvm::Value *value,
+                                 const std::string &mapType, const std::string &op, int lineNumber) {
+    std::string keyType = mapKeyType(mapType);
+    std::string valueType = mapValueType(mapType);
+    key = convertMapKey(key, mapType, lineNumber);
+    if (!key) {
+        return;
+    }
+    if ((valueType == "string") != value->getType()->isPointerTy()) {
+        reportError("Map value type mismatch: expected '" + valueType + "' but got '" +
+                    typeNameOf(value->getType()) + "'", lineNumber);
+        return;
+    }
+    if (valueType == "string" && op != "=") {
+        reportError("Compound assignment '" + op + "' is not supported for string map values", lineNumber);
+        return;
+    }
+
+    llvm::Type *valueTy = getType(valueType);
+    llvm::Value *slot = builder->CreateCall(getMapInsertFunction(keyType), {map, key}, "slot");
+    llvm::Value *values = builder->CreateLoad(llvm::PointerType::get(*context, 0),
+                                              builder->CreateStructGEP(getMapStructType(), map, MAP_VALUES), "values");
+    llvm::Value *ptr = builder->CreateGEP(valueTy, values, slot, "value_ptr");
+
+    if (valueType == "string") {
+        // 映射保存字符串的副本，覆盖时释放旧值（先复制：新值可能就是旧值，如 m[k] = m[k]）
+        llvm::Value *oldVal = builder->CreateLoad(valueTy, ptr, "oldval");
+        llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", valueTy, valueTy);
+        value = builder->CreateCall(strdupFunc, {value}, "value_copy");
+        builder->CreateCall(module->getFunction("free"), {oldVal});
+    } else if (op != "=") {
+        llvm::Value *oldVal = builder->CreateLoad(valueTy, ptr, "oldval");
+        value = applyCompoundAssign(op, oldVal, value);
+    }
+    if (value->getType() != valueTy) {
+        value = convertToType(value, valueTy);
+    }
+    builder->CreateStore(value, ptr);
+}
+
+// m[k]：键不存在时报告运行时错误并返回默认值（与数组越界的处理方式一致）
+llvm::Value *CodeGenerator::codegenMapGet(ArrayAccessNode *node, const std::string &mapType) {
+    std::string keyType = mapKeyType(mapType);
+    std::string valueType = mapValueType(mapType);
+    llvm::Value *map = codegenExpr(node->array.get());
+    llvm::Value *key = codegenExpr(node->index.get());
+    if (!map || !key) {
+        return nullptr;
+    }
+    key = convertMapKey(key, mapType, node->lineNumber);
+    if (!key) {
+        return nullptr;
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::Value *hash = builder->CreateCall(getMapHashFunction(keyType), {key}, "hash");
+    llvm::Value *slot = builder->CreateCall(getMapFindFunction(keyType), {map, key, hash}, "slot");
+    llvm::Value *found = builder->CreateICmpSGE(slot, llvm::ConstantInt::get(slot->getType(), 0), "found");
+
+    llvm::BasicBlock *hitBB = llvm::BasicBlock::Create(*context, "map_hit", function);
+    llvm::BasicBlock *missBB = llvm::BasicBlock::Create(*context, "map_miss", function);
+    llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*context, "map_merge", function);
+    builder->CreateCondBr(found, hitBB, missBB);
+
+    llvm::Type *valueTy = getType(valueType);
+    builder->SetInsertPoint(hitBB);
+    llvm::Value *values = builder->CreateLoad(llvm::PointerType::get(*context, 0),
+                                              builder->CreateStructGEP(getMapStructType(), map, MAP_VALUES), "values");
+    llvm::Value *value = builder->CreateLoad(valueTy, builder->CreateGEP(valueTy, values, slot), "map_value");
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(missBB);
+    llvm::Value *errorMsg = builder->CreateGlobalString("Runtime Error: Map key not found\n", "", 0, module.get());
+    builder->CreateCall(getPrintfFunction(), {errorMsg});
+    llvm::Value *defaultValue = valueType == "string"
+                                    ? builder->CreateGlobalString("", "", 0, module.get())
+                                    : llvm::Constant::getNullValue(valueTy);
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(mergeBB);
+    llvm::PHINode *phi = builder->CreatePHI(valueTy, 2, "map_get");
+    phi->addIncoming(value, hitBB);
+    phi->addIncoming(defaultValue, missBB);
+    if (valueType == "string") {
+        fn->borrowedStrings.insert(phi);
+    }
+    return phi;
+}
+
+// m[k] = v 以及 m[k] += v 等复合赋值
+void CodeGenerator::codegenMapSet(AssignmentNode *node, const std::string &mapType) {
+    auto target = static_cast<ArrayAccessNode *>(node->target.get());
+    llvm::Value *map = codegenExpr(target->array.get());
+    llvm::Value *key = codegenExpr(target->index.get());
+    llvm::Value *value = codegenExpr(node->value.get());
+    if (!map || !key || !value) {
+        return;
+    }
+    emitMapStore(map, key, value, mapType, node->op, node->lineNumber);
+    clearTempMemory();
+}
+
+// for k in m：按槽的顺序遍历所有键（循环中插入新键时，是否遍历到新键不确定）
+void CodeGenerator::codegenMapForStmt(ForStmtNode *node, const std::string &mapType) {
+    if (g_verbose) {
+        std::cout << "[IR Gen] For loop: " << node->variable << " in " << mapType << std::endl;
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    std::string keyType = mapKeyType(mapType);
+    llvm::Type *keyTy = getType(keyType);
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *mapTy = getMapStructType();
+
+    // 检查循环变量名是否与已存在的局部变量冲突（警告而非错误）
+    if (currentDiagnostics().enableShadowWarnings && fn->namedValues.find(node->variable) != fn->namedValues.end()) {
+        reportWarning("For loop variable '" + node->variable + "' shadows an existing local variable", node->lineNumber);
+    }
+
+    llvm::Value *map = codegenExpr(node->iterable.get());
+    if (!map) {
+        return;
+    }
+    // 循环持有映射的一个引用（与遍历动态数组相同）
+    llvm::AllocaInst *mapVar = createEntryBlockAlloca(function, node->variable + "_map", ptrTy);
+    trackReferenceSlot(mapVar, mapType);
+    storeReference(mapVar, map, mapType);
+    clearTempMemory();
+
+    llvm::AllocaInst *loopVar = createEntryBlockAlloca(function, node->variable, keyTy);
+    llvm::AllocaInst *slotVar = createEntryBlockAlloca(function, node->variable + "_slot", i64);
+    builder->CreateStore(llvm::ConstantInt::get(i64, 0), slotVar);
+    fn->namedValues[node->variable] = loopVar;
+    fn->variableTypes[node->variable] = keyType;
+
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "formap_cond", function);
+    llvm::BasicBlock *checkBB = llvm::BasicBlock::Create(*context, "formap_check");
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "formap_body");
+    llvm::BasicBlock *incrBB = llvm::BasicBlock::Create(*context, "formap_incr");
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(*context, "after_formap");
+
+    LoopContext loopCtx;
+    loopCtx.continueBlock = incrBB;
+    loopCtx.breakBlock = afterBB;
+    fn->loopContextStack.push_back(loopCtx);
+
+    // 循环体可能插入新键导致扩容，每次迭代重新读取容量和数组
+    builder->CreateBr(condBB);
+    builder->SetInsertPoint(condBB);
+    llvm::Value *slot = builder->CreateLoad(i64, slotVar, "slot");
+    llvm::Value *capacity = builder->CreateLoad(i64, builder->CreateStructGEP(mapTy, map, MAP_CAPACITY), "capacity");
+    builder->CreateCondBr(builder->CreateICmpULT(slot, capacity), checkBB, afterBB);
+
+    function->insert(function->end(), checkBB);
+    builder->SetInsertPoint(checkBB);
+    llvm::Value *ctrl = builder->CreateLoad(ptrTy, builder->CreateStructGEP(mapTy, map, MAP_CTRL), "ctrl");
+    llvm::Value *c = builder->CreateLoad(i8, builder->CreateGEP(i8, ctrl, slot), "ctrl_byte");
+    llvm::Value *isFull = builder->CreateICmpEQ(builder->CreateAnd(c, builder->getInt8(MAP_CTRL_EMPTY)), builder->getInt8(0));
+    builder->CreateCondBr(isFull, bodyBB, incrBB);
+
+    function->insert(function->end(), bodyBB);
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *keys = builder->CreateLoad(ptrTy, builder->CreateStructGEP(mapTy, map, MAP_KEYS), "keys");
+    builder->CreateStore(builder->CreateLoad(keyTy, builder->CreateGEP(keyTy, keys, slot), "key"), loopVar);
+    codegenStmt(node->body.get());
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(incrBB);
+    }
+
+    function->insert(function->end(), incrBB);
+    builder->SetInsertPoint(incrBB);
+    clearTempMemory();
+    llvm::Value *current = builder->CreateLoad(i64, slotVar, "slot");
+    builder->CreateStore(builder->CreateAdd(current, llvm::ConstantInt::get(i64, 1), "next_slot"), slotVar);
+    builder->CreateBr(condBB);
+
+    function->insert(function->end(), afterBB);
+    builder->SetInsertPoint(afterBB);
+    attachLoopHints(node->annotations, node->lineNumber, condBB);
+    fn->loopContextStack.pop_back();
+
+    // 循环变量的作用域仅限于循环内
+    fn->namedValues.erase(node->variable);
+    fn->variableTypes.erase(node->variable);
+}
+
+// 动态数组 list<T>（T[]）
+//
+// 头部 { data, size, capacity, refs }，动态数组的值是指向头部的指针（与映射一样按引用传递）。
+// 新建的数组（字面量、切片、split、read_ints、函数返回值）是语句中的临时值，语句结束时释放；
+// 写入变量时取走临时值或把引用计数加一，变量的旧值和函数出口时局部变量、参数持有的值减一，减到 0 时释放元素和头部。
+// 引用计数用 cmpxchg 原子更新，数组可以传给 spawn 的线程。
+// 元素连续存储在堆上：追加时容量不足则容量翻倍（至少 LIST_MIN_CAPACITY），用 realloc 整体移动
+// 已有元素，不逐个复制；字符串元素保存副本，移动时只移动指针。
+// 下标访问只比较一次：索引符号扩展为 i64 后与 size 做无符号比较，负数索引同时被排除。
+
+bool CodeGenerator::isListType(const std::string &typeName) {
+    return typeName.rfind("list<", 0) == 0;
+}
+
+bool CodeGenerator::isReferenceType(const std::string &typeName) {
+    return isMapType(typeName) || isListType(typeName) || typeName == "file" || isChanType(typeName) ||
+           isFutureType(typeName) || isGenType(typeName);
+}
+
+std::string CodeGenerator::listElementType(const std::string &listType) {
+    return listType.substr(5, listType.size() - 6);
+}
+
+llvm::StructType *CodeGenerator::getListStructType() {
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    return llvm::StructType::get(*context, {llvm::PointerType::get(*context, 0), i64, i64, i64});
+}
+
+// ptr __ppx_list_new(i64 elementSize, i64 capacity)
+llvm::Function *CodeGenerator::getListNewFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_list_new")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *listTy = getListStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_list_new", llvm::FunctionType::get(ptrTy, {i64, i64}, false));
+    auto args = function->arg_begin();
+    llvm::Value *elementSize = &*args++;
+    llvm::Value *capacity = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    builder->SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", function));
+    llvm::Function *mallocFunc = module->getFunction("malloc");
+    uint64_t headerSize = module->getDataLayout().getTypeAllocSize(listTy);
+    llvm::Value *list = builder->CreateCall(mallocFunc, {llvm::ConstantInt::get(i64, headerSize)}, "list");
+    llvm::Value *data = builder->CreateCall(mallocFunc, {builder->CreateMul(capacity, elementSize)}, "data");
+    builder->CreateStore(data, builder->CreateStructGEP(listTy, list, LIST_DATA));
+    builder->CreateStore(llvm::ConstantInt::get(i64, 0), builder->CreateStructGEP(listTy, list, LIST_SIZE));
+    builder->CreateStore(capacity, builder->CreateStructGEP(listTy, list, LIST_CAPACITY));
+    builder->CreateStore(llvm::ConstantInt::get(i64, 1), builder->CreateStructGEP(listTy, list, LIST_REFS));
+    builder->CreateRet(list);
+    return function;
+}
+
+// void __ppx_list_grow(ptr list, i64 elementSize, i64 minCapacity)：容量不足 minCapacity 时扩容
+// 新容量为 max(2 * capacity, minCapacity, LIST_MIN_CAPACITY)，均摊后每次追加 O(1)
+llvm::Function *CodeGenerator::getListGrowFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_list_grow")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *listTy = getListStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_list_grow",
+        llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy, i64, i64}, false));
+    auto args = function->arg_begin();
+    llvm::Value *list = &*args++;
+    llvm::Value *elementSize = &*args++;
+    llvm::Value *minCapacity = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *growBB = llvm::BasicBlock::Create(*context, "grow", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::FunctionCallee reallocFunc = module->getOrInsertFunction("realloc", ptrTy, ptrTy, i64);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *capacityPtr = builder->CreateStructGEP(listTy, list, LIST_CAPACITY);
+    llvm::Value *capacity = builder->CreateLoad(i64, capacityPtr, "capacity");
+    builder->CreateCondBr(builder->CreateICmpULE(minCapacity, capacity), doneBB, growBB);
+
+    builder->SetInsertPoint(growBB);
+    llvm::Value *newCapacity = builder->CreateShl(capacity, 1, "doubled");
+    newCapacity = builder->CreateSelect(builder->CreateICmpUGT(minCapacity, newCapacity),
+                                        minCapacity, newCapacity);
+    llvm::Value *minimum = llvm::ConstantInt::get(i64, CodeGenConstants::LIST_MIN_CAPACITY);
+    newCapacity = builder->CreateSelect(builder->CreateICmpULT(newCapacity, minimum),
+                                        minimum, newCapacity, "new_capacity");
+    llvm::Value *dataPtr = builder->CreateStructGEP(listTy, list, LIST_DATA);
+    llvm::Value *data = builder->CreateLoad(ptrTy, dataPtr, "data");
+    llvm::Value *newData = builder->CreateCall(reallocFunc, {data, builder->CreateMul(newCapacity, elementSize)}, "new_data");
+    builder->CreateStore(newData, dataPtr);
+    builder->CreateStore(newCapacity, capacityPtr);
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// ptr __ppx_list_slice(ptr list, i64 elementSize, i64 from, i64 to, i1 strings)
+// 复制 [from, to) 的元素到新的动态数组（调用方已检查范围），字符串元素逐个复制
+llvm::Function *CodeGenerator::getListSliceFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_list_slice")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *i1 = llvm::Type::getInt1Ty(*context);
+    llvm::StructType *listTy = getListStructType();
+    llvm::Function *newFunc = getListNewFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_list_slice", llvm::FunctionType::get(ptrTy, {ptrTy, i64, i64, i64, i1}, false));
+    auto args = function->arg_begin();
+    llvm::Value *list = &*args++;
+    llvm::Value *elementSize = &*args++;
+    llvm::Value *from = &*args++;
+    llvm::Value *to = &*args++;
+    llvm::Value *strings = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *dupCondBB = llvm::BasicBlock::Create(*context, "dup_cond", function);
+    llvm::BasicBlock *dupBodyBB = llvm::BasicBlock::Create(*context, "dup_body", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *count = builder->CreateSub(to, from, "count");
+    llvm::Value *result = builder->CreateCall(newFunc, {elementSize, count}, "slice");
+    llvm::Value *source = builder->CreateLoad(ptrTy, builder->CreateStructGEP(listTy, list, LIST_DATA), "source");
+    llvm::Value *target = builder->CreateLoad(ptrTy, builder->CreateStructGEP(listTy, result, LIST_DATA), "target");
+    llvm::Value *start = builder->CreateGEP(i8, source, builder->CreateMul(from, elementSize), "start");
+    builder->CreateMemCpy(target, llvm::MaybeAlign(1), start, llvm::MaybeAlign(1), builder->CreateMul(count, elementSize));
+    builder->CreateStore(count, builder->CreateStructGEP(listTy, result, LIST_SIZE));
+    builder->CreateCondBr(strings, dupCondBB, doneBB);
+
+    builder->SetInsertPoint(dupCondBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    i->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    builder->CreateCondBr(builder->CreateICmpULT(i, count), dupBodyBB, doneBB);
+
+    builder->SetInsertPoint(dupBodyBB);
+    llvm::Value *elementPtr = builder->CreateGEP(ptrTy, target, i, "element_ptr");
+    llvm::Value *copy = builder->CreateCall(strdupFunc, {builder->CreateLoad(ptrTy, elementPtr)}, "copy");
+    builder->CreateStore(copy, elementPtr);
+    i->addIncoming(builder->CreateAdd(i, llvm::ConstantInt::get(i64, 1)), dupBodyBB);
+    builder->CreateBr(dupCondBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(result);
+    return function;
+}
+
+// void __ppx_list_retain(ptr list)：引用计数加一（空指针不变）
+llvm::Function *CodeGenerator::getListRetainFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_list_retain")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::StructType *listTy = getListStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_list_retain", llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy}, false));
+    llvm::Value *list = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *retainBB = llvm::BasicBlock::Create(*context, "retain", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(list), doneBB, retainBB);
+
+    builder->SetInsertPoint(retainBB);
+    createCounterUpdate(*builder, builder->CreateStructGEP(listTy, list, LIST_REFS), 1, llvm::AtomicOrdering::Monotonic);
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_list_release(ptr list, i1 strings)：引用计数减一（空指针不变），
+// 最后一个引用释放时依次释放字符串元素（strings 为真时）、元素数组和头部
+llvm::Function *CodeGenerator::getListReleaseFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_list_release")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *i1 = llvm::Type::getInt1Ty(*context);
+    llvm::StructType *listTy = getListStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_list_release",
+        llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy, i1}, false));
+    auto args = function->arg_begin();
+    llvm::Value *list = &*args++;
+    llvm::Value *strings = &*args++;
+    llvm::Function *freeFunc = module->getFunction("free");
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *releaseBB = llvm::BasicBlock::Create(*context, "release", function);
+    llvm::BasicBlock *lastBB = llvm::BasicBlock::Create(*context, "last", function);
+    llvm::BasicBlock *freeCondBB = llvm::BasicBlock::Create(*context, "free_cond", function);
+    llvm::BasicBlock *freeBodyBB = llvm::BasicBlock::Create(*context, "free_body", function);
+    llvm::BasicBlock *freeListBB = llvm::BasicBlock::Create(*context, "free_list", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(list), doneBB, releaseBB);
+
+    // 减一使用 acq_rel：其他线程对数组的写入在释放之前可见
+    builder->SetInsertPoint(releaseBB);
+    llvm::Value *refs = createCounterUpdate(*builder, builder->CreateStructGEP(listTy, list, LIST_REFS), -1,
+                                            llvm::AtomicOrdering::AcquireRelease);
+    builder->CreateCondBr(builder->CreateICmpEQ(refs, llvm::ConstantInt::get(i64, 1), "last"), lastBB, doneBB);
+
+    builder->SetInsertPoint(lastBB);
+    llvm::Value *size = builder->CreateLoad(i64, builder->CreateStructGEP(listTy, list, LIST_SIZE), "size");
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(listTy, list, LIST_DATA), "data");
+    builder->CreateCondBr(strings, freeCondBB, freeListBB);
+
+    builder->SetInsertPoint(freeCondBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    i->addIncoming(llvm::ConstantInt::get(i64, 0), lastBB);
+    builder->CreateCondBr(builder->CreateICmpULT(i, size), freeBodyBB, freeListBB);
+
+    builder->SetInsertPoint(freeBodyBB);
+    builder->CreateCall(freeFunc, {builder->CreateLoad(ptrTy, builder->CreateGEP(ptrTy, data, i), "element")});
+    i->addIncoming(builder->CreateAdd(i, llvm::ConstantInt::get(i64, 1)), freeBodyBB);
+    builder->CreateBr(freeCondBB);
+
+    builder->SetInsertPoint(freeListBB);
+    builder->CreateCall(freeFunc, {data});
+    builder->CreateCall(freeFunc, {list});
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// 检查元素类型并转换为动态数组的元素类型
+llvm::Value *CodeGenerator::convertListElement(llvm::Value *value, const std::string &listType, int lineNumber) {
+    std::string elementType = listElementType(listType);
+    if ((elementType == "string") != value->getType()->isPointerTy()) {
+        reportError("List element type mismatch: expected '" + elementType + "' but got '" +
+                    typeNameOf(value->getType()) + "'", lineNumber);
+        return nullptr;
+    }
+    llvm::Type *elementTy = getType(elementType);
+    if (value->getType() != elementTy) {
+        value = convertToType(value, elementTy);
+    }
+    return value;
+}
+
+// 追加一个元素：容量足够时直接写入，否则先调用 __ppx_list_grow（字符串元素保存副本）
+void CodeGenerator::emitListPush(llvm::Value *list, llvm::Value *value, const std::string &listType, bool copyString) {
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(listElementType(listType));
+    llvm::StructType *listTy = getListStructType();
+    uint64_t elementSize = module->getDataLayout().getTypeAllocSize(elementTy);
+
+    if (elementTy->isPointerTy() && copyString) {
+        llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+        value = builder->CreateCall(strdupFunc, {value}, "element_copy");
+    }
+
+    llvm::Value *sizePtr = builder->CreateStructGEP(listTy, list, LIST_SIZE);
+    llvm::Value *size = builder->CreateLoad(i64, sizePtr, "size");
+    llvm::Value *capacity = builder->CreateLoad(i64, builder->CreateStructGEP(listTy, list, LIST_CAPACITY), "capacity");
+    llvm::Value *newSize = builder->CreateAdd(size, llvm::ConstantInt::get(i64, 1), "new_size");
+
+    llvm::BasicBlock *growBB = llvm::BasicBlock::Create(*context, "list_grow", function);
+    llvm::BasicBlock *storeBB = llvm::BasicBlock::Create(*context, "list_store", function);
+    builder->CreateCondBr(builder->CreateICmpEQ(size, capacity), growBB, storeBB);
+
+    builder->SetInsertPoint(growBB);
+    builder->CreateCall(getListGrowFunction(), {list, llvm::ConstantInt::get(i64, elementSize), newSize});
+    builder->CreateBr(storeBB);
+
+    builder->SetInsertPoint(storeBB);
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(listTy, list, LIST_DATA), "data");
+    builder->CreateStore(value, builder->CreateGEP(elementTy, data, size, "element_ptr"));
+    builder->CreateStore(newSize, sizePtr);
+}
+
+// 生成动态数组字面量：按元素数量分配容量后依次追加
+llvm::Value *CodeGenerator::codegenListLiteral(ArrayLiteralNode *node, const std::string &listType) {
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(listElementType(listType));
+
+    if (g_verbose) {
+        std::cout << "[IR Gen] List literal: " << listType << " with " << node->elements.size() << " elements" << std::endl;
+    }
+
+    std::vector<llvm::Value *> elements;
+    for (auto &element : node->elements) {
+        if (dynamic_cast<ArrayLiteralNode *>(element.get())) {
+            reportError("List element type mismatch: expected '" + listElementType(listType) + "' but got 'array'", node->lineNumber);
+            return nullptr;
+        }
+        llvm::Value *value = codegenExpr(element.get());
+        if (!value) {
+            return nullptr;
+        }
+        value = convertListElement(value, listType, node->lineNumber);
+        if (!value) {
+            return nullptr;
+        }
+        elements.push_back(value);
+    }
+
+    llvm::Value *list = builder->CreateCall(getListNewFunction(), {
+        llvm::ConstantInt::get(i64, module->getDataLayout().getTypeAllocSize(elementTy)),
+        llvm::ConstantInt::get(i64, std::max<uint64_t>(elements.size(), CodeGenConstants::LIST_MIN_CAPACITY))}, "list");
+    for (llvm::Value *value : elements) {
+        emitListPush(list, value, listType);
+    }
+    pushTempReference(list, listType);
+    return list;
+}
+
+// 索引在 [0, size) 内时跳转到 inBoundsBB，否则输出运行时错误后跳转到 errorBB
+llvm::Value *CodeGenerator::emitListBoundsCheck(llvm::Value *list, llvm::Value *index,
+                                                llvm::BasicBlock *inBoundsBB, llvm::BasicBlock *errorBB) {
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Value *index64 = builder->CreateSExtOrTrunc(index, i64, "index64");
+    llvm::Value *size = builder->CreateLoad(i64, builder->CreateStructGEP(getListStructType(), list, LIST_SIZE), "size");
+
+    llvm::BasicBlock *reportBB = llvm::BasicBlock::Create(*context, "bounds_error", function);
+    llvm::Value *inBounds = omitRuntimeCheck() ? builder->getTrue() : builder->CreateICmpULT(index64, size, "in_bounds");
+    builder->CreateCondBr(inBounds, inBoundsBB, reportBB);
+
+    builder->SetInsertPoint(reportBB);
+    llvm::Value *errorMsg = builder->CreateGlobalString("Runtime Error: Array index out of bounds\n", "", 0, module.get());
+    builder->CreateCall(getPrintfFunction(), {errorMsg});
+    builder->CreateBr(errorBB);
+    return index64;
+}
+
+// a[i]：越界时报告运行时错误并返回默认值（与静态数组一致）
+llvm::Value *CodeGenerator::codegenListGet(ArrayAccessNode *node, const std::string &listType) {
+    llvm::Value *list = codegenExpr(node->array.get());
+    llvm::Value *index = codegenExpr(node->index.get());
+    if (!list || !index) {
+        return nullptr;
+    }
+    if (!index->getType()->isIntegerTy()) {
+        reportError("Array index must be integer type", node->lineNumber);
+        return nullptr;
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::Type *elementTy = getType(listElementType(listType));
+    llvm::BasicBlock *accessBB = llvm::BasicBlock::Create(*context, "list_access", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "list_default", function);
+    llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*context, "list_merge", function);
+    llvm::Value *index64 = emitListBoundsCheck(list, index, accessBB, errorBB);
+
+    builder->SetInsertPoint(accessBB);
+    llvm::Value *data = builder->CreateLoad(llvm::PointerType::get(*context, 0),
+                                            builder->CreateStructGEP(getListStructType(), list, LIST_DATA), "data");
+    llvm::Value *value = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, index64), "element");
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(errorBB);
+    llvm::Value *defaultValue = elementTy->isPointerTy()
+                                    ? builder->CreateGlobalString("", "", 0, module.get())
+                                    : llvm::Constant::getNullValue(elementTy);
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(mergeBB);
+    llvm::PHINode *phi = builder->CreatePHI(elementTy, 2, "list_get");
+    phi->addIncoming(value, accessBB);
+    phi->addIncoming(defaultValue, errorBB);
+    if (elementTy->isPointerTy()) {
+        fn->borrowedStrings.insert(phi);
+    }
+    return phi;
+}
+
+// a[i] = v 以及 a[i] += v 等复合赋值：越界时报告运行时错误，不写入
+void CodeGenerator::codegenListSet(AssignmentNode *node, const std::string &listType) {
+    auto target = static_cast<ArrayAccessNode *>(node->target.get());
+    llvm::Value *list = codegenExpr(target->array.get());
+    llvm::Value *index = codegenExpr(target->index.get());
+    llvm::Value *value = codegenExpr(node->value.get());
+    if (!list || !index || !value) {
+        return;
+    }
+    if (!index->getType()->isIntegerTy()) {
+        reportError("Array index must be integer type", node->lineNumber);
+        return;
+    }
+    value = convertListElement(value, listType, node->lineNumber);
+    if (!value) {
+        return;
+    }
+    llvm::Type *elementTy = getType(listElementType(listType));
+    if (elementTy->isPointerTy() && node->op != "=") {
+        reportError("Compound assignment '" + node->op + "' is not supported for string list elements", node->lineNumber);
+        return;
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *storeBB = llvm::BasicBlock::Create(*context, "list_set", function);
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(*context, "list_set_done", function);
+    llvm::Value *index64 = emitListBoundsCheck(list, index, storeBB, afterBB);
+
+    builder->SetInsertPoint(storeBB);
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(getListStructType(), list, LIST_DATA), "data");
+    llvm::Value *ptr = builder->CreateGEP(elementTy, data, index64, "element_ptr");
+    if (elementTy->isPointerTy()) {
+        // 动态数组保存字符串的副本，覆盖时释放旧值（先复制：新值可能就是旧值，如 a[i] = a[i]）
+        llvm::Value *oldVal = builder->CreateLoad(elementTy, ptr, "oldval");
+        llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+        value = builder->CreateCall(strdupFunc, {value}, "element_copy");
+        builder->CreateCall(module->getFunction("free"), {oldVal});
+    } else if (node->op != "=") {
+        llvm::Value *oldVal = builder->CreateLoad(elementTy, ptr, "oldval");
+        value = applyCompoundAssign(node->op, oldVal, value);
+        if (value->getType() != elementTy) {
+            value = convertToType(value, elementTy);
+        }
+    }
+    builder->CreateStore(value, ptr);
+    builder->CreateBr(afterBB);
+
+    builder->SetInsertPoint(afterBB);
+    clearTempMemory();
+}
+
+// push(a, v) / pop(a) / reserve(a, n)，也可以写作 a.push(v) 等；参数从 node->arguments[firstArg] 开始
+llvm::Value *CodeGenerator::codegenListBuiltin(FunctionCallNode *node, ExprNode *listExpr,
+                                               size_t firstArg, const std::string &listType) {
+    const std::string &name = node->functionName;
+    size_t expected = name == "pop" ? 0 : 1;
+    if (node->arguments.size() - firstArg != expected) {
+        reportError(name + "() expects " + std::to_string(expected + 1) + " arguments (list" +
+                    (name == "push" ? ", value)" : name == "reserve" ? ", capacity)" : ")"), node->lineNumber);
+        return nullptr;
+    }
+    llvm::Value *list = codegenExpr(listExpr);
+    if (!list) {
+        return nullptr;
+    }
+
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(listElementType(listType));
+    llvm::StructType *listTy = getListStructType();
+
+    if (name == "push") {
+        llvm::Value *value = codegenExpr(node->arguments[firstArg].get());
+        if (!value) {
+            return nullptr;
+        }
+        value = convertListElement(value, listType, node->lineNumber);
+        if (!value) {
+            return nullptr;
+        }
+        emitListPush(list, value, listType);
+        llvm::Value *size = builder->CreateLoad(i64, builder->CreateStructGEP(listTy, list, LIST_SIZE), "size");
+        return builder->CreateTrunc(size, i32, "len");
+    }
+
+    if (name == "reserve") {
+        llvm::Value *capacity = codegenExpr(node->arguments[firstArg].get());
+        if (!capacity) {
+            return nullptr;
+        }
+        if (!capacity->getType()->isIntegerTy()) {
+            reportError("reserve() expects an integer capacity", node->lineNumber);
+            return nullptr;
+        }
+        // 负数按 0 处理
+        capacity = builder->CreateSExtOrTrunc(capacity, i64, "capacity");
+        capacity = builder->CreateSelect(builder->CreateICmpSLT(capacity, llvm::ConstantInt::get(i64, 0)),
+                                         llvm::ConstantInt::get(i64, 0), capacity);
+        uint64_t elementSize = module->getDataLayout().getTypeAllocSize(elementTy);
+        return builder->CreateCall(getListGrowFunction(), {list, llvm::ConstantInt::get(i64, elementSize), capacity});
+    }
+
+    // pop：移除并返回最后一个元素，空数组报告运行时错误并返回默认值
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *popBB = llvm::BasicBlock::Create(*context, "list_pop", function);
+    llvm::BasicBlock *emptyBB = llvm::BasicBlock::Create(*context, "list_empty", function);
+    llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*context, "list_pop_done", function);
+    llvm::Value *sizePtr = builder->CreateStructGEP(listTy, list, LIST_SIZE);
+    llvm::Value *size = builder->CreateLoad(i64, sizePtr, "size");
+    builder->CreateCondBr(builder->CreateICmpEQ(size, llvm::ConstantInt::get(i64, 0)), emptyBB, popBB);
+
+    builder->SetInsertPoint(popBB);
+    llvm::Value *last = builder->CreateSub(size, llvm::ConstantInt::get(i64, 1), "last");
+    builder->CreateStore(last, sizePtr);
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(listTy, list, LIST_DATA), "data");
+    llvm::Value *value = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, last), "popped");
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(emptyBB);
+    llvm::Value *errorMsg = builder->CreateGlobalString("Runtime Error: Pop from empty list\n", "", 0, module.get());
+    builder->CreateCall(getPrintfFunction(), {errorMsg});
+    llvm::Value *defaultValue = llvm::Constant::getNullValue(elementTy);
+    if (elementTy->isPointerTy()) {
+        // 弹出的字符串归调用方所有，默认值也需要是堆上的副本
+        llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+        defaultValue = builder->CreateCall(strdupFunc, {builder->CreateGlobalString("", "", 0, module.get())}, "empty");
+    }
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(mergeBB);
+    llvm::PHINode *phi = builder->CreatePHI(elementTy, 2, "pop");
+    phi->addIncoming(value, popBB);
+    phi->addIncoming(defaultValue, emptyBB);
+    if (elementTy->isPointerTy()) {
+        // 与其他返回新字符串的表达式一样作为临时内存，赋值给变量时转移所有权
+        pushTempMemory(phi);
+    }
+    return phi;
+}
+
+// a[from..to]：复制 [from, to) 到新的动态数组，范围无效时报告运行时错误并返回空数组
+// 不是动态数组的对象按字符串切片处理
+llvm::Value *CodeGenerator::codegenSlice(SliceNode *node) {
+    std::string listType = declaredTypeOf(node->object.get());
+    if (!isListType(listType)) {
+        return codegenStringSlice(node);
+    }
+    llvm::Value *list = codegenExpr(node->object.get());
+    if (!list) {
+        return nullptr;
+    }
+
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *listTy = getListStructType();
+    llvm::Value *size = builder->CreateLoad(i64, builder->CreateStructGEP(listTy, list, LIST_SIZE), "size");
+    llvm::Value *from = nullptr;
+    llvm::Value *to = nullptr;
+    if (!emitSliceBounds(node, size, from, to)) {
+        return nullptr;
+    }
+
+    llvm::Type *elementTy = getType(listElementType(listType));
+    llvm::Value *slice = builder->CreateCall(getListSliceFunction(), {
+        list,
+        llvm::ConstantInt::get(i64, module->getDataLayout().getTypeAllocSize(elementTy)),
+        from, to,
+        builder->getInt1(elementTy->isPointerTy())}, "slice");
+    pushTempReference(slice, listType);
+    return slice;
+}
+
+// 求值切片边界（省略时为 0 和 size），范围无效时报告运行时错误并使用 [0, 0)
+bool CodeGenerator::emitSliceBounds(SliceNode *node, llvm::Value *size, llvm::Value *&from, llvm::Value *&to) {
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Value *bounds[2] = {llvm::ConstantInt::get(i64, 0), size};
+    ExprNode *boundNodes[2] = {node->from.get(), node->to.get()};
+    for (int i = 0; i < 2; i++) {
+        if (!boundNodes[i]) {
+            continue;
+        }
+        llvm::Value *bound = codegenExpr(boundNodes[i]);
+        if (!bound) {
+            return false;
+        }
+        if (!bound->getType()->isIntegerTy()) {
+            reportError("Slice bounds must be integer type", node->lineNumber);
+            return false;
+        }
+        bounds[i] = builder->CreateSExtOrTrunc(bound, i64, i == 0 ? "from" : "to");
+    }
+
+    // 0 <= from <= to <= size：无符号比较同时排除负数
+    llvm::Value *valid = builder->CreateAnd(builder->CreateICmpULE(bounds[0], bounds[1]),
+                                            builder->CreateICmpULE(bounds[1], size), "slice_valid");
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "slice_error", function);
+    llvm::BasicBlock *copyBB = llvm::BasicBlock::Create(*context, "slice_copy", function);
+    llvm::BasicBlock *checkBB = builder->GetInsertBlock();
+    builder->CreateCondBr(valid, copyBB, errorBB);
+
+    builder->SetInsertPoint(errorBB);
+    llvm::Value *errorMsg = builder->CreateGlobalString("Runtime Error: Slice out of bounds\n", "", 0, module.get());
+    builder->CreateCall(getPrintfFunction(), {errorMsg});
+    builder->CreateBr(copyBB);
+
+    builder->SetInsertPoint(copyBB);
+    llvm::PHINode *fromPhi = builder->CreatePHI(i64, 2, "from");
+    fromPhi->addIncoming(bounds[0], checkBB);
+    fromPhi->addIncoming(llvm::ConstantInt::get(i64, 0), errorBB);
+    llvm::PHINode *toPhi = builder->CreatePHI(i64, 2, "to");
+    toPhi->addIncoming(bounds[1], checkBB);
+    toPhi->addIncoming(llvm::ConstantInt::get(i64, 0), errorBB);
+    from = fromPhi;
+    to = toPhi;
+    return true;
+}
+
+// 字符串切片视图
+//
+// s[a..b] 的值是指向原字符串内部的指针加上长度，不分配内存。print、len、${...}、比较和 + 直接使用视图，
+// 嵌套切片在视图上继续切片；只有赋值给变量、作为参数传递或返回等需要独立字符串的位置才复制为
+// 以 NUL 结尾的新字符串（与拼接结果一样是临时内存，赋值给变量时转移所有权）。
+
+bool CodeGenerator::isStringSlice(ExprNode *node) {
+    auto slice = dynamic_cast<SliceNode *>(node);
+    return slice && !isListType(declaredTypeOf(slice->object.get()));
+}
+
+llvm::Value *CodeGenerator::codegenStringView(ExprNode *node, llvm::Value *&length) {
+    length = nullptr;
+    // trim() 的结果也是视图
+    if (auto call = dynamic_cast<FunctionCallNode *>(node)) {
+        ExprNode *subject = nullptr;
+        size_t firstArg = 0;
+        if (call->functionName == "trim" && stringBuiltinCall(call, subject, firstArg)) {
+            return codegenStringBuiltin(call, subject, firstArg, &length);
+        }
+    }
+    if (!isStringSlice(node)) {
+        return codegenExpr(node);
+    }
+    auto slice = static_cast<SliceNode *>(node);
+
+    std::string objectType = declaredTypeOf(slice->object.get());
+    if (!objectType.empty() && objectType != "string") {
+        reportError("Cannot slice a value of type '" + objectType + "'", slice->lineNumber);
+        return nullptr;
+    }
+    llvm::Value *baseLength = nullptr;
+    llvm::Value *base = codegenStringView(slice->object.get(), baseLength);
+    if (!base) {
+        return nullptr;
+    }
+    if (!base->getType()->isPointerTy()) {
+        llvm::Type *type = base->getType();
+        std::string typeName = type->isIntegerTy(32) ? "int" : type->isDoubleTy() ? "double"
+                             : type->isIntegerTy(8) ? "char" : type->isIntegerTy(1) ? "bool" : "unknown";
+        reportError("Cannot slice a value of type '" + typeName + "'", slice->lineNumber);
+        return nullptr;
+    }
+
+    llvm::Value *from = nullptr;
+    llvm::Value *to = nullptr;
+    if (!emitSliceBounds(slice, stringViewLength(base, baseLength), from, to)) {
+        return nullptr;
+    }
+    length = builder->CreateSub(to, from, "view_len", true, true);
+    return builder->CreateInBoundsGEP(builder->getInt8Ty(), base, from, "view");
+}
+
+llvm::Value *CodeGenerator::stringViewLength(llvm::Value *data, llvm::Value *length) {
+    if (length) {
+        return length;
+    }
+    return builder->CreateCall(getStrlenFunction(), {data}, "strlen");
+}
+
+llvm::Value *CodeGenerator::codegenStringSlice(SliceNode *node) {
+    llvm::Value *length = nullptr;
+    llvm::Value *data = codegenStringView(node, length);
+    if (!data) {
+        return nullptr;
+    }
+    return materializeStringView(data, length);
+}
+
+llvm::Value *CodeGenerator::materializeStringView(llvm::Value *data, llvm::Value *length) {
+    if (g_verbose) {
+        std::cout << "[IR Gen] String slice copied to a new string" << std::endl;
+    }
+    llvm::Value *copy = emitStringCopy(data, length);
+    pushTempMemory(copy);
+    return copy;
+}
+
+llvm::Value *CodeGenerator::emitStringCopy(llvm::Value *data, llvm::Value *length) {
+    llvm::Value *size = builder->CreateAdd(length, builder->getInt64(1), "copy_size");
+    llvm::Value *copy = builder->CreateCall(module->getFunction("malloc"), {size}, "str_copy");
+    builder->CreateMemCpy(copy, llvm::MaybeAlign(1), data, llvm::MaybeAlign(1), length);
+    builder->CreateStore(builder->getInt8(0), builder->CreateInBoundsGEP(builder->getInt8Ty(), copy, length));
+    return copy;
+}
+
+// 拼接：按已知长度 memcpy，结果为临时内存
+llvm::Value *CodeGenerator::emitStringConcat(llvm::Value *left, llvm::Value *leftLength,
+                                             llvm::Value *right, llvm::Value *rightLength) {
+    llvm::Value *len1 = stringViewLength(left, leftLength);
+    llvm::Value *len2 = stringViewLength(right, rightLength);
+    llvm::Value *totalLen = builder->CreateAdd(len1, len2, "totallen");
+    llvm::Value *newStr = builder->CreateCall(module->getFunction("malloc"),
+                                              {builder->CreateAdd(totalLen, builder->getInt64(1), "totallen_plus1")},
+                                              "newstr");
+    builder->CreateMemCpy(newStr, llvm::MaybeAlign(1), left, llvm::MaybeAlign(1), len1);
+    builder->CreateMemCpy(builder->CreateInBoundsGEP(builder->getInt8Ty(), newStr, len1), llvm::MaybeAlign(1),
+                          right, llvm::MaybeAlign(1), len2);
+    builder->CreateStore(builder->getInt8(0), builder->CreateInBoundsGEP(builder->getInt8Ty(), newStr, totalLen));
+
+    // 追踪临时内存，稍后自动释放
+    pushTempMemory(newStr);
+    return newStr;
+}
+
+// 比较：两个完整字符串使用 strcmp；有视图时 memcmp 公共前缀，相同则较短的较小
+llvm::Value *CodeGenerator::emitStringCompare(const std::string &op, llvm::Value *left, llvm::Value *leftLength,
+                                              llvm::Value *right, llvm::Value *rightLength) {
+    llvm::Type *i32 = builder->getInt32Ty();
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Value *cmp = nullptr;
+    if (!leftLength && !rightLength) {
+        llvm::FunctionCallee strcmpFunc = module->getOrInsertFunction("strcmp", i32, ptrTy, ptrTy);
+        cmp = builder->CreateCall(strcmpFunc, {left, right}, "strcmp");
+    } else {
+        llvm::Value *len1 = stringViewLength(left, leftLength);
+        llvm::Value *len2 = stringViewLength(right, rightLength);
+        llvm::Value *common = builder->CreateSelect(builder->CreateICmpULT(len1, len2), len1, len2, "common_len");
+        llvm::FunctionCallee memcmpFunc = module->getOrInsertFunction("memcmp", i32, ptrTy, ptrTy, builder->getInt64Ty());
+        llvm::Value *prefix = builder->CreateCall(memcmpFunc, {left, right, common}, "memcmp");
+        llvm::Value *byLength = builder->CreateSub(builder->CreateZExt(builder->CreateICmpUGT(len1, len2), i32),
+                                                   builder->CreateZExt(builder->CreateICmpULT(len1, len2), i32),
+                                                   "len_cmp");
+        cmp = builder->CreateSelect(builder->CreateICmpEQ(prefix, builder->getInt32(0)), byLength, prefix, "strcmp");
+    }
+
+    llvm::Value *zero = builder->getInt32(0);
+    if (op == "==") return builder->CreateICmpEQ(cmp, zero, "eqtmp");
+    if (op == "!=") return builder->CreateICmpNE(cmp, zero, "netmp");
+    if (op == "<") return builder->CreateICmpSLT(cmp, zero, "lttmp");
+    if (op == ">") return builder->CreateICmpSGT(cmp, zero, "gttmp");
+    if (op == "<=") return builder->CreateICmpSLE(cmp, zero, "letmp");
+    return builder->CreateICmpSGE(cmp, zero, "getmp");
+}
+
+// 字符串运行时
+//
+// 子串查找以 memchr 定位子串的首字节，再用 memcmp 比较其余字节：C 库的 memchr/memcmp 在运行时按 CPU 选择
+// SSE2/AVX2 等向量实现（glibc 通过 ifunc 分派，不支持时使用标量实现），逐字节的比较只发生在首字节命中的位置。
+// count/split/replace 在 __ppx_str_find 之上循环；大小写转换与映射的控制字节组一样按 8 字节一组无分支地处理。
+
+// i64 __ppx_str_find(ptr s, i64 len, ptr sub, i64 subLen, i64 from)：从 from 开始第一次出现的位置，没有时为 -1
+llvm::Function *CodeGenerator::getStringFindFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_str_find")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_str_find", llvm::FunctionType::get(i64, {ptrTy, i64, ptrTy, i64, i64}, false));
+    auto args = function->arg_begin();
+    llvm::Value *str = &*args++;
+    llvm::Value *length = &*args++;
+    llvm::Value *sub = &*args++;
+    llvm::Value *subLength = &*args++;
+    llvm::Value *from = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *emptyBB = llvm::BasicBlock::Create(*context, "empty_sub", function);
+    llvm::BasicBlock *searchBB = llvm::BasicBlock::Create(*context, "search", function);
+    llvm::BasicBlock *scanBB = llvm::BasicBlock::Create(*context, "scan", function);
+    llvm::BasicBlock *chrBB = llvm::BasicBlock::Create(*context, "memchr", function);
+    llvm::BasicBlock *candidateBB = llvm::BasicBlock::Create(*context, "candidate", function);
+    llvm::BasicBlock *foundBB = llvm::BasicBlock::Create(*context, "found", function);
+    llvm::BasicBlock *notFoundBB = llvm::BasicBlock::Create(*context, "not_found", function);
+    llvm::FunctionCallee memchrFunc = module->getOrInsertFunction("memchr", ptrTy, ptrTy, i32, i64);
+    llvm::FunctionCallee memcmpFunc = module->getOrInsertFunction("memcmp", i32, ptrTy, ptrTy, i64);
+    llvm::Value *minusOne = llvm::ConstantInt::get(i64, -1);
+
+    // 空子串出现在 from 处（from 不超过长度时）
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(subLength, llvm::ConstantInt::get(i64, 0)), emptyBB, searchBB);
+
+    builder->SetInsertPoint(emptyBB);
+    builder->CreateRet(builder->CreateSelect(builder->CreateICmpULE(from, length), from, minusOne));
+
+    // 子串只可能从 [from, len - subLen] 开始
+    builder->SetInsertPoint(searchBB);
+    llvm::Value *first = builder->CreateZExt(builder->CreateLoad(i8, sub, "first"), i32);
+    llvm::Value *fits = builder->CreateICmpULE(subLength, length, "fits");
+    llvm::Value *last = builder->CreateSub(length, subLength, "last");
+    builder->CreateCondBr(fits, scanBB, notFoundBB);
+
+    builder->SetInsertPoint(scanBB);
+    llvm::PHINode *pos = builder->CreatePHI(i64, 2, "pos");
+    pos->addIncoming(from, searchBB);
+    builder->CreateCondBr(builder->CreateICmpULE(pos, last), chrBB, notFoundBB);
+
+    builder->SetInsertPoint(chrBB);
+    llvm::Value *window = builder->CreateAdd(builder->CreateSub(last, pos), llvm::ConstantInt::get(i64, 1), "window");
+    llvm::Value *hit = builder->CreateCall(memchrFunc, {builder->CreateGEP(i8, str, pos), first, window}, "hit");
+    builder->CreateCondBr(builder->CreateICmpEQ(hit, llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0))),
+                          notFoundBB, candidateBB);
+
+    builder->SetInsertPoint(candidateBB);
+    llvm::Value *index = builder->CreateSub(builder->CreatePtrToInt(hit, i64), builder->CreatePtrToInt(str, i64), "index");
+    llvm::Value *rest = builder->CreateSub(subLength, llvm::ConstantInt::get(i64, 1), "rest");
+    llvm::Value *cmp = builder->CreateCall(memcmpFunc, {builder->CreateGEP(i8, hit, llvm::ConstantInt::get(i64, 1)),
+                                                        builder->CreateGEP(i8, sub, llvm::ConstantInt::get(i64, 1)), rest}, "cmp");
+    pos->addIncoming(builder->CreateAdd(index, llvm::ConstantInt::get(i64, 1)), candidateBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(cmp, llvm::ConstantInt::get(i32, 0)), foundBB, scanBB);
+
+    builder->SetInsertPoint(foundBB);
+    builder->CreateRet(index);
+
+    builder->SetInsertPoint(notFoundBB);
+    builder->CreateRet(minusOne);
+    return function;
+}
+
+// i64 __ppx_str_count(ptr s, i64 len, ptr sub, i64 subLen)：不重叠的出现次数（空子串为 len + 1）
+llvm::Function *CodeGenerator::getStringCountFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_str_count")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *findFunc = getStringFindFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_str_count", llvm::FunctionType::get(i64, {ptrTy, i64, ptrTy, i64}, false));
+    auto args = function->arg_begin();
+    llvm::Value *str = &*args++;
+    llvm::Value *length = &*args++;
+    llvm::Value *sub = &*args++;
+    llvm::Value *subLength = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *emptyBB = llvm::BasicBlock::Create(*context, "empty_sub", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(subLength, llvm::ConstantInt::get(i64, 0)), emptyBB, loopBB);
+
+    builder->SetInsertPoint(emptyBB);
+    builder->CreateRet(builder->CreateAdd(length, llvm::ConstantInt::get(i64, 1)));
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *pos = builder->CreatePHI(i64, 2, "pos");
+    llvm::PHINode *count = builder->CreatePHI(i64, 2, "count");
+    pos->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    count->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    llvm::Value *index = builder->CreateCall(findFunc, {str, length, sub, subLength, pos}, "index");
+    pos->addIncoming(builder->CreateAdd(index, subLength), loopBB);
+    count->addIncoming(builder->CreateAdd(count, llvm::ConstantInt::get(i64, 1)), loopBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(index, llvm::ConstantInt::get(i64, 0)), doneBB, loopBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(count);
+    return function;
+}
+
+// ptr __ppx_str_split(ptr s, i64 len, ptr sep, i64 sepLen)：按分隔符拆分为 list<string>（空分隔符时只有一个元素）
+llvm::Function *CodeGenerator::getStringSplitFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_str_split")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *findFunc = getStringFindFunction();
+    llvm::Function *newFunc = getListNewFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_str_split", llvm::FunctionType::get(ptrTy, {ptrTy, i64, ptrTy, i64}, false));
+    auto args = function->arg_begin();
+    llvm::Value *str = &*args++;
+    llvm::Value *length = &*args++;
+    llvm::Value *sep = &*args++;
+    llvm::Value *sepLength = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *list = builder->CreateCall(newFunc, {llvm::ConstantInt::get(i64, 8),
+                                                      llvm::ConstantInt::get(i64, CodeGenConstants::LIST_MIN_CAPACITY)}, "list");
+    llvm::Value *noSeparator = builder->CreateICmpEQ(sepLength, llvm::ConstantInt::get(i64, 0), "no_separator");
+    builder->CreateBr(loopBB);
+
+    // 每轮取出 [start, 下一个分隔符) 的副本，所有权直接交给动态数组
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *start = builder->CreatePHI(i64, 2, "start");
+    start->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    llvm::Value *index = builder->CreateCall(findFunc, {str, length, sep, sepLength, start}, "index");
+    index = builder->CreateSelect(noSeparator, llvm::ConstantInt::get(i64, -1), index, "index");
+    llvm::Value *isLast = builder->CreateICmpSLT(index, llvm::ConstantInt::get(i64, 0), "is_last");
+    llvm::Value *end = builder->CreateSelect(isLast, length, index, "end");
+    llvm::Value *piece = emitStringCopy(builder->CreateGEP(i8, str, start), builder->CreateSub(end, start));
+    emitListPush(list, piece, "list<string>", false);
+    llvm::BasicBlock *pushedBB = builder->GetInsertBlock();
+    start->addIncoming(builder->CreateAdd(index, sepLength, "next"), pushedBB);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    builder->CreateCondBr(isLast, doneBB, loopBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(list);
+    return function;
+}
+
+// ptr __ppx_str_replace(ptr s, i64 len, ptr old, i64 oldLen, ptr new, i64 newLen)：替换所有不重叠的出现，返回新字符串
+// 先计数再一次分配结果（空的 old 时返回副本）
+llvm::Function *CodeGenerator::getStringReplaceFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_str_replace")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *findFunc = getStringFindFunction();
+    llvm::Function *countFunc = getStringCountFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_str_replace", llvm::FunctionType::get(ptrTy, {ptrTy, i64, ptrTy, i64, ptrTy, i64}, false));
+    auto args = function->arg_begin();
+    llvm::Value *str = &*args++;
+    llvm::Value *length = &*args++;
+    llvm::Value *oldStr = &*args++;
+    llvm::Value *oldLength = &*args++;
+    llvm::Value *newStr = &*args++;
+    llvm::Value *newLength = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *copyBB = llvm::BasicBlock::Create(*context, "copy", function);
+    llvm::BasicBlock *allocBB = llvm::BasicBlock::Create(*context, "alloc", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *replaceBB = llvm::BasicBlock::Create(*context, "replace", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(oldLength, llvm::ConstantInt::get(i64, 0)), copyBB, allocBB);
+
+    builder->SetInsertPoint(copyBB);
+    builder->CreateRet(emitStringCopy(str, length));
+
+    builder->SetInsertPoint(allocBB);
+    llvm::Value *count = builder->CreateCall(countFunc, {str, length, oldStr, oldLength}, "count");
+    llvm::Value *total = builder->CreateAdd(length, builder->CreateMul(count, builder->CreateSub(newLength, oldLength)), "total");
+    llvm::Value *result = builder->CreateCall(module->getFunction("malloc"),
+                                              {builder->CreateAdd(total, llvm::ConstantInt::get(i64, 1))}, "result");
+    builder->CreateBr(loopBB);
+
+    // 复制到下一个 old 之前的部分，再写入 new
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *src = builder->CreatePHI(i64, 2, "src");
+    llvm::PHINode *dst = builder->CreatePHI(i64, 2, "dst");
+    src->addIncoming(llvm::ConstantInt::get(i64, 0), allocBB);
+    dst->addIncoming(llvm::ConstantInt::get(i64, 0), allocBB);
+    llvm::Value *index = builder->CreateCall(findFunc, {str, length, oldStr, oldLength, src}, "index");
+    llvm::Value *isLast = builder->CreateICmpSLT(index, llvm::ConstantInt::get(i64, 0), "is_last");
+    llvm::Value *end = builder->CreateSelect(isLast, length, index, "end");
+    llvm::Value *chunk = builder->CreateSub(end, src, "chunk");
+    builder->CreateMemCpy(builder->CreateGEP(i8, result, dst), llvm::MaybeAlign(1),
+                          builder->CreateGEP(i8, str, src), llvm::MaybeAlign(1), chunk);
+    llvm::Value *chunkEnd = builder->CreateAdd(dst, chunk, "chunk_end");
+    builder->CreateCondBr(isLast, doneBB, replaceBB);
+
+    builder->SetInsertPoint(replaceBB);
+    builder->CreateMemCpy(builder->CreateGEP(i8, result, chunkEnd), llvm::MaybeAlign(1), newStr, llvm::MaybeAlign(1), newLength);
+    src->addIncoming(builder->CreateAdd(index, oldLength), replaceBB);
+    dst->addIncoming(builder->CreateAdd(chunkEnd, newLength), replaceBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateStore(llvm::ConstantInt::get(i8, 0), builder->CreateGEP(i8, result, chunkEnd));
+    builder->CreateRet(result);
+    return function;
+}
+
+// ptr __ppx_str_upper(ptr s, i64 len) / __ppx_str_lower：ASCII 大小写转换，返回新字符串
+llvm::Function *CodeGenerator::getStringCaseFunction(bool upper) {
+    const char *name = upper ? "__ppx_str_upper" : "__ppx_str_lower";
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(ptrTy, {ptrTy, i64}, false));
+    auto args = function->arg_begin();
+    llvm::Value *str = &*args++;
+    llvm::Value *length = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "cond", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "body", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    llvm::BasicBlock *blockCondBB = llvm::BasicBlock::Create(*context, "block_cond", function);
+    llvm::BasicBlock *blockBodyBB = llvm::BasicBlock::Create(*context, "block_body", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *result = builder->CreateCall(module->getFunction("malloc"),
+                                              {builder->CreateAdd(length, llvm::ConstantInt::get(i64, 1))}, "result");
+    builder->CreateBr(blockCondBB);
+
+    // 每次转换 STRING_CASE_LANES 个字节：与逐字节的写法相同，c - first < 26 的字节翻转 0x20 位，
+    // 比较和选择作用于字节向量
+    const unsigned lanes = CodeGenConstants::STRING_CASE_LANES;
+    llvm::Type *blockTy = llvm::FixedVectorType::get(i8, lanes);
+    builder->SetInsertPoint(blockCondBB);
+    llvm::PHINode *block = builder->CreatePHI(i64, 2, "block");
+    block->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    llvm::Value *blockEnd = builder->CreateAdd(block, llvm::ConstantInt::get(i64, lanes), "block_end");
+    builder->CreateCondBr(builder->CreateICmpULE(blockEnd, length), blockBodyBB, condBB);
+
+    builder->SetInsertPoint(blockBodyBB);
+    llvm::Value *bytes = builder->CreateAlignedLoad(blockTy, builder->CreateGEP(i8, str, block), llvm::MaybeAlign(1), "bytes");
+    llvm::Value *offsets = builder->CreateSub(bytes, builder->CreateVectorSplat(lanes, builder->getInt8(upper ? 'a' : 'A')));
+    llvm::Value *letters = builder->CreateICmpULT(offsets, builder->CreateVectorSplat(lanes, builder->getInt8(26)), "letters");
+    llvm::Value *flipped = builder->CreateXor(bytes, builder->CreateVectorSplat(lanes, builder->getInt8(0x20)));
+    builder->CreateAlignedStore(builder->CreateSelect(letters, flipped, bytes), builder->CreateGEP(i8, result, block),
+                                llvm::MaybeAlign(1));
+    block->addIncoming(blockEnd, blockBodyBB);
+    builder->CreateBr(blockCondBB);
+
+    // 剩余不足一组的字节逐个转换
+    builder->SetInsertPoint(condBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    i->addIncoming(block, blockCondBB);
+    builder->CreateCondBr(builder->CreateICmpULT(i, length), bodyBB, doneBB);
+
+    // 'a'..'z'（或 'A'..'Z'）范围内的字节翻转 0x20 位：c - first < 26 用一次无符号比较判断
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *c = builder->CreateLoad(i8, builder->CreateGEP(i8, str, i), "c");
+    llvm::Value *offset = builder->CreateSub(c, llvm::ConstantInt::get(i8, upper ? 'a' : 'A'));
+    llvm::Value *inRange = builder->CreateICmpULT(offset, llvm::ConstantInt::get(i8, 26), "in_range");
+    llvm::Value *converted = builder->CreateSelect(inRange, builder->CreateXor(c, llvm::ConstantInt::get(i8, 0x20)), c);
+    builder->CreateStore(converted, builder->CreateGEP(i8, result, i));
+    i->addIncoming(builder->CreateAdd(i, llvm::ConstantInt::get(i64, 1)), bodyBB);
+    builder->CreateBr(condBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateStore(llvm::ConstantInt::get(i8, 0), builder->CreateGEP(i8, result, length));
+    builder->CreateRet(result);
+    return function;
+}
+
+// i64 __ppx_str_trim_start(ptr s, i64 len, i64 limit)：第一个非空白字节的位置（不超过 limit 时为 limit）
+// i64 __ppx_str_trim_end(ptr s, i64 len, i64 limit)：最后一个非空白字节之后的位置（不小于 limit）
+// 空白为空格和 \t \n \v \f \r
+llvm::Function *CodeGenerator::getStringTrimFunction(bool start) {
+    const char *name = start ? "__ppx_str_trim_start" : "__ppx_str_trim_end";
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(i64, {ptrTy, i64, i64}, false));
+    auto args = function->arg_begin();
+    llvm::Value *str = &*args++;
+    llvm::Value *length = &*args++;
+    llvm::Value *limit = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "cond", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "body", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateBr(condBB);
+
+    // 从头向后扫描到 limit，或从尾向前扫描到 limit
+    builder->SetInsertPoint(condBB);
+    llvm::PHINode *pos = builder->CreatePHI(i64, 2, "pos");
+    pos->addIncoming(start ? llvm::ConstantInt::get(i64, 0) : length, entryBB);
+    builder->CreateCondBr(start ? builder->CreateICmpULT(pos, limit) : builder->CreateICmpUGT(pos, limit), bodyBB, doneBB);
+
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *at = start ? static_cast<llvm::Value *>(pos) : builder->CreateSub(pos, llvm::ConstantInt::get(i64, 1));
+    llvm::Value *c = builder->CreateLoad(i8, builder->CreateGEP(i8, str, at), "c");
+    llvm::Value *isSpace = builder->CreateOr(
+        builder->CreateICmpEQ(c, llvm::ConstantInt::get(i8, ' ')),
+        builder->CreateICmpULT(builder->CreateSub(c, llvm::ConstantInt::get(i8, '\t')), llvm::ConstantInt::get(i8, 5)),
+        "is_space");
+    pos->addIncoming(start ? builder->CreateAdd(pos, llvm::ConstantInt::get(i64, 1)) : at, bodyBB);
+    llvm::BasicBlock *stopBB = llvm::BasicBlock::Create(*context, "stop", function);
+    builder->CreateCondBr(isSpace, condBB, stopBB);
+
+    builder->SetInsertPoint(stopBB);
+    builder->CreateRet(pos);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(pos);
+    return function;
+}
+
+// 字符串内置函数
+//
+// 写法为 f(s, ...) 或 s.f(...)；参数可以是字符串切片视图，直接以指针 + 长度传给运行时函数。
+// 与用户定义的同名函数冲突时调用用户函数。
+
+bool CodeGenerator::isStringBuiltin(const std::string &name) {
+    static const std::set<std::string> names = {
+        "find", "contains", "count", "starts_with", "ends_with",
+        "split", "replace", "trim", "to_upper", "to_lower"};
+    return names.count(name) > 0;
+}
+
+std::string CodeGenerator::stringBuiltinType(const std::string &name) {
+    if (name == "find" || name == "count") {
+        return "int";
+    }
+    if (name == "contains" || name == "starts_with" || name == "ends_with") {
+        return "bool";
+    }
+    if (name == "split") {
+        return "list<string>";
+    }
+    return "string";
+}
+
+bool CodeGenerator::stringBuiltinCall(FunctionCallNode *node, ExprNode *&subject, size_t &firstArg) {
+    if (!isStringBuiltin(node->functionName)) {
+        return false;
+    }
+    if (node->object) {
+        if (declaredTypeOf(node->object.get()) != "string") {
+            return false;
+        }
+        subject = node->object.get();
+        firstArg = 0;
+        return true;
+    }
+    if (functionPrototypes.count(node->functionName) || functions.count(node->functionName)) {
+        return false;
+    }
+    subject = node->arguments.empty() ? nullptr : node->arguments[0].get();
+    firstArg = 1;
+    return true;
+}
+
+llvm::Value *CodeGenerator::codegenStringBuiltin(FunctionCallNode *node, ExprNode *subject, size_t firstArg,
+                                                 llvm::Value **viewLength) {
+    const std::string &name = node->functionName;
+    if (g_verbose) {
+        std::cout << "[IR Gen] String builtin: " << name << "()" << std::endl;
+    }
+
+    const char *params = name == "replace" ? "(string, old, new)"
+                       : name == "starts_with" ? "(string, prefix)"
+                       : name == "ends_with" ? "(string, suffix)"
+                       : name == "split" ? "(string, separator)"
+                       : name == "trim" || name == "to_upper" || name == "to_lower" ? "(string)"
+                       : "(string, substring)";
+    size_t expected = name == "replace" ? 3 : std::string(params) == "(string)" ? 1 : 2;
+    if (!subject || node->arguments.size() - firstArg + 1 != expected) {
+        reportError(name + "() expects " + std::to_string(expected) + (expected == 1 ? " argument " : " arguments ") +
+                    params, node->lineNumber);
+        return nullptr;
+    }
+
+    // 依次求值主体和其余参数（都按视图求值，不复制切片）
+    std::vector<llvm::Value *> data;
+    std::vector<llvm::Value *> lengths;
+    for (size_t i = 0; i < expected; i++) {
+        ExprNode *arg = i == 0 ? subject : node->arguments[firstArg + i - 1].get();
+        llvm::Value *length = nullptr;
+        llvm::Value *value = codegenStringView(arg, length);
+        if (!value) {
+            return nullptr;
+        }
+        if (!value->getType()->isPointerTy() || isReferenceType(declaredTypeOf(arg))) {
+            reportError(name + "() expects string arguments", node->lineNumber);
+            return nullptr;
+        }
+        data.push_back(value);
+        lengths.push_back(length);
+    }
+    for (size_t i = 0; i < expected; i++) {
+        lengths[i] = stringViewLength(data[i], lengths[i]);
+    }
+
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Value *zero = llvm::ConstantInt::get(i64, 0);
+
+    if (name == "find" || name == "contains") {
+        llvm::Value *index = builder->CreateCall(getStringFindFunction(),
+                                                 {data[0], lengths[0], data[1], lengths[1], zero}, "index");
+        return name == "find" ? builder->CreateTrunc(index, i32, "find")
+                              : builder->CreateICmpSGE(index, zero, "contains");
+    }
+    if (name == "count") {
+        llvm::Value *count = builder->CreateCall(getStringCountFunction(), {data[0], lengths[0], data[1], lengths[1]}, "count");
+        return builder->CreateTrunc(count, i32, "count");
+    }
+    if (name == "starts_with" || name == "ends_with") {
+        // 前缀不长于字符串时 memcmp 对应位置，否则比较 0 个字节后按长度判为 false
+        llvm::Value *fits = builder->CreateICmpULE(lengths[1], lengths[0], "fits");
+        llvm::Value *compared = builder->CreateSelect(fits, lengths[1], zero, "compared");
+        llvm::Value *at = data[0];
+        if (name == "ends_with") {
+            at = builder->CreateGEP(builder->getInt8Ty(), data[0],
+                                    builder->CreateSelect(fits, builder->CreateSub(lengths[0], lengths[1]), zero), "tail");
+        }
+        llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+        llvm::FunctionCallee memcmpFunc = module->getOrInsertFunction("memcmp", i32, ptrTy, ptrTy, i64);
+        llvm::Value *cmp = builder->CreateCall(memcmpFunc, {at, data[1], compared}, "cmp");
+        return builder->CreateAnd(fits, builder->CreateICmpEQ(cmp, llvm::ConstantInt::get(i32, 0)), name);
+    }
+    if (name == "split") {
+        llvm::Value *parts = builder->CreateCall(getStringSplitFunction(), {data[0], lengths[0], data[1], lengths[1]}, "split");
+        pushTempReference(parts, stringBuiltinType(name));
+        return parts;
+    }
+    if (name == "trim") {
+        llvm::Value *begin = builder->CreateCall(getStringTrimFunction(true), {data[0], lengths[0], lengths[0]}, "trim_begin");
+        llvm::Value *end = builder->CreateCall(getStringTrimFunction(false), {data[0], lengths[0], begin}, "trim_end");
+        llvm::Value *view = builder->CreateGEP(builder->getInt8Ty(), data[0], begin, "trim");
+        llvm::Value *length = builder->CreateSub(end, begin, "trim_len");
+        if (viewLength) {
+            *viewLength = length;
+            return view;
+        }
+        return materializeStringView(view, length);
+    }
+
+    llvm::Value *result = nullptr;
+    if (name == "replace") {
+        result = builder->CreateCall(getStringReplaceFunction(),
+                                     {data[0], lengths[0], data[1], lengths[1], data[2], lengths[2]}, "replace");
+    } else {
+        result = builder->CreateCall(getStringCaseFunction(name == "to_upper"), {data[0], lengths[0]}, name);
+    }
+    // 与拼接结果一样作为临时内存，赋值给变量时转移所有权
+    pushTempMemory(result);
+    return result;
+}
+
+// 标准输入缓冲区和数值解析
+//
+// read_ints/read_doubles/read_all 用 fread 按块把标准输入读入 __ppx_stdin 缓冲区，在缓冲区内原地切分并解析，
+// 不为每个数分配字符串；input() 先取缓冲区中剩余的字节再调用 getchar，两种读法可以交替使用。
+// 整数解析不依赖 C 库：连续 8 个数字作为一组，用一次 64 位加载判断并合并为一个数（SWAR），剩余的数字逐个累加。
+// 合并需要把相邻的数字乘以 10、100、10000 后两两相加，是跨字节的横向运算：在 64 位寄存器中是三次乘法和移位，
+// 而字节向量没有对应的通用 IR 运算（需要 pmaddubsw 等目标相关的 intrinsic），8 个数字也正好是一个寄存器
+
+// 判断字节是否为空白（空格和 \t \n \v \f \r）
+static llvm::Value *emitIsSpace(llvm::IRBuilder<> &builder, llvm::Value *c) {
+    llvm::Type *i8 = builder.getInt8Ty();
+    return builder.CreateOr(
+        builder.CreateICmpEQ(c, llvm::ConstantInt::get(i8, ' ')),
+        builder.CreateICmpULT(builder.CreateSub(c, llvm::ConstantInt::get(i8, '\t')), llvm::ConstantInt::get(i8, 5)),
+        "is_space");
+}
+
+llvm::StructType *CodeGenerator::getStdinStateType() {
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    return llvm::StructType::get(*context, {llvm::PointerType::get(*context, 0), i64, i64, i64});
+}
+
+// 缓冲区状态与运行时函数一样使用 linkonce_odr，链接后所有模块共用一份
+llvm::GlobalVariable *CodeGenerator::getStdinStateGlobal() {
+    if (llvm::GlobalVariable *existing = module->getNamedGlobal("__ppx_stdin")) {
+        return existing;
+    }
+    llvm::StructType *stateTy = getStdinStateType();
+    return new llvm::GlobalVariable(*module, stateTy, false, llvm::GlobalValue::LinkOnceODRLinkage,
+                                    llvm::ConstantAggregateZero::get(stateTy), "__ppx_stdin");
+}
+
+// i1 __ppx_stdin_fill()：把未读字节移到缓冲区开头，再用 fread 读满剩余空间，没有读到新字节时返回 false
+llvm::Function *CodeGenerator::getStdinFillFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_stdin_fill")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *stateTy = getStdinStateType();
+    llvm::GlobalVariable *state = getStdinStateGlobal();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_stdin_fill", llvm::FunctionType::get(llvm::Type::getInt1Ty(*context), {}, false));
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *allocBB = llvm::BasicBlock::Create(*context, "alloc", function);
+    llvm::BasicBlock *compactBB = llvm::BasicBlock::Create(*context, "compact", function);
+    llvm::BasicBlock *fullBB = llvm::BasicBlock::Create(*context, "full", function);
+    llvm::BasicBlock *readBB = llvm::BasicBlock::Create(*context, "read", function);
+    llvm::FunctionCallee memmoveFunc = module->getOrInsertFunction("memmove", ptrTy, ptrTy, ptrTy, i64);
+    llvm::FunctionCallee freadFunc = module->getOrInsertFunction("fread", i64, ptrTy, i64, i64, ptrTy);
+    llvm::Value *chunkSize = llvm::ConstantInt::get(i64, CodeGenConstants::STDIN_CHUNK_SIZE);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *dataPtr = builder->CreateStructGEP(stateTy, state, STDIN_DATA);
+    llvm::Value *posPtr = builder->CreateStructGEP(stateTy, state, STDIN_POS);
+    llvm::Value *lenPtr = builder->CreateStructGEP(stateTy, state, STDIN_LEN);
+    llvm::Value *data = builder->CreateLoad(ptrTy, dataPtr, "data");
+    builder->CreateCondBr(builder->CreateIsNull(data), allocBB, compactBB);
+
+    builder->SetInsertPoint(allocBB);
+    llvm::Value *allocated = builder->CreateCall(module->getFunction("malloc"), {chunkSize}, "allocated");
+    builder->CreateStore(allocated, dataPtr);
+    builder->CreateBr(compactBB);
+
+    builder->SetInsertPoint(compactBB);
+    llvm::PHINode *buffer = builder->CreatePHI(ptrTy, 2, "buffer");
+    buffer->addIncoming(data, entryBB);
+    buffer->addIncoming(allocated, allocBB);
+    llvm::Value *pos = builder->CreateLoad(i64, posPtr, "pos");
+    llvm::Value *rest = builder->CreateSub(builder->CreateLoad(i64, lenPtr, "len"), pos, "rest");
+    builder->CreateCall(memmoveFunc, {buffer, builder->CreateGEP(i8, buffer, pos), rest});
+    builder->CreateStore(llvm::ConstantInt::get(i64, 0), posPtr);
+    builder->CreateStore(rest, lenPtr);
+    llvm::Value *room = builder->CreateSub(chunkSize, rest, "room");
+    builder->CreateCondBr(builder->CreateICmpEQ(room, llvm::ConstantInt::get(i64, 0)), fullBB, readBB);
+
+    builder->SetInsertPoint(fullBB);
+    builder->CreateRet(builder->getFalse());
+
+    builder->SetInsertPoint(readBB);
+    llvm::Value *stdinFile = emitStdinFile();
+    llvm::Value *count = builder->CreateCall(freadFunc, {builder->CreateGEP(i8, buffer, rest),
+                                                         llvm::ConstantInt::get(i64, 1), room, stdinFile}, "count");
+    builder->CreateStore(builder->CreateAdd(rest, count), lenPtr);
+    builder->CreateRet(builder->CreateICmpNE(count, llvm::ConstantInt::get(i64, 0)));
+    return function;
+}
+
+// i32 __ppx_stdin_getc()：缓冲区中还有未读字节时取出一个，否则调用 getchar
+llvm::Function *CodeGenerator::getStdinGetcFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_stdin_getc")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *stateTy = getStdinStateType();
+    llvm::GlobalVariable *state = getStdinStateGlobal();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_stdin_getc", llvm::FunctionType::get(i32, {}, false));
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *bufferedBB = llvm::BasicBlock::Create(*context, "buffered", function);
+    llvm::BasicBlock *directBB = llvm::BasicBlock::Create(*context, "direct", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *posPtr = builder->CreateStructGEP(stateTy, state, STDIN_POS);
+    llvm::Value *pos = builder->CreateLoad(i64, posPtr, "pos");
+    llvm::Value *len = builder->CreateLoad(i64, builder->CreateStructGEP(stateTy, state, STDIN_LEN), "len");
+    builder->CreateCondBr(builder->CreateICmpULT(pos, len), bufferedBB, directBB);
+
+    builder->SetInsertPoint(bufferedBB);
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(stateTy, state, STDIN_DATA), "data");
+    llvm::Value *c = builder->CreateLoad(i8, builder->CreateGEP(i8, data, pos), "c");
+    builder->CreateStore(builder->CreateAdd(pos, llvm::ConstantInt::get(i64, 1)), posPtr);
+    builder->CreateRet(builder->CreateZExt(c, i32));
+
+    builder->SetInsertPoint(directBB);
+    builder->CreateRet(builder->CreateCall(module->getFunction("getchar"), {}, "ch"));
+    return function;
+}
+
+// ptr __ppx_stdin_token(ptr length)：跳过空白，返回下一个以空白分隔的记号在缓冲区中的位置，长度写入 length；
+// 输入结束时返回 null。记号不从缓冲区中取出，解析成功后由调用方前移 pos
+llvm::Function *CodeGenerator::getStdinTokenFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_stdin_token")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *stateTy = getStdinStateType();
+    llvm::GlobalVariable *state = getStdinStateGlobal();
+    llvm::Function *fillFunc = getStdinFillFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_stdin_token", llvm::FunctionType::get(ptrTy, {ptrTy}, false));
+    llvm::Value *lengthOut = &*function->arg_begin();
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *skipBB = llvm::BasicBlock::Create(*context, "skip", function);
+    llvm::BasicBlock *skipFillBB = llvm::BasicBlock::Create(*context, "skip_fill", function);
+    llvm::BasicBlock *skipByteBB = llvm::BasicBlock::Create(*context, "skip_byte", function);
+    llvm::BasicBlock *skipNextBB = llvm::BasicBlock::Create(*context, "skip_next", function);
+    llvm::BasicBlock *eofBB = llvm::BasicBlock::Create(*context, "eof", function);
+    llvm::BasicBlock *scanBB = llvm::BasicBlock::Create(*context, "scan", function);
+    llvm::BasicBlock *scanFillBB = llvm::BasicBlock::Create(*context, "scan_fill", function);
+    llvm::BasicBlock *scanByteBB = llvm::BasicBlock::Create(*context, "scan_byte", function);
+    llvm::BasicBlock *scanNextBB = llvm::BasicBlock::Create(*context, "scan_next", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *dataPtr = builder->CreateStructGEP(stateTy, state, STDIN_DATA);
+    llvm::Value *posPtr = builder->CreateStructGEP(stateTy, state, STDIN_POS);
+    llvm::Value *lenPtr = builder->CreateStructGEP(stateTy, state, STDIN_LEN);
+    builder->CreateBr(skipBB);
+
+    // 跳过空白，缓冲区读完时补充
+    builder->SetInsertPoint(skipBB);
+    llvm::Value *pos = builder->CreateLoad(i64, posPtr, "pos");
+    builder->CreateCondBr(builder->CreateICmpULT(pos, builder->CreateLoad(i64, lenPtr, "len")), skipByteBB, skipFillBB);
+
+    builder->SetInsertPoint(skipFillBB);
+    builder->CreateCondBr(builder->CreateCall(fillFunc, {}, "filled"), skipBB, eofBB);
+
+    builder->SetInsertPoint(eofBB);
+    builder->CreateRet(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)));
+
+    builder->SetInsertPoint(skipByteBB);
+    llvm::Value *data = builder->CreateLoad(ptrTy, dataPtr, "data");
+    llvm::Value *c = builder->CreateLoad(i8, builder->CreateGEP(i8, data, pos), "c");
+    builder->CreateCondBr(emitIsSpace(*builder, c), skipNextBB, scanBB);
+
+    builder->SetInsertPoint(skipNextBB);
+    builder->CreateStore(builder->CreateAdd(pos, llvm::ConstantInt::get(i64, 1)), posPtr);
+    builder->CreateBr(skipBB);
+
+    // 记号的长度 k 相对于 pos 计算，补充缓冲区移动数据后仍然有效
+    builder->SetInsertPoint(scanBB);
+    llvm::PHINode *k = builder->CreatePHI(i64, 3, "k");
+    k->addIncoming(llvm::ConstantInt::get(i64, 1), skipByteBB);
+    llvm::Value *at = builder->CreateAdd(builder->CreateLoad(i64, posPtr, "pos"), k, "at");
+    builder->CreateCondBr(builder->CreateICmpULT(at, builder->CreateLoad(i64, lenPtr, "len")), scanByteBB, scanFillBB);
+
+    builder->SetInsertPoint(scanFillBB);
+    k->addIncoming(k, scanFillBB);
+    builder->CreateCondBr(builder->CreateCall(fillFunc, {}, "filled"), scanBB, doneBB);
+
+    builder->SetInsertPoint(scanByteBB);
+    llvm::Value *next = builder->CreateLoad(i8, builder->CreateGEP(i8, builder->CreateLoad(ptrTy, dataPtr, "data"), at), "c");
+    builder->CreateCondBr(emitIsSpace(*builder, next), doneBB, scanNextBB);
+
+    builder->SetInsertPoint(scanNextBB);
+    k->addIncoming(builder->CreateAdd(k, llvm::ConstantInt::get(i64, 1)), scanNextBB);
+    builder->CreateBr(scanBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateStore(k, lengthOut);
+    llvm::Value *start = builder->CreateGEP(i8, builder->CreateLoad(ptrTy, dataPtr, "data"),
+                                            builder->CreateLoad(i64, posPtr, "pos"), "token");
+    builder->CreateRet(start);
+    return function;
+}
+
+// i1 __ppx_parse_int(ptr s, i64 len, ptr out)：s 必须是可选的 + 或 - 后跟至少一个数字，且在 int 范围内，
+// 成功时写入 *out（i32）并返回 true，失败时不修改 *out
+llvm::Function *CodeGenerator::getParseIntFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_parse_int")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_parse_int",
+        llvm::FunctionType::get(llvm::Type::getInt1Ty(*context), {ptrTy, i64, ptrTy}, false));
+    auto args = function->arg_begin();
+    llvm::Value *str = &*args++;
+    llvm::Value *length = &*args++;
+    llvm::Value *out = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *signBB = llvm::BasicBlock::Create(*context, "sign", function);
+    llvm::BasicBlock *wordCondBB = llvm::BasicBlock::Create(*context, "word_cond", function);
+    llvm::BasicBlock *wordBodyBB = llvm::BasicBlock::Create(*context, "word_body", function);
+    llvm::BasicBlock *wordDigitsBB = llvm::BasicBlock::Create(*context, "word_digits", function);
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "cond", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "body", function);
+    llvm::BasicBlock *digitBB = llvm::BasicBlock::Create(*context, "digit", function);
+    llvm::BasicBlock *finishBB = llvm::BasicBlock::Create(*context, "finish", function);
+    llvm::BasicBlock *storeBB = llvm::BasicBlock::Create(*context, "store", function);
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "fail", function);
+
+    // 累加值超过 2^31 后固定为 2^31 + 1，只用于最后判断溢出，i64 的乘法不会再溢出
+    llvm::Value *saturated = llvm::ConstantInt::get(i64, 0x80000001ULL);
+    auto saturate = [&](llvm::Value *value) {
+        return builder->CreateSelect(builder->CreateICmpUGT(value, saturated), saturated, value, "value");
+    };
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(length, llvm::ConstantInt::get(i64, 0)), failBB, signBB);
+
+    builder->SetInsertPoint(signBB);
+    llvm::Value *first = builder->CreateLoad(i8, str, "first");
+    llvm::Value *negative = builder->CreateICmpEQ(first, llvm::ConstantInt::get(i8, '-'), "negative");
+    llvm::Value *hasSign = builder->CreateOr(negative, builder->CreateICmpEQ(first, llvm::ConstantInt::get(i8, '+')));
+    llvm::Value *start = builder->CreateZExt(hasSign, i64, "start");
+    builder->CreateCondBr(builder->CreateICmpULT(start, length), wordCondBB, failBB);
+
+    // 每次取 8 个字节：全部是数字时（高 4 位都是 3，且加 6 后不进位到高 4 位）合并为一个 8 位十进制数
+    builder->SetInsertPoint(wordCondBB);
+    llvm::PHINode *word = builder->CreatePHI(i64, 2, "word");
+    llvm::PHINode *wordValue = builder->CreatePHI(i64, 2, "word_value");
+    word->addIncoming(start, signBB);
+    wordValue->addIncoming(llvm::ConstantInt::get(i64, 0), signBB);
+    llvm::Value *wordEnd = builder->CreateAdd(word, llvm::ConstantInt::get(i64, 8), "word_end");
+    builder->CreateCondBr(builder->CreateICmpULE(wordEnd, length), wordBodyBB, condBB);
+
+    builder->SetInsertPoint(wordBodyBB);
+    llvm::Value *x = builder->CreateAlignedLoad(i64, builder->CreateGEP(i8, str, word), llvm::MaybeAlign(1), "x");
+    llvm::Value *high = llvm::ConstantInt::get(i64, 0xF0F0F0F0F0F0F0F0ULL);
+    llvm::Value *carry = builder->CreateAnd(builder->CreateAdd(x, llvm::ConstantInt::get(i64, 6 * BYTE_LSB)), high);
+    llvm::Value *nibbles = builder->CreateOr(builder->CreateAnd(x, high), builder->CreateLShr(carry, 4));
+    builder->CreateCondBr(builder->CreateICmpEQ(nibbles, llvm::ConstantInt::get(i64, 3 * 0x11 * BYTE_LSB), "all_digits"),
+                          wordDigitsBB, condBB);
+
+    // 小端序下第一个数字在最低字节：相邻的 1、2、4 个数字依次两两合并
+    builder->SetInsertPoint(wordDigitsBB);
+    llvm::Value *digits = builder->CreateAnd(x, llvm::ConstantInt::get(i64, 0x0F * BYTE_LSB));
+    digits = builder->CreateLShr(builder->CreateMul(digits, llvm::ConstantInt::get(i64, 10 * 256 + 1)), 8);
+    digits = builder->CreateAnd(digits, llvm::ConstantInt::get(i64, 0x00FF00FF00FF00FFULL));
+    digits = builder->CreateLShr(builder->CreateMul(digits, llvm::ConstantInt::get(i64, 100 * 65536 + 1)), 16);
+    digits = builder->CreateAnd(digits, llvm::ConstantInt::get(i64, 0x0000FFFF0000FFFFULL));
+    digits = builder->CreateLShr(builder->CreateMul(digits, llvm::ConstantInt::get(i64, 10000ULL * 4294967296ULL + 1)), 32);
+    llvm::Value *merged = builder->CreateAdd(builder->CreateMul(wordValue, llvm::ConstantInt::get(i64, 100000000)), digits);
+    word->addIncoming(wordEnd, wordDigitsBB);
+    wordValue->addIncoming(saturate(merged), wordDigitsBB);
+    builder->CreateBr(wordCondBB);
+
+    // 剩余的字节逐个累加，遇到非数字时失败
+    builder->SetInsertPoint(condBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 3, "i");
+    llvm::PHINode *value = builder->CreatePHI(i64, 3, "value");
+    i->addIncoming(word, wordCondBB);
+    i->addIncoming(word, wordBodyBB);
+    value->addIncoming(wordValue, wordCondBB);
+    value->addIncoming(wordValue, wordBodyBB);
+    builder->CreateCondBr(builder->CreateICmpULT(i, length), bodyBB, finishBB);
+
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *digit = builder->CreateSub(builder->CreateLoad(i8, builder->CreateGEP(i8, str, i), "c"),
+                                            llvm::ConstantInt::get(i8, '0'), "digit");
+    builder->CreateCondBr(builder->CreateICmpULT(digit, llvm::ConstantInt::get(i8, 10)), digitBB, failBB);
+
+    builder->SetInsertPoint(digitBB);
+    llvm::Value *accumulated = builder->CreateAdd(builder->CreateMul(value, llvm::ConstantInt::get(i64, 10)),
+                                                  builder->CreateZExt(digit, i64));
+    i->addIncoming(builder->CreateAdd(i, llvm::ConstantInt::get(i64, 1)), digitBB);
+    value->addIncoming(saturate(accumulated), digitBB);
+    builder->CreateBr(condBB);
+
+    // 负数最多到 2^31，正数最多到 2^31 - 1
+    builder->SetInsertPoint(finishBB);
+    llvm::Value *limit = builder->CreateAdd(llvm::ConstantInt::get(i64, 0x7FFFFFFF), builder->CreateZExt(negative, i64), "limit");
+    builder->CreateCondBr(builder->CreateICmpULE(value, limit), storeBB, failBB);
+
+    builder->SetInsertPoint(storeBB);
+    llvm::Value *result = builder->CreateTrunc(value, i32);
+    builder->CreateStore(builder->CreateSelect(negative, builder->CreateNeg(result), result, "result"), out);
+    builder->CreateRet(builder->getTrue());
+
+    builder->SetInsertPoint(failBB);
+    builder->CreateRet(builder->getFalse());
+    return function;
+}
+
+// i1 __ppx_parse_double(ptr s, i64 len, ptr out)：s 的全部字节必须构成 strtod 能识别的十进制浮点数（不接受 0x 前缀），
+// 且不超出 double 范围，成功时写入 *out（double）并返回 true。s 不一定以 NUL 结尾，先复制到栈上的缓冲区（过长时 malloc）
+llvm::Function *CodeGenerator::getParseDoubleFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_parse_double")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *doubleTy = llvm::Type::getDoubleTy(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_parse_double",
+        llvm::FunctionType::get(llvm::Type::getInt1Ty(*context), {ptrTy, i64, ptrTy}, false));
+    auto args = function->arg_begin();
+    llvm::Value *str = &*args++;
+    llvm::Value *length = &*args++;
+    llvm::Value *out = &*args++;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *firstBB = llvm::BasicBlock::Create(*context, "first", function);
+    llvm::BasicBlock *heapBB = llvm::BasicBlock::Create(*context, "heap", function);
+    llvm::BasicBlock *convertBB = llvm::BasicBlock::Create(*context, "convert", function);
+    llvm::BasicBlock *freeBB = llvm::BasicBlock::Create(*context, "free", function);
+    llvm::BasicBlock *checkBB = llvm::BasicBlock::Create(*context, "check", function);
+    llvm::BasicBlock *storeBB = llvm::BasicBlock::Create(*context, "store", function);
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "fail", function);
+    llvm::FunctionCallee strtodFunc = module->getOrInsertFunction("strtod", doubleTy, ptrTy, ptrTy);
+    llvm::FunctionCallee memcpyFunc = module->getOrInsertFunction("memcpy", ptrTy, ptrTy, ptrTy, i64);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *stackBuffer = builder->CreateAlloca(
+        llvm::ArrayType::get(i8, CodeGenConstants::PARSE_BUFFER_SIZE), nullptr, "stack_buffer");
+    llvm::Value *endPtr = builder->CreateAlloca(ptrTy, nullptr, "end_ptr");
+    builder->CreateCondBr(builder->CreateICmpEQ(length, llvm::ConstantInt::get(i64, 0)), failBB, firstBB);
+
+    // strtod 会跳过开头的空白，这里要求第一个字节就是数字的一部分
+    builder->SetInsertPoint(firstBB);
+    llvm::Value *first = builder->CreateLoad(i8, str, "first");
+    llvm::Value *fits = builder->CreateICmpULT(length, llvm::ConstantInt::get(i64, CodeGenConstants::PARSE_BUFFER_SIZE));
+    llvm::BasicBlock *chooseBB = llvm::BasicBlock::Create(*context, "choose", function, heapBB);
+    builder->CreateCondBr(emitIsSpace(*builder, first), failBB, chooseBB);
+
+    builder->SetInsertPoint(chooseBB);
+    builder->CreateCondBr(fits, convertBB, heapBB);
+
+    builder->SetInsertPoint(heapBB);
+    llvm::Value *heap = builder->CreateCall(module->getFunction("malloc"),
+                                            {builder->CreateAdd(length, llvm::ConstantInt::get(i64, 1))}, "heap");
+    builder->CreateBr(convertBB);
+
+    builder->SetInsertPoint(convertBB);
+    llvm::PHINode *buffer = builder->CreatePHI(ptrTy, 2, "buffer");
+    buffer->addIncoming(stackBuffer, chooseBB);
+    buffer->addIncoming(heap, heapBB);
+    builder->CreateCall(memcpyFunc, {buffer, str, length});
+    llvm::Value *bufferEnd = builder->CreateGEP(i8, buffer, length, "buffer_end");
+    builder->CreateStore(llvm::ConstantInt::get(i8, 0), bufferEnd);
+    llvm::Value *errnoPtr = emitErrnoPtr();
+    builder->CreateStore(llvm::ConstantInt::get(i32, 0), errnoPtr);
+    llvm::Value *parsed = builder->CreateCall(strtodFunc, {buffer, endPtr}, "parsed");
+    llvm::Value *rangeError = builder->CreateICmpEQ(builder->CreateLoad(i32, errnoPtr, "errno"),
+                                                    llvm::ConstantInt::get(i32, 34), "range_error");   // ERANGE
+    llvm::Value *complete = builder->CreateICmpEQ(builder->CreateLoad(ptrTy, endPtr, "end"), bufferEnd, "complete");
+
+    // strtod 接受十六进制浮点数：符号之后是 0x 或 0X 时失败。缓冲区以 NUL 结尾，
+    // 只有一个符号时 buffer[2] 仍在栈上的缓冲区内（malloc 的缓冲区至少有 PARSE_BUFFER_SIZE 个字节）
+    llvm::Value *hasSign = builder->CreateOr(builder->CreateICmpEQ(first, llvm::ConstantInt::get(i8, '-')),
+                                             builder->CreateICmpEQ(first, llvm::ConstantInt::get(i8, '+')));
+    llvm::Value *digitsStart = builder->CreateZExt(hasSign, i64, "digits_start");
+    llvm::Value *lead = builder->CreateLoad(i8, builder->CreateGEP(i8, buffer, digitsStart), "lead");
+    llvm::Value *marker = builder->CreateLoad(
+        i8, builder->CreateGEP(i8, buffer, builder->CreateAdd(digitsStart, llvm::ConstantInt::get(i64, 1))), "marker");
+    llvm::Value *hex = builder->CreateAnd(
+        builder->CreateICmpEQ(lead, llvm::ConstantInt::get(i8, '0')),
+        builder->CreateICmpEQ(builder->CreateOr(marker, llvm::ConstantInt::get(i8, 0x20)), llvm::ConstantInt::get(i8, 'x')),
+        "hex");
+    builder->CreateCondBr(fits, checkBB, freeBB);
+
+    builder->SetInsertPoint(freeBB);
+    builder->CreateCall(module->getFunction("free"), {buffer});
+    builder->CreateBr(checkBB);
+
+    // ERANGE 且结果为 0 或无穷大说明超出 double 范围（上溢或下溢为 0）；
+    // 非规格化数按原值接受，inf/nan 的写法不设置 errno
+    builder->SetInsertPoint(checkBB);
+    llvm::Value *infinity = llvm::ConstantFP::getInfinity(doubleTy);
+    llvm::Value *lost = builder->CreateOr(builder->CreateFCmpOEQ(parsed, llvm::ConstantFP::get(doubleTy, 0.0)),
+                                          builder->CreateFCmpOEQ(builder->CreateUnaryIntrinsic(llvm::Intrinsic::fabs, parsed),
+                                                                 infinity));
+    llvm::Value *outOfRange = builder->CreateAnd(rangeError, lost, "out_of_range");
+    builder->CreateCondBr(builder->CreateAnd(builder->CreateAnd(complete, builder->CreateNot(hex)),
+                                             builder->CreateNot(outOfRange)),
+                          storeBB, failBB);
+
+    builder->SetInsertPoint(storeBB);
+    builder->CreateStore(parsed, out);
+    builder->CreateRet(builder->getTrue());
+
+    builder->SetInsertPoint(failBB);
+    builder->CreateRet(builder->getFalse());
+    return function;
+}
+
+// ptr __ppx_read_ints(i64 n) / __ppx_read_doubles(i64 n)：从标准输入读取最多 n 个以空白分隔的数，返回动态数组；
+// 遇到输入结束或无法解析的记号时提前结束（该记号留在缓冲区中，之后的 input() 可以读到）
+llvm::Function *CodeGenerator::getReadNumbersFunction(bool isDouble) {
+    const char *name = isDouble ? "__ppx_read_doubles" : "__ppx_read_ints";
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = isDouble ? llvm::Type::getDoubleTy(*context) : llvm::Type::getInt32Ty(*context);
+    std::string listType = isDouble ? "list<double>" : "list<int>";
+    llvm::StructType *listTy = getListStructType();
+    llvm::StructType *stateTy = getStdinStateType();
+    llvm::GlobalVariable *state = getStdinStateGlobal();
+    llvm::Function *tokenFunc = getStdinTokenFunction();
+    llvm::Function *parseFunc = isDouble ? getParseDoubleFunction() : getParseIntFunction();
+    llvm::Function *newFunc = getListNewFunction();
+    llvm::Function *function = createRuntimeFunction(module.get(), name, llvm::FunctionType::get(ptrTy, {i64}, false));
+    llvm::Value *count = &*function->arg_begin();
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "cond", function);
+    llvm::BasicBlock *tokenBB = llvm::BasicBlock::Create(*context, "token", function);
+    llvm::BasicBlock *parseBB = llvm::BasicBlock::Create(*context, "parse", function);
+    llvm::BasicBlock *pushBB = llvm::BasicBlock::Create(*context, "push", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *lengthVar = builder->CreateAlloca(i64, nullptr, "length");
+    llvm::Value *valueVar = builder->CreateAlloca(elementTy, nullptr, "value");
+    llvm::Value *list = builder->CreateCall(newFunc, {
+        llvm::ConstantInt::get(i64, module->getDataLayout().getTypeAllocSize(elementTy)),
+        llvm::ConstantInt::get(i64, CodeGenConstants::LIST_MIN_CAPACITY)}, "list");
+    llvm::Value *posPtr = builder->CreateStructGEP(stateTy, state, STDIN_POS);
+    builder->CreateBr(condBB);
+
+    builder->SetInsertPoint(condBB);
+    llvm::Value *size = builder->CreateLoad(i64, builder->CreateStructGEP(listTy, list, LIST_SIZE), "size");
+    builder->CreateCondBr(builder->CreateICmpSLT(size, count), tokenBB, doneBB);
+
+    builder->SetInsertPoint(tokenBB);
+    llvm::Value *token = builder->CreateCall(tokenFunc, {lengthVar}, "token");
+    builder->CreateCondBr(builder->CreateIsNull(token), doneBB, parseBB);
+
+    builder->SetInsertPoint(parseBB);
+    llvm::Value *length = builder->CreateLoad(i64, lengthVar, "token_len");
+    builder->CreateCondBr(builder->CreateCall(parseFunc, {token, length, valueVar}, "parsed"), pushBB, doneBB);
+
+    builder->SetInsertPoint(pushBB);
+    builder->CreateStore(builder->CreateAdd(builder->CreateLoad(i64, posPtr, "pos"), length), posPtr);
+    emitListPush(list, builder->CreateLoad(elementTy, valueVar, "element"), listType);
+    builder->CreateBr(condBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(list);
+    return function;
+}
+
+// ptr __ppx_read_all()：读取标准输入的全部剩余内容（先取缓冲区中未读的字节），返回新字符串
+llvm::Function *CodeGenerator::getReadAllFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_read_all")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *stateTy = getStdinStateType();
+    llvm::GlobalVariable *state = getStdinStateGlobal();
+    llvm::Function *function = createRuntimeFunction(module.get(), "__ppx_read_all", llvm::FunctionType::get(ptrTy, {}, false));
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *growBB = llvm::BasicBlock::Create(*context, "grow", function);
+    llvm::BasicBlock *readBB = llvm::BasicBlock::Create(*context, "read", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::FunctionCallee memcpyFunc = module->getOrInsertFunction("memcpy", ptrTy, ptrTy, ptrTy, i64);
+    llvm::FunctionCallee reallocFunc = module->getOrInsertFunction("realloc", ptrTy, ptrTy, i64);
+    llvm::FunctionCallee freadFunc = module->getOrInsertFunction("fread", i64, ptrTy, i64, i64, ptrTy);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *posPtr = builder->CreateStructGEP(stateTy, state, STDIN_POS);
+    llvm::Value *pos = builder->CreateLoad(i64, posPtr, "pos");
+    llvm::Value *len = builder->CreateLoad(i64, builder->CreateStructGEP(stateTy, state, STDIN_LEN), "len");
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(stateTy, state, STDIN_DATA), "data");
+    llvm::Value *rest = builder->CreateSub(len, pos, "rest");
+    llvm::Value *capacity = builder->CreateAdd(rest, llvm::ConstantInt::get(i64, CodeGenConstants::STDIN_CHUNK_SIZE), "capacity");
+    llvm::Value *result = builder->CreateCall(module->getFunction("malloc"), {capacity}, "result");
+    builder->CreateCall(memcpyFunc, {result, builder->CreateGEP(i8, data, pos), rest});
+    builder->CreateStore(len, posPtr);
+    builder->CreateBr(loopBB);
+
+    // 每次读满剩余空间（保留结尾 NUL 的位置），空间用完时容量翻倍
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *buffer = builder->CreatePHI(ptrTy, 2, "buffer");
+    llvm::PHINode *cap = builder->CreatePHI(i64, 2, "cap");
+    llvm::PHINode *size = builder->CreatePHI(i64, 2, "size");
+    buffer->addIncoming(result, entryBB);
+    cap->addIncoming(capacity, entryBB);
+    size->addIncoming(rest, entryBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(builder->CreateAdd(size, one), cap), growBB, readBB);
+
+    builder->SetInsertPoint(growBB);
+    llvm::Value *doubled = builder->CreateShl(cap, 1, "doubled");
+    llvm::Value *grown = builder->CreateCall(reallocFunc, {buffer, doubled}, "grown");
+    builder->CreateBr(readBB);
+
+    builder->SetInsertPoint(readBB);
+    llvm::PHINode *current = builder->CreatePHI(ptrTy, 2, "current");
+    llvm::PHINode *currentCap = builder->CreatePHI(i64, 2, "current_cap");
+    current->addIncoming(buffer, loopBB);
+    current->addIncoming(grown, growBB);
+    currentCap->addIncoming(cap, loopBB);
+    currentCap->addIncoming(doubled, growBB);
+    llvm::Value *stdinFile = emitStdinFile();
+    llvm::Value *room = builder->CreateSub(builder->CreateSub(currentCap, size), one, "room");
+    llvm::Value *count = builder->CreateCall(freadFunc, {builder->CreateGEP(i8, current, size), one, room, stdinFile}, "count");
+    llvm::Value *newSize = builder->CreateAdd(size, count, "new_size");
+    buffer->addIncoming(current, readBB);
+    cap->addIncoming(currentCap, readBB);
+    size->addIncoming(newSize, readBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(count, llvm::ConstantInt::get(i64, 0)), doneBB, loopBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateStore(llvm::ConstantInt::get(i8, 0), builder->CreateGEP(i8, current, size));
+    builder->CreateRet(current);
+    return function;
+}
+
+// 数值输入内置函数
+//
+// parse_int(s, v)/parse_double(s, v) 忽略 s 两端的空白后解析，成功时写入变量 v 并返回 true，失败时返回 false 且不修改 v；
+// s 可以是字符串切片视图。与用户定义的同名函数冲突时调用用户函数。
+
+bool CodeGenerator::isInputBuiltin(const std::string &name) {
+    return name == "parse_int" || name == "parse_double" || name == "read_ints" || name == "read_doubles" ||
+           name == "read_all";
+}
+
+std::string CodeGenerator::inputBuiltinType(const std::string &name) {
+    if (name == "parse_int" || name == "parse_double") {
+        return "bool";
+    }
+    if (name == "read_ints") {
+        return "list<int>";
+    }
+    if (name == "read_doubles") {
+        return "list<double>";
+    }
+    return "string";
+}
+
+bool CodeGenerator::inputBuiltinCall(FunctionCallNode *node) {
+    return !node->object && isInputBuiltin(node->functionName) &&
+           !functionPrototypes.count(node->functionName) && !functions.count(node->functionName);
+}
+
+llvm::Value *CodeGenerator::codegenInputBuiltin(FunctionCallNode *node) {
+    const std::string &name = node->functionName;
+    if (g_verbose) {
+        std::cout << "[IR Gen] Input builtin: " << name << "()" << std::endl;
+    }
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+
+    if (name == "read_all") {
+        if (!node->arguments.empty()) {
+            reportError("read_all() expects no arguments", node->lineNumber);
+            return nullptr;
+        }
+        llvm::Value *text = builder->CreateCall(getReadAllFunction(), {}, "read_all");
+        pushTempMemory(text);
+        return text;
+    }
+
+    if (name == "read_ints" || name == "read_doubles") {
+        if (node->arguments.size() != 1) {
+            reportError(name + "() expects 1 argument (count)", node->lineNumber);
+            return nullptr;
+        }
+        llvm::Value *count = codegenExpr(node->arguments[0].get());
+        if (!count) {
+            return nullptr;
+        }
+        if (!count->getType()->isIntegerTy(32)) {
+            reportError(name + "() expects an int count", node->lineNumber);
+            return nullptr;
+        }
+        llvm::Value *numbers = builder->CreateCall(getReadNumbersFunction(name == "read_doubles"),
+                                                   {builder->CreateSExt(count, i64)}, name);
+        pushTempReference(numbers, inputBuiltinType(name));
+        return numbers;
+    }
+
+    // parse_int / parse_double：第二个参数必须是对应类型的变量
+    bool isDouble = name == "parse_double";
+    if (node->arguments.size() != 2) {
+        reportError(name + "() expects 2 arguments (string, variable)", node->lineNumber);
+        return nullptr;
+    }
+    std::string valueType = isDouble ? "double" : "int";
+    auto target = dynamic_cast<IdentifierNode *>(node->arguments[1].get());
+    if (!target || declaredTypeOf(target) != valueType) {
+        reportError(name + "() expects " + (isDouble ? "a double" : "an int") + " variable as its second argument",
+                    node->lineNumber);
+        return nullptr;
+    }
+    llvm::Value *targetPtr = nullptr;
+    auto local = fn->namedValues.find(target->name);
+    if (local != fn->namedValues.end() && local->second) {
+        if (fn->localConstVariables.count(target->name)) {
+            reportError("Cannot reassign constant '" + target->name + "'", node->lineNumber);
+            return nullptr;
+        }
+        targetPtr = local->second;
+    } else {
+        llvm::GlobalVariable *globalVar = globalValues[target->name];
+        if (!globalVar || globalVar->isConstant()) {
+            reportError("Cannot reassign constant '" + target->name + "'", node->lineNumber);
+            return nullptr;
+        }
+        targetPtr = globalVar;
+    }
+
+    llvm::Value *viewLength = nullptr;
+    llvm::Value *text = codegenStringView(node->arguments[0].get(), viewLength);
+    if (!text) {
+        return nullptr;
+    }
+    std::string textType = declaredTypeOf(node->arguments[0].get());
+    if (!text->getType()->isPointerTy() || isReferenceType(textType)) {
+        reportError(name + "() expects a string as its first argument", node->lineNumber);
+        return nullptr;
+    }
+    llvm::Value *length = stringViewLength(text, viewLength);
+    llvm::Value *begin = builder->CreateCall(getStringTrimFunction(true), {text, length, length}, "trim_begin");
+    llvm::Value *end = builder->CreateCall(getStringTrimFunction(false), {text, length, begin}, "trim_end");
+    return builder->CreateCall(isDouble ? getParseDoubleFunction() : getParseIntFunction(),
+                               {builder->CreateGEP(builder->getInt8Ty(), text, begin), builder->CreateSub(end, begin), targetPtr},
+                               name);
+}
+
+// 文件运行时
+//
+// file 是指向文件头部的指针。读取时，不小于 FILE_MMAP_THRESHOLD 字节的普通文件整体 mmap 并提示顺序访问，
+// 其余情况（小文件、管道、设备或 mmap 失败）用 read(2) 读入 FILE_BUFFER_SIZE 字节的缓冲区；写入先复制到缓冲区，
+// 缓冲区满、flush 或 close 时才用 write(2) 写出。运行时函数失败时设置 errno 并返回 null 或负数，由调用处抛出异常。
+
+// open(2) 的写入标志（<fcntl.h> 的取值因平台而异）
+static int fileWriteFlags(bool append) {
+    const int writeOnly = 1;
+    if (targetIsDarwin()) {
+        return writeOnly | 0x200 | (append ? 0x8 : 0x400);     // O_CREAT | O_APPEND 或 O_TRUNC
+    }
+    return writeOnly | 0x40 | (append ? 0x400 : 0x200);         // O_CREAT | O_APPEND 或 O_TRUNC
+}
+
+llvm::Value *CodeGenerator::emitErrnoPtr() {
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::FunctionCallee errnoFunc =
+        module->getOrInsertFunction(targetIsDarwin() ? "__error" : "__errno_location", ptrTy);
+    return builder->CreateCall(errnoFunc, {}, "errno_ptr");
+}
+
+llvm::Value *CodeGenerator::emitStdinFile() {
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Constant *stdinGlobal = module->getOrInsertGlobal(targetIsDarwin() ? "__stdinp" : "stdin", ptrTy);
+    return builder->CreateLoad(ptrTy, stdinGlobal, "stdin");
+}
+
+llvm::StructType *CodeGenerator::getFileStructType() {
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    return llvm::StructType::get(*context, {ptrTy, i64, i64, i64, ptrTy, i32, i32, i32});
+}
+
+// ptr __ppx_file_open(ptr path, ptr mode)：mode 为 "r"、"w" 或 "a"，失败时返回 null
+llvm::Function *CodeGenerator::getFileOpenFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_open")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *fileTy = getFileStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_open", llvm::FunctionType::get(ptrTy, {ptrTy, ptrTy}, false));
+    llvm::Value *path = function->getArg(0);
+    llvm::Value *mode = function->getArg(1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *modeEndBB = llvm::BasicBlock::Create(*context, "mode_end", function);
+    llvm::BasicBlock *invalidBB = llvm::BasicBlock::Create(*context, "invalid", function);
+    llvm::BasicBlock *openBB = llvm::BasicBlock::Create(*context, "open", function);
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "fail", function);
+    llvm::BasicBlock *openedBB = llvm::BasicBlock::Create(*context, "opened", function);
+    llvm::BasicBlock *writerBB = llvm::BasicBlock::Create(*context, "writer", function);
+    llvm::BasicBlock *readerBB = llvm::BasicBlock::Create(*context, "reader", function);
+    llvm::BasicBlock *mmapBB = llvm::BasicBlock::Create(*context, "mmap", function);
+    llvm::BasicBlock *mappedBB = llvm::BasicBlock::Create(*context, "mapped", function);
+    llvm::BasicBlock *bufferedBB = llvm::BasicBlock::Create(*context, "buffered", function);
+    llvm::FunctionCallee openFunc = module->getOrInsertFunction("open", llvm::FunctionType::get(i32, {ptrTy, i32}, true));
+    llvm::FunctionCallee lseekFunc = module->getOrInsertFunction("lseek", i64, i32, i64, i32);
+    llvm::FunctionCallee mmapFunc = module->getOrInsertFunction("mmap", ptrTy, ptrTy, i64, i32, i32, i32, i64);
+    llvm::FunctionCallee madviseFunc = module->getOrInsertFunction("madvise", i32, ptrTy, i64, i32);
+    llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+    llvm::Function *mallocFunc = module->getFunction("malloc");
+    llvm::Value *bufferSize = llvm::ConstantInt::get(i64, CodeGenConstants::FILE_BUFFER_SIZE);
+    llvm::Value *zero64 = llvm::ConstantInt::get(i64, 0);
+    llvm::Value *zero32 = llvm::ConstantInt::get(i32, 0);
+
+    // 模式必须恰好是一个字符 r、w 或 a
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *m = builder->CreateLoad(i8, mode, "m");
+    llvm::Value *isRead = builder->CreateICmpEQ(m, llvm::ConstantInt::get(i8, 'r'), "is_read");
+    llvm::Value *isAppend = builder->CreateICmpEQ(m, llvm::ConstantInt::get(i8, 'a'), "is_append");
+    llvm::Value *isWrite = builder->CreateICmpEQ(m, llvm::ConstantInt::get(i8, 'w'), "is_write");
+    builder->CreateCondBr(builder->CreateOr(builder->CreateOr(isRead, isAppend), isWrite), modeEndBB, invalidBB);
+
+    builder->SetInsertPoint(modeEndBB);
+    llvm::Value *m1 = builder->CreateLoad(i8, builder->CreateGEP(i8, mode, llvm::ConstantInt::get(i64, 1)), "m1");
+    builder->CreateCondBr(builder->CreateICmpEQ(m1, llvm::ConstantInt::get(i8, 0)), openBB, invalidBB);
+
+    builder->SetInsertPoint(invalidBB);
+    builder->CreateStore(llvm::ConstantInt::get(i32, 22), emitErrnoPtr());     // EINVAL
+    builder->CreateRet(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)));
+
+    builder->SetInsertPoint(openBB);
+    llvm::Value *flags = builder->CreateSelect(
+        isRead, zero32,
+        builder->CreateSelect(isAppend, llvm::ConstantInt::get(i32, fileWriteFlags(true)),
+                              llvm::ConstantInt::get(i32, fileWriteFlags(false))), "flags");
+    llvm::Value *fd = builder->CreateCall(openFunc, {path, flags, llvm::ConstantInt::get(i32, 0644)}, "fd");
+    builder->CreateCondBr(builder->CreateICmpSLT(fd, zero32), failBB, openedBB);
+
+    builder->SetInsertPoint(failBB);
+    builder->CreateRet(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)));
+
+    builder->SetInsertPoint(openedBB);
+    uint64_t headerSize = module->getDataLayout().getTypeAllocSize(fileTy);
+    llvm::Value *file = builder->CreateCall(mallocFunc, {llvm::ConstantInt::get(i64, headerSize)}, "file");
+    builder->CreateStore(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)),
+                         builder->CreateStructGEP(fileTy, file, FILE_DATA));
+    builder->CreateStore(zero64, builder->CreateStructGEP(fileTy, file, FILE_POS));
+    builder->CreateStore(zero64, builder->CreateStructGEP(fileTy, file, FILE_LEN));
+    builder->CreateStore(zero64, builder->CreateStructGEP(fileTy, file, FILE_CAPACITY));
+    builder->CreateStore(builder->CreateCall(strdupFunc, {path}, "path"), builder->CreateStructGEP(fileTy, file, FILE_PATH));
+    builder->CreateStore(fd, builder->CreateStructGEP(fileTy, file, FILE_FD));
+    builder->CreateStore(builder->CreateZExt(builder->CreateNot(isRead), i32), builder->CreateStructGEP(fileTy, file, FILE_WRITABLE));
+    builder->CreateStore(zero32, builder->CreateStructGEP(fileTy, file, FILE_MAPPED));
+    builder->CreateCondBr(isRead, readerBB, writerBB);
+
+    builder->SetInsertPoint(writerBB);
+    builder->CreateStore(builder->CreateCall(mallocFunc, {bufferSize}, "buffer"), builder->CreateStructGEP(fileTy, file, FILE_DATA));
+    builder->CreateStore(bufferSize, builder->CreateStructGEP(fileTy, file, FILE_CAPACITY));
+    builder->CreateRet(file);
+
+    // 管道和设备的 lseek 返回 -1，走缓冲读取
+    builder->SetInsertPoint(readerBB);
+    llvm::Value *size = builder->CreateCall(lseekFunc, {fd, zero64, llvm::ConstantInt::get(i32, 2)}, "size");   // SEEK_END
+    builder->CreateCondBr(builder->CreateICmpSGE(size, llvm::ConstantInt::get(i64, CodeGenConstants::FILE_MMAP_THRESHOLD)),
+                          mmapBB, bufferedBB);
+
+    builder->SetInsertPoint(mmapBB);
+    llvm::Value *mapping = builder->CreateCall(
+        mmapFunc, {llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)), size,
+                   llvm::ConstantInt::get(i32, 1), llvm::ConstantInt::get(i32, 2), fd, zero64}, "mapping");  // PROT_READ, MAP_PRIVATE
+    llvm::Value *mapFailed = builder->CreateICmpEQ(builder->CreatePtrToInt(mapping, i64), llvm::ConstantInt::get(i64, -1));
+    builder->CreateCondBr(mapFailed, bufferedBB, mappedBB);
+
+    builder->SetInsertPoint(mappedBB);
+    builder->CreateCall(madviseFunc, {mapping, size, llvm::ConstantInt::get(i32, 2)});    // MADV_SEQUENTIAL
+    builder->CreateStore(mapping, builder->CreateStructGEP(fileTy, file, FILE_DATA));
+    builder->CreateStore(size, builder->CreateStructGEP(fileTy, file, FILE_LEN));
+    builder->CreateStore(size, builder->CreateStructGEP(fileTy, file, FILE_CAPACITY));
+    builder->CreateStore(llvm::ConstantInt::get(i32, 1), builder->CreateStructGEP(fileTy, file, FILE_MAPPED));
+    builder->CreateRet(file);
+
+    builder->SetInsertPoint(bufferedBB);
+    builder->CreateCall(lseekFunc, {fd, zero64, zero32});     // SEEK_SET
+    builder->CreateStore(builder->CreateCall(mallocFunc, {bufferSize}, "buffer"), builder->CreateStructGEP(fileTy, file, FILE_DATA));
+    builder->CreateStore(bufferSize, builder->CreateStructGEP(fileTy, file, FILE_CAPACITY));
+    builder->CreateRet(file);
+    return function;
+}
+
+// i32 __ppx_file_fill(ptr f)：把未读字节移到缓冲区开头（缓冲区已满时容量翻倍），再用 read(2) 读满剩余空间；
+// 读到数据返回 1，文件结束返回 0，出错返回 -1（文件已关闭或以写入模式打开时 errno 为 EBADF）
+llvm::Function *CodeGenerator::getFileFillFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_fill")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *fileTy = getFileStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_fill", llvm::FunctionType::get(i32, {ptrTy}, false));
+    llvm::Value *file = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *badBB = llvm::BasicBlock::Create(*context, "bad", function);
+    llvm::BasicBlock *checkBB = llvm::BasicBlock::Create(*context, "check", function);
+    llvm::BasicBlock *eofBB = llvm::BasicBlock::Create(*context, "eof", function);
+    llvm::BasicBlock *compactBB = llvm::BasicBlock::Create(*context, "compact", function);
+    llvm::BasicBlock *growBB = llvm::BasicBlock::Create(*context, "grow", function);
+    llvm::BasicBlock *readBB = llvm::BasicBlock::Create(*context, "read", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "error", function);
+    llvm::BasicBlock *gotBB = llvm::BasicBlock::Create(*context, "got", function);
+    llvm::FunctionCallee memmoveFunc = module->getOrInsertFunction("memmove", ptrTy, ptrTy, ptrTy, i64);
+    llvm::FunctionCallee reallocFunc = module->getOrInsertFunction("realloc", ptrTy, ptrTy, i64);
+    llvm::FunctionCallee readFunc = module->getOrInsertFunction("read", i64, i32, ptrTy, i64);
+    llvm::Value *zero64 = llvm::ConstantInt::get(i64, 0);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *fd = builder->CreateLoad(i32, builder->CreateStructGEP(fileTy, file, FILE_FD), "fd");
+    llvm::Value *writable = builder->CreateLoad(i32, builder->CreateStructGEP(fileTy, file, FILE_WRITABLE), "writable");
+    llvm::Value *bad = builder->CreateOr(builder->CreateICmpSLT(fd, llvm::ConstantInt::get(i32, 0)),
+                                         builder->CreateICmpNE(writable, llvm::ConstantInt::get(i32, 0)));
+    builder->CreateCondBr(bad, badBB, checkBB);
+
+    builder->SetInsertPoint(badBB);
+    builder->CreateStore(llvm::ConstantInt::get(i32, 9), emitErrnoPtr());      // EBADF
+    builder->CreateRet(llvm::ConstantInt::get(i32, -1));
+
+    // mmap 映射已包含整个文件
+    builder->SetInsertPoint(checkBB);
+    llvm::Value *mapped = builder->CreateLoad(i32, builder->CreateStructGEP(fileTy, file, FILE_MAPPED), "mapped");
+    builder->CreateCondBr(builder->CreateICmpNE(mapped, llvm::ConstantInt::get(i32, 0)), eofBB, compactBB);
+
+    builder->SetInsertPoint(eofBB);
+    builder->CreateRet(llvm::ConstantInt::get(i32, 0));
+
+    builder->SetInsertPoint(compactBB);
+    llvm::Value *dataPtr = builder->CreateStructGEP(fileTy, file, FILE_DATA);
+    llvm::Value *posPtr = builder->CreateStructGEP(fileTy, file, FILE_POS);
+    llvm::Value *lenPtr = builder->CreateStructGEP(fileTy, file, FILE_LEN);
+    llvm::Value *capPtr = builder->CreateStructGEP(fileTy, file, FILE_CAPACITY);
+    llvm::Value *data = builder->CreateLoad(ptrTy, dataPtr, "data");
+    llvm::Value *pos = builder->CreateLoad(i64, posPtr, "pos");
+    llvm::Value *rest = builder->CreateSub(builder->CreateLoad(i64, lenPtr, "len"), pos, "rest");
+    llvm::Value *capacity = builder->CreateLoad(i64, capPtr, "capacity");
+    builder->CreateCall(memmoveFunc, {data, builder->CreateGEP(i8, data, pos), rest});
+    builder->CreateStore(zero64, posPtr);
+    builder->CreateStore(rest, lenPtr);
+    builder->CreateCondBr(builder->CreateICmpEQ(rest, capacity), growBB, readBB);
+
+    // 一行比缓冲区还长或 read_all 读取整个文件时扩容
+    builder->SetInsertPoint(growBB);
+    llvm::Value *doubled = builder->CreateShl(capacity, 1, "doubled");
+    llvm::Value *grown = builder->CreateCall(reallocFunc, {data, doubled}, "grown");
+    builder->CreateStore(grown, dataPtr);
+    builder->CreateStore(doubled, capPtr);
+    builder->CreateBr(readBB);
+
+    builder->SetInsertPoint(readBB);
+    llvm::PHINode *buffer = builder->CreatePHI(ptrTy, 2, "buffer");
+    llvm::PHINode *cap = builder->CreatePHI(i64, 2, "cap");
+    buffer->addIncoming(data, compactBB);
+    buffer->addIncoming(grown, growBB);
+    cap->addIncoming(capacity, compactBB);
+    cap->addIncoming(doubled, growBB);
+    llvm::Value *count = builder->CreateCall(
+        readFunc, {fd, builder->CreateGEP(i8, buffer, rest), builder->CreateSub(cap, rest)}, "count");
+    builder->CreateCondBr(builder->CreateICmpSLT(count, zero64), errorBB, gotBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateRet(llvm::ConstantInt::get(i32, -1));
+
+    builder->SetInsertPoint(gotBB);
+    builder->CreateStore(builder->CreateAdd(rest, count), lenPtr);
+    builder->CreateRet(builder->CreateZExt(builder->CreateICmpSGT(count, zero64), i32));
+    return function;
+}
+
+// i64 __ppx_file_next_line(ptr f, ptr buffer, ptr capacity)：读取下一行（不含换行符和行尾的 \r），
+// 复制到 *buffer 指向的可复用缓冲区（容量 *capacity，不够时 realloc）并以 NUL 结尾；
+// 返回行长度，文件结束返回 -1（*buffer 为空字符串），出错返回 -2
+llvm::Function *CodeGenerator::getFileNextLineFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_next_line")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *fileTy = getFileStructType();
+    llvm::Function *fillFunc = getFileFillFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_next_line", llvm::FunctionType::get(i64, {ptrTy, ptrTy, ptrTy}, false));
+    llvm::Value *file = function->getArg(0);
+    llvm::Value *bufferOut = function->getArg(1);
+    llvm::Value *capacityOut = function->getArg(2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *searchBB = llvm::BasicBlock::Create(*context, "search", function);
+    llvm::BasicBlock *scanBB = llvm::BasicBlock::Create(*context, "scan", function);
+    llvm::BasicBlock *notFoundBB = llvm::BasicBlock::Create(*context, "not_found", function);
+    llvm::BasicBlock *fillBB = llvm::BasicBlock::Create(*context, "fill", function);
+    llvm::BasicBlock *filledBB = llvm::BasicBlock::Create(*context, "filled", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "error", function);
+    llvm::BasicBlock *eofBB = llvm::BasicBlock::Create(*context, "eof", function);
+    llvm::BasicBlock *foundBB = llvm::BasicBlock::Create(*context, "found", function);
+    llvm::BasicBlock *lineBB = llvm::BasicBlock::Create(*context, "line", function);
+    llvm::BasicBlock *checkCrBB = llvm::BasicBlock::Create(*context, "check_cr", function);
+    llvm::BasicBlock *sizedBB = llvm::BasicBlock::Create(*context, "sized", function);
+    llvm::BasicBlock *growBB = llvm::BasicBlock::Create(*context, "grow", function);
+    llvm::BasicBlock *copyBB = llvm::BasicBlock::Create(*context, "copy", function);
+    llvm::FunctionCallee memchrFunc = module->getOrInsertFunction("memchr", ptrTy, ptrTy, i32, i64);
+    llvm::FunctionCallee memcpyFunc = module->getOrInsertFunction("memcpy", ptrTy, ptrTy, ptrTy, i64);
+    llvm::FunctionCallee reallocFunc = module->getOrInsertFunction("realloc", ptrTy, ptrTy, i64);
+    llvm::Value *zero64 = llvm::ConstantInt::get(i64, 0);
+    llvm::Value *one64 = llvm::ConstantInt::get(i64, 1);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *dataPtr = builder->CreateStructGEP(fileTy, file, FILE_DATA);
+    llvm::Value *posPtr = builder->CreateStructGEP(fileTy, file, FILE_POS);
+    llvm::Value *lenPtr = builder->CreateStructGEP(fileTy, file, FILE_LEN);
+    builder->CreateBr(searchBB);
+
+    // scanned 为已确认不含换行符的字节数（相对于 pos，补充缓冲区移动数据后仍然有效）
+    builder->SetInsertPoint(searchBB);
+    llvm::PHINode *scanned = builder->CreatePHI(i64, 2, "scanned");
+    scanned->addIncoming(zero64, entryBB);
+    llvm::Value *pos = builder->CreateLoad(i64, posPtr, "pos");
+    llvm::Value *len = builder->CreateLoad(i64, lenPtr, "len");
+    llvm::Value *data = builder->CreateLoad(ptrTy, dataPtr, "data");
+    llvm::Value *from = builder->CreateAdd(pos, scanned, "from");
+    llvm::Value *avail = builder->CreateSub(len, from, "avail");
+    builder->CreateCondBr(builder->CreateICmpSGT(avail, zero64), scanBB, fillBB);
+
+    builder->SetInsertPoint(scanBB);
+    llvm::Value *newline = builder->CreateCall(
+        memchrFunc, {builder->CreateGEP(i8, data, from), llvm::ConstantInt::get(i32, '\n'), avail}, "newline");
+    builder->CreateCondBr(builder->CreateIsNull(newline), notFoundBB, foundBB);
+
+    builder->SetInsertPoint(notFoundBB);
+    llvm::Value *allScanned = builder->CreateSub(len, pos, "all_scanned");
+    builder->CreateBr(fillBB);
+
+    builder->SetInsertPoint(fillBB);
+    llvm::PHINode *pending = builder->CreatePHI(i64, 2, "pending");
+    pending->addIncoming(scanned, searchBB);
+    pending->addIncoming(allScanned, notFoundBB);
+    llvm::Value *filled = builder->CreateCall(fillFunc, {file}, "filled");
+    builder->CreateCondBr(builder->CreateICmpSGT(filled, llvm::ConstantInt::get(i32, 0)), searchBB, filledBB);
+    scanned->addIncoming(pending, fillBB);
+
+    builder->SetInsertPoint(filledBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(filled, llvm::ConstantInt::get(i32, 0)), errorBB, eofBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateRet(llvm::ConstantInt::get(i64, -2));
+
+    // 文件结束：剩余字节是没有换行符的最后一行，没有剩余字节时返回 -1
+    builder->SetInsertPoint(eofBB);
+    llvm::Value *eofPos = builder->CreateLoad(i64, posPtr, "pos");
+    llvm::Value *eofStart = builder->CreateGEP(i8, builder->CreateLoad(ptrTy, dataPtr, "data"), eofPos, "start");
+    llvm::Value *atEnd = builder->CreateICmpEQ(pending, zero64, "at_end");
+    builder->CreateBr(lineBB);
+
+    builder->SetInsertPoint(foundBB);
+    llvm::Value *start = builder->CreateGEP(i8, data, pos, "start");
+    llvm::Value *lineLength = builder->CreateSub(builder->CreatePtrToInt(newline, i64), builder->CreatePtrToInt(start, i64), "line_length");
+    llvm::Value *withNewline = builder->CreateAdd(lineLength, one64, "with_newline");
+    builder->CreateBr(lineBB);
+
+    builder->SetInsertPoint(lineBB);
+    llvm::PHINode *lineStart = builder->CreatePHI(ptrTy, 2, "line_start");
+    llvm::PHINode *length = builder->CreatePHI(i64, 2, "length");
+    llvm::PHINode *consumed = builder->CreatePHI(i64, 2, "consumed");
+    llvm::PHINode *isEnd = builder->CreatePHI(builder->getInt1Ty(), 2, "is_end");
+    lineStart->addIncoming(eofStart, eofBB);
+    lineStart->addIncoming(start, foundBB);
+    length->addIncoming(pending, eofBB);
+    length->addIncoming(lineLength, foundBB);
+    consumed->addIncoming(pending, eofBB);
+    consumed->addIncoming(withNewline, foundBB);
+    isEnd->addIncoming(atEnd, eofBB);
+    isEnd->addIncoming(builder->getFalse(), foundBB);
+    builder->CreateStore(builder->CreateAdd(builder->CreateLoad(i64, posPtr, "pos"), consumed), posPtr);
+    builder->CreateCondBr(builder->CreateICmpSGT(length, zero64), checkCrBB, sizedBB);
+
+    // Windows 换行符 \r\n 的 \r 不属于行内容
+    builder->SetInsertPoint(checkCrBB);
+    llvm::Value *last = builder->CreateSub(length, one64, "last");
+    llvm::Value *lastChar = builder->CreateLoad(i8, builder->CreateGEP(i8, lineStart, last), "last_char");
+    llvm::Value *stripped = builder->CreateSelect(
+        builder->CreateICmpEQ(lastChar, llvm::ConstantInt::get(i8, '\r')), last, length, "stripped");
+    builder->CreateBr(sizedBB);
+
+    builder->SetInsertPoint(sizedBB);
+    llvm::PHINode *finalLength = builder->CreatePHI(i64, 2, "final_length");
+    finalLength->addIncoming(length, lineBB);
+    finalLength->addIncoming(stripped, checkCrBB);
+    llvm::Value *need = builder->CreateAdd(finalLength, one64, "need");
+    llvm::Value *oldBuffer = builder->CreateLoad(ptrTy, bufferOut, "old_buffer");
+    llvm::Value *oldCapacity = builder->CreateLoad(i64, capacityOut, "old_capacity");
+    builder->CreateCondBr(builder->CreateICmpUGT(need, oldCapacity), growBB, copyBB);
+
+    // 容量按 max(need, 2 * capacity, 64) 增长，多数行复用同一个缓冲区
+    builder->SetInsertPoint(growBB);
+    llvm::Value *twice = builder->CreateShl(oldCapacity, 1, "twice");
+    llvm::Value *newCapacity = builder->CreateSelect(builder->CreateICmpUGT(twice, need), twice, need);
+    newCapacity = builder->CreateSelect(builder->CreateICmpULT(newCapacity, llvm::ConstantInt::get(i64, 64)),
+                                        llvm::ConstantInt::get(i64, 64), newCapacity, "new_capacity");
+    llvm::Value *newBuffer = builder->CreateCall(reallocFunc, {oldBuffer, newCapacity}, "new_buffer");
+    builder->CreateStore(newBuffer, bufferOut);
+    builder->CreateStore(newCapacity, capacityOut);
+    builder->CreateBr(copyBB);
+
+    builder->SetInsertPoint(copyBB);
+    llvm::PHINode *lineBuffer = builder->CreatePHI(ptrTy, 2, "line_buffer");
+    lineBuffer->addIncoming(oldBuffer, sizedBB);
+    lineBuffer->addIncoming(newBuffer, growBB);
+    builder->CreateCall(memcpyFunc, {lineBuffer, lineStart, finalLength});
+    builder->CreateStore(llvm::ConstantInt::get(i8, 0), builder->CreateGEP(i8, lineBuffer, finalLength));
+    builder->CreateRet(builder->CreateSelect(isEnd, llvm::ConstantInt::get(i64, -1), finalLength));
+    return function;
+}
+
+// ptr __ppx_file_read_line(ptr f)：读取下一行并返回新字符串（文件结束时为空字符串），出错返回 null
+llvm::Function *CodeGenerator::getFileReadLineFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_read_line")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *nextLineFunc = getFileNextLineFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_read_line", llvm::FunctionType::get(ptrTy, {ptrTy}, false));
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "error", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *bufferVar = builder->CreateAlloca(ptrTy, nullptr, "buffer");
+    llvm::Value *capacityVar = builder->CreateAlloca(i64, nullptr, "capacity");
+    builder->CreateStore(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)), bufferVar);
+    builder->CreateStore(llvm::ConstantInt::get(i64, 0), capacityVar);
+    llvm::Value *length = builder->CreateCall(nextLineFunc, {function->getArg(0), bufferVar, capacityVar}, "length");
+    builder->CreateCondBr(builder->CreateICmpEQ(length, llvm::ConstantInt::get(i64, -2)), errorBB, doneBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateRet(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)));
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(builder->CreateLoad(ptrTy, bufferVar, "line"));
+    return function;
+}
+
+// ptr __ppx_file_read_all(ptr f)：读取文件的全部剩余内容并返回新字符串，出错返回 null
+llvm::Function *CodeGenerator::getFileReadAllFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_read_all")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *fileTy = getFileStructType();
+    llvm::Function *fillFunc = getFileFillFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_read_all", llvm::FunctionType::get(ptrTy, {ptrTy}, false));
+    llvm::Value *file = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *endBB = llvm::BasicBlock::Create(*context, "end", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "error", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::FunctionCallee memcpyFunc = module->getOrInsertFunction("memcpy", ptrTy, ptrTy, ptrTy, i64);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateBr(loopBB);
+
+    // 反复补充缓冲区（满时容量翻倍）直到文件结束，mmap 映射的文件直接结束
+    builder->SetInsertPoint(loopBB);
+    llvm::Value *filled = builder->CreateCall(fillFunc, {file}, "filled");
+    builder->CreateCondBr(builder->CreateICmpSGT(filled, llvm::ConstantInt::get(i32, 0)), loopBB, endBB);
+
+    builder->SetInsertPoint(endBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(filled, llvm::ConstantInt::get(i32, 0)), errorBB, doneBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateRet(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)));
+
+    builder->SetInsertPoint(doneBB);
+    llvm::Value *posPtr = builder->CreateStructGEP(fileTy, file, FILE_POS);
+    llvm::Value *pos = builder->CreateLoad(i64, posPtr, "pos");
+    llvm::Value *len = builder->CreateLoad(i64, builder->CreateStructGEP(fileTy, file, FILE_LEN), "len");
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(fileTy, file, FILE_DATA), "data");
+    llvm::Value *rest = builder->CreateSub(len, pos, "rest");
+    llvm::Value *result = builder->CreateCall(module->getFunction("malloc"), {builder->CreateAdd(rest, llvm::ConstantInt::get(i64, 1))}, "result");
+    builder->CreateCall(memcpyFunc, {result, builder->CreateGEP(i8, data, pos), rest});
+    builder->CreateStore(llvm::ConstantInt::get(i8, 0), builder->CreateGEP(i8, result, rest));
+    builder->CreateStore(len, posPtr);
+    builder->CreateRet(result);
+    return function;
+}
+
+// i1 __ppx_file_eof(ptr f)：缓冲区中没有未读字节且无法再读到数据时返回 true
+llvm::Function *CodeGenerator::getFileEofFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_eof")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *fileTy = getFileStructType();
+    llvm::Function *fillFunc = getFileFillFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_eof", llvm::FunctionType::get(builder->getInt1Ty(), {ptrTy}, false));
+    llvm::Value *file = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *pendingBB = llvm::BasicBlock::Create(*context, "pending", function);
+    llvm::BasicBlock *fillBB = llvm::BasicBlock::Create(*context, "fill", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *pos = builder->CreateLoad(i64, builder->CreateStructGEP(fileTy, file, FILE_POS), "pos");
+    llvm::Value *len = builder->CreateLoad(i64, builder->CreateStructGEP(fileTy, file, FILE_LEN), "len");
+    builder->CreateCondBr(builder->CreateICmpSLT(pos, len), pendingBB, fillBB);
+
+    builder->SetInsertPoint(pendingBB);
+    builder->CreateRet(builder->getFalse());
+
+    builder->SetInsertPoint(fillBB);
+    llvm::Value *filled = builder->CreateCall(fillFunc, {file}, "filled");
+    builder->CreateRet(builder->CreateICmpSLE(filled, llvm::ConstantInt::get(i32, 0)));
+    return function;
+}
+
+// i32 __ppx_file_write_all(i32 fd, ptr data, i64 n)：循环调用 write(2) 直到写完，出错返回 -1
+llvm::Function *CodeGenerator::getFileWriteAllFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_write_all")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_write_all", llvm::FunctionType::get(i32, {i32, ptrTy, i64}, false));
+    llvm::Value *fd = function->getArg(0);
+    llvm::Value *data = function->getArg(1);
+    llvm::Value *size = function->getArg(2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *writeBB = llvm::BasicBlock::Create(*context, "write", function);
+    llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*context, "next", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "error", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::FunctionCallee writeFunc = module->getOrInsertFunction("write", i64, i32, ptrTy, i64);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *offset = builder->CreatePHI(i64, 2, "offset");
+    offset->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(offset, size), writeBB, doneBB);
+
+    builder->SetInsertPoint(writeBB);
+    llvm::Value *written = builder->CreateCall(
+        writeFunc, {fd, builder->CreateGEP(i8, data, offset), builder->CreateSub(size, offset)}, "written");
+    builder->CreateCondBr(builder->CreateICmpSLT(written, llvm::ConstantInt::get(i64, 0)), errorBB, nextBB);
+
+    builder->SetInsertPoint(nextBB);
+    offset->addIncoming(builder->CreateAdd(offset, written), nextBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateRet(llvm::ConstantInt::get(i32, -1));
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(llvm::ConstantInt::get(i32, 0));
+    return function;
+}
+
+// i32 __ppx_file_write(ptr f, ptr s, i64 n)：把 n 个字节追加到写缓冲区，放不下时先写出缓冲区，
+// 不小于缓冲区大小的数据直接写出；出错返回 -1（文件已关闭或以读取模式打开时 errno 为 EBADF）
+llvm::Function *CodeGenerator::getFileWriteFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_write")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *fileTy = getFileStructType();
+    llvm::Function *writeAllFunc = getFileWriteAllFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_write", llvm::FunctionType::get(i32, {ptrTy, ptrTy, i64}, false));
+    llvm::Value *file = function->getArg(0);
+    llvm::Value *source = function->getArg(1);
+    llvm::Value *size = function->getArg(2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *badBB = llvm::BasicBlock::Create(*context, "bad", function);
+    llvm::BasicBlock *checkBB = llvm::BasicBlock::Create(*context, "check", function);
+    llvm::BasicBlock *flushBB = llvm::BasicBlock::Create(*context, "flush", function);
+    llvm::BasicBlock *flushedBB = llvm::BasicBlock::Create(*context, "flushed", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "error", function);
+    llvm::BasicBlock *directBB = llvm::BasicBlock::Create(*context, "direct", function);
+    llvm::BasicBlock *copyBB = llvm::BasicBlock::Create(*context, "copy", function);
+    llvm::FunctionCallee memcpyFunc = module->getOrInsertFunction("memcpy", ptrTy, ptrTy, ptrTy, i64);
+    llvm::Value *zero64 = llvm::ConstantInt::get(i64, 0);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *fd = builder->CreateLoad(i32, builder->CreateStructGEP(fileTy, file, FILE_FD), "fd");
+    llvm::Value *writable = builder->CreateLoad(i32, builder->CreateStructGEP(fileTy, file, FILE_WRITABLE), "writable");
+    llvm::Value *bad = builder->CreateOr(builder->CreateICmpSLT(fd, llvm::ConstantInt::get(i32, 0)),
+                                         builder->CreateICmpEQ(writable, llvm::ConstantInt::get(i32, 0)));
+    builder->CreateCondBr(bad, badBB, checkBB);
+
+    builder->SetInsertPoint(badBB);
+    builder->CreateStore(llvm::ConstantInt::get(i32, 9), emitErrnoPtr());      // EBADF
+    builder->CreateRet(llvm::ConstantInt::get(i32, -1));
+
+    builder->SetInsertPoint(checkBB);
+    llvm::Value *lenPtr = builder->CreateStructGEP(fileTy, file, FILE_LEN);
+    llvm::Value *len = builder->CreateLoad(i64, lenPtr, "len");
+    llvm::Value *capacity = builder->CreateLoad(i64, builder->CreateStructGEP(fileTy, file, FILE_CAPACITY), "capacity");
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(fileTy, file, FILE_DATA), "data");
+    builder->CreateCondBr(builder->CreateICmpUGT(builder->CreateAdd(len, size), capacity), flushBB, copyBB);
+
+    builder->SetInsertPoint(flushBB);
+    llvm::Value *flushed = builder->CreateCall(writeAllFunc, {fd, data, len}, "flushed");
+    builder->CreateCondBr(builder->CreateICmpSLT(flushed, llvm::ConstantInt::get(i32, 0)), errorBB, flushedBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateRet(llvm::ConstantInt::get(i32, -1));
+
+    builder->SetInsertPoint(flushedBB);
+    builder->CreateStore(zero64, lenPtr);
+    builder->CreateCondBr(builder->CreateICmpUGE(size, capacity), directBB, copyBB);
+
+    builder->SetInsertPoint(directBB);
+    builder->CreateRet(builder->CreateCall(writeAllFunc, {fd, source, size}, "written"));
+
+    builder->SetInsertPoint(copyBB);
+    llvm::PHINode *used = builder->CreatePHI(i64, 2, "used");
+    used->addIncoming(len, checkBB);
+    used->addIncoming(zero64, flushedBB);
+    builder->CreateCall(memcpyFunc, {builder->CreateGEP(i8, data, used), source, size});
+    builder->CreateStore(builder->CreateAdd(used, size), lenPtr);
+    builder->CreateRet(llvm::ConstantInt::get(i32, 0));
+    return function;
+}
+
+// i32 __ppx_file_flush(ptr f)：写出写缓冲区中的数据，出错返回 -1；以读取模式打开或已关闭的文件不做任何事
+llvm::Function *CodeGenerator::getFileFlushFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_flush")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *fileTy = getFileStructType();
+    llvm::Function *writeAllFunc = getFileWriteAllFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_flush", llvm::FunctionType::get(i32, {ptrTy}, false));
+    llvm::Value *file = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *flushBB = llvm::BasicBlock::Create(*context, "flush", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "error", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::BasicBlock *skipBB = llvm::BasicBlock::Create(*context, "skip", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *fd = builder->CreateLoad(i32, builder->CreateStructGEP(fileTy, file, FILE_FD), "fd");
+    llvm::Value *writable = builder->CreateLoad(i32, builder->CreateStructGEP(fileTy, file, FILE_WRITABLE), "writable");
+    llvm::Value *active = builder->CreateAnd(builder->CreateICmpSGE(fd, llvm::ConstantInt::get(i32, 0)),
+                                             builder->CreateICmpNE(writable, llvm::ConstantInt::get(i32, 0)));
+    builder->CreateCondBr(active, flushBB, skipBB);
+
+    builder->SetInsertPoint(flushBB);
+    llvm::Value *lenPtr = builder->CreateStructGEP(fileTy, file, FILE_LEN);
+    llvm::Value *len = builder->CreateLoad(i64, lenPtr, "len");
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(fileTy, file, FILE_DATA), "data");
+    llvm::Value *written = builder->CreateCall(writeAllFunc, {fd, data, len}, "written");
+    builder->CreateCondBr(builder->CreateICmpSLT(written, llvm::ConstantInt::get(i32, 0)), errorBB, doneBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateRet(llvm::ConstantInt::get(i32, -1));
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateStore(llvm::ConstantInt::get(i64, 0), lenPtr);
+    builder->CreateRet(llvm::ConstantInt::get(i32, 0));
+
+    builder->SetInsertPoint(skipBB);
+    builder->CreateRet(llvm::ConstantInt::get(i32, 0));
+    return function;
+}
+
+// i32 __ppx_file_close(ptr f)：写出缓冲区、释放缓冲区或解除映射并关闭文件描述符，出错返回 -1；
+// 关闭后头部保留（路径仍可用于异常消息），再次读写或关闭时 errno 为 EBADF
+llvm::Function *CodeGenerator::getFileCloseFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_file_close")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *fileTy = getFileStructType();
+    llvm::Function *flushFunc = getFileFlushFunction();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_file_close", llvm::FunctionType::get(i32, {ptrTy}, false));
+    llvm::Value *file = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *badBB = llvm::BasicBlock::Create(*context, "bad", function);
+    llvm::BasicBlock *flushBB = llvm::BasicBlock::Create(*context, "flush", function);
+    llvm::BasicBlock *unmapBB = llvm::BasicBlock::Create(*context, "unmap", function);
+    llvm::BasicBlock *freeBB = llvm::BasicBlock::Create(*context, "free", function);
+    llvm::BasicBlock *closeBB = llvm::BasicBlock::Create(*context, "close", function);
+    llvm::FunctionCallee munmapFunc = module->getOrInsertFunction("munmap", i32, ptrTy, i64);
+    llvm::FunctionCallee closeFunc = module->getOrInsertFunction("close", i32, i32);
+    llvm::Value *zero32 = llvm::ConstantInt::get(i32, 0);
+    llvm::Value *zero64 = llvm::ConstantInt::get(i64, 0);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *fdPtr = builder->CreateStructGEP(fileTy, file, FILE_FD);
+    llvm::Value *fd = builder->CreateLoad(i32, fdPtr, "fd");
+    builder->CreateCondBr(builder->CreateICmpSLT(fd, zero32), badBB, flushBB);
+
+    builder->SetInsertPoint(badBB);
+    builder->CreateStore(llvm::ConstantInt::get(i32, 9), emitErrnoPtr());      // EBADF
+    builder->CreateRet(llvm::ConstantInt::get(i32, -1));
+
+    builder->SetInsertPoint(flushBB);
+    llvm::Value *flushed = builder->CreateCall(flushFunc, {file}, "flushed");
+    llvm::Value *dataPtr = builder->CreateStructGEP(fileTy, file, FILE_DATA);
+    llvm::Value *data = builder->CreateLoad(ptrTy, dataPtr, "data");
+    llvm::Value *mappedPtr = builder->CreateStructGEP(fileTy, file, FILE_MAPPED);
+    llvm::Value *mapped = builder->CreateLoad(i32, mappedPtr, "mapped");
+    builder->CreateCondBr(builder->CreateICmpNE(mapped, zero32), unmapBB, freeBB);
+
+    builder->SetInsertPoint(unmapBB);
+    builder->CreateCall(munmapFunc, {data, builder->CreateLoad(i64, builder->CreateStructGEP(fileTy, file, FILE_CAPACITY), "size")});
+    builder->CreateBr(closeBB);
+
+    builder->SetInsertPoint(freeBB);
+    builder->CreateCall(module->getFunction("free"), {data});
+    builder->CreateBr(closeBB);
+
+    builder->SetInsertPoint(closeBB);
+    llvm::Value *closed = builder->CreateCall(closeFunc, {fd}, "closed");
+    builder->CreateStore(llvm::ConstantInt::get(i32, -1), fdPtr);
+    builder->CreateStore(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)), dataPtr);
+    builder->CreateStore(zero64, builder->CreateStructGEP(fileTy, file, FILE_POS));
+    builder->CreateStore(zero64, builder->CreateStructGEP(fileTy, file, FILE_LEN));
+    builder->CreateStore(zero64, builder->CreateStructGEP(fileTy, file, FILE_CAPACITY));
+    builder->CreateStore(zero32, mappedPtr);
+    llvm::Value *failed = builder->CreateOr(builder->CreateICmpSLT(flushed, zero32), builder->CreateICmpSLT(closed, zero32));
+    builder->CreateRet(builder->CreateSelect(failed, llvm::ConstantInt::get(i32, -1), zero32));
+    return function;
+}
+
+// 文件内置函数
+//
+// open(path[, mode]) 返回 file（mode 为 "r"、"w" 或 "a"，默认 "r"）；read_line(f)、read_all(f)、write(f, value)、
+// flush(f)、close(f)、eof(f) 也可以写成 f.read_line() 等方法调用。失败时抛出异常，消息包含路径和错误原因。
+// 与用户定义的同名函数冲突时调用用户函数。
+
+bool CodeGenerator::isFileBuiltin(const std::string &name) {
+    static const std::set<std::string> names = {
+        "open", "read_line", "read_all", "write", "flush", "close", "eof", "lines"};
+    return names.count(name) > 0;
+}
+
+std::string CodeGenerator::fileBuiltinType(const std::string &name) {
+    if (name == "open") {
+        return "file";
+    }
+    if (name == "read_line" || name == "read_all") {
+        return "string";
+    }
+    if (name == "eof") {
+        return "bool";
+    }
+    return "int";
+}
+
+bool CodeGenerator::fileBuiltinCall(FunctionCallNode *node, ExprNode *&handle, size_t &firstArg) {
+    if (!isFileBuiltin(node->functionName)) {
+        return false;
+    }
+    if (node->object) {
+        if (node->functionName == "open" || declaredTypeOf(node->object.get()) != "file") {
+            return false;
+        }
+        handle = node->object.get();
+        firstArg = 0;
+        return true;
+    }
+    if (functionPrototypes.count(node->functionName) || functions.count(node->functionName)) {
+        return false;
+    }
+    // 没有参数的 read_all() 读取标准输入（数值输入内置函数）
+    if (node->functionName == "read_all" && node->arguments.empty()) {
+        return false;
+    }
+    handle = node->functionName == "open" || node->arguments.empty() ? nullptr : node->arguments[0].get();
+    firstArg = node->functionName == "open" ? 0 : 1;
+    return true;
+}
+
+// 运行时函数失败时（failed 为 true）抛出异常，消息为 "<action> '<path>': <strerror(errno)>"
+void CodeGenerator::emitIoErrorCheck(llvm::Value *failed, const std::string &action, llvm::Value *path) {
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "io_error", function);
+    llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "io_ok", function);
+    builder->CreateCondBr(failed, failBB, okBB);
+
+    builder->SetInsertPoint(failBB);
+    llvm::Value *code = builder->CreateLoad(i32, emitErrnoPtr(), "errno");
+    llvm::FunctionCallee strerrorFunc = module->getOrInsertFunction("strerror", ptrTy, i32);
+    llvm::FunctionCallee snprintfFunc =
+        module->getOrInsertFunction("snprintf", llvm::FunctionType::get(i32, {ptrTy, i64, ptrTy}, true));
+    llvm::Type *messageTy = llvm::ArrayType::get(builder->getInt8Ty(), CodeGenConstants::IO_ERROR_BUFFER_SIZE);
+    llvm::AllocaInst *message = createEntryBlockAlloca(function, "io_error_msg", messageTy);
+    builder->CreateCall(snprintfFunc, {message, llvm::ConstantInt::get(i64, CodeGenConstants::IO_ERROR_BUFFER_SIZE),
+                                       builder->CreateGlobalString("%s '%s': %s", "", 0, module.get()),
+                                       builder->CreateGlobalString(action, "", 0, module.get()), path,
+                                       builder->CreateCall(strerrorFunc, {code}, "reason")});
+    emitThrow(message, false);
+
+    builder->SetInsertPoint(okBB);
+}
+
+llvm::Value *CodeGenerator::codegenFileBuiltin(FunctionCallNode *node, ExprNode *handle, size_t firstArg) {
+    const std::string &name = node->functionName;
+    if (g_verbose) {
+        std::cout << "[IR Gen] File builtin: " << name << "()" << std::endl;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+
+    if (name == "lines") {
+        reportError("lines() can only be used in a for loop", node->lineNumber);
+        return nullptr;
+    }
+
+    if (name == "open") {
+        size_t count = node->arguments.size();
+        if (count != 1 && count != 2) {
+            reportError("open() expects 1 or 2 arguments (path, mode)", node->lineNumber);
+            return nullptr;
+        }
+        llvm::Value *path = codegenExpr(node->arguments[0].get());
+        if (!path) {
+            return nullptr;
+        }
+        if (!path->getType()->isPointerTy() || isReferenceType(declaredTypeOf(node->arguments[0].get()))) {
+            reportError("open() expects a string path", node->lineNumber);
+            return nullptr;
+        }
+        llvm::Value *mode = nullptr;
+        if (count == 2) {
+            mode = codegenExpr(node->arguments[1].get());
+            if (!mode) {
+                return nullptr;
+            }
+            if (!mode->getType()->isPointerTy() || isReferenceType(declaredTypeOf(node->arguments[1].get()))) {
+                reportError("open() expects a string mode (\"r\", \"w\" or \"a\")", node->lineNumber);
+                return nullptr;
+            }
+            // 字面量模式在编译时检查
+            if (auto literal = dynamic_cast<StringLiteralNode *>(node->arguments[1].get())) {
+                if (literal->value != "r" && literal->value != "w" && literal->value != "a") {
+                    reportError("open() mode must be \"r\", \"w\" or \"a\"", node->lineNumber);
+                    return nullptr;
+                }
+            }
+        } else {
+            mode = builder->CreateGlobalString("r", "", 0, module.get());
+        }
+        llvm::Value *file = builder->CreateCall(getFileOpenFunction(), {path, mode}, "file");
+        emitIoErrorCheck(builder->CreateIsNull(file), "Cannot open file", path);
+        return file;
+    }
+
+    size_t expected = name == "write" ? 2 : 1;
+    if (!handle || node->arguments.size() - firstArg + 1 != expected) {
+        reportError(name + "() expects " + std::to_string(expected) +
+                    (expected == 1 ? " argument (file)" : " arguments (file, value)"), node->lineNumber);
+        return nullptr;
+    }
+    if (declaredTypeOf(handle) != "file") {
+        reportError(name + "() expects a file as its first argument", node->lineNumber);
+        return nullptr;
+    }
+    llvm::Value *file = codegenExpr(handle);
+    if (!file) {
+        return nullptr;
+    }
+    llvm::StructType *fileTy = getFileStructType();
+    auto filePath = [&]() {
+        return builder->CreateLoad(ptrTy, builder->CreateStructGEP(fileTy, file, FILE_PATH), "path");
+    };
+
+    if (name == "read_line" || name == "read_all") {
+        llvm::Function *readFunc = name == "read_line" ? getFileReadLineFunction() : getFileReadAllFunction();
+        llvm::Value *text = builder->CreateCall(readFunc, {file}, name);
+        emitIoErrorCheck(builder->CreateIsNull(text), "Cannot read from file", filePath());
+        pushTempMemory(text);
+        return text;
+    }
+
+    if (name == "eof") {
+        return builder->CreateCall(getFileEofFunction(), {file}, "eof");
+    }
+
+    if (name == "write") {
+        // 字符串（包括切片视图）按原样写入，其他值先转换为字符串
+        ExprNode *valueNode = node->arguments[firstArg].get();
+        llvm::Value *viewLength = nullptr;
+        llvm::Value *value = codegenStringView(valueNode, viewLength);
+        if (!value) {
+            return nullptr;
+        }
+        if (value->getType()->isPointerTy() && isReferenceType(declaredTypeOf(valueNode))) {
+            reportError("write() cannot write a value of type '" + declaredTypeOf(valueNode) + "'", node->lineNumber);
+            return nullptr;
+        }
+        if (!value->getType()->isPointerTy()) {
+            value = convertToString(value);
+            viewLength = nullptr;
+        }
+        llvm::Value *length = stringViewLength(value, viewLength);
+        llvm::Value *status = builder->CreateCall(getFileWriteFunction(), {file, value, length}, "status");
+        emitIoErrorCheck(builder->CreateICmpSLT(status, llvm::ConstantInt::get(i32, 0)), "Cannot write to file", filePath());
+        return builder->CreateTrunc(length, i32, "written");
+    }
+
+    // flush() / close() 成功时返回 0
+    bool isClose = name == "close";
+    llvm::Value *status = builder->CreateCall(isClose ? getFileCloseFunction() : getFileFlushFunction(), {file}, "status");
+    emitIoErrorCheck(builder->CreateICmpSLT(status, llvm::ConstantInt::get(i32, 0)),
+                     isClose ? "Cannot close file" : "Cannot write to file", filePath());
+    return llvm::ConstantInt::get(i32, 0);
+}
+
+// for line in lines(path) / lines(f)：逐行读取，循环变量指向复用的行缓冲区（下一次迭代时被覆盖）；
+// 参数是路径时在循环结束（包括 break）后关闭文件，参数是 file 时不关闭
+void CodeGenerator::codegenLinesForStmt(ForStmtNode *node, FunctionCallNode *call) {
+    if (g_verbose) {
+        std::cout << "[IR Gen] For loop: " << node->variable << " in lines()" << std::endl;
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+
+    ExprNode *source = call->object ? call->object.get() : call->arguments.empty() ? nullptr : call->arguments[0].get();
+    if (!source || call->arguments.size() != (call->object ? 0u : 1u)) {
+        reportError("lines() expects 1 argument (path or file)", node->lineNumber);
+        return;
+    }
+
+    // 检查循环变量名是否与已存在的局部变量冲突（警告而非错误）
+    if (currentDiagnostics().enableShadowWarnings && fn->namedValues.find(node->variable) != fn->namedValues.end()) {
+        reportWarning("For loop variable '" + node->variable + "' shadows an existing local variable", node->lineNumber);
+    }
+
+    bool ownsFile = declaredTypeOf(source) != "file";
+    llvm::Value *value = codegenExpr(source);
+    if (!value) {
+        return;
+    }
+    if (!value->getType()->isPointerTy() || (ownsFile && isReferenceType(declaredTypeOf(source)))) {
+        reportError("lines() expects a string path or a file", node->lineNumber);
+        return;
+    }
+    llvm::Value *file = value;
+    if (ownsFile) {
+        file = builder->CreateCall(getFileOpenFunction(), {value, builder->CreateGlobalString("r", "", 0, module.get())}, "file");
+        emitIoErrorCheck(builder->CreateIsNull(file), "Cannot open file", value);
+    }
+    clearTempMemory();
+
+    llvm::AllocaInst *loopVar = createEntryBlockAlloca(function, node->variable, ptrTy);
+    llvm::AllocaInst *bufferVar = createEntryBlockAlloca(function, node->variable + "_buffer", ptrTy);
+    llvm::AllocaInst *capacityVar = createEntryBlockAlloca(function, node->variable + "_capacity", i64);
+    builder->CreateStore(llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0)), bufferVar);
+    builder->CreateStore(llvm::ConstantInt::get(i64, 0), capacityVar);
+    fn->namedValues[node->variable] = loopVar;
+    fn->variableTypes[node->variable] = "string";
+
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "forlines_cond", function);
+    llvm::BasicBlock *checkBB = llvm::BasicBlock::Create(*context, "forlines_check");
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "forlines_body");
+    llvm::BasicBlock *incrBB = llvm::BasicBlock::Create(*context, "forlines_incr");
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(*context, "after_forlines");
+
+    LoopContext loopCtx;
+    loopCtx.continueBlock = incrBB;
+    loopCtx.breakBlock = afterBB;
+    fn->loopContextStack.push_back(loopCtx);
+
+    // 长度 -1 为文件结束，-2 为读取出错
+    builder->CreateBr(condBB);
+    builder->SetInsertPoint(condBB);
+    llvm::Value *length = builder->CreateCall(getFileNextLineFunction(), {file, bufferVar, capacityVar}, "line_length");
+    llvm::Value *path = builder->CreateLoad(ptrTy, builder->CreateStructGEP(getFileStructType(), file, FILE_PATH), "path");
+    emitIoErrorCheck(builder->CreateICmpEQ(length, llvm::ConstantInt::get(i64, -2)), "Cannot read from file", path);
+    builder->CreateBr(checkBB);
+
+    function->insert(function->end(), checkBB);
+    builder->SetInsertPoint(checkBB);
+    builder->CreateCondBr(builder->CreateICmpSGE(length, llvm::ConstantInt::get(i64, 0)), bodyBB, afterBB);
+
+    function->insert(function->end(), bodyBB);
+    builder->SetInsertPoint(bodyBB);
+    builder->CreateStore(builder->CreateLoad(ptrTy, bufferVar, "line"), loopVar);
+    codegenStmt(node->body.get());
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(incrBB);
+    }
+
+    function->insert(function->end(), incrBB);
+    builder->SetInsertPoint(incrBB);
+    clearTempMemory();
+    builder->CreateBr(condBB);
+
+    function->insert(function->end(), afterBB);
+    builder->SetInsertPoint(afterBB);
+    attachLoopHints(node->annotations, node->lineNumber, condBB);
+    fn->loopContextStack.pop_back();
+    builder->CreateCall(module->getFunction("free"), {builder->CreateLoad(ptrTy, bufferVar, "line_buffer")});
+    if (ownsFile) {
+        builder->CreateCall(getFileCloseFunction(), {file});
+    }
+
+    // 循环变量的作用域仅限于循环内
+    fn->namedValues.erase(node->variable);
+    fn->variableTypes.erase(node->variable);
+}
+
+// 排序和查找运行时
+//
+// 每种元素类型（int、double、char、string）和方向分别生成一组函数，比较直接内联为整数或浮点比较（字符串调用
+// __ppx_str_compare），不经过函数指针。排序使用内省排序：三数取中的 Hoare 划分，不超过 INSERTION_SORT_THRESHOLD
+// 个元素的区间改用插入排序，递归深度超过 2*log2(n) 时改用堆排序，保证最坏 O(n log n)；
+// 不少于 RADIX_SORT_THRESHOLD 个元素的 int 数组使用 LSD 基数排序（4 趟，每趟 8 位）。
+
+// 运行时函数名的元素类型后缀
+static std::string sortSuffix(const std::string &elementType) {
+    if (elementType == "int") return "i32";
+    if (elementType == "double") return "f64";
+    if (elementType == "char") return "i8";
+    return "str";
+}
+
+bool CodeGenerator::isSortableElementType(const std::string &typeName) {
+    return typeName == "int" || typeName == "double" || typeName == "char" || typeName == "string";
+}
+
+// i32 __ppx_str_compare(ptr a, ptr b)：与 strcmp 相同的顺序，首字节不同时不调用 strcmp
+llvm::Function *CodeGenerator::getStringCompareFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_str_compare")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i8 = llvm::Type::getInt8Ty(*context);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_str_compare", llvm::FunctionType::get(i32, {ptrTy, ptrTy}, false));
+    llvm::Value *a = function->getArg(0);
+    llvm::Value *b = function->getArg(1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *differBB = llvm::BasicBlock::Create(*context, "differ", function);
+    llvm::BasicBlock *sameBB = llvm::BasicBlock::Create(*context, "same", function);
+    llvm::BasicBlock *restBB = llvm::BasicBlock::Create(*context, "rest", function);
+    llvm::BasicBlock *endBB = llvm::BasicBlock::Create(*context, "end", function);
+    llvm::FunctionCallee strcmpFunc = module->getOrInsertFunction("strcmp", i32, ptrTy, ptrTy);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *ca = builder->CreateZExt(builder->CreateLoad(i8, a, "ca"), i32);
+    llvm::Value *cb = builder->CreateZExt(builder->CreateLoad(i8, b, "cb"), i32);
+    builder->CreateCondBr(builder->CreateICmpNE(ca, cb), differBB, sameBB);
+
+    builder->SetInsertPoint(differBB);
+    builder->CreateRet(builder->CreateSub(ca, cb));
+
+    builder->SetInsertPoint(sameBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(ca, llvm::ConstantInt::get(i32, 0)), endBB, restBB);
+
+    builder->SetInsertPoint(endBB);
+    builder->CreateRet(llvm::ConstantInt::get(i32, 0));
+
+    builder->SetInsertPoint(restBB);
+    llvm::Value *one = builder->getInt64(1);
+    builder->CreateRet(builder->CreateCall(strcmpFunc, {builder->CreateGEP(i8, a, one), builder->CreateGEP(i8, b, one)}, "cmp"));
+    return function;
+}
+
+llvm::Value *CodeGenerator::emitElementLess(const std::string &elementType, llvm::Value *a, llvm::Value *b,
+                                            bool descending) {
+    if (descending) {
+        std::swap(a, b);
+    }
+    if (elementType == "double") {
+        return builder->CreateFCmpOLT(a, b, "less");
+    }
+    if (elementType == "string") {
+        llvm::Value *cmp = builder->CreateCall(getStringCompareFunction(), {a, b}, "cmp");
+        return builder->CreateICmpSLT(cmp, builder->getInt32(0), "less");
+    }
+    return builder->CreateICmpSLT(a, b, "less");
+}
+
+llvm::Value *CodeGenerator::emitElementEqual(const std::string &elementType, llvm::Value *a, llvm::Value *b) {
+    if (elementType == "double") {
+        return builder->CreateFCmpOEQ(a, b, "equal");
+    }
+    if (elementType == "string") {
+        llvm::Value *cmp = builder->CreateCall(getStringCompareFunction(), {a, b}, "cmp");
+        return builder->CreateICmpEQ(cmp, builder->getInt32(0), "equal");
+    }
+    return builder->CreateICmpEQ(a, b, "equal");
+}
+
+// void __ppx_insertion_sort_T(ptr data, i64 lo, i64 hi)：对 [lo, hi) 插入排序
+llvm::Function *CodeGenerator::getInsertionSortFunction(const std::string &elementType, bool descending) {
+    std::string name = "__ppx_insertion_sort_" + std::string(descending ? "desc_" : "") + sortSuffix(elementType);
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(builder->getVoidTy(), {ptrTy, i64, i64}, false));
+    llvm::Value *data = function->getArg(0);
+    llvm::Value *lo = function->getArg(1);
+    llvm::Value *hi = function->getArg(2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *outerBB = llvm::BasicBlock::Create(*context, "outer", function);
+    llvm::BasicBlock *takeBB = llvm::BasicBlock::Create(*context, "take", function);
+    llvm::BasicBlock *innerBB = llvm::BasicBlock::Create(*context, "inner", function);
+    llvm::BasicBlock *compareBB = llvm::BasicBlock::Create(*context, "compare", function);
+    llvm::BasicBlock *shiftBB = llvm::BasicBlock::Create(*context, "shift", function);
+    llvm::BasicBlock *placeBB = llvm::BasicBlock::Create(*context, "place", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *start = builder->CreateAdd(lo, one, "start");
+    builder->CreateBr(outerBB);
+
+    builder->SetInsertPoint(outerBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    i->addIncoming(start, entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(i, hi), takeBB, doneBB);
+
+    builder->SetInsertPoint(takeBB);
+    llvm::Value *x = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, i), "x");
+    builder->CreateBr(innerBB);
+
+    // 把比 x 大的元素依次后移一位
+    builder->SetInsertPoint(innerBB);
+    llvm::PHINode *j = builder->CreatePHI(i64, 2, "j");
+    j->addIncoming(i, takeBB);
+    builder->CreateCondBr(builder->CreateICmpSGT(j, lo), compareBB, placeBB);
+
+    builder->SetInsertPoint(compareBB);
+    llvm::Value *prev = builder->CreateSub(j, one, "prev");
+    llvm::Value *y = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, prev), "y");
+    builder->CreateCondBr(emitElementLess(elementType, x, y, descending), shiftBB, placeBB);
+
+    builder->SetInsertPoint(shiftBB);
+    builder->CreateStore(y, builder->CreateGEP(elementTy, data, j));
+    j->addIncoming(prev, shiftBB);
+    builder->CreateBr(innerBB);
+
+    builder->SetInsertPoint(placeBB);
+    builder->CreateStore(x, builder->CreateGEP(elementTy, data, j));
+    i->addIncoming(builder->CreateAdd(i, one), placeBB);
+    builder->CreateBr(outerBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_sift_down_T(ptr base, i64 root, i64 n)：大顶堆（降序时为小顶堆）的下沉
+llvm::Function *CodeGenerator::getSiftDownFunction(const std::string &elementType, bool descending) {
+    std::string name = "__ppx_sift_down_" + std::string(descending ? "desc_" : "") + sortSuffix(elementType);
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(builder->getVoidTy(), {ptrTy, i64, i64}, false));
+    llvm::Value *base = function->getArg(0);
+    llvm::Value *n = function->getArg(2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *pickBB = llvm::BasicBlock::Create(*context, "pick", function);
+    llvm::BasicBlock *rightBB = llvm::BasicBlock::Create(*context, "right", function);
+    llvm::BasicBlock *chosenBB = llvm::BasicBlock::Create(*context, "chosen", function);
+    llvm::BasicBlock *swapBB = llvm::BasicBlock::Create(*context, "swap", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *root = builder->CreatePHI(i64, 2, "root");
+    root->addIncoming(function->getArg(1), entryBB);
+    llvm::Value *left = builder->CreateAdd(builder->CreateShl(root, 1), one, "left");
+    builder->CreateCondBr(builder->CreateICmpSLT(left, n), pickBB, doneBB);
+
+    builder->SetInsertPoint(pickBB);
+    llvm::Value *right = builder->CreateAdd(left, one, "right");
+    builder->CreateCondBr(builder->CreateICmpSLT(right, n), rightBB, chosenBB);
+
+    builder->SetInsertPoint(rightBB);
+    llvm::Value *leftValue = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, base, left), "left_value");
+    llvm::Value *rightValue = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, base, right), "right_value");
+    llvm::Value *larger = builder->CreateSelect(emitElementLess(elementType, leftValue, rightValue, descending),
+                                                right, left, "larger");
+    builder->CreateBr(chosenBB);
+
+    builder->SetInsertPoint(chosenBB);
+    llvm::PHINode *child = builder->CreatePHI(i64, 2, "child");
+    child->addIncoming(left, pickBB);
+    child->addIncoming(larger, rightBB);
+    llvm::Value *rootPtr = builder->CreateGEP(elementTy, base, root);
+    llvm::Value *childPtr = builder->CreateGEP(elementTy, base, child);
+    llvm::Value *rootValue = builder->CreateLoad(elementTy, rootPtr, "root_value");
+    llvm::Value *childValue = builder->CreateLoad(elementTy, childPtr, "child_value");
+    builder->CreateCondBr(emitElementLess(elementType, rootValue, childValue, descending), swapBB, doneBB);
+
+    builder->SetInsertPoint(swapBB);
+    builder->CreateStore(childValue, rootPtr);
+    builder->CreateStore(rootValue, childPtr);
+    root->addIncoming(child, swapBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_heap_sort_T(ptr data, i64 lo, i64 hi)：对 [lo, hi) 堆排序（内省排序递归过深时使用）
+llvm::Function *CodeGenerator::getHeapSortFunction(const std::string &elementType, bool descending) {
+    std::string name = "__ppx_heap_sort_" + std::string(descending ? "desc_" : "") + sortSuffix(elementType);
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Function *siftFunc = getSiftDownFunction(elementType, descending);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(builder->getVoidTy(), {ptrTy, i64, i64}, false));
+    llvm::Value *lo = function->getArg(1);
+    llvm::Value *hi = function->getArg(2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *buildBB = llvm::BasicBlock::Create(*context, "build", function);
+    llvm::BasicBlock *buildStepBB = llvm::BasicBlock::Create(*context, "build_step", function);
+    llvm::BasicBlock *extractBB = llvm::BasicBlock::Create(*context, "extract", function);
+    llvm::BasicBlock *extractStepBB = llvm::BasicBlock::Create(*context, "extract_step", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::Value *zero = llvm::ConstantInt::get(i64, 0);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *base = builder->CreateGEP(elementTy, function->getArg(0), lo, "base");
+    llvm::Value *n = builder->CreateSub(hi, lo, "n");
+    llvm::Value *half = builder->CreateLShr(n, 1, "half");
+    builder->CreateBr(buildBB);
+
+    // 建堆：从最后一个非叶结点开始逐个下沉
+    builder->SetInsertPoint(buildBB);
+    llvm::PHINode *start = builder->CreatePHI(i64, 2, "start");
+    start->addIncoming(half, entryBB);
+    builder->CreateCondBr(builder->CreateICmpSGT(start, zero), buildStepBB, extractBB);
+
+    builder->SetInsertPoint(buildStepBB);
+    llvm::Value *node = builder->CreateSub(start, one, "node");
+    builder->CreateCall(siftFunc, {base, node, n});
+    start->addIncoming(node, buildStepBB);
+    builder->CreateBr(buildBB);
+
+    // 依次把堆顶交换到末尾
+    builder->SetInsertPoint(extractBB);
+    llvm::PHINode *end = builder->CreatePHI(i64, 2, "end");
+    end->addIncoming(n, buildBB);
+    builder->CreateCondBr(builder->CreateICmpSGT(end, one), extractStepBB, doneBB);
+
+    builder->SetInsertPoint(extractStepBB);
+    llvm::Value *last = builder->CreateSub(end, one, "last");
+    llvm::Value *lastPtr = builder->CreateGEP(elementTy, base, last);
+    llvm::Value *top = builder->CreateLoad(elementTy, base, "top");
+    builder->CreateStore(builder->CreateLoad(elementTy, lastPtr, "tail"), base);
+    builder->CreateStore(top, lastPtr);
+    builder->CreateCall(siftFunc, {base, zero, last});
+    end->addIncoming(last, extractStepBB);
+    builder->CreateBr(extractBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_intro_sort_T(ptr data, i64 lo, i64 hi, i32 depth)：对 [lo, hi) 内省排序，
+// 较短的一侧递归，较长的一侧继续循环，递归深度不超过 log2(n)
+llvm::Function *CodeGenerator::getIntroSortFunction(const std::string &elementType, bool descending) {
+    std::string name = "__ppx_intro_sort_" + std::string(descending ? "desc_" : "") + sortSuffix(elementType);
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Function *insertionFunc = getInsertionSortFunction(elementType, descending);
+    llvm::Function *heapFunc = getHeapSortFunction(elementType, descending);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(builder->getVoidTy(), {ptrTy, i64, i64, i32}, false));
+    llvm::Value *data = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *smallBB = llvm::BasicBlock::Create(*context, "small", function);
+    llvm::BasicBlock *depthBB = llvm::BasicBlock::Create(*context, "check_depth", function);
+    llvm::BasicBlock *heapBB = llvm::BasicBlock::Create(*context, "heap", function);
+    llvm::BasicBlock *pivotBB = llvm::BasicBlock::Create(*context, "pivot", function);
+    llvm::BasicBlock *scanLeftBB = llvm::BasicBlock::Create(*context, "scan_left", function);
+    llvm::BasicBlock *scanRightBB = llvm::BasicBlock::Create(*context, "scan_right", function);
+    llvm::BasicBlock *crossBB = llvm::BasicBlock::Create(*context, "cross", function);
+    llvm::BasicBlock *swapBB = llvm::BasicBlock::Create(*context, "swap", function);
+    llvm::BasicBlock *splitBB = llvm::BasicBlock::Create(*context, "split", function);
+    llvm::BasicBlock *recurseLeftBB = llvm::BasicBlock::Create(*context, "recurse_left", function);
+    llvm::BasicBlock *recurseRightBB = llvm::BasicBlock::Create(*context, "recurse_right", function);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *lo = builder->CreatePHI(i64, 3, "lo");
+    llvm::PHINode *hi = builder->CreatePHI(i64, 3, "hi");
+    llvm::PHINode *depth = builder->CreatePHI(i32, 3, "depth");
+    lo->addIncoming(function->getArg(1), entryBB);
+    hi->addIncoming(function->getArg(2), entryBB);
+    depth->addIncoming(function->getArg(3), entryBB);
+    llvm::Value *n = builder->CreateSub(hi, lo, "n");
+    builder->CreateCondBr(builder->CreateICmpSLE(n, llvm::ConstantInt::get(i64, CodeGenConstants::INSERTION_SORT_THRESHOLD)),
+                          smallBB, depthBB);
+
+    builder->SetInsertPoint(smallBB);
+    builder->CreateCall(insertionFunc, {data, lo, hi});
+    builder->CreateRetVoid();
+
+    builder->SetInsertPoint(depthBB);
+    builder->CreateCondBr(builder->CreateICmpEQ(depth, llvm::ConstantInt::get(i32, 0)), heapBB, pivotBB);
+
+    builder->SetInsertPoint(heapBB);
+    builder->CreateCall(heapFunc, {data, lo, hi});
+    builder->CreateRetVoid();
+
+    // 三数取中：把 data[lo]、data[mid]、data[last] 排好序，中位数作为枢轴，两端同时成为扫描的哨兵
+    builder->SetInsertPoint(pivotBB);
+    llvm::Value *last = builder->CreateSub(hi, one, "last");
+    llvm::Value *mid = builder->CreateAdd(lo, builder->CreateLShr(builder->CreateSub(last, lo), 1), "mid");
+    llvm::Value *loPtr = builder->CreateGEP(elementTy, data, lo);
+    llvm::Value *midPtr = builder->CreateGEP(elementTy, data, mid);
+    llvm::Value *lastPtr = builder->CreateGEP(elementTy, data, last);
+    llvm::Value *a = builder->CreateLoad(elementTy, loPtr, "a");
+    llvm::Value *b = builder->CreateLoad(elementTy, midPtr, "b");
+    llvm::Value *c = builder->CreateLoad(elementTy, lastPtr, "c");
+    llvm::Value *swapAB = emitElementLess(elementType, b, a, descending);
+    llvm::Value *a1 = builder->CreateSelect(swapAB, b, a);
+    llvm::Value *b1 = builder->CreateSelect(swapAB, a, b);
+    llvm::Value *swapAC = emitElementLess(elementType, c, a1, descending);
+    llvm::Value *low = builder->CreateSelect(swapAC, c, a1, "low");
+    llvm::Value *c1 = builder->CreateSelect(swapAC, a1, c);
+    llvm::Value *swapBC = emitElementLess(elementType, c1, b1, descending);
+    llvm::Value *pivot = builder->CreateSelect(swapBC, c1, b1, "pivot");
+    llvm::Value *high = builder->CreateSelect(swapBC, b1, c1, "high");
+    builder->CreateStore(low, loPtr);
+    builder->CreateStore(pivot, midPtr);
+    builder->CreateStore(high, lastPtr);
+    llvm::Value *before = builder->CreateSub(lo, one, "before");
+    builder->CreateBr(scanLeftBB);
+
+    // Hoare 划分：从左找不小于枢轴的元素，从右找不大于枢轴的元素，交叉前交换
+    builder->SetInsertPoint(scanLeftBB);
+    llvm::PHINode *iPrev = builder->CreatePHI(i64, 3, "i_prev");
+    llvm::PHINode *jCarry = builder->CreatePHI(i64, 3, "j_carry");
+    iPrev->addIncoming(before, pivotBB);
+    jCarry->addIncoming(hi, pivotBB);
+    llvm::Value *i = builder->CreateAdd(iPrev, one, "i");
+    llvm::Value *iPtr = builder->CreateGEP(elementTy, data, i);
+    llvm::Value *left = builder->CreateLoad(elementTy, iPtr, "left");
+    iPrev->addIncoming(i, scanLeftBB);
+    jCarry->addIncoming(jCarry, scanLeftBB);
+    builder->CreateCondBr(emitElementLess(elementType, left, pivot, descending), scanLeftBB, scanRightBB);
+
+    builder->SetInsertPoint(scanRightBB);
+    llvm::PHINode *jPrev = builder->CreatePHI(i64, 2, "j_prev");
+    jPrev->addIncoming(jCarry, scanLeftBB);
+    llvm::Value *j = builder->CreateSub(jPrev, one, "j");
+    llvm::Value *jPtr = builder->CreateGEP(elementTy, data, j);
+    llvm::Value *right = builder->CreateLoad(elementTy, jPtr, "right");
+    jPrev->addIncoming(j, scanRightBB);
+    builder->CreateCondBr(emitElementLess(elementType, pivot, right, descending), scanRightBB, crossBB);
+
+    builder->SetInsertPoint(crossBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(i, j), swapBB, splitBB);
+
+    builder->SetInsertPoint(swapBB);
+    builder->CreateStore(right, iPtr);
+    builder->CreateStore(left, jPtr);
+    iPrev->addIncoming(i, swapBB);
+    jCarry->addIncoming(j, swapBB);
+    builder->CreateBr(scanLeftBB);
+
+    // [lo, j] 和 [j + 1, hi) 都不为空
+    builder->SetInsertPoint(splitBB);
+    llvm::Value *split = builder->CreateAdd(j, one, "split");
+    llvm::Value *nextDepth = builder->CreateSub(depth, llvm::ConstantInt::get(i32, 1), "next_depth");
+    builder->CreateCondBr(builder->CreateICmpSLT(builder->CreateSub(split, lo), builder->CreateSub(hi, split)),
+                          recurseLeftBB, recurseRightBB);
+
+    builder->SetInsertPoint(recurseLeftBB);
+    builder->CreateCall(function, {data, lo, split, nextDepth});
+    lo->addIncoming(split, recurseLeftBB);
+    hi->addIncoming(hi, recurseLeftBB);
+    depth->addIncoming(nextDepth, recurseLeftBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(recurseRightBB);
+    builder->CreateCall(function, {data, split, hi, nextDepth});
+    lo->addIncoming(lo, recurseRightBB);
+    hi->addIncoming(split, recurseRightBB);
+    depth->addIncoming(nextDepth, recurseRightBB);
+    builder->CreateBr(loopBB);
+    return function;
+}
+
+// void __ppx_radix_sort_i32(ptr data, i64 n, i32 mask)：LSD 基数排序，按 (x ^ mask) 的无符号大小排列；
+// mask 为 0x80000000 时为升序，0x7fffffff 时为降序。一趟遍历同时统计 4 个字节的直方图，
+// 所有元素在某个字节上相同时跳过该趟
+llvm::Function *CodeGenerator::getRadixSortFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_radix_sort_i32")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_radix_sort_i32", llvm::FunctionType::get(builder->getVoidTy(), {ptrTy, i64, i32}, false));
+    llvm::Value *data = function->getArg(0);
+    llvm::Value *n = function->getArg(1);
+    llvm::Value *mask = function->getArg(2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *histBB = llvm::BasicBlock::Create(*context, "hist", function);
+    llvm::BasicBlock *histBodyBB = llvm::BasicBlock::Create(*context, "hist_body", function);
+    llvm::BasicBlock *passBB = llvm::BasicBlock::Create(*context, "pass", function);
+    llvm::BasicBlock *passBodyBB = llvm::BasicBlock::Create(*context, "pass_body", function);
+    llvm::BasicBlock *prefixBB = llvm::BasicBlock::Create(*context, "prefix", function);
+    llvm::BasicBlock *scatterBB = llvm::BasicBlock::Create(*context, "scatter", function);
+    llvm::BasicBlock *scatterBodyBB = llvm::BasicBlock::Create(*context, "scatter_body", function);
+    llvm::BasicBlock *passDoneBB = llvm::BasicBlock::Create(*context, "pass_done", function);
+    llvm::BasicBlock *skipBB = llvm::BasicBlock::Create(*context, "skip", function);
+    llvm::BasicBlock *finishBB = llvm::BasicBlock::Create(*context, "finish", function);
+    llvm::BasicBlock *copyBB = llvm::BasicBlock::Create(*context, "copy", function);
+    llvm::BasicBlock *freeBB = llvm::BasicBlock::Create(*context, "free", function);
+    llvm::FunctionCallee memsetFunc = module->getOrInsertFunction("memset", ptrTy, ptrTy, i32, i64);
+    llvm::FunctionCallee memcpyFunc = module->getOrInsertFunction("memcpy", ptrTy, ptrTy, ptrTy, i64);
+    llvm::Value *zero = llvm::ConstantInt::get(i64, 0);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+    llvm::Value *byteMask = llvm::ConstantInt::get(i32, 255);
+    llvm::Value *bytes = builder->getInt64(4);
+
+    // counts[pass * 256 + byte]：4 个直方图
+    builder->SetInsertPoint(entryBB);
+    llvm::Type *countsTy = llvm::ArrayType::get(i64, 4 * 256);
+    llvm::Value *counts = builder->CreateAlloca(countsTy, nullptr, "counts");
+    builder->CreateCall(memsetFunc, {counts, llvm::ConstantInt::get(i32, 0), builder->getInt64(4 * 256 * 8)});
+    llvm::Value *temp = builder->CreateCall(module->getFunction("malloc"), {builder->CreateMul(n, bytes)}, "temp");
+    builder->CreateBr(histBB);
+
+    builder->SetInsertPoint(histBB);
+    llvm::PHINode *hi = builder->CreatePHI(i64, 2, "i");
+    hi->addIncoming(zero, entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(hi, n), histBodyBB, passBB);
+
+    builder->SetInsertPoint(histBodyBB);
+    llvm::Value *key = builder->CreateXor(builder->CreateLoad(i32, builder->CreateGEP(i32, data, hi), "x"), mask, "key");
+    for (unsigned pass = 0; pass < 4; pass++) {
+        llvm::Value *digit = builder->CreateAnd(builder->CreateLShr(key, pass * 8), byteMask);
+        llvm::Value *slot = builder->CreateAdd(builder->CreateZExt(digit, i64), builder->getInt64(pass * 256));
+        llvm::Value *slotPtr = builder->CreateGEP(i64, counts, slot);
+        builder->CreateStore(builder->CreateAdd(builder->CreateLoad(i64, slotPtr, "count"), one), slotPtr);
+    }
+    hi->addIncoming(builder->CreateAdd(hi, one), histBodyBB);
+    builder->CreateBr(histBB);
+
+    builder->SetInsertPoint(passBB);
+    llvm::PHINode *pass = builder->CreatePHI(i32, 3, "pass");
+    llvm::PHINode *src = builder->CreatePHI(ptrTy, 3, "src");
+    llvm::PHINode *dst = builder->CreatePHI(ptrTy, 3, "dst");
+    pass->addIncoming(llvm::ConstantInt::get(i32, 0), histBB);
+    src->addIncoming(data, histBB);
+    dst->addIncoming(temp, histBB);
+    builder->CreateCondBr(builder->CreateICmpULT(pass, llvm::ConstantInt::get(i32, 4)), passBodyBB, finishBB);
+
+    builder->SetInsertPoint(passBodyBB);
+    llvm::Value *shift = builder->CreateShl(pass, 3, "shift");
+    llvm::Value *hist = builder->CreateGEP(i64, counts, builder->CreateShl(builder->CreateZExt(pass, i64), 8), "hist");
+    llvm::Value *firstKey = builder->CreateXor(builder->CreateLoad(i32, src, "first"), mask);
+    llvm::Value *firstDigit = builder->CreateZExt(builder->CreateAnd(builder->CreateLShr(firstKey, shift), byteMask), i64);
+    llvm::Value *firstCount = builder->CreateLoad(i64, builder->CreateGEP(i64, hist, firstDigit), "first_count");
+    llvm::Value *nextPass = builder->CreateAdd(pass, llvm::ConstantInt::get(i32, 1), "next_pass");
+    builder->CreateCondBr(builder->CreateICmpEQ(firstCount, n), skipBB, prefixBB);
+
+    builder->SetInsertPoint(skipBB);
+    pass->addIncoming(nextPass, skipBB);
+    src->addIncoming(src, skipBB);
+    dst->addIncoming(dst, skipBB);
+    builder->CreateBr(passBB);
+
+    // 直方图改为每个桶的起始位置
+    builder->SetInsertPoint(prefixBB);
+    llvm::PHINode *bucket = builder->CreatePHI(i64, 2, "bucket");
+    llvm::PHINode *sum = builder->CreatePHI(i64, 2, "sum");
+    bucket->addIncoming(zero, passBodyBB);
+    sum->addIncoming(zero, passBodyBB);
+    llvm::Value *bucketPtr = builder->CreateGEP(i64, hist, bucket);
+    llvm::Value *bucketCount = builder->CreateLoad(i64, bucketPtr, "bucket_count");
+    builder->CreateStore(sum, bucketPtr);
+    llvm::Value *nextBucket = builder->CreateAdd(bucket, one);
+    bucket->addIncoming(nextBucket, prefixBB);
+    sum->addIncoming(builder->CreateAdd(sum, bucketCount), prefixBB);
+    builder->CreateCondBr(builder->CreateICmpULT(nextBucket, builder->getInt64(256)), prefixBB, scatterBB);
+
+    builder->SetInsertPoint(scatterBB);
+    llvm::PHINode *si = builder->CreatePHI(i64, 2, "i");
+    si->addIncoming(zero, prefixBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(si, n), scatterBodyBB, passDoneBB);
+
+    builder->SetInsertPoint(scatterBodyBB);
+    llvm::Value *x = builder->CreateLoad(i32, builder->CreateGEP(i32, src, si), "x");
+    llvm::Value *digit = builder->CreateZExt(builder->CreateAnd(builder->CreateLShr(builder->CreateXor(x, mask), shift), byteMask), i64);
+    llvm::Value *offsetPtr = builder->CreateGEP(i64, hist, digit);
+    llvm::Value *offset = builder->CreateLoad(i64, offsetPtr, "offset");
+    builder->CreateStore(x, builder->CreateGEP(i32, dst, offset));
+    builder->CreateStore(builder->CreateAdd(offset, one), offsetPtr);
+    si->addIncoming(builder->CreateAdd(si, one), scatterBodyBB);
+    builder->CreateBr(scatterBB);
+
+    builder->SetInsertPoint(passDoneBB);
+    pass->addIncoming(nextPass, passDoneBB);
+    src->addIncoming(dst, passDoneBB);
+    dst->addIncoming(src, passDoneBB);
+    builder->CreateBr(passBB);
+
+    builder->SetInsertPoint(finishBB);
+    builder->CreateCondBr(builder->CreateICmpNE(src, data), copyBB, freeBB);
+
+    builder->SetInsertPoint(copyBB);
+    builder->CreateCall(memcpyFunc, {data, src, builder->CreateMul(n, bytes)});
+    builder->CreateBr(freeBB);
+
+    builder->SetInsertPoint(freeBB);
+    builder->CreateCall(module->getFunction("free"), {temp});
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_sort_T(ptr data, i64 n) / __ppx_sort_desc_T：排序入口，深度上限为 2 * floor(log2(n))
+llvm::Function *CodeGenerator::getSortFunction(const std::string &elementType, bool descending) {
+    std::string name = "__ppx_sort_" + std::string(descending ? "desc_" : "") + sortSuffix(elementType);
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *introFunc = getIntroSortFunction(elementType, descending);
+    llvm::Function *radixFunc = elementType == "int" ? getRadixSortFunction() : nullptr;
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(builder->getVoidTy(), {ptrTy, i64}, false));
+    llvm::Value *data = function->getArg(0);
+    llvm::Value *n = function->getArg(1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *depthBB = llvm::BasicBlock::Create(*context, "depth", function);
+    llvm::BasicBlock *depthStepBB = llvm::BasicBlock::Create(*context, "depth_step", function);
+    llvm::BasicBlock *introBB = llvm::BasicBlock::Create(*context, "intro", function);
+
+    builder->SetInsertPoint(entryBB);
+    if (radixFunc) {
+        llvm::BasicBlock *radixBB = llvm::BasicBlock::Create(*context, "radix", function);
+        builder->CreateCondBr(builder->CreateICmpSGE(n, llvm::ConstantInt::get(i64, CodeGenConstants::RADIX_SORT_THRESHOLD)),
+                              radixBB, depthBB);
+        builder->SetInsertPoint(radixBB);
+        uint32_t mask = descending ? 0x7fffffffu : 0x80000000u;
+        builder->CreateCall(radixFunc, {data, n, llvm::ConstantInt::get(i32, mask)});
+        builder->CreateRetVoid();
+    } else {
+        builder->CreateBr(depthBB);
+    }
+
+    builder->SetInsertPoint(depthBB);
+    llvm::PHINode *rest = builder->CreatePHI(i64, 2, "rest");
+    llvm::PHINode *depth = builder->CreatePHI(i32, 2, "depth");
+    rest->addIncoming(n, entryBB);
+    depth->addIncoming(llvm::ConstantInt::get(i32, 0), entryBB);
+    builder->CreateCondBr(builder->CreateICmpSGT(rest, llvm::ConstantInt::get(i64, 1)), depthStepBB, introBB);
+
+    builder->SetInsertPoint(depthStepBB);
+    rest->addIncoming(builder->CreateLShr(rest, 1), depthStepBB);
+    depth->addIncoming(builder->CreateAdd(depth, llvm::ConstantInt::get(i32, 2)), depthStepBB);
+    builder->CreateBr(depthBB);
+
+    builder->SetInsertPoint(introBB);
+    builder->CreateCall(introFunc, {data, llvm::ConstantInt::get(i64, 0), n, depth});
+    builder->CreateRetVoid();
+    return function;
+}
+
+// i64 __ppx_binary_search_T(ptr data, i64 n, T value)：在升序数组中二分查找 value，返回第一个相等元素的下标，没有时返回 -1
+llvm::Function *CodeGenerator::getBinarySearchFunction(const std::string &elementType) {
+    std::string name = "__ppx_binary_search_" + sortSuffix(elementType);
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(i64, {ptrTy, i64, elementTy}, false));
+    llvm::Value *data = function->getArg(0);
+    llvm::Value *n = function->getArg(1);
+    llvm::Value *value = function->getArg(2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "body", function);
+    llvm::BasicBlock *checkBB = llvm::BasicBlock::Create(*context, "check", function);
+    llvm::BasicBlock *compareBB = llvm::BasicBlock::Create(*context, "compare", function);
+    llvm::BasicBlock *missingBB = llvm::BasicBlock::Create(*context, "missing", function);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+    llvm::Value *notFound = llvm::ConstantInt::get(i64, -1);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateBr(loopBB);
+
+    // 下界：第一个不小于 value 的位置
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *lo = builder->CreatePHI(i64, 2, "lo");
+    llvm::PHINode *hi = builder->CreatePHI(i64, 2, "hi");
+    lo->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    hi->addIncoming(n, entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(lo, hi), bodyBB, checkBB);
+
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *mid = builder->CreateAdd(lo, builder->CreateLShr(builder->CreateSub(hi, lo), 1), "mid");
+    llvm::Value *element = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, mid), "element");
+    llvm::Value *before = emitElementLess(elementType, element, value, false);
+    lo->addIncoming(builder->CreateSelect(before, builder->CreateAdd(mid, one), lo), bodyBB);
+    hi->addIncoming(builder->CreateSelect(before, hi, mid), bodyBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(checkBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(lo, n), compareBB, missingBB);
+
+    builder->SetInsertPoint(compareBB);
+    llvm::Value *found = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, lo), "found");
+    builder->CreateRet(builder->CreateSelect(emitElementEqual(elementType, found, value), lo, notFound));
+
+    builder->SetInsertPoint(missingBB);
+    builder->CreateRet(notFound);
+    return function;
+}
+
+// i64 __ppx_min_index_T(ptr data, i64 n) / __ppx_max_index_T：第一个最小（最大）元素的下标，空数组返回 -1
+llvm::Function *CodeGenerator::getExtremeIndexFunction(const std::string &elementType, bool isMax) {
+    std::string name = std::string(isMax ? "__ppx_max_index_" : "__ppx_min_index_") + sortSuffix(elementType);
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(i64, {ptrTy, i64}, false));
+    llvm::Value *data = function->getArg(0);
+    llvm::Value *n = function->getArg(1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *emptyBB = llvm::BasicBlock::Create(*context, "empty", function);
+    llvm::BasicBlock *initBB = llvm::BasicBlock::Create(*context, "init", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "body", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLE(n, llvm::ConstantInt::get(i64, 0)), emptyBB, initBB);
+
+    builder->SetInsertPoint(emptyBB);
+    builder->CreateRet(llvm::ConstantInt::get(i64, -1));
+
+    builder->SetInsertPoint(initBB);
+    llvm::Value *first = builder->CreateLoad(elementTy, data, "first");
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    llvm::PHINode *bestIndex = builder->CreatePHI(i64, 2, "best_index");
+    llvm::PHINode *best = builder->CreatePHI(elementTy, 2, "best");
+    i->addIncoming(one, initBB);
+    bestIndex->addIncoming(llvm::ConstantInt::get(i64, 0), initBB);
+    best->addIncoming(first, initBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(i, n), bodyBB, doneBB);
+
+    // 只有严格更小（更大）时才替换，相等时保留第一个
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *element = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, i), "element");
+    llvm::Value *better = isMax ? emitElementLess(elementType, best, element, false)
+                                : emitElementLess(elementType, element, best, false);
+    i->addIncoming(builder->CreateAdd(i, one), bodyBB);
+    bestIndex->addIncoming(builder->CreateSelect(better, i, bestIndex), bodyBB);
+    best->addIncoming(builder->CreateSelect(better, element, best), bodyBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(bestIndex);
+    return function;
+}
+
+// i64 __ppx_unique_T(ptr data, i64 n, i1 owned)：把相邻的重复元素只保留第一个，依次移到数组前部，返回保留的个数；
+// owned 为 true 时（动态数组中的字符串）释放被去掉的字符串
+llvm::Function *CodeGenerator::getUniqueFunction(const std::string &elementType) {
+    std::string name = "__ppx_unique_" + sortSuffix(elementType);
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(i64, {ptrTy, i64, builder->getInt1Ty()}, false));
+    llvm::Value *data = function->getArg(0);
+    llvm::Value *n = function->getArg(1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *emptyBB = llvm::BasicBlock::Create(*context, "empty", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "body", function);
+    llvm::BasicBlock *duplicateBB = llvm::BasicBlock::Create(*context, "duplicate", function);
+    llvm::BasicBlock *keepBB = llvm::BasicBlock::Create(*context, "keep", function);
+    llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*context, "next", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::Value *zero = llvm::ConstantInt::get(i64, 0);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLE(n, zero), emptyBB, loopBB);
+
+    builder->SetInsertPoint(emptyBB);
+    builder->CreateRet(zero);
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    llvm::PHINode *kept = builder->CreatePHI(i64, 2, "kept");
+    i->addIncoming(one, entryBB);
+    kept->addIncoming(one, entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(i, n), bodyBB, doneBB);
+
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *element = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, i), "element");
+    llvm::Value *previous = builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, builder->CreateSub(kept, one)), "previous");
+    builder->CreateCondBr(emitElementEqual(elementType, element, previous), duplicateBB, keepBB);
+
+    builder->SetInsertPoint(duplicateBB);
+    if (elementTy->isPointerTy()) {
+        llvm::BasicBlock *releaseBB = llvm::BasicBlock::Create(*context, "release", function);
+        builder->CreateCondBr(function->getArg(2), releaseBB, nextBB);
+        builder->SetInsertPoint(releaseBB);
+        builder->CreateCall(module->getFunction("free"), {element});
+    }
+    llvm::BasicBlock *droppedBB = builder->GetInsertBlock();
+    builder->CreateBr(nextBB);
+
+    builder->SetInsertPoint(keepBB);
+    builder->CreateStore(element, builder->CreateGEP(elementTy, data, kept));
+    llvm::Value *keptNext = builder->CreateAdd(kept, one);
+    builder->CreateBr(nextBB);
+
+    builder->SetInsertPoint(nextBB);
+    llvm::PHINode *keptAfter = builder->CreatePHI(i64, 3, "kept_after");
+    keptAfter->addIncoming(keptNext, keepBB);
+    keptAfter->addIncoming(kept, droppedBB);
+    if (droppedBB != duplicateBB) {
+        keptAfter->addIncoming(kept, duplicateBB);
+    }
+    i->addIncoming(builder->CreateAdd(i, one), nextBB);
+    kept->addIncoming(keptAfter, nextBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(kept);
+    return function;
+}
+
+// 数组内置函数
+//
+// sort(a)、sort_desc(a) 原地排序；binary_search(a, x) 在升序数组中查找 x，返回下标或 -1；min_index(a)、max_index(a)
+// 返回第一个最小（最大）元素的下标，空数组返回 -1；unique(a) 去掉相邻的重复元素，返回保留的个数（动态数组同时缩短）。
+// 参数可以是动态数组或一维定长数组（int、double、char、string），也可以写成 a.sort() 等方法调用。
+// 与用户定义的同名函数冲突时调用用户函数。
+
+bool CodeGenerator::isArrayBuiltin(const std::string &name) {
+    static const std::set<std::string> names = {
+        "sort", "sort_desc", "binary_search", "min_index", "max_index", "unique"};
+    return names.count(name) > 0;
+}
+
+bool CodeGenerator::arrayBuiltinCall(FunctionCallNode *node, ExprNode *&array, size_t &firstArg) {
+    if (!isArrayBuiltin(node->functionName) && !isVectorBuiltin(node->functionName)) {
+        return false;
+    }
+    if (node->object) {
+        // 对象不是变量时可能是模块函数调用
+        auto ident = dynamic_cast<IdentifierNode *>(node->object.get());
+        if (!isListType(declaredTypeOf(node->object.get())) &&
+            !(ident && (fn->namedValues.count(ident->name) || fn->constArrays.count(ident->name) ||
+                        globalValues.count(ident->name)))) {
+            return false;
+        }
+        array = node->object.get();
+        firstArg = 0;
+        return true;
+    }
+    if (functionPrototypes.count(node->functionName) || functions.count(node->functionName)) {
+        return false;
+    }
+    array = node->arguments.empty() ? nullptr : node->arguments[0].get();
+    firstArg = 1;
+    return true;
+}
+
+// sum、min、max、dot 返回数组的元素类型，其余返回 int
+std::string CodeGenerator::arrayBuiltinType(FunctionCallNode *node, ExprNode *array) {
+    const std::string &name = node->functionName;
+    if (!array || !(name == "sum" || name == "min" || name == "max" || name == "dot")) {
+        return "int";
+    }
+    std::string type = declaredTypeOf(array);
+    if (isListType(type)) {
+        return listElementType(type);
+    }
+    return type;
+}
+
+// 动态数组读取头部中的数据指针和长度；定长数组只接受数组变量本身（局部、局部常量或全局），取首元素地址和编译期长度
+bool CodeGenerator::codegenArrayOperand(ExprNode *node, ArrayOperand &operand) {
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    std::string type = declaredTypeOf(node);
+    if (isListType(type)) {
+        llvm::Value *list = codegenExpr(node);
+        if (!list) {
+            return false;
+        }
+        llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+        llvm::StructType *listTy = getListStructType();
+        operand.list = list;
+        operand.data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(listTy, list, LIST_DATA), "data");
+        operand.count = builder->CreateLoad(i64, builder->CreateStructGEP(listTy, list, LIST_SIZE), "size");
+        operand.elementType = listElementType(type);
+        return true;
+    }
+
+    auto ident = dynamic_cast<IdentifierNode *>(node);
+    if (!ident) {
+        return false;
+    }
+    llvm::Value *base = nullptr;
+    llvm::Type *arrayType = nullptr;
+    auto constIt = fn->constArrays.find(ident->name);
+    auto localIt = fn->namedValues.find(ident->name);
+    auto globalIt = globalValues.find(ident->name);
+    if (constIt != fn->constArrays.end()) {
+        base = constIt->second;
+        arrayType = constIt->second->getValueType();
+        operand.isConst = true;
+    } else if (localIt != fn->namedValues.end()) {
+        if (!localIt->second) {
+            return false;
+        }
+        base = localIt->second;
+        arrayType = localIt->second->getAllocatedType();
+        operand.isConst = fn->localConstVariables.count(ident->name) > 0;
+    } else if (globalIt != globalValues.end()) {
+        base = globalIt->second;
+        arrayType = globalIt->second->getValueType();
+        operand.isConst = globalIt->second->isConstant();
+    }
+    if (!base || !arrayType->isArrayTy()) {
+        return false;
+    }
+    // 多维数组和 bool 数组不支持
+    llvm::Type *elementTy = arrayType->getArrayElementType();
+    operand.elementType = elementTy->isArrayTy() ? "" : typeNameOf(elementTy);
+    fn->usedVariables.insert(ident->name);
+    operand.data = builder->CreateConstInBoundsGEP2_64(arrayType, base, 0, 0, "data");
+    operand.count = llvm::ConstantInt::get(i64, arrayType->getArrayNumElements());
+    return true;
+}
+
+llvm::Value *CodeGenerator::codegenArrayBuiltin(FunctionCallNode *node, ExprNode *array, size_t firstArg) {
+    const std::string &name = node->functionName;
+    if (g_verbose) {
+        std::cout << "[IR Gen] Array builtin: " << name << "()" << std::endl;
+    }
+    if (isVectorBuiltin(name)) {
+        return codegenVectorBuiltin(node, array, firstArg);
+    }
+    size_t expected = name == "binary_search" ? 1 : 0;
+    if (!array || node->arguments.size() - firstArg != expected) {
+        reportError(name + "() expects " + std::to_string(expected + 1) + " argument" + (expected ? "s (array, value)" : " (array)"),
+                    node->lineNumber);
+        return nullptr;
+    }
+    ArrayOperand operand;
+    if (!codegenArrayOperand(array, operand)) {
+        reportError(name + "() expects an array as its first argument", node->lineNumber);
+        return nullptr;
+    }
+    if (operand.elementType.empty()) {
+        reportError(name + "() does not support multi-dimensional arrays", node->lineNumber);
+        return nullptr;
+    }
+    if (!isSortableElementType(operand.elementType)) {
+        reportError(name + "() does not support arrays of type '" + operand.elementType + "'", node->lineNumber);
+        return nullptr;
+    }
+    bool modifies = name == "sort" || name == "sort_desc" || name == "unique";
+    if (modifies && operand.isConst) {
+        reportError(name + "() cannot modify a constant array", node->lineNumber);
+        return nullptr;
+    }
+
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    if (name == "sort" || name == "sort_desc") {
+        builder->CreateCall(getSortFunction(operand.elementType, name == "sort_desc"), {operand.data, operand.count});
+        return llvm::ConstantInt::get(i32, 0);
+    }
+
+    llvm::Value *index = nullptr;
+    if (name == "binary_search") {
+        llvm::Value *value = codegenExpr(node->arguments[firstArg].get());
+        if (!value) {
+            return nullptr;
+        }
+        llvm::Type *elementTy = getType(operand.elementType);
+        // int 值可以在 double 数组中查找，其余类型必须与元素类型一致
+        if (value->getType()->isIntegerTy(32) && elementTy->isDoubleTy()) {
+            value = builder->CreateSIToFP(value, elementTy);
+        }
+        if (value->getType() != elementTy || isReferenceType(declaredTypeOf(node->arguments[firstArg].get()))) {
+            reportError("binary_search() value of type '" + typeNameOf(value->getType()) +
+                        "' does not match array element type '" + operand.elementType + "'", node->lineNumber);
+            return nullptr;
+        }
+        index = builder->CreateCall(getBinarySearchFunction(operand.elementType), {operand.data, operand.count, value}, "index");
+    } else if (name == "min_index" || name == "max_index") {
+        index = builder->CreateCall(getExtremeIndexFunction(operand.elementType, name == "max_index"),
+                                    {operand.data, operand.count}, "index");
+    } else {
+        // 动态数组拥有其中的字符串，被去掉的字符串由 unique 释放
+        llvm::Value *owned = builder->getInt1(operand.list && operand.elementType == "string");
+        index = builder->CreateCall(getUniqueFunction(operand.elementType), {operand.data, operand.count, owned}, "kept");
+        if (operand.list) {
+            builder->CreateStore(index, builder->CreateStructGEP(getListStructType(), operand.list, LIST_SIZE));
+        }
+    }
+    return builder->CreateTrunc(index, i32, name);
+}
+
+// 数组运算运行时
+//
+// int 和 double 分别生成内核。主循环每次处理两个 VECTOR_BYTES 字节的向量（<8 x i32> 或 <4 x double>，
+// 使用两组独立的累加器隐藏加法延迟），剩余不足的元素逐个处理；没有 AVX2 的目标上，后端把每个向量拆成两个 SSE2 操作。
+// 归约的水平合并使用 llvm.vector.reduce.*。
+//
+// 浮点重结合策略：double 的 sum/dot 不允许编译器重排加法，结果只由数组内容决定（与编译方式、目标 CPU、
+// -interp/-tiered 无关）。长度超过 PAIRWISE_BLOCK 的数组对半拆分后分别求和再相加（成对求和），
+// 块内按 8 路交错累加后依次合并，舍入误差随长度按 O(log n) 增长，而逐个累加为 O(n)。
+// int 的加法和所有最值与顺序无关，结果与逐个计算完全相同（int 求和按 32 位回绕）。
+
+bool CodeGenerator::isVectorBuiltin(const std::string &name) {
+    static const std::set<std::string> names = {
+        "sum", "min", "max", "dot", "fill", "copy", "scale", "axpy"};
+    return names.count(name) > 0;
+}
+
+llvm::FixedVectorType *CodeGenerator::kernelVectorType(const std::string &elementType) {
+    llvm::Type *scalarTy = getType(elementType);
+    unsigned lanes = CodeGenConstants::VECTOR_BYTES / (scalarTy->getPrimitiveSizeInBits() / 8);
+    return llvm::FixedVectorType::get(scalarTy, lanes);
+}
+
+// 水平归约：double 求和按元素顺序依次相加（起始值 -0.0 不改变任何和）
+llvm::Value *CodeGenerator::emitVectorReduce(const std::string &kernel, llvm::Value *vector) {
+    bool isDouble = vector->getType()->getScalarType()->isDoubleTy();
+    if (kernel == "min") {
+        return isDouble ? builder->CreateFPMinReduce(vector) : builder->CreateIntMinReduce(vector, true);
+    }
+    if (kernel == "max") {
+        return isDouble ? builder->CreateFPMaxReduce(vector) : builder->CreateIntMaxReduce(vector, true);
+    }
+    if (isDouble) {
+        return builder->CreateFAddReduce(llvm::ConstantFP::getNegativeZero(builder->getDoubleTy()), vector);
+    }
+    return builder->CreateAddReduce(vector);
+}
+
+// 两个值按 kernel 合并（sum、dot 相加，min、max 取最值），向量逐元素合并
+static llvm::Value *combineValues(llvm::IRBuilder<> &builder, const std::string &kernel, llvm::Value *acc,
+                                  llvm::Value *value) {
+    bool isDouble = acc->getType()->getScalarType()->isDoubleTy();
+    if (kernel == "min" || kernel == "max") {
+        bool isMin = kernel == "min";
+        llvm::Value *better = isDouble ? (isMin ? builder.CreateFCmpOLT(value, acc) : builder.CreateFCmpOGT(value, acc))
+                                       : (isMin ? builder.CreateICmpSLT(value, acc) : builder.CreateICmpSGT(value, acc));
+        return builder.CreateSelect(better, value, acc, kernel);
+    }
+    return isDouble ? builder.CreateFAdd(acc, value, "acc") : builder.CreateAdd(acc, value, "acc");
+}
+
+// T __ppx_sum_T(ptr a, i64 n) / __ppx_dot_T(ptr a, ptr b, i64 n) / __ppx_min_T / __ppx_max_T
+// double 的 sum/dot 为 __ppx_sum_block_f64 / __ppx_dot_block_f64，只处理一个成对求和的分块；min/max 要求 n > 0
+llvm::Function *CodeGenerator::getReduceKernel(const std::string &kernel, const std::string &elementType) {
+    bool isDouble = elementType == "double";
+    bool block = isDouble && (kernel == "sum" || kernel == "dot");
+    std::string name = "__ppx_" + kernel + (block ? "_block" : "") + (isDouble ? "_f64" : "_i32");
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *scalarTy = getType(elementType);
+    llvm::FixedVectorType *vectorTy = kernelVectorType(elementType);
+    bool isDot = kernel == "dot";
+    std::vector<llvm::Type *> params = {ptrTy};
+    if (isDot) {
+        params.push_back(ptrTy);
+    }
+    params.push_back(i64);
+    llvm::Function *function = createRuntimeFunction(module.get(), name, llvm::FunctionType::get(scalarTy, params, false));
+    llvm::Value *a = function->getArg(0);
+    llvm::Value *b = isDot ? function->getArg(1) : nullptr;
+    llvm::Value *n = function->getArg(isDot ? 2 : 1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "body", function);
+    llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*context, "merge", function);
+    llvm::BasicBlock *tailBB = llvm::BasicBlock::Create(*context, "tail", function);
+    llvm::BasicBlock *tailBodyBB = llvm::BasicBlock::Create(*context, "tail_body", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    unsigned lanes = vectorTy->getNumElements();
+    llvm::Align align(scalarTy->getPrimitiveSizeInBits() / 8);
+    llvm::Value *step = llvm::ConstantInt::get(i64, 2 * lanes);
+    llvm::Value *one = llvm::ConstantInt::get(i64, 1);
+
+    // 第 i 个元素（点积为两个数组对应元素的乘积），向量版本读取从 i 开始的 lanes 个元素
+    auto element = [&](llvm::Type *type, llvm::Value *index) -> llvm::Value * {
+        llvm::Value *x = builder->CreateAlignedLoad(type, builder->CreateGEP(scalarTy, a, index), align, "x");
+        if (!isDot) {
+            return x;
+        }
+        llvm::Value *y = builder->CreateAlignedLoad(type, builder->CreateGEP(scalarTy, b, index), align, "y");
+        return isDouble ? builder->CreateFMul(x, y, "product") : builder->CreateMul(x, y, "product");
+    };
+
+    // 求和的累加器从 +0.0 开始（空数组的和为 0 而不是 -0），最值从第一个元素开始
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *init;
+    if (kernel == "min" || kernel == "max") {
+        init = builder->CreateVectorSplat(lanes, builder->CreateAlignedLoad(scalarTy, a, align, "first"), "init");
+    } else {
+        init = llvm::ConstantVector::getSplat(vectorTy->getElementCount(),
+                                              isDouble ? llvm::ConstantFP::get(scalarTy, 0.0)
+                                                       : llvm::ConstantInt::get(scalarTy, 0));
+    }
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    llvm::PHINode *acc0 = builder->CreatePHI(vectorTy, 2, "acc0");
+    llvm::PHINode *acc1 = builder->CreatePHI(vectorTy, 2, "acc1");
+    i->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    acc0->addIncoming(init, entryBB);
+    acc1->addIncoming(init, entryBB);
+    llvm::Value *next = builder->CreateAdd(i, step, "next");
+    builder->CreateCondBr(builder->CreateICmpSLE(next, n), bodyBB, mergeBB);
+
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *v0 = element(vectorTy, i);
+    llvm::Value *v1 = element(vectorTy, builder->CreateAdd(i, llvm::ConstantInt::get(i64, lanes)));
+    i->addIncoming(next, bodyBB);
+    acc0->addIncoming(combineValues(*builder, kernel, acc0, v0), bodyBB);
+    acc1->addIncoming(combineValues(*builder, kernel, acc1, v1), bodyBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(mergeBB);
+    llvm::Value *reduced = emitVectorReduce(kernel, combineValues(*builder, kernel, acc0, acc1));
+    builder->CreateBr(tailBB);
+
+    builder->SetInsertPoint(tailBB);
+    llvm::PHINode *j = builder->CreatePHI(i64, 2, "j");
+    llvm::PHINode *result = builder->CreatePHI(scalarTy, 2, "result");
+    j->addIncoming(i, mergeBB);
+    result->addIncoming(reduced, mergeBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(j, n), tailBodyBB, doneBB);
+
+    builder->SetInsertPoint(tailBodyBB);
+    j->addIncoming(builder->CreateAdd(j, one), tailBodyBB);
+    result->addIncoming(combineValues(*builder, kernel, result, element(scalarTy, j)), tailBodyBB);
+    builder->CreateBr(tailBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(result);
+    return function;
+}
+
+// double __ppx_sum_f64(ptr a, i64 n) / __ppx_dot_f64(ptr a, ptr b, i64 n)：成对求和，
+// 超过 PAIRWISE_BLOCK 个元素时在中点（向下取到主循环步长的整数倍）拆成两半分别求和
+llvm::Function *CodeGenerator::getPairwiseKernel(const std::string &kernel) {
+    std::string name = "__ppx_" + kernel + "_f64";
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *doubleTy = builder->getDoubleTy();
+    llvm::Function *blockFunc = getReduceKernel(kernel, "double");
+    bool isDot = kernel == "dot";
+    std::vector<llvm::Type *> params = {ptrTy};
+    if (isDot) {
+        params.push_back(ptrTy);
+    }
+    params.push_back(i64);
+    llvm::Function *function = createRuntimeFunction(module.get(), name, llvm::FunctionType::get(doubleTy, params, false));
+    llvm::Value *n = function->getArg(isDot ? 2 : 1);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *leafBB = llvm::BasicBlock::Create(*context, "leaf", function);
+    llvm::BasicBlock *splitBB = llvm::BasicBlock::Create(*context, "split", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLE(n, llvm::ConstantInt::get(i64, CodeGenConstants::PAIRWISE_BLOCK)),
+                          leafBB, splitBB);
+
+    std::vector<llvm::Value *> args;
+    for (auto &arg : function->args()) {
+        args.push_back(&arg);
+    }
+    builder->SetInsertPoint(leafBB);
+    builder->CreateRet(builder->CreateCall(blockFunc, args, "block"));
+
+    builder->SetInsertPoint(splitBB);
+    int64_t step = 2 * kernelVectorType("double")->getNumElements();
+    llvm::Value *half = builder->CreateAnd(builder->CreateLShr(n, 1), llvm::ConstantInt::get(i64, -step), "half");
+    std::vector<llvm::Value *> leftArgs, rightArgs;
+    for (unsigned k = 0; k + 1 < args.size(); k++) {
+        leftArgs.push_back(args[k]);
+        rightArgs.push_back(builder->CreateGEP(doubleTy, args[k], half));
+    }
+    leftArgs.push_back(half);
+    rightArgs.push_back(builder->CreateSub(n, half));
+    llvm::Value *left = builder->CreateCall(function, leftArgs, "left");
+    llvm::Value *right = builder->CreateCall(function, rightArgs, "right");
+    builder->CreateRet(builder->CreateFAdd(left, right, "sum"));
+    return function;
+}
+
+// void __ppx_fill_T(ptr a, i64 n, T value) / __ppx_scale_T(ptr a, i64 n, T factor) /
+// __ppx_axpy_T(ptr y, ptr x, i64 n, T alpha)：逐元素写回 a（y += alpha * x），double 不合并为 FMA
+llvm::Function *CodeGenerator::getMapKernel(const std::string &kernel, const std::string &elementType) {
+    bool isDouble = elementType == "double";
+    std::string name = "__ppx_" + kernel + (isDouble ? "_f64" : "_i32");
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *scalarTy = getType(elementType);
+    llvm::FixedVectorType *vectorTy = kernelVectorType(elementType);
+    bool isAxpy = kernel == "axpy";
+    std::vector<llvm::Type *> params = {ptrTy};
+    if (isAxpy) {
+        params.push_back(ptrTy);
+    }
+    params.push_back(i64);
+    params.push_back(scalarTy);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), name, llvm::FunctionType::get(builder->getVoidTy(), params, false));
+    llvm::Value *data = function->getArg(0);
+    llvm::Value *source = isAxpy ? function->getArg(1) : nullptr;
+    llvm::Value *n = function->getArg(isAxpy ? 2 : 1);
+    llvm::Value *operand = function->getArg(isAxpy ? 3 : 2);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*context, "loop", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "body", function);
+    llvm::BasicBlock *tailBB = llvm::BasicBlock::Create(*context, "tail", function);
+    llvm::BasicBlock *tailBodyBB = llvm::BasicBlock::Create(*context, "tail_body", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    unsigned lanes = vectorTy->getNumElements();
+    llvm::Align align(scalarTy->getPrimitiveSizeInBits() / 8);
+
+    // 计算第 index 个元素（向量版本为从 index 开始的 lanes 个元素）的新值并写回
+    auto update = [&](llvm::Type *type, llvm::Value *operandValue, llvm::Value *index) {
+        llvm::Value *ptr = builder->CreateGEP(scalarTy, data, index);
+        llvm::Value *value = operandValue;
+        if (kernel == "scale") {
+            llvm::Value *old = builder->CreateAlignedLoad(type, ptr, align, "old");
+            value = isDouble ? builder->CreateFMul(old, operandValue) : builder->CreateMul(old, operandValue);
+        } else if (isAxpy) {
+            llvm::Value *old = builder->CreateAlignedLoad(type, ptr, align, "old");
+            llvm::Value *x = builder->CreateAlignedLoad(type, builder->CreateGEP(scalarTy, source, index), align, "x");
+            value = isDouble ? builder->CreateFAdd(old, builder->CreateFMul(operandValue, x))
+                             : builder->CreateAdd(old, builder->CreateMul(operandValue, x));
+        }
+        builder->CreateAlignedStore(value, ptr, align);
+    };
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *splat = builder->CreateVectorSplat(lanes, operand, "splat");
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(loopBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    i->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    llvm::Value *next = builder->CreateAdd(i, llvm::ConstantInt::get(i64, lanes), "next");
+    builder->CreateCondBr(builder->CreateICmpSLE(next, n), bodyBB, tailBB);
+
+    builder->SetInsertPoint(bodyBB);
+    update(vectorTy, splat, i);
+    i->addIncoming(next, bodyBB);
+    builder->CreateBr(loopBB);
+
+    builder->SetInsertPoint(tailBB);
+    llvm::PHINode *j = builder->CreatePHI(i64, 2, "j");
+    j->addIncoming(i, loopBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(j, n), tailBodyBB, doneBB);
+
+    builder->SetInsertPoint(tailBodyBB);
+    update(scalarTy, operand, j);
+    j->addIncoming(builder->CreateAdd(j, llvm::ConstantInt::get(i64, 1)), tailBodyBB);
+    builder->CreateBr(tailBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// 两个数组的长度不同时抛出 "<name>() arrays have different lengths (m and n)"
+bool CodeGenerator::emitLengthCheck(const std::string &name, llvm::Value *a, llvm::Value *b, int lineNumber) {
+    auto constA = llvm::dyn_cast<llvm::ConstantInt>(a);
+    auto constB = llvm::dyn_cast<llvm::ConstantInt>(b);
+    if (constA && constB) {
+        if (constA->getSExtValue() != constB->getSExtValue()) {
+            reportError(name + "() arrays have different lengths (" + std::to_string(constA->getSExtValue()) + " and " +
+                        std::to_string(constB->getSExtValue()) + ")", lineNumber);
+            return false;
+        }
+        return true;
+    }
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "length_mismatch", function);
+    llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "length_ok", function);
+    builder->CreateCondBr(builder->CreateICmpNE(a, b), failBB, okBB);
+
+    builder->SetInsertPoint(failBB);
+    llvm::FunctionCallee snprintfFunc =
+        module->getOrInsertFunction("snprintf", llvm::FunctionType::get(i32, {ptrTy, i64, ptrTy}, true));
+    llvm::Type *messageTy = llvm::ArrayType::get(builder->getInt8Ty(), CodeGenConstants::EXCEPTION_MSG_BUFFER_SIZE);
+    llvm::AllocaInst *message = createEntryBlockAlloca(function, "length_error_msg", messageTy);
+    std::string format = name + "() arrays have different lengths (%lld and %lld)";
+    builder->CreateCall(snprintfFunc, {message, llvm::ConstantInt::get(i64, CodeGenConstants::EXCEPTION_MSG_BUFFER_SIZE),
+                                       builder->CreateGlobalString(format, "", 0, module.get()), a, b});
+    emitThrow(message, false);
+
+    builder->SetInsertPoint(okBB);
+    return true;
+}
+
+// sum(a)、min(a)、max(a)、dot(a, b)、fill(a, v)、copy(dst, src)、scale(a, k)、axpy(y, alpha, x)，
+// 也可以写作 a.sum()、y.axpy(alpha, x) 等；参数可以是动态数组或一维定长数组
+llvm::Value *CodeGenerator::codegenVectorBuiltin(FunctionCallNode *node, ExprNode *array, size_t firstArg) {
+    const std::string &name = node->functionName;
+    static const std::map<std::string, std::string> signatures = {
+        {"sum", "(array)"}, {"min", "(array)"}, {"max", "(array)"}, {"dot", "(array, array)"},
+        {"fill", "(array, value)"}, {"copy", "(destination, source)"}, {"scale", "(array, factor)"},
+        {"axpy", "(array, factor, array)"}};
+    const std::string &signature = signatures.at(name);
+    size_t expected = std::count(signature.begin(), signature.end(), ',') + 1;
+    if (!array || node->arguments.size() - firstArg + 1 != expected) {
+        reportError(name + "() expects " + std::to_string(expected) + (expected == 1 ? " argument " : " arguments ") +
+                    signature, node->lineNumber);
+        return nullptr;
+    }
+    ArrayOperand operand;
+    if (!codegenArrayOperand(array, operand)) {
+        reportError(name + "() expects an array as its first argument", node->lineNumber);
+        return nullptr;
+    }
+    if (operand.elementType != "int" && operand.elementType != "double") {
+        reportError(name + "() expects an int or double array", node->lineNumber);
+        return nullptr;
+    }
+    bool modifies = name == "fill" || name == "copy" || name == "scale" || name == "axpy";
+    if (modifies && operand.isConst) {
+        reportError(name + "() cannot modify a constant array", node->lineNumber);
+        return nullptr;
+    }
+
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *scalarTy = getType(operand.elementType);
+    bool isDouble = operand.elementType == "double";
+
+    // 第二个数组参数（dot、copy 为第 2 个参数，axpy 为第 3 个），元素类型必须相同
+    ArrayOperand other;
+    if (name == "dot" || name == "copy" || name == "axpy") {
+        ExprNode *otherExpr = node->arguments[firstArg + (name == "axpy" ? 1 : 0)].get();
+        if (!codegenArrayOperand(otherExpr, other)) {
+            reportError(name + "() expects an array as its " + (name == "axpy" ? "third" : "second") + " argument",
+                        node->lineNumber);
+            return nullptr;
+        }
+        if (other.elementType != operand.elementType) {
+            reportError(name + "() expects arrays of the same element type ('" + operand.elementType + "' and '" +
+                        (other.elementType.empty() ? "multi-dimensional array" : other.elementType) + "')",
+                        node->lineNumber);
+            return nullptr;
+        }
+    }
+
+    // fill、scale、axpy 的标量参数：int 值可以用于 double 数组
+    llvm::Value *scalar = nullptr;
+    if (name == "fill" || name == "scale" || name == "axpy") {
+        ExprNode *scalarExpr = node->arguments[firstArg].get();
+        scalar = codegenExpr(scalarExpr);
+        if (!scalar) {
+            return nullptr;
+        }
+        if (scalar->getType()->isIntegerTy(32) && isDouble) {
+            scalar = builder->CreateSIToFP(scalar, scalarTy);
+        }
+        if (scalar->getType() != scalarTy || isReferenceType(declaredTypeOf(scalarExpr))) {
+            reportError(name + "() value of type '" + typeNameOf(scalar->getType()) +
+                        "' does not match array element type '" + operand.elementType + "'", node->lineNumber);
+            return nullptr;
+        }
+    }
+
+    if (name == "fill" || name == "scale") {
+        builder->CreateCall(getMapKernel(name, operand.elementType), {operand.data, operand.count, scalar});
+        return llvm::ConstantInt::get(i32, 0);
+    }
+    if (name == "axpy") {
+        if (!emitLengthCheck(name, operand.count, other.count, node->lineNumber)) {
+            return nullptr;
+        }
+        builder->CreateCall(getMapKernel(name, operand.elementType), {operand.data, other.data, operand.count, scalar});
+        return llvm::ConstantInt::get(i32, 0);
+    }
+    if (name == "copy") {
+        // 复制两者中较短的长度，源和目标可以重叠
+        llvm::Value *count = builder->CreateSelect(builder->CreateICmpSLT(other.count, operand.count), other.count,
+                                                   operand.count, "count");
+        llvm::Align align(scalarTy->getPrimitiveSizeInBits() / 8);
+        llvm::Value *bytes = builder->CreateMul(count, builder->getInt64(scalarTy->getPrimitiveSizeInBits() / 8));
+        builder->CreateMemMove(operand.data, align, other.data, align, bytes);
+        return builder->CreateTrunc(count, i32, "copied");
+    }
+    if (name == "dot") {
+        if (!emitLengthCheck(name, operand.count, other.count, node->lineNumber)) {
+            return nullptr;
+        }
+        llvm::Function *kernel = isDouble ? getPairwiseKernel(name) : getReduceKernel(name, operand.elementType);
+        return builder->CreateCall(kernel, {operand.data, other.data, operand.count}, "dot");
+    }
+
+    // sum、min、max：长度为常量且不超过 INLINE_REDUCE_LIMIT 的定长数组整体读成一个向量直接归约
+    // （double 求和按成对求和的顺序调用内核，保证与其他长度的结果一致）
+    auto constCount = llvm::dyn_cast<llvm::ConstantInt>(operand.count);
+    bool orderFree = !(isDouble && name == "sum");
+    if (constCount && orderFree && constCount->getZExtValue() <= CodeGenConstants::INLINE_REDUCE_LIMIT) {
+        auto vectorTy = llvm::FixedVectorType::get(scalarTy, constCount->getZExtValue());
+        llvm::Align align(scalarTy->getPrimitiveSizeInBits() / 8);
+        llvm::Value *vector = builder->CreateAlignedLoad(vectorTy, operand.data, align, "elements");
+        return emitVectorReduce(name, vector);
+    }
+    if (name == "sum") {
+        llvm::Function *kernel = isDouble ? getPairwiseKernel(name) : getReduceKernel(name, operand.elementType);
+        return builder->CreateCall(kernel, {operand.data, operand.count}, "sum");
+    }
+    if (!constCount) {
+        llvm::Function *function = builder->GetInsertBlock()->getParent();
+        llvm::BasicBlock *emptyBB = llvm::BasicBlock::Create(*context, "empty_array", function);
+        llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "nonempty_array", function);
+        builder->CreateCondBr(builder->CreateICmpEQ(operand.count, builder->getInt64(0)), emptyBB, okBB);
+        builder->SetInsertPoint(emptyBB);
+        emitThrow(builder->CreateGlobalString(name + "() of an empty array", "", 0, module.get()), false);
+        builder->SetInsertPoint(okBB);
+    }
+    return builder->CreateCall(getReduceKernel(name, operand.elementType), {operand.data, operand.count}, name);
+}
+
+// for x in a：按下标顺序遍历元素（每次迭代重新读取 size，循环中 push/pop 会影响遍历范围）
+void CodeGenerator::codegenListForStmt(ForStmtNode *node, const std::string &listType) {
+    if (g_verbose) {
+        std::cout << "[IR Gen] For loop: " << node->variable << " in " << listType << std::endl;
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    std::string elementType = listElementType(listType);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *listTy = getListStructType();
+
+    // 检查循环变量名是否与已存在的局部变量冲突（警告而非错误）
+    if (currentDiagnostics().enableShadowWarnings && fn->namedValues.find(node->variable) != fn->namedValues.end()) {
+        reportWarning("For loop variable '" + node->variable + "' shadows an existing local variable", node->lineNumber);
+    }
+
+    llvm::Value *list = codegenExpr(node->iterable.get());
+    if (!list) {
+        return;
+    }
+    // 循环持有数组的一个引用：循环体中的语句会释放临时值，也可能给被遍历的变量赋值
+    llvm::AllocaInst *listVar = createEntryBlockAlloca(function, node->variable + "_list", ptrTy);
+    trackReferenceSlot(listVar, listType);
+    storeReference(listVar, list, listType);
+    clearTempMemory();
+
+    llvm::AllocaInst *loopVar = createEntryBlockAlloca(function, node->variable, elementTy);
+    llvm::AllocaInst *indexVar = createEntryBlockAlloca(function, node->variable + "_index", i64);
+    builder->CreateStore(llvm::ConstantInt::get(i64, 0), indexVar);
+    fn->namedValues[node->variable] = loopVar;
+    fn->variableTypes[node->variable] = elementType;
+
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "forlist_cond", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "forlist_body");
+    llvm::BasicBlock *incrBB = llvm::BasicBlock::Create(*context, "forlist_incr");
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(*context, "after_forlist");
+
+    LoopContext loopCtx;
+    loopCtx.continueBlock = incrBB;
+    loopCtx.breakBlock = afterBB;
+    fn->loopContextStack.push_back(loopCtx);
+
+    builder->CreateBr(condBB);
+    builder->SetInsertPoint(condBB);
+    llvm::Value *index = builder->CreateLoad(i64, indexVar, "index");
+    llvm::Value *size = builder->CreateLoad(i64, builder->CreateStructGEP(listTy, list, LIST_SIZE), "size");
+    builder->CreateCondBr(builder->CreateICmpULT(index, size), bodyBB, afterBB);
+
+    function->insert(function->end(), bodyBB);
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *data = builder->CreateLoad(ptrTy, builder->CreateStructGEP(listTy, list, LIST_DATA), "data");
+    builder->CreateStore(builder->CreateLoad(elementTy, builder->CreateGEP(elementTy, data, index), "element"), loopVar);
+    codegenStmt(node->body.get());
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(incrBB);
+    }
+
+    function->insert(function->end(), incrBB);
+    builder->SetInsertPoint(incrBB);
+    clearTempMemory();
+    llvm::Value *current = builder->CreateLoad(i64, indexVar, "index");
+    builder->CreateStore(builder->CreateAdd(current, llvm::ConstantInt::get(i64, 1), "next_index"), indexVar);
+    builder->CreateBr(condBB);
+
+    function->insert(function->end(), afterBB);
+    builder->SetInsertPoint(afterBB);
+    attachLoopHints(node->annotations, node->lineNumber, condBB);
+    fn->loopContextStack.pop_back();
+
+    // 循环变量的作用域仅限于循环内
+    fn->namedValues.erase(node->variable);
+    fn->variableTypes.erase(node->variable);
+}
+
+// 线程和通道
+//
+// spawn f(args) 在新的 POSIX 线程中调用用户函数 f，值为 future<T>（T 为 f 的返回类型，没有返回值时为 void），
+// 指向 malloc 的任务结构体 { 线程, 引用计数, 状态, 结果, 参数... }。线程入口 __ppx_task_f 从任务结构体中取出参数
+// 调用 f 并写回结果；join(h) 把状态从 joinable 改为 joined，等待线程结束后取出结果。复制的 future 指向同一个任务，
+// 第二次 join 抛出运行时错误。future 与动态数组一样按引用计数管理，线程结束前另持有一个引用，
+// 最后一个引用释放时释放任务结构体（没有 join 过时同时分离线程、释放结果）。
+// spawn 作为表达式语句时线程被分离，只有线程持有引用。字符串参数复制一份交给线程
+// （调用方的临时字符串在语句结束时释放），f 返回后释放；定长数组参数指向调用方的栈帧，不能传给线程。
+//
+// 通道 chan<T> 是有界的多生产者多消费者无锁环形队列：
+// - 头部 { cells, mask, closed, refs, 填充, enqueuePos, 填充, dequeuePos, 填充 }，入队位置和出队位置各占一个缓存行，
+//   生产者和消费者更新各自的位置时不会互相使对方的缓存行失效；容量向上取整为 2 的幂，位置 & mask 为槽下标
+// - 每个槽为 { seq, value }：seq 等于位置时可以写入，等于位置 + 1 时可以读出。发送方读到可写的槽后用 cmpxchg
+//   把 enqueuePos 推进一格占有该槽，写入 value 后以 release 顺序把 seq 设为位置 + 1；接收方对称地推进 dequeuePos，
+//   读出后把 seq 设为位置 + 槽数量（下一轮的写入位置）。读 seq 使用 acquire 顺序，value 的读写不需要原子操作
+// - 队列满（空）时先自旋重试，之后 sched_yield，长时间等待时 usleep（__ppx_chan_backoff）
+// - 元素以 i64 保存（int 符号扩展，double 按位转换，字符串和引用类型为指针）；发送字符串时复制一份，
+//   接收方得到副本的所有权
+// - close(c) 之后 send 抛出异常；recv 取完剩余元素后抛出异常，for x in c 取完剩余元素后结束循环。
+//   关闭前应先等待所有发送方完成（关闭时正在写入的元素可能不会被接收）
+// - 通道与映射、动态数组一样按引用计数管理（引用计数在第一个缓存行，只在复制和释放引用时更新）；
+//   最后一个引用释放时释放槽数组和头部，队列中没有被接收的字符串一并释放
+
+bool CodeGenerator::isChanType(const std::string &typeName) {
+    return typeName.rfind("chan<", 0) == 0;
+}
+
+bool CodeGenerator::isFutureType(const std::string &typeName) {
+    return typeName.rfind("future<", 0) == 0;
+}
+
+std::string CodeGenerator::chanElementType(const std::string &chanType) {
+    return chanType.substr(5, chanType.size() - 6);
+}
+
+std::string CodeGenerator::futureValueType(const std::string &futureType) {
+    return futureType.substr(7, futureType.size() - 8);
+}
+
+// 头部 192 字节：第一个缓存行为 cells、mask、closed、refs，入队位置和出队位置各占后面的一个缓存行
+llvm::StructType *CodeGenerator::getChannelStructType() {
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    uint64_t lineWords = CodeGenConstants::CACHE_LINE_BYTES / 8;
+    return llvm::StructType::get(*context, {ptrTy, i64, i64, i64, llvm::ArrayType::get(i64, lineWords - 4),
+                                            i64, llvm::ArrayType::get(i64, lineWords - 1),
+                                            i64, llvm::ArrayType::get(i64, lineWords - 1)});
+}
+
+// ptr __ppx_chan_new(i64 capacity)：容量向上取整为 2 的幂（至少 CHANNEL_MIN_CAPACITY），引用计数为 1，分配失败时返回 null
+llvm::Function *CodeGenerator::getChannelNewFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_chan_new")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *chanTy = getChannelStructType();
+    llvm::StructType *cellTy = llvm::StructType::get(*context, {i64, i64});
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_chan_new", llvm::FunctionType::get(ptrTy, {i64}, false));
+    llvm::Value *requested = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *sizeBB = llvm::BasicBlock::Create(*context, "size", function);
+    llvm::BasicBlock *doubleBB = llvm::BasicBlock::Create(*context, "double", function);
+    llvm::BasicBlock *allocBB = llvm::BasicBlock::Create(*context, "alloc_cells", function);
+    llvm::BasicBlock *initBB = llvm::BasicBlock::Create(*context, "init", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "fail", function);
+    llvm::FunctionCallee allocFunc = module->getOrInsertFunction("aligned_alloc", ptrTy, i64, i64);
+    llvm::Value *lineBytes = llvm::ConstantInt::get(i64, CodeGenConstants::CACHE_LINE_BYTES);
+
+    builder->SetInsertPoint(entryBB);
+    uint64_t headerSize = module->getDataLayout().getTypeAllocSize(chanTy);
+    llvm::Value *chan = builder->CreateCall(allocFunc, {lineBytes, llvm::ConstantInt::get(i64, headerSize)}, "chan");
+    builder->CreateCondBr(builder->CreateIsNull(chan), failBB, sizeBB);
+
+    builder->SetInsertPoint(sizeBB);
+    llvm::PHINode *capacity = builder->CreatePHI(i64, 2, "capacity");
+    capacity->addIncoming(llvm::ConstantInt::get(i64, CodeGenConstants::CHANNEL_MIN_CAPACITY), entryBB);
+    builder->CreateCondBr(builder->CreateICmpULT(capacity, requested), doubleBB, allocBB);
+
+    builder->SetInsertPoint(doubleBB);
+    capacity->addIncoming(builder->CreateShl(capacity, 1, "doubled"), doubleBB);
+    builder->CreateBr(sizeBB);
+
+    builder->SetInsertPoint(allocBB);
+    uint64_t cellSize = module->getDataLayout().getTypeAllocSize(cellTy);
+    llvm::Value *cells = builder->CreateCall(
+        allocFunc, {lineBytes, builder->CreateMul(capacity, llvm::ConstantInt::get(i64, cellSize))}, "cells");
+    builder->CreateMemSet(chan, builder->getInt8(0), headerSize, llvm::MaybeAlign(CodeGenConstants::CACHE_LINE_BYTES));
+    builder->CreateStore(cells, builder->CreateStructGEP(chanTy, chan, CHAN_CELLS));
+    builder->CreateStore(builder->CreateSub(capacity, llvm::ConstantInt::get(i64, 1)),
+                         builder->CreateStructGEP(chanTy, chan, CHAN_MASK));
+    builder->CreateStore(llvm::ConstantInt::get(i64, 1), builder->CreateStructGEP(chanTy, chan, CHAN_REFS));
+    builder->CreateCondBr(builder->CreateIsNull(cells), failBB, initBB);
+
+    // 槽 i 的序号初始为 i（第一轮的写入位置）
+    builder->SetInsertPoint(initBB);
+    llvm::PHINode *i = builder->CreatePHI(i64, 2, "i");
+    i->addIncoming(llvm::ConstantInt::get(i64, 0), allocBB);
+    llvm::Value *cell = builder->CreateGEP(cellTy, cells, i, "cell");
+    builder->CreateStore(i, builder->CreateStructGEP(cellTy, cell, CELL_SEQ));
+    llvm::Value *next = builder->CreateAdd(i, llvm::ConstantInt::get(i64, 1), "next");
+    i->addIncoming(next, initBB);
+    builder->CreateCondBr(builder->CreateICmpULT(next, capacity), initBB, doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRet(chan);
+
+    builder->SetInsertPoint(failBB);
+    builder->CreateRet(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptrTy)));
+    return function;
+}
+
+// void __ppx_chan_backoff(i64 attempt)：第 attempt 次重试前等待
+llvm::Function *CodeGenerator::getChannelBackoffFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_chan_backoff")) {
+        return existing;
+    }
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_chan_backoff", llvm::FunctionType::get(builder->getVoidTy(), {i64}, false));
+    llvm::Value *attempt = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *waitBB = llvm::BasicBlock::Create(*context, "wait", function);
+    llvm::BasicBlock *yieldBB = llvm::BasicBlock::Create(*context, "yield", function);
+    llvm::BasicBlock *sleepBB = llvm::BasicBlock::Create(*context, "sleep", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(attempt, llvm::ConstantInt::get(i64, CodeGenConstants::CHANNEL_SPIN_LIMIT)),
+                          doneBB, waitBB);
+
+    builder->SetInsertPoint(waitBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(attempt, llvm::ConstantInt::get(i64, CodeGenConstants::CHANNEL_YIELD_LIMIT)),
+                          yieldBB, sleepBB);
+
+    builder->SetInsertPoint(yieldBB);
+    builder->CreateCall(module->getOrInsertFunction("sched_yield", i32));
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(sleepBB);
+    builder->CreateCall(module->getOrInsertFunction("usleep", i32, i32),
+                        {llvm::ConstantInt::get(i32, CodeGenConstants::CHANNEL_SLEEP_US)});
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// i1 __ppx_chan_send(ptr chan, i64 value)：通道已关闭时返回 false，队列满时等待
+llvm::Function *CodeGenerator::getChannelSendFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_chan_send")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *chanTy = getChannelStructType();
+    llvm::StructType *cellTy = llvm::StructType::get(*context, {i64, i64});
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_chan_send", llvm::FunctionType::get(builder->getInt1Ty(), {ptrTy, i64}, false));
+    llvm::Value *chan = function->getArg(0);
+    llvm::Value *value = function->getArg(1);
+    auto acquire = llvm::AtomicOrdering::Acquire;
+    auto monotonic = llvm::AtomicOrdering::Monotonic;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *startBB = llvm::BasicBlock::Create(*context, "start", function);
+    llvm::BasicBlock *probeBB = llvm::BasicBlock::Create(*context, "probe", function);
+    llvm::BasicBlock *claimBB = llvm::BasicBlock::Create(*context, "claim", function);
+    llvm::BasicBlock *busyBB = llvm::BasicBlock::Create(*context, "busy", function);
+    llvm::BasicBlock *fullBB = llvm::BasicBlock::Create(*context, "full", function);
+    llvm::BasicBlock *waitBB = llvm::BasicBlock::Create(*context, "wait", function);
+    llvm::BasicBlock *retryBB = llvm::BasicBlock::Create(*context, "retry", function);
+    llvm::BasicBlock *writeBB = llvm::BasicBlock::Create(*context, "write", function);
+    llvm::BasicBlock *closedBB = llvm::BasicBlock::Create(*context, "closed", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *closedPtr = builder->CreateStructGEP(chanTy, chan, CHAN_CLOSED);
+    llvm::Value *posPtr = builder->CreateStructGEP(chanTy, chan, CHAN_ENQUEUE_POS);
+    llvm::Value *cells = builder->CreateLoad(ptrTy, builder->CreateStructGEP(chanTy, chan, CHAN_CELLS), "cells");
+    llvm::Value *mask = builder->CreateLoad(i64, builder->CreateStructGEP(chanTy, chan, CHAN_MASK), "mask");
+    llvm::Value *wasClosed = createAtomicLoad(*builder, closedPtr, acquire, "was_closed");
+    builder->CreateCondBr(builder->CreateICmpNE(wasClosed, llvm::ConstantInt::get(i64, 0)), closedBB, startBB);
+
+    builder->SetInsertPoint(startBB);
+    llvm::Value *startPos = createAtomicLoad(*builder, posPtr, monotonic, "start_pos");
+    builder->CreateBr(probeBB);
+
+    builder->SetInsertPoint(probeBB);
+    llvm::PHINode *pos = builder->CreatePHI(i64, 2, "pos");
+    llvm::PHINode *attempt = builder->CreatePHI(i64, 2, "attempt");
+    pos->addIncoming(startPos, startBB);
+    attempt->addIncoming(llvm::ConstantInt::get(i64, 0), startBB);
+    llvm::Value *cell = builder->CreateGEP(cellTy, cells, builder->CreateAnd(pos, mask), "cell");
+    llvm::Value *seqPtr = builder->CreateStructGEP(cellTy, cell, CELL_SEQ);
+    llvm::Value *seq = createAtomicLoad(*builder, seqPtr, acquire, "seq");
+    llvm::Value *diff = builder->CreateSub(seq, pos, "diff");
+    builder->CreateCondBr(builder->CreateICmpEQ(diff, llvm::ConstantInt::get(i64, 0)), claimBB, busyBB);
+
+    // 槽可写：占有该位置（失败说明其他发送方抢先，重新读取位置）
+    builder->SetInsertPoint(claimBB);
+    llvm::Value *exchange = builder->CreateAtomicCmpXchg(posPtr, pos, builder->CreateAdd(pos, llvm::ConstantInt::get(i64, 1)),
+                                                         llvm::MaybeAlign(8), monotonic, monotonic);
+    builder->CreateCondBr(builder->CreateExtractValue(exchange, 1, "claimed"), writeBB, retryBB);
+
+    // 序号落后于位置：槽中还是上一轮的元素，队列已满
+    builder->SetInsertPoint(busyBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(diff, llvm::ConstantInt::get(i64, 0)), fullBB, retryBB);
+
+    builder->SetInsertPoint(fullBB);
+    llvm::Value *closed = createAtomicLoad(*builder, closedPtr, acquire, "closed");
+    builder->CreateCondBr(builder->CreateICmpNE(closed, llvm::ConstantInt::get(i64, 0)), closedBB, waitBB);
+
+    builder->SetInsertPoint(waitBB);
+    builder->CreateCall(getChannelBackoffFunction(), {attempt});
+    builder->CreateBr(retryBB);
+
+    builder->SetInsertPoint(retryBB);
+    pos->addIncoming(createAtomicLoad(*builder, posPtr, monotonic, "retry_pos"), retryBB);
+    attempt->addIncoming(builder->CreateAdd(attempt, llvm::ConstantInt::get(i64, 1), "next_attempt"), retryBB);
+    builder->CreateBr(probeBB);
+
+    builder->SetInsertPoint(writeBB);
+    builder->CreateStore(value, builder->CreateStructGEP(cellTy, cell, CELL_VALUE));
+    createAtomicStore(*builder, builder->CreateAdd(pos, llvm::ConstantInt::get(i64, 1)), seqPtr,
+                      llvm::AtomicOrdering::Release);
+    builder->CreateRet(builder->getInt1(true));
+
+    builder->SetInsertPoint(closedBB);
+    builder->CreateRet(builder->getInt1(false));
+    return function;
+}
+
+// i1 __ppx_chan_recv(ptr chan, ptr out)：取出一个元素写入 *out；队列空时等待，通道已关闭且取空时返回 false
+llvm::Function *CodeGenerator::getChannelRecvFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_chan_recv")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *chanTy = getChannelStructType();
+    llvm::StructType *cellTy = llvm::StructType::get(*context, {i64, i64});
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_chan_recv", llvm::FunctionType::get(builder->getInt1Ty(), {ptrTy, ptrTy}, false));
+    llvm::Value *chan = function->getArg(0);
+    llvm::Value *out = function->getArg(1);
+    auto acquire = llvm::AtomicOrdering::Acquire;
+    auto monotonic = llvm::AtomicOrdering::Monotonic;
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *probeBB = llvm::BasicBlock::Create(*context, "probe", function);
+    llvm::BasicBlock *claimBB = llvm::BasicBlock::Create(*context, "claim", function);
+    llvm::BasicBlock *busyBB = llvm::BasicBlock::Create(*context, "busy", function);
+    llvm::BasicBlock *emptyBB = llvm::BasicBlock::Create(*context, "empty", function);
+    llvm::BasicBlock *recheckBB = llvm::BasicBlock::Create(*context, "recheck", function);
+    llvm::BasicBlock *waitBB = llvm::BasicBlock::Create(*context, "wait", function);
+    llvm::BasicBlock *retryBB = llvm::BasicBlock::Create(*context, "retry", function);
+    llvm::BasicBlock *readBB = llvm::BasicBlock::Create(*context, "read", function);
+    llvm::BasicBlock *drainedBB = llvm::BasicBlock::Create(*context, "drained", function);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *closedPtr = builder->CreateStructGEP(chanTy, chan, CHAN_CLOSED);
+    llvm::Value *posPtr = builder->CreateStructGEP(chanTy, chan, CHAN_DEQUEUE_POS);
+    llvm::Value *cells = builder->CreateLoad(ptrTy, builder->CreateStructGEP(chanTy, chan, CHAN_CELLS), "cells");
+    llvm::Value *mask = builder->CreateLoad(i64, builder->CreateStructGEP(chanTy, chan, CHAN_MASK), "mask");
+    llvm::Value *startPos = createAtomicLoad(*builder, posPtr, monotonic, "start_pos");
+    builder->CreateBr(probeBB);
+
+    builder->SetInsertPoint(probeBB);
+    llvm::PHINode *pos = builder->CreatePHI(i64, 2, "pos");
+    llvm::PHINode *attempt = builder->CreatePHI(i64, 2, "attempt");
+    pos->addIncoming(startPos, entryBB);
+    attempt->addIncoming(llvm::ConstantInt::get(i64, 0), entryBB);
+    llvm::Value *cell = builder->CreateGEP(cellTy, cells, builder->CreateAnd(pos, mask), "cell");
+    llvm::Value *seqPtr = builder->CreateStructGEP(cellTy, cell, CELL_SEQ);
+    llvm::Value *nextPos = builder->CreateAdd(pos, llvm::ConstantInt::get(i64, 1), "next_pos");
+    llvm::Value *seq = createAtomicLoad(*builder, seqPtr, acquire, "seq");
+    llvm::Value *diff = builder->CreateSub(seq, nextPos, "diff");
+    builder->CreateCondBr(builder->CreateICmpEQ(diff, llvm::ConstantInt::get(i64, 0)), claimBB, busyBB);
+
+    builder->SetInsertPoint(claimBB);
+    llvm::Value *exchange = builder->CreateAtomicCmpXchg(posPtr, pos, nextPos, llvm::MaybeAlign(8), monotonic, monotonic);
+    builder->CreateCondBr(builder->CreateExtractValue(exchange, 1, "claimed"), readBB, retryBB);
+
+    // 序号落后于位置 + 1：槽还没有被写入，队列为空
+    builder->SetInsertPoint(busyBB);
+    builder->CreateCondBr(builder->CreateICmpSLT(diff, llvm::ConstantInt::get(i64, 0)), emptyBB, retryBB);
+
+    builder->SetInsertPoint(emptyBB);
+    llvm::Value *closed = createAtomicLoad(*builder, closedPtr, acquire, "closed");
+    builder->CreateCondBr(builder->CreateICmpNE(closed, llvm::ConstantInt::get(i64, 0)), recheckBB, waitBB);
+
+    // 看到关闭标志后再读一次序号：关闭之前完成的发送一定在此时可见
+    builder->SetInsertPoint(recheckBB);
+    llvm::Value *lastSeq = createAtomicLoad(*builder, seqPtr, acquire, "last_seq");
+    builder->CreateCondBr(builder->CreateICmpSLT(builder->CreateSub(lastSeq, nextPos), llvm::ConstantInt::get(i64, 0)),
+                          drainedBB, retryBB);
+
+    builder->SetInsertPoint(waitBB);
+    builder->CreateCall(getChannelBackoffFunction(), {attempt});
+    builder->CreateBr(retryBB);
+
+    builder->SetInsertPoint(retryBB);
+    pos->addIncoming(createAtomicLoad(*builder, posPtr, monotonic, "retry_pos"), retryBB);
+    attempt->addIncoming(builder->CreateAdd(attempt, llvm::ConstantInt::get(i64, 1), "next_attempt"), retryBB);
+    builder->CreateBr(probeBB);
+
+    // 读出元素后把槽交给下一轮的发送方
+    builder->SetInsertPoint(readBB);
+    llvm::Value *value = builder->CreateLoad(i64, builder->CreateStructGEP(cellTy, cell, CELL_VALUE), "value");
+    createAtomicStore(*builder, builder->CreateAdd(pos, builder->CreateAdd(mask, llvm::ConstantInt::get(i64, 1))),
+                      seqPtr, llvm::AtomicOrdering::Release);
+    builder->CreateStore(value, out);
+    builder->CreateRet(builder->getInt1(true));
+
+    builder->SetInsertPoint(drainedBB);
+    builder->CreateRet(builder->getInt1(false));
+    return function;
+}
+
+// void __ppx_chan_close(ptr chan)
+llvm::Function *CodeGenerator::getChannelCloseFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_chan_close")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_chan_close", llvm::FunctionType::get(builder->getVoidTy(), {ptrTy}, false));
+
+    RuntimeFunctionGuard guard(*builder);
+    builder->SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", function));
+    llvm::Value *closedPtr = builder->CreateStructGEP(getChannelStructType(), function->getArg(0), CHAN_CLOSED);
+    createAtomicStore(*builder, builder->getInt64(1), closedPtr, llvm::AtomicOrdering::Release);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_chan_retain(ptr chan)：引用计数加一（空指针不变）
+llvm::Function *CodeGenerator::getChannelRetainFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_chan_retain")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::StructType *chanTy = getChannelStructType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_chan_retain", llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy}, false));
+    llvm::Value *chan = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *retainBB = llvm::BasicBlock::Create(*context, "retain", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(chan), doneBB, retainBB);
+
+    builder->SetInsertPoint(retainBB);
+    createCounterUpdate(*builder, builder->CreateStructGEP(chanTy, chan, CHAN_REFS), 1, llvm::AtomicOrdering::Monotonic);
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_chan_release(ptr chan, i1 strings)：引用计数减一（空指针不变），最后一个引用释放时释放通道。
+// 此时没有其他线程访问通道，[dequeuePos, enqueuePos) 之间是已发送、未接收的元素，strings 为真时逐个释放
+llvm::Function *CodeGenerator::getChannelReleaseFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_chan_release")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *i1 = llvm::Type::getInt1Ty(*context);
+    llvm::StructType *chanTy = getChannelStructType();
+    llvm::StructType *cellTy = llvm::StructType::get(*context, {i64, i64});
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_chan_release", llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy, i1}, false));
+    llvm::Value *chan = function->getArg(0);
+    llvm::Value *strings = function->getArg(1);
+    llvm::Function *freeFunc = module->getFunction("free");
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *releaseBB = llvm::BasicBlock::Create(*context, "release", function);
+    llvm::BasicBlock *lastBB = llvm::BasicBlock::Create(*context, "last", function);
+    llvm::BasicBlock *drainBB = llvm::BasicBlock::Create(*context, "drain", function);
+    llvm::BasicBlock *freeCondBB = llvm::BasicBlock::Create(*context, "free_cond", function);
+    llvm::BasicBlock *freeBodyBB = llvm::BasicBlock::Create(*context, "free_body", function);
+    llvm::BasicBlock *freeChanBB = llvm::BasicBlock::Create(*context, "free_chan", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(chan), doneBB, releaseBB);
+
+    // 减一使用 acq_rel：其他线程的发送和接收在释放之前可见
+    builder->SetInsertPoint(releaseBB);
+    llvm::Value *refs = createCounterUpdate(*builder, builder->CreateStructGEP(chanTy, chan, CHAN_REFS), -1,
+                                            llvm::AtomicOrdering::AcquireRelease);
+    builder->CreateCondBr(builder->CreateICmpEQ(refs, llvm::ConstantInt::get(i64, 1), "last"), lastBB, doneBB);
+
+    builder->SetInsertPoint(lastBB);
+    llvm::Value *cells = builder->CreateLoad(ptrTy, builder->CreateStructGEP(chanTy, chan, CHAN_CELLS), "cells");
+    builder->CreateCondBr(strings, drainBB, freeChanBB);
+
+    builder->SetInsertPoint(drainBB);
+    llvm::Value *mask = builder->CreateLoad(i64, builder->CreateStructGEP(chanTy, chan, CHAN_MASK), "mask");
+    llvm::Value *head = builder->CreateLoad(i64, builder->CreateStructGEP(chanTy, chan, CHAN_DEQUEUE_POS), "head");
+    llvm::Value *tail = builder->CreateLoad(i64, builder->CreateStructGEP(chanTy, chan, CHAN_ENQUEUE_POS), "tail");
+    builder->CreateBr(freeCondBB);
+
+    builder->SetInsertPoint(freeCondBB);
+    llvm::PHINode *pos = builder->CreatePHI(i64, 2, "pos");
+    pos->addIncoming(head, drainBB);
+    builder->CreateCondBr(builder->CreateICmpNE(pos, tail), freeBodyBB, freeChanBB);
+
+    builder->SetInsertPoint(freeBodyBB);
+    llvm::Value *cell = builder->CreateGEP(cellTy, cells, builder->CreateAnd(pos, mask), "cell");
+    llvm::Value *word = builder->CreateLoad(i64, builder->CreateStructGEP(cellTy, cell, CELL_VALUE), "word");
+    builder->CreateCall(freeFunc, {builder->CreateIntToPtr(word, ptrTy, "element")});
+    pos->addIncoming(builder->CreateAdd(pos, llvm::ConstantInt::get(i64, 1)), freeBodyBB);
+    builder->CreateBr(freeCondBB);
+
+    builder->SetInsertPoint(freeChanBB);
+    builder->CreateCall(freeFunc, {cells});
+    builder->CreateCall(freeFunc, {chan});
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+llvm::StructType *CodeGenerator::getTaskStructType(llvm::Function *callee) {
+    llvm::Type *resultTy = callee->getReturnType()->isVoidTy() ? builder->getInt8Ty() : callee->getReturnType();
+    std::vector<llvm::Type *> fields = {builder->getInt64Ty(), builder->getInt64Ty(), builder->getInt64Ty(), resultTy};
+    for (llvm::Type *paramTy : callee->getFunctionType()->params()) {
+        fields.push_back(paramTy);
+    }
+    return llvm::StructType::get(*context, fields);
+}
+
+// ptr __ppx_task_f(ptr task)：线程入口，调用 f 后写回结果，释放字符串参数的副本
+// （f 直接返回某个字符串参数时保留该副本，交给 join 的调用者）、引用计数参数的引用和线程持有的任务引用
+llvm::Function *CodeGenerator::getTaskFunction(llvm::Function *callee) {
+    std::string name = "__ppx_task_" + callee->getName().str();
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::StructType *taskTy = getTaskStructType(callee);
+    llvm::Function *function = createRuntimeFunction(module.get(), name, llvm::FunctionType::get(ptrTy, {ptrTy}, false));
+    llvm::Value *task = function->getArg(0);
+    llvm::Function *freeFunc = module->getFunction("free");
+
+    RuntimeFunctionGuard guard(*builder);
+    builder->SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", function));
+    std::vector<llvm::Value *> args;
+    for (unsigned i = 0; i < callee->arg_size(); i++) {
+        llvm::Type *paramTy = callee->getFunctionType()->getParamType(i);
+        args.push_back(builder->CreateLoad(paramTy, builder->CreateStructGEP(taskTy, task, TASK_ARGS + i), "arg"));
+    }
+    llvm::Value *result = builder->CreateCall(callee, args);
+    if (!callee->getReturnType()->isVoidTy()) {
+        builder->CreateStore(result, builder->CreateStructGEP(taskTy, task, TASK_RESULT));
+    }
+
+    auto protoIt = functionPrototypes.find(callee->getName().str());
+    for (unsigned i = 0; i < callee->arg_size() && protoIt != functionPrototypes.end(); i++) {
+        const std::string &paramType = protoIt->second->parameters[i]->type->typeName;
+        if (isCountedType(paramType)) {
+            emitRelease(args[i], paramType);
+            continue;
+        }
+        if (paramType != "string") {
+            continue;
+        }
+        if (!result->getType()->isPointerTy()) {
+            builder->CreateCall(freeFunc, {args[i]});
+            continue;
+        }
+        llvm::BasicBlock *freeBB = llvm::BasicBlock::Create(*context, "free_arg", function);
+        llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*context, "next_arg", function);
+        builder->CreateCondBr(builder->CreateICmpEQ(args[i], result), nextBB, freeBB);
+        builder->SetInsertPoint(freeBB);
+        builder->CreateCall(freeFunc, {args[i]});
+        builder->CreateBr(nextBB);
+        builder->SetInsertPoint(nextBB);
+    }
+
+    // 释放线程持有的引用
+    std::string valueType = protoIt != functionPrototypes.end() && protoIt->second->returnType
+                                ? protoIt->second->returnType->typeName
+                                : "void";
+    builder->CreateCall(getFutureReleaseFunction(valueType), {task});
+    builder->CreateRet(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptrTy)));
+    return function;
+}
+
+// void __ppx_future_retain(ptr task)：任务的引用计数加一（空指针不变）
+llvm::Function *CodeGenerator::getFutureRetainFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_future_retain")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::StructType *taskTy = llvm::StructType::get(*context, {i64, i64, i64});
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_future_retain", llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy}, false));
+    llvm::Value *task = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *retainBB = llvm::BasicBlock::Create(*context, "retain", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(task), doneBB, retainBB);
+
+    builder->SetInsertPoint(retainBB);
+    createCounterUpdate(*builder, builder->CreateStructGEP(taskTy, task, TASK_REFS), 1, llvm::AtomicOrdering::Monotonic);
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// void __ppx_future_release_T(ptr task)：引用计数减一（空指针不变），最后一个引用释放时释放任务结构体。
+// 没有 join 过的任务由这里释放结果（字符串、动态数组或映射），仍可 join 的线程同时被分离。
+// 结果的类型不同，按 future<T> 的 T 分别生成
+llvm::Function *CodeGenerator::getFutureReleaseFunction(const std::string &valueType) {
+    std::string name = "__ppx_future_release_";
+    for (char c : valueType) {
+        name += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    if (llvm::Function *existing = module->getFunction(name)) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Type *valueTy = valueType == "void" ? builder->getInt8Ty() : getType(valueType);
+    llvm::StructType *taskTy = llvm::StructType::get(*context, {i64, i64, i64, valueTy});
+    llvm::Function *function =
+        createRuntimeFunction(module.get(), name, llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy}, false));
+    llvm::Value *task = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *releaseBB = llvm::BasicBlock::Create(*context, "release", function);
+    llvm::BasicBlock *lastBB = llvm::BasicBlock::Create(*context, "last", function);
+    llvm::BasicBlock *resultBB = llvm::BasicBlock::Create(*context, "release_result", function);
+    llvm::BasicBlock *detachBB = llvm::BasicBlock::Create(*context, "detach", function);
+    llvm::BasicBlock *freeBB = llvm::BasicBlock::Create(*context, "free_task", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(task), doneBB, releaseBB);
+
+    // 减一使用 acq_rel：线程写入的结果和状态在释放之前可见
+    builder->SetInsertPoint(releaseBB);
+    llvm::Value *refs = createCounterUpdate(*builder, builder->CreateStructGEP(taskTy, task, TASK_REFS), -1,
+                                            llvm::AtomicOrdering::AcquireRelease);
+    builder->CreateCondBr(builder->CreateICmpEQ(refs, llvm::ConstantInt::get(i64, 1), "last"), lastBB, doneBB);
+
+    builder->SetInsertPoint(lastBB);
+    llvm::Value *state = builder->CreateLoad(i64, builder->CreateStructGEP(taskTy, task, TASK_STATE), "state");
+    builder->CreateCondBr(builder->CreateICmpEQ(state, builder->getInt64(TASK_JOINED)), freeBB, resultBB);
+
+    builder->SetInsertPoint(resultBB);
+    if (valueType == "string" || isCountedType(valueType)) {
+        llvm::Value *result = builder->CreateLoad(valueTy, builder->CreateStructGEP(taskTy, task, TASK_RESULT), "result");
+        if (valueType == "string") {
+            builder->CreateCall(module->getFunction("free"), {result});
+        } else {
+            emitRelease(result, valueType);
+        }
+    }
+    builder->CreateCondBr(builder->CreateICmpEQ(state, builder->getInt64(TASK_JOINABLE)), detachBB, freeBB);
+
+    builder->SetInsertPoint(detachBB);
+    llvm::FunctionCallee detachFunc = module->getOrInsertFunction("pthread_detach", i32, i64);
+    builder->CreateCall(detachFunc, {builder->CreateLoad(i64, builder->CreateStructGEP(taskTy, task, TASK_THREAD), "thread")});
+    builder->CreateBr(freeBB);
+
+    builder->SetInsertPoint(freeBB);
+    builder->CreateCall(module->getFunction("free"), {task});
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// spawn f(args)：参数在当前线程中求值并写入任务结构体，然后创建线程执行 __ppx_task_f
+llvm::Value *CodeGenerator::codegenSpawn(SpawnNode *node, bool detached) {
+    FunctionCallNode *call = node->call.get();
+    const std::string &name = call->functionName;
+    if (g_verbose) {
+        std::cout << "[IR Gen] Spawn: " << name << "()" << (detached ? " (detached)" : "") << std::endl;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+
+    auto protoIt = functionPrototypes.find(name);
+    llvm::Function *callee = module->getFunction(name);
+    if (protoIt == functionPrototypes.end() || !callee) {
+        reportError("spawn expects a call to a user-defined function, '" + name + "' is not one", node->lineNumber);
+        return nullptr;
+    }
+    if (isGeneratorFunction(name)) {
+        reportError("Generator '" + name + "' can only be iterated by a for loop", node->lineNumber);
+        return nullptr;
+    }
+    requestFunctionBody(name);
+    FunctionDeclNode *decl = protoIt->second;
+    for (auto &param : decl->parameters) {
+        if (!param->type->arrayDimensions.empty()) {
+            reportError("spawn cannot pass fixed-size array parameter '" + param->name + "' of '" + name +
+                        "' to another thread", node->lineNumber);
+            return nullptr;
+        }
+    }
+
+    std::vector<llvm::Value *> args;
+    if (!codegenCallArguments(call, callee, args)) {
+        return nullptr;
+    }
+
+    llvm::StructType *taskTy = getTaskStructType(callee);
+    uint64_t taskSize = module->getDataLayout().getTypeAllocSize(taskTy);
+    llvm::Value *task = builder->CreateCall(module->getFunction("malloc"), {llvm::ConstantInt::get(i64, taskSize)}, "task");
+    // 分离的线程是唯一的引用持有者，否则 spawn 的值（future）另持有一个引用
+    builder->CreateStore(builder->getInt64(detached ? 1 : 2), builder->CreateStructGEP(taskTy, task, TASK_REFS));
+    builder->CreateStore(builder->getInt64(detached ? TASK_DETACHED : TASK_JOINABLE),
+                         builder->CreateStructGEP(taskTy, task, TASK_STATE));
+    llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+    for (size_t i = 0; i < args.size(); i++) {
+        llvm::Value *arg = args[i];
+        const std::string &paramType = decl->parameters[i]->type->typeName;
+        if (paramType == "string") {
+            arg = builder->CreateCall(strdupFunc, {arg}, "arg_copy");
+        } else if (isCountedType(paramType)) {
+            // 线程持有动态数组和映射参数的一个引用，函数返回后由 __ppx_task_f 释放
+            emitRetain(arg, paramType);
+        }
+        builder->CreateStore(arg, builder->CreateStructGEP(taskTy, task, TASK_ARGS + i));
+    }
+
+    // 分离的线程可能在 pthread_create 返回前就结束并释放任务结构体，线程号写入栈上的变量
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::Value *threadPtr = detached ? createEntryBlockAlloca(function, "thread", i64)
+                                      : builder->CreateStructGEP(taskTy, task, TASK_THREAD);
+    llvm::FunctionCallee createFunc = module->getOrInsertFunction("pthread_create", i32, ptrTy, ptrTy, ptrTy, ptrTy);
+    llvm::Value *nullPtr = llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptrTy));
+    llvm::Value *status = builder->CreateCall(createFunc, {threadPtr, nullPtr, getTaskFunction(callee), task}, "status");
+
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "spawn_failed", function);
+    llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "spawned", function);
+    builder->CreateCondBr(builder->CreateICmpNE(status, llvm::ConstantInt::get(i32, 0)), failBB, okBB);
+    builder->SetInsertPoint(failBB);
+    emitThrow(builder->CreateGlobalString("spawn failed to create a thread", "", 0, module.get()), false);
+    builder->SetInsertPoint(okBB);
+
+    if (detached) {
+        llvm::FunctionCallee detachFunc = module->getOrInsertFunction("pthread_detach", i32, i64);
+        builder->CreateCall(detachFunc, {builder->CreateLoad(i64, threadPtr, "thread")});
+        return task;
+    }
+    pushTempReference(task, "future<" + (decl->returnType ? decl->returnType->typeName : std::string("void")) + ">");
+    return task;
+}
+
+// chan<T>(capacity)：容量必须为正数，省略时为 CHANNEL_DEFAULT_CAPACITY
+llvm::Value *CodeGenerator::codegenChannel(ChannelNode *node) {
+    if (g_verbose) {
+        std::cout << "[IR Gen] Channel: chan<" << node->elementType << ">" << std::endl;
+    }
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+
+    llvm::Value *capacity = llvm::ConstantInt::get(i32, CodeGenConstants::CHANNEL_DEFAULT_CAPACITY);
+    if (node->capacity) {
+        capacity = codegenExpr(node->capacity.get());
+        if (!capacity) {
+            return nullptr;
+        }
+        if (!capacity->getType()->isIntegerTy(32)) {
+            reportError("Channel capacity must be an int", node->lineNumber);
+            return nullptr;
+        }
+        auto constant = llvm::dyn_cast<llvm::ConstantInt>(capacity);
+        if (constant && constant->getSExtValue() <= 0) {
+            reportError("Channel capacity must be positive", node->lineNumber);
+            return nullptr;
+        }
+        if (!constant) {
+            llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "chan_capacity_error", function);
+            llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "chan_capacity_ok", function);
+            builder->CreateCondBr(builder->CreateICmpSLE(capacity, llvm::ConstantInt::get(i32, 0)), failBB, okBB);
+            builder->SetInsertPoint(failBB);
+            emitThrow(builder->CreateGlobalString("Channel capacity must be positive", "", 0, module.get()), false);
+            builder->SetInsertPoint(okBB);
+        }
+    }
+
+    llvm::Value *chan = builder->CreateCall(getChannelNewFunction(), {builder->CreateSExt(capacity, i64)}, "chan");
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "chan_alloc_error", function);
+    llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "chan_created", function);
+    builder->CreateCondBr(builder->CreateIsNull(chan), failBB, okBB);
+    builder->SetInsertPoint(failBB);
+    emitThrow(builder->CreateGlobalString("Cannot allocate channel", "", 0, module.get()), false);
+    builder->SetInsertPoint(okBB);
+    pushTempReference(chan, "chan<" + node->elementType + ">");
+    return chan;
+}
+
+llvm::Value *CodeGenerator::channelWord(llvm::Value *value, const std::string &elementType) {
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    if (elementType == "double") {
+        return builder->CreateBitCast(value, i64);
+    }
+    if (value->getType()->isPointerTy()) {
+        return builder->CreatePtrToInt(value, i64);
+    }
+    if (elementType == "int") {
+        return builder->CreateSExt(value, i64);
+    }
+    return builder->CreateZExt(value, i64);
+}
+
+llvm::Value *CodeGenerator::channelValue(llvm::Value *word, const std::string &elementType) {
+    llvm::Type *elementTy = getType(elementType);
+    if (elementTy->isDoubleTy()) {
+        return builder->CreateBitCast(word, elementTy, "element");
+    }
+    if (elementTy->isPointerTy()) {
+        return builder->CreateIntToPtr(word, elementTy, "element");
+    }
+    return builder->CreateTrunc(word, elementTy, "element");
+}
+
+bool CodeGenerator::isThreadBuiltin(const std::string &name) {
+    return name == "join" || name == "send" || name == "recv" || name == "close";
+}
+
+// 方法写法的对象、或普通写法的第一个参数为 future（join）或通道（send、recv、close）时为线程内置函数；
+// 普通写法与用户定义的同名函数冲突时调用用户函数
+bool CodeGenerator::threadBuiltinCall(FunctionCallNode *node, ExprNode *&subject, size_t &firstArg) {
+    if (!isThreadBuiltin(node->functionName)) {
+        return false;
+    }
+    if (node->object) {
+        subject = node->object.get();
+        firstArg = 0;
+    } else {
+        if (functionPrototypes.count(node->functionName) || functions.count(node->functionName) ||
+            node->arguments.empty()) {
+            return false;
+        }
+        subject = node->arguments[0].get();
+        firstArg = 1;
+    }
+    std::string subjectType = declaredTypeOf(subject);
+    return node->functionName == "join" ? isFutureType(subjectType) : isChanType(subjectType);
+}
+
+std::string CodeGenerator::threadBuiltinType(FunctionCallNode *node, ExprNode *subject) {
+    std::string subjectType = declaredTypeOf(subject);
+    if (node->functionName == "join") {
+        std::string valueType = futureValueType(subjectType);
+        return valueType == "void" ? "int" : valueType;
+    }
+    if (node->functionName == "recv") {
+        return chanElementType(subjectType);
+    }
+    return "int";
+}
+
+llvm::Value *CodeGenerator::codegenThreadBuiltin(FunctionCallNode *node, ExprNode *subject, size_t firstArg) {
+    const std::string &name = node->functionName;
+    if (g_verbose) {
+        std::cout << "[IR Gen] Thread builtin: " << name << "()" << std::endl;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(*context);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+
+    size_t expected = name == "send" ? 1 : 0;
+    if (node->arguments.size() - firstArg != expected) {
+        reportError(name == "send" ? "send() expects 2 arguments (channel, value)"
+                    : name == "join" ? "join() expects 1 argument (future)"
+                    : name + "() expects 1 argument (channel)", node->lineNumber);
+        return nullptr;
+    }
+    std::string subjectType = declaredTypeOf(subject);
+    llvm::Value *handle = codegenExpr(subject);
+    if (!handle) {
+        return nullptr;
+    }
+
+    // join：把状态从 joinable 改为 joined（已经 join 过时抛出异常），等待线程结束后取出结果；
+    // 任务结构体由最后一个引用释放
+    if (name == "join") {
+        std::string valueType = futureValueType(subjectType);
+        llvm::Type *valueTy = valueType == "void" ? builder->getInt8Ty() : getType(valueType);
+        llvm::StructType *taskTy = llvm::StructType::get(*context, {i64, i64, i64, valueTy});
+        llvm::Function *function = builder->GetInsertBlock()->getParent();
+        llvm::BasicBlock *claimBB = llvm::BasicBlock::Create(*context, "join_claim", function);
+        llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "join_failed", function);
+        llvm::BasicBlock *joinBB = llvm::BasicBlock::Create(*context, "join_wait", function);
+        builder->CreateCondBr(builder->CreateIsNull(handle), failBB, claimBB);
+        builder->SetInsertPoint(claimBB);
+        llvm::Value *claim = builder->CreateAtomicCmpXchg(
+            builder->CreateStructGEP(taskTy, handle, TASK_STATE), builder->getInt64(TASK_JOINABLE),
+            builder->getInt64(TASK_JOINED), llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic,
+            llvm::AtomicOrdering::Monotonic);
+        builder->CreateCondBr(builder->CreateExtractValue(claim, 1, "claimed"), joinBB, failBB);
+        builder->SetInsertPoint(failBB);
+        emitThrow(builder->CreateGlobalString("join() on a future that has already been joined", "", 0, module.get()),
+                  false);
+        builder->SetInsertPoint(joinBB);
+        llvm::Value *thread = builder->CreateLoad(i64, builder->CreateStructGEP(taskTy, handle, TASK_THREAD), "thread");
+        llvm::FunctionCallee joinFunc = module->getOrInsertFunction("pthread_join", i32, i64, ptrTy);
+        builder->CreateCall(joinFunc, {thread, llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptrTy))});
+        llvm::Value *result = llvm::ConstantInt::get(i32, 0);
+        if (valueType != "void") {
+            result = builder->CreateLoad(valueTy, builder->CreateStructGEP(taskTy, handle, TASK_RESULT), "result");
+        }
+        pushTempReference(result, valueType);
+        return result;
+    }
+
+    std::string elementType = chanElementType(subjectType);
+    if (name == "close") {
+        builder->CreateCall(getChannelCloseFunction(), {handle});
+        return llvm::ConstantInt::get(i32, 0);
+    }
+
+    if (name == "send") {
+        ExprNode *valueNode = node->arguments[firstArg].get();
+        llvm::Value *value = codegenTypedExpr(valueNode, elementType);
+        if (!value) {
+            return nullptr;
+        }
+        // int 值可以发送到 chan<double>，其余类型必须相同
+        std::string valueType = declaredTypeOf(valueNode);
+        std::string actual = valueType.empty() ? typeNameOf(value->getType()) : valueType;
+        llvm::Type *elementTy = getType(elementType);
+        bool widened = elementTy->isDoubleTy() && value->getType()->isIntegerTy(32);
+        if ((value->getType() != elementTy && !widened) || (isReferenceType(actual) && actual != elementType)) {
+            reportError("send() value of type '" + actual + "' does not match channel element type '" + elementType + "'",
+                        node->lineNumber);
+            return nullptr;
+        }
+        if (value->getType() != elementTy) {
+            value = convertToType(value, elementTy);
+        }
+        // 字符串发送副本，接收方取得所有权
+        if (elementType == "string") {
+            llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+            value = builder->CreateCall(strdupFunc, {value}, "sent_copy");
+        }
+        llvm::Value *sent = builder->CreateCall(getChannelSendFunction(), {handle, channelWord(value, elementType)}, "sent");
+        llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "send_closed", function);
+        llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "send_ok", function);
+        builder->CreateCondBr(sent, okBB, failBB);
+        builder->SetInsertPoint(failBB);
+        if (elementType == "string") {
+            builder->CreateCall(module->getFunction("free"), {value});
+        }
+        emitThrow(builder->CreateGlobalString("send() on a closed channel", "", 0, module.get()), false);
+        builder->SetInsertPoint(okBB);
+        return llvm::ConstantInt::get(i32, 0);
+    }
+
+    // recv：通道已关闭且取空时抛出异常，接收到的字符串为临时内存
+    llvm::AllocaInst *slot = createEntryBlockAlloca(function, "recv_slot", i64);
+    llvm::Value *received = builder->CreateCall(getChannelRecvFunction(), {handle, slot}, "received");
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "recv_closed", function);
+    llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "recv_ok", function);
+    builder->CreateCondBr(received, okBB, failBB);
+    builder->SetInsertPoint(failBB);
+    emitThrow(builder->CreateGlobalString("recv() on a closed channel", "", 0, module.get()), false);
+    builder->SetInsertPoint(okBB);
+    llvm::Value *value = channelValue(builder->CreateLoad(i64, slot, "word"), elementType);
+    if (elementType == "string") {
+        pushTempMemory(value);
+    }
+    return value;
+}
+
+// for x in c：每次迭代接收一个元素，通道关闭且取空后结束；字符串元素在迭代结束时释放
+void CodeGenerator::codegenChannelForStmt(ForStmtNode *node, const std::string &chanType) {
+    if (g_verbose) {
+        std::cout << "[IR Gen] For loop: " << node->variable << " in " << chanType << std::endl;
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    std::string elementType = chanElementType(chanType);
+    llvm::Type *elementTy = getType(elementType);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+
+    // 检查循环变量名是否与已存在的局部变量冲突（警告而非错误）
+    if (currentDiagnostics().enableShadowWarnings && fn->namedValues.find(node->variable) != fn->namedValues.end()) {
+        reportWarning("For loop variable '" + node->variable + "' shadows an existing local variable", node->lineNumber);
+    }
+
+    llvm::Value *chan = codegenExpr(node->iterable.get());
+    if (!chan) {
+        return;
+    }
+    // 循环持有通道的一个引用：循环体中的语句会释放临时值，也可能给被遍历的变量赋值
+    llvm::AllocaInst *chanVar = createEntryBlockAlloca(function, node->variable + "_chan", chan->getType());
+    trackReferenceSlot(chanVar, chanType);
+    storeReference(chanVar, chan, chanType);
+    clearTempMemory();
+
+    llvm::AllocaInst *loopVar = createEntryBlockAlloca(function, node->variable, elementTy);
+    llvm::AllocaInst *slot = createEntryBlockAlloca(function, node->variable + "_slot", i64);
+    fn->namedValues[node->variable] = loopVar;
+    fn->variableTypes[node->variable] = elementType;
+
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "forchan_cond", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "forchan_body");
+    llvm::BasicBlock *incrBB = llvm::BasicBlock::Create(*context, "forchan_incr");
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(*context, "after_forchan");
+
+    LoopContext loopCtx;
+    loopCtx.continueBlock = incrBB;
+    loopCtx.breakBlock = afterBB;
+    fn->loopContextStack.push_back(loopCtx);
+
+    builder->CreateBr(condBB);
+    builder->SetInsertPoint(condBB);
+    llvm::Value *received = builder->CreateCall(getChannelRecvFunction(),
+                                                {builder->CreateLoad(chan->getType(), chanVar, "chan"), slot}, "received");
+    builder->CreateCondBr(received, bodyBB, afterBB);
+
+    function->insert(function->end(), bodyBB);
+    builder->SetInsertPoint(bodyBB);
+    builder->CreateStore(channelValue(builder->CreateLoad(i64, slot, "word"), elementType), loopVar);
+    codegenStmt(node->body.get());
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(incrBB);
+    }
+
+    function->insert(function->end(), incrBB);
+    builder->SetInsertPoint(incrBB);
+    clearTempMemory();
+    if (elementType == "string") {
+        // 按接收到的指针释放（循环体可能给循环变量重新赋值）
+        llvm::Value *element = builder->CreateIntToPtr(builder->CreateLoad(i64, slot, "word"), elementTy);
+        builder->CreateCall(module->getFunction("free"), {element});
+    }
+    builder->CreateBr(condBB);
+
+    function->insert(function->end(), afterBB);
+    builder->SetInsertPoint(afterBB);
+    attachLoopHints(node->annotations, node->lineNumber, condBB);
+    fn->loopContextStack.pop_back();
+
+    // 循环变量的作用域仅限于循环内
+    fn->namedValues.erase(node->variable);
+    fn->variableTypes.erase(node->variable);
+}
+
+// ============================================================================
+// 生成器
+// ============================================================================
+// 返回类型为 gen<T> 的函数是生成器，函数体中的 yield v 向 for x in f(args) 产出一个值后挂起，
+// 下一次迭代从 yield 之后继续执行；函数体执行完毕或 return 时循环结束。
+// 生成器按 LLVM 协程（switched-resume）降级：
+// - 入口：llvm.coro.id 以 promise 变量保存 yield 的值；llvm.coro.alloc 为真时向帧池申请协程帧，
+//   llvm.coro.begin 返回协程句柄，字符串参数复制一份（调用方的临时字符串在循环开始前就会释放），
+//   随后在初始挂起点返回句柄，调用只创建协程而不执行函数体
+// - yield：写入 promise 后挂起；恢复时释放本条语句的临时内存，销毁时释放临时内存和正在迭代的内层生成器
+// - 结束：最终挂起点使 llvm.coro.done 为真；清理块释放参数副本，llvm.coro.free 返回的协程帧交还帧池
+// - for 循环：每次迭代 llvm.coro.resume，llvm.coro.done 为真时结束，否则通过 llvm.coro.promise 读取值；
+//   循环结束（包括 break）和函数 return 时 llvm.coro.destroy 释放协程帧
+// IR 生成后由 lowerCoroutines 运行协程 Pass。拆分后的生成器入口标记为 alwaysinline，内联到迭代它的函数后
+// CoroElide 能看到协程的整个生命周期，把协程帧改为调用方栈上的局部变量，不再申请内存。
+// 无法消除的协程帧（递归的生成器等）来自按 64 字节分级的帧池，释放的帧按大小挂到空闲链表上重用。
+// 限制：生成器只能被 for 循环迭代（不能赋值给变量或传给其他函数）；try 块中不能 yield；
+// 循环体中抛出的异常被外层 catch 捕获时不会销毁生成器（协程帧泄漏）。
+
+bool CodeGenerator::isGenType(const std::string &typeName) {
+    return typeName.rfind("gen<", 0) == 0;
+}
+
+std::string CodeGenerator::genElementType(const std::string &genType) {
+    return genType.substr(4, genType.size() - 5);
+}
+
+bool CodeGenerator::isGeneratorFunction(const std::string &name) {
+    auto it = functionPrototypes.find(name);
+    return it != functionPrototypes.end() && it->second->returnType && isGenType(it->second->returnType->typeName);
+}
+
+// 调用协程内置函数（overloads 为重载类型，如 llvm.coro.size.i64 的 i64）
+static llvm::CallInst *createCoroCall(llvm::IRBuilder<> &builder, llvm::Module *module, llvm::Intrinsic::ID id,
+                                      llvm::ArrayRef<llvm::Value *> args, const std::string &name = "",
+                                      llvm::ArrayRef<llvm::Type *> overloads = {}) {
+    llvm::Function *intrinsic = llvm::Intrinsic::getOrInsertDeclaration(module, id, overloads);
+    return builder.CreateCall(intrinsic, args, name);
+}
+
+// 帧池：{ i64 lock, [GENERATOR_POOL_CLASSES x ptr] free }，第 k 个空闲链表保存 k 个 GENERATOR_BLOCK_BYTES 的块，
+// 空闲块的前 8 字节指向链表中的下一块
+llvm::GlobalVariable *CodeGenerator::getGeneratorPoolGlobal() {
+    if (llvm::GlobalVariable *existing = module->getGlobalVariable("__ppx_gen_pool")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::StructType *poolTy = llvm::StructType::get(
+        *context, {llvm::Type::getInt64Ty(*context), llvm::ArrayType::get(ptrTy, CodeGenConstants::GENERATOR_POOL_CLASSES)});
+    return new llvm::GlobalVariable(*module, poolTy, false, llvm::GlobalValue::LinkOnceODRLinkage,
+                                    llvm::Constant::getNullValue(poolTy), "__ppx_gen_pool");
+}
+
+// 帧池的自旋锁：获取失败时 sched_yield 后重试
+static void emitPoolLock(llvm::IRBuilder<> &builder, llvm::Module *module, llvm::Value *lock) {
+    llvm::LLVMContext &context = builder.getContext();
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *tryBB = llvm::BasicBlock::Create(context, "lock", function);
+    llvm::BasicBlock *waitBB = llvm::BasicBlock::Create(context, "lock_wait", function);
+    llvm::BasicBlock *lockedBB = llvm::BasicBlock::Create(context, "locked", function);
+    llvm::FunctionCallee yieldFunc = module->getOrInsertFunction("sched_yield", builder.getInt32Ty());
+    builder.CreateBr(tryBB);
+
+    builder.SetInsertPoint(tryBB);
+    llvm::Value *result = builder.CreateAtomicCmpXchg(lock, builder.getInt64(0), builder.getInt64(1), llvm::MaybeAlign(8),
+                                                      llvm::AtomicOrdering::Acquire, llvm::AtomicOrdering::Monotonic);
+    builder.CreateCondBr(builder.CreateExtractValue(result, 1, "acquired"), lockedBB, waitBB);
+
+    builder.SetInsertPoint(waitBB);
+    builder.CreateCall(yieldFunc);
+    builder.CreateBr(tryBB);
+
+    builder.SetInsertPoint(lockedBB);
+}
+
+// ptr __ppx_gen_alloc(i64 size)：块头 GENERATOR_HEADER_BYTES 字节保存大小级别（0 表示直接由 malloc 分配），
+// 返回块头之后的地址，分配失败时返回 null
+llvm::Function *CodeGenerator::getGeneratorAllocFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_gen_alloc")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::GlobalVariable *pool = getGeneratorPoolGlobal();
+    llvm::Type *poolTy = pool->getValueType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_gen_alloc", llvm::FunctionType::get(ptrTy, {i64}, false));
+    llvm::Value *size = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *largeBB = llvm::BasicBlock::Create(*context, "large", function);
+    llvm::BasicBlock *pooledBB = llvm::BasicBlock::Create(*context, "pooled", function);
+    llvm::BasicBlock *reuseBB = llvm::BasicBlock::Create(*context, "reuse", function);
+    llvm::BasicBlock *freshBB = llvm::BasicBlock::Create(*context, "fresh", function);
+    llvm::BasicBlock *headerBB = llvm::BasicBlock::Create(*context, "header", function);
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "fail", function);
+    llvm::Function *mallocFunc = module->getFunction("malloc");
+    llvm::Value *blockBytes = llvm::ConstantInt::get(i64, CodeGenConstants::GENERATOR_BLOCK_BYTES);
+
+    builder->SetInsertPoint(entryBB);
+    llvm::Value *total = builder->CreateAdd(size, llvm::ConstantInt::get(i64, CodeGenConstants::GENERATOR_HEADER_BYTES), "total");
+    llvm::Value *cls = builder->CreateUDiv(builder->CreateAdd(total, llvm::ConstantInt::get(i64, CodeGenConstants::GENERATOR_BLOCK_BYTES - 1)),
+                                           blockBytes, "class");
+    builder->CreateCondBr(builder->CreateICmpUGE(cls, llvm::ConstantInt::get(i64, CodeGenConstants::GENERATOR_POOL_CLASSES)),
+                          largeBB, pooledBB);
+
+    builder->SetInsertPoint(largeBB);
+    llvm::Value *largeBlock = builder->CreateCall(mallocFunc, {total}, "large_block");
+    builder->CreateBr(headerBB);
+
+    builder->SetInsertPoint(pooledBB);
+    llvm::Value *lock = builder->CreateStructGEP(poolTy, pool, GEN_POOL_LOCK);
+    llvm::Value *head = builder->CreateGEP(poolTy, pool, {builder->getInt32(0), builder->getInt32(GEN_POOL_FREE), cls}, "head");
+    emitPoolLock(*builder, module.get(), lock);
+    llvm::Value *freeBlock = builder->CreateLoad(ptrTy, head, "free_block");
+    builder->CreateCondBr(builder->CreateIsNull(freeBlock), freshBB, reuseBB);
+
+    builder->SetInsertPoint(reuseBB);
+    builder->CreateStore(builder->CreateLoad(ptrTy, freeBlock, "next"), head);
+    createAtomicStore(*builder, llvm::ConstantInt::get(i64, 0), lock, llvm::AtomicOrdering::Release);
+    builder->CreateBr(headerBB);
+
+    builder->SetInsertPoint(freshBB);
+    createAtomicStore(*builder, llvm::ConstantInt::get(i64, 0), lock, llvm::AtomicOrdering::Release);
+    llvm::Value *freshBlock = builder->CreateCall(mallocFunc, {builder->CreateMul(cls, blockBytes)}, "fresh_block");
+    builder->CreateBr(headerBB);
+
+    builder->SetInsertPoint(headerBB);
+    llvm::PHINode *block = builder->CreatePHI(ptrTy, 3, "block");
+    block->addIncoming(largeBlock, largeBB);
+    block->addIncoming(freeBlock, reuseBB);
+    block->addIncoming(freshBlock, freshBB);
+    llvm::PHINode *blockClass = builder->CreatePHI(i64, 3, "block_class");
+    blockClass->addIncoming(llvm::ConstantInt::get(i64, 0), largeBB);
+    blockClass->addIncoming(cls, reuseBB);
+    blockClass->addIncoming(cls, freshBB);
+    llvm::BasicBlock *okBB = llvm::BasicBlock::Create(*context, "ok", function);
+    builder->CreateCondBr(builder->CreateIsNull(block), failBB, okBB);
+
+    builder->SetInsertPoint(okBB);
+    builder->CreateStore(blockClass, block);
+    builder->CreateRet(builder->CreateConstGEP1_64(builder->getInt8Ty(), block, CodeGenConstants::GENERATOR_HEADER_BYTES, "frame"));
+
+    builder->SetInsertPoint(failBB);
+    builder->CreateRet(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptrTy)));
+    return function;
+}
+
+// void __ppx_gen_free(ptr frame)：池中分配的块挂回对应的空闲链表，其余块直接释放
+llvm::Function *CodeGenerator::getGeneratorFreeFunction() {
+    if (llvm::Function *existing = module->getFunction("__ppx_gen_free")) {
+        return existing;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::GlobalVariable *pool = getGeneratorPoolGlobal();
+    llvm::Type *poolTy = pool->getValueType();
+    llvm::Function *function = createRuntimeFunction(
+        module.get(), "__ppx_gen_free", llvm::FunctionType::get(llvm::Type::getVoidTy(*context), {ptrTy}, false));
+    llvm::Value *frame = function->getArg(0);
+
+    RuntimeFunctionGuard guard(*builder);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
+    llvm::BasicBlock *blockBB = llvm::BasicBlock::Create(*context, "block", function);
+    llvm::BasicBlock *largeBB = llvm::BasicBlock::Create(*context, "large", function);
+    llvm::BasicBlock *pooledBB = llvm::BasicBlock::Create(*context, "pooled", function);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*context, "done", function);
+
+    builder->SetInsertPoint(entryBB);
+    builder->CreateCondBr(builder->CreateIsNull(frame), doneBB, blockBB);
+
+    builder->SetInsertPoint(blockBB);
+    llvm::Value *block = builder->CreateConstGEP1_64(builder->getInt8Ty(), frame,
+                                                     -static_cast<int64_t>(CodeGenConstants::GENERATOR_HEADER_BYTES), "block");
+    llvm::Value *cls = builder->CreateLoad(i64, block, "class");
+    builder->CreateCondBr(builder->CreateICmpEQ(cls, llvm::ConstantInt::get(i64, 0)), largeBB, pooledBB);
+
+    builder->SetInsertPoint(largeBB);
+    builder->CreateCall(module->getFunction("free"), {block});
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(pooledBB);
+    llvm::Value *lock = builder->CreateStructGEP(poolTy, pool, GEN_POOL_LOCK);
+    llvm::Value *head = builder->CreateGEP(poolTy, pool, {builder->getInt32(0), builder->getInt32(GEN_POOL_FREE), cls}, "head");
+    emitPoolLock(*builder, module.get(), lock);
+    builder->CreateStore(builder->CreateLoad(ptrTy, head, "next"), block);
+    builder->CreateStore(block, head);
+    createAtomicStore(*builder, llvm::ConstantInt::get(i64, 0), lock, llvm::AtomicOrdering::Release);
+    builder->CreateBr(doneBB);
+
+    builder->SetInsertPoint(doneBB);
+    builder->CreateRetVoid();
+    return function;
+}
+
+// 生成器入口：创建 promise 和协程句柄（在参数写入局部变量之前）
+void CodeGenerator::emitGeneratorEntry(llvm::Function *function, const std::string &genType) {
+    GeneratorContext &gen = fn->generator;
+    gen.yieldType = genElementType(genType);
+    if (g_verbose) {
+        std::cout << "[IR Gen] Generator: " << function->getName().str() << " yields " << gen.yieldType << std::endl;
+    }
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::Type *i64 = llvm::Type::getInt64Ty(*context);
+    llvm::Value *nullPtr = llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptrTy));
+
+    // CoroSplit 只拆分标记为 presplitcoroutine 的函数；拆分后的入口内联到调用方，以便 CoroElide 消除帧分配
+    function->setPresplitCoroutine();
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+
+    gen.promise = createEntryBlockAlloca(function, "promise", getType(gen.yieldType));
+    gen.promise->setAlignment(llvm::Align(CodeGenConstants::GENERATOR_PROMISE_ALIGN));
+    gen.id = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_id,
+                            {builder->getInt32(0), gen.promise, nullPtr, nullPtr}, "id");
+
+    llvm::BasicBlock *entryBB = builder->GetInsertBlock();
+    llvm::BasicBlock *allocBB = llvm::BasicBlock::Create(*context, "gen_alloc", function);
+    llvm::BasicBlock *failBB = llvm::BasicBlock::Create(*context, "gen_alloc_error", function);
+    llvm::BasicBlock *allocatedBB = llvm::BasicBlock::Create(*context, "gen_allocated", function);
+    llvm::BasicBlock *beginBB = llvm::BasicBlock::Create(*context, "gen_begin", function);
+    llvm::Value *needAlloc = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_alloc, {gen.id}, "need_alloc");
+    builder->CreateCondBr(needAlloc, allocBB, beginBB);
+
+    builder->SetInsertPoint(allocBB);
+    llvm::Value *size = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_size, {}, "frame_size", {i64});
+    llvm::Value *memory = builder->CreateCall(getGeneratorAllocFunction(), {size}, "frame_memory");
+    builder->CreateCondBr(builder->CreateIsNull(memory), failBB, allocatedBB);
+    builder->SetInsertPoint(failBB);
+    emitThrow(builder->CreateGlobalString("Cannot allocate generator frame", "", 0, module.get()), false);
+    builder->SetInsertPoint(allocatedBB);
+    builder->CreateBr(beginBB);
+
+    builder->SetInsertPoint(beginBB);
+    llvm::PHINode *frame = builder->CreatePHI(ptrTy, 2, "frame");
+    frame->addIncoming(nullPtr, entryBB);
+    frame->addIncoming(memory, allocatedBB);
+    gen.handle = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_begin, {gen.id, frame}, "handle");
+
+    gen.finalBlock = llvm::BasicBlock::Create(*context, "gen_final");
+    gen.cleanupBlock = llvm::BasicBlock::Create(*context, "gen_cleanup");
+    gen.suspendBlock = llvm::BasicBlock::Create(*context, "gen_suspend");
+}
+
+// 参数写入局部变量之后：复制字符串参数，然后在初始挂起点返回
+void CodeGenerator::emitGeneratorStart(FunctionDeclNode *node) {
+    GeneratorContext &gen = fn->generator;
+    llvm::Function *function = fn->function;
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", ptrTy, ptrTy);
+    for (auto &param : node->parameters) {
+        if (param->type->typeName != "string" || !param->type->arrayDimensions.empty()) {
+            continue;
+        }
+        llvm::AllocaInst *slot = fn->namedValues[param->name];
+        llvm::Value *copy = builder->CreateCall(strdupFunc, {builder->CreateLoad(ptrTy, slot)}, param->name + "_copy");
+        builder->CreateStore(copy, slot);
+        llvm::AllocaInst *copySlot = createEntryBlockAlloca(function, param->name + "_copy", ptrTy);
+        builder->CreateStore(copy, copySlot);
+        gen.stringCopies.push_back(copySlot);
+    }
+
+    llvm::Value *state = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_suspend,
+                                        {llvm::ConstantTokenNone::get(*context), builder->getFalse()}, "initial");
+    llvm::BasicBlock *startBB = llvm::BasicBlock::Create(*context, "gen_start", function);
+    llvm::SwitchInst *dispatch = builder->CreateSwitch(state, gen.suspendBlock, 2);
+    dispatch->addCase(builder->getInt8(0), startBB);
+    dispatch->addCase(builder->getInt8(1), gen.cleanupBlock);
+    builder->SetInsertPoint(startBB);
+}
+
+// 函数体之后：最终挂起点、清理块和返回句柄的挂起块
+void CodeGenerator::emitGeneratorFinish() {
+    GeneratorContext &gen = fn->generator;
+    llvm::Function *function = fn->function;
+    llvm::Type *ptrTy = llvm::PointerType::get(*context, 0);
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        clearTempMemory();
+        builder->CreateBr(gen.finalBlock);
+    }
+
+    // 最终挂起后 llvm.coro.done 为真，生成器只能被销毁
+    function->insert(function->end(), gen.finalBlock);
+    builder->SetInsertPoint(gen.finalBlock);
+    llvm::Value *state = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_suspend,
+                                        {llvm::ConstantTokenNone::get(*context), builder->getTrue()}, "final");
+    llvm::BasicBlock *resumedBB = llvm::BasicBlock::Create(*context, "gen_resumed_after_final", function);
+    llvm::SwitchInst *dispatch = builder->CreateSwitch(state, gen.suspendBlock, 2);
+    dispatch->addCase(builder->getInt8(0), resumedBB);
+    dispatch->addCase(builder->getInt8(1), gen.cleanupBlock);
+    builder->SetInsertPoint(resumedBB);
+    builder->CreateUnreachable();
+
+    function->insert(function->end(), gen.cleanupBlock);
+    builder->SetInsertPoint(gen.cleanupBlock);
+    for (llvm::AllocaInst *copySlot : gen.stringCopies) {
+        builder->CreateCall(module->getFunction("free"), {builder->CreateLoad(ptrTy, copySlot)});
+    }
+    for (auto it = fn->referenceSlots.rbegin(); it != fn->referenceSlots.rend(); ++it) {
+        emitRelease(builder->CreateLoad(ptrTy, it->first, "local_ref"), it->second);
+    }
+    llvm::Value *memory = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_free, {gen.id, gen.handle}, "frame");
+    builder->CreateCall(getGeneratorFreeFunction(), {memory});
+    builder->CreateBr(gen.suspendBlock);
+
+    function->insert(function->end(), gen.suspendBlock);
+    builder->SetInsertPoint(gen.suspendBlock);
+    createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_end,
+                   {gen.handle, builder->getFalse(), llvm::ConstantTokenNone::get(*context)});
+    builder->CreateRet(gen.handle);
+}
+
+// 逆序销毁当前函数中正在被 for 循环迭代的生成器
+void CodeGenerator::destroyActiveGenerators() {
+    for (auto it = fn->activeGenerators.rbegin(); it != fn->activeGenerators.rend(); ++it) {
+        createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_destroy, {*it});
+    }
+}
+
+void CodeGenerator::codegenYieldStmt(YieldStmtNode *node) {
+    if (g_verbose) {
+        std::cout << "[IR Gen] Yield statement" << std::endl;
+    }
+    GeneratorContext &gen = fn->generator;
+    if (!gen.handle) {
+        reportError("'yield' can only be used in a generator function (return type gen<T>)", node->lineNumber);
+        return;
+    }
+    if (!fn->exceptionContextStack.empty()) {
+        reportError("'yield' cannot be used inside a try block", node->lineNumber);
+        return;
+    }
+
+    llvm::Value *value = codegenTypedExpr(node->value.get(), gen.yieldType);
+    if (!value) {
+        return;
+    }
+    // 与 send 相同：int 值可以由 gen<double> 产出，其余类型必须相同
+    std::string valueType = declaredTypeOf(node->value.get());
+    std::string actual = valueType.empty() ? typeNameOf(value->getType()) : valueType;
+    llvm::Type *yieldTy = getType(gen.yieldType);
+    bool widened = yieldTy->isDoubleTy() && value->getType()->isIntegerTy(32);
+    if ((value->getType() != yieldTy && !widened) || (isReferenceType(actual) && actual != gen.yieldType)) {
+        reportError("yield value of type '" + actual + "' does not match generator element type '" + gen.yieldType + "'",
+                    node->lineNumber);
+        return;
+    }
+    if (value->getType() != yieldTy) {
+        value = convertToType(value, yieldTy);
+    }
+    builder->CreateStore(value, gen.promise);
+
+    llvm::Value *state = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_suspend,
+                                        {llvm::ConstantTokenNone::get(*context), builder->getFalse()}, "yield_state");
+    llvm::BasicBlock *resumeBB = llvm::BasicBlock::Create(*context, "yield_resume", fn->function);
+    llvm::BasicBlock *destroyBB = llvm::BasicBlock::Create(*context, "yield_destroy", fn->function);
+    llvm::SwitchInst *dispatch = builder->CreateSwitch(state, gen.suspendBlock, 2);
+    dispatch->addCase(builder->getInt8(0), resumeBB);
+    dispatch->addCase(builder->getInt8(1), destroyBB);
+
+    // 在 yield 处被销毁（for 循环提前结束）：释放内层生成器和本条语句的临时内存
+    builder->SetInsertPoint(destroyBB);
+    destroyActiveGenerators();
+    for (auto it = fn->tempReferences.rbegin(); it != fn->tempReferences.rend(); ++it) {
+        emitRelease(it->first, it->second);
+    }
+    for (auto it = fn->tempMemoryStack.rbegin(); it != fn->tempMemoryStack.rend(); ++it) {
+        builder->CreateCall(module->getFunction("free"), {*it});
+    }
+    builder->CreateBr(gen.cleanupBlock);
+
+    builder->SetInsertPoint(resumeBB);
+    clearTempMemory();
+}
+
+// for x in f(args)：调用生成器得到句柄，每次迭代恢复一次，llvm.coro.done 为真时结束
+void CodeGenerator::codegenGeneratorForStmt(ForStmtNode *node, FunctionCallNode *call) {
+    const std::string &name = call->functionName;
+    if (g_verbose) {
+        std::cout << "[IR Gen] For loop: " << node->variable << " in generator " << name << "()" << std::endl;
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    std::string elementType = genElementType(functionPrototypes[name]->returnType->typeName);
+    llvm::Type *elementTy = getType(elementType);
+
+    // 检查循环变量名是否与已存在的局部变量冲突（警告而非错误）
+    if (currentDiagnostics().enableShadowWarnings && fn->namedValues.find(node->variable) != fn->namedValues.end()) {
+        reportWarning("For loop variable '" + node->variable + "' shadows an existing local variable", node->lineNumber);
+    }
+
+    llvm::Function *callee = module->getFunction(name);
+    if (!callee) {
+        reportError("Undefined function: " + name, call->lineNumber);
+        return;
+    }
+    requestFunctionBody(name);
+    std::vector<llvm::Value *> args;
+    if (!codegenCallArguments(call, callee, args)) {
+        return;
+    }
+    llvm::Value *handle = builder->CreateCall(callee, args, "gen");
+    clearTempMemory();
+
+    llvm::AllocaInst *loopVar = createEntryBlockAlloca(function, node->variable, elementTy);
+    fn->namedValues[node->variable] = loopVar;
+    fn->variableTypes[node->variable] = elementType;
+
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "forgen_cond", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "forgen_body");
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(*context, "after_forgen");
+
+    LoopContext loopCtx;
+    loopCtx.continueBlock = condBB;
+    loopCtx.breakBlock = afterBB;
+    fn->loopContextStack.push_back(loopCtx);
+    fn->activeGenerators.push_back(handle);
+
+    builder->CreateBr(condBB);
+    builder->SetInsertPoint(condBB);
+    createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_resume, {handle});
+    llvm::Value *done = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_done, {handle}, "done");
+    builder->CreateCondBr(done, afterBB, bodyBB);
+
+    function->insert(function->end(), bodyBB);
+    builder->SetInsertPoint(bodyBB);
+    llvm::Value *promise = createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_promise,
+                                          {handle, builder->getInt32(CodeGenConstants::GENERATOR_PROMISE_ALIGN),
+                                           builder->getFalse()}, "promise");
+    builder->CreateStore(builder->CreateLoad(elementTy, promise, "element"), loopVar);
+    codegenStmt(node->body.get());
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        clearTempMemory();
+        builder->CreateBr(condBB);
+    }
+
+    function->insert(function->end(), afterBB);
+    builder->SetInsertPoint(afterBB);
+    attachLoopHints(node->annotations, node->lineNumber, condBB);
+    createCoroCall(*builder, module.get(), llvm::Intrinsic::coro_destroy, {handle});
+    fn->activeGenerators.pop_back();
+    fn->loopContextStack.pop_back();
+
+    // 循环变量的作用域仅限于循环内
+    fn->namedValues.erase(node->variable);
+    fn->variableTypes.erase(node->variable);
+}
+
+// 运行协程 Pass（后端不运行优化管线，生成器必须在 IR 生成后立即降级）：
+// CoroEarly 降级 resume/destroy/done/promise；内联器按调用图后序处理 SCC，被迭代的生成器先被 CoroSplit 拆分，
+// 拆分后的 alwaysinline 入口再内联到调用方，CoroElide 把调用方中不会逃逸的协程帧改为栈上的局部变量；
+// CoroCleanup 移除剩余的协程内置函数。内联阈值为 0，其余函数基本保持不变
+bool CodeGenerator::lowerCoroutines() {
+    llvm::Function *coroBegin = module->getFunction("llvm.coro.begin");
+    if (!coroBegin) {
+        return true;
+    }
+    // 协程帧的布局（llvm.coro.size）依赖目标的数据布局
+    if (module->getDataLayout().isDefault() && !prepareTargetModule()) {
+        return false;
+    }
+    size_t generators = coroBegin->getNumUses();
+
+    llvm::LoopAnalysisManager loopAM;
+    llvm::FunctionAnalysisManager functionAM;
+    llvm::CGSCCAnalysisManager cgsccAM;
+    llvm::ModuleAnalysisManager moduleAM;
+    llvm::PassBuilder passBuilder;
+    passBuilder.registerModuleAnalyses(moduleAM);
+    passBuilder.registerCGSCCAnalyses(cgsccAM);
+    passBuilder.registerFunctionAnalyses(functionAM);
+    passBuilder.registerLoopAnalyses(loopAM);
+    passBuilder.crossRegisterProxies(loopAM, functionAM, cgsccAM, moduleAM);
+
+    llvm::ModulePassManager passes;
+    passes.addPass(llvm::CoroEarlyPass());
+    llvm::ModuleInlinerWrapperPass inliner(llvm::getInlineParams(0));
+    inliner.getPM().addPass(llvm::createCGSCCToFunctionPassAdaptor(llvm::CoroElidePass()));
+    inliner.getPM().addPass(llvm::CoroSplitPass());
+    passes.addPass(std::move(inliner));
+    passes.addPass(llvm::CoroCleanupPass());
+    passes.run(*module, moduleAM);
+
+    if (g_verbose) {
+        std::cout << "[IR Gen] Lowered " << generators << " generator(s) with LLVM coroutine passes" << std::endl;
+    }
+    return true;
+}
+
+// ============================================================================
+// SIMD 向量
+// ============================================================================
+// vec<T,N>（T 为 int 或 double，N 为 2 到 64 之间 2 的幂）是按值传递的定长向量，映射为 LLVM 的 <N x T>：
+// - + - * 逐元素运算，另一侧为标量时广播到所有元素；int 向量与 double 向量或 double 标量运算时提升为 double
+// - / 的结果为 double 向量，// 和 % 逐元素整除和取模；除数为 0 的元素结果为 0（double 为 NaN）并报告运行时错误
+// - == 和 != 比较整个向量，结果为 bool
+// - v[i] 读写单个元素：常量下标在编译时检查范围，变量下标在运行时检查
+// - vec<T,N>(a, i) 和 store(v, a, i) 读写数组 a 中下标 [i, i+N) 的元素（一次向量访存），越界时报告运行时错误。
+//   留在栈上的定长数组和全局数组的对齐提高到向量大小（最多 64 字节），下标为常量时按向量大小对齐访问，
+//   其余情况只保证元素对齐，由优化器根据下标推断更大的对齐
+// - sum、min、max 水平归约，dot(v, w) 为逐元素乘积之和
+// 向量宽于目标平台的向量寄存器时（例如 SSE2 上的 vec<double,8>），后端的类型合法化把它拆分为多个寄存器宽的操作，
+// 没有向量单元的目标逐元素展开，同一程序在各个目标上的结果相同；解释器同样逐元素执行。
+
+bool CodeGenerator::isVecType(const std::string &typeName) {
+    return typeName.rfind("vec<", 0) == 0;
+}
+
+bool CodeGenerator::isValidVecType(const std::string &typeName) {
+    if (!isVecType(typeName)) {
+        return false;
+    }
+    std::string elementType = vecElementType(typeName);
+    unsigned lanes = vecLaneCount(typeName);
+    return (elementType == "int" || elementType == "double") && lanes >= 2 && lanes <= 64 && (lanes & (lanes - 1)) == 0;
+}
+
+std::string CodeGenerator::vecElementType(const std::string &vecType) {
+    size_t comma = vecType.find(',');
+    return comma == std::string::npos ? "" : vecType.substr(4, comma - 4);
+}
+
+unsigned CodeGenerator::vecLaneCount(const std::string &vecType) {
+    size_t comma = vecType.find(',');
+    return comma == std::string::npos ? 0 : std::stoul(vecType.substr(comma + 1));
+}
+
+bool CodeGenerator::checkVecType(const std::string &typeName, int lineNumber) {
+    if (!isVecType(typeName) || isValidVecType(typeName)) {
+        return true;
+    }
+    reportError("Invalid vector type '" + typeName +
+                "': the element type must be int or double and the lane count a power of two from 2 to 64", lineNumber);
+    return false;
+}
+
+// vec<T,N>()：全 0；vec<T,N>(x)：标量广播，元素个数相同的向量逐元素转换；vec<T,N>(a, i)：从数组读取；
+// vec<T,N>(x0, ..., xN-1)：依次作为各元素
+llvm::Value *CodeGenerator::codegenVec(VecNode *node) {
+    std::string vecType = node->typeName();
+    if (!checkVecType(vecType, node->lineNumber)) {
+        return nullptr;
+    }
+    if (g_verbose) {
+        std::cout << "[IR Gen] Vector: " << vecType << " with " << node->arguments.size() << " argument(s)"
+                  << std::endl;
+    }
+    auto *vecTy = llvm::cast<llvm::FixedVectorType>(getType(vecType));
+    size_t count = node->arguments.size();
+    if (count == 0) {
+        return llvm::Constant::getNullValue(vecTy);
+    }
+    if (count == 2 && isArrayOperand(node->arguments[0].get())) {
+        return codegenVecArrayAccess(vecType, node->arguments[0].get(), node->arguments[1].get(), vecTy, nullptr,
+                                     node->lineNumber);
+    }
+    if (count != 1 && count != vecTy->getNumElements()) {
+        reportError(vecType + "() expects 0, 1, 2 (array, index) or " + std::to_string(vecTy->getNumElements()) +
+                    " arguments but got " + std::to_string(count), node->lineNumber);
+        return nullptr;
+    }
+
+    llvm::Value *result = llvm::PoisonValue::get(vecTy);
+    for (size_t i = 0; i < count; i++) {
+        llvm::Value *value = codegenExpr(node->arguments[i].get());
+        if (!value) {
+            return nullptr;
+        }
+        llvm::Type *valueTy = value->getType();
+        bool scalar = valueTy->isIntegerTy() || valueTy->isDoubleTy();
+        if (!(count == 1 ? convertibleToVec(valueTy, vecTy) : scalar)) {
+            reportError(vecType + "() expects int or double values but got '" + typeNameOf(valueTy) + "'",
+                        node->lineNumber);
+            return nullptr;
+        }
+        if (count == 1) {
+            return convertToVec(value, vecTy);
+        }
+        result = builder->CreateInsertElement(result, convertToType(value, vecTy->getElementType()), i, "vec");
+    }
+    return result;
+}
+
+// 转换为向量类型 vecTy（调用方已用 convertibleToVec 检查）：标量先转换为元素类型再广播，向量逐元素转换
+llvm::Value *CodeGenerator::convertToVec(llvm::Value *value, llvm::FixedVectorType *vecTy) {
+    llvm::Type *type = value->getType();
+    if (type == vecTy) {
+        return value;
+    }
+    if (type->isVectorTy()) {
+        return vecTy->getElementType()->isDoubleTy() ? builder->CreateSIToFP(value, vecTy, "vec_to_double")
+                                                     : builder->CreateFPToSI(value, vecTy, "vec_to_int");
+    }
+    if (type->isIntegerTy() && !type->isIntegerTy(32)) {
+        // bool 按 0/1，char 按有符号扩展
+        value = type->isIntegerTy(1) ? builder->CreateZExt(value, builder->getInt32Ty(), "bool_to_int")
+                                     : builder->CreateSExtOrTrunc(value, builder->getInt32Ty(), "to_int");
+    }
+    return builder->CreateVectorSplat(vecTy->getNumElements(), convertToType(value, vecTy->getElementType()),
+                                      "splat");
+}
+
+llvm::Value *CodeGenerator::codegenVecBinaryOp(const std::string &op, llvm::Value *left, llvm::Value *right,
+                                               int lineNumber) {
+    llvm::Type *doubleTy = builder->getDoubleTy();
+    auto *vecTy = llvm::cast<llvm::FixedVectorType>(left->getType()->isVectorTy() ? left->getType()
+                                                                                   : right->getType());
+    unsigned lanes = vecTy->getNumElements();
+
+    if (left->getType()->isVectorTy() && right->getType()->isVectorTy()) {
+        // 两侧都是向量：元素个数必须相同，int 与 double 混合时提升为 double
+        if (left->getType() != right->getType()) {
+            if (llvm::cast<llvm::FixedVectorType>(right->getType())->getNumElements() != lanes) {
+                reportError("Vector type mismatch: '" + typeNameOf(left->getType()) + "' and '" +
+                            typeNameOf(right->getType()) + "'", lineNumber);
+                return nullptr;
+            }
+            vecTy = llvm::FixedVectorType::get(doubleTy, lanes);
+            left = convertToVec(left, vecTy);
+            right = convertToVec(right, vecTy);
+        }
+    } else {
+        // 一侧为标量：double 标量使 int 向量提升为 double，然后广播
+        llvm::Value *&vector = left->getType()->isVectorTy() ? left : right;
+        llvm::Value *&scalar = left->getType()->isVectorTy() ? right : left;
+        if (!convertibleToVec(scalar->getType(), vecTy)) {
+            reportError("Operator '" + op + "' cannot combine '" + typeNameOf(vecTy) + "' and '" +
+                        typeNameOf(scalar->getType()) + "'", lineNumber);
+            return nullptr;
+        }
+        if (scalar->getType()->isDoubleTy() && !vecTy->getElementType()->isDoubleTy()) {
+            vecTy = llvm::FixedVectorType::get(doubleTy, lanes);
+            vector = convertToVec(vector, vecTy);
+        }
+        scalar = convertToVec(scalar, vecTy);
+    }
+
+    bool isFloat = vecTy->getElementType()->isDoubleTy();
+    if (op == "+")
+        return isFloat ? builder->CreateFAdd(left, right, "addtmp") : builder->CreateAdd(left, right, "addtmp");
+    if (op == "-")
+        return isFloat ? builder->CreateFSub(left, right, "subtmp") : builder->CreateSub(left, right, "subtmp");
+    if (op == "*")
+        return isFloat ? builder->CreateFMul(left, right, "multmp") : builder->CreateMul(left, right, "multmp");
+
+    if (op == "/" || op == "//" || op == "%") {
+        // / 的结果总是 double 向量，// 总是 int 向量，% 保持元素类型
+        if (op != "%") {
+            isFloat = op == "/";
+            vecTy = llvm::FixedVectorType::get(isFloat ? doubleTy : builder->getInt32Ty(), lanes);
+            left = convertToVec(left, vecTy);
+            right = convertToVec(right, vecTy);
+        }
+        std::string kind = op == "/" ? "Division" : op == "//" ? "Integer division" : "Modulo";
+        auto *constDivisor = llvm::dyn_cast<llvm::Constant>(right);
+        if (constDivisor && constDivisor->isNullValue()) {
+            reportError(kind + " by zero (divisor is constant " + (isFloat ? "0.0" : "0") + ")", lineNumber);
+            return nullptr;
+        }
+        if (omitRuntimeCheck()) {
+            if (isFloat) {
+                return op == "%" ? builder->CreateFRem(left, right, "mod_result")
+                                 : builder->CreateFDiv(left, right, "div_result");
+            }
+            return op == "%" ? builder->CreateSRem(left, right, "mod_result")
+                             : builder->CreateSDiv(left, right, "div_result");
+        }
+
+        // 任一元素为 0 时报告运行时错误；这些元素的结果为 0（double 为 NaN），其余元素正常计算
+        llvm::Value *zero = llvm::Constant::getNullValue(vecTy);
+        llvm::Value *isZero = isFloat ? builder->CreateFCmpOEQ(right, zero, "is_zero")
+                                      : builder->CreateICmpEQ(right, zero, "is_zero");
+        llvm::Function *function = builder->GetInsertBlock()->getParent();
+        llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "div_error", function);
+        llvm::BasicBlock *computeBB = llvm::BasicBlock::Create(*context, "div_compute", function);
+        builder->CreateCondBr(builder->CreateOrReduce(isZero), errorBB, computeBB);
+
+        builder->SetInsertPoint(errorBB);
+        builder->CreateCall(getPrintfFunction(),
+                            {builder->CreateGlobalString("Runtime Error: " + kind + " by zero\n", "", 0, module.get())});
+        builder->CreateBr(computeBB);
+
+        builder->SetInsertPoint(computeBB);
+        if (isFloat) {
+            llvm::Value *result = op == "%" ? builder->CreateFRem(left, right, "mod_result")
+                                            : builder->CreateFDiv(left, right, "div_result");
+            return builder->CreateSelect(isZero, llvm::ConstantFP::getNaN(vecTy), result, "div_phi");
+        }
+        // 为 0 的除数换成 1，避免整数除零
+        llvm::Value *divisor = builder->CreateSelect(isZero, llvm::ConstantInt::get(vecTy, 1), right, "divisor");
+        llvm::Value *result = op == "%" ? builder->CreateSRem(left, divisor, "mod_result")
+                                        : builder->CreateSDiv(left, divisor, "div_result");
+        return builder->CreateSelect(isZero, zero, result, "div_phi");
+    }
+
+    if (op == "==" || op == "!=") {
+        // 所有元素都相等时两个向量相等
+        llvm::Value *equal = isFloat ? builder->CreateFCmpOEQ(left, right, "lane_eq")
+                                     : builder->CreateICmpEQ(left, right, "lane_eq");
+        llvm::Value *allEqual = builder->CreateAndReduce(equal);
+        return op == "==" ? allEqual : builder->CreateNot(allEqual, "netmp");
+    }
+
+    reportError("Operator '" + op + "' is not supported for vector type '" + typeNameOf(vecTy) + "'", lineNumber);
+    return nullptr;
+}
+
+// v = w、v op= w：右侧可以是标量（广播）或元素个数相同的向量（逐元素转换）
+void CodeGenerator::codegenVecAssign(AssignmentNode *node, llvm::Value *storage, llvm::FixedVectorType *vecTy) {
+    llvm::Value *value = codegenExpr(node->value.get());
+    if (!value) {
+        reportError("Invalid assignment value for variable '" + static_cast<IdentifierNode *>(node->target.get())->name +
+                    "'", node->lineNumber);
+        return;
+    }
+    if (node->op != "=") {
+        llvm::Value *oldVal = builder->CreateLoad(vecTy, storage, "oldval");
+        value = codegenVecBinaryOp(node->op.substr(0, node->op.size() - 1), oldVal, value, node->lineNumber);
+        if (!value) {
+            return;
+        }
+    }
+    if (!convertibleToVec(value->getType(), vecTy)) {
+        reportError("Type mismatch: cannot assign '" + typeNameOf(value->getType()) + "' to '" + typeNameOf(vecTy) +
+                    "'", node->lineNumber);
+        return;
+    }
+    builder->CreateStore(convertToVec(value, vecTy), storage);
+}
+
+llvm::Value *CodeGenerator::vecStoragePtr(ExprNode *node) {
+    auto ident = dynamic_cast<IdentifierNode *>(node);
+    if (!ident || !isVecType(declaredTypeOf(node))) {
+        return nullptr;
+    }
+    fn->usedVariables.insert(ident->name);
+    auto local = fn->namedValues.find(ident->name);
+    if (local != fn->namedValues.end() && local->second) {
+        return local->second;
+    }
+    auto global = globalValues.find(ident->name);
+    return global != globalValues.end() ? global->second : nullptr;
+}
+
+// v[i]：常量下标在编译时检查范围后直接取出元素；变量下标在运行时检查范围（越界时报告错误并返回 0），
+// 从向量变量的存储位置按元素读取（其他向量表达式先存到栈上）
+llvm::Value *CodeGenerator::codegenVecLane(ArrayAccessNode *node) {
+    llvm::Value *storage = vecStoragePtr(node->array.get());
+    llvm::Value *vector = nullptr;
+    llvm::FixedVectorType *vecTy = nullptr;
+    if (storage) {
+        vecTy = llvm::cast<llvm::FixedVectorType>(getType(declaredTypeOf(node->array.get())));
+    } else {
+        vector = codegenExpr(node->array.get());
+        if (!vector) {
+            return nullptr;
+        }
+        vecTy = llvm::cast<llvm::FixedVectorType>(vector->getType());
+    }
+    llvm::Value *index = codegenExpr(node->index.get());
+    if (!index) {
+        return nullptr;
+    }
+    if (!index->getType()->isIntegerTy()) {
+        reportError("Array index must be integer type", node->lineNumber);
+        return nullptr;
+    }
+
+    if (auto *constIndex = llvm::dyn_cast<llvm::ConstantInt>(index)) {
+        int64_t lane = constIndex->getSExtValue();
+        if (lane < 0 || lane >= static_cast<int64_t>(vecTy->getNumElements())) {
+            reportError("Vector lane index " + std::to_string(lane) + " is out of range for '" + typeNameOf(vecTy) +
+                        "'", node->lineNumber);
+            return nullptr;
+        }
+        if (!vector) {
+            vector = builder->CreateLoad(vecTy, storage, "vec");
+        }
+        return builder->CreateExtractElement(vector, static_cast<uint64_t>(lane), "lane");
+    }
+
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    if (!storage) {
+        storage = createEntryBlockAlloca(function, "vec_tmp", vecTy);
+        builder->CreateStore(vector, storage);
+    }
+    llvm::Type *elementTy = vecTy->getElementType();
+    llvm::Value *index64 = builder->CreateSExtOrTrunc(index, builder->getInt64Ty(), "index64");
+    llvm::BasicBlock *accessBB = llvm::BasicBlock::Create(*context, "lane_access", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "bounds_error", function);
+    llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*context, "bounds_merge", function);
+    llvm::Value *inBounds = omitRuntimeCheck() ? builder->getTrue()
+                                               : builder->CreateICmpULT(index64, builder->getInt64(vecTy->getNumElements()),
+                                                                        "in_bounds");
+    builder->CreateCondBr(inBounds, accessBB, errorBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateCall(getPrintfFunction(), {builder->CreateGlobalString(
+                                                 "Runtime Error: Array index out of bounds\n", "", 0, module.get())});
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(accessBB);
+    llvm::Value *ptr = builder->CreateInBoundsGEP(elementTy, storage, index64, "lane_ptr");
+    llvm::Value *loaded = builder->CreateLoad(elementTy, ptr, "lane");
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(mergeBB);
+    llvm::PHINode *phi = builder->CreatePHI(elementTy, 2, "lane_result");
+    phi->addIncoming(loaded, accessBB);
+    phi->addIncoming(llvm::Constant::getNullValue(elementTy), errorBB);
+    return phi;
+}
+
+// v[i] = x、v[i] op= x：向量必须是变量，越界时报告运行时错误，不写入
+void CodeGenerator::codegenVecLaneSet(AssignmentNode *node, ArrayAccessNode *target) {
+    auto ident = dynamic_cast<IdentifierNode *>(target->array.get());
+    llvm::Value *storage = vecStoragePtr(target->array.get());
+    if (!storage) {
+        reportError("Vector lane assignment target must be a variable", node->lineNumber);
+        return;
+    }
+    auto *global = llvm::dyn_cast<llvm::GlobalVariable>(storage);
+    if (fn->localConstVariables.count(ident->name) || (global && global->isConstant())) {
+        reportError("Cannot reassign constant '" + ident->name + "'", node->lineNumber);
+        return;
+    }
+    auto *vecTy = llvm::cast<llvm::FixedVectorType>(getType(declaredTypeOf(ident)));
+    llvm::Type *elementTy = vecTy->getElementType();
+
+    llvm::Value *index = codegenExpr(target->index.get());
+    llvm::Value *value = index ? codegenExpr(node->value.get()) : nullptr;
+    if (!value) {
+        reportError("Invalid assignment value for array element", node->lineNumber);
+        return;
+    }
+    if (!index->getType()->isIntegerTy()) {
+        reportError("Array index must be integer type", node->lineNumber);
+        return;
+    }
+    if (!(value->getType()->isIntegerTy() || value->getType()->isDoubleTy())) {
+        reportError("Type mismatch: cannot assign '" + typeNameOf(value->getType()) + "' to '" +
+                    typeNameOf(elementTy) + "'", node->lineNumber);
+        return;
+    }
+
+    // 常量下标在编译时检查范围，变量下标在运行时检查
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *errorBB = nullptr;
+    llvm::BasicBlock *doneBB = nullptr;
+    if (auto *constIndex = llvm::dyn_cast<llvm::ConstantInt>(index)) {
+        int64_t lane = constIndex->getSExtValue();
+        if (lane < 0 || lane >= static_cast<int64_t>(vecTy->getNumElements())) {
+            reportError("Vector lane index " + std::to_string(lane) + " is out of range for '" + typeNameOf(vecTy) +
+                        "'", node->lineNumber);
+            return;
+        }
+    } else {
+        llvm::BasicBlock *accessBB = llvm::BasicBlock::Create(*context, "lane_access", function);
+        errorBB = llvm::BasicBlock::Create(*context, "bounds_error", function);
+        doneBB = llvm::BasicBlock::Create(*context, "lane_store_done", function);
+        index = builder->CreateSExtOrTrunc(index, builder->getInt64Ty(), "index64");
+        llvm::Value *inBounds = omitRuntimeCheck() ? builder->getTrue()
+                                                   : builder->CreateICmpULT(index, builder->getInt64(vecTy->getNumElements()),
+                                                                            "in_bounds");
+        builder->CreateCondBr(inBounds, accessBB, errorBB);
+        builder->SetInsertPoint(errorBB);
+        builder->CreateCall(getPrintfFunction(), {builder->CreateGlobalString(
+                                                     "Runtime Error: Array index out of bounds\n", "", 0, module.get())});
+        builder->CreateBr(doneBB);
+        builder->SetInsertPoint(accessBB);
+    }
+    llvm::Value *ptr = builder->CreateInBoundsGEP(elementTy, storage, index, "lane_ptr");
+    if (node->op != "=") {
+        llvm::Value *oldVal = builder->CreateLoad(elementTy, ptr, "oldval");
+        value = applyCompoundAssign(node->op, oldVal, value);
+    }
+    builder->CreateStore(convertToType(value, elementTy), ptr);
+    if (doneBB) {
+        builder->CreateBr(doneBB);
+        builder->SetInsertPoint(doneBB);
+    }
+}
+
+bool CodeGenerator::isArrayOperand(ExprNode *node) {
+    if (isListType(declaredTypeOf(node))) {
+        return true;
+    }
+    auto ident = dynamic_cast<IdentifierNode *>(node);
+    if (!ident) {
+        return false;
+    }
+    if (fn->constArrays.count(ident->name)) {
+        return true;
+    }
+    auto local = fn->namedValues.find(ident->name);
+    if (local != fn->namedValues.end()) {
+        return local->second && local->second->getAllocatedType()->isArrayTy();
+    }
+    auto global = globalValues.find(ident->name);
+    return global != globalValues.end() && global->second->getValueType()->isArrayTy();
+}
+
+// 读取（value 为空）或写入数组中下标 [i, i+N) 的元素：越界时报告运行时错误，读取返回全 0 向量，写入不执行
+llvm::Value *CodeGenerator::codegenVecArrayAccess(const std::string &name, ExprNode *array, ExprNode *indexExpr,
+                                                  llvm::FixedVectorType *vecTy, llvm::Value *value,
+                                                  int lineNumber) {
+    std::string elementType = typeNameOf(vecTy->getElementType());
+    ArrayOperand operand;
+    if (!codegenArrayOperand(array, operand)) {
+        reportError(name + "() expects an array as its " + (value ? "second" : "first") + " argument", lineNumber);
+        return nullptr;
+    }
+    if (operand.elementType != elementType) {
+        reportError("Vector element type '" + elementType + "' does not match array element type '" +
+                    (operand.elementType.empty() ? std::string("array") : operand.elementType) + "'", lineNumber);
+        return nullptr;
+    }
+    if (value && operand.isConst) {
+        reportError(name + "() cannot modify a constant array", lineNumber);
+        return nullptr;
+    }
+    llvm::Value *index = codegenExpr(indexExpr);
+    if (!index) {
+        return nullptr;
+    }
+    if (!index->getType()->isIntegerTy()) {
+        reportError("Array index must be integer type", lineNumber);
+        return nullptr;
+    }
+
+    // 长度不小于 N 时 0 <= i 且 i + N <= 长度 等价于 i <= 长度 - N（无符号比较同时排除负数）
+    llvm::Value *index64 = builder->CreateSExtOrTrunc(index, builder->getInt64Ty(), "index64");
+    llvm::Value *lanes = builder->getInt64(vecTy->getNumElements());
+    llvm::Value *inBounds = builder->CreateAnd(
+        builder->CreateICmpUGE(operand.count, lanes, "fits"),
+        builder->CreateICmpULE(index64, builder->CreateSub(operand.count, lanes), "index_fits"), "in_bounds");
+    if (omitRuntimeCheck()) {
+        inBounds = builder->getTrue();
+    }
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *accessBB = llvm::BasicBlock::Create(*context, "vec_access", function);
+    llvm::BasicBlock *errorBB = llvm::BasicBlock::Create(*context, "bounds_error", function);
+    llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*context, "bounds_merge", function);
+    builder->CreateCondBr(inBounds, accessBB, errorBB);
+
+    builder->SetInsertPoint(errorBB);
+    builder->CreateCall(getPrintfFunction(), {builder->CreateGlobalString(
+                                                 "Runtime Error: Array index out of bounds\n", "", 0, module.get())});
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(accessBB);
+    llvm::Value *ptr = builder->CreateInBoundsGEP(vecTy->getElementType(), operand.data, index64, "vec_ptr");
+    llvm::Align align = vecAccessAlign(operand, index64, vecTy);
+    llvm::Value *loaded = nullptr;
+    if (value) {
+        builder->CreateAlignedStore(value, ptr, align);
+    } else {
+        loaded = builder->CreateAlignedLoad(vecTy, ptr, align, "vec_load");
+    }
+    builder->CreateBr(mergeBB);
+
+    builder->SetInsertPoint(mergeBB);
+    if (value) {
+        return builder->getInt32(0);
+    }
+    llvm::PHINode *phi = builder->CreatePHI(vecTy, 2, "vec_result");
+    phi->addIncoming(loaded, accessBB);
+    phi->addIncoming(llvm::Constant::getNullValue(vecTy), errorBB);
+    return phi;
+}
+
+// 留在栈上的定长数组（不超过 stackArrayLimit，不会被改为堆分配）和本模块定义的全局数组提高到向量大小对齐；
+// 偏移为常量且是向量大小的整数倍时按向量大小访问，否则只保证元素对齐（动态数组的数据来自 malloc）
+llvm::Align CodeGenerator::vecAccessAlign(const ArrayOperand &operand, llvm::Value *index,
+                                          llvm::FixedVectorType *vecTy) {
+    const llvm::DataLayout &layout = module->getDataLayout();
+    uint64_t elementSize = layout.getTypeAllocSize(vecTy->getElementType());
+    uint64_t vectorSize = std::min<uint64_t>(elementSize * vecTy->getNumElements(), 64);
+    llvm::Align elementAlign = layout.getABITypeAlign(vecTy->getElementType());
+    llvm::Align vectorAlign(vectorSize);
+
+    llvm::Value *base = operand.list ? nullptr : operand.data->stripInBoundsConstantOffsets();
+    bool aligned = false;
+    if (auto *alloca = llvm::dyn_cast_or_null<llvm::AllocaInst>(base)) {
+        if (layout.getTypeAllocSize(alloca->getAllocatedType()) <= stackArrayLimit) {
+            alloca->setAlignment(std::max(alloca->getAlign(), vectorAlign));
+            aligned = true;
+        }
+    } else if (auto *global = llvm::dyn_cast_or_null<llvm::GlobalVariable>(base)) {
+        if (!global->isDeclaration()) {
+            global->setAlignment(std::max(global->getAlign().valueOrOne(), vectorAlign));
+            aligned = true;
+        }
+    }
+    auto *constIndex = llvm::dyn_cast<llvm::ConstantInt>(index);
+    if (aligned && constIndex && constIndex->getSExtValue() >= 0 &&
+        constIndex->getZExtValue() * elementSize % vectorSize == 0) {
+        return vectorAlign;
+    }
+    return elementAlign;
+}
+
+bool CodeGenerator::isSimdBuiltin(const std::string &name) {
+    return name == "store" || name == "sum" || name == "min" || name == "max" || name == "dot";
+}
+
+bool CodeGenerator::simdBuiltinCall(FunctionCallNode *node, ExprNode *&subject, size_t &firstArg) {
+    if (!isSimdBuiltin(node->functionName)) {
+        return false;
+    }
+    if (node->object) {
+        subject = node->object.get();
+        firstArg = 0;
+    } else {
+        if (functionPrototypes.count(node->functionName) || functions.count(node->functionName) ||
+            node->arguments.empty()) {
+            return false;
+        }
+        subject = node->arguments[0].get();
+        firstArg = 1;
+    }
+    return isVecType(declaredTypeOf(subject));
+}
+
+// sum、min、max、dot 返回元素类型，store 返回 int
+std::string CodeGenerator::simdBuiltinType(FunctionCallNode *node, ExprNode *subject) {
+    return node->functionName == "store" ? "int" : vecElementType(declaredTypeOf(subject));
+}
+
+llvm::Value *CodeGenerator::codegenSimdBuiltin(FunctionCallNode *node, ExprNode *subject, size_t firstArg) {
+    const std::string &name = node->functionName;
+    if (g_verbose) {
+        std::cout << "[IR Gen] Vector builtin: " << name << "()" << std::endl;
+    }
+    size_t argc = node->arguments.size() - firstArg;
+    size_t expected = name == "store" ? 2 : name == "dot" ? 1 : 0;
+    if (argc != expected) {
+        if (name == "store") {
+            reportError("store() expects 3 arguments (vector, array, index)", node->lineNumber);
+        } else {
+            reportError(name + "() expects " + std::to_string(expected + 1) + " argument(s) but got " +
+                        std::to_string(argc + 1), node->lineNumber);
+        }
+        return nullptr;
+    }
+    llvm::Value *vector = codegenExpr(subject);
+    if (!vector) {
+        return nullptr;
+    }
+    auto *vecTy = llvm::cast<llvm::FixedVectorType>(vector->getType());
+
+    if (name == "store") {
+        if (!isArrayOperand(node->arguments[firstArg].get())) {
+            reportError("store() expects an array as its second argument", node->lineNumber);
+            return nullptr;
+        }
+        return codegenVecArrayAccess(name, node->arguments[firstArg].get(), node->arguments[firstArg + 1].get(), vecTy,
+                                     vector, node->lineNumber);
+    }
+    if (name == "dot") {
+        llvm::Value *other = codegenExpr(node->arguments[firstArg].get());
+        if (!other) {
+            return nullptr;
+        }
+        if (other->getType() != vecTy) {
+            reportError("dot() expects two vectors of the same type but got '" + typeNameOf(vecTy) + "' and '" +
+                        typeNameOf(other->getType()) + "'", node->lineNumber);
+            return nullptr;
+        }
+        bool isFloat = vecTy->getElementType()->isDoubleTy();
+        vector = isFloat ? builder->CreateFMul(vector, other, "products") : builder->CreateMul(vector, other, "products");
+        return emitVectorReduce("sum", vector);
+    }
+    return emitVectorReduce(name, vector);
+}
+
+std::string CodeGenerator::formatVecLanes(llvm::Value *vector, const std::string &laneSpec,
+                                          std::vector<llvm::Value *> &args) {
+    unsigned lanes = llvm::cast<llvm::FixedVectorType>(vector->getType())->getNumElements();
+    std::string format = "[";
+    for (unsigned i = 0; i < lanes; i++) {
+        format += (i ? ", " : "") + laneSpec;
+        args.push_back(builder->CreateExtractElement(vector, static_cast<uint64_t>(i), "lane"));
+    }
+    return format + "]";
+}
+
+// ============================================================================
+// 循环优化提示
+// ============================================================================
+// while 和 for 之前可以写注解，作为这个循环的优化提示：
+// - @unroll(N) 展开 N 次（llvm.loop.unroll.count），不写参数时要求完全展开（llvm.loop.unroll.enable，
+//   迭代次数必须是常量），@unroll(1) 禁止展开（llvm.loop.unroll.disable）
+// - @vectorize 要求向量化（llvm.loop.vectorize.enable），@vectorize(W) 同时指定向量宽度（llvm.loop.vectorize.width）
+// - @nocheck 省略循环体中的数组越界检查和除零检查：条件改为常量，错误分支不可达，由后端删除；
+//   越界访问和除以 0 的行为未定义。嵌套在循环体中的循环同样不检查
+// 元数据附加在跳回循环头的跳转指令上，另带 !{"ppx.loop.line", i32 行号}，用于把优化报告对应到源代码。
+// 原生代码生成路径不运行优化管线，optimizeHintedLoops 只对含提示的函数运行一段小的循环管线，
+// 其中的向量化和展开只处理带提示的循环，再根据优化报告告诉用户每个提示是否生效；
+// -tiered 的 O2 管线直接使用这些元数据，解释器忽略注解。
+
+// 循环注解和函数注解（@fastmath）的检查
+bool CodeGenerator::checkAnnotations(const std::vector<Annotation> &annotations, bool onLoop) {
+    static const std::set<std::string> loopAnnotations = {"unroll", "vectorize", "nocheck"};
+    static const std::set<std::string> functionAnnotations = {"fastmath"};
+    bool valid = true;
+    std::set<std::string> seen;
+    for (const auto &annotation : annotations) {
+        if (!(onLoop ? loopAnnotations : functionAnnotations).count(annotation.name)) {
+            reportError(std::string("Unknown ") + (onLoop ? "loop" : "function") + " annotation '" +
+                        annotation.text() + "'", annotation.lineNumber);
+            valid = false;
+        } else if (!seen.insert(annotation.name).second) {
+            reportError("Duplicate annotation '@" + annotation.name + "'", annotation.lineNumber);
+            valid = false;
+        } else if ((annotation.name == "nocheck" || annotation.name == "fastmath") && annotation.hasArgument) {
+            reportError("Annotation '@" + annotation.name + "' does not take an argument", annotation.lineNumber);
+            valid = false;
+        } else if (annotation.name == "unroll" && annotation.hasArgument &&
+                   (annotation.argument < 1 || annotation.argument > 1024)) {
+            reportError("Unroll count must be between 1 and 1024, got " + std::to_string(annotation.argument),
+                        annotation.lineNumber);
+            valid = false;
+        } else if (annotation.name == "vectorize" && annotation.hasArgument &&
+                   (annotation.argument < 2 || annotation.argument > 64 ||
+                    (annotation.argument & (annotation.argument - 1)) != 0)) {
+            reportError("Vectorize width must be a power of two between 2 and 64, got " +
+                        std::to_string(annotation.argument), annotation.lineNumber);
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+bool CodeGenerator::omitRuntimeCheck() {
+    if (fn->noCheckDepth == 0) {
+        return false;
+    }
+    fn->omittedChecks++;
+    return true;
+}
+
+void CodeGenerator::codegenAnnotatedLoop(StmtNode *loop, const std::vector<Annotation> &annotations) {
+    bool noCheck = false;
+    if (checkAnnotations(annotations, true)) {
+        for (const auto &annotation : annotations) {
+            noCheck = noCheck || annotation.name == "nocheck";
+        }
+    }
+    if (g_verbose && !annotations.empty()) {
+        std::cout << "[IR Gen] Loop at line " << loop->lineNumber << " has " << annotations.size()
+                  << " annotation(s)" << std::endl;
+    }
+
+    unsigned omittedBefore = fn->omittedChecks;
+    if (noCheck) {
+        fn->noCheckDepth++;
+    }
+    if (auto *whileStmt = dynamic_cast<WhileStmtNode *>(loop)) {
+        codegenWhileStmt(whileStmt);
+    } else {
+        codegenForStmt(static_cast<ForStmtNode *>(loop));
+    }
+    if (noCheck) {
+        fn->noCheckDepth--;
+        reportRemark("Loop hint '@nocheck' applied: " + std::to_string(fn->omittedChecks - omittedBefore) +
+                     " runtime check(s) removed", loop->lineNumber);
+    }
+}
+
+void CodeGenerator::attachLoopHints(const std::vector<Annotation> &annotations, int line,
+                                    llvm::BasicBlock *header) {
+    std::vector<llvm::Metadata *> operands = {nullptr};
+    auto addProperty = [&](const char *name, llvm::Constant *value) {
+        std::vector<llvm::Metadata *> property = {llvm::MDString::get(*context, name)};
+        if (value) {
+            property.push_back(llvm::ConstantAsMetadata::get(value));
+        }
+        operands.push_back(llvm::MDNode::get(*context, property));
+    };
+    for (const auto &annotation : annotations) {
+        if (annotation.name == "unroll") {
+            if (!annotation.hasArgument) {
+                addProperty("llvm.loop.unroll.enable", nullptr);
+            } else if (annotation.argument == 1) {
+                addProperty("llvm.loop.unroll.disable", nullptr);
+            } else {
+                addProperty("llvm.loop.unroll.count", builder->getInt32(annotation.argument));
+            }
+        } else if (annotation.name == "vectorize") {
+            addProperty("llvm.loop.vectorize.enable", builder->getTrue());
+            if (annotation.hasArgument) {
+                addProperty("llvm.loop.vectorize.width", builder->getInt32(annotation.argument));
+            }
+        }
+    }
+    if (operands.size() == 1) {
+        return;
+    }
+    addProperty("ppx.loop.line", builder->getInt32(line));
+
+    // 循环标识是自引用的 distinct 节点
+    llvm::MDNode *loopID = llvm::MDNode::getDistinct(*context, operands);
+    loopID->replaceOperandWith(0, loopID);
+
+    // 回边：循环头之后跳回循环头的块（循环之前的块都排在循环头前面，循环之后的块此时还没有创建）
+    bool inLoop = false;
+    for (llvm::BasicBlock &block : *header->getParent()) {
+        inLoop = inLoop || &block == header;
+        llvm::Instruction *terminator = block.getTerminator();
+        if (!inLoop || !terminator) {
+            continue;
+        }
+        for (unsigned i = 0; i < terminator->getNumSuccessors(); i++) {
+            if (terminator->getSuccessor(i) == header) {
+                terminator->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+                break;
+            }
+        }
+    }
+}
+
+namespace {
+
+// 带提示的循环：请求的提示和优化报告
+struct HintedLoop {
+    std::string unrollHint;                                     // "@unroll(4)"，为空表示没有展开提示
+    std::string vectorizeHint;                                  // "@vectorize(8)"，为空表示没有向量化提示
+    std::string unrollResult, vectorizeResult;                  // 生效时优化器的说明
+    std::string unrollReason, vectorizeReason;                  // 未生效的原因
+    bool vectorizeAnalyzed = false;                             // vectorizeReason 是否来自具体的分析报告
+};
+
+// 循环标识中 ppx.loop.line 的行号（不是带提示的循环时为 0）
+int hintedLoopLine(llvm::MDNode *loopID) {
+    if (!loopID) {
+        return 0;
+    }
+    for (const llvm::MDOperand &operand : loopID->operands()) {
+        auto *property = llvm::dyn_cast_or_null<llvm::MDNode>(operand.get());
+        if (property && property->getNumOperands() == 2 && property != loopID) {
+            auto *name = llvm::dyn_cast<llvm::MDString>(property->getOperand(0));
+            if (name && name->getString() == "ppx.loop.line") {
+                return static_cast<int>(llvm::mdconst::extract<llvm::ConstantInt>(property->getOperand(1))->getZExtValue());
+            }
+        }
+    }
+    return 0;
+}
+
+// 从函数的 llvm.loop 元数据中收集带提示的循环，按行号索引
+std::map<int, HintedLoop> collectHintedLoops(llvm::Function &function) {
+    std::map<int, HintedLoop> loops;
+    for (llvm::BasicBlock &block : function) {
+        llvm::Instruction *terminator = block.getTerminator();
+        llvm::MDNode *loopID = terminator ? terminator->getMetadata(llvm::LLVMContext::MD_loop) : nullptr;
+        int line = hintedLoopLine(loopID);
+        if (line == 0 || loops.count(line)) {
+            continue;
+        }
+        HintedLoop &loop = loops[line];
+        for (const llvm::MDOperand &operand : loopID->operands()) {
+            auto *property = llvm::dyn_cast_or_null<llvm::MDNode>(operand.get());
+            if (!property || property == loopID) {
+                continue;
+            }
+            auto *name = llvm::dyn_cast<llvm::MDString>(property->getOperand(0));
+            std::string value = property->getNumOperands() > 1
+                ? std::to_string(llvm::mdconst::extract<llvm::ConstantInt>(property->getOperand(1))->getZExtValue())
+                : "";
+            if (!name) {
+                continue;
+            }
+            if (name->getString() == "llvm.loop.unroll.count") {
+                loop.unrollHint = "@unroll(" + value + ")";
+            } else if (name->getString() == "llvm.loop.unroll.enable") {
+                loop.unrollHint = "@unroll";
+            } else if (name->getString() == "llvm.loop.vectorize.width") {
+                loop.vectorizeHint = "@vectorize(" + value + ")";
+            } else if (name->getString() == "llvm.loop.vectorize.enable" && loop.vectorizeHint.empty()) {
+                loop.vectorizeHint = "@vectorize";
+            }
+        }
+    }
+    return loops;
+}
+
+// 记录各个块所属的带提示循环：报告的代码区域是循环头或出问题的指令所在的块，
+// 内层循环排在外层之后，覆盖外层的记录；向量化会创建新的循环，因此在向量化之后再记录一次
+struct LoopHintRecorder : llvm::PassInfoMixin<LoopHintRecorder> {
+    std::map<const llvm::BasicBlock *, int> *loopBlocks;
+
+    explicit LoopHintRecorder(std::map<const llvm::BasicBlock *, int> &loopBlocks) : loopBlocks(&loopBlocks) {}
+
+    llvm::PreservedAnalyses run(llvm::Function &function, llvm::FunctionAnalysisManager &analyses) {
+        llvm::LoopInfo &loopInfo = analyses.getResult<llvm::LoopAnalysis>(function);
+        for (llvm::Loop *loop : loopInfo.getLoopsInPreorder()) {
+            if (int line = hintedLoopLine(loop->getLoopID())) {
+                for (llvm::BasicBlock *block : loop->blocks()) {
+                    (*loopBlocks)[block] = line;
+                }
+            }
+        }
+        return llvm::PreservedAnalyses::all();
+    }
+};
+
+// 收集循环向量化和展开的优化报告
+struct LoopRemarkHandler : llvm::DiagnosticHandler {
+    std::map<const llvm::BasicBlock *, int> &loopBlocks;
+    std::map<int, HintedLoop> *loops = nullptr;
+
+    explicit LoopRemarkHandler(std::map<const llvm::BasicBlock *, int> &loopBlocks) : loopBlocks(loopBlocks) {}
+
+    static bool isLoopPass(llvm::StringRef passName) {
+        return passName == "loop-vectorize" || passName == "loop-unroll";
+    }
+    bool isAnalysisRemarkEnabled(llvm::StringRef passName) const override { return isLoopPass(passName); }
+    bool isMissedOptRemarkEnabled(llvm::StringRef passName) const override { return isLoopPass(passName); }
+    bool isPassedOptRemarkEnabled(llvm::StringRef passName) const override { return isLoopPass(passName); }
+    bool isAnyRemarkEnabled() const override { return true; }
+
+    bool handleDiagnostics(const llvm::DiagnosticInfo &info) override {
+        auto *remark = llvm::dyn_cast<llvm::DiagnosticInfoIROptimization>(&info);
+        if (!remark) {
+            return false;
+        }
+        // 强制向量化时，向量化器的分析报告使用 AlwaysPrint（空的 Pass 名）
+        llvm::StringRef passName(remark->getPassName());
+        bool unroll = passName == "loop-unroll";
+        if (!unroll && passName != "loop-vectorize" && passName != llvm::OptimizationRemarkAnalysis::AlwaysPrint) {
+            return true;
+        }
+        auto block = loopBlocks.find(llvm::dyn_cast_or_null<llvm::BasicBlock>(remark->getCodeRegion()));
+        if (block == loopBlocks.end() || !loops || !loops->count(block->second)) {
+            return true;
+        }
+        HintedLoop &loop = (*loops)[block->second];
+        std::string message = remark->getMsg();
+        const std::string prefix = "loop not vectorized: ";
+        if (message.rfind(prefix, 0) == 0) {
+            message = message.substr(prefix.size());
+        }
+
+        if (info.getKind() == llvm::DK_OptimizationRemark) {
+            std::string &result = unroll ? loop.unrollResult : loop.vectorizeResult;
+            if (result.empty()) {
+                result = message;
+            }
+        } else if (unroll) {
+            if (loop.unrollReason.empty()) {
+                loop.unrollReason = message;
+            }
+        } else if (info.getKind() == llvm::DK_OptimizationRemarkAnalysis && !loop.vectorizeAnalyzed) {
+            loop.vectorizeReason = message;
+            loop.vectorizeAnalyzed = true;
+        } else if (loop.vectorizeReason.empty()) {
+            loop.vectorizeReason = message;
+        }
+        return true;
+    }
+};
+
+// 报告一个提示是否生效：生效时输出优化报告（-Rpass），未生效时给出警告
+void reportLoopHint(const std::string &hint, const std::string &result, const std::string &reason, int line) {
+    if (hint.empty()) {
+        return;
+    }
+    if (!result.empty()) {
+        reportRemark("Loop hint '" + hint + "' applied: " + result, line);
+    } else {
+        reportWarning("Loop hint '" + hint + "' was not applied: " +
+                      (reason.empty() ? "the optimizer could not transform the loop" : reason), line);
+    }
+}
+
+} // namespace
+
+static std::unique_ptr<llvm::TargetMachine> createHostTargetMachine();
+
+// 只处理带提示的函数：SROA 把局部变量提升为寄存器，循环旋转和归纳变量化简把循环整理为标准形式，
+// 向量化和展开只变换带提示的循环（OnlyWhenForced），其余循环保持不变
+bool CodeGenerator::optimizeHintedLoops() {
+    std::vector<llvm::Function *> functions;
+    for (llvm::Function &function : *module) {
+        if (!function.isDeclaration() && !collectHintedLoops(function).empty()) {
+            functions.push_back(&function);
+        }
+    }
+    if (functions.empty()) {
+        return true;
+    }
+    // 向量化的代价模型依赖目标信息
+    if (module->getDataLayout().isDefault() && !prepareTargetModule()) {
+        return false;
+    }
+    auto targetMachine = createHostTargetMachine();
+    if (!targetMachine) {
+        return false;
+    }
+
+    llvm::LoopAnalysisManager loopAM;
+    llvm::FunctionAnalysisManager functionAM;
+    llvm::CGSCCAnalysisManager cgsccAM;
+    llvm::ModuleAnalysisManager moduleAM;
+    llvm::PassBuilder passBuilder(targetMachine.get());
+    passBuilder.registerModuleAnalyses(moduleAM);
+    passBuilder.registerCGSCCAnalyses(cgsccAM);
+    passBuilder.registerFunctionAnalyses(functionAM);
+    passBuilder.registerLoopAnalyses(loopAM);
+    passBuilder.crossRegisterProxies(loopAM, functionAM, cgsccAM, moduleAM);
+
+    std::map<const llvm::BasicBlock *, int> loopBlocks;
+    llvm::FunctionPassManager passes;
+    passes.addPass(llvm::SROAPass(llvm::SROAOptions::ModifyCFG));
+    passes.addPass(llvm::EarlyCSEPass(true));
+    passes.addPass(llvm::InstCombinePass());
+    passes.addPass(llvm::SimplifyCFGPass());
+    llvm::LoopPassManager loopPasses;
+    loopPasses.addPass(llvm::LoopRotatePass());
+    loopPasses.addPass(llvm::IndVarSimplifyPass());
+    passes.addPass(llvm::createFunctionToLoopPassAdaptor(std::move(loopPasses)));
+    passes.addPass(LoopHintRecorder(loopBlocks));
+    passes.addPass(llvm::LoopVectorizePass(llvm::LoopVectorizeOptions(true, true)));
+    passes.addPass(LoopHintRecorder(loopBlocks));
+    passes.addPass(llvm::LoopUnrollPass(llvm::LoopUnrollOptions(2, true, false)));
+    passes.addPass(llvm::InstCombinePass());
+    passes.addPass(llvm::SimplifyCFGPass());
+
+    auto handler = std::make_unique<LoopRemarkHandler>(loopBlocks);
+    LoopRemarkHandler *remarks = handler.get();
+    std::unique_ptr<llvm::DiagnosticHandler> previousHandler = context->getDiagnosticHandler();
+    context->setDiagnosticHandler(std::move(handler));
+
+    for (llvm::Function *function : functions) {
+        std::map<int, HintedLoop> loops = collectHintedLoops(*function);
+        loopBlocks.clear();
+        remarks->loops = &loops;
+        passes.run(*function, functionAM);
+        functionAM.clear(*function, function->getName());
+        for (auto &entry : loops) {
+            reportLoopHint(entry.second.vectorizeHint, entry.second.vectorizeResult, entry.second.vectorizeReason,
+                           entry.first);
+            reportLoopHint(entry.second.unrollHint, entry.second.unrollResult, entry.second.unrollReason,
+                           entry.first);
+        }
+    }
+    context->setDiagnosticHandler(std::move(previousHandler));
+
+    if (g_verbose) {
+        std::cout << "[IR Gen] Optimized hinted loops in " << functions.size() << " function(s)" << std::endl;
+    }
+    return true;
+}
+
+// ============================================================================
+// 浮点运算标志
+// ============================================================================
+// 默认的浮点运算严格遵循 IEEE 754：不重结合、不收缩为 FMA，pow 调用 C 库（可能设置 errno）。
+// - -ffp-contract=fast 为浮点运算加上 contract 标志，后端可以把相邻的乘法和加法合并为一条 FMA 指令
+// - -ffast-math 设置全部标志（reassoc、nnan、ninf、nsz、arcp、contract、afn）并隐含 -fno-math-errno，
+//   向量化器可以重排 double 的归约；函数声明之前的 @fastmath 只对这个函数设置全部标志，
+//   这个函数中的 pow 同样不设置 errno（afn 标志）
+// - -fno-math-errno 时 pow 生成 llvm.pow 内置函数，优化器把它当作没有副作用的运算
+//   （常量折叠，pow(x, 2.0) 化简为乘法，循环中的调用可以向量化）
+// 标志设置在 IRBuilder 上，生成的 fadd/fsub/fmul/fdiv/frem、浮点比较和数学内置函数调用都带有这些标志；
+// 结果可能与严格模式在最后几位不同，NaN 和无穷大参与运算时结果未定义。
+
+void CodeGenerator::setFastMath(bool enable) {
+    if (enable) {
+        fastMathFlags.setFast();
+    } else {
+        fastMathFlags.clear();
+    }
+    mathErrno = !enable;
+    builder->setFastMathFlags(fastMathFlags);
+}
+
+void CodeGenerator::setFPContractFast(bool enable) {
+    fastMathFlags.setAllowContract(enable);
+    builder->setFastMathFlags(fastMathFlags);
+}
+
+llvm::FastMathFlags CodeGenerator::functionFastMathFlags(FunctionDeclNode *node) {
+    llvm::FastMathFlags flags = fastMathFlags;
+    if (!checkAnnotations(node->annotations, false)) {
+        return flags;
+    }
+    for (const auto &annotation : node->annotations) {
+        if (annotation.name == "fastmath") {
+            flags.setFast();
+            if (g_verbose) {
+                std::cout << "[IR Gen] Fast-math enabled for function: " << node->name << std::endl;
+            }
+        }
+    }
+    return flags;
+}
+
+llvm::Value *CodeGenerator::codegenPow(llvm::Value *base, llvm::Value *exponent) {
+    // -fno-math-errno、-ffast-math 或当前函数的 @fastmath：使用没有副作用的内置函数
+    if (!mathErrno || builder->getFastMathFlags().approxFunc()) {
+        return builder->CreateBinaryIntrinsic(llvm::Intrinsic::pow, base, exponent, {}, "pow_result");
+    }
+    // 调用 C 标准库的 pow 函数
+    return builder->CreateCall(module->getFunction("pow"), {base, exponent}, "pow_result");
+}
+
+// 创建全局构造函数来初始化需要动态初始化的全局变量
+void CodeGenerator::createGlobalConstructor() {
+    // 如果没有需要动态初始化的全局变量，直接返回
+    if (globalInitializers.empty()) {
+        return;
+    }
+    
+    if (g_verbose) {
+        std::cout << "[IR Gen] Creating global constructor for " 
+                  << globalInitializers.size() << " dynamic initializers" << std::endl;
+    }
+    
+    // 创建全局构造函数类型: void ()
+    llvm::FunctionType *ctorType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(*context), false);
+    
+    // 创建全局构造函数
+    llvm::Function *ctor = llvm::Function::Create(
+        ctorType, llvm::Function::InternalLinkage,
+        "__global_init", module.get());
+    
+    // 创建基本块
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", ctor);
+    builder->SetInsertPoint(entryBB);
+    
+    // 全局构造函数使用独立的函数上下文
+    FunctionContext ctorContext;
+    ctorContext.function = ctor;
+    FunctionContext *savedContext = fn;
+    fn = &ctorContext;
+    
+    // 为每个需要动态初始化的全局变量生成初始化代码
+    for (const auto &init : globalInitializers) {
+        if (emitGlobalArrayInit(init)) {
+            clearTempMemory();
+            continue;
+        }
+        // 生成初始化表达式的代码
+        llvm::Value *initValue = codegenTypedExpr(init.initializer, init.typeName);
+
+        // 向量的初始值：标量广播，元素个数相同的向量逐元素转换
+        llvm::Type *valueType = init.variable->getValueType();
+        if (initValue && valueType->isVectorTy() && initValue->getType() != valueType) {
+            if (!convertibleToVec(initValue->getType(), valueType)) {
+                reportError("Type mismatch: cannot assign '" + typeNameOf(initValue->getType()) + "' to '" +
+                            init.typeName + "'", init.initializer->lineNumber);
+                initValue = nullptr;
+            } else {
+                initValue = convertToVec(initValue, llvm::cast<llvm::FixedVectorType>(valueType));
+            }
+        }
+        
+        if (initValue) {
+            // 存储到全局变量
+            initValue = copyBorrowedString(initValue, init.typeName);
+            if (isCountedType(init.typeName)) {
+                storeReference(init.variable, initValue, init.typeName);
+            } else {
+                builder->CreateStore(initValue, init.variable);
+            }
+            removeTempMemory(initValue);
+            
+            if (g_verbose) {
+                std::cout << "[IR Gen] Initialized global variable dynamically" << std::endl;
+            }
+        } else {
+            std::cerr << "Warning: Failed to generate initializer for global variable" 
+                      << std::endl;
+        }
+        
+        // 清理初始化过程中产生的临时内存
+        clearTempMemory();
+    }
+    
+    // 返回（初始化表达式的 for 循环等持有的动态数组和映射在返回前释放）
+    builder->CreateRetVoid();
+    releaseReferenceSlots(ctor);
+    moveLargeArraysToHeap(ctor);
+
+    // 恢复函数上下文
+    fn = savedContext;
+    
+    // 将全局构造函数注册到 llvm.global_ctors
+    // llvm.global_ctors 是一个特殊的全局数组，包含程序启动时要调用的函数
+    llvm::Type *i32Type = llvm::Type::getInt32Ty(*context);
+    llvm::PointerType *voidFuncPtrType = llvm::PointerType::get(*context, 0);
+    llvm::PointerType *i8PtrType = llvm::PointerType::get(*context, 0);
+    
+    // 结构体类型: { i32, void ()*, i8* }
+    llvm::StructType *ctorStructType = llvm::StructType::get(
+        i32Type, voidFuncPtrType, i8PtrType);
+    
+    // 创建构造函数数组元素: { 65535, @__global_init, null }
+    // 优先级 65535 表示在所有用户代码之前运行
+    llvm::Constant *ctorStruct = llvm::ConstantStruct::get(
+        ctorStructType,
+        llvm::ConstantInt::get(i32Type, 65535),  // 优先级
+        ctor,                                     // 构造函数指针
+        llvm::Constant::getNullValue(i8PtrType)  // 关联数据（null）
+    );
+    
+    // 创建全局数组: [@__global_init]
+    llvm::ArrayType *ctorArrayType = llvm::ArrayType::get(ctorStructType, 1);
+    llvm::Constant *ctorArray = llvm::ConstantArray::get(
+        ctorArrayType, {ctorStruct});
+    
+    // 创建 llvm.global_ctors 全局变量
+    new llvm::GlobalVariable(
+        *module,
+        ctorArrayType,
+        false,  // 不是常量
+        llvm::GlobalValue::AppendingLinkage,  // 使用 appending linkage
+        ctorArray,
+        "llvm.global_ctors"
+    );
+    
+    if (g_verbose) {
+        std::cout << "[IR Gen] Global constructor registered" << std::endl;
+    }
+}
+
+// 代码生成主入口
+bool CodeGenerator::generate(ProgramNode *root) {
+    if (!root)
+        return false;
+
+    // 第一遍：声明所有函数原型（重复定义留到下一遍报告）
+    for (auto &stmt : root->statements) {
+        if (auto funcDecl = dynamic_cast<FunctionDeclNode *>(stmt.get())) {
+            if (!module->getFunction(funcDecl->name)) {
+                declareFunction(funcDecl);
+            }
+        }
+    }
+
+    if (irThreads > 1) {
+        // 第二遍：串行处理 import 和全局变量等顶层语句，收集函数体
+        std::vector<FunctionDeclNode *> bodies;
+        for (auto &stmt : root->statements) {
+            if (auto funcDecl = dynamic_cast<FunctionDeclNode *>(stmt.get())) {
+                if (declareFunction(funcDecl)) {
+                    bodies.push_back(funcDecl);
+                }
+            } else {
+                codegenStmt(stmt.get());
+            }
+        }
+        // 第三遍：并行生成函数体
+        generateFunctionBodiesParallel(bodies);
+    } else {
+        for (auto &stmt : root->statements) {
+            codegenStmt(stmt.get());
+        }
+    }
+    
+    // 创建全局构造函数（如果有需要动态初始化的全局变量）
+    // 初始化表达式调用的模块函数也会加入工作表，因此在生成模块函数体之前创建
+    createGlobalConstructor();
+    
+    // 生成被调用到的导入模块函数体
+    generateRequestedFunctionBodies();
+    
+    // 检查是否存在main函数
+    if (!module->getFunction("main")) {
+        // 使用文件最后一行作为错误位置，便于显示代码上下文
+        int lastLine = static_cast<int>(currentDiagnostics().sourceLines.size());
+        reportError("No 'main' function defined - program needs an entry point", lastLine > 0 ? lastLine : 1);
+    }
+
+    // 检查是否有编译错误
+    if (hasErrors()) {
+        std::cerr << "\nLLVM IR generation failed with " << currentDiagnostics().errorCount << " error(s)";
+        if (currentDiagnostics().warningCount > 0) {
+            std::cerr << " and " << currentDiagnostics().warningCount << " warning(s)";
+        }
+        std::cerr << std::endl;
+        return false;
+    }
+
+    // 显示警告统计（如果有）
+    if (currentDiagnostics().warningCount > 0) {
+        std::cerr << "LLVM IR generated with " << currentDiagnostics().warningCount << " warning(s)" << std::endl;
+    }
+
+    std::string errorStr;
+    llvm::raw_string_ostream errorStream(errorStr);
+    if (llvm::verifyModule(*module, &errorStream)) {
+        std::cerr << "Module verification failed:" << std::endl
+                  << errorStr << std::endl;
+        return false;
+    }
+
+    return lowerCoroutines();
+}
+
+// 交互式增量生成
+// 本生成器的模块只保存之前各段输入定义的函数和全局变量的外部声明；
+// 每段输入由镜像这些声明的新生成器在独立的 LLVMContext 中生成，可以直接交给 JIT，
+// 之前的定义通过 JIT 的符号查找引用，不会重新编译
+bool CodeGenerator::generateIncrement(ProgramNode *chunk, const std::string &entryName,
+                                      std::unique_ptr<llvm::LLVMContext> &outContext,
+                                      std::unique_ptr<llvm::Module> &outModule) {
+    resetErrorCounts();
+    CodeGenerator part(*this, ++incrementCount);
+
+    // 顶层的非声明语句按顺序生成到入口函数中
+    llvm::Function *entry = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(*part.context), false),
+        llvm::Function::ExternalLinkage, entryName, part.module.get());
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*part.context, "entry", entry);
+    part.builder->SetInsertPoint(entryBB);
+    FunctionContext entryContext;
+    entryContext.function = entry;
+
+    // 本段内的函数可以互相调用，先声明原型
+    for (auto &stmt : chunk->statements) {
+        if (auto funcDecl = dynamic_cast<FunctionDeclNode *>(stmt.get())) {
+            if (!part.module->getFunction(funcDecl->name)) {
+                part.declareFunction(funcDecl);
+            }
+        }
+    }
+
+    size_t initialized = 0;
+    for (auto &stmt : chunk->statements) {
+        bool topLevel = dynamic_cast<FunctionDeclNode *>(stmt.get()) ||
+                        dynamic_cast<VarDeclNode *>(stmt.get()) ||
+                        dynamic_cast<ImportNode *>(stmt.get());
+        if (!topLevel) {
+            part.fn = &entryContext;
+            part.codegenStmt(stmt.get());
+            continue;
+        }
+
+        // 函数、全局变量和 import 在顶层上下文中生成
+        llvm::BasicBlock *insertBlock = part.builder->GetInsertBlock();
+        part.fn = &part.topLevelContext;
+        part.codegenStmt(stmt.get());
+        part.fn = &entryContext;
+        part.builder->SetInsertPoint(insertBlock);
+
+        // 需要动态初始化的全局变量在入口函数中按语句顺序初始化
+        for (; initialized < part.globalInitializers.size(); initialized++) {
+            const auto &init = part.globalInitializers[initialized];
+            if (part.emitGlobalArrayInit(init)) {
+                part.clearTempMemory();
+                continue;
+            }
+            llvm::Value *initValue = part.codegenTypedExpr(init.initializer, init.typeName);
+            if (initValue) {
+                initValue = part.copyBorrowedString(initValue, init.typeName);
+                if (isCountedType(init.typeName)) {
+                    part.storeReference(init.variable, initValue, init.typeName);
+                } else {
+                    part.builder->CreateStore(initValue, init.variable);
+                }
+                part.removeTempMemory(initValue);
+            }
+            part.clearTempMemory();
+        }
+    }
+    part.fn = &entryContext;
+    part.clearTempMemory();
+    if (!part.builder->GetInsertBlock()->getTerminator()) {
+        part.builder->CreateRetVoid();
+    }
+    part.releaseReferenceSlots(entry);
+    part.moveLargeArraysToHeap(entry);
+
+    // 导入的模块函数之后的输入也可能调用，全部生成函数体并保留在符号表中
+    auto functionTable = part.functions;
+    auto prototypeTable = part.functionPrototypes;
+    auto moduleFunctionTable = part.moduleFunctions;
+    for (const auto &entry : part.lazyFunctionBodies) {
+        part.lazyFunctionWorklist.push_back(entry.first);
+    }
+    part.generateRequestedFunctionBodies();
+    part.functions = functionTable;
+    part.functionPrototypes = prototypeTable;
+    part.moduleFunctions = moduleFunctionTable;
+
+    if (hasErrors()) {
+        if (currentDiagnostics().printDiagnostics) {
+            std::cerr << "Evaluation failed with " << currentDiagnostics().errorCount << " error(s)" << std::endl;
+        }
+        return false;
+    }
+
+    // 全局变量在之后的模块中以外部声明引用
+    for (auto &global : part.module->globals()) {
+        if (global.hasInternalLinkage() && global.hasName()) {
+            global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        }
+    }
+
+    std::string errorStr;
+    llvm::raw_string_ostream errorStream(errorStr);
+    if (llvm::verifyModule(*part.module, &errorStream)) {
+        std::cerr << "Module verification failed:" << std::endl
+                  << errorStr << std::endl;
+        return false;
+    }
+    if (!part.lowerCoroutines()) {
+        return false;
+    }
+
+    adoptDefinitions(part);
+    outContext = std::move(part.context);
+    outModule = std::move(part.module);
+    return true;
+}
+
+// 将增量模块中新定义的函数和全局变量以外部声明加入本模块，并更新符号表
+void CodeGenerator::adoptDefinitions(CodeGenerator &part) {
+    auto declareGlobal = [this](llvm::GlobalVariable *global) {
+        llvm::GlobalVariable *decl = module->getNamedGlobal(global->getName());
+        if (!decl) {
+            decl = new llvm::GlobalVariable(
+                *module, translateType(global->getValueType(), *context), global->isConstant(),
+                llvm::GlobalValue::ExternalLinkage, nullptr, global->getName());
+        }
+        return decl;
+    };
+    auto declareFunction = [this](llvm::Function *function) {
+        llvm::Function *decl = module->getFunction(function->getName());
+        if (!decl) {
+            decl = llvm::Function::Create(
+                llvm::cast<llvm::FunctionType>(translateType(function->getFunctionType(), *context)),
+                llvm::Function::ExternalLinkage, function->getName(), module.get());
+        }
+        return decl;
+    };
+
+    for (const auto &entry : part.globalValues) {
+        if (!globalValues.count(entry.first)) {
+            globalValues[entry.first] = declareGlobal(entry.second);
+        }
+    }
+    globalTypes.insert(part.globalTypes.begin(), part.globalTypes.end());
+    for (const auto &entry : part.functions) {
+        if (!functions.count(entry.first)) {
+            functions[entry.first] = declareFunction(entry.second);
+            functionPrototypes[entry.first] = part.functionPrototypes[entry.first];
+        }
+    }
+
+    // 导入的模块
+    loadedModules.insert(part.loadedModules.begin(), part.loadedModules.end());
+    moduleAliases.insert(part.moduleAliases.begin(), part.moduleAliases.end());
+    moduleASTs.insert(moduleASTs.end(), part.moduleASTs.begin(), part.moduleASTs.end());
+    for (const auto &moduleEntry : part.moduleFunctions) {
+        for (const auto &entry : moduleEntry.second) {
+            moduleFunctions[moduleEntry.first][entry.first] = declareFunction(entry.second);
+        }
+    }
+    for (const auto &moduleEntry : part.moduleGlobals) {
+        for (const auto &entry : moduleEntry.second) {
+            moduleGlobals[moduleEntry.first][entry.first] = declareGlobal(entry.second);
+        }
+    }
+}
+
+// 并行生成函数体
+// 每个工作线程使用独立的 LLVMContext/Module，完成后以 bitcode 载入主上下文并由 llvm::Linker 合并
+void CodeGenerator::generateFunctionBodiesParallel(const std::vector<FunctionDeclNode *> &nodes) {
+    unsigned threadCount = std::min<unsigned>(irThreads, nodes.size());
+    if (threadCount <= 1) {
+        for (auto *node : nodes) {
+            codegenFunctionBody(node, module->getFunction(node->name));
+        }
+        return;
+    }
+
+    if (g_verbose) {
+        std::cout << "[IR Gen] Generating " << nodes.size() << " function bodies on "
+                  << threadCount << " threads" << std::endl;
+    }
+
+    // 工作模块以外部声明引用全局变量，合并期间把内部链接的全局变量临时提升为外部链接
+    std::vector<llvm::GlobalVariable *> promotedGlobals;
+    for (auto &global : module->globals()) {
+        if (global.hasInternalLinkage() && global.hasName()) {
+            global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+            promotedGlobals.push_back(&global);
+        }
+    }
+
+    // 按源码顺序轮流分配函数体；工作生成器在主线程中创建
+    std::vector<std::vector<FunctionDeclNode *>> partitions(threadCount);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        partitions[i % threadCount].push_back(nodes[i]);
+    }
+    std::vector<std::unique_ptr<CodeGenerator>> workers;
+    for (unsigned i = 0; i < threadCount; i++) {
+        workers.emplace_back(new CodeGenerator(*this, i));
+    }
+
+    // 工作线程沿用本线程的诊断状态和日志设置
+    DiagnosticState &diagnostics = currentDiagnostics();
+    bool verbose = g_verbose;
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back([&workers, &partitions, &diagnostics, verbose, i]() {
+            DiagnosticScope scope(diagnostics, verbose);
+            CodeGenerator &worker = *workers[i];
+            for (auto *node : partitions[i]) {
+                worker.codegenFunctionBody(node, worker.module->getFunction(node->name));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // 工作线程中解析到的模块函数交由主生成器延迟生成
+    for (auto &worker : workers) {
+        for (const auto &funcName : worker->lazyFunctionWorklist) {
+            requestFunctionBody(funcName);
+        }
+    }
+
+    // 合并工作模块
+    for (unsigned i = 0; i < threadCount; i++) {
+        llvm::SmallVector<char, 0> bitcode;
+        llvm::raw_svector_ostream stream(bitcode);
+        llvm::WriteBitcodeToFile(*workers[i]->module, stream);
+
+        llvm::MemoryBufferRef bufferRef(llvm::StringRef(bitcode.data(), bitcode.size()),
+                                        workers[i]->module->getName());
+        auto part = llvm::parseBitcodeFile(bufferRef, *context);
+        if (!part) {
+            reportError("Failed to load parallel IR part: " + llvm::toString(part.takeError()), 0);
+            continue;
+        }
+        if (llvm::Linker::linkModules(*module, std::move(*part))) {
+            reportError("Failed to link parallel IR part '" + workers[i]->module->getName().str() + "'", 0);
+        }
+    }
+    workers.clear();
+
+    // 链接器会用带函数体的定义替换主模块中的原型，刷新函数符号表
+    for (auto &entry : functions) {
+        entry.second = module->getFunction(entry.first);
+    }
+    for (auto &moduleEntry : moduleFunctions) {
+        for (auto &entry : moduleEntry.second) {
+            entry.second = module->getFunction(entry.first);
+        }
+    }
+    for (auto *global : promotedGlobals) {
+        global->setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+
+    if (g_verbose) {
+        std::cout << "[IR Gen] Linked " << threadCount << " parallel IR parts" << std::endl;
+    }
+}
+
+// 输出接口
+
+void CodeGenerator::printIR() { module->print(llvm::outs(), nullptr); }
 
 bool CodeGenerator::writeIRToFile(const std::string &filename) {
     std::error_code EC;
@@ -4153,48 +13614,33 @@ bool CodeGenerator::writeIRToFile(const std::string &filename) {
     return true;
 }
 
-bool CodeGenerator::compileToObjectFile(const std::string &filename) {
-    // 初始化所有目标
-    llvm::InitializeAllTargetInfos();
-    llvm::InitializeAllTargets();
-    llvm::InitializeAllTargetMCs();
-    llvm::InitializeAllAsmParsers();
-    llvm::InitializeAllAsmPrinters();
-    
-    // 获取目标三元组
-    llvm::Triple targetTriple(llvm::sys::getDefaultTargetTriple());
-    module->setTargetTriple(targetTriple);
-    
-    if (g_verbose) {
-        std::cout << "[CodeGen] Target triple: " << targetTriple.str() << std::endl;
-    }
-    
-    // 查找目标
+// 为宿主平台创建 TargetMachine（每个代码生成线程使用独立的实例）
+static std::unique_ptr<llvm::TargetMachine> createHostTargetMachine() {
+    std::string triple = llvm::sys::getDefaultTargetTriple();
     std::string error;
-    auto target = llvm::TargetRegistry::lookupTarget(targetTriple.str(), error);
+    auto target = llvm::TargetRegistry::lookupTarget(triple, error);
     
     if (!target) {
         std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Failed to lookup target: " << error << std::endl;
-        return false;
+        return nullptr;
     }
     
-    // 创建 TargetMachine
     auto CPU = "generic";
     auto features = "";
     llvm::TargetOptions opt;
     auto relocModel = llvm::Reloc::PIC_;  // 位置无关代码
-    auto targetMachine = target->createTargetMachine(
-        targetTriple, CPU, features, opt, relocModel);
+    std::unique_ptr<llvm::TargetMachine> targetMachine(target->createTargetMachine(
+        llvm::Triple(triple), CPU, features, opt, relocModel));
     
     if (!targetMachine) {
         std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Failed to create target machine" << std::endl;
-        return false;
     }
-    
-    // 设置模块的数据布局
-    module->setDataLayout(targetMachine->createDataLayout());
-    
-    // 打开输出文件
+    return targetMachine;
+}
+
+// 运行代码生成 Pass，将模块输出为目标文件
+static bool emitObjectFile(llvm::Module &module, llvm::TargetMachine &targetMachine,
+                           const std::string &filename) {
     std::error_code EC;
     llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
     
@@ -4207,14 +13653,78 @@ bool CodeGenerator::compileToObjectFile(const std::string &filename) {
     llvm::legacy::PassManager pass;
     auto fileType = llvm::CodeGenFileType::ObjectFile;
     
-    if (targetMachine->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
+    if (targetMachine.addPassesToEmitFile(pass, dest, nullptr, fileType)) {
         std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": TargetMachine can't emit a file of this type" << std::endl;
         return false;
     }
     
     // 运行 Pass 生成目标文件
-    pass.run(*module);
+    pass.run(module);
     dest.flush();
+    return true;
+}
+
+bool CodeGenerator::prepareTargetModule() {
+    // 初始化所有目标
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllAsmPrinters();
+    
+    // 获取目标三元组
+    llvm::Triple targetTriple(llvm::sys::getDefaultTargetTriple());
+    module->setTargetTriple(targetTriple);
+    
+    if (g_verbose) {
+        std::cout << "[CodeGen] Target triple: " << targetTriple.str() << std::endl;
+    }
+    
+    auto targetMachine = createHostTargetMachine();
+    if (!targetMachine) {
+        return false;
+    }
+    
+    // 设置模块的数据布局
+    module->setDataLayout(targetMachine->createDataLayout());
+    return true;
+}
+
+bool CodeGenerator::compileToObjectFile(const std::string &filename) {
+    if (codegenThreads > 1) {
+        // 并行生成多个目标文件，再用 ld -r 合并为一个可重定位目标文件
+        std::vector<std::string> parts;
+        if (!compileToObjectFileParts(filename, parts)) {
+            return false;
+        }
+        
+        std::vector<std::string> args = {"ld", "-r", "-o", filename};
+        args.insert(args.end(), parts.begin(), parts.end());
+        int result = safeExecuteCommand(args, g_verbose);
+        
+        for (const auto &part : parts) {
+            std::remove(part.c_str());
+        }
+        
+        if (result != 0) {
+            std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Failed to merge object files (ld exit code: " << result << ")" << std::endl;
+            return false;
+        }
+        
+        if (g_verbose) {
+            std::cout << "[CodeGen] Object file generated: " << filename << std::endl;
+        }
+        return true;
+    }
+    
+    if (!prepareTargetModule() || !optimizeHintedLoops()) {
+        return false;
+    }
+    
+    auto targetMachine = createHostTargetMachine();
+    if (!targetMachine || !emitObjectFile(*module, *targetMachine, filename)) {
+        return false;
+    }
     
     if (g_verbose) {
         std::cout << "[CodeGen] Object file generated: " << filename << std::endl;
@@ -4223,6 +13733,78 @@ bool CodeGenerator::compileToObjectFile(const std::string &filename) {
     return true;
 }
 
+/*
+ * 并行目标代码生成
+ * 用 llvm::SplitModule 将模块按函数划分为 codegenThreads 份（内部符号提升为隐藏的外部符号，
+ * 保证各部分之间可以互相链接），每份序列化为位码后在独立线程中读入自己的 LLVMContext，
+ * 使用独立的 TargetMachine 完成指令选择和寄存器分配，输出 <filename>.partN.o。
+ * LLVMContext 不是线程安全的，因此各线程之间不共享任何 IR 对象。
+ */
+bool CodeGenerator::compileToObjectFileParts(const std::string &filename,
+                                             std::vector<std::string> &parts) {
+    if (!prepareTargetModule() || !optimizeHintedLoops()) {
+        return false;
+    }
+    
+    // 拆分模块：各部分仍属于主模块的上下文，先序列化为位码再交给工作线程
+    std::vector<llvm::SmallVector<char, 0>> bitcodeParts;
+    llvm::SplitModule(*module, codegenThreads, [&](std::unique_ptr<llvm::Module> part) {
+        bitcodeParts.emplace_back();
+        llvm::raw_svector_ostream stream(bitcodeParts.back());
+        llvm::WriteBitcodeToFile(*part, stream);
+    });
+    
+    if (g_verbose) {
+        std::cout << "[CodeGen] Split module into " << bitcodeParts.size() << " parts" << std::endl;
+    }
+    
+    for (size_t i = 0; i < bitcodeParts.size(); i++) {
+        parts.push_back(filename + ".part" + std::to_string(i) + ".o");
+    }
+    
+    std::vector<char> succeeded(bitcodeParts.size(), 0);
+    std::mutex errorMutex;
+    DiagnosticState &diagnostics = currentDiagnostics();
+    bool verbose = g_verbose;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < bitcodeParts.size(); i++) {
+        threads.emplace_back([&, i]() {
+            DiagnosticScope scope(diagnostics, verbose);
+            llvm::LLVMContext partContext;
+            llvm::StringRef data(bitcodeParts[i].data(), bitcodeParts[i].size());
+            auto partModule = llvm::parseBitcodeFile(
+                llvm::MemoryBufferRef(data, parts[i]), partContext);
+            if (!partModule) {
+                std::string message = llvm::toString(partModule.takeError());
+                std::lock_guard<std::mutex> lock(errorMutex);
+                std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Failed to load code generation part " << i << ": " << message << std::endl;
+                return;
+            }
+            auto targetMachine = createHostTargetMachine();
+            if (targetMachine && emitObjectFile(**partModule, *targetMachine, parts[i])) {
+                succeeded[i] = 1;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (!succeeded[i]) {
+            for (const auto &part : parts) {
+                std::remove(part.c_str());
+            }
+            return false;
+        }
+    }
+    
+    if (g_verbose) {
+        std::cout << "[CodeGen] Generated " << parts.size() << " object files in parallel" << std::endl;
+    }
+    return true;
+}
+
 bool CodeGenerator::compileToExecutable(const std::string &filename) {
     // 安全检查：验证文件名不包含危险字符
     if (!isValidFilePath(filename)) {
@@ -4230,7 +13812,39 @@ bool CodeGenerator::compileToExecutable(const std::string &filename) {
         return false;
     }
     
-    // 1. 先生成 LLVM IR 文件
+    // 并行代码生成：直接链接拆分后的多个目标文件
+    if (codegenThreads > 1) {
+        std::vector<std::string> parts;
+        if (!compileToObjectFileParts(filename, parts)) {
+            return false;
+        }
+        
+        std::vector<std::string> args = {"clang"};
+        args.insert(args.end(), parts.begin(), parts.end());
+        args.push_back("-pthread");
+        args.push_back("-o");
+        args.push_back(filename);
+        int result = safeExecuteCommand(args, g_verbose);
+        
+        for (const auto &part : parts) {
+            std::remove(part.c_str());
+        }
+        
+        if (result != 0) {
+            std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Failed to link executable (clang exit code: " << result << ")" << std::endl;
+            return false;
+        }
+        
+        if (g_verbose) {
+            std::cout << "[Compile] Executable generated: " << filename << std::endl;
+        }
+        return true;
+    }
+    
+    // 1. 先生成 LLVM IR 文件（clang 不优化 IR，带提示的循环先在这里变换）
+    if (!optimizeHintedLoops()) {
+        return false;
+    }
     std::string llFilename = filename + ".ll";
     if (!writeIRToFile(llFilename)) {
         std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": Failed to write LLVM IR file" << std::endl;
@@ -4248,6 +13862,7 @@ bool CodeGenerator::compileToExecutable(const std::string &filename) {
         "clang",
         "-Wno-override-module",
         llFilename,
+        "-pthread",
         "-o",
         filename
     };
@@ -4302,18 +13917,14 @@ llvm::Function* CodeGenerator::getLongjmpFunction() {
     return module->getFunction("longjmp");
 }
 
-// 获取或创建异常消息全局变量
-llvm::GlobalVariable* CodeGenerator::getOrCreateExceptionMsgGlobal() {
-    if (!currentExceptionMsg) {
-        // 创建全局字符串缓冲区用于存储异常消息
+// 获取或创建当前函数的异常消息缓冲区
+// throw 只会跳转到同一函数中的 catch，缓冲区放在栈帧中即可，多个线程同时抛出异常时互不影响
+llvm::AllocaInst* CodeGenerator::getExceptionMessageBuffer() {
+    if (!fn->exceptionMessage) {
         llvm::ArrayType *bufType = llvm::ArrayType::get(llvm::Type::getInt8Ty(*context), CodeGenConstants::EXCEPTION_MSG_BUFFER_SIZE);
-        currentExceptionMsg = new llvm::GlobalVariable(
-            *module, bufType, false,
-            llvm::GlobalValue::InternalLinkage,
-            llvm::ConstantAggregateZero::get(bufType),
-            "__exception_msg");
+        fn->exceptionMessage = createEntryBlockAlloca(builder->GetInsertBlock()->getParent(), "exception_msg", bufType);
     }
-    return currentExceptionMsg;
+    return fn->exceptionMessage;
 }
 
 // 生成 Try-Catch 语句
@@ -4336,7 +13947,7 @@ void CodeGenerator::codegenTryCatch(TryCatchNode *node) {
     llvm::AllocaInst *jmpBuf = createEntryBlockAlloca(function, "jmp_buf", jmpBufType);
     
     // 压入异常上下文栈
-    exceptionContextStack.push_back(jmpBuf);
+    fn->exceptionContextStack.push_back(jmpBuf);
     
     // 2. 保存当前执行上下文
     llvm::Value *jmpBufPtr = builder->CreatePointerCast(
@@ -4375,29 +13986,29 @@ void CodeGenerator::codegenTryCatch(TryCatchNode *node) {
             std::cout << "[IR Gen]   Generating catch block" << std::endl;
         }
         
-        // 如果catch定义了异常变量，创建局部变量并从全局异常消息复制
+        // 如果catch定义了异常变量，创建局部变量并复制异常消息
+        // （缓冲区在栈帧中，复制后异常变量在函数返回后仍然有效，例如 return e）
         if (!node->exceptionVar.empty()) {
-            llvm::GlobalVariable *exceptionMsgGlobal = getOrCreateExceptionMsgGlobal();
+            llvm::Value *exceptionMsg = getExceptionMessageBuffer();
             
             // 创建局部字符串变量
             llvm::Type *strType = llvm::PointerType::get(*context, 0);
             llvm::AllocaInst *exceptionVarAlloca = createEntryBlockAlloca(
                 function, node->exceptionVar, strType);
             
-            // 将全局异常消息的地址存储到局部变量
-            llvm::Value *msgPtr = builder->CreatePointerCast(
-                exceptionMsgGlobal, strType, "exception_msg_ptr");
+            llvm::FunctionCallee strdupFunc = module->getOrInsertFunction("strdup", strType, strType);
+            llvm::Value *msgPtr = builder->CreateCall(strdupFunc, {exceptionMsg}, "exception_msg_copy");
             builder->CreateStore(msgPtr, exceptionVarAlloca);
             
             // 添加到符号表
-            namedValues[node->exceptionVar] = exceptionVarAlloca;
+            fn->namedValues[node->exceptionVar] = exceptionVarAlloca;
         }
         
         codegenStmt(node->catchBlock.get());
         
         // 从符号表移除异常变量
         if (!node->exceptionVar.empty()) {
-            namedValues.erase(node->exceptionVar);
+            fn->namedValues.erase(node->exceptionVar);
         }
     }
     
@@ -4410,7 +14021,7 @@ void CodeGenerator::codegenTryCatch(TryCatchNode *node) {
     builder->SetInsertPoint(afterBB);
     
     // 从异常上下文栈弹出
-    exceptionContextStack.pop_back();
+    fn->exceptionContextStack.pop_back();
     
     if (g_verbose) {
         std::cout << "[IR Gen]   Try-catch completed" << std::endl;
@@ -4437,22 +14048,34 @@ void CodeGenerator::codegenThrow(ThrowStmtNode *node) {
         errorMsg = builder->CreateGlobalString("Exception thrown", "", 0, module.get());
     }
     
-    // 2. 将异常消息复制到全局异常缓冲区
-    llvm::GlobalVariable *exceptionMsgGlobal = getOrCreateExceptionMsgGlobal();
+    emitThrow(errorMsg, true);
+    
+    // 创建新块用于后续代码（不会执行）
+    llvm::Function *function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *afterThrowBB = llvm::BasicBlock::Create(
+        *context, "after_throw", function);
+    builder->SetInsertPoint(afterThrowBB);
+}
+
+// 抛出异常：将消息复制到当前函数的异常缓冲区，在 try 块中时跳转到 catch 块，否则打印后退出
+// 调用后当前块已终结，调用者负责创建后续基本块
+void CodeGenerator::emitThrow(llvm::Value *errorMsg, bool releaseTempMemory) {
+    // 将异常消息复制到当前函数的异常缓冲区
+    llvm::Value *destPtr = getExceptionMessageBuffer();
     llvm::Function *strcpyFunc = module->getFunction("strcpy");
     if (strcpyFunc) {
-        llvm::Value *destPtr = builder->CreatePointerCast(
-            exceptionMsgGlobal, llvm::PointerType::get(*context, 0), "dest_ptr");
         builder->CreateCall(strcpyFunc, {destPtr, errorMsg});
     }
     
-    // 3. 在抛出异常前清理临时内存
-    // 这对异常安全至关重要，防止异常处理时的内存泄漏
-    clearTempMemory();
+    // 在抛出异常前清理临时内存，防止异常处理时的内存泄漏
+    // 运行时错误在表达式求值中途抛出，此时由调用者决定是否释放（releaseTempMemory 为 false）
+    if (releaseTempMemory) {
+        clearTempMemory();
+    }
     
-    // 4. 检查是否在try块中
-    if (exceptionContextStack.empty()) {
-        // 没有try块捕获，打印错误并退出
+    // 检查是否在try块中
+    if (fn->exceptionContextStack.empty()) {
+        // 没有try块捕获，打印错误并退出（消息已复制到异常缓冲区，临时内存释放后仍然有效）
         if (g_verbose) {
             std::cout << "[IR Gen]   No try block to catch exception, will exit" << std::endl;
         }
@@ -4461,7 +14084,7 @@ void CodeGenerator::codegenThrow(ThrowStmtNode *node) {
         if (printfFunc) {
             llvm::Value *formatStr = builder->CreateGlobalString(
                 "Uncaught exception: %s\\n", "", 0, module.get());
-            builder->CreateCall(printfFunc, {formatStr, errorMsg});
+            builder->CreateCall(printfFunc, {formatStr, destPtr});
         }
         
         llvm::Function *exitFunc = module->getFunction("exit");
@@ -4471,12 +14094,6 @@ void CodeGenerator::codegenThrow(ThrowStmtNode *node) {
         }
         
         builder->CreateUnreachable();
-        
-        // 创建新块用于后续代码（不会执行）
-        llvm::Function *function = builder->GetInsertBlock()->getParent();
-        llvm::BasicBlock *afterThrowBB = llvm::BasicBlock::Create(
-            *context, "after_throw", function);
-        builder->SetInsertPoint(afterThrowBB);
     } else {
         // 在try块中，跳转到对应的catch块
         if (g_verbose) {
@@ -4484,7 +14101,7 @@ void CodeGenerator::codegenThrow(ThrowStmtNode *node) {
         }
         
         llvm::Function *longjmpFunc = getLongjmpFunction();
-        llvm::AllocaInst *jmpBuf = exceptionContextStack.back();
+        llvm::AllocaInst *jmpBuf = fn->exceptionContextStack.back();
         
         llvm::Value *jmpBufPtr = builder->CreatePointerCast(
             jmpBuf, llvm::PointerType::get(*context, 0), "jmpbuf_ptr");
@@ -4492,12 +14109,6 @@ void CodeGenerator::codegenThrow(ThrowStmtNode *node) {
         
         builder->CreateCall(longjmpFunc, {jmpBufPtr, exceptionCode});
         builder->CreateUnreachable();  // 不会返回
-        
-        // 创建新块用于后续代码（不会执行）
-        llvm::Function *function = builder->GetInsertBlock()->getParent();
-        llvm::BasicBlock *afterThrowBB = llvm::BasicBlock::Create(
-            *context, "after_throw", function);
-        builder->SetInsertPoint(afterThrowBB);
     }
 }
 
@@ -4508,7 +14119,7 @@ void CodeGenerator::codegenBreakStmt(BreakStmtNode *node) {
     }
     
     // 检查是否在循环或switch中
-    if (loopContextStack.empty()) {
+    if (fn->loopContextStack.empty()) {
         reportError("'break' statement not in loop or switch", node->lineNumber);
         return;
     }
@@ -4517,7 +14128,7 @@ void CodeGenerator::codegenBreakStmt(BreakStmtNode *node) {
     clearTempMemory();
     
     // 跳转到循环/switch的结束块
-    llvm::BasicBlock *breakBlock = loopContextStack.back().breakBlock;
+    llvm::BasicBlock *breakBlock = fn->loopContextStack.back().breakBlock;
     builder->CreateBr(breakBlock);
     
     // 创建新的不可达块（break后的代码不会执行）
@@ -4534,7 +14145,7 @@ void CodeGenerator::codegenContinueStmt(ContinueStmtNode *node) {
     }
     
     // 检查是否在循环中
-    if (loopContextStack.empty()) {
+    if (fn->loopContextStack.empty()) {
         reportError("'continue' statement not in loop", node->lineNumber);
         return;
     }
@@ -4543,7 +14154,7 @@ void CodeGenerator::codegenContinueStmt(ContinueStmtNode *node) {
     clearTempMemory();
     
     // 跳转到循环的继续块（通常是条件检查或迭代更新）
-    llvm::BasicBlock *continueBlock = loopContextStack.back().continueBlock;
+    llvm::BasicBlock *continueBlock = fn->loopContextStack.back().continueBlock;
     builder->CreateBr(continueBlock);
     
     // 创建新的不可达块（continue后的代码不会执行）
@@ -4572,6 +14183,9 @@ void CodeGenerator::codegenSwitchStmt(SwitchStmtNode *node) {
     llvm::BasicBlock *afterSwitchBB = llvm::BasicBlock::Create(
         *context, "after_switch", function);
     
+    // 清理条件表达式求值产生的临时内存
+    clearTempMemory();
+
     // 创建switch指令（使用LLVM的switch指令）
     llvm::BasicBlock *defaultBB = nullptr;
     std::vector<std::pair<llvm::BasicBlock*, std::shared_ptr<CaseNode>>> caseBlocks;
@@ -4599,7 +14213,7 @@ void CodeGenerator::codegenSwitchStmt(SwitchStmtNode *node) {
     LoopContext loopCtx;
     loopCtx.breakBlock = afterSwitchBB;
     loopCtx.continueBlock = nullptr; 
-    loopContextStack.push_back(loopCtx);
+    fn->loopContextStack.push_back(loopCtx);
     
     // 生成每个case的代码
     for (size_t i = 0; i < caseBlocks.size(); i++) {
@@ -4628,7 +14242,7 @@ void CodeGenerator::codegenSwitchStmt(SwitchStmtNode *node) {
     }
     
     // 弹出循环上下文
-    loopContextStack.pop_back();
+    fn->loopContextStack.pop_back();
     
     // 继续在switch后的代码
     builder->SetInsertPoint(afterSwitchBB);
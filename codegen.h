@@ -26,9 +26,6 @@
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/TargetParser/Host.h>
 
-// 外部变量声明
-extern bool g_verbose;  // 全局日志控制变量
-
 // 设置源文件路径（用于错误报告显示源代码上下文）
 void setSourceFilePath(const std::string& path);
 
@@ -39,6 +36,30 @@ namespace CodeGenConstants {
     const size_t STRING_CONVERT_BUFFER_SIZE = 64;   // 数值转字符串缓冲区
     const size_t EXCEPTION_MSG_BUFFER_SIZE = 256;   // 异常消息缓冲区
     const size_t JMP_BUF_SIZE = 200;                // setjmp/longjmp 缓冲区
+    const uint64_t MAP_INITIAL_CAPACITY = 8;        // 映射的初始槽数量（一个探测组）
+    const unsigned STRING_CASE_LANES = 16;          // to_upper/to_lower 每次转换的字节数（128 位，SSE2 的一个寄存器）
+    const uint64_t LIST_MIN_CAPACITY = 4;           // 动态数组扩容后的最小容量
+    const uint64_t STACK_ARRAY_LIMIT = 64 * 1024;   // 局部数组放在栈上的最大字节数（-fstack-array-limit）
+    const uint64_t STDIN_CHUNK_SIZE = 64 * 1024;    // read_ints 等批量读取标准输入的缓冲区大小
+    const uint64_t PARSE_BUFFER_SIZE = 64;          // parse_double 在栈上复制数字的缓冲区（更长时 malloc）
+    const uint64_t FILE_BUFFER_SIZE = 64 * 1024;    // 文件读写缓冲区的初始大小
+    const uint64_t FILE_MMAP_THRESHOLD = 256 * 1024; // 不小于该大小的普通文件以 mmap 读取
+    const size_t IO_ERROR_BUFFER_SIZE = 256;        // I/O 异常消息缓冲区
+    const int64_t INSERTION_SORT_THRESHOLD = 16;    // 排序时不超过该长度的区间使用插入排序
+    const int64_t RADIX_SORT_THRESHOLD = 1024;      // 不少于该长度的 int 数组使用基数排序
+    const unsigned VECTOR_BYTES = 32;               // 数组运算内核的向量宽度（256 位，AVX2 的一个寄存器）
+    const int64_t PAIRWISE_BLOCK = 128;             // double 求和、点积的成对求和分块大小
+    const uint64_t INLINE_REDUCE_LIMIT = 16;        // 不超过该长度的定长数组直接内联归约
+    const int64_t CHANNEL_DEFAULT_CAPACITY = 64;    // chan<T>() 省略容量时的槽数量
+    const uint64_t CHANNEL_MIN_CAPACITY = 4;        // 通道的最小槽数量（容量向上取整为 2 的幂）
+    const uint64_t CACHE_LINE_BYTES = 64;           // 通道的入队、出队位置各占一个缓存行
+    const int64_t CHANNEL_SPIN_LIMIT = 64;          // 通道满或空时先自旋重试的次数
+    const int64_t CHANNEL_YIELD_LIMIT = 1024;       // 之后用 sched_yield 让出，超过该次数后 usleep
+    const unsigned CHANNEL_SLEEP_US = 50;           // 长时间等待时每次休眠的微秒数
+    const uint64_t GENERATOR_BLOCK_BYTES = 64;      // 生成器帧池的分级粒度（块大小为其整数倍，含块头）
+    const uint64_t GENERATOR_POOL_CLASSES = 16;     // 帧池的级数，更大的协程帧直接 malloc
+    const uint64_t GENERATOR_HEADER_BYTES = 16;     // 帧池块头（记录级别，保持协程帧 16 字节对齐）
+    const unsigned GENERATOR_PROMISE_ALIGN = 8;     // 生成器 promise（yield 的值）的对齐
 }
 
 // LLVM 代码生成器类
@@ -49,24 +70,17 @@ private:
     std::unique_ptr<llvm::Module> module;                           // LLVM 模块，包含所有函数和全局变量
     std::unique_ptr<llvm::IRBuilder<>> builder;                     // IR 构建器，用于生成 LLVM 指令
     
-    // 编译状态（错误计数使用error.h中的全局变量）
-    llvm::Function* currentFunction;                                // 当前正在编译的函数
-    int currentFunctionLineNumber;                                  // 当前函数声明的行号
-    
     // 符号表
-    std::map<std::string, llvm::AllocaInst*> namedValues;          // 局部变量符号表
     std::map<std::string, llvm::GlobalVariable*> globalValues;      // 全局变量符号表
+    std::map<std::string, std::string> globalTypes;                 // 全局变量的类型名
     std::map<std::string, llvm::Function*> functions;               // 函数符号表
-    std::map<std::string, std::string> variableTypes;               // 变量类型映射表
-    std::set<std::string> localConstVariables;                      // 局部常量变量集合
-    std::set<std::string> failedDeclarations;                       // 声明失败的变量（用于抑制级联错误）
-    std::set<std::string> usedVariables;                            // 已使用的变量（用于未使用变量警告）
-    std::map<std::string, int> declaredVariables;                   // 已声明的变量及其行号
+    std::map<std::string, FunctionDeclNode*> functionPrototypes;    // 已预先声明原型的函数及其声明节点
     
     // 全局变量动态初始化
     struct GlobalInitializer {
         llvm::GlobalVariable* variable;                             // 全局变量指针
         ExprNode* initializer;                                      // 初始化表达式
+        std::string typeName;                                       // 声明的类型名（用于 [:] 等依赖上下文的字面量）
     };
     std::vector<GlobalInitializer> globalInitializers;              // 需要动态初始化的全局变量列表
     
@@ -75,13 +89,57 @@ private:
         llvm::BasicBlock* continueBlock;                            // continue 跳转的目标块
         llvm::BasicBlock* breakBlock;                               // break 跳转的目标块
     };
-    std::vector<LoopContext> loopContextStack;                      // 循环上下文栈（支持嵌套循环）
-    std::vector<llvm::AllocaInst*> exceptionContextStack;           // 异常上下文栈（支持嵌套 try-catch）
-    llvm::GlobalVariable* currentExceptionMsg;                      // 当前异常消息的全局变量
     
-    // 内存管理
-    std::vector<llvm::Value*> tempMemoryStack;                      // 临时内存栈（用于自动释放）
-    std::map<std::string, llvm::Value*> ownedStringMemory;          // 变量拥有的动态字符串内存
+    // 生成器函数的协程状态（普通函数中 handle 为空）
+    struct GeneratorContext {
+        std::string yieldType;                                      // gen<T> 的元素类型名 T
+        llvm::Value* id = nullptr;                                  // llvm.coro.id 返回的 token
+        llvm::Value* handle = nullptr;                              // llvm.coro.begin 返回的协程句柄
+        llvm::AllocaInst* promise = nullptr;                        // 保存 yield 的值，for 循环通过 llvm.coro.promise 读取
+        std::vector<llvm::AllocaInst*> stringCopies;                // 字符串参数的副本（清理时释放）
+        llvm::BasicBlock* finalBlock = nullptr;                     // 最终挂起点（函数体结束或 return）
+        llvm::BasicBlock* cleanupBlock = nullptr;                   // 释放参数副本和协程帧
+        llvm::BasicBlock* suspendBlock = nullptr;                   // 挂起后返回调用者
+    };
+
+    // 函数级代码生成上下文
+    // 每个函数体拥有独立的一份，函数体之间不共享任何可变状态，因此可以并行生成
+    struct FunctionContext {
+        llvm::Function* function = nullptr;                         // 当前正在编译的函数
+        int lineNumber = 0;                                         // 当前函数声明的行号
+        std::map<std::string, llvm::AllocaInst*> namedValues;      // 局部变量符号表
+        std::map<std::string, llvm::GlobalVariable*> constArrays;   // 直接读取只读全局常量的局部常量数组
+        std::map<std::string, llvm::ArrayType*> arrayParams;        // 定长数组参数（按指针传递）声明的数组类型
+        std::map<std::string, std::string> variableTypes;           // 变量类型映射表
+        std::set<std::string> localConstVariables;                  // 局部常量变量集合
+        std::set<std::string> failedDeclarations;                   // 声明失败的变量（用于抑制级联错误）
+        std::set<std::string> usedVariables;                        // 已使用的变量（用于未使用变量警告）
+        std::map<std::string, int> declaredVariables;               // 已声明的变量及其行号
+        std::vector<LoopContext> loopContextStack;                  // 循环上下文栈（支持嵌套循环）
+        std::vector<llvm::AllocaInst*> exceptionContextStack;       // 异常上下文栈（支持嵌套 try-catch）
+        llvm::AllocaInst* exceptionMessage = nullptr;               // 异常消息缓冲区（在栈帧中，每个线程各有一份）
+        std::vector<llvm::Value*> tempMemoryStack;                  // 临时内存栈（用于自动释放）
+        std::map<std::string, llvm::Value*> ownedStringMemory;      // 变量拥有的动态字符串内存
+        std::vector<std::pair<llvm::Value*, std::string>> tempReferences;       // 临时的引用计数值及其类型（语句结束时释放）
+        std::set<llvm::Value*> borrowedStrings;                     // 取自动态数组或映射的字符串元素（内存仍属于容器）
+        std::vector<std::pair<llvm::AllocaInst*, std::string>> referenceSlots;  // 持有引用计数值的局部变量（函数出口释放）
+        GeneratorContext generator;                                 // 生成器函数的协程状态
+        std::vector<llvm::Value*> activeGenerators;                 // 正在被 for 循环迭代的生成器句柄（return 前销毁）
+        int noCheckDepth = 0;                                       // 所在 @nocheck 循环的层数（大于 0 时省略运行时检查）
+        unsigned omittedChecks = 0;                                 // @nocheck 循环中省略的运行时检查个数
+    };
+    FunctionContext topLevelContext;                                // 顶层（全局作用域）上下文
+    FunctionContext* fn;                                            // 当前函数上下文
+    
+    // 并行 IR 生成
+    unsigned irThreads;                                             // 函数体 IR 生成线程数（1 为串行）
+    unsigned codegenThreads;                                        // 目标代码生成线程数（1 为不拆分模块）
+    uint64_t stackArrayLimit;                                       // 超过该字节数的局部数组改为堆分配
+    unsigned incrementCount;                                        // 已生成的增量模块数（交互式模式）
+
+    // 浮点语义
+    llvm::FastMathFlags fastMathFlags;                              // 所有函数的浮点运算标志（-ffast-math、-ffp-contract=fast）
+    bool mathErrno;                                                 // 数学函数是否设置 errno（为 false 时 pow 使用 LLVM 内置函数，@fastmath 函数中总是使用）
     
     // 模块管理
     std::set<std::string> loadedModules;                            // 已加载的模块集合
@@ -90,12 +148,27 @@ private:
     std::map<std::string, std::string> moduleAliases;               // 模块别名映射（import as）
     std::map<std::string, std::map<std::string, llvm::Function*>> moduleFunctions;       // 模块函数表
     std::map<std::string, std::map<std::string, llvm::GlobalVariable*>> moduleGlobals;   // 模块全局变量表
+    std::vector<std::shared_ptr<ProgramNode>> moduleASTs;           // 已加载模块的 AST（延迟生成的函数体引用其中的节点）
+    std::map<std::string, FunctionDeclNode*> lazyFunctionBodies;    // 已声明原型、尚未生成函数体的模块函数
+    std::vector<std::string> lazyFunctionWorklist;                  // 已被调用、等待生成函数体的模块函数
     
     // 类型系统
     llvm::Type* getType(const std::string& typeName);                               // 将类型名转换为 LLVM 类型
+    std::string declaredTypeOf(ExprNode* node);                                     // 表达式的声明类型名（未知时为空）
+    static bool isMapType(const std::string& typeName);                             // 是否为 map<K,V>
+    static std::string mapKeyType(const std::string& mapType);                      // map<K,V> 的键类型名 K
+    static std::string mapValueType(const std::string& mapType);                    // map<K,V> 的值类型名 V
+    static bool isListType(const std::string& typeName);                            // 是否为 list<T>（T[]）
+    static bool isReferenceType(const std::string& typeName);                       // 映射、动态数组、文件、通道、future 或生成器（以指针表示但不是字符串）
+    static std::string listElementType(const std::string& listType);                // list<T> 的元素类型名 T
+    static bool isChanType(const std::string& typeName);                            // 是否为 chan<T>
+    static bool isFutureType(const std::string& typeName);                          // 是否为 future<T>
+    static std::string chanElementType(const std::string& chanType);                // chan<T> 的元素类型名 T
+    static std::string futureValueType(const std::string& futureType);              // future<T> 的结果类型名 T
     llvm::AllocaInst* createEntryBlockAlloca(llvm::Function* function,              // 在函数入口块创建局部变量
                                               const std::string& varName,
                                               llvm::Type* type);
+    void moveLargeArraysToHeap(llvm::Function* function);                           // 超过栈上限的局部数组改为堆分配，在出口释放
     
     // 内置函数
     void declareBuiltinFunctions();                                                 // 声明所有内置函数
@@ -107,21 +180,38 @@ private:
     void pushTempMemory(llvm::Value* ptr);                                          // 将指针加入临时内存栈
     void removeTempMemory(llvm::Value* ptr);                                        // 从临时内存栈移除指针
     void clearTempMemory();                                                         // 清理当前作用域的临时内存
+    void clearTempMemorySince(size_t memoryMark, size_t referenceMark);             // 只清理标记之后加入的临时内存
     void trackOwnedString(const std::string& varName, llvm::Value* ptr);           // 跟踪变量拥有的字符串内存
     void freeOwnedString(const std::string& varName);                               // 释放变量拥有的字符串内存
+    llvm::Value* copyBorrowedString(llvm::Value* value, const std::string& typeName);   // 绑定到变量或返回的字符串属于容器时保存副本
+
+    // 引用计数（动态数组）
+    static bool isCountedType(const std::string& typeName);                         // 值是否带引用计数（list<T>、map<K,V>、future<T>、chan<T>）
+    void emitRetain(llvm::Value* value, const std::string& typeName);               // 引用计数加一（空指针不变）
+    void emitRelease(llvm::Value* value, const std::string& typeName);              // 引用计数减一，减到 0 时释放
+    void pushTempReference(llvm::Value* value, const std::string& typeName);        // 新建的值加入临时引用栈
+    bool takeTempReference(llvm::Value* value);                                     // 从临时引用栈取走（所有权转移）
+    void ownReference(llvm::Value* value, const std::string& typeName);             // 取得一个引用：临时值直接取走，否则加一
+    void trackReferenceSlot(llvm::AllocaInst* slot, const std::string& typeName);   // 局部变量持有引用（入口置空，出口释放）
+    void storeReference(llvm::Value* slot, llvm::Value* value,                      // 写入变量：取得新值的引用，释放旧值
+                        const std::string& typeName);
+    void releaseReferenceSlots(llvm::Function* function);                           // 在每个 ret 之前释放局部变量持有的引用
     
     // 模块管理辅助函数
     std::string findModuleFile(const std::string& moduleName);                      // 查找模块文件路径
     bool loadModule(const std::string& moduleName);                                 // 加载模块
     llvm::Function* findModuleFunction(const std::string& moduleName, const std::string& funcName);        // 在模块中查找函数
     llvm::GlobalVariable* findModuleGlobal(const std::string& moduleName, const std::string& varName);     // 在模块中查找全局变量
+    void requestFunctionBody(const std::string& funcName);                          // 调用点解析到模块函数时加入工作表
+    void generateRequestedFunctionBodies();                                         // 按工作表生成被调用的模块函数体（传递闭包）
     void codegenImport(ImportNode* node);                                           // 生成 import 语句代码
     
     // 异常处理辅助函数
     void declareExceptionHandlingFunctions();                                       // 声明异常处理相关函数
     llvm::Function* getSetjmpFunction();                                            // 获取 setjmp 函数
     llvm::Function* getLongjmpFunction();                                           // 获取 longjmp 函数
-    llvm::GlobalVariable* getOrCreateExceptionMsgGlobal();                          // 获取或创建异常消息全局变量
+    llvm::AllocaInst* getExceptionMessageBuffer();                                  // 获取或创建当前函数的异常消息缓冲区
+    void emitThrow(llvm::Value* errorMsg, bool releaseTempMemory);                  // 抛出异常（跳转到 catch 或打印后退出）
     
     // 全局变量初始化
     void createGlobalConstructor();                                                 // 创建全局构造函数（用于初始化全局变量）
@@ -137,7 +227,293 @@ private:
                                              bool isIntegerDivision = false);
     llvm::Value* createModuloWithZeroCheck(llvm::Value* left, llvm::Value* right,      // 创建带除零检查的取模
                                            const std::string& errorMsg);
+    llvm::Value* applyCompoundAssign(const std::string& op, llvm::Value* oldVal,       // 计算复合赋值（+= 等）的新值
+                                     llvm::Value* value);
+    
+    // 映射运行时（以 linkonce_odr 函数的形式按需生成到使用它的模块中，见 codegen.cc 中的说明）
+    llvm::StructType* getMapStructType();                                           // 映射头部结构体
+    llvm::Function* getMapNewFunction();                                            // __ppx_map_new
+    llvm::Function* getMapEmptySlotFunction();                                      // __ppx_map_empty_slot
+    llvm::Function* getMapHashFunction(const std::string& keyType);                 // __ppx_map_hash.K
+    llvm::Function* getMapFindFunction(const std::string& keyType);                 // __ppx_map_find.K
+    llvm::Function* getMapRehashFunction(const std::string& keyType);               // __ppx_map_rehash.K
+    llvm::Function* getMapInsertFunction(const std::string& keyType);               // __ppx_map_insert.K
+    llvm::Function* getMapRetainFunction();                                         // __ppx_map_retain
+    llvm::Function* getMapReleaseFunction();                                        // __ppx_map_release
+    llvm::Value* emitMapLoadGroup(llvm::Value* ctrl, llvm::Value* base);            // 读取 8 个控制字节 <8 x i8>
+    llvm::Value* emitMapGroupMask(llvm::Value* matches);                            // <8 x i1> 压缩为位掩码
+    llvm::Value* emitMapGroupMatch(llvm::Value* group, llvm::Value* h2);            // 组内等于 H2 的槽
+    llvm::Value* emitMapGroupEmpty(llvm::Value* group);                             // 组内的空槽
+    llvm::Value* emitMapFirstSlot(llvm::Value* mask);                               // 掩码中最低的槽序号（cttz）
     
+    // 映射代码生成
+    llvm::Value* codegenTypedExpr(ExprNode* node, const std::string& typeName);     // 按声明类型生成表达式（[:] 需要类型）
+    llvm::Value* codegenMapLiteral(MapLiteralNode* node, const std::string& mapType);  // 生成映射字面量
+    llvm::Value* convertMapKey(llvm::Value* key, const std::string& mapType,        // 检查并转换映射的键
+                               int lineNumber);
+    llvm::Value* codegenMapGet(ArrayAccessNode* node, const std::string& mapType);  // m[k] 读取
+    void codegenMapSet(AssignmentNode* node, const std::string& mapType);           // m[k] = v 及复合赋值
+    void emitMapStore(llvm::Value* map, llvm::Value* key, llvm::Value* value,       // 插入或更新键值对
+                      const std::string& mapType, const std::string& op, int lineNumber);
+    void codegenMapForStmt(ForStmtNode* node, const std::string& mapType);          // for k in m
+    
+    // 动态数组运行时（与映射相同，以 linkonce_odr 函数的形式按需生成）
+    llvm::StructType* getListStructType();                                          // 动态数组头部结构体
+    llvm::Function* getListNewFunction();                                           // __ppx_list_new
+    llvm::Function* getListGrowFunction();                                          // __ppx_list_grow
+    llvm::Function* getListSliceFunction();                                         // __ppx_list_slice
+    llvm::Function* getListRetainFunction();                                        // __ppx_list_retain
+    llvm::Function* getListReleaseFunction();                                       // __ppx_list_release
+    
+    // 动态数组代码生成
+    llvm::Value* codegenListLiteral(ArrayLiteralNode* node, const std::string& listType);  // 生成动态数组字面量
+    llvm::Value* convertListElement(llvm::Value* value, const std::string& listType,    // 检查并转换元素
+                                    int lineNumber);
+    llvm::Value* emitListBoundsCheck(llvm::Value* list, llvm::Value* index,         // 索引检查，返回 i64 索引
+                                     llvm::BasicBlock* inBoundsBB, llvm::BasicBlock* errorBB);
+    void emitListPush(llvm::Value* list, llvm::Value* value, const std::string& listType,   // 追加元素（已转换）
+                      bool copyString = true);                      // copyString 为 false 时字符串元素直接转移所有权
+    llvm::Value* codegenListGet(ArrayAccessNode* node, const std::string& listType);    // a[i] 读取
+    void codegenListSet(AssignmentNode* node, const std::string& listType);         // a[i] = v 及复合赋值
+    llvm::Value* codegenListBuiltin(FunctionCallNode* node, ExprNode* listExpr,     // push/pop/reserve
+                                    size_t firstArg, const std::string& listType);
+    llvm::Value* codegenSlice(SliceNode* node);                                     // a[from..to]
+    bool emitSliceBounds(SliceNode* node, llvm::Value* size,                        // 检查 0 <= from <= to <= size（无效时为空范围）
+                         llvm::Value*& from, llvm::Value*& to);
+    void codegenListForStmt(ForStmtNode* node, const std::string& listType);        // for x in a
+    
+    // 定长数组访问（多维数组按行主序连续存储）
+    struct ArrayLiteralElement {
+        uint64_t offset;                                            // 按行主序展开后的位置
+        llvm::Value* value;                                         // 元素的值（常量元素为 llvm::Constant）
+    };
+    llvm::Value* fixedArrayOf(ArrayAccessNode* node, llvm::Type*& arrayType);       // 下标链的根为定长数组（局部、参数、全局）时返回其地址
+    bool evaluateArrayLiteral(ArrayLiteralNode* literal,                            // 按书写顺序求值字面量元素并检查维度
+                              const std::vector<uint64_t>& dimensions, size_t depth,
+                              uint64_t base, std::vector<ArrayLiteralElement>& elements);
+    llvm::Constant* arrayLiteralConstant(llvm::ArrayType* type,                     // 字面量的常量部分（其余元素为 0）
+                                         std::vector<ArrayLiteralElement>& elements,
+                                         bool& allConstant, int lineNumber);
+    void emitArrayLiteralInit(llvm::Value* dest, llvm::ArrayType* type,             // memcpy 常量部分，再写入非常量元素
+                              llvm::Constant* constantPart, std::vector<ArrayLiteralElement>& elements,
+                              const std::string& name);
+    bool emitGlobalArrayInit(const GlobalInitializer& init);                        // 定长数组全局变量的字面量初始值
+    llvm::Value* emitFixedArrayElementPtr(ArrayAccessNode* node,                    // 合并边界检查并线性化下标，返回元素指针
+                                          llvm::Type*& elementType, llvm::BasicBlock*& errorBB);
+
+    // 字符串切片视图（指针 + 长度，不复制；print/len/比较/拼接直接使用，其余位置复制为新字符串）
+    bool isStringSlice(ExprNode* node);                                             // s[a..b]，s 不是动态数组
+    llvm::Value* codegenStringView(ExprNode* node, llvm::Value*& length);           // 切片返回视图并设置 i64 长度，其余表达式长度为空
+    llvm::Value* stringViewLength(llvm::Value* data, llvm::Value* length);          // 视图长度，为空时按 strlen 计算
+    llvm::Value* codegenStringSlice(SliceNode* node);                               // 复制切片为新字符串（临时内存）
+    llvm::Value* materializeStringView(llvm::Value* data, llvm::Value* length);     // 复制视图为新字符串（临时内存）
+    llvm::Value* emitStringCopy(llvm::Value* data, llvm::Value* length);            // malloc 并复制为以 NUL 结尾的字符串
+    llvm::Value* emitStringConcat(llvm::Value* left, llvm::Value* leftLength,       // 拼接两个字符串或视图
+                                  llvm::Value* right, llvm::Value* rightLength);
+    llvm::Value* emitStringCompare(const std::string& op,                           // 按内容比较两个字符串或视图
+                                   llvm::Value* left, llvm::Value* leftLength,
+                                   llvm::Value* right, llvm::Value* rightLength);
+
+    // 字符串运行时（以 linkonce_odr 函数的形式按需生成，参数为指针 + 长度）
+    llvm::Function* getStringFindFunction();                                        // __ppx_str_find
+    llvm::Function* getStringCountFunction();                                       // __ppx_str_count
+    llvm::Function* getStringSplitFunction();                                       // __ppx_str_split
+    llvm::Function* getStringReplaceFunction();                                     // __ppx_str_replace
+    llvm::Function* getStringCaseFunction(bool upper);                              // __ppx_str_upper / __ppx_str_lower
+    llvm::Function* getStringTrimFunction(bool start);                              // __ppx_str_trim_start / __ppx_str_trim_end
+
+    // 字符串内置函数（find、contains、count、starts_with、ends_with、split、replace、trim、to_upper、to_lower）
+    static bool isStringBuiltin(const std::string& name);                           // 是否为字符串内置函数名
+    static std::string stringBuiltinType(const std::string& name);                  // 内置函数的返回类型名
+    bool stringBuiltinCall(FunctionCallNode* node, ExprNode*& subject,              // 调用是否为字符串内置函数（未被用户函数覆盖）
+                           size_t& firstArg);
+    llvm::Value* codegenStringBuiltin(FunctionCallNode* node, ExprNode* subject,    // s.f(...) 或 f(s, ...)
+                                      size_t firstArg, llvm::Value** viewLength = nullptr);
+
+    // 标准输入缓冲区和数值解析运行时（以 linkonce_odr 函数的形式按需生成）
+    llvm::StructType* getStdinStateType();                                          // 标准输入缓冲区结构体
+    llvm::GlobalVariable* getStdinStateGlobal();                                    // __ppx_stdin
+    llvm::Function* getStdinFillFunction();                                         // __ppx_stdin_fill
+    llvm::Function* getStdinGetcFunction();                                         // __ppx_stdin_getc
+    llvm::Function* getStdinTokenFunction();                                        // __ppx_stdin_token
+    llvm::Function* getParseIntFunction();                                          // __ppx_parse_int
+    llvm::Function* getParseDoubleFunction();                                       // __ppx_parse_double
+    llvm::Function* getReadNumbersFunction(bool isDouble);                          // __ppx_read_ints / __ppx_read_doubles
+    llvm::Function* getReadAllFunction();                                           // __ppx_read_all
+    llvm::Value* emitErrnoPtr();                                                    // errno 的地址（__errno_location / __error）
+    llvm::Value* emitStdinFile();                                                   // C 库的 stdin（FILE*）
+
+    // 数值输入内置函数（parse_int、parse_double、read_ints、read_doubles、read_all）
+    static bool isInputBuiltin(const std::string& name);                            // 是否为数值输入内置函数名
+    static std::string inputBuiltinType(const std::string& name);                   // 内置函数的返回类型名
+    bool inputBuiltinCall(FunctionCallNode* node);                                  // 调用是否为数值输入内置函数（未被用户函数覆盖）
+    llvm::Value* codegenInputBuiltin(FunctionCallNode* node);                       // 生成数值输入内置函数调用
+
+    // 文件运行时（以 linkonce_odr 函数的形式按需生成；失败时返回 null 或负数并设置 errno）
+    llvm::StructType* getFileStructType();                                          // 文件头部结构体
+    llvm::Function* getFileOpenFunction();                                          // __ppx_file_open
+    llvm::Function* getFileFillFunction();                                          // __ppx_file_fill
+    llvm::Function* getFileNextLineFunction();                                      // __ppx_file_next_line
+    llvm::Function* getFileReadLineFunction();                                      // __ppx_file_read_line
+    llvm::Function* getFileReadAllFunction();                                       // __ppx_file_read_all
+    llvm::Function* getFileEofFunction();                                           // __ppx_file_eof
+    llvm::Function* getFileWriteAllFunction();                                      // __ppx_file_write_all
+    llvm::Function* getFileWriteFunction();                                         // __ppx_file_write
+    llvm::Function* getFileFlushFunction();                                         // __ppx_file_flush
+    llvm::Function* getFileCloseFunction();                                         // __ppx_file_close
+
+    // 文件内置函数（open、read_line、read_all、write、flush、close、eof 和 for line in lines(...)）
+    static bool isFileBuiltin(const std::string& name);                             // 是否为文件内置函数名
+    static std::string fileBuiltinType(const std::string& name);                    // 内置函数的返回类型名
+    bool fileBuiltinCall(FunctionCallNode* node, ExprNode*& handle,                 // 调用是否为文件内置函数（未被用户函数覆盖）
+                         size_t& firstArg);
+    llvm::Value* codegenFileBuiltin(FunctionCallNode* node, ExprNode* handle,       // f.op(...) 或 op(f, ...)
+                                    size_t firstArg);
+    void emitIoErrorCheck(llvm::Value* failed, const std::string& action,          // 失败时抛出 "<action> '<path>': 错误原因"
+                          llvm::Value* path);
+    void codegenLinesForStmt(ForStmtNode* node, FunctionCallNode* call);            // for line in lines(path 或 f)
+
+    // 排序和查找运行时（按元素类型 int、double、char、string 分别生成，降序版本单独生成）
+    static bool isSortableElementType(const std::string& typeName);                 // 是否为可排序的元素类型
+    llvm::Function* getStringCompareFunction();                                     // __ppx_str_compare
+    llvm::Value* emitElementLess(const std::string& elementType, llvm::Value* a,    // a 排在 b 之前（降序时比较方向相反）
+                                 llvm::Value* b, bool descending);
+    llvm::Value* emitElementEqual(const std::string& elementType, llvm::Value* a,   // a 与 b 相等
+                                  llvm::Value* b);
+    llvm::Function* getInsertionSortFunction(const std::string& elementType,        // __ppx_insertion_sort_T
+                                             bool descending);
+    llvm::Function* getSiftDownFunction(const std::string& elementType,             // __ppx_sift_down_T
+                                        bool descending);
+    llvm::Function* getHeapSortFunction(const std::string& elementType,             // __ppx_heap_sort_T
+                                        bool descending);
+    llvm::Function* getIntroSortFunction(const std::string& elementType,            // __ppx_intro_sort_T
+                                         bool descending);
+    llvm::Function* getRadixSortFunction();                                         // __ppx_radix_sort_i32
+    llvm::Function* getSortFunction(const std::string& elementType,                 // __ppx_sort_T / __ppx_sort_desc_T
+                                    bool descending);
+    llvm::Function* getBinarySearchFunction(const std::string& elementType);        // __ppx_binary_search_T
+    llvm::Function* getExtremeIndexFunction(const std::string& elementType,         // __ppx_min_index_T / __ppx_max_index_T
+                                            bool isMax);
+    llvm::Function* getUniqueFunction(const std::string& elementType);              // __ppx_unique_T
+
+    // 数组内置函数（sort、sort_desc、binary_search、min_index、max_index、unique）
+    struct ArrayOperand {
+        llvm::Value* data = nullptr;                                // 第一个元素的地址
+        llvm::Value* count = nullptr;                               // 元素个数（i64）
+        llvm::Value* list = nullptr;                                // 动态数组的头部，定长数组为空
+        std::string elementType;                                    // 元素类型名
+        bool isConst = false;                                       // 只读的常量数组
+    };
+    static bool isArrayBuiltin(const std::string& name);                            // 是否为数组内置函数名
+    bool arrayBuiltinCall(FunctionCallNode* node, ExprNode*& array,                 // 调用是否为数组内置函数（未被用户函数覆盖）
+                          size_t& firstArg);
+    bool codegenArrayOperand(ExprNode* node, ArrayOperand& operand);                // 求值一维定长数组或动态数组
+    llvm::Value* codegenArrayBuiltin(FunctionCallNode* node, ExprNode* array,       // sort(a)、a.sort() 等
+                                     size_t firstArg);
+    std::string arrayBuiltinType(FunctionCallNode* node, ExprNode* array);          // 数组内置函数的返回类型名
+
+    // 向量化的数组运算（sum、min、max、dot、fill、copy、scale、axpy，元素类型为 int 或 double）
+    static bool isVectorBuiltin(const std::string& name);                           // 是否为数组运算内置函数名
+    llvm::FixedVectorType* kernelVectorType(const std::string& elementType);        // 内核一次处理的向量类型
+    llvm::Value* emitVectorReduce(const std::string& kernel, llvm::Value* vector);  // llvm.vector.reduce.* 水平归约
+    llvm::Function* getReduceKernel(const std::string& kernel,                      // __ppx_sum_T / dot / min / max
+                                    const std::string& elementType);
+    llvm::Function* getPairwiseKernel(const std::string& kernel);                   // __ppx_sum_f64 / __ppx_dot_f64
+    llvm::Function* getMapKernel(const std::string& kernel,                         // __ppx_fill_T / scale / axpy
+                                 const std::string& elementType);
+    llvm::Value* codegenVectorBuiltin(FunctionCallNode* node, ExprNode* array,      // sum(a)、a.dot(b) 等
+                                      size_t firstArg);
+    bool emitLengthCheck(const std::string& name, llvm::Value* a, llvm::Value* b,   // 检查两个数组长度相同
+                         int lineNumber);
+
+    // 线程和通道运行时（通道为有界的无锁多生产者多消费者环形队列，以 linkonce_odr 函数的形式按需生成）
+    llvm::StructType* getChannelStructType();                                       // 通道头部结构体
+    llvm::Function* getChannelNewFunction();                                        // __ppx_chan_new
+    llvm::Function* getChannelBackoffFunction();                                    // __ppx_chan_backoff
+    llvm::Function* getChannelSendFunction();                                       // __ppx_chan_send
+    llvm::Function* getChannelRecvFunction();                                       // __ppx_chan_recv
+    llvm::Function* getChannelCloseFunction();                                      // __ppx_chan_close
+    llvm::Function* getChannelRetainFunction();                                     // __ppx_chan_retain
+    llvm::Function* getChannelReleaseFunction();                                    // __ppx_chan_release
+    llvm::StructType* getTaskStructType(llvm::Function* callee);                    // spawn 的任务结构体（线程、引用计数、状态、结果、参数）
+    llvm::Function* getTaskFunction(llvm::Function* callee);                        // __ppx_task_f：在新线程中调用 f
+    llvm::Function* getFutureRetainFunction();                                      // __ppx_future_retain
+    llvm::Function* getFutureReleaseFunction(const std::string& valueType);         // __ppx_future_release_T
+
+    // 线程和通道代码生成（spawn、join、chan<T>(n)、send、recv、close）
+    bool codegenCallArguments(FunctionCallNode* node, llvm::Function* callee,       // 检查参数个数和类型并生成用户函数的实参
+                              std::vector<llvm::Value*>& args);
+    llvm::Value* codegenSpawn(SpawnNode* node, bool detached);                      // spawn f(args)，detached 时不返回 future
+    llvm::Value* codegenChannel(ChannelNode* node);                                 // chan<T>(capacity)
+    llvm::Value* channelWord(llvm::Value* value, const std::string& elementType);   // 通道元素转换为 i64 槽值
+    llvm::Value* channelValue(llvm::Value* word, const std::string& elementType);   // i64 槽值转换回通道元素
+    static bool isThreadBuiltin(const std::string& name);                           // 是否为 join/send/recv/close
+    bool threadBuiltinCall(FunctionCallNode* node, ExprNode*& subject,              // 调用的对象或第一个参数是否为通道或 future
+                           size_t& firstArg);
+    std::string threadBuiltinType(FunctionCallNode* node, ExprNode* subject);       // 线程内置函数的返回类型名
+    llvm::Value* codegenThreadBuiltin(FunctionCallNode* node, ExprNode* subject,    // h.join()、c.send(v)、recv(c) 等
+                                      size_t firstArg);
+    void codegenChannelForStmt(ForStmtNode* node, const std::string& chanType);     // for x in c：接收到通道关闭并取空
+
+    // 生成器（llvm.coro.* 协程，帧从帧池分配，for 循环在本函数中迭代时由 CoroElide 改为栈上分配）
+    static bool isGenType(const std::string& typeName);                             // 是否为 gen<T>
+    static std::string genElementType(const std::string& genType);                  // gen<T> 的元素类型名 T
+    bool isGeneratorFunction(const std::string& name);                              // 是否为返回 gen<T> 的用户函数
+    llvm::GlobalVariable* getGeneratorPoolGlobal();                                 // __ppx_gen_pool：自旋锁和各级空闲链表
+    llvm::Function* getGeneratorAllocFunction();                                    // __ppx_gen_alloc
+    llvm::Function* getGeneratorFreeFunction();                                     // __ppx_gen_free
+    void emitGeneratorEntry(llvm::Function* function, const std::string& genType);  // coro.id、从帧池分配协程帧、coro.begin
+    void emitGeneratorStart(FunctionDeclNode* node);                                // 复制字符串参数后在初始挂起点挂起
+    void emitGeneratorFinish();                                                     // 最终挂起点、清理和返回句柄
+    void destroyActiveGenerators();                                                 // 销毁正在迭代的生成器（return 和 yield 被销毁时）
+    void codegenYieldStmt(YieldStmtNode* node);                                     // yield v
+    void codegenGeneratorForStmt(ForStmtNode* node, FunctionCallNode* call);        // for x in f(args)：逐个恢复生成器
+    bool lowerCoroutines();                                                         // 运行协程 Pass，把生成器拆分为普通函数
+
+    // SIMD 向量（vec<T,N> 映射为 <N x T>，宽于目标向量寄存器时由后端拆分）
+    static bool isVecType(const std::string& typeName);                             // 是否为 vec<T,N>
+    static bool isValidVecType(const std::string& typeName);                        // T 为 int 或 double，N 为 2 到 64 之间 2 的幂
+    static std::string vecElementType(const std::string& vecType);                  // vec<T,N> 的元素类型名 T
+    static unsigned vecLaneCount(const std::string& vecType);                       // vec<T,N> 的元素个数 N
+    bool checkVecType(const std::string& typeName, int lineNumber);                 // 无效的向量类型报告错误
+    llvm::Value* codegenVec(VecNode* node);                                         // vec<T,N>(...)
+    llvm::Value* convertToVec(llvm::Value* value, llvm::FixedVectorType* vecTy);    // 标量广播或逐元素转换（不兼容时返回空）
+    llvm::Value* codegenVecBinaryOp(const std::string& op, llvm::Value* left,       // 逐元素运算，标量广播到所有元素
+                                    llvm::Value* right, int lineNumber);
+    void codegenVecAssign(AssignmentNode* node, llvm::Value* storage,               // v = w、v += w：逐元素运算后写回
+                          llvm::FixedVectorType* vecTy);
+    llvm::Value* vecStoragePtr(ExprNode* node);                                     // 向量变量的存储位置（不是变量时为空）
+    llvm::Value* codegenVecLane(ArrayAccessNode* node);                             // v[i]
+    void codegenVecLaneSet(AssignmentNode* node, ArrayAccessNode* target);          // v[i] = x、v[i] += x
+    bool isArrayOperand(ExprNode* node);                                            // 是否为一维定长数组变量或动态数组（不生成代码）
+    llvm::Value* codegenVecArrayAccess(const std::string& name, ExprNode* array,    // 读取（value 为空）或写入 a[i..i+N)
+                                       ExprNode* indexExpr, llvm::FixedVectorType* vecTy,
+                                       llvm::Value* value, int lineNumber);
+    llvm::Align vecAccessAlign(const ArrayOperand& operand, llvm::Value* index,     // 向量访存的对齐（必要时提高数组的对齐）
+                               llvm::FixedVectorType* vecTy);
+    static bool isSimdBuiltin(const std::string& name);                             // 是否为 store/sum/min/max/dot
+    bool simdBuiltinCall(FunctionCallNode* node, ExprNode*& subject,                // 调用的对象或第一个参数是否为向量
+                         size_t& firstArg);
+    std::string simdBuiltinType(FunctionCallNode* node, ExprNode* subject);         // 向量内置函数的返回类型名
+    llvm::Value* codegenSimdBuiltin(FunctionCallNode* node, ExprNode* subject,      // v.sum()、dot(v, w)、store(v, a, i)
+                                    size_t firstArg);
+    std::string formatVecLanes(llvm::Value* vector, const std::string& laneSpec,    // "[%d, %d, ...]" 格式串，各元素追加到 args
+                               std::vector<llvm::Value*>& args);
+
+    // 循环优化提示（@unroll、@vectorize 写入 llvm.loop 元数据，@nocheck 省略循环内的运行时检查）
+    bool checkAnnotations(const std::vector<Annotation>& annotations,               // 未知、重复或参数无效的注解报告错误（循环或函数）
+                          bool onLoop);
+    void codegenAnnotatedLoop(StmtNode* loop,                                       // 生成带注解的 while 或 for 循环
+                              const std::vector<Annotation>& annotations);
+    void attachLoopHints(const std::vector<Annotation>& annotations, int line,      // 在循环回边上附加 llvm.loop 元数据
+                         llvm::BasicBlock* header);
+    bool omitRuntimeCheck();                                                        // 是否省略当前位置的越界和除零检查
+    bool optimizeHintedLoops();                                                     // 对带提示的函数运行循环优化并报告结果
+
+    // 浮点运算标志（-ffast-math、-ffp-contract=fast 和函数的 @fastmath 设置 IRBuilder 的 FastMathFlags）
+    llvm::FastMathFlags functionFastMathFlags(FunctionDeclNode* node);              // 函数体使用的浮点运算标志（检查函数注解）
+    llvm::Value* codegenPow(llvm::Value* base, llvm::Value* exponent);              // pow(x, y)：设置 errno 时调用 C 库，否则使用 llvm.pow
+
     // 表达式代码生成
     llvm::Value* codegenExpr(ExprNode* node);                                       // 表达式代码生成入口
     llvm::Value* codegenIntLiteral(IntLiteralNode* node);                           // 生成整数字面量
@@ -160,6 +536,8 @@ private:
     void codegenVarDecl(VarDeclNode* node);                                         // 生成变量声明
     void codegenAssignment(AssignmentNode* node);                                   // 生成赋值语句
     void codegenFunctionDecl(FunctionDeclNode* node);                               // 生成函数声明
+    llvm::Function* declareFunction(FunctionDeclNode* node);                        // 声明函数原型（不生成函数体）
+    void codegenFunctionBody(FunctionDeclNode* node, llvm::Function* function);     // 生成函数体
     void codegenBlock(BlockNode* node);                                             // 生成代码块
     void codegenIfStmt(IfStmtNode* node);                                           // 生成 if 语句
     void codegenWhileStmt(WhileStmtNode* node);                                     // 生成 while 循环
@@ -172,6 +550,17 @@ private:
     void codegenThrow(ThrowStmtNode* node);                                         // 生成 throw 语句
     void codegenExprStmt(ExprStmtNode* node);                                       // 生成表达式语句
     
+    // 并行 IR 生成
+    CodeGenerator(CodeGenerator& parent, unsigned index);                           // 创建并行工作生成器（镜像主模块声明）
+    void generateFunctionBodiesParallel(const std::vector<FunctionDeclNode*>& nodes);   // 多线程生成函数体并合并
+    
+    // 交互式增量生成
+    void adoptDefinitions(CodeGenerator& part);                                     // 将增量模块中的新定义登记为本模块的外部声明
+    
+    // 并行目标代码生成
+    bool prepareTargetModule();                                                     // 设置目标三元组和数据布局
+    bool compileToObjectFileParts(const std::string& filename, std::vector<std::string>& parts);    // 拆分模块并行输出多个目标文件
+    
 public:
     // 构造函数：初始化代码生成器，创建 LLVM 模块
     CodeGenerator(const std::string& moduleName);
@@ -180,14 +569,30 @@ public:
     
     // 配置
     void setSourceDirectory(const std::string& dir) { sourceDirectory = dir; }  // 设置源文件目录（用于模块查找）
+    void setIRThreads(unsigned n) { irThreads = n > 0 ? n : 1; }    // 设置函数体 IR 生成线程数
+    void setCodegenThreads(unsigned n) { codegenThreads = n > 0 ? n : 1; }  // 设置目标代码生成线程数
+    void setStackArrayLimit(uint64_t bytes) { stackArrayLimit = bytes; }    // 设置局部数组放在栈上的最大字节数
+    void setFastMath(bool enable);                                          // -ffast-math：允许全部浮点优化，数学函数不设置 errno
+    void setFPContractFast(bool enable);                                    // -ffp-contract=fast：允许把乘法和加法收缩为 FMA
+    void setMathErrno(bool enable) { mathErrno = enable; }                  // -fno-math-errno：数学函数不设置 errno
+    
+    // 错误管理（使用当前线程的诊断状态）
+    bool hasErrors() const { return currentDiagnostics().errorCount > 0; }      // 检查是否有错误
+    int getErrorCount() const { return currentDiagnostics().errorCount; }       // 获取错误数量
+    int getWarningCount() const { return currentDiagnostics().warningCount; }   // 获取警告数量
     
-    // 错误管理（使用error.h中的全局函数和变量）
-    bool hasErrors() const { return g_errorCount > 0; }             // 检查是否有错误
-    int getErrorCount() const { return g_errorCount; }              // 获取错误数量
-    int getWarningCount() const { return g_warningCount; }          // 获取警告数量
+    // 符号查询
+    FunctionDeclNode* getFunctionPrototype(const std::string& name) const {     // 已定义函数的声明节点（不存在时返回 nullptr）
+        auto it = functionPrototypes.find(name);
+        return it != functionPrototypes.end() ? it->second : nullptr;
+    }
     
     // 代码生成
     bool generate(ProgramNode* root);                               // 主入口：从 AST 生成 LLVM IR
+    bool generateIncrement(ProgramNode* chunk,                      // 交互式：在独立的新上下文中生成一段输入
+                           const std::string& entryName,            // 顶层语句放入 void entryName()
+                           std::unique_ptr<llvm::LLVMContext>& outContext,
+                           std::unique_ptr<llvm::Module>& outModule);
     
     // 输出
     void printIR();                                                 // 打印 LLVM IR 到控制台
@@ -18,6 +18,8 @@
 #include <iomanip>
 #include <cstring>
 #include <algorithm>
+#include <mutex>
+#include <sstream>
 
 //  * 全局变量定义
 // ANSI 终端颜色代码
@@ -29,53 +31,74 @@ namespace ErrorColors {
     const char* RESET  = "\033[0m";     // 重置样式
 }
 
-// 源代码缓存
-std::vector<std::string> g_sourceLines;
-std::string g_sourceFilePath;
+// 诊断状态
+// 进程级的默认状态供命令行编译器使用，嵌入 API 的会话通过 DiagnosticScope 切换到自己的状态
+static DiagnosticState g_defaultDiagnostics;
+static thread_local DiagnosticState* t_currentDiagnostics = nullptr;
 
-// 错误统计
-int g_errorCount = 0;
-int g_warningCount = 0;
-int g_syntaxErrorCount = 0;
+// 详细日志开关
+thread_local bool g_verbose = false;
 
-// 警告控制选项
-bool g_enableAllWarnings = false;
-bool g_warningsAsErrors = false;
-bool g_suppressWarnings = false;
-bool g_enableUnusedWarnings = true;
-bool g_enableDeadCodeWarnings = true;
-bool g_enableMissingReturnWarnings = true;
-bool g_enableShadowWarnings = false;  // 需要 -Wall 或 -Wshadow 启用
+DiagnosticState& currentDiagnostics() {
+    return t_currentDiagnostics ? *t_currentDiagnostics : g_defaultDiagnostics;
+}
+
+DiagnosticScope::DiagnosticScope(DiagnosticState& state, bool verbose)
+    : previousState(t_currentDiagnostics), previousVerbose(g_verbose) {
+    t_currentDiagnostics = &state;
+    g_verbose = verbose;
+}
+
+DiagnosticScope::~DiagnosticScope() {
+    t_currentDiagnostics = previousState;
+    g_verbose = previousVerbose;
+}
 
 
 // 源文件管理
 // 加载源文件到内存缓存
 void loadSourceFile(const std::string& filename) {
-    g_sourceFilePath = filename;
-    g_sourceLines.clear();
+    DiagnosticState& state = currentDiagnostics();
+    state.sourceFilePath = filename;
+    state.sourceLines.clear();
     std::ifstream file(filename);
     if (file.is_open()) {
         std::string line;
         while (std::getline(file, line)) {
-            g_sourceLines.push_back(line);
+            state.sourceLines.push_back(line);
         }
         file.close();
     }
 }
 
+// 从内存加载源代码，name 作为诊断信息中显示的文件名
+void loadSourceText(const std::string& name, const std::string& text) {
+    DiagnosticState& state = currentDiagnostics();
+    state.sourceFilePath = name;
+    state.sourceLines.clear();
+    std::istringstream stream(text);
+    std::string line;
+    while (std::getline(stream, line)) {
+        state.sourceLines.push_back(line);
+    }
+}
+
 // 获取指定行的源代码（行号从1开始）
 std::string getSourceLine(int lineNum) {
-    if (lineNum > 0 && lineNum <= static_cast<int>(g_sourceLines.size())) {
-        return g_sourceLines[lineNum - 1];
+    const std::vector<std::string>& sourceLines = currentDiagnostics().sourceLines;
+    if (lineNum > 0 && lineNum <= static_cast<int>(sourceLines.size())) {
+        return sourceLines[lineNum - 1];
     }
     return "";
 }
 
 // 重置错误和警告计数器
 void resetErrorCounts() {
-    g_errorCount = 0;
-    g_warningCount = 0;
-    g_syntaxErrorCount = 0;
+    DiagnosticState& state = currentDiagnostics();
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
+    state.errorCount = 0;
+    state.warningCount = 0;
+    state.syntaxErrorCount = 0;
 }
 
 
@@ -104,7 +127,7 @@ bool endsWith(const std::string& str, const std::string& suffix) {
 // 统计源代码中未匹配的括号数量（跳过注释和字符串）
 void countBrackets(int& braces, int& brackets, int& parens) {
     braces = brackets = parens = 0;
-    for (const auto& line : g_sourceLines) {
+    for (const auto& line : currentDiagnostics().sourceLines) {
         bool inString = false;
         bool inComment = false;
         for (size_t i = 0; i < line.length(); i++) {
@@ -132,7 +155,7 @@ void countBrackets(int& braces, int& brackets, int& parens) {
 // 显示源代码上下文（不显示列指向）
 void displaySourceContext(int line, int column, bool isError) {
     (void)column;  // 不再使用列号
-    if (line <= 0 || g_sourceLines.empty()) return;
+    if (line <= 0 || currentDiagnostics().sourceLines.empty()) return;
     
     std::cerr << std::endl;
     int startLine = std::max(1, line - 2);
@@ -168,6 +191,7 @@ static const struct { const char* from; const char* to; } tokenTranslations[] =
     {"BOOL_LITERAL", "布尔值"},
     {"INT_LITERAL", "整数"},
     {"IDENTIFIER", "标识符"},
+    {"ANNOTATION", "注解"},
     
     // 复合运算符
     {"PLUS_ASSIGN", "'+='"},
@@ -200,6 +224,8 @@ static const struct { const char* from; const char* to; } tokenTranslations[] =
     {"CATCH", "'catch'"},
     {"THROW", "'throw'"},
     {"CONST", "'const'"},
+    {"LIST", "'list'"},
+    {"MAP", "'map'"},
     {"ELSE", "'else'"},
     {"CASE", "'case'"},
     {"FUNC", "'func'"},
@@ -281,8 +307,108 @@ std::string translateSemanticError(const std::string& msg) {
         return "未定义的函数";
     }
     
+    // SIMD 向量
+    if (msg.find("Invalid vector type") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.find("'", start + 1);
+        std::string name = (start != std::string::npos && end != std::string::npos) ? msg.substr(start + 1, end - start - 1) : "";
+        return "无效的向量类型 '" + name + "'：元素类型必须是 int 或 double，元素个数必须是 2 到 64 之间 2 的幂";
+    }
+    if (msg.find("() expects 0, 1, 2 (array, index) or ") != std::string::npos) {
+        std::string name = msg.substr(0, msg.find("() expects"));
+        size_t orPos = msg.find(" or ");
+        size_t argPos = msg.find(" arguments but got ");
+        if (orPos != std::string::npos && argPos != std::string::npos)
+            return name + "() 需要 0 个、1 个、2 个（数组, 下标）或 " + msg.substr(orPos + 4, argPos - orPos - 4) +
+                   " 个参数，实际为 " + msg.substr(argPos + 19) + " 个";
+    }
+    if (msg.find("() expects int or double values but got") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        std::string name = msg.substr(0, msg.find("() expects"));
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return name + "() 的参数必须是 int 或 double，实际为 '" + msg.substr(start + 1, end - start - 1) + "'";
+    }
+    if (msg.find("Vector type mismatch") != std::string::npos || msg.find("dot() expects two vectors") != std::string::npos ||
+        msg.find("cannot combine") != std::string::npos || msg.find("is not supported for vector type") != std::string::npos ||
+        msg.find("Vector lane index") != std::string::npos || msg.find("Vector element type") != std::string::npos) {
+        std::vector<std::string> quoted;
+        for (size_t pos = msg.find('\''); pos != std::string::npos; pos = msg.find('\'', pos + 1)) {
+            size_t end = msg.find('\'', pos + 1);
+            if (end == std::string::npos) break;
+            quoted.push_back(msg.substr(pos + 1, end - pos - 1));
+            pos = end;
+        }
+        if (msg.find("Vector type mismatch") != std::string::npos && quoted.size() == 2)
+            return "向量类型不匹配: '" + quoted[0] + "' 和 '" + quoted[1] + "'";
+        if (msg.find("dot() expects two vectors") != std::string::npos && quoted.size() == 2)
+            return "dot() 的两个向量类型必须相同（'" + quoted[0] + "' 和 '" + quoted[1] + "'）";
+        if (msg.find("cannot combine") != std::string::npos && quoted.size() == 3)
+            return "运算符 '" + quoted[0] + "' 不能用于 '" + quoted[1] + "' 和 '" + quoted[2] + "'";
+        if (msg.find("is not supported for vector type") != std::string::npos && quoted.size() == 2)
+            return "向量类型 '" + quoted[1] + "' 不支持运算符 '" + quoted[0] + "'";
+        if (msg.find("Vector lane index") != std::string::npos && quoted.size() == 1) {
+            size_t numPos = msg.find("index ") + 6;
+            return "向量下标 " + msg.substr(numPos, msg.find(' ', numPos) - numPos) + " 超出 '" + quoted[0] + "' 的范围";
+        }
+        if (msg.find("Vector element type") != std::string::npos && quoted.size() == 2)
+            return "向量元素类型 '" + quoted[0] + "' 与数组元素类型 '" + quoted[1] + "' 不一致";
+    }
+    if (msg.find("Vector lane assignment target must be a variable") != std::string::npos)
+        return "只能给向量变量的元素赋值";
+    if (msg.find("store() expects 3 arguments") != std::string::npos)
+        return "store() 需要 3 个参数（向量, 数组, 下标）";
+    if (msg.find("Unknown vector method") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return "向量没有方法 '" + msg.substr(start + 1, end - start - 1) + "'";
+        return "未知的向量方法";
+    }
+    
+    // 循环注解和优化提示
+    if (msg.find("Unknown loop annotation") != std::string::npos || msg.find("Unknown function annotation") != std::string::npos ||
+        msg.find("Duplicate annotation") != std::string::npos ||
+        msg.find("does not take an argument") != std::string::npos || msg.find("Loop hint '") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.find("'", start + 1);
+        std::string name = (start != std::string::npos && end != std::string::npos) ? msg.substr(start + 1, end - start - 1) : "";
+        if (msg.find("Unknown loop annotation") != std::string::npos)
+            return "未知的循环注解 '" + name + "'";
+        if (msg.find("Unknown function annotation") != std::string::npos)
+            return "未知的函数注解 '" + name + "'";
+        if (msg.find("Duplicate annotation") != std::string::npos)
+            return "重复的注解 '" + name + "'";
+        if (msg.find("does not take an argument") != std::string::npos)
+            return "注解 '" + name + "' 不接受参数";
+        size_t colon = msg.find(": ", end);
+        std::string detail = colon != std::string::npos ? msg.substr(colon + 2) : "";
+        size_t removed = detail.find(" runtime check(s) removed");
+        if (removed != std::string::npos)
+            detail = "省略了 " + detail.substr(0, removed) + " 个运行时检查";
+        if (detail == "the optimizer could not transform the loop")
+            detail = "优化器无法按要求变换这个循环";
+        if (msg.find("' applied") != std::string::npos)
+            return "循环提示 '" + name + "' 已生效: " + detail;
+        if (msg.find("' was not applied") != std::string::npos)
+            return "循环提示 '" + name + "' 未生效: " + detail;
+    }
+    if (msg.find("Unroll count must be between 1 and 1024, got ") != std::string::npos)
+        return "@unroll 的展开次数必须在 1 到 1024 之间，实际为 " + msg.substr(msg.find("got ") + 4);
+    if (msg.find("Vectorize width must be a power of two between 2 and 64, got ") != std::string::npos)
+        return "@vectorize 的向量宽度必须是 2 到 64 之间 2 的幂，实际为 " + msg.substr(msg.find("got ") + 4);
+    
     // 类型不匹配
     if (msg.find("Type mismatch") != std::string::npos) {
+        if (msg.find("cannot return") != std::string::npos) {
+            size_t start = msg.find("'");
+            size_t mid = msg.find("' from function returning '");
+            if (start != std::string::npos && mid != std::string::npos && msg.back() == '\'') {
+                std::string fromType = msg.substr(start + 1, mid - start - 1);
+                std::string toType = msg.substr(mid + 27, msg.length() - mid - 28);
+                return "类型不匹配: 函数返回 '" + toType + "'，不能返回 '" + fromType + "'";
+            }
+        }
         if (msg.find("cannot assign") != std::string::npos) {
             size_t toPos = msg.find(" to ");
             if (toPos != std::string::npos) {
@@ -294,6 +420,17 @@ std::string translateSemanticError(const std::string& msg) {
                 return "类型不匹配: 无法将 " + fromType + " 赋值给 '" + toType + "' 类型";
             }
         }
+        if (msg.find("for argument") != std::string::npos && msg.find("expected") != std::string::npos) {
+            std::vector<std::string> quoted;
+            for (size_t pos = msg.find('\''); pos != std::string::npos; pos = msg.find('\'', pos + 1)) {
+                size_t end = msg.find('\'', pos + 1);
+                if (end == std::string::npos) break;
+                quoted.push_back(msg.substr(pos + 1, end - pos - 1));
+                pos = end;
+            }
+            if (quoted.size() == 3)
+                return "类型不匹配: 函数 '" + quoted[0] + "' 的参数期望 '" + quoted[1] + "'，实际为 '" + quoted[2] + "'";
+        }
         return "类型不匹配";
     }
     
@@ -312,6 +449,229 @@ std::string translateSemanticError(const std::string& msg) {
         return "标识符已定义";
     }
     
+    // 映射和动态数组内置函数的参数数量（先于通用的参数数量错误匹配）
+    if (msg.find("has() expects 2 arguments") != std::string::npos)
+        return "has() 需要 2 个参数（映射, 键）";
+    if (msg.find("push() expects") != std::string::npos)
+        return "push() 需要 2 个参数（动态数组, 值）";
+    if (msg.find("pop() expects") != std::string::npos)
+        return "pop() 需要 1 个参数（动态数组）";
+    if (msg.find("reserve() expects 2 arguments") != std::string::npos)
+        return "reserve() 需要 2 个参数（动态数组, 容量）";
+    
+    // 线程和通道
+    if (msg.find("spawn expects a call to a user-defined function") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return "spawn 只能调用用户定义的函数，'" + msg.substr(start + 1, end - start - 1) + "' 不是用户定义的函数";
+        return "spawn 只能调用用户定义的函数";
+    }
+    if (msg.find("spawn cannot pass fixed-size array parameter") != std::string::npos) {
+        size_t first = msg.find("'");
+        size_t firstEnd = msg.find("'", first + 1);
+        size_t second = msg.find("'", firstEnd + 1);
+        size_t secondEnd = msg.rfind("'");
+        if (first != std::string::npos && second != std::string::npos && second < secondEnd)
+            return "spawn 不能把函数 '" + msg.substr(second + 1, secondEnd - second - 1) + "' 的定长数组参数 '" +
+                   msg.substr(first + 1, firstEnd - first - 1) + "' 传给其他线程";
+        return "spawn 不能把定长数组参数传给其他线程";
+    }
+    if (msg.find("Unknown channel method") != std::string::npos || msg.find("Unknown future method") != std::string::npos) {
+        std::string kind = msg.find("channel") != std::string::npos ? "通道" : "future ";
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return kind + "没有方法 '" + msg.substr(start + 1, end - start - 1) + "'";
+        return "未知的" + kind + "方法";
+    }
+    if (msg.find("Channel capacity must be an int") != std::string::npos)
+        return "通道容量必须是整数";
+    if (msg.find("Channel capacity must be positive") != std::string::npos)
+        return "通道容量必须是正数";
+    if (msg.find("send() expects 2 arguments") != std::string::npos)
+        return "send() 需要 2 个参数（通道, 值）";
+    if (msg.find("join() expects 1 argument") != std::string::npos)
+        return "join() 需要 1 个参数（future）";
+    if (msg.find("() expects 1 argument (channel)") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 需要 1 个参数（通道）";
+    if (msg.find("does not match channel element type") != std::string::npos) {
+        size_t first = msg.find("'");
+        size_t firstEnd = msg.find("'", first + 1);
+        size_t second = msg.find("'", firstEnd + 1);
+        size_t secondEnd = msg.rfind("'");
+        if (first != std::string::npos && second != std::string::npos && second < secondEnd)
+            return "send() 的值类型 '" + msg.substr(first + 1, firstEnd - first - 1) +
+                   "' 与通道元素类型 '" + msg.substr(second + 1, secondEnd - second - 1) + "' 不一致";
+        return "send() 的值类型与通道元素类型不一致";
+    }
+    
+    // 生成器
+    if (msg.find("can only be iterated by a for loop") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return "生成器 '" + msg.substr(start + 1, end - start - 1) + "' 只能由 for 循环遍历";
+        return "生成器只能由 for 循环遍历";
+    }
+    if (msg.find("cannot return a value, use 'yield'") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.find("'", start + 1);
+        if (start != std::string::npos && end != std::string::npos)
+            return "生成器 '" + msg.substr(start + 1, end - start - 1) + "' 不能返回值，请使用 'yield' 产出值";
+        return "生成器不能返回值，请使用 'yield' 产出值";
+    }
+    if (msg.find("'yield' can only be used in a generator function") != std::string::npos)
+        return "'yield' 只能在生成器函数（返回类型为 gen<T>）中使用";
+    if (msg.find("'yield' cannot be used inside a try block") != std::string::npos)
+        return "'yield' 不能在 try 块中使用";
+    if (msg.find("does not match generator element type") != std::string::npos) {
+        size_t first = msg.find("'");
+        size_t firstEnd = msg.find("'", first + 1);
+        size_t second = msg.find("'", firstEnd + 1);
+        size_t secondEnd = msg.rfind("'");
+        if (first != std::string::npos && second != std::string::npos && second < secondEnd)
+            return "yield 的值类型 '" + msg.substr(first + 1, firstEnd - first - 1) +
+                   "' 与生成器元素类型 '" + msg.substr(second + 1, secondEnd - second - 1) + "' 不一致";
+        return "yield 的值类型与生成器元素类型不一致";
+    }
+    
+    // 文件内置函数
+    if (msg.find("() expects a file as its first argument") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的第一个参数必须是 file";
+    if (msg.find("() expects 1 argument (file)") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 需要 1 个参数（文件）";
+    if (msg.find("write() expects 2 arguments") != std::string::npos)
+        return "write() 需要 2 个参数（文件, 值）";
+    if (msg.find("write() cannot write a value of type") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return "write() 不能写入 '" + msg.substr(start + 1, end - start - 1) + "' 类型的值";
+        return "write() 不能写入该类型的值";
+    }
+    if (msg.find("open() expects 1 or 2 arguments") != std::string::npos)
+        return "open() 需要 1 或 2 个参数（路径, 模式）";
+    if (msg.find("open() expects a string path") != std::string::npos)
+        return "open() 的路径必须是字符串";
+    if (msg.find("open() expects a string mode") != std::string::npos || msg.find("open() mode must be") != std::string::npos)
+        return "open() 的模式必须是 \"r\"、\"w\" 或 \"a\"";
+    if (msg.find("lines() can only be used in a for loop") != std::string::npos)
+        return "lines() 只能用在 for 循环中";
+    if (msg.find("lines() expects 1 argument") != std::string::npos)
+        return "lines() 需要 1 个参数（路径或文件）";
+    if (msg.find("lines() expects a string path or a file") != std::string::npos)
+        return "lines() 的参数必须是字符串路径或 file";
+    
+    // 数组内置函数
+    if (msg.find("() expects 1 argument (array)") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 需要 1 个参数（数组）";
+    if (msg.find("binary_search() expects 2 arguments") != std::string::npos)
+        return "binary_search() 需要 2 个参数（数组, 值）";
+    if (msg.find("() expects an array as its first argument") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的第一个参数必须是数组";
+    if (msg.find("() does not support multi-dimensional arrays") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 不支持多维数组";
+    if (msg.find("() does not support arrays of type") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return msg.substr(0, msg.find("()")) + "() 不支持元素类型为 '" + msg.substr(start + 1, end - start - 1) + "' 的数组";
+        return msg.substr(0, msg.find("()")) + "() 不支持该元素类型的数组";
+    }
+    if (msg.find("() cannot modify a constant array") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 不能修改常量数组";
+    if (msg.find("binary_search() value of type") != std::string::npos) {
+        size_t first = msg.find("'");
+        size_t firstEnd = msg.find("'", first + 1);
+        size_t second = msg.find("'", firstEnd + 1);
+        size_t secondEnd = msg.rfind("'");
+        if (first != std::string::npos && second != std::string::npos && second < secondEnd)
+            return "binary_search() 查找的值类型 '" + msg.substr(first + 1, firstEnd - first - 1) +
+                   "' 与数组元素类型 '" + msg.substr(second + 1, secondEnd - second - 1) + "' 不一致";
+        return "binary_search() 查找的值类型与数组元素类型不一致";
+    }
+    if (msg.find("dot() expects 2 arguments") != std::string::npos)
+        return "dot() 需要 2 个参数（数组, 数组）";
+    if (msg.find("copy() expects 2 arguments") != std::string::npos)
+        return "copy() 需要 2 个参数（目标数组, 源数组）";
+    if (msg.find("fill() expects 2 arguments") != std::string::npos)
+        return "fill() 需要 2 个参数（数组, 值）";
+    if (msg.find("scale() expects 2 arguments") != std::string::npos)
+        return "scale() 需要 2 个参数（数组, 系数）";
+    if (msg.find("axpy() expects 3 arguments") != std::string::npos)
+        return "axpy() 需要 3 个参数（数组, 系数, 数组）";
+    if (msg.find("() expects an int or double array") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的参数必须是 int 或 double 数组";
+    if (msg.find("() expects an array as its second argument") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的第二个参数必须是数组";
+    if (msg.find("() expects an array as its third argument") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的第三个参数必须是数组";
+    if (msg.find("() expects arrays of the same element type") != std::string::npos) {
+        size_t open = msg.find("(", msg.find("type"));
+        size_t and_ = msg.find(" and ", open == std::string::npos ? 0 : open);
+        if (open != std::string::npos && and_ != std::string::npos)
+            return msg.substr(0, msg.find("()")) + "() 的两个数组元素类型必须相同（" + msg.substr(open + 1, and_ - open - 1) +
+                   " 和 " + msg.substr(and_ + 5, msg.size() - and_ - 6) + "）";
+        return msg.substr(0, msg.find("()")) + "() 的两个数组元素类型必须相同";
+    }
+    if (msg.find("() arrays have different lengths") != std::string::npos) {
+        size_t open = msg.find("(", msg.find("lengths"));
+        size_t and_ = msg.find(" and ", open == std::string::npos ? 0 : open);
+        if (open != std::string::npos && and_ != std::string::npos)
+            return msg.substr(0, msg.find("()")) + "() 的两个数组长度不同（" + msg.substr(open + 1, and_ - open - 1) +
+                   " 和 " + msg.substr(and_ + 5, msg.size() - and_ - 6) + "）";
+        return msg.substr(0, msg.find("()")) + "() 的两个数组长度不同";
+    }
+    if (msg.find("() value of type") != std::string::npos && msg.find("does not match array element type") != std::string::npos) {
+        size_t first = msg.find("'");
+        size_t firstEnd = msg.find("'", first + 1);
+        size_t second = msg.find("'", firstEnd + 1);
+        size_t secondEnd = msg.rfind("'");
+        if (first != std::string::npos && second != std::string::npos && second < secondEnd)
+            return msg.substr(0, msg.find("()")) + "() 的值类型 '" + msg.substr(first + 1, firstEnd - first - 1) +
+                   "' 与数组元素类型 '" + msg.substr(second + 1, secondEnd - second - 1) + "' 不一致";
+        return msg.substr(0, msg.find("()")) + "() 的值类型与数组元素类型不一致";
+    }
+    
+    // 数值输入内置函数
+    if (msg.find("() expects a string as its first argument") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的第一个参数必须是字符串";
+    if (msg.find("variable as its second argument") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的第二个参数必须是 " +
+               (msg.find("a double") != std::string::npos ? "double" : "int") + " 类型的变量";
+    if (msg.find("() expects an int count") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的参数必须是整数";
+    if (msg.find("() expects 1 argument (count)") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 需要 1 个参数（数量）";
+    if (msg.find("read_all() expects no arguments") != std::string::npos)
+        return "read_all() 不需要参数";
+    
+    // 字符串内置函数
+    if (msg.find("() expects string arguments") != std::string::npos)
+        return msg.substr(0, msg.find("()")) + "() 的参数必须是字符串";
+    if (msg.find("() expects") != std::string::npos && msg.find("(string") != std::string::npos) {
+        static const std::pair<const char*, const char*> words[] = {
+            {"string", "字符串"}, {"substring", "子串"}, {"prefix", "前缀"}, {"suffix", "后缀"},
+            {"separator", "分隔符"}, {"old", "旧子串"}, {"new", "新子串"}, {"variable", "变量"}};
+        std::string params = msg.substr(msg.rfind('(') + 1);
+        params = params.substr(0, params.find(')'));
+        std::string translated;
+        size_t count = 0;
+        for (size_t pos = 0; pos <= params.size(); count++) {
+            size_t comma = params.find(", ", pos);
+            std::string word = params.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+            for (const auto& entry : words) {
+                if (word == entry.first) {
+                    word = entry.second;
+                }
+            }
+            translated += (translated.empty() ? "" : ", ") + word;
+            pos = comma == std::string::npos ? params.size() + 1 : comma + 2;
+        }
+        return msg.substr(0, msg.find("()")) + "() 需要 " + std::to_string(count) + " 个参数（" + translated + "）";
+    }
+    
     // 参数数量错误
     if (msg.find("expects") != std::string::npos && msg.find("argument") != std::string::npos) {
         return "函数参数数量不正确";
@@ -388,6 +748,68 @@ std::string translateSemanticError(const std::string& msg) {
     }
     if (msg.find("Array index must be integer") != std::string::npos)
         return "数组索引必须是整数类型";
+    if (msg.find("Inconsistent array dimensions") != std::string::npos)
+        return "数组维度不一致: 字面量的嵌套层数与数组的维度不符";
+    if (msg.find("Array initializer must be an array literal") != std::string::npos)
+        return "数组的初始值必须是数组字面量";
+    if (msg.find("Global constant array elements must be constants") != std::string::npos)
+        return "全局常量数组的元素必须是常量";
+    
+    // 映射相关（消息中依次带有引号括起的期望类型和实际类型）
+    if (msg.find("Map key type mismatch") != std::string::npos ||
+        msg.find("Map value type mismatch") != std::string::npos ||
+        msg.find("List element type mismatch") != std::string::npos ||
+        msg.find("Array element type mismatch") != std::string::npos) {
+        std::vector<std::string> quoted;
+        for (size_t pos = msg.find('\''); pos != std::string::npos; pos = msg.find('\'', pos + 1)) {
+            size_t end = msg.find('\'', pos + 1);
+            if (end == std::string::npos) break;
+            quoted.push_back(msg.substr(pos + 1, end - pos - 1));
+            pos = end;
+        }
+        std::string what = msg.find("Map key") != std::string::npos     ? "映射键"
+                           : msg.find("Map value") != std::string::npos   ? "映射值"
+                           : msg.find("Array element") != std::string::npos ? "数组元素"
+                                                                          : "动态数组元素";
+        if (quoted.size() == 2)
+            return what + "类型不匹配: 期望 '" + quoted[0] + "'，实际为 '" + quoted[1] + "'";
+        return what + "类型不匹配";
+    }
+    if (msg.find("not supported for string map values") != std::string::npos)
+        return "值为字符串的映射不支持复合赋值";
+    if (msg.find("Cannot infer the type of empty map literal") != std::string::npos)
+        return "无法推断空映射字面量 '[:]' 的类型，请将变量声明为 map<K,V>";
+    if (msg.find("has() expects a map") != std::string::npos)
+        return "has() 的第一个参数必须是映射";
+    
+    // 动态数组相关
+    if (msg.find("not supported for string list elements") != std::string::npos)
+        return "元素为字符串的动态数组不支持复合赋值";
+    if (msg.find("Unknown list method") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return "动态数组没有方法 '" + msg.substr(start + 1, end - start - 1) + "'";
+        return "未知的动态数组方法";
+    }
+    if (msg.find("reserve() expects an integer") != std::string::npos)
+        return "reserve() 的容量必须是整数";
+    if (msg.find("Cannot slice") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return "无法对 '" + msg.substr(start + 1, end - start - 1) + "' 类型的值切片";
+        return "无法对该值切片";
+    }
+    if (msg.find("Slice bounds must be integer") != std::string::npos)
+        return "切片边界必须是整数类型";
+    if (msg.find("Cannot iterate over") != std::string::npos) {
+        size_t start = msg.find("'");
+        size_t end = msg.rfind("'");
+        if (start != std::string::npos && end != std::string::npos && start < end)
+            return "无法遍历 '" + msg.substr(start + 1, end - start - 1) + "' 类型的值";
+        return "无法遍历该值";
+    }
     
     // 缺少 main 函数
     if (msg.find("No 'main' function defined") != std::string::npos)
@@ -600,6 +1022,30 @@ std::string generateSemanticHint(const std::string& message, int line) {
         return "提示: 请检查函数是否已定义，注意拼写是否正确";
     }
     
+    // SIMD 向量
+    if (message.find("Invalid vector type") != std::string::npos)
+        return "提示: 向量类型写作 vec<T,N>，例如 vec<double,4>、vec<int,8>";
+    if (message.find("Vector lane index") != std::string::npos)
+        return "提示: vec<T,N> 的下标范围是 0 到 N-1";
+    if (message.find("Vector type mismatch") != std::string::npos || message.find("dot() expects two vectors") != std::string::npos)
+        return "提示: 两个向量的元素个数必须相同；int 向量与 double 向量运算时会先转换为 double 向量";
+    if (message.find("Unknown vector method") != std::string::npos)
+        return "提示: 向量支持 sum()、min()、max()、dot(v) 和 store(array, index)";
+    if (message.find("Vector element type") != std::string::npos)
+        return "提示: 向量与数组之间的加载和存储要求元素类型相同，例如 vec<double,4>(a, i) 中 a 必须是 double 数组";
+    
+    // 循环注解、函数注解和优化提示
+    if (message.find("Unknown function annotation") != std::string::npos || message.find("'@fastmath' does not take") != std::string::npos)
+        return "提示: 函数注解只有 @fastmath，写在 func 之前，允许这个函数的浮点运算重结合和收缩为 FMA";
+    if (message.find("Unknown loop annotation") != std::string::npos || message.find("does not take an argument") != std::string::npos)
+        return "提示: 循环注解有 @unroll、@unroll(N)、@vectorize、@vectorize(W) 和 @nocheck，写在 while 或 for 之前";
+    if (message.find("Duplicate annotation") != std::string::npos)
+        return "提示: 同一个循环或函数的每种注解只能写一次";
+    if (message.find("Unroll count must be") != std::string::npos)
+        return "提示: @unroll(1) 禁止展开，不写参数的 @unroll 要求完全展开";
+    if (message.find("Vectorize width must be") != std::string::npos)
+        return "提示: 不写参数的 @vectorize 由编译器选择向量宽度";
+    
     if (message.find("Type mismatch") != std::string::npos || 
         message.find("type mismatch") != std::string::npos)
         return "提示: 请检查赋值和运算两侧的类型是否一致";
@@ -622,6 +1068,18 @@ std::string generateSemanticHint(const std::string& message, int line) {
     if (message.find("Array index must be integer") != std::string::npos)
         return "提示: 数组索引必须是整数类型，不能使用浮点数作为索引";
     
+    // 映射
+    if (message.find("Cannot iterate over") != std::string::npos)
+        return "提示: for ... in 可以遍历 map<K,V> 的键、list<T> 的元素、chan<T> 接收到的值和 gen<T> 生成器产出的值，整数范围请使用 'for i in a..b'";
+    if (message.find("empty map literal") != std::string::npos)
+        return "提示: 例如 'let m: map<string, int> = [:]'";
+    
+    // 动态数组
+    if (message.find("Unknown list method") != std::string::npos)
+        return "提示: 动态数组支持 push(v)、pop()、reserve(n) 以及 sort() 等排序和查找方法，长度使用 len(a)";
+    if (message.find("Cannot slice") != std::string::npos)
+        return "提示: 切片 a[from..to] 只能用于 list<T> 和 string";
+    
     // 常量重新赋值
     if (message.find("Cannot reassign") != std::string::npos || 
         message.find("reassign") != std::string::npos)
@@ -649,6 +1107,74 @@ std::string generateSemanticHint(const std::string& message, int line) {
     if (message.find("continue") != std::string::npos && message.find("loop") != std::string::npos)
         return "提示: 'continue' 语句只能在循环语句中使用";
     
+    // 线程和通道
+    if (message.find("spawn expects a call to a user-defined function") != std::string::npos)
+        return "提示: spawn 后面是对用户函数的直接调用，例如 let h: future<int> = spawn work(n)，内置函数请包装在用户函数中";
+    if (message.find("spawn cannot pass fixed-size array parameter") != std::string::npos)
+        return "提示: 定长数组在调用方的栈上，线程可能比调用方活得更久；请改用 list<T> 参数";
+    if (message.find("Unknown channel method") != std::string::npos)
+        return "提示: 通道支持 c.send(v)、c.recv()、c.close()，也可以用 for x in c 接收到通道关闭为止";
+    if (message.find("Unknown future method") != std::string::npos)
+        return "提示: future 只支持 h.join()，等待线程结束并取得返回值";
+    if (message.find("Channel capacity") != std::string::npos)
+        return "提示: 例如 chan<int>(128)，省略容量时为 64，容量向上取整为 2 的幂";
+    if (message.find("does not match channel element type") != std::string::npos)
+        return "提示: int 值可以发送到 chan<double>，其他类型必须与通道元素类型相同";
+    
+    // 生成器
+    if (message.find("can only be iterated by a for loop") != std::string::npos)
+        return "提示: 生成器的调用只能写在 for 循环中，例如 for x in count(0, 10) { ... }";
+    if (message.find("cannot return a value, use 'yield'") != std::string::npos)
+        return "提示: 生成器用 yield v 产出值，不带值的 return 提前结束生成器";
+    if (message.find("'yield' can only be used in a generator function") != std::string::npos)
+        return "提示: 把函数的返回类型声明为 gen<T>，例如 func count(n: int): gen<int> { ... }";
+    if (message.find("'yield' cannot be used inside a try block") != std::string::npos)
+        return "提示: 异常只在当前函数内传递，生成器挂起时 try 块无法保留；请把 yield 移到 try 块之外";
+    if (message.find("does not match generator element type") != std::string::npos)
+        return "提示: int 值可以由 gen<double> 产出，其他类型必须与生成器元素类型相同";
+    
+    // 文件内置函数
+    if (message.find("() expects a file as its first argument") != std::string::npos)
+        return "提示: 第一个参数是 open() 返回的文件，例如 let f: file = open(path) 之后调用 read_line(f)";
+    if (message.find("open() mode") != std::string::npos || message.find("open() expects a string mode") != std::string::npos)
+        return "提示: \"r\" 读取，\"w\" 清空后写入，\"a\" 追加写入";
+    if (message.find("lines() can only be used in a for loop") != std::string::npos)
+        return "提示: 逐行遍历文件请写成 for line in lines(path) { ... }，单独读取一行请使用 read_line(f)";
+    if (message.find("write() cannot write") != std::string::npos)
+        return "提示: write() 可以写入字符串和 int、double、bool、char 值，映射和动态数组需要逐个元素写入";
+    
+    // 数组内置函数
+    if (message.find("() expects an array as its first argument") != std::string::npos)
+        return "提示: 参数可以是 list<T> 或一维定长数组（如 let a: int[10] = ...），元素类型为 int、double、char 或 string";
+    if (message.find("() does not support") != std::string::npos && message.find("arrays") != std::string::npos)
+        return "提示: 排序和查找支持元素类型为 int、double、char 或 string 的一维数组";
+    if (message.find("() cannot modify a constant array") != std::string::npos)
+        return "提示: 常量数组只能读取（如 binary_search()、min_index()、sum()、dot()），需要修改时请复制到 let 声明的数组";
+    if (message.find("binary_search() value of type") != std::string::npos)
+        return "提示: 查找的值必须与数组元素类型相同，int 值可以在 double 数组中查找";
+    if (message.find("() expects an int or double array") != std::string::npos)
+        return "提示: sum()、min()、max()、dot()、fill()、copy()、scale()、axpy() 支持元素类型为 int 或 double 的一维数组";
+    if (message.find("() expects an array as its") != std::string::npos)
+        return "提示: 数组参数可以是 list<T> 或一维定长数组，例如 dot(a, b)、copy(dst, src)、axpy(y, 2.0, x)";
+    if (message.find("() expects arrays of the same element type") != std::string::npos)
+        return "提示: 两个数组的元素类型必须相同，int 数组需要逐个元素转换后才能与 double 数组计算";
+    if (message.find("() arrays have different lengths") != std::string::npos)
+        return "提示: dot() 和 axpy() 逐个元素计算，两个数组的长度必须相同；copy() 只复制较短的长度";
+    if (message.find("does not match array element type") != std::string::npos)
+        return "提示: int 值可以用于 double 数组，double 值不能用于 int 数组";
+    
+    // 数值输入内置函数
+    if (message.find("variable as its second argument") != std::string::npos)
+        return "提示: 解析结果写入第二个参数指定的变量，例如 let n: int = 0 之后调用 parse_int(text, n)";
+    if (message.find("() expects a string as its first argument") != std::string::npos)
+        return "提示: 第一个参数是要解析的文本，可以是字符串变量、字面量或切片";
+    if (message.find("() expects an int count") != std::string::npos)
+        return "提示: 参数是要读取的数的个数，例如 read_ints(n)";
+    
+    // 字符串内置函数
+    if (message.find("() expects string arguments") != std::string::npos)
+        return "提示: 字符串内置函数的参数可以是字符串变量、字面量、切片或返回字符串的表达式";
+    
     // 参数数量错误
     if (message.find("expects") != std::string::npos || message.find("argument") != std::string::npos)
         return "提示: 请检查函数调用时传入的参数数量";
@@ -661,13 +1187,19 @@ std::string generateSemanticHint(const std::string& message, int line) {
 // 报告语义错误（带源代码上下文和修复建议）
 void reportError(const std::string& message, int line, int column) {
     (void)column;  // 不再使用列号
+    DiagnosticState& state = currentDiagnostics();
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
     
     // 翻译错误消息为中文
     std::string translatedMsg = translateSemanticError(message);
+    std::string hint = generateSemanticHint(message, line);
+    state.diagnostics.push_back({Diagnostic::Error, state.sourceFilePath, line, translatedMsg, hint});
+    state.errorCount++;
+    if (!state.printDiagnostics) return;
     
     // 输出位置信息（显示行号）
     std::cerr << ErrorColors::BOLD;
-    if (!g_sourceFilePath.empty()) std::cerr << g_sourceFilePath << ":";
+    if (!state.sourceFilePath.empty()) std::cerr << state.sourceFilePath << ":";
     if (line > 0) std::cerr << line << ": ";
     
     // 输出错误信息
@@ -676,27 +1208,30 @@ void reportError(const std::string& message, int line, int column) {
     
     // 显示上下文（不带列指向）
     displaySourceContext(line, 0, true);
-    std::string hint = generateSemanticHint(message, line);
     if (!hint.empty())
         std::cerr << ErrorColors::CYAN << hint << ErrorColors::RESET << std::endl;
     
     std::cerr << std::endl;
-    g_errorCount++;
 }
 
 // 报告警告信息
 void reportWarning(const std::string& message, int line, int column) {
     (void)column;  // 不再使用列号
+    DiagnosticState& state = currentDiagnostics();
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
     
-    if (g_suppressWarnings) return;
-    if (g_warningsAsErrors) { reportError(message, line, column); return; }
+    if (state.suppressWarnings) return;
+    if (state.warningsAsErrors) { reportError(message, line, column); return; }
     
     // 翻译警告消息为中文
     std::string translatedMsg = translateSemanticError(message);
+    state.diagnostics.push_back({Diagnostic::Warning, state.sourceFilePath, line, translatedMsg, ""});
+    state.warningCount++;
+    if (!state.printDiagnostics) return;
     
     // 输出位置信息（只显示行号）
     std::cerr << ErrorColors::BOLD;
-    if (!g_sourceFilePath.empty()) std::cerr << g_sourceFilePath << ":";
+    if (!state.sourceFilePath.empty()) std::cerr << state.sourceFilePath << ":";
     if (line > 0) std::cerr << line << ": ";
     
     // 输出警告信息
@@ -704,21 +1239,42 @@ void reportWarning(const std::string& message, int line, int column) {
     std::cerr << translatedMsg << std::endl;
     
     // 显示简化的上下文
-    if (line > 0 && !g_sourceLines.empty()) {
+    if (line > 0 && !state.sourceLines.empty()) {
         std::string srcLine = getSourceLine(line);
         if (!srcLine.empty()) {
             std::cerr << "    " << ErrorColors::CYAN << std::setw(4) << line 
                       << " | " << ErrorColors::RESET << srcLine << std::endl;
         }
     }
+}
+
+// 报告优化报告（-Rpass），格式与警告相同，不计入诊断统计
+void reportRemark(const std::string& message, int line) {
+    DiagnosticState& state = currentDiagnostics();
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
+    if (!state.enableOptRemarks || !state.printDiagnostics) return;
+    
+    std::cerr << ErrorColors::BOLD;
+    if (!state.sourceFilePath.empty()) std::cerr << state.sourceFilePath << ":";
+    if (line > 0) std::cerr << line << ": ";
+    std::cerr << ErrorColors::CYAN << "remark: " << ErrorColors::RESET;
+    std::cerr << translateSemanticError(message) << std::endl;
     
-    g_warningCount++;
+    if (line > 0 && !state.sourceLines.empty()) {
+        std::string srcLine = getSourceLine(line);
+        if (!srcLine.empty()) {
+            std::cerr << "    " << ErrorColors::CYAN << std::setw(4) << line 
+                      << " | " << ErrorColors::RESET << srcLine << std::endl;
+        }
+    }
 }
 
 // 报告语法错误（由 Bison 解析器调用）
 void reportSyntaxError(const char* msg, int line, int column) {
     (void)column;  // 不再使用列号
-    g_syntaxErrorCount++;
+    DiagnosticState& state = currentDiagnostics();
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
+    state.syntaxErrorCount++;
     
     std::string friendlyMsg = translateErrorMessage(msg);
     int errorLine = line;
@@ -751,9 +1307,13 @@ void reportSyntaxError(const char* msg, int line, int column) {
         }
     }
     
+    std::string hint = generateSyntaxHint(friendlyMsg, errorLine);
+    state.diagnostics.push_back({Diagnostic::Error, state.sourceFilePath, errorLine, friendlyMsg, hint});
+    if (!state.printDiagnostics) return;
+    
     // 输出位置和错误信息（只显示行号）
     std::cerr << ErrorColors::BOLD;
-    if (!g_sourceFilePath.empty()) std::cerr << g_sourceFilePath << ":";
+    if (!state.sourceFilePath.empty()) std::cerr << state.sourceFilePath << ":";
     std::cerr << errorLine << ": ";
     std::cerr << ErrorColors::RED << "error: " << ErrorColors::RESET;
     std::cerr << ErrorColors::BOLD << friendlyMsg << ErrorColors::RESET << std::endl;
@@ -775,8 +1335,7 @@ void reportSyntaxError(const char* msg, int line, int column) {
         }
     }
     
-    // 生成修复建议
-    std::string hint = generateSyntaxHint(friendlyMsg, errorLine);
+    // 修复建议
     if (!hint.empty())
         std::cerr << ErrorColors::CYAN << hint << ErrorColors::RESET << std::endl;
     std::cerr << std::endl;
@@ -784,42 +1343,55 @@ void reportSyntaxError(const char* msg, int line, int column) {
 
 // 启用所有警告选项
 void enableAllWarnings() {
-    g_enableAllWarnings = true;
-    g_enableUnusedWarnings = true;
-    g_enableDeadCodeWarnings = true;
-    g_enableMissingReturnWarnings = true;
-    g_enableShadowWarnings = true;
+    DiagnosticState& state = currentDiagnostics();
+    state.enableAllWarnings = true;
+    state.enableUnusedWarnings = true;
+    state.enableDeadCodeWarnings = true;
+    state.enableMissingReturnWarnings = true;
+    state.enableShadowWarnings = true;
 }
 
 // 将警告视为错误
 void setWarningsAsErrors(bool enable) {
-    g_warningsAsErrors = enable;
+    currentDiagnostics().warningsAsErrors = enable;
 }
 
 // 禁用所有警告
 void suppressAllWarnings() {
-    g_suppressWarnings = true;
-    g_enableUnusedWarnings = false;
-    g_enableDeadCodeWarnings = false;
-    g_enableMissingReturnWarnings = false;
-    g_enableShadowWarnings = false;
+    DiagnosticState& state = currentDiagnostics();
+    state.suppressWarnings = true;
+    state.enableUnusedWarnings = false;
+    state.enableDeadCodeWarnings = false;
+    state.enableMissingReturnWarnings = false;
+    state.enableShadowWarnings = false;
 }
 
 // 检查警告是否启用
 bool isWarningEnabled() {
-    return !g_suppressWarnings;
+    return !currentDiagnostics().suppressWarnings;
+}
+
+// 输出优化报告
+void enableOptRemarks() {
+    currentDiagnostics().enableOptRemarks = true;
+}
+
+// 检查是否输出优化报告
+bool isOptRemarksEnabled() {
+    return currentDiagnostics().enableOptRemarks;
 }
 
 // 设置警告选项（命令行参数处理）
 void setWarningOption(const std::string& option) {
+    DiagnosticState& state = currentDiagnostics();
     if (option == "all")             enableAllWarnings();
     else if (option == "error")      setWarningsAsErrors(true);
-    else if (option == "no-unused")  g_enableUnusedWarnings = false;
-    else if (option == "unused")     g_enableUnusedWarnings = true;
-    else if (option == "no-dead-code")      g_enableDeadCodeWarnings = false;
-    else if (option == "dead-code")         g_enableDeadCodeWarnings = true;
-    else if (option == "no-missing-return") g_enableMissingReturnWarnings = false;
-    else if (option == "missing-return")    g_enableMissingReturnWarnings = true;
-    else if (option == "shadow")     g_enableShadowWarnings = true;
-    else if (option == "no-shadow")  g_enableShadowWarnings = false;
+    else if (option == "no-unused")  state.enableUnusedWarnings = false;
+    else if (option == "unused")     state.enableUnusedWarnings = true;
+    else if (option == "no-dead-code")      state.enableDeadCodeWarnings = false;
+    else if (option == "dead-code")         state.enableDeadCodeWarnings = true;
+    else if (option == "no-missing-return") state.enableMissingReturnWarnings = false;
+    else if (option == "missing-return")    state.enableMissingReturnWarnings = true;
+    else if (option == "shadow")     state.enableShadowWarnings = true;
+    else if (option == "no-shadow")  state.enableShadowWarnings = false;
 }
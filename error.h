@@ -7,11 +7,13 @@
  * - 源代码上下文显示
  * - 错误信息翻译和修复建议
  * - 警告级别控制 (-Wall, -Werror, -w)
+ * - 诊断状态按线程切换，嵌入 API 的每个会话独立收集诊断信息
  */
 
 #ifndef ERROR_H
 #define ERROR_H
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -28,37 +30,81 @@ namespace ErrorColors {
 }
 
 /**
- * 源代码管理
- * 用于错误报告时显示源代码上下文
+ * 诊断信息
+ * 每条错误和警告都记录在当前诊断状态中，嵌入 API 通过 ppx::Session::diagnostics() 读取
  */
-extern std::vector<std::string> g_sourceLines;    // 源代码行缓存
-extern std::string g_sourceFilePath;              // 当前源文件路径
-
-void loadSourceFile(const std::string& filename); // 加载源文件到缓存
-std::string getSourceLine(int lineNum);           // 获取指定行源代码
+struct Diagnostic {
+    enum Severity { Error, Warning };
+    Severity severity;                            // 错误或警告
+    std::string file;                             // 源文件名（内存中的源代码为调用者给出的名称）
+    int line;                                     // 行号（0 表示没有位置信息）
+    std::string message;                          // 翻译后的中文信息
+    std::string hint;                             // 修复建议（可能为空）
+};
 
 /**
- * 错误统计计数器
+ * 诊断状态
+ * 源代码缓存、错误统计、警告选项和已报告的诊断信息
+ *
+ * 每个线程有一个当前状态，默认为进程级的状态（命令行编译器使用）；
+ * 嵌入 API 的每个会话拥有独立的状态，调用期间通过 DiagnosticScope 切换，
+ * 因此不同线程中的会话互不影响
  */
-extern int g_errorCount;                          // 错误计数
-extern int g_warningCount;                        // 警告计数
-extern int g_syntaxErrorCount;                    // 语法错误计数
+struct DiagnosticState {
+    // 源代码管理（用于错误报告时显示源代码上下文）
+    std::vector<std::string> sourceLines;         // 源代码行缓存
+    std::string sourceFilePath;                   // 当前源文件路径
 
-void resetErrorCounts();                          // 重置所有计数器
+    // 错误统计计数器
+    int errorCount = 0;                           // 错误计数
+    int warningCount = 0;                         // 警告计数
+    int syntaxErrorCount = 0;                     // 语法错误计数
+
+    // 警告控制选项
+    bool enableAllWarnings = false;               // -Wall: 启用所有警告
+    bool warningsAsErrors = false;                // -Werror: 将警告视为错误
+    bool suppressWarnings = false;                // -w: 禁用所有警告
+    bool enableUnusedWarnings = true;             // 未使用变量/参数警告
+    bool enableDeadCodeWarnings = true;           // 死代码警告
+    bool enableMissingReturnWarnings = true;      // 缺少返回值警告
+    bool enableShadowWarnings = false;            // 变量遮蔽警告（需要 -Wall 或 -Wshadow 启用）
+    bool enableOptRemarks = false;                // -Rpass: 输出优化提示是否生效
+
+    // 输出
+    bool printDiagnostics = true;                 // 是否输出到 stderr
+    std::vector<Diagnostic> diagnostics;          // 已报告的诊断信息
+
+    // 并行 IR 生成时多个线程可能同时报告诊断信息，输出和计数由互斥锁保护
+    std::recursive_mutex mutex;
+};
+
+DiagnosticState& currentDiagnostics();            // 当前线程的诊断状态
 
 /**
- * 警告控制选项
- * 通过命令行参数控制警告行为
+ * 切换当前线程的诊断状态和详细日志开关，析构时恢复
+ * 嵌入 API 在会话调用期间使用；代码生成的工作线程用它沿用创建者线程的设置
  */
-extern bool g_enableAllWarnings;                  // -Wall: 启用所有警告
-extern bool g_warningsAsErrors;                   // -Werror: 将警告视为错误
-extern bool g_suppressWarnings;                   // -w: 禁用所有警告
+class DiagnosticScope {
+public:
+    DiagnosticScope(DiagnosticState& state, bool verbose);
+    ~DiagnosticScope();
+    DiagnosticScope(const DiagnosticScope&) = delete;
+    DiagnosticScope& operator=(const DiagnosticScope&) = delete;
+private:
+    DiagnosticState* previousState;
+    bool previousVerbose;
+};
 
-// 具体警告类型开关
-extern bool g_enableUnusedWarnings;               // 未使用变量/参数警告
-extern bool g_enableDeadCodeWarnings;             // 死代码警告
-extern bool g_enableMissingReturnWarnings;        // 缺少返回值警告
-extern bool g_enableShadowWarnings;               // 变量遮蔽警告
+/**
+ * 详细日志开关（-v），每个线程独立
+ */
+extern thread_local bool g_verbose;
+
+void loadSourceFile(const std::string& filename); // 加载源文件到缓存
+void loadSourceText(const std::string& name, const std::string& text);  // 从内存加载源代码
+std::string getSourceLine(int lineNum);           // 获取指定行源代码
+
+void resetErrorCounts();                          // 重置所有计数器
 
 // 警告控制函数
 void enableAllWarnings();                         // 启用所有警告 (-Wall)
@@ -66,6 +112,8 @@ void setWarningsAsErrors(bool enable);            // 设置警告视为错误 (-
 void suppressAllWarnings();                       // 禁用所有警告 (-w)
 void setWarningOption(const std::string& option); // 解析 -Wxx 选项
 bool isWarningEnabled();                          // 检查是否启用警告输出
+void enableOptRemarks();                          // 输出优化报告 (-Rpass)
+bool isOptRemarksEnabled();                       // 检查是否输出优化报告
 
 /**
  * 错误报告函数
@@ -73,6 +121,7 @@ bool isWarningEnabled();                          // 检查是否启用警告输
  */
 void reportError(const std::string& message, int line, int column = 0);
 void reportWarning(const std::string& message, int line, int column = 0);
+void reportRemark(const std::string& message, int line);     // 优化报告（仅在 -Rpass 时输出，不计数）
 void reportSyntaxError(const char* msg, int line, int column);
 
 /**
@@ -0,0 +1,1982 @@
+/**
+ * interp.cc
+ * PiPiXia 字节码解释器实现
+ *
+ * 降级规则：
+ * - 每个 SSA 值、函数参数和常量分配一个寄存器；常量寄存器排在帧的最前面，调用时整体复制
+ * - 入口块中定长的 alloca 在帧内存中静态分配，其余 alloca 在内存栈上动态分配，函数返回时释放
+ * - getelementptr 展开为 "基址 + 下标 × 步长" 的加法序列
+ * - 定长向量（<N x T>）占用 N 个连续的寄存器，逐元素展开；llvm.vector.reduce.* 按元素顺序依次合并
+ * - phi 在前驱边上展开为并行复制，带 phi 的后继块经由边上的复制序列跳转
+ * - setjmp 在 jmp_buf 中记录帧序号和恢复位置，longjmp 通过 C++ 异常回溯到对应帧
+ * - 原子访存和 cmpxchg 按顺序一致执行；cmpxchg 的结果 { 旧值, 是否成功 } 占两个连续的寄存器，extractvalue 取其中之一
+ * - 线程函数为模块中定义的函数的 pthread_create 降级为 SPAWN，新线程在自己的寄存器栈和内存栈上执行
+ * - 函数地址常量求值为 llvm::Function*，间接调用（生成器的 resume/destroy）降级为 CALL_INDIRECT，
+ *   执行时按地址查找函数；使用函数地址或间接调用的函数不参与分层编译（本地代码中的函数地址与解释器不同）
+ * - 指向源程序中更早基本块的跳转降级为 LOOP/BR_LOOP，与函数调用一起累计函数热度
+ */
+
+#include "interp.h"
+#include "error.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/GetElementPtrTypeIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Operator.h>
+
+static_assert(sizeof(void*) == 8, "bytecode interpreter requires 64-bit pointers");
+
+// 栈容量（按需分配物理页）
+static const size_t REGISTER_STACK_SLOTS = 4u << 20;   // 4M 个寄存器
+static const size_t MEMORY_STACK_BYTES = 64u << 20;    // 64 MB
+static const size_t THREAD_REGISTER_SLOTS = 1u << 20;  // spawn 创建的线程：1M 个寄存器
+static const size_t THREAD_MEMORY_BYTES = 16u << 20;   // 16 MB
+static const uint32_t NO_REGISTER = UINT32_MAX;
+static const uint64_t JUMP_RECORD_MAGIC = 0x5050584a4d50ull;  // "PPXJMP"
+
+/*
+ * 操作码表
+ * 整数运算的结果按 width 位宽规整；访存指令按类型区分；CALL/CALL_INDIRECT/CALL_NATIVE 的参数寄存器
+ * 保存在函数的 callArgs 表中（b 为起始下标，c 为个数）
+ */
+#define PPX_OPCODES(X) \
+    X(MOV) X(SEXT1) X(ZEXT) X(TRUNC) \
+    X(ADD) X(SUB) X(MUL) X(SDIV) X(UDIV) X(SREM) X(UREM) \
+    X(AND) X(OR) X(XOR) X(SHL) X(LSHR) X(ASHR) X(CTTZ) \
+    X(ADDI) X(MADD) \
+    X(FADD) X(FSUB) X(FMUL) X(FDIV) X(FREM) X(FNEG) \
+    X(ICMP_EQ) X(ICMP_NE) X(ICMP_SLT) X(ICMP_SLE) X(ICMP_SGT) X(ICMP_SGE) \
+    X(ICMP_ULT) X(ICMP_ULE) X(ICMP_UGT) X(ICMP_UGE) X(FCMP) \
+    X(SITOFP) X(UITOFP) X(FPTOSI) X(FPTOUI) X(FPTRUNC) \
+    X(SELECT) \
+    X(LOAD_I1) X(LOAD_I8) X(LOAD_I16) X(LOAD_I32) X(LOAD_I64) X(LOAD_F32) X(LOAD_F64) \
+    X(STORE_I8) X(STORE_I16) X(STORE_I32) X(STORE_I64) X(STORE_F32) X(STORE_F64) \
+    X(FRAME_ADDR) X(ALLOCA) \
+    X(JMP) X(BR) X(LOOP) X(BR_LOOP) X(SWITCH) X(RET) X(RET_VOID) X(UNREACHABLE) \
+    X(CALL) X(CALL_INDIRECT) X(CALL_NATIVE) X(SETJMP) X(LONGJMP) \
+    X(MEMCPY) X(MEMMOVE) X(MEMSET) \
+    X(ATOMIC_LOAD) X(ATOMIC_STORE) X(CMPXCHG) X(SPAWN)
+
+enum Opcode : uint16_t {
+#define PPX_OPCODE_ENUM(name) OP_##name,
+    PPX_OPCODES(PPX_OPCODE_ENUM)
+#undef PPX_OPCODE_ENUM
+    OP_COUNT
+};
+
+struct BytecodeInterpreter::Instr {
+    uint16_t op;
+    uint16_t width;     // 整数位宽 / 浮点位宽
+    uint32_t dst;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    int64_t imm;        // 立即数 / 跳转目标 / 函数下标 / 比较谓词
+};
+
+struct SwitchTable {
+    std::vector<std::pair<int64_t, uint32_t>> cases;    // 按值排序
+    uint32_t defaultTarget;
+};
+
+struct BytecodeInterpreter::BytecodeFunction {
+    llvm::Function* source = nullptr;
+    std::string name;
+    std::vector<Instr> code;
+    std::vector<InterpSlot> constants;      // 寄存器 [0, constants.size()) 的初始值
+    std::vector<uint32_t> callArgs;         // 调用参数寄存器
+    std::vector<SwitchTable> switches;
+    uint32_t argBase = 0;                   // 第一个参数寄存器
+    uint32_t argCount = 0;
+    uint32_t frameSize = 0;                 // 寄存器总数
+    uint64_t frameBytes = 0;                // 静态 alloca 占用的帧内存
+    unsigned index = 0;                     // 在 functions 中的下标
+    std::atomic<uint64_t> hotness{0};       // 调用次数 + 循环回边次数
+    bool tierUpCandidate = true;            // main 和全局构造函数（只执行一次）以及使用函数地址的函数不参与分层编译
+    std::atomic<bool> tierUpRequested{false};       // 已通知热点（多个线程可能同时达到阈值）
+    std::atomic<NativeEntry> nativeEntry{nullptr};  // 分层编译后的本地代码入口
+
+    // 热度加一，返回是否恰好达到阈值
+    // 多个线程同时执行时不加锁，计数可能丢失，只用于估计热点
+    bool heat(uint64_t threshold) {
+        uint64_t value = hotness.load(std::memory_order_relaxed) + 1;
+        hotness.store(value, std::memory_order_relaxed);
+        return value == threshold;
+    }
+};
+
+// 解释器栈：寄存器栈和内存栈（alloca），每个线程一份
+struct BytecodeInterpreter::ThreadStack {
+    std::unique_ptr<InterpSlot[]> registers;
+    InterpSlot* registerTop;                // 当前栈顶
+    InterpSlot* registerLimit;
+    std::unique_ptr<char[]> memory;
+    char* memoryTop;
+    char* memoryLimit;
+    uint64_t frameSerial = 0;               // 帧序号（用于 longjmp 定位目标帧）
+
+    ThreadStack(size_t slots, size_t bytes)
+        : registers(new InterpSlot[slots]), registerTop(registers.get()), registerLimit(registerTop + slots),
+          memory(new char[bytes]), memoryTop(memory.get()), memoryLimit(memoryTop + bytes) {}
+};
+
+thread_local BytecodeInterpreter::ThreadStack* BytecodeInterpreter::currentStack = nullptr;
+
+// SPAWN 传给新线程的参数
+struct SpawnRequest {
+    BytecodeInterpreter* interpreter;
+    unsigned index;                         // 线程函数的下标
+    void* argument;
+};
+
+// 本地代码创建线程时传给新线程的参数
+struct NativeSpawnRequest {
+    BytecodeInterpreter* interpreter;
+    void* (*start)(void*);                  // JIT 编译的线程函数
+    void* argument;
+};
+
+// 宿主函数的调用方式
+enum NativeKind {
+    NATIVE_GENERIC,         // 按 ABI 直接调用（整数/指针与浮点参数分别按顺序传入寄存器）
+    NATIVE_VARIADIC,        // 变参函数，只允许整数/指针参数
+    NATIVE_PRINTF,          // 解释器格式化后写入 stdout
+    NATIVE_SPRINTF,
+    NATIVE_SNPRINTF,
+    NATIVE_EXIT,            // 刷新输出后立即结束进程
+};
+
+struct BytecodeInterpreter::NativeFunction {
+    std::string name;
+    NativeKind kind = NATIVE_GENERIC;
+    void* address = nullptr;
+    std::vector<char> argIsFloat;       // 固定参数是否为浮点
+    bool returnsDouble = false;
+    bool returnsFloat = false;
+    unsigned returnWidth = 0;           // 整数返回值位宽（0 表示 void 或指针）
+};
+
+// longjmp 在解释器中的表示：回溯到 serial 对应的帧后从 resumePc 继续
+struct InterpJump {
+    uint64_t serial;
+    uint32_t resumePc;
+    uint32_t dst;
+    int64_t value;
+};
+
+// 解释器内部错误（栈溢出、非法 longjmp 等）
+struct InterpError {
+    std::string message;
+};
+
+// jmp_buf 中保存的恢复信息
+struct JumpRecord {
+    uint64_t magic;
+    uint64_t serial;
+    uint32_t resumePc;
+    uint32_t dst;
+};
+
+// 按位宽规整整数：i1 取最低位，其余符号扩展
+static inline int64_t normalizeInt(uint64_t value, unsigned width) {
+    switch (width) {
+        case 1:  return value & 1;
+        case 8:  return static_cast<int8_t>(value);
+        case 16: return static_cast<int16_t>(value);
+        case 32: return static_cast<int32_t>(value);
+        case 64: return static_cast<int64_t>(value);
+        default: {
+            unsigned shift = 64 - width;
+            return static_cast<int64_t>(value << shift) >> shift;
+        }
+    }
+}
+
+// 取整数的无符号值
+static inline uint64_t unsignedInt(int64_t value, unsigned width) {
+    return width >= 64 ? static_cast<uint64_t>(value)
+                       : static_cast<uint64_t>(value) & ((uint64_t(1) << width) - 1);
+}
+
+static unsigned integerWidth(llvm::Type* type) {
+    if (type->isIntegerTy()) {
+        return type->getIntegerBitWidth();
+    }
+    return 64;  // 指针
+}
+
+// 值占用的寄存器个数：向量和结构体（cmpxchg 的结果）每个元素一个，其余一个
+static unsigned laneCount(llvm::Type* type) {
+    if (auto* vector = llvm::dyn_cast<llvm::FixedVectorType>(type)) {
+        return vector->getNumElements();
+    }
+    if (auto* structType = llvm::dyn_cast<llvm::StructType>(type)) {
+        return structType->getNumElements();
+    }
+    return 1;
+}
+
+// 原子访存（顺序一致），width 为整数位宽
+static int64_t atomicLoad(void* address, unsigned width) {
+    switch (width) {
+        case 8:  return __atomic_load_n(static_cast<int8_t*>(address), __ATOMIC_SEQ_CST);
+        case 16: return __atomic_load_n(static_cast<int16_t*>(address), __ATOMIC_SEQ_CST);
+        case 32: return __atomic_load_n(static_cast<int32_t*>(address), __ATOMIC_SEQ_CST);
+        default: return __atomic_load_n(static_cast<int64_t*>(address), __ATOMIC_SEQ_CST);
+    }
+}
+
+static void atomicStore(void* address, int64_t value, unsigned width) {
+    switch (width) {
+        case 8:  __atomic_store_n(static_cast<int8_t*>(address), static_cast<int8_t>(value), __ATOMIC_SEQ_CST); break;
+        case 16: __atomic_store_n(static_cast<int16_t*>(address), static_cast<int16_t>(value), __ATOMIC_SEQ_CST); break;
+        case 32: __atomic_store_n(static_cast<int32_t*>(address), static_cast<int32_t>(value), __ATOMIC_SEQ_CST); break;
+        default: __atomic_store_n(static_cast<int64_t*>(address), value, __ATOMIC_SEQ_CST); break;
+    }
+}
+
+// 比较并交换：expected 更新为内存中的旧值，返回是否成功
+template <typename T>
+static bool compareExchange(void* address, int64_t& expected, int64_t desired) {
+    T old = static_cast<T>(expected);
+    bool ok = __atomic_compare_exchange_n(static_cast<T*>(address), &old, static_cast<T>(desired), false,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    expected = old;
+    return ok;
+}
+
+static bool atomicCompareExchange(void* address, int64_t& expected, int64_t desired, unsigned width) {
+    switch (width) {
+        case 8:  return compareExchange<int8_t>(address, expected, desired);
+        case 16: return compareExchange<int16_t>(address, expected, desired);
+        case 32: return compareExchange<int32_t>(address, expected, desired);
+        default: return compareExchange<int64_t>(address, expected, desired);
+    }
+}
+
+static void runtimeError(const std::string& message) {
+    std::fflush(stdout);
+    std::cerr << ErrorColors::RED << "Runtime error" << ErrorColors::RESET << ": " << message << std::endl;
+}
+
+// 构造和析构
+
+BytecodeInterpreter::BytecodeInterpreter(llvm::Module* module)
+    : module(module), dataLayout(module->getDataLayout()),
+      runningThreads(0), tierUpThreshold(UINT64_MAX) {}
+
+BytecodeInterpreter::~BytecodeInterpreter() {}
+
+// 全局变量
+
+bool BytecodeInterpreter::allocateGlobals() {
+    // 先分配全部地址，初始化值中可能引用其他全局变量
+    for (auto& global : module->globals()) {
+        if (global.getName().starts_with("llvm.")) {
+            continue;
+        }
+        if (global.isDeclaration()) {
+            void* address = dlsym(RTLD_DEFAULT, global.getName().str().c_str());
+            if (!address) {
+                runtimeError("unresolved external global '" + global.getName().str() + "'");
+                return false;
+            }
+            globalAddresses[&global] = static_cast<char*>(address);
+            continue;
+        }
+        uint64_t size = dataLayout.getTypeAllocSize(global.getValueType());
+        uint64_t align = std::max<uint64_t>(16, global.getAlign() ? global.getAlign()->value() : 1);
+        std::unique_ptr<char[]> storage(new char[size + align]());
+        uintptr_t raw = reinterpret_cast<uintptr_t>(storage.get());
+        char* aligned = reinterpret_cast<char*>((raw + align - 1) & ~(uintptr_t)(align - 1));
+        globalAddresses[&global] = aligned;
+        globalStorage.push_back(std::move(storage));
+    }
+    for (auto& global : module->globals()) {
+        if (global.isDeclaration() || !global.hasInitializer() || global.getName().starts_with("llvm.")) {
+            continue;
+        }
+        if (!writeConstant(globalAddresses[&global], global.getInitializer())) {
+            runtimeError("unsupported initializer for global '" + global.getName().str() + "'");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BytecodeInterpreter::evaluateConstant(const llvm::Constant* c, InterpSlot& out) {
+    out.i = 0;
+    if (auto* ci = llvm::dyn_cast<llvm::ConstantInt>(c)) {
+        if (ci->getBitWidth() > 64) {
+            return false;
+        }
+        out.i = normalizeInt(ci->getZExtValue(), ci->getBitWidth());
+        return true;
+    }
+    if (auto* cf = llvm::dyn_cast<llvm::ConstantFP>(c)) {
+        if (cf->getType()->isFloatTy()) {
+            out.d = cf->getValueAPF().convertToFloat();
+        } else if (cf->getType()->isDoubleTy()) {
+            out.d = cf->getValueAPF().convertToDouble();
+        } else {
+            return false;
+        }
+        return true;
+    }
+    if (llvm::isa<llvm::ConstantPointerNull>(c) || llvm::isa<llvm::UndefValue>(c)) {
+        return true;
+    }
+    if (auto* gv = llvm::dyn_cast<llvm::GlobalVariable>(c)) {
+        auto it = globalAddresses.find(gv);
+        if (it == globalAddresses.end()) {
+            return false;
+        }
+        out.p = it->second;
+        return true;
+    }
+    if (auto* f = llvm::dyn_cast<llvm::Function>(c)) {
+        // 函数地址只用于标识（解释器不支持间接调用）
+        out.p = const_cast<llvm::Function*>(f);
+        return true;
+    }
+    if (auto* ce = llvm::dyn_cast<llvm::ConstantExpr>(c)) {
+        if (auto* gep = llvm::dyn_cast<llvm::GEPOperator>(ce)) {
+            InterpSlot base;
+            if (!evaluateConstant(llvm::cast<llvm::Constant>(gep->getPointerOperand()), base)) {
+                return false;
+            }
+            llvm::APInt offset(64, 0);
+            if (!gep->accumulateConstantOffset(dataLayout, offset)) {
+                return false;
+            }
+            out.p = static_cast<char*>(base.p) + offset.getSExtValue();
+            return true;
+        }
+        switch (ce->getOpcode()) {
+            case llvm::Instruction::BitCast:
+            case llvm::Instruction::AddrSpaceCast:
+            case llvm::Instruction::IntToPtr:
+                return evaluateConstant(ce->getOperand(0), out);
+            case llvm::Instruction::PtrToInt:
+                if (!evaluateConstant(ce->getOperand(0), out)) {
+                    return false;
+                }
+                out.i = normalizeInt(out.i, integerWidth(ce->getType()));
+                return true;
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+bool BytecodeInterpreter::writeConstant(char* addr, const llvm::Constant* c) {
+    llvm::Type* type = c->getType();
+    uint64_t size = dataLayout.getTypeAllocSize(type);
+
+    if (llvm::isa<llvm::ConstantAggregateZero>(c) || llvm::isa<llvm::UndefValue>(c)) {
+        std::memset(addr, 0, size);
+        return true;
+    }
+    if (auto* data = llvm::dyn_cast<llvm::ConstantDataSequential>(c)) {
+        llvm::StringRef raw = data->getRawDataValues();
+        std::memcpy(addr, raw.data(), raw.size());
+        return true;
+    }
+    if (llvm::isa<llvm::ConstantArray>(c) || llvm::isa<llvm::ConstantVector>(c)) {
+        llvm::Type* elementType = llvm::isa<llvm::ArrayType>(type)
+            ? type->getArrayElementType()
+            : llvm::cast<llvm::VectorType>(type)->getElementType();
+        uint64_t stride = dataLayout.getTypeAllocSize(elementType);
+        for (unsigned i = 0; i < c->getNumOperands(); i++) {
+            if (!writeConstant(addr + i * stride, llvm::cast<llvm::Constant>(c->getOperand(i)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (auto* cs = llvm::dyn_cast<llvm::ConstantStruct>(c)) {
+        const llvm::StructLayout* layout = dataLayout.getStructLayout(cs->getType());
+        for (unsigned i = 0; i < cs->getNumOperands(); i++) {
+            if (!writeConstant(addr + layout->getElementOffset(i), cs->getOperand(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    InterpSlot value;
+    if (!evaluateConstant(c, value)) {
+        return false;
+    }
+    if (type->isFloatTy()) {
+        float f = static_cast<float>(value.d);
+        std::memcpy(addr, &f, sizeof(f));
+    } else if (type->isDoubleTy()) {
+        std::memcpy(addr, &value.d, sizeof(double));
+    } else if (type->isIntegerTy(1)) {
+        *addr = static_cast<char>(value.i & 1);
+    } else {
+        std::memcpy(addr, &value.i, size < 8 ? size : 8);   // 小端序
+    }
+    return true;
+}
+
+// 宿主函数
+
+int BytecodeInterpreter::resolveNative(const llvm::Function* callee) {
+    auto it = nativeIndex.find(callee);
+    if (it != nativeIndex.end()) {
+        return static_cast<int>(it->second);
+    }
+
+    std::unique_ptr<NativeFunction> native(new NativeFunction());
+    std::string name = callee->getName().str();
+    llvm::FunctionType* type = callee->getFunctionType();
+
+    // 数学内建函数映射到 C 库同名函数，例如 llvm.pow.f64 -> pow
+    if (callee->isIntrinsic()) {
+        std::string base = name.substr(5, name.find('.', 5) - 5);
+        static const char* const mathIntrinsics[] = {
+            "pow", "sqrt", "fabs", "floor", "ceil", "trunc", "round", "sin", "cos",
+            "exp", "exp2", "log", "log2", "log10", "fma", "copysign",
+        };
+        bool known = false;
+        for (const char* math : mathIntrinsics) {
+            known = known || base == math;
+        }
+        if (base == "minnum") base = "fmin";
+        if (base == "maxnum") base = "fmax";
+        if (!known && base != "fmin" && base != "fmax") {
+            return -1;
+        }
+        if (type->getReturnType()->isFloatTy()) {
+            base += "f";
+        }
+        name = base;
+    }
+
+    native->name = name;
+    if (name == "printf") {
+        native->kind = NATIVE_PRINTF;
+    } else if (name == "sprintf") {
+        native->kind = NATIVE_SPRINTF;
+    } else if (name == "snprintf") {
+        native->kind = NATIVE_SNPRINTF;
+    } else if (name == "exit") {
+        native->kind = NATIVE_EXIT;
+    } else {
+        native->kind = type->isVarArg() ? NATIVE_VARIADIC : NATIVE_GENERIC;
+        native->address = dlsym(RTLD_DEFAULT, name.c_str());
+        if (!native->address) {
+            return -1;
+        }
+    }
+
+    unsigned intArgs = 0, floatArgs = 0;
+    for (llvm::Type* param : type->params()) {
+        bool isFloat = param->isFloatingPointTy();
+        if (!isFloat && !param->isIntegerTy() && !param->isPointerTy()) {
+            return -1;
+        }
+        native->argIsFloat.push_back(isFloat);
+        (isFloat ? floatArgs : intArgs)++;
+    }
+    if (intArgs > 6 || floatArgs > 8) {
+        return -1;
+    }
+    llvm::Type* ret = type->getReturnType();
+    native->returnsDouble = ret->isDoubleTy();
+    native->returnsFloat = ret->isFloatTy();
+    native->returnWidth = ret->isIntegerTy() ? ret->getIntegerBitWidth() : 0;
+
+    natives.push_back(std::move(native));
+    nativeIndex[callee] = natives.size() - 1;
+    return static_cast<int>(natives.size() - 1);
+}
+
+// 按 printf 格式串逐个转换说明符格式化参数（参数类型由说明符决定）
+static std::string formatPrintf(const char* format, const InterpSlot* args, unsigned argc) {
+    std::string out;
+    unsigned next = 0;
+    auto nextArg = [&]() -> InterpSlot {
+        InterpSlot slot;
+        slot.i = 0;
+        if (next < argc) {
+            slot = args[next];
+        }
+        next++;
+        return slot;
+    };
+    char buffer[512];
+
+    for (const char* p = format; *p; ) {
+        if (*p != '%') {
+            const char* start = p;
+            while (*p && *p != '%') p++;
+            out.append(start, p - start);
+            continue;
+        }
+        if (p[1] == '%') {
+            out += '%';
+            p += 2;
+            continue;
+        }
+
+        // 解析 %[flags][width][.precision][length]conversion
+        std::string spec = "%";
+        const char* q = p + 1;
+        while (*q && std::strchr("-+ #0'", *q)) spec += *q++;
+        if (*q == '*') {
+            spec += std::to_string(static_cast<int>(nextArg().i));
+            q++;
+        }
+        while (*q >= '0' && *q <= '9') spec += *q++;
+        if (*q == '.') {
+            spec += *q++;
+            if (*q == '*') {
+                spec += std::to_string(static_cast<int>(nextArg().i));
+                q++;
+            }
+            while (*q >= '0' && *q <= '9') spec += *q++;
+        }
+        bool isLong = false;
+        while (*q && std::strchr("hlLqjzt", *q)) {
+            isLong = isLong || *q == 'l' || *q == 'q' || *q == 'j' || *q == 'z' || *q == 't';
+            q++;
+        }
+        char conversion = *q;
+        if (!conversion) {
+            break;
+        }
+        p = q + 1;
+
+        int length = 0;
+        switch (conversion) {
+            case 'd': case 'i':
+                spec += "ll";
+                spec += conversion;
+                {
+                    int64_t value = nextArg().i;
+                    length = std::snprintf(buffer, sizeof(buffer), spec.c_str(),
+                                           static_cast<long long>(isLong ? value : static_cast<int>(value)));
+                }
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                spec += "ll";
+                spec += conversion;
+                {
+                    int64_t value = nextArg().i;
+                    unsigned long long u = isLong ? static_cast<unsigned long long>(value)
+                                                  : static_cast<unsigned>(value);
+                    length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), u);
+                }
+                break;
+            case 'c':
+                spec += conversion;
+                length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<int>(nextArg().i));
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                spec += conversion;
+                length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), nextArg().d);
+                break;
+            case 's': {
+                spec += conversion;
+                const char* str = static_cast<const char*>(nextArg().p);
+                if (!str) str = "(null)";
+                length = std::snprintf(nullptr, 0, spec.c_str(), str);
+                if (length > 0) {
+                    std::string piece(length + 1, '\0');
+                    std::snprintf(&piece[0], piece.size(), spec.c_str(), str);
+                    out.append(piece.data(), length);
+                }
+                continue;
+            }
+            case 'p':
+                spec += conversion;
+                length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), nextArg().p);
+                break;
+            case 'n':
+                nextArg();
+                continue;
+            default:
+                out += spec;
+                out += conversion;
+                continue;
+        }
+        if (length > 0) {
+            out.append(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+        }
+    }
+    return out;
+}
+
+typedef int64_t (*GenericIntFn)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                                double, double, double, double, double, double, double, double);
+typedef double (*GenericDoubleFn)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                                  double, double, double, double, double, double, double, double);
+typedef float (*GenericFloatFn)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                                float, float, float, float, float, float, float, float);
+typedef int64_t (*VariadicFn)(int64_t, ...);
+
+InterpSlot BytecodeInterpreter::callNative(const NativeFunction& native, const InterpSlot* args, unsigned argc) {
+    InterpSlot result;
+    result.i = 0;
+
+    switch (native.kind) {
+        case NATIVE_PRINTF: {
+            std::string text = formatPrintf(static_cast<const char*>(args[0].p), args + 1, argc - 1);
+            std::fwrite(text.data(), 1, text.size(), stdout);
+            result.i = static_cast<int32_t>(text.size());
+            return result;
+        }
+        case NATIVE_SPRINTF: {
+            std::string text = formatPrintf(static_cast<const char*>(args[1].p), args + 2, argc - 2);
+            std::memcpy(args[0].p, text.c_str(), text.size() + 1);
+            result.i = static_cast<int32_t>(text.size());
+            return result;
+        }
+        case NATIVE_SNPRINTF: {
+            std::string text = formatPrintf(static_cast<const char*>(args[2].p), args + 3, argc - 3);
+            size_t capacity = static_cast<size_t>(args[1].i);
+            if (capacity > 0) {
+                size_t count = std::min(capacity - 1, text.size());
+                std::memcpy(args[0].p, text.data(), count);
+                static_cast<char*>(args[0].p)[count] = '\0';
+            }
+            result.i = static_cast<int32_t>(text.size());
+            return result;
+        }
+        case NATIVE_EXIT:
+            // 不执行静态析构，避免与仍在运行的后台 JIT 线程竞争
+            std::fflush(nullptr);
+            std::_Exit(static_cast<int>(args[0].i));
+        case NATIVE_VARIADIC: {
+            int64_t a[8] = {0};
+            for (unsigned i = 0; i < argc && i < 8; i++) a[i] = args[i].i;
+            result.i = reinterpret_cast<VariadicFn>(native.address)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+            break;
+        }
+        case NATIVE_GENERIC: {
+            // SysV x86-64 / AArch64：整数和浮点参数分别按顺序占用各自的寄存器
+            int64_t ints[6] = {0};
+            double doubles[8] = {0};
+            float floats[8] = {0};
+            unsigned intCount = 0, floatCount = 0;
+            for (unsigned i = 0; i < argc; i++) {
+                if (native.argIsFloat[i]) {
+                    floats[floatCount] = static_cast<float>(args[i].d);
+                    doubles[floatCount++] = args[i].d;
+                } else {
+                    ints[intCount++] = args[i].i;
+                }
+            }
+            if (native.returnsFloat) {
+                result.d = reinterpret_cast<GenericFloatFn>(native.address)(
+                    ints[0], ints[1], ints[2], ints[3], ints[4], ints[5],
+                    floats[0], floats[1], floats[2], floats[3], floats[4], floats[5], floats[6], floats[7]);
+            } else if (native.returnsDouble) {
+                result.d = reinterpret_cast<GenericDoubleFn>(native.address)(
+                    ints[0], ints[1], ints[2], ints[3], ints[4], ints[5],
+                    doubles[0], doubles[1], doubles[2], doubles[3], doubles[4], doubles[5], doubles[6], doubles[7]);
+            } else {
+                result.i = reinterpret_cast<GenericIntFn>(native.address)(
+                    ints[0], ints[1], ints[2], ints[3], ints[4], ints[5],
+                    doubles[0], doubles[1], doubles[2], doubles[3], doubles[4], doubles[5], doubles[6], doubles[7]);
+            }
+            break;
+        }
+    }
+    if (native.returnWidth) {
+        result.i = normalizeInt(result.i, native.returnWidth);
+    }
+    return result;
+}
+
+// 降级
+
+namespace {
+
+// 单个函数的降级状态
+struct Lowering {
+    const llvm::DataLayout& dataLayout;
+    BytecodeInterpreter::BytecodeFunction& fn;
+    std::map<const llvm::Value*, uint32_t> registers;
+    std::map<const llvm::BasicBlock*, uint32_t> blockStart;
+    uint32_t nextRegister = 0;
+    std::string error;
+
+    // 跳转目标回填：code[index] 的 imm（field 0）或 c（field 1）指向 edges[edge]
+    struct Edge {
+        const llvm::BasicBlock* from;
+        const llvm::BasicBlock* to;
+    };
+    std::vector<Edge> edges;
+    struct Fixup {
+        size_t index;
+        int field;          // 0: imm, 1: c, 2: switch case, 3: switch default
+        size_t edge;
+        size_t caseIndex;
+    };
+    std::vector<Fixup> fixups;
+
+    Lowering(const llvm::DataLayout& dl, BytecodeInterpreter::BytecodeFunction& f)
+        : dataLayout(dl), fn(f) {}
+
+    uint32_t reg(const llvm::Value* value) {
+        auto it = registers.find(value);
+        return it != registers.end() ? it->second : NO_REGISTER;
+    }
+
+    uint32_t newRegister() { return nextRegister++; }
+
+    uint32_t newRegisters(unsigned count) {
+        uint32_t first = nextRegister;
+        nextRegister += count;
+        return first;
+    }
+
+    BytecodeInterpreter::Instr& emit(Opcode op, uint32_t dst = NO_REGISTER, uint32_t a = 0,
+                                     uint32_t b = 0, uint32_t c = 0, int64_t imm = 0, uint16_t width = 0) {
+        fn.code.push_back({op, width, dst, a, b, c, imm});
+        return fn.code.back();
+    }
+
+    size_t edgeTo(const llvm::BasicBlock* from, const llvm::BasicBlock* to) {
+        edges.push_back({from, to});
+        return edges.size() - 1;
+    }
+
+    void fail(const std::string& message) {
+        if (error.empty()) {
+            error = message;
+        }
+    }
+};
+
+// 按类型选择访存操作码，不支持的类型返回 OP_COUNT
+// 2～7 位的整数（协程帧中的挂起点序号）占一个字节
+Opcode loadOpcode(llvm::Type* type) {
+    if (type->isIntegerTy(1))       return OP_LOAD_I1;
+    if (type->isIntegerTy() && type->getIntegerBitWidth() <= 8) return OP_LOAD_I8;
+    if (type->isIntegerTy(16))      return OP_LOAD_I16;
+    if (type->isIntegerTy(32))      return OP_LOAD_I32;
+    if (type->isIntegerTy(64) || type->isPointerTy()) return OP_LOAD_I64;
+    if (type->isFloatTy())          return OP_LOAD_F32;
+    if (type->isDoubleTy())         return OP_LOAD_F64;
+    return OP_COUNT;
+}
+
+Opcode storeOpcode(llvm::Type* type) {
+    if (type->isIntegerTy() && type->getIntegerBitWidth() <= 8) return OP_STORE_I8;
+    if (type->isIntegerTy(16))      return OP_STORE_I16;
+    if (type->isIntegerTy(32))      return OP_STORE_I32;
+    if (type->isIntegerTy(64) || type->isPointerTy()) return OP_STORE_I64;
+    if (type->isFloatTy())          return OP_STORE_F32;
+    if (type->isDoubleTy())         return OP_STORE_F64;
+    return OP_COUNT;
+}
+
+Opcode icmpOpcode(llvm::CmpInst::Predicate predicate) {
+    switch (predicate) {
+        case llvm::CmpInst::ICMP_EQ:  return OP_ICMP_EQ;
+        case llvm::CmpInst::ICMP_NE:  return OP_ICMP_NE;
+        case llvm::CmpInst::ICMP_SLT: return OP_ICMP_SLT;
+        case llvm::CmpInst::ICMP_SLE: return OP_ICMP_SLE;
+        case llvm::CmpInst::ICMP_SGT: return OP_ICMP_SGT;
+        case llvm::CmpInst::ICMP_SGE: return OP_ICMP_SGE;
+        case llvm::CmpInst::ICMP_ULT: return OP_ICMP_ULT;
+        case llvm::CmpInst::ICMP_ULE: return OP_ICMP_ULE;
+        case llvm::CmpInst::ICMP_UGT: return OP_ICMP_UGT;
+        default:                      return OP_ICMP_UGE;
+    }
+}
+
+bool isVectorInstruction(const llvm::Instruction& inst) {
+    // 用户函数的向量参数和返回值按元素占用连续的寄存器，由普通的调用和返回处理
+    if (llvm::isa<llvm::ReturnInst>(inst)) {
+        return false;
+    }
+    if (auto* call = llvm::dyn_cast<llvm::CallInst>(&inst)) {
+        if (!call->getCalledFunction() || !call->getCalledFunction()->isIntrinsic()) {
+            return false;
+        }
+    }
+    if (inst.getType()->isVectorTy()) {
+        return true;
+    }
+    for (const llvm::Use& use : inst.operands()) {
+        if (use->getType()->isVectorTy()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 向量指令逐元素展开：第 k 个元素位于 "第一个寄存器 + k"
+void lowerVectorInstruction(Lowering& lower, llvm::Instruction& inst) {
+    uint32_t dst = lower.reg(&inst);
+    auto operand = [&](unsigned i) { return lower.reg(inst.getOperand(i)); };
+    llvm::Type* scalar = inst.getType()->getScalarType();
+    unsigned lanes = laneCount(inst.getType());
+    unsigned width = scalar->isIntegerTy() ? scalar->getIntegerBitWidth() : scalar->isFloatTy() ? 32 : 64;
+
+    // 两个操作数逐元素运算
+    auto elementwise = [&](Opcode op, int64_t imm, uint16_t w) {
+        for (unsigned k = 0; k < lanes; k++) {
+            lower.emit(op, dst + k, operand(0) + k, operand(1) + k, 0, imm, w);
+        }
+    };
+    // 一个操作数逐元素运算（取负和类型转换，宽度为结果的位宽）
+    auto unary = [&](Opcode op, uint16_t w) {
+        for (unsigned k = 0; k < lanes; k++) {
+            lower.emit(op, dst + k, operand(0) + k, 0, 0, 0, w);
+        }
+    };
+
+    switch (inst.getOpcode()) {
+        case llvm::Instruction::Add:  elementwise(OP_ADD, 0, width); return;
+        case llvm::Instruction::Sub:  elementwise(OP_SUB, 0, width); return;
+        case llvm::Instruction::Mul:  elementwise(OP_MUL, 0, width); return;
+        case llvm::Instruction::SDiv: elementwise(OP_SDIV, 0, width); return;
+        case llvm::Instruction::SRem: elementwise(OP_SREM, 0, width); return;
+        case llvm::Instruction::And:  elementwise(OP_AND, 0, width); return;
+        case llvm::Instruction::Or:   elementwise(OP_OR, 0, width); return;
+        case llvm::Instruction::Xor:  elementwise(OP_XOR, 0, width); return;
+        case llvm::Instruction::FAdd: elementwise(OP_FADD, 0, width); return;
+        case llvm::Instruction::FSub: elementwise(OP_FSUB, 0, width); return;
+        case llvm::Instruction::FMul: elementwise(OP_FMUL, 0, width); return;
+        case llvm::Instruction::FDiv: elementwise(OP_FDIV, 0, width); return;
+        case llvm::Instruction::FRem: elementwise(OP_FREM, 0, width); return;
+        case llvm::Instruction::FNeg: unary(OP_FNEG, width); return;
+        case llvm::Instruction::SIToFP: unary(OP_SITOFP, width); return;
+        case llvm::Instruction::FPToSI: unary(OP_FPTOSI, width); return;
+        case llvm::Instruction::ICmp: {
+            llvm::Type* compared = inst.getOperand(0)->getType()->getScalarType();
+            elementwise(icmpOpcode(llvm::cast<llvm::ICmpInst>(&inst)->getPredicate()), 0, integerWidth(compared));
+            return;
+        }
+        case llvm::Instruction::FCmp:
+            elementwise(OP_FCMP, llvm::cast<llvm::FCmpInst>(&inst)->getPredicate(), 0);
+            return;
+        case llvm::Instruction::Select: {
+            // 条件可以是标量，也可以是逐元素的向量
+            bool vectorCondition = inst.getOperand(0)->getType()->isVectorTy();
+            for (unsigned k = 0; k < lanes; k++) {
+                lower.emit(OP_SELECT, dst + k, operand(0) + (vectorCondition ? k : 0), operand(1) + k, operand(2) + k);
+            }
+            return;
+        }
+        case llvm::Instruction::Load:
+        case llvm::Instruction::Store: {
+            bool isLoad = inst.getOpcode() == llvm::Instruction::Load;
+            llvm::Type* element = isLoad ? scalar : inst.getOperand(0)->getType()->getScalarType();
+            unsigned count = isLoad ? lanes : laneCount(inst.getOperand(0)->getType());
+            Opcode op = isLoad ? loadOpcode(element) : storeOpcode(element);
+            if (op == OP_COUNT) {
+                lower.fail("unsupported vector element type in '" + lower.fn.name + "'");
+                return;
+            }
+            uint32_t base = isLoad ? operand(0) : operand(1);
+            int64_t stride = lower.dataLayout.getTypeAllocSize(element);
+            for (unsigned k = 0; k < count; k++) {
+                uint32_t address = base;
+                if (k > 0) {
+                    address = lower.newRegister();
+                    lower.emit(OP_ADDI, address, base, 0, 0, k * stride);
+                }
+                if (isLoad) {
+                    lower.emit(op, dst + k, address);
+                } else {
+                    lower.emit(op, NO_REGISTER, address, operand(0) + k);
+                }
+            }
+            return;
+        }
+        case llvm::Instruction::InsertElement:
+        case llvm::Instruction::ExtractElement: {
+            auto* index = llvm::dyn_cast<llvm::ConstantInt>(inst.getOperand(inst.getNumOperands() - 1));
+            if (!index) {
+                lower.fail("variable vector index is not supported in '" + lower.fn.name + "'");
+                return;
+            }
+            uint32_t lane = index->getZExtValue();
+            if (inst.getOpcode() == llvm::Instruction::ExtractElement) {
+                lower.emit(OP_MOV, dst, operand(0) + lane);
+                return;
+            }
+            for (unsigned k = 0; k < lanes; k++) {
+                lower.emit(OP_MOV, dst + k, k == lane ? operand(1) : operand(0) + k);
+            }
+            return;
+        }
+        case llvm::Instruction::BitCast: {
+            // <N x i1> 到 iN：逐元素比较的结果压缩为位掩码，第 k 个元素为第 k 位
+            llvm::Type* source = inst.getOperand(0)->getType();
+            if (inst.getType()->isVectorTy() || !source->getScalarType()->isIntegerTy(1)) {
+                lower.fail("unsupported vector bitcast in '" + lower.fn.name + "'");
+                return;
+            }
+            lower.emit(OP_MOV, dst, operand(0));
+            for (unsigned k = 1; k < laneCount(source); k++) {
+                lower.emit(OP_MADD, dst, dst, operand(0) + k, 0, static_cast<int64_t>(uint64_t(1) << k));
+            }
+            lower.emit(OP_TRUNC, dst, dst, 0, 0, 0, integerWidth(inst.getType()));
+            return;
+        }
+        case llvm::Instruction::ShuffleVector: {
+            auto* shuffle = llvm::cast<llvm::ShuffleVectorInst>(&inst);
+            int inputLanes = laneCount(shuffle->getOperand(0)->getType());
+            for (unsigned k = 0; k < lanes; k++) {
+                int element = shuffle->getMaskValue(k);
+                if (element < 0) {
+                    continue;   // 未定义的元素
+                }
+                uint32_t src = element < inputLanes ? operand(0) + element : operand(1) + (element - inputLanes);
+                lower.emit(OP_MOV, dst + k, src);
+            }
+            return;
+        }
+        case llvm::Instruction::Call: {
+            // 水平归约：从起始值（或第一个元素）开始按元素顺序依次合并
+            auto* call = llvm::cast<llvm::CallInst>(&inst);
+            llvm::Function* callee = call->getCalledFunction();
+            llvm::Intrinsic::ID id = callee ? callee->getIntrinsicID() : llvm::Intrinsic::not_intrinsic;
+            bool ordered = id == llvm::Intrinsic::vector_reduce_fadd || id == llvm::Intrinsic::vector_reduce_fmul;
+            llvm::Value* vector = call->getArgOperand(ordered ? 1 : 0);
+            uint32_t first = lower.reg(vector);
+            unsigned count = laneCount(vector->getType());
+            Opcode op = OP_COUNT;
+            int64_t predicate = 0;
+            switch (id) {
+                case llvm::Intrinsic::vector_reduce_add:  op = OP_ADD; break;
+                case llvm::Intrinsic::vector_reduce_mul:  op = OP_MUL; break;
+                case llvm::Intrinsic::vector_reduce_and:  op = OP_AND; break;
+                case llvm::Intrinsic::vector_reduce_or:   op = OP_OR; break;
+                case llvm::Intrinsic::vector_reduce_xor:  op = OP_XOR; break;
+                case llvm::Intrinsic::vector_reduce_fadd: op = OP_FADD; break;
+                case llvm::Intrinsic::vector_reduce_fmul: op = OP_FMUL; break;
+                case llvm::Intrinsic::vector_reduce_smin: op = OP_ICMP_SLT; break;
+                case llvm::Intrinsic::vector_reduce_smax: op = OP_ICMP_SGT; break;
+                case llvm::Intrinsic::vector_reduce_umin: op = OP_ICMP_ULT; break;
+                case llvm::Intrinsic::vector_reduce_umax: op = OP_ICMP_UGT; break;
+                case llvm::Intrinsic::vector_reduce_fmin: op = OP_FCMP; predicate = llvm::CmpInst::FCMP_OLT; break;
+                case llvm::Intrinsic::vector_reduce_fmax: op = OP_FCMP; predicate = llvm::CmpInst::FCMP_OGT; break;
+                default: break;
+            }
+            if (op == OP_COUNT || count == 0) {
+                lower.fail("unsupported vector call in '" + lower.fn.name + "'");
+                return;
+            }
+            if (ordered) {
+                lower.emit(op, dst, operand(0), first, 0, 0, width);
+            } else {
+                lower.emit(OP_MOV, dst, first);
+            }
+            bool compare = op == OP_FCMP || (op >= OP_ICMP_EQ && op <= OP_ICMP_UGE);
+            uint32_t flag = compare ? lower.newRegister() : NO_REGISTER;
+            for (unsigned k = 1; k < count; k++) {
+                if (compare) {
+                    // 最值：元素比当前结果更小（更大）时替换
+                    lower.emit(op, flag, first + k, dst, 0, predicate, width);
+                    lower.emit(OP_SELECT, dst, flag, first + k, dst);
+                } else {
+                    lower.emit(op, dst, dst, first + k, 0, 0, width);
+                }
+            }
+            return;
+        }
+        default:
+            lower.fail(std::string("unsupported vector instruction '") + inst.getOpcodeName() +
+                       "' in '" + lower.fn.name + "'");
+            return;
+    }
+}
+
+}  // namespace
+
+bool BytecodeInterpreter::lowerFunction(BytecodeFunction& fn) {
+    llvm::Function& function = *fn.source;
+    Lowering lower(dataLayout, fn);
+
+    // 第一遍：常量寄存器放在帧的最前面
+    for (auto& bb : function) {
+        for (auto& inst : bb) {
+            for (const llvm::Use& use : inst.operands()) {
+                auto* c = llvm::dyn_cast<llvm::Constant>(use.get());
+                if (!c || lower.registers.count(c) || llvm::isa<llvm::BasicBlock>(use.get())) {
+                    continue;
+                }
+                if (auto* f = llvm::dyn_cast<llvm::Function>(c)) {
+                    auto* call = llvm::dyn_cast<llvm::CallBase>(&inst);
+                    if (call && call->getCalledOperand() == f) {
+                        continue;   // 直接调用的目标不占寄存器
+                    }
+                    if (!call || !call->getCalledFunction() || call->getCalledFunction()->getName() != "pthread_create") {
+                        fn.tierUpCandidate = false;
+                    }
+                }
+                InterpSlot value;
+                if (auto* vectorType = llvm::dyn_cast<llvm::FixedVectorType>(c->getType())) {
+                    // 向量常量每个元素一个寄存器，未定义的元素为 0
+                    lower.registers[c] = lower.newRegisters(vectorType->getNumElements());
+                    for (unsigned k = 0; k < vectorType->getNumElements(); k++) {
+                        llvm::Constant* element = c->getAggregateElement(k);
+                        value.i = 0;
+                        if (element && !evaluateConstant(element, value)) {
+                            lower.fail("unsupported vector constant in '" + fn.name + "'");
+                        }
+                        fn.constants.push_back(value);
+                    }
+                    continue;
+                }
+                if (!evaluateConstant(c, value)) {
+                    if (llvm::isa<llvm::SwitchInst>(inst) || llvm::isa<llvm::IntrinsicInst>(inst) ||
+                        llvm::isa<llvm::MetadataAsValue>(use.get())) {
+                        continue;
+                    }
+                    lower.fail("unsupported constant operand in '" + fn.name + "'");
+                    continue;
+                }
+                lower.registers[c] = lower.newRegister();
+                fn.constants.push_back(value);
+            }
+        }
+    }
+
+    // 参数和指令结果
+    fn.argBase = lower.nextRegister;
+    // 向量参数每个元素一个寄存器
+    for (auto& arg : function.args()) {
+        lower.registers[&arg] = lower.newRegisters(laneCount(arg.getType()));
+        fn.argCount += laneCount(arg.getType());
+    }
+    for (auto& bb : function) {
+        for (auto& inst : bb) {
+            if (!inst.getType()->isVoidTy()) {
+                lower.registers[&inst] = lower.newRegisters(laneCount(inst.getType()));
+            }
+        }
+    }
+
+    // 入口块中定长的 alloca 静态分配
+    std::map<const llvm::AllocaInst*, uint64_t> staticAllocas;
+    for (auto& inst : function.getEntryBlock()) {
+        auto* alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst);
+        if (!alloca || !llvm::isa<llvm::ConstantInt>(alloca->getArraySize())) {
+            continue;
+        }
+        uint64_t align = std::max<uint64_t>(alloca->getAlign().value(), 1);
+        uint64_t size = dataLayout.getTypeAllocSize(alloca->getAllocatedType()) *
+                        llvm::cast<llvm::ConstantInt>(alloca->getArraySize())->getZExtValue();
+        fn.frameBytes = (fn.frameBytes + align - 1) / align * align;
+        staticAllocas[alloca] = fn.frameBytes;
+        fn.frameBytes += size;
+    }
+    fn.frameBytes = (fn.frameBytes + 15) / 16 * 16;
+
+    // 第二遍：逐条指令降级
+    for (auto& bb : function) {
+        lower.blockStart[&bb] = fn.code.size();
+        for (auto& inst : bb) {
+            if (llvm::isa<llvm::PHINode>(inst)) {
+                continue;   // 在前驱边上展开
+            }
+            if (isVectorInstruction(inst)) {
+                lowerVectorInstruction(lower, inst);
+                continue;
+            }
+            uint32_t dst = lower.reg(&inst);
+            auto operand = [&](unsigned i) { return lower.reg(inst.getOperand(i)); };
+            unsigned width = inst.getType()->isIntegerTy() ? inst.getType()->getIntegerBitWidth() : 64;
+
+            switch (inst.getOpcode()) {
+                case llvm::Instruction::Add:  lower.emit(OP_ADD, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::Sub:  lower.emit(OP_SUB, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::Mul:  lower.emit(OP_MUL, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::SDiv: lower.emit(OP_SDIV, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::UDiv: lower.emit(OP_UDIV, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::SRem: lower.emit(OP_SREM, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::URem: lower.emit(OP_UREM, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::And:  lower.emit(OP_AND, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::Or:   lower.emit(OP_OR, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::Xor:  lower.emit(OP_XOR, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::Shl:  lower.emit(OP_SHL, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::LShr: lower.emit(OP_LSHR, dst, operand(0), operand(1), 0, 0, width); break;
+                case llvm::Instruction::AShr: lower.emit(OP_ASHR, dst, operand(0), operand(1), 0, 0, width); break;
+
+                case llvm::Instruction::FAdd:
+                case llvm::Instruction::FSub:
+                case llvm::Instruction::FMul:
+                case llvm::Instruction::FDiv:
+                case llvm::Instruction::FRem: {
+                    static const Opcode ops[] = {OP_FADD, OP_FSUB, OP_FMUL, OP_FDIV, OP_FREM};
+                    unsigned k = inst.getOpcode() == llvm::Instruction::FAdd ? 0
+                               : inst.getOpcode() == llvm::Instruction::FSub ? 1
+                               : inst.getOpcode() == llvm::Instruction::FMul ? 2
+                               : inst.getOpcode() == llvm::Instruction::FDiv ? 3 : 4;
+                    lower.emit(ops[k], dst, operand(0), operand(1), 0, 0,
+                               inst.getType()->isFloatTy() ? 32 : 64);
+                    break;
+                }
+                case llvm::Instruction::FNeg:
+                    lower.emit(OP_FNEG, dst, operand(0));
+                    break;
+
+                case llvm::Instruction::ICmp: {
+                    auto* cmp = llvm::cast<llvm::ICmpInst>(&inst);
+                    unsigned w = integerWidth(cmp->getOperand(0)->getType());
+                    lower.emit(icmpOpcode(cmp->getPredicate()), dst, operand(0), operand(1), 0, 0, w);
+                    break;
+                }
+                case llvm::Instruction::FCmp:
+                    lower.emit(OP_FCMP, dst, operand(0), operand(1), 0,
+                               llvm::cast<llvm::FCmpInst>(&inst)->getPredicate());
+                    break;
+
+                case llvm::Instruction::SExt:
+                    if (inst.getOperand(0)->getType()->isIntegerTy(1)) {
+                        lower.emit(OP_SEXT1, dst, operand(0), 0, 0, 0, width);
+                    } else {
+                        lower.emit(OP_MOV, dst, operand(0));
+                    }
+                    break;
+                case llvm::Instruction::ZExt:
+                    lower.emit(OP_ZEXT, dst, operand(0), 0, 0, 0,
+                               integerWidth(inst.getOperand(0)->getType()));
+                    break;
+                case llvm::Instruction::Trunc:
+                case llvm::Instruction::PtrToInt:
+                    lower.emit(OP_TRUNC, dst, operand(0), 0, 0, 0, width);
+                    break;
+                case llvm::Instruction::IntToPtr:
+                case llvm::Instruction::BitCast:
+                case llvm::Instruction::AddrSpaceCast:
+                case llvm::Instruction::FPExt:
+                case llvm::Instruction::Freeze:
+                    lower.emit(OP_MOV, dst, operand(0));
+                    break;
+                case llvm::Instruction::SIToFP:
+                    lower.emit(OP_SITOFP, dst, operand(0), 0, 0, 0, inst.getType()->isFloatTy() ? 32 : 64);
+                    break;
+                case llvm::Instruction::UIToFP:
+                    lower.emit(OP_UITOFP, dst, operand(0), 0, 0, integerWidth(inst.getOperand(0)->getType()),
+                               inst.getType()->isFloatTy() ? 32 : 64);
+                    break;
+                case llvm::Instruction::FPToSI:
+                    lower.emit(OP_FPTOSI, dst, operand(0), 0, 0, 0, width);
+                    break;
+                case llvm::Instruction::FPToUI:
+                    lower.emit(OP_FPTOUI, dst, operand(0), 0, 0, 0, width);
+                    break;
+                case llvm::Instruction::FPTrunc:
+                    lower.emit(OP_FPTRUNC, dst, operand(0));
+                    break;
+
+                case llvm::Instruction::Select:
+                    lower.emit(OP_SELECT, dst, operand(0), operand(1), operand(2));
+                    break;
+
+                case llvm::Instruction::Load: {
+                    if (llvm::cast<llvm::LoadInst>(&inst)->isAtomic()) {
+                        if (!inst.getType()->isIntegerTy() && !inst.getType()->isPointerTy()) {
+                            lower.fail("unsupported atomic load type in '" + fn.name + "'");
+                            break;
+                        }
+                        lower.emit(OP_ATOMIC_LOAD, dst, operand(0), 0, 0, 0, integerWidth(inst.getType()));
+                        break;
+                    }
+                    Opcode op = loadOpcode(inst.getType());
+                    if (op == OP_COUNT) {
+                        lower.fail("unsupported load type in '" + fn.name + "'");
+                        break;
+                    }
+                    lower.emit(op, dst, operand(0));
+                    break;
+                }
+                case llvm::Instruction::Store: {
+                    llvm::Type* stored = inst.getOperand(0)->getType();
+                    if (llvm::cast<llvm::StoreInst>(&inst)->isAtomic()) {
+                        if (!stored->isIntegerTy() && !stored->isPointerTy()) {
+                            lower.fail("unsupported atomic store type in '" + fn.name + "'");
+                            break;
+                        }
+                        lower.emit(OP_ATOMIC_STORE, NO_REGISTER, operand(1), operand(0), 0, 0, integerWidth(stored));
+                        break;
+                    }
+                    Opcode op = storeOpcode(stored);
+                    if (op == OP_COUNT) {
+                        lower.fail("unsupported store type in '" + fn.name + "'");
+                        break;
+                    }
+                    lower.emit(op, NO_REGISTER, operand(1), operand(0));
+                    break;
+                }
+
+                case llvm::Instruction::AtomicCmpXchg: {
+                    llvm::Type* compared = inst.getOperand(1)->getType();
+                    if (!compared->isIntegerTy() && !compared->isPointerTy()) {
+                        lower.fail("unsupported cmpxchg type in '" + fn.name + "'");
+                        break;
+                    }
+                    lower.emit(OP_CMPXCHG, dst, operand(0), operand(1), operand(2), 0, integerWidth(compared));
+                    break;
+                }
+                case llvm::Instruction::ExtractValue: {
+                    auto* extract = llvm::cast<llvm::ExtractValueInst>(&inst);
+                    if (extract->getNumIndices() != 1 || !extract->getAggregateOperand()->getType()->isStructTy()) {
+                        lower.fail("unsupported extractvalue in '" + fn.name + "'");
+                        break;
+                    }
+                    lower.emit(OP_MOV, dst, operand(0) + extract->getIndices()[0]);
+                    break;
+                }
+
+                case llvm::Instruction::Alloca: {
+                    auto* alloca = llvm::cast<llvm::AllocaInst>(&inst);
+                    auto it = staticAllocas.find(alloca);
+                    if (it != staticAllocas.end()) {
+                        lower.emit(OP_FRAME_ADDR, dst, 0, 0, 0, it->second);
+                    } else {
+                        uint64_t size = dataLayout.getTypeAllocSize(alloca->getAllocatedType());
+                        lower.emit(OP_ALLOCA, dst, lower.reg(alloca->getArraySize()), 0, 0, size,
+                                   integerWidth(alloca->getArraySize()->getType()));
+                    }
+                    break;
+                }
+
+                case llvm::Instruction::GetElementPtr: {
+                    auto* gep = llvm::cast<llvm::GetElementPtrInst>(&inst);
+                    uint32_t current = operand(0);
+                    int64_t offset = 0;
+                    for (auto it = llvm::gep_type_begin(gep); it != llvm::gep_type_end(gep); ++it) {
+                        const llvm::Value* index = it.getOperand();
+                        if (llvm::StructType* st = it.getStructTypeOrNull()) {
+                            unsigned field = llvm::cast<llvm::ConstantInt>(index)->getZExtValue();
+                            offset += dataLayout.getStructLayout(st)->getElementOffset(field);
+                            continue;
+                        }
+                        int64_t stride = dataLayout.getTypeAllocSize(it.getIndexedType());
+                        if (auto* ci = llvm::dyn_cast<llvm::ConstantInt>(index)) {
+                            offset += ci->getSExtValue() * stride;
+                        } else {
+                            lower.emit(OP_MADD, dst, current, lower.reg(index), 0, stride);
+                            current = dst;
+                        }
+                    }
+                    if (offset != 0 || current != dst) {
+                        lower.emit(OP_ADDI, dst, current, 0, 0, offset);
+                    }
+                    break;
+                }
+
+                case llvm::Instruction::Call: {
+                    auto* call = llvm::cast<llvm::CallInst>(&inst);
+                    llvm::Function* callee = call->getCalledFunction();
+                    if (!callee) {
+                        uint32_t argStart = fn.callArgs.size();
+                        for (unsigned i = 0; i < call->arg_size(); i++) {
+                            fn.callArgs.push_back(lower.reg(call->getArgOperand(i)));
+                        }
+                        lower.emit(OP_CALL_INDIRECT, dst, lower.reg(call->getCalledOperand()), argStart, call->arg_size());
+                        fn.tierUpCandidate = false;
+                        break;
+                    }
+                    std::string calleeName = callee->getName().str();
+
+                    // 无副作用的调试/生命周期内建函数直接忽略
+                    if (callee->isIntrinsic()) {
+                        llvm::Intrinsic::ID id = callee->getIntrinsicID();
+                        if (id == llvm::Intrinsic::lifetime_start || id == llvm::Intrinsic::lifetime_end ||
+                            id == llvm::Intrinsic::dbg_declare || id == llvm::Intrinsic::dbg_value ||
+                            id == llvm::Intrinsic::assume) {
+                            break;
+                        }
+                        if (id == llvm::Intrinsic::cttz) {
+                            lower.emit(OP_CTTZ, dst, operand(0), 0, 0, 0, integerWidth(call->getType()));
+                            break;
+                        }
+                        if (id == llvm::Intrinsic::memcpy || id == llvm::Intrinsic::memmove ||
+                            id == llvm::Intrinsic::memset) {
+                            Opcode op = id == llvm::Intrinsic::memcpy ? OP_MEMCPY
+                                      : id == llvm::Intrinsic::memmove ? OP_MEMMOVE : OP_MEMSET;
+                            lower.emit(op, NO_REGISTER, operand(0), operand(1), operand(2));
+                            break;
+                        }
+                    }
+                    if (calleeName == "setjmp" || calleeName == "_setjmp") {
+                        lower.emit(OP_SETJMP, dst, operand(0));
+                        break;
+                    }
+                    if (calleeName == "longjmp" || calleeName == "_longjmp") {
+                        lower.emit(OP_LONGJMP, NO_REGISTER, operand(0), operand(1));
+                        break;
+                    }
+                    if (calleeName == "pthread_create") {
+                        // 线程函数必须是模块中定义的函数，在新线程中由解释器执行
+                        auto* entry = llvm::dyn_cast<llvm::Function>(call->getArgOperand(2));
+                        auto defined = entry ? functionIndex.find(entry) : functionIndex.end();
+                        if (defined == functionIndex.end()) {
+                            lower.fail("unsupported thread function in '" + fn.name + "'");
+                            break;
+                        }
+                        lower.emit(OP_SPAWN, dst, operand(0), operand(1), operand(3), defined->second, 32);
+                        break;
+                    }
+
+                    // 用户函数的向量参数按元素依次传递
+                    uint32_t argStart = fn.callArgs.size();
+                    auto defined = functionIndex.find(callee);
+                    bool user = defined != functionIndex.end();
+                    for (unsigned i = 0; i < call->arg_size(); i++) {
+                        llvm::Value* arg = call->getArgOperand(i);
+                        for (unsigned k = 0; k < (user ? laneCount(arg->getType()) : 1); k++) {
+                            fn.callArgs.push_back(lower.reg(arg) + k);
+                        }
+                    }
+                    if (user) {
+                        // 向量结果在返回时留在被调函数帧的开头，按元素复制回来
+                        lower.emit(OP_CALL, dst, 0, argStart, fn.callArgs.size() - argStart, defined->second,
+                                   laneCount(call->getType()));
+                        break;
+                    }
+                    int native = resolveNative(callee);
+                    if (native < 0) {
+                        lower.fail("unresolved external function '" + calleeName + "'");
+                        break;
+                    }
+                    if (natives[native]->kind == NATIVE_VARIADIC) {
+                        for (unsigned i = 0; i < call->arg_size(); i++) {
+                            if (call->getArgOperand(i)->getType()->isFloatingPointTy() || i >= 8) {
+                                lower.fail("unsupported variadic call to '" + calleeName + "'");
+                            }
+                        }
+                    }
+                    lower.emit(OP_CALL_NATIVE, dst, 0, argStart, call->arg_size(), native);
+                    break;
+                }
+
+                case llvm::Instruction::Br: {
+                    auto* br = llvm::cast<llvm::BranchInst>(&inst);
+                    if (br->isUnconditional()) {
+                        size_t index = fn.code.size();
+                        lower.emit(OP_JMP);
+                        lower.fixups.push_back({index, 0, lower.edgeTo(&bb, br->getSuccessor(0)), 0});
+                    } else {
+                        size_t index = fn.code.size();
+                        lower.emit(OP_BR, NO_REGISTER, lower.reg(br->getCondition()));
+                        lower.fixups.push_back({index, 0, lower.edgeTo(&bb, br->getSuccessor(0)), 0});
+                        lower.fixups.push_back({index, 1, lower.edgeTo(&bb, br->getSuccessor(1)), 0});
+                    }
+                    break;
+                }
+                case llvm::Instruction::Switch: {
+                    auto* sw = llvm::cast<llvm::SwitchInst>(&inst);
+                    size_t index = fn.code.size();
+                    SwitchTable table;
+                    table.defaultTarget = 0;
+                    std::vector<std::pair<int64_t, const llvm::BasicBlock*>> cases;
+                    for (auto& c : sw->cases()) {
+                        InterpSlot value;
+                        evaluateConstant(c.getCaseValue(), value);
+                        cases.push_back({value.i, c.getCaseSuccessor()});
+                    }
+                    std::sort(cases.begin(), cases.end(),
+                              [](const auto& x, const auto& y) { return x.first < y.first; });
+                    for (size_t i = 0; i < cases.size(); i++) {
+                        table.cases.push_back({cases[i].first, 0});
+                        lower.fixups.push_back({index, 2, lower.edgeTo(&bb, cases[i].second), i});
+                    }
+                    lower.fixups.push_back({index, 3, lower.edgeTo(&bb, sw->getDefaultDest()), 0});
+                    fn.switches.push_back(table);
+                    lower.emit(OP_SWITCH, NO_REGISTER, lower.reg(sw->getCondition()), fn.switches.size() - 1);
+                    break;
+                }
+                case llvm::Instruction::Ret:
+                    if (inst.getNumOperands() == 0) {
+                        lower.emit(OP_RET_VOID);
+                    } else {
+                        lower.emit(OP_RET, NO_REGISTER, operand(0), 0, 0, 0, laneCount(inst.getOperand(0)->getType()));
+                    }
+                    break;
+                case llvm::Instruction::Unreachable:
+                    lower.emit(OP_UNREACHABLE);
+                    break;
+
+                default:
+                    lower.fail(std::string("unsupported instruction '") + inst.getOpcodeName() +
+                               "' in '" + fn.name + "'");
+                    break;
+            }
+        }
+    }
+
+    // 边：没有 phi 的后继直接跳转，有 phi 的后继先执行并行复制
+    // 指向更早（或同一）基本块的边视为循环回边
+    std::vector<uint32_t> edgeTarget(lower.edges.size());
+    std::vector<char> edgeBackward(lower.edges.size());
+    for (size_t e = 0; e < lower.edges.size(); e++) {
+        const auto& edge = lower.edges[e];
+        bool backward = lower.blockStart[edge.to] <= lower.blockStart[edge.from];
+        std::vector<std::pair<uint32_t, uint32_t>> moves;     // (dst, src)
+        for (const llvm::PHINode& phi : edge.to->phis()) {
+            uint32_t src = lower.reg(phi.getIncomingValueForBlock(edge.from));
+            if (src == NO_REGISTER) {
+                lower.fail("unsupported phi operand in '" + fn.name + "'");
+                continue;
+            }
+            for (unsigned k = 0; k < laneCount(phi.getType()); k++) {
+                moves.push_back({lower.reg(&phi) + k, src + k});
+            }
+        }
+        if (moves.empty()) {
+            edgeTarget[e] = lower.blockStart[edge.to];
+            edgeBackward[e] = backward;
+            continue;
+        }
+        edgeTarget[e] = fn.code.size();
+        bool conflict = false;
+        for (const auto& move : moves) {
+            for (const auto& other : moves) {
+                conflict = conflict || move.second == other.first;
+            }
+        }
+        if (conflict) {
+            std::vector<uint32_t> temps;
+            for (const auto& move : moves) {
+                temps.push_back(lower.newRegister());
+                lower.emit(OP_MOV, temps.back(), move.second);
+            }
+            for (size_t i = 0; i < moves.size(); i++) {
+                lower.emit(OP_MOV, moves[i].first, temps[i]);
+            }
+        } else {
+            for (const auto& move : moves) {
+                lower.emit(OP_MOV, move.first, move.second);
+            }
+        }
+        lower.emit(backward ? OP_LOOP : OP_JMP, NO_REGISTER, 0, 0, 0, lower.blockStart[edge.to]);
+    }
+    for (const auto& fixup : lower.fixups) {
+        Instr& instr = fn.code[fixup.index];
+        uint32_t target = edgeTarget[fixup.edge];
+        if (edgeBackward[fixup.edge] && instr.op == OP_JMP) {
+            instr.op = OP_LOOP;
+        } else if (edgeBackward[fixup.edge] && instr.op == OP_BR) {
+            instr.op = OP_BR_LOOP;
+        }
+        switch (fixup.field) {
+            case 0: instr.imm = target; break;
+            case 1: instr.c = target; break;
+            case 2: fn.switches[instr.b].cases[fixup.caseIndex].second = target; break;
+            default: fn.switches[instr.b].defaultTarget = target; break;
+        }
+    }
+
+    fn.frameSize = lower.nextRegister;
+    if (!lower.error.empty()) {
+        std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": -interp: "
+                  << lower.error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool BytecodeInterpreter::prepare() {
+    mainStack.reset(new ThreadStack(REGISTER_STACK_SLOTS, MEMORY_STACK_BYTES));
+    currentStack = mainStack.get();
+
+    if (!allocateGlobals()) {
+        return false;
+    }
+
+    for (auto& function : module->functions()) {
+        if (function.isDeclaration()) {
+            continue;
+        }
+        std::unique_ptr<BytecodeFunction> fn(new BytecodeFunction());
+        fn->source = &function;
+        fn->name = function.getName().str();
+        fn->index = functions.size();
+        functionIndex[&function] = functions.size();
+        functions.push_back(std::move(fn));
+    }
+
+    size_t instructions = 0;
+    for (auto& fn : functions) {
+        if (!lowerFunction(*fn)) {
+            return false;
+        }
+        instructions += fn->code.size();
+    }
+
+    if (g_verbose) {
+        std::cout << "[Interp] Lowered " << functions.size() << " function(s) to "
+                  << instructions << " bytecode instruction(s), " << natives.size()
+                  << " native function(s)" << std::endl;
+    }
+    return true;
+}
+
+// 执行
+
+InterpSlot BytecodeInterpreter::invoke(unsigned index) {
+    BytecodeFunction& fn = *functions[index];
+    ThreadStack& stack = *currentStack;
+    InterpSlot* regs = stack.registerTop;
+    if (regs + fn.frameSize > stack.registerLimit) {
+        throw InterpError{"stack overflow in '" + fn.name + "'"};
+    }
+    char* savedMemoryTop = stack.memoryTop;
+    char* frameMemory = stack.memoryTop;
+    if (frameMemory + fn.frameBytes > stack.memoryLimit) {
+        throw InterpError{"stack overflow in '" + fn.name + "'"};
+    }
+
+    // 帧在返回或被 longjmp 回溯时释放
+    struct FrameGuard {
+        ThreadStack& stack;
+        InterpSlot* regs;
+        char* memory;
+        ~FrameGuard() {
+            stack.registerTop = regs;
+            stack.memoryTop = memory;
+        }
+    } guard{stack, regs, savedMemoryTop};
+
+    stack.registerTop = regs + fn.frameSize;
+    stack.memoryTop = frameMemory + fn.frameBytes;
+    if (!fn.constants.empty()) {
+        std::memcpy(regs, fn.constants.data(), fn.constants.size() * sizeof(InterpSlot));
+    }
+    return execute(fn, regs, frameMemory, ++stack.frameSerial);
+}
+
+InterpSlot BytecodeInterpreter::call(unsigned index, const InterpSlot* regs, const uint32_t* args, uint32_t argc) {
+    BytecodeFunction& callee = *functions[index];
+    ThreadStack& stack = *currentStack;
+    InterpSlot* calleeRegs = stack.registerTop;
+    if (calleeRegs + callee.frameSize > stack.registerLimit) {
+        throw InterpError{"stack overflow in '" + callee.name + "'"};
+    }
+    InterpSlot result;
+    NativeEntry entry = callee.nativeEntry.load(std::memory_order_acquire);
+    if (entry) {
+        // 已分层编译：参数按顺序放在栈顶，直接调用本地代码
+        for (uint32_t i = 0; i < argc; i++) {
+            calleeRegs[i] = regs[args[i]];
+        }
+        entry(calleeRegs, &result);
+    } else {
+        for (uint32_t i = 0; i < argc; i++) {
+            calleeRegs[callee.argBase + i] = regs[args[i]];
+        }
+        if (callee.heat(tierUpThreshold)) requestTierUp(callee);
+        result = invoke(index);
+    }
+    return result;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PPX_COMPUTED_GOTO 1
+#endif
+
+InterpSlot BytecodeInterpreter::execute(BytecodeFunction& fn, InterpSlot* regs, char* frameMemory,
+                                        uint64_t serial) {
+    const Instr* code = fn.code.data();
+    const Instr* pc = code;
+    ThreadStack& stack = *currentStack;
+
+#ifdef PPX_COMPUTED_GOTO
+    static const void* const dispatchTable[] = {
+#define PPX_OPCODE_LABEL(name) &&L_##name,
+        PPX_OPCODES(PPX_OPCODE_LABEL)
+#undef PPX_OPCODE_LABEL
+    };
+#define CASE(name) L_##name:
+#define DISPATCH() goto *dispatchTable[pc->op]
+#else
+#define CASE(name) case OP_##name:
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() do { ++pc; DISPATCH(); } while (0)
+#define JUMP(target) do { pc = code + (target); DISPATCH(); } while (0)
+#define R(field) regs[pc->field]
+
+    for (;;) {
+        try {
+#ifdef PPX_COMPUTED_GOTO
+            DISPATCH();
+#else
+        dispatch:
+            switch (pc->op) {
+#endif
+            CASE(MOV)    R(dst) = R(a); NEXT();
+            CASE(SEXT1)  R(dst).i = normalizeInt(-(R(a).i & 1), pc->width); NEXT();
+            CASE(ZEXT)   R(dst).i = static_cast<int64_t>(unsignedInt(R(a).i, pc->width)); NEXT();
+            CASE(TRUNC)  R(dst).i = normalizeInt(R(a).i, pc->width); NEXT();
+
+            CASE(ADD)  R(dst).i = normalizeInt(uint64_t(R(a).i) + uint64_t(R(b).i), pc->width); NEXT();
+            CASE(SUB)  R(dst).i = normalizeInt(uint64_t(R(a).i) - uint64_t(R(b).i), pc->width); NEXT();
+            CASE(MUL)  R(dst).i = normalizeInt(uint64_t(R(a).i) * uint64_t(R(b).i), pc->width); NEXT();
+            CASE(SDIV) R(dst).i = normalizeInt(uint64_t(R(a).i / R(b).i), pc->width); NEXT();
+            CASE(SREM) R(dst).i = normalizeInt(uint64_t(R(a).i % R(b).i), pc->width); NEXT();
+            CASE(UDIV) R(dst).i = normalizeInt(unsignedInt(R(a).i, pc->width) / unsignedInt(R(b).i, pc->width), pc->width); NEXT();
+            CASE(UREM) R(dst).i = normalizeInt(unsignedInt(R(a).i, pc->width) % unsignedInt(R(b).i, pc->width), pc->width); NEXT();
+            CASE(AND)  R(dst).i = R(a).i & R(b).i; NEXT();
+            CASE(OR)   R(dst).i = R(a).i | R(b).i; NEXT();
+            CASE(XOR)  R(dst).i = normalizeInt(uint64_t(R(a).i ^ R(b).i), pc->width); NEXT();
+            CASE(SHL)  R(dst).i = normalizeInt(uint64_t(R(a).i) << (R(b).i & 63), pc->width); NEXT();
+            CASE(LSHR) R(dst).i = normalizeInt(unsignedInt(R(a).i, pc->width) >> (R(b).i & 63), pc->width); NEXT();
+            CASE(ASHR) R(dst).i = normalizeInt(uint64_t(R(a).i >> (R(b).i & 63)), pc->width); NEXT();
+            CASE(CTTZ) {
+                uint64_t value = unsignedInt(R(a).i, pc->width);
+                R(dst).i = value ? __builtin_ctzll(value) : pc->width;
+                NEXT();
+            }
+            CASE(ADDI) R(dst).i = R(a).i + pc->imm; NEXT();
+            CASE(MADD) R(dst).i = R(a).i + R(b).i * pc->imm; NEXT();
+
+            CASE(FADD) R(dst).d = R(a).d + R(b).d; if (pc->width == 32) R(dst).d = float(R(dst).d); NEXT();
+            CASE(FSUB) R(dst).d = R(a).d - R(b).d; if (pc->width == 32) R(dst).d = float(R(dst).d); NEXT();
+            CASE(FMUL) R(dst).d = R(a).d * R(b).d; if (pc->width == 32) R(dst).d = float(R(dst).d); NEXT();
+            CASE(FDIV) R(dst).d = R(a).d / R(b).d; if (pc->width == 32) R(dst).d = float(R(dst).d); NEXT();
+            CASE(FREM) R(dst).d = std::fmod(R(a).d, R(b).d); NEXT();
+            CASE(FNEG) R(dst).d = -R(a).d; NEXT();
+
+            CASE(ICMP_EQ)  R(dst).i = R(a).i == R(b).i; NEXT();
+            CASE(ICMP_NE)  R(dst).i = R(a).i != R(b).i; NEXT();
+            CASE(ICMP_SLT) R(dst).i = R(a).i < R(b).i; NEXT();
+            CASE(ICMP_SLE) R(dst).i = R(a).i <= R(b).i; NEXT();
+            CASE(ICMP_SGT) R(dst).i = R(a).i > R(b).i; NEXT();
+            CASE(ICMP_SGE) R(dst).i = R(a).i >= R(b).i; NEXT();
+            CASE(ICMP_ULT) R(dst).i = unsignedInt(R(a).i, pc->width) < unsignedInt(R(b).i, pc->width); NEXT();
+            CASE(ICMP_ULE) R(dst).i = unsignedInt(R(a).i, pc->width) <= unsignedInt(R(b).i, pc->width); NEXT();
+            CASE(ICMP_UGT) R(dst).i = unsignedInt(R(a).i, pc->width) > unsignedInt(R(b).i, pc->width); NEXT();
+            CASE(ICMP_UGE) R(dst).i = unsignedInt(R(a).i, pc->width) >= unsignedInt(R(b).i, pc->width); NEXT();
+            CASE(FCMP) {
+                double x = R(a).d, y = R(b).d;
+                bool unordered = std::isnan(x) || std::isnan(y);
+                bool result;
+                switch (pc->imm) {
+                    case llvm::CmpInst::FCMP_FALSE: result = false; break;
+                    case llvm::CmpInst::FCMP_OEQ:   result = !unordered && x == y; break;
+                    case llvm::CmpInst::FCMP_OGT:   result = !unordered && x > y; break;
+                    case llvm::CmpInst::FCMP_OGE:   result = !unordered && x >= y; break;
+                    case llvm::CmpInst::FCMP_OLT:   result = !unordered && x < y; break;
+                    case llvm::CmpInst::FCMP_OLE:   result = !unordered && x <= y; break;
+                    case llvm::CmpInst::FCMP_ONE:   result = !unordered && x != y; break;
+                    case llvm::CmpInst::FCMP_ORD:   result = !unordered; break;
+                    case llvm::CmpInst::FCMP_UNO:   result = unordered; break;
+                    case llvm::CmpInst::FCMP_UEQ:   result = unordered || x == y; break;
+                    case llvm::CmpInst::FCMP_UGT:   result = unordered || x > y; break;
+                    case llvm::CmpInst::FCMP_UGE:   result = unordered || x >= y; break;
+                    case llvm::CmpInst::FCMP_ULT:   result = unordered || x < y; break;
+                    case llvm::CmpInst::FCMP_ULE:   result = unordered || x <= y; break;
+                    case llvm::CmpInst::FCMP_UNE:   result = unordered || x != y; break;
+                    default:                        result = true; break;
+                }
+                R(dst).i = result;
+                NEXT();
+            }
+
+            CASE(SITOFP)  R(dst).d = pc->width == 32 ? double(float(R(a).i)) : double(R(a).i); NEXT();
+            CASE(UITOFP)  {
+                uint64_t u = unsignedInt(R(a).i, static_cast<unsigned>(pc->imm));
+                R(dst).d = pc->width == 32 ? double(float(u)) : double(u);
+                NEXT();
+            }
+            CASE(FPTOSI)  R(dst).i = normalizeInt(uint64_t(int64_t(R(a).d)), pc->width); NEXT();
+            CASE(FPTOUI)  R(dst).i = normalizeInt(uint64_t(R(a).d), pc->width); NEXT();
+            CASE(FPTRUNC) R(dst).d = float(R(a).d); NEXT();
+
+            CASE(SELECT) R(dst) = (R(a).i & 1) ? R(b) : R(c); NEXT();
+
+            CASE(LOAD_I1)  R(dst).i = *static_cast<uint8_t*>(R(a).p) & 1; NEXT();
+            CASE(LOAD_I8)  R(dst).i = *static_cast<int8_t*>(R(a).p); NEXT();
+            CASE(LOAD_I16) { int16_t v; std::memcpy(&v, R(a).p, 2); R(dst).i = v; NEXT(); }
+            CASE(LOAD_I32) { int32_t v; std::memcpy(&v, R(a).p, 4); R(dst).i = v; NEXT(); }
+            CASE(LOAD_I64) std::memcpy(&R(dst).i, R(a).p, 8); NEXT();
+            CASE(LOAD_F32) { float v; std::memcpy(&v, R(a).p, 4); R(dst).d = v; NEXT(); }
+            CASE(LOAD_F64) std::memcpy(&R(dst).d, R(a).p, 8); NEXT();
+            CASE(STORE_I8)  *static_cast<int8_t*>(R(a).p) = static_cast<int8_t>(R(b).i); NEXT();
+            CASE(STORE_I16) { int16_t v = static_cast<int16_t>(R(b).i); std::memcpy(R(a).p, &v, 2); NEXT(); }
+            CASE(STORE_I32) { int32_t v = static_cast<int32_t>(R(b).i); std::memcpy(R(a).p, &v, 4); NEXT(); }
+            CASE(STORE_I64) std::memcpy(R(a).p, &R(b).i, 8); NEXT();
+            CASE(STORE_F32) { float v = static_cast<float>(R(b).d); std::memcpy(R(a).p, &v, 4); NEXT(); }
+            CASE(STORE_F64) std::memcpy(R(a).p, &R(b).d, 8); NEXT();
+
+            CASE(FRAME_ADDR) R(dst).p = frameMemory + pc->imm; NEXT();
+            CASE(ALLOCA) {
+                uint64_t size = unsignedInt(R(a).i, pc->width) * pc->imm;
+                char* memory = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(stack.memoryTop) + 15) & ~uintptr_t(15));
+                if (memory + size > stack.memoryLimit) {
+                    throw InterpError{"stack overflow in '" + fn.name + "'"};
+                }
+                stack.memoryTop = memory + size;
+                R(dst).p = memory;
+                NEXT();
+            }
+
+            CASE(JMP) JUMP(pc->imm);
+            CASE(BR)  if (R(a).i & 1) JUMP(pc->imm); else JUMP(pc->c);
+            CASE(LOOP)
+                if (fn.heat(tierUpThreshold)) requestTierUp(fn);
+                JUMP(pc->imm);
+            CASE(BR_LOOP)
+                if (fn.heat(tierUpThreshold)) requestTierUp(fn);
+                if (R(a).i & 1) JUMP(pc->imm); else JUMP(pc->c);
+            CASE(SWITCH) {
+                const SwitchTable& table = fn.switches[pc->b];
+                int64_t value = R(a).i;
+                auto it = std::lower_bound(table.cases.begin(), table.cases.end(), value,
+                                           [](const std::pair<int64_t, uint32_t>& entry, int64_t v) {
+                                               return entry.first < v;
+                                           });
+                JUMP(it != table.cases.end() && it->first == value ? it->second : table.defaultTarget);
+            }
+            CASE(RET) {
+                // 向量结果的各元素移到帧的开头，由调用方复制
+                if (pc->width > 1) {
+                    std::memmove(regs, &R(a), pc->width * sizeof(InterpSlot));
+                    return regs[0];
+                }
+                return R(a);
+            }
+            CASE(RET_VOID) { InterpSlot none; none.i = 0; return none; }
+            CASE(UNREACHABLE) throw InterpError{"reached unreachable code in '" + fn.name + "'"};
+
+            CASE(CALL) {
+                InterpSlot result = call(static_cast<unsigned>(pc->imm), regs, fn.callArgs.data() + pc->b, pc->c);
+                if (pc->width > 1) {
+                    std::memcpy(&R(dst), stack.registerTop, pc->width * sizeof(InterpSlot));
+                } else if (pc->dst != NO_REGISTER) {
+                    R(dst) = result;
+                }
+                NEXT();
+            }
+            CASE(CALL_INDIRECT) {
+                auto target = functionIndex.find(static_cast<const llvm::Function*>(R(a).p));
+                if (target == functionIndex.end()) {
+                    throw InterpError{"indirect call to an unknown function in '" + fn.name + "'"};
+                }
+                InterpSlot result = call(target->second, regs, fn.callArgs.data() + pc->b, pc->c);
+                if (pc->dst != NO_REGISTER) R(dst) = result;
+                NEXT();
+            }
+            CASE(CALL_NATIVE) {
+                const uint32_t* args = fn.callArgs.data() + pc->b;
+                InterpSlot values[16];
+                uint32_t argc = std::min<uint32_t>(pc->c, 16);
+                for (uint32_t i = 0; i < argc; i++) {
+                    values[i] = regs[args[i]];
+                }
+                InterpSlot result = callNative(*natives[pc->imm], values, argc);
+                if (pc->dst != NO_REGISTER) R(dst) = result;
+                NEXT();
+            }
+            CASE(SETJMP) {
+                JumpRecord record{JUMP_RECORD_MAGIC, serial, static_cast<uint32_t>(pc - code + 1), pc->dst};
+                std::memcpy(R(a).p, &record, sizeof(record));
+                R(dst).i = 0;
+                NEXT();
+            }
+            CASE(LONGJMP) {
+                JumpRecord record;
+                std::memcpy(&record, R(a).p, sizeof(record));
+                if (record.magic != JUMP_RECORD_MAGIC) {
+                    throw InterpError{"longjmp to an uninitialized jump buffer"};
+                }
+                int64_t value = R(b).i == 0 ? 1 : R(b).i;
+                throw InterpJump{record.serial, record.resumePc, record.dst, value};
+            }
+            CASE(MEMCPY)  std::memcpy(R(a).p, R(b).p, static_cast<size_t>(R(c).i)); NEXT();
+            CASE(MEMMOVE) std::memmove(R(a).p, R(b).p, static_cast<size_t>(R(c).i)); NEXT();
+            CASE(MEMSET)  std::memset(R(a).p, static_cast<int>(R(b).i), static_cast<size_t>(R(c).i)); NEXT();
+
+            CASE(ATOMIC_LOAD)  R(dst).i = atomicLoad(R(a).p, pc->width); NEXT();
+            CASE(ATOMIC_STORE) atomicStore(R(a).p, R(b).i, pc->width); NEXT();
+            CASE(CMPXCHG) {
+                int64_t expected = R(b).i;
+                bool ok = atomicCompareExchange(R(a).p, expected, R(c).i, pc->width);
+                regs[pc->dst].i = expected;
+                regs[pc->dst + 1].i = ok;
+                NEXT();
+            }
+            CASE(SPAWN) {
+                // pthread_create(thread, attr, f, arg)：新线程在自己的解释器栈上执行 f(arg)
+                SpawnRequest* request = new SpawnRequest{this, static_cast<unsigned>(pc->imm), R(c).p};
+                runningThreads.fetch_add(1, std::memory_order_relaxed);
+                int status = pthread_create(static_cast<pthread_t*>(R(a).p), static_cast<const pthread_attr_t*>(R(b).p),
+                                            &BytecodeInterpreter::threadEntry, request);
+                if (status != 0) {
+                    runningThreads.fetch_sub(1, std::memory_order_relaxed);
+                    delete request;
+                }
+                R(dst).i = status;
+                NEXT();
+            }
+#ifndef PPX_COMPUTED_GOTO
+            default:
+                throw InterpError{"invalid bytecode"};
+            }
+#endif
+        } catch (const InterpJump& jump) {
+            // longjmp 目标不在本帧时继续向外回溯
+            if (jump.serial != serial) {
+                throw;
+            }
+            regs[jump.dst].i = normalizeInt(jump.value, 32);
+            pc = code + jump.resumePc;
+        }
+    }
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef R
+}
+
+// 分层执行
+
+void BytecodeInterpreter::enableTierUp(uint64_t threshold, TierUpHandler handler) {
+    tierUpThreshold = threshold;
+    tierUpHandler = std::move(handler);
+}
+
+void BytecodeInterpreter::installNativeEntry(unsigned index, NativeEntry entry) {
+    functions[index]->nativeEntry.store(entry, std::memory_order_release);
+}
+
+void* BytecodeInterpreter::globalAddress(const llvm::GlobalVariable* global) const {
+    auto it = globalAddresses.find(global);
+    return it != globalAddresses.end() ? it->second : nullptr;
+}
+
+// 分层编译后的函数中 spawn 不经过 SPAWN 指令，同样计入仍在运行的线程，
+// 否则 main 返回后会在这些线程仍执行 JIT 代码时释放 JIT 和全局变量
+int BytecodeInterpreter::spawnNative(void* thread, const void* attr, void* (*start)(void*), void* argument) {
+    NativeSpawnRequest* request = new NativeSpawnRequest{this, start, argument};
+    runningThreads.fetch_add(1, std::memory_order_relaxed);
+    int status = pthread_create(static_cast<pthread_t*>(thread), static_cast<const pthread_attr_t*>(attr),
+                                &BytecodeInterpreter::nativeThreadEntry, request);
+    if (status != 0) {
+        runningThreads.fetch_sub(1, std::memory_order_relaxed);
+        delete request;
+    }
+    return status;
+}
+
+void BytecodeInterpreter::requestTierUp(BytecodeFunction& fn) {
+    if (tierUpHandler && fn.tierUpCandidate && !fn.tierUpRequested.exchange(true)) {
+        tierUpHandler(fn.index, fn.name);
+    }
+}
+
+int BytecodeInterpreter::run() {
+    llvm::Function* mainFunction = module->getFunction("main");
+    if (!mainFunction || functionIndex.find(mainFunction) == functionIndex.end()) {
+        runtimeError("no 'main' function to run");
+        return 1;
+    }
+
+    // 全局构造函数按优先级执行
+    std::vector<std::pair<uint64_t, unsigned>> constructors;
+    if (auto* ctors = module->getGlobalVariable("llvm.global_ctors")) {
+        if (auto* list = llvm::dyn_cast<llvm::ConstantArray>(ctors->getInitializer())) {
+            for (auto& entry : list->operands()) {
+                auto* item = llvm::cast<llvm::ConstantStruct>(entry);
+                auto* priority = llvm::cast<llvm::ConstantInt>(item->getOperand(0));
+                auto* fn = llvm::dyn_cast<llvm::Function>(item->getOperand(1));
+                if (fn && functionIndex.count(fn)) {
+                    constructors.push_back({priority->getZExtValue(), functionIndex[fn]});
+                }
+            }
+        }
+    }
+    std::stable_sort(constructors.begin(), constructors.end(),
+                     [](const auto& x, const auto& y) { return x.first < y.first; });
+    for (const auto& ctor : constructors) {
+        functions[ctor.second]->tierUpCandidate = false;
+    }
+    functions[functionIndex[mainFunction]]->tierUpCandidate = false;
+
+    int exitCode = 0;
+    try {
+        for (const auto& ctor : constructors) {
+            invoke(ctor.second);
+        }
+        InterpSlot result = invoke(functionIndex[mainFunction]);
+        if (mainFunction->getReturnType()->isIntegerTy()) {
+            exitCode = static_cast<int>(result.i);
+        }
+    } catch (const InterpError& error) {
+        runtimeError(error.message);
+        exitCode = 1;
+    } catch (const InterpJump&) {
+        runtimeError("longjmp target frame is no longer active");
+        exitCode = 1;
+    }
+    std::fflush(stdout);
+
+    // 与本地程序从 main 返回时一样结束仍在运行的分离线程（它们还在使用解释器的函数表和全局变量）
+    if (runningThreads.load(std::memory_order_acquire) > 0) {
+        std::fflush(nullptr);
+        std::_Exit(exitCode);
+    }
+    return exitCode;
+}
+
+void* BytecodeInterpreter::threadEntry(void* argument) {
+    std::unique_ptr<SpawnRequest> request(static_cast<SpawnRequest*>(argument));
+    BytecodeInterpreter& self = *request->interpreter;
+    BytecodeFunction& fn = *self.functions[request->index];
+    InterpSlot result;
+    result.i = 0;
+    {
+        ThreadStack stack(THREAD_REGISTER_SLOTS, THREAD_MEMORY_BYTES);
+        currentStack = &stack;
+        InterpSlot arg;
+        arg.p = request->argument;
+        try {
+            NativeEntry entry = fn.nativeEntry.load(std::memory_order_acquire);
+            if (entry) {
+                entry(&arg, &result);
+            } else {
+                stack.registerTop[fn.argBase] = arg;
+                if (fn.heat(self.tierUpThreshold)) self.requestTierUp(fn);
+                result = self.invoke(request->index);
+            }
+        } catch (const InterpError& error) {
+            // 其他线程仍在运行，无法回到 run()，直接结束进程
+            runtimeError(error.message);
+            std::fflush(nullptr);
+            std::_Exit(1);
+        } catch (const InterpJump&) {
+            runtimeError("longjmp target frame is no longer active");
+            std::fflush(nullptr);
+            std::_Exit(1);
+        }
+        currentStack = nullptr;
+    }
+    self.runningThreads.fetch_sub(1, std::memory_order_release);
+    return result.p;
+}
+
+void* BytecodeInterpreter::nativeThreadEntry(void* argument) {
+    std::unique_ptr<NativeSpawnRequest> request(static_cast<NativeSpawnRequest*>(argument));
+    void* result = request->start(request->argument);
+    request->interpreter->runningThreads.fetch_sub(1, std::memory_order_release);
+    return result;
+}
@@ -0,0 +1,102 @@
+/**
+ * interp.h
+ * PiPiXia 字节码解释器
+ *
+ * 功能：
+ * - 将 CodeGenerator 生成的 LLVM IR（与 -tac 输出的三地址码一一对应）降级为寄存器式字节码
+ * - 使用 computed goto 分派执行，不经过 LLVM 后端（无目标代码生成和链接）
+ * - 字符串、I/O 等运行时函数直接调用宿主 C 库，setjmp/longjmp 异常由解释器模拟
+ * - 分层执行：统计函数调用和循环回边次数，热点函数交给后台 JIT 编译后原子地切换到本地代码
+ * - spawn 创建的线程各自使用独立的解释器栈，共享函数表和全局变量
+ */
+
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/DataLayout.h>
+
+// 解释器寄存器：整数按位宽符号扩展保存，i1 保存为 0/1
+union InterpSlot {
+    int64_t i;
+    double d;
+    void* p;
+};
+
+// 本地代码入口：参数和返回值通过 InterpSlot 数组传递（由 TieredJIT 生成的包装函数实现）
+typedef void (*NativeEntry)(const InterpSlot* args, InterpSlot* result);
+
+// 热点函数回调：函数下标和函数名
+typedef std::function<void(unsigned, const std::string&)> TierUpHandler;
+
+class BytecodeInterpreter {
+public:
+    struct Instr;                       // 字节码指令
+    struct BytecodeFunction;            // 降级后的函数
+    struct NativeFunction;              // 宿主 C 库函数
+
+    explicit BytecodeInterpreter(llvm::Module* module);
+    ~BytecodeInterpreter();
+
+    bool prepare();                                                 // 分配全局变量并降级所有函数
+    int run();                                                      // 执行全局构造函数和 main，返回退出码
+
+    // 分层执行
+    void enableTierUp(uint64_t threshold, TierUpHandler handler);   // 热度达到阈值时调用 handler（每个函数一次）
+    void installNativeEntry(unsigned index, NativeEntry entry);     // 切换到本地代码（可在其他线程调用）
+    void* globalAddress(const llvm::GlobalVariable* global) const;  // 全局变量在解释器中的地址
+    int spawnNative(void* thread, const void* attr,                 // 本地代码中的 pthread_create（线程计入 runningThreads）
+                    void* (*start)(void*), void* argument);
+
+private:
+    llvm::Module* module;
+    const llvm::DataLayout& dataLayout;
+
+    // 函数和宿主函数表
+    std::vector<std::unique_ptr<BytecodeFunction>> functions;       // 模块中定义的函数
+    std::map<const llvm::Function*, unsigned> functionIndex;        // 函数 -> 下标
+    std::vector<std::unique_ptr<NativeFunction>> natives;           // 外部声明的宿主函数
+    std::map<const llvm::Function*, unsigned> nativeIndex;          // 外部函数 -> 下标
+
+    // 全局变量存储
+    std::map<const llvm::GlobalVariable*, char*> globalAddresses;   // 全局变量 -> 宿主地址
+    std::vector<std::unique_ptr<char[]>> globalStorage;             // 全局变量内存
+
+    // 解释器栈（每个线程一份）
+    struct ThreadStack;                                             // 寄存器栈、内存栈和帧序号
+    std::unique_ptr<ThreadStack> mainStack;                         // 主线程的栈
+    static thread_local ThreadStack* currentStack;                  // 当前线程的栈
+    std::atomic<unsigned> runningThreads;                           // spawn 创建且尚未结束的线程数（含本地代码创建的线程）
+
+    // 分层执行
+    uint64_t tierUpThreshold;                                       // 热度阈值（UINT64_MAX 表示不启用）
+    TierUpHandler tierUpHandler;
+
+    // 降级
+    bool allocateGlobals();                                         // 分配并初始化全局变量
+    bool lowerFunction(BytecodeFunction& fn);                       // 将一个函数降级为字节码
+    int resolveNative(const llvm::Function* callee);                // 解析外部函数，失败返回 -1
+    bool evaluateConstant(const llvm::Constant* c, InterpSlot& out);    // 求值常量操作数
+    bool writeConstant(char* addr, const llvm::Constant* c);        // 将常量写入内存（全局变量初始化）
+
+    // 执行
+    InterpSlot invoke(unsigned index);                              // 调用函数（参数已写入被调用者帧）
+    InterpSlot call(unsigned index, const InterpSlot* regs,         // 从调用者的寄存器复制参数后调用函数
+                    const uint32_t* args, uint32_t argc);
+    void requestTierUp(BytecodeFunction& fn);                       // 通知热点函数
+    InterpSlot execute(BytecodeFunction& fn, InterpSlot* regs, char* frameMemory, uint64_t serial);
+    InterpSlot callNative(const NativeFunction& native, const InterpSlot* args, unsigned argc);
+    static void* threadEntry(void* request);                        // pthread_create 创建的线程在解释器中的入口
+    static void* nativeThreadEntry(void* request);                  // 本地代码创建的线程的入口（结束时更新计数）
+};
+
+#endif // INTERP_H
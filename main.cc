@@ -21,24 +21,23 @@
 #include <map>
 #include <vector>
 #include <algorithm>
+#include <chrono>
 #include "node.h"
 #include "codegen.h"
+#include "interp.h"
+#include "tierjit.h"
+#include "repl.h"
 #include "error.h"
 #include "syntax.hh"
 
-// 全局日志控制变量，控制是否输出详细的编译过程信息
-bool g_verbose = false;
-
 // 来自 Flex/Bison 的外部声明
 extern FILE* yyin;                                  // Flex 输入文件指针
-extern int yyparse();                               // Bison 语法分析函数
 extern int yylex();                                 // Flex 词法分析函数
-extern std::shared_ptr<ProgramNode> root;           // AST 根节点
 extern int yylineno;                                // 当前行号
 extern union YYSTYPE yylval;                        // Token 值
 
 // 来自 error.h 的源文件加载函数和错误计数器
-// loadSourceFile 和 g_syntaxErrorCount 已在 error.h 中声明
+// loadSourceFile 和诊断状态 currentDiagnostics() 已在 error.h 中声明
 
 // 文件名处理辅助函数：更改文件扩展名
 std::string changeExtension(const std::string& filename, const std::string& newExt) {
@@ -55,6 +54,10 @@ const char* getTokenName(int token) {
         case INT_LITERAL: return "INT_LITERAL";
         case DOUBLE_LITERAL: return "DOUBLE_LITERAL";
         case STRING_LITERAL: return "STRING_LITERAL";
+        case INTERP_HEAD: return "INTERP_HEAD";
+        case INTERP_MID: return "INTERP_MID";
+        case INTERP_TAIL: return "INTERP_TAIL";
+        case INTERP_FORMAT: return "INTERP_FORMAT";
         case CHAR_LITERAL: return "CHAR_LITERAL";
         case BOOL_LITERAL: return "BOOL_LITERAL";
         case IDENTIFIER: return "IDENTIFIER";
@@ -183,6 +186,10 @@ bool tokenizeFile(const std::string& inputFile, const std::string& outputFile =
                 line << yylval.doubleVal;
                 break;
             case STRING_LITERAL:
+            case INTERP_HEAD:
+            case INTERP_MID:
+            case INTERP_TAIL:
+            case INTERP_FORMAT:
             case IDENTIFIER:
             case TYPE:
                 if (yylval.strVal) {
@@ -229,6 +236,116 @@ bool tokenizeFile(const std::string& inputFile, const std::string& outputFile =
     return true;
 }
 
+// 解析 -fxxx=N 形式的正整数选项（线程数、阈值等），成功返回 true
+bool parseCountOption(const std::string& arg, const std::string& prefix, unsigned& count) {
+    std::string value = arg.substr(prefix.length());
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos ||
+        value.length() > 9 || std::stoi(value) < 1) {
+        std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": "
+                  << prefix.substr(0, prefix.length() - 1) << " 需要一个正整数" << std::endl;
+        return false;
+    }
+    count = static_cast<unsigned>(std::stoi(value));
+    return true;
+}
+
+// 浮点选项：-ffast-math、-ffp-contract=fast|off、-fno-math-errno
+struct FloatOptions {
+    bool fastMath = false;      // 允许全部浮点优化
+    int fpContract = -1;        // 1 为 fast，0 为 off，-1 为未指定（跟随 -ffast-math）
+    bool noMathErrno = false;   // 数学函数不设置 errno
+};
+
+// 先应用 -ffast-math，再由 -ffp-contract 和 -fno-math-errno 覆盖（与选项在命令行中的顺序无关）
+void applyFloatOptions(CodeGenerator& codegen, const FloatOptions& options) {
+    codegen.setFastMath(options.fastMath);
+    if (options.fpContract >= 0) {
+        codegen.setFPContractFast(options.fpContract == 1);
+    }
+    if (options.noMathErrno) {
+        codegen.setMathErrno(false);
+    }
+}
+
+// 解释执行模式：解析源文件、生成 LLVM IR 后直接由字节码解释器执行，不输出编译信息
+// tierThreshold 大于 0 时启用分层执行：热度达到阈值的函数在后台 JIT 编译为本地代码
+// 返回程序的退出码
+int interpretFile(const std::string& inputFile, unsigned irThreads, unsigned tierThreshold, unsigned stackArrayLimit,
+                  const FloatOptions& floatOptions) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    FILE* file = fopen(inputFile.c_str(), "r");
+    if (!file) {
+        std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": 无法打开文件 '" << inputFile << "'" << std::endl;
+        return 1;
+    }
+    loadSourceFile(inputFile);
+
+    std::shared_ptr<ProgramNode> program = parseProgram(file);
+    fclose(file);
+    if (!program) {
+        std::cerr << "\nCompilation failed with " << currentDiagnostics().syntaxErrorCount << " syntax error(s)." << std::endl;
+        return 1;
+    }
+
+    setSourceFilePath(inputFile);
+    CodeGenerator codegen(inputFile);
+    codegen.setIRThreads(irThreads);
+    codegen.setStackArrayLimit(stackArrayLimit);
+    applyFloatOptions(codegen, floatOptions);
+    size_t lastSlash = inputFile.find_last_of('/');
+    if (lastSlash != std::string::npos) {
+        codegen.setSourceDirectory(inputFile.substr(0, lastSlash));
+    }
+    if (!codegen.generate(program.get())) {
+        std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": LLVM IR generation failed" << std::endl;
+        return 1;
+    }
+
+    // 分层执行时解释器与本地代码共享内存，需使用本机数据布局
+    if (tierThreshold > 0 && !TieredJIT::prepareModule(codegen.getModule())) {
+        tierThreshold = 0;
+    }
+
+    BytecodeInterpreter interpreter(codegen.getModule());
+    if (!interpreter.prepare()) {
+        return 1;
+    }
+
+    std::unique_ptr<TieredJIT> tieredJIT;
+    if (tierThreshold > 0) {
+        tieredJIT.reset(new TieredJIT(codegen.getModule(), interpreter));
+        TieredJIT* jit = tieredJIT.get();
+        interpreter.enableTierUp(tierThreshold, [jit](unsigned index, const std::string& name) {
+            jit->request(index, name);
+        });
+        tieredJIT->start();
+    }
+
+    auto readyTime = std::chrono::steady_clock::now();
+    if (g_verbose) {
+        std::cout << "[Interp] Startup: "
+                  << std::chrono::duration<double, std::milli>(readyTime - startTime).count()
+                  << " ms" << std::endl;
+    }
+
+    int exitCode = interpreter.run();
+    if (tieredJIT) {
+        tieredJIT->stop();
+        if (g_verbose) {
+            std::cout << "[Tier] " << tieredJIT->getCompiledCount() << " function(s) tiered up to native code" << std::endl;
+        }
+    }
+
+    if (g_verbose) {
+        auto endTime = std::chrono::steady_clock::now();
+        std::cout << "[Interp] Execution: "
+                  << std::chrono::duration<double, std::milli>(endTime - readyTime).count()
+                  << " ms, exit code " << exitCode << std::endl;
+    }
+    return exitCode;
+}
+
 // 打印编译器使用帮助信息
 void printUsage(const char* programName) {
     std::cout << "PiPiXia Language Compiler" << std::endl;
@@ -247,12 +364,28 @@ void printUsage(const char* programName) {
     std::cout << "                 可使用 -llvm -o <目录/文件.ll> 指定输出路径" << std::endl;
     std::cout << "  -c             输出目标文件（.o），不生成可执行文件" << std::endl;
     std::cout << "                 可使用 -c -o <目录/文件.o> 指定输出路径" << std::endl;
+    std::cout << "  -interp        使用字节码解释器直接运行程序，不生成目标代码" << std::endl;
+    std::cout << "  -tiered        分层执行：先解释执行，热点函数在后台以 -O2 JIT 编译" << std::endl;
+    std::cout << "  -ftier-threshold=N" << std::endl;
+    std::cout << "                 函数调用与循环回边累计达到 N 次后 JIT 编译（默认 10000）" << std::endl;
+    std::cout << "  --repl         交互式解释器：逐行输入，每段输入增量 JIT 编译后立即执行" << std::endl;
     std::cout << "  -v, --verbose  启用详细日志 (AST 解析和 IR 生成)" << std::endl;
+    std::cout << "  -fir-threads=N 使用 N 个线程并行生成函数体 IR（默认 1）" << std::endl;
+    std::cout << "  -fcodegen-threads=N" << std::endl;
+    std::cout << "                 将模块拆分为 N 份并行生成目标代码（默认 1，用于 -c 和可执行文件）" << std::endl;
+    std::cout << "  -fstack-array-limit=N" << std::endl;
+    std::cout << "                 超过 N 字节的局部数组在堆上分配，函数退出时释放（默认 65536）" << std::endl;
+    std::cout << "  -ffast-math    允许重结合、FMA 收缩等全部浮点优化（结果可能在最后几位不同），隐含 -fno-math-errno" << std::endl;
+    std::cout << "  -ffp-contract=fast|off" << std::endl;
+    std::cout << "                 是否允许把浮点乘法和加法收缩为 FMA 指令（默认 off）" << std::endl;
+    std::cout << "  -fno-math-errno" << std::endl;
+    std::cout << "                 数学函数（pow）不设置 errno，使用 LLVM 内置函数以便优化和向量化" << std::endl;
     std::cout << "  -Wall          启用所有警告" << std::endl;
     std::cout << "  -Werror        将警告视为错误" << std::endl;
     std::cout << "  -w             禁用所有警告" << std::endl;
     std::cout << "  -Wno-unused    禁用未使用变量警告" << std::endl;
     std::cout << "  -Wshadow       启用变量遮蔽警告" << std::endl;
+    std::cout << "  -Rpass         报告循环提示（@unroll、@vectorize、@nocheck）是否生效" << std::endl;
     std::cout << "  -h, --help     显示此帮助信息" << std::endl;
     std::cout << "\n示例:" << std::endl;
     std::cout << "  " << programName << " code/main.ppx                     # 编译到可执行文件 main" << std::endl;
@@ -269,6 +402,9 @@ void printUsage(const char* programName) {
     std::cout << "  " << programName << " code/main.ppx -llvm -o my.ll      # 生成 my.ll 文件" << std::endl;
     std::cout << "  " << programName << " code/main.ppx -c                  # 生成目标文件" << std::endl;
     std::cout << "  " << programName << " code/main.ppx -c -o myobj.o       # 生成 myobj.o 文件" << std::endl;
+    std::cout << "  " << programName << " code/main.ppx -interp             # 解释执行程序" << std::endl;
+    std::cout << "  " << programName << " code/main.ppx -tiered -v          # 分层执行并显示 JIT 编译事件" << std::endl;
+    std::cout << "  " << programName << " --repl                            # 启动交互式解释器" << std::endl;
 }
 
 // 主函数
@@ -290,6 +426,14 @@ int main(int argc, char** argv) {
     bool emitLLVM = false;              // 是否输出LLVM IR到文件
     bool compileToObj = false;          // 是否生成目标文件(.o)
     bool compileToExe = false;          // 是否生成可执行文件
+    bool interpret = false;             // 是否解释执行
+    bool tiered = false;                // 是否分层执行
+    bool repl = false;                  // 是否启动交互式解释器
+    unsigned tierThreshold = 10000;     // 分层编译热度阈值
+    unsigned irThreads = 1;             // 函数体 IR 生成线程数
+    unsigned codegenThreads = 1;        // 目标代码生成线程数
+    unsigned stackArrayLimit = CodeGenConstants::STACK_ARRAY_LIMIT;    // 局部数组放在栈上的最大字节数
+    FloatOptions floatOptions;          // 浮点优化选项
 
     // 解析命令行参数
     for (int i = 1; i < argc; i++) {
@@ -311,14 +455,47 @@ int main(int argc, char** argv) {
             emitLLVM = false; 
         } else if (arg == "-c") {
             compileToObj = true;
+        } else if (arg == "-interp") {
+            interpret = true;
+        } else if (arg == "-tiered") {
+            tiered = true;
+        } else if (arg == "--repl") {
+            repl = true;
+        } else if (arg.rfind("-ftier-threshold=", 0) == 0) {
+            if (!parseCountOption(arg, "-ftier-threshold=", tierThreshold)) {
+                return 1;
+            }
         } else if (arg == "-v" || arg == "--verbose") {
             g_verbose = true;
+        } else if (arg.rfind("-fir-threads=", 0) == 0) {
+            if (!parseCountOption(arg, "-fir-threads=", irThreads)) {
+                return 1;
+            }
+        } else if (arg.rfind("-fcodegen-threads=", 0) == 0) {
+            if (!parseCountOption(arg, "-fcodegen-threads=", codegenThreads)) {
+                return 1;
+            }
+        } else if (arg.rfind("-fstack-array-limit=", 0) == 0) {
+            if (!parseCountOption(arg, "-fstack-array-limit=", stackArrayLimit)) {
+                return 1;
+            }
+        } else if (arg == "-ffast-math") {
+            floatOptions.fastMath = true;
+        } else if (arg == "-ffp-contract=fast" || arg == "-ffp-contract=off") {
+            floatOptions.fpContract = (arg == "-ffp-contract=fast") ? 1 : 0;
+        } else if (arg.rfind("-ffp-contract=", 0) == 0) {
+            std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": -ffp-contract 只支持 fast 或 off" << std::endl;
+            return 1;
+        } else if (arg == "-fno-math-errno") {
+            floatOptions.noMathErrno = true;
         } else if (arg == "-Wall") {
             enableAllWarnings();
         } else if (arg == "-Werror") {
             setWarningsAsErrors(true);
         } else if (arg == "-w") {
             suppressAllWarnings();
+        } else if (arg == "-Rpass") {
+            enableOptRemarks();
         } else if (arg.substr(0, 2) == "-W" && arg.length() > 2) {
             // 解析 -Wxx 选项
             setWarningOption(arg.substr(2));
@@ -338,12 +515,23 @@ int main(int argc, char** argv) {
         }
     }
 
+    // 交互式模式：从标准输入读取，不需要输入文件
+    if (repl) {
+        ReplSession session;
+        return session.run(stdin);
+    }
+
     if (inputFile.empty()) {
         std::cerr << ErrorColors::RED << "Error" << ErrorColors::RESET << ": 未指定输入文件" << std::endl;
         printUsage(argv[0]);
         return 1;
     }
 
+    // 解释执行模式：不经过其他输出模式和目标代码生成
+    if (interpret || tiered) {
+        return interpretFile(inputFile, irThreads, tiered ? tierThreshold : 0, stackArrayLimit, floatOptions);
+    }
+
     // 编译模式设置
     
     // Token分析模式：只进行词法分析，不进行后续的语法分析和代码生成
@@ -480,11 +668,11 @@ int main(int argc, char** argv) {
     }
     
     // 调用Bison生成的解析器进行语法分析
-    int parseResult = yyparse();
+    std::shared_ptr<ProgramNode> program = parseProgram(file);
     fclose(file);
 
-    if (parseResult != 0 || g_syntaxErrorCount > 0) {
-        std::cerr << "\nCompilation failed with " << g_syntaxErrorCount << " syntax error(s)." << std::endl;
+    if (!program) {
+        std::cerr << "\nCompilation failed with " << currentDiagnostics().syntaxErrorCount << " syntax error(s)." << std::endl;
         return 1;
     }
 
@@ -496,11 +684,11 @@ int main(int argc, char** argv) {
     // AST输出（可选）
     
     // 如果用户指定了-ast选项，打印AST到控制台
-    if (printAST && root) {
+    if (printAST && program) {
         std::cout << "\n=== Abstract Syntax Tree ===" << std::endl;
         std::cout << "Source: " << inputFile << std::endl;
         std::cout << std::endl;
-        root->print(0);
+        program->print(0);
         std::cout << std::endl;
     }
 
@@ -524,11 +712,11 @@ int main(int argc, char** argv) {
             std::streambuf* coutBuf = std::cout.rdbuf();
             std::cout.rdbuf(outFile.rdbuf());
             
-            if (root) {
+            if (program) {
                 std::cout << "=== PiPiXia AST Output ===" << std::endl;
                 std::cout << "Source: " << inputFile << std::endl;
                 std::cout << std::endl;
-                root->print(0);
+                program->print(0);
             }
             
             std::cout.rdbuf(coutBuf);
@@ -542,8 +730,8 @@ int main(int argc, char** argv) {
     
     // 检查程序中是否定义了main函数
     bool hasMain = false;
-    if (root) {
-        for (const auto& stmt : root->statements) {
+    if (program) {
+        for (const auto& stmt : program->statements) {
             if (auto funcDecl = std::dynamic_pointer_cast<FunctionDeclNode>(stmt)) {
                 if (funcDecl->name == "main") {
                     hasMain = true;
@@ -564,13 +752,17 @@ int main(int argc, char** argv) {
     }
 
     // LLVM IR 代码生成
-    if (generateLLVM && root) {
+    if (generateLLVM && program) {
         std::cout << "\n=== LLVM Code Generation ===" << std::endl;
         
         // 设置源文件路径（用于语义错误报告显示源代码上下文）
         setSourceFilePath(inputFile);
         
         CodeGenerator codegen(inputFile);
+        codegen.setIRThreads(irThreads);
+        codegen.setCodegenThreads(codegenThreads);
+        codegen.setStackArrayLimit(stackArrayLimit);
+        applyFloatOptions(codegen, floatOptions);
         
         // 设置源文件目录（用于import查找模块）
         size_t lastSlash = inputFile.find_last_of('/');
@@ -580,7 +772,7 @@ int main(int argc, char** argv) {
         }
         
         // 生成LLVM IR代码
-        if (codegen.generate(root.get())) {
+        if (codegen.generate(program.get())) {
             std::cout << "LLVM IR generation successful!" << std::endl;
             
             // 可执行文件生成
@@ -737,8 +929,8 @@ int main(int argc, char** argv) {
         std::cout << "Output: " << astFile << " (AST)" << std::endl;
     }
     
-    if (root) {
-        std::cout << "Statements parsed: " << root->statements.size() << std::endl;
+    if (program) {
+        std::cout << "Statements parsed: " << program->statements.size() << std::endl;
     }
     
     // 返回编译结果
@@ -2,6 +2,7 @@
 #define NODE_H
 
 // 标准库头文件
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <memory>
@@ -176,6 +177,28 @@ public:
     }
 };
 
+// 映射字面量 - [key: value, ...]，空映射为 [:]
+class MapLiteralNode : public ExprNode {
+public:
+    std::vector<std::shared_ptr<ExprNode>> keys;
+    std::vector<std::shared_ptr<ExprNode>> values;
+    
+    MapLiteralNode() {}
+    
+    void addEntry(std::shared_ptr<ExprNode> key, std::shared_ptr<ExprNode> value) {
+        keys.push_back(key);
+        values.push_back(value);
+    }
+    
+    void print(int indent = 0) const override {
+        std::cout << std::string(indent, ' ') << "MapLiteral: [" << keys.size() << " entries]" << std::endl;
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (keys[i]) keys[i]->print(indent + 2);
+            if (values[i]) values[i]->print(indent + 4);
+        }
+    }
+};
+
 // 标识符和访问表达式
 
 // 标识符 - 变量名、函数名等
@@ -253,6 +276,57 @@ public:
     }
 };
 
+// 启动线程 - spawn f(args)，值为 future<T>（T 为 f 的返回类型）
+class SpawnNode : public ExprNode {
+public:
+    std::shared_ptr<FunctionCallNode> call;
+    
+    SpawnNode(std::shared_ptr<FunctionCallNode> c) : call(c) {}
+    
+    void print(int indent = 0) const override {
+        std::cout << std::string(indent, ' ') << "Spawn:" << std::endl;
+        if (call) call->print(indent + 2);
+    }
+};
+
+// 创建通道 - chan<T>(capacity)，省略容量时使用默认容量
+class ChannelNode : public ExprNode {
+public:
+    std::string elementType;
+    std::shared_ptr<ExprNode> capacity;
+    
+    ChannelNode(const std::string& type, std::shared_ptr<ExprNode> cap)
+        : elementType(type), capacity(cap) {}
+    
+    void print(int indent = 0) const override {
+        std::cout << std::string(indent, ' ') << "Channel: chan<" << elementType << ">" << std::endl;
+        if (capacity) capacity->print(indent + 2);
+    }
+};
+
+// 创建 SIMD 向量 - vec<T,N>(...)：无参数为全 0，一个参数广播到所有元素，
+// (a, i) 从数组 a 的下标 i 处读取 N 个元素，N 个参数依次作为各元素
+class VecNode : public ExprNode {
+public:
+    std::string elementType;
+    int lanes;
+    std::vector<std::shared_ptr<ExprNode>> arguments;
+    
+    VecNode(const std::string& type, int n)
+        : elementType(type), lanes(n) {}
+    
+    std::string typeName() const {
+        return "vec<" + elementType + "," + std::to_string(lanes) + ">";
+    }
+    
+    void print(int indent = 0) const override {
+        std::cout << std::string(indent, ' ') << "Vec: " << typeName() << std::endl;
+        for (const auto& arg : arguments) {
+            arg->print(indent + 2);
+        }
+    }
+};
+
 // 数组访问
 class ArrayAccessNode : public ExprNode {
 public:
@@ -269,6 +343,26 @@ public:
     }
 };
 
+// 切片 - a[from..to]，省略的边界为开头或结尾
+class SliceNode : public ExprNode {
+public:
+    std::shared_ptr<ExprNode> object;
+    std::shared_ptr<ExprNode> from;     // 可以为空
+    std::shared_ptr<ExprNode> to;       // 可以为空
+    
+    SliceNode(std::shared_ptr<ExprNode> obj, std::shared_ptr<ExprNode> f, std::shared_ptr<ExprNode> t)
+        : object(obj), from(f), to(t) {}
+    
+    void print(int indent = 0) const override {
+        std::cout << std::string(indent, ' ') << "Slice:" << std::endl;
+        if (object) object->print(indent + 2);
+        std::cout << std::string(indent + 2, ' ') << "From:" << (from ? "" : " (start)") << std::endl;
+        if (from) from->print(indent + 4);
+        std::cout << std::string(indent + 2, ' ') << "To:" << (to ? "" : " (end)") << std::endl;
+        if (to) to->print(indent + 4);
+    }
+};
+
 // 成员访问 - object.member 语法
 class MemberAccessNode : public ExprNode {
 public:
@@ -295,6 +389,26 @@ public:
     virtual ~StmtNode() = default;
 };
 
+// 注解 - @name 或 @name(N)，写在循环或函数之前，作为优化提示
+struct Annotation {
+    std::string name;       // 不含 @ 的名称
+    int argument = 0;       // 括号中的整数参数
+    bool hasArgument = false;
+    int lineNumber = 0;
+
+    std::string text() const {
+        return "@" + name + (hasArgument ? "(" + std::to_string(argument) + ")" : "");
+    }
+};
+
+// 输出注解列表（AST 打印使用）
+inline void printAnnotations(const std::vector<Annotation>& annotations, int indent) {
+    if (annotations.empty()) return;
+    std::cout << std::string(indent, ' ') << "Annotations:";
+    for (const auto& annotation : annotations) std::cout << " " << annotation.text();
+    std::cout << std::endl;
+}
+
 // 声明语句
 
 // 变量声明 - let/const 语句
@@ -385,12 +499,14 @@ class WhileStmtNode : public StmtNode {
 public:
     std::shared_ptr<ExprNode> condition;
     std::shared_ptr<StmtNode> body;
+    std::vector<Annotation> annotations;  // 循环之前的注解（@unroll、@vectorize、@nocheck）
     
     WhileStmtNode(std::shared_ptr<ExprNode> cond, std::shared_ptr<StmtNode> bodyStmt)
         : condition(cond), body(bodyStmt) {}
     
     void print(int indent = 0) const override {
         std::cout << std::string(indent, ' ') << "WhileStmt:" << std::endl;
+        printAnnotations(annotations, indent + 2);
         if (condition) condition->print(indent + 2);
         if (body) body->print(indent + 2);
     }
@@ -402,16 +518,24 @@ public:
     std::string variable;
     std::shared_ptr<ExprNode> start;
     std::shared_ptr<ExprNode> end;
+    std::shared_ptr<ExprNode> iterable;  // for x in 容器（此时 start/end 为空）
     std::shared_ptr<StmtNode> body;
+    std::vector<Annotation> annotations;  // 循环之前的注解（@unroll、@vectorize、@nocheck）
     
     ForStmtNode(const std::string& var, std::shared_ptr<ExprNode> startExpr,
                 std::shared_ptr<ExprNode> endExpr, std::shared_ptr<StmtNode> bodyStmt)
         : variable(var), start(startExpr), end(endExpr), body(bodyStmt) {}
     
+    ForStmtNode(const std::string& var, std::shared_ptr<ExprNode> iterableExpr,
+                std::shared_ptr<StmtNode> bodyStmt)
+        : variable(var), iterable(iterableExpr), body(bodyStmt) {}
+    
     void print(int indent = 0) const override {
         std::cout << std::string(indent, ' ') << "ForStmt: " << variable << std::endl;
+        printAnnotations(annotations, indent + 2);
         if (start) start->print(indent + 2);
         if (end) end->print(indent + 2);
+        if (iterable) iterable->print(indent + 2);
         if (body) body->print(indent + 2);
     }
 };
@@ -477,6 +601,19 @@ public:
     }
 };
 
+// Yield 语句 - 生成器函数向 for 循环产出一个值后挂起
+class YieldStmtNode : public StmtNode {
+public:
+    std::shared_ptr<ExprNode> value;
+
+    YieldStmtNode(std::shared_ptr<ExprNode> val) : value(val) {}
+
+    void print(int indent = 0) const override {
+        std::cout << std::string(indent, ' ') << "YieldStmt:" << std::endl;
+        if (value) value->print(indent + 2);
+    }
+};
+
 // Break 语句 - 退出循环
 class BreakStmtNode : public StmtNode {
 public:
@@ -572,6 +709,7 @@ public:
     std::vector<std::shared_ptr<ParameterNode>> parameters;
     std::shared_ptr<TypeNode> returnType;
     std::shared_ptr<BlockNode> body;
+    std::vector<Annotation> annotations;  // 函数之前的注解（@fastmath）
     
     FunctionDeclNode(const std::string& funcName) : name(funcName) {}
     
@@ -581,6 +719,7 @@ public:
     
     void print(int indent = 0) const override {
         std::cout << std::string(indent, ' ') << "FunctionDecl: " << name << std::endl;
+        printAnnotations(annotations, indent + 2);
         for (const auto& param : parameters) {
             if (param) param->print(indent + 2);
         }
@@ -629,4 +768,8 @@ public:
     }
 };
 
+// 语法分析入口（syntax.y）：从 input 读取完整程序，有语法错误时返回 nullptr
+// Flex/Bison 生成的扫描器和分析器使用全局状态，多个线程同时调用时依次进行
+std::shared_ptr<ProgramNode> parseProgram(FILE* input);
+
 #endif // NODE_H
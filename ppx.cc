@@ -0,0 +1,293 @@
+/**
+ * ppx.cc
+ * PiPiXia 嵌入式 C++ API 实现
+ *
+ * 每次 Session::compile 的处理流程：
+ * 1. 切换到会话自己的诊断状态（DiagnosticScope），从内存缓冲区进行语法分析
+ * 2. CodeGenerator::generateIncrement 在新的 LLVMContext 中生成增量模块：
+ *    函数和全局变量为定义，顶层语句按顺序放入入口函数 __ppx_init_N
+ * 3. 增量模块加入会话的 LLJIT（不做额外优化，降低延迟），查找并调用入口函数
+ * 4. 新定义以外部声明登记到会话模块，之后的源代码通过 JIT 符号查找引用
+ */
+
+#include "ppx.h"
+#include "codegen.h"
+#include "node.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+
+namespace ppx {
+
+// exit 跳转目标
+
+static thread_local detail::ExitTrap* t_exitTrap = nullptr;
+
+detail::ExitTrap::ExitTrap() : exitCode(0), previous(t_exitTrap) {
+    t_exitTrap = this;
+}
+
+detail::ExitTrap::~ExitTrap() {
+    t_exitTrap = previous;
+}
+
+// JIT 代码中的 exit：刷新输出后跳回当前线程最近的调用点，不结束宿主进程
+static void sessionExit(int code) {
+    std::fflush(nullptr);
+    detail::ExitTrap* trap = t_exitTrap;
+    if (!trap) {
+        std::exit(code);
+    }
+    trap->exitCode = code;
+    std::longjmp(trap->target, 1);
+}
+
+// 调用入口函数，执行中调用 exit 时返回 false
+static bool runEntry(void (*entry)(), int& exitCode) {
+    detail::ExitTrap trap;
+    if (setjmp(trap.target) != 0) {
+        exitCode = trap.exitCode;
+        return false;
+    }
+    entry();
+    return true;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point from,
+                        std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+RuntimeError::RuntimeError(int exitCode)
+    : std::runtime_error("PiPiXia 程序在执行中退出（exit code " + std::to_string(exitCode) + "）"), code(exitCode) {}
+
+// 会话
+
+struct Session::Impl {
+    Options options;
+    DiagnosticState diagnostics;                                    // 会话自己的诊断状态
+    std::unique_ptr<CodeGenerator> declarations;                    // 会话模块：只保存已有定义的外部声明
+    std::vector<std::shared_ptr<ProgramNode>> programs;             // 已编译源代码的 AST（函数原型引用其中的节点）
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    unsigned inputCount = 0;                                        // 已编译的源代码段数（入口函数编号）
+    Timings timings;
+
+    bool initialize();                                              // 创建 LLJIT 并设置符号解析
+};
+
+bool Session::Impl::initialize() {
+    auto targetBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!targetBuilder) {
+        reportError("无法检测本机目标: " + llvm::toString(targetBuilder.takeError()), 0);
+        return false;
+    }
+
+    auto created = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(*targetBuilder)).create();
+    if (!created) {
+        reportError("无法创建 JIT: " + llvm::toString(created.takeError()), 0);
+        return false;
+    }
+    jit = std::move(*created);
+
+    // 外部 C 库函数从当前进程解析，exit 由会话接管
+    auto processSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit->getDataLayout().getGlobalPrefix());
+    if (!processSymbols) {
+        reportError(llvm::toString(processSymbols.takeError()), 0);
+        jit.reset();
+        return false;
+    }
+    llvm::orc::JITDylib& dylib = jit->getMainJITDylib();
+    dylib.addGenerator(std::move(*processSymbols));
+
+    llvm::orc::SymbolMap sessionSymbols;
+    sessionSymbols[jit->mangleAndIntern("exit")] =
+        llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(&sessionExit), llvm::JITSymbolFlags::Exported);
+    if (auto error = dylib.define(llvm::orc::absoluteSymbols(std::move(sessionSymbols)))) {
+        reportError(llvm::toString(std::move(error)), 0);
+        jit.reset();
+        return false;
+    }
+
+    // 增量模块复制会话模块的数据布局
+    declarations->getModule()->setDataLayout(jit->getDataLayout());
+    return true;
+}
+
+Session::Session(const Options& options) : impl(new Impl) {
+    impl->options = options;
+    impl->diagnostics.printDiagnostics = options.printDiagnostics;
+
+    DiagnosticScope scope(impl->diagnostics, options.verbose);
+    if (options.enableAllWarnings) {
+        enableAllWarnings();
+    }
+    if (options.suppressWarnings) {
+        suppressAllWarnings();
+    }
+    setWarningsAsErrors(options.warningsAsErrors);
+
+    impl->declarations.reset(new CodeGenerator("ppx_session"));
+    if (!options.sourceDirectory.empty()) {
+        impl->declarations->setSourceDirectory(options.sourceDirectory);
+    }
+    impl->initialize();
+}
+
+Session::~Session() {
+    // JIT 中的代码引用会话模块之外的内存，先于其他成员释放
+    impl->jit.reset();
+}
+
+bool Session::compile(const std::string& source, const std::string& name) {
+    DiagnosticScope scope(impl->diagnostics, impl->options.verbose);
+    impl->timings = Timings();
+    if (!impl->jit) {
+        reportError("会话初始化失败，无法编译", 0);
+        return false;
+    }
+    if (source.find_first_not_of(" \t\r\n") == std::string::npos) {
+        return true;
+    }
+    auto startTime = std::chrono::steady_clock::now();
+
+    // 1. 语法分析（词法分析器从内存缓冲区读取）
+    loadSourceText(name, source);
+    resetErrorCounts();
+    FILE* buffer = fmemopen(const_cast<char*>(source.data()), source.size(), "r");
+    if (!buffer) {
+        reportError("无法读取源代码", 0);
+        return false;
+    }
+    std::shared_ptr<ProgramNode> program = parseProgram(buffer);
+    fclose(buffer);
+    if (!program) {
+        return false;
+    }
+    auto parsedTime = std::chrono::steady_clock::now();
+
+    // 2. 生成增量模块
+    std::string entryName = "__ppx_init_" + std::to_string(++impl->inputCount);
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::unique_ptr<llvm::Module> module;
+    if (!impl->declarations->generateIncrement(program.get(), entryName, context, module)) {
+        return false;
+    }
+    impl->programs.push_back(program);
+    auto generatedTime = std::chrono::steady_clock::now();
+
+    // 3. JIT 编译
+    if (auto error = impl->jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context)))) {
+        reportError(llvm::toString(std::move(error)), 0);
+        return false;
+    }
+    auto symbol = impl->jit->lookup(entryName);
+    if (!symbol) {
+        reportError(llvm::toString(symbol.takeError()), 0);
+        return false;
+    }
+    auto entry = symbol->toPtr<void (*)()>();
+    auto compiledTime = std::chrono::steady_clock::now();
+
+    // 4. 执行顶层语句
+    int exitCode = 0;
+    bool completed = runEntry(entry, exitCode);
+    std::fflush(nullptr);
+    auto endTime = std::chrono::steady_clock::now();
+
+    impl->timings.parse = elapsedMs(startTime, parsedTime);
+    impl->timings.ir = elapsedMs(parsedTime, generatedTime);
+    impl->timings.jit = elapsedMs(generatedTime, compiledTime);
+    impl->timings.run = elapsedMs(compiledTime, endTime);
+
+    if (!completed) {
+        reportError("程序在执行中退出（exit code " + std::to_string(exitCode) + "），已有定义保持有效", 0);
+        return false;
+    }
+    return true;
+}
+
+// PPX 函数签名的类型名：返回类型在前。定长数组参数与 C++ 的 T* 比较时不区分维度，记为 "T[N]"；
+// withDimensions 为真时写出各维长度（用于诊断信息）
+static std::vector<std::string> prototypeSignature(FunctionDeclNode* node, bool withDimensions = false) {
+    std::vector<std::string> signature;
+    signature.push_back(node->returnType ? node->returnType->typeName : "void");
+    for (const auto& param : node->parameters) {
+        std::string name = param->type->typeName;
+        if (!param->type->arrayDimensions.empty() && !withDimensions) {
+            name += "[N]";
+        }
+        for (size_t i = 0; withDimensions && i < param->type->arrayDimensions.size(); i++) {
+            name += "[" + std::to_string(param->type->arrayDimensions[i]) + "]";
+        }
+        signature.push_back(name);
+    }
+    return signature;
+}
+
+static std::string formatSignature(const std::vector<std::string>& signature) {
+    std::string text = signature[0] + "(";
+    for (size_t i = 1; i < signature.size(); i++) {
+        text += (i > 1 ? ", " : "") + signature[i];
+    }
+    return text + ")";
+}
+
+void* Session::lookupFunction(const std::string& name, const std::vector<const char*>& signature) {
+    DiagnosticScope scope(impl->diagnostics, impl->options.verbose);
+    if (!impl->jit) {
+        return nullptr;
+    }
+
+    FunctionDeclNode* prototype = impl->declarations->getFunctionPrototype(name);
+    if (!prototype) {
+        reportError("函数 '" + name + "' 未定义", 0);
+        return nullptr;
+    }
+    std::vector<std::string> expected = prototypeSignature(prototype);
+    std::vector<std::string> requested(signature.begin(), signature.end());
+    if (expected != requested) {
+        reportError("函数 '" + name + "' 的类型为 " + formatSignature(prototypeSignature(prototype, true)) +
+                    "，与请求的 C++ 类型 " + formatSignature(requested) + " 不一致", 0);
+        return nullptr;
+    }
+
+    auto symbol = impl->jit->lookup(name);
+    if (!symbol) {
+        reportError(llvm::toString(symbol.takeError()), 0);
+        return nullptr;
+    }
+    return symbol->toPtr<void*>();
+}
+
+const std::vector<Diagnostic>& Session::diagnostics() const {
+    return impl->diagnostics.diagnostics;
+}
+
+void Session::clearDiagnostics() {
+    std::lock_guard<std::recursive_mutex> lock(impl->diagnostics.mutex);
+    impl->diagnostics.diagnostics.clear();
+}
+
+const Timings& Session::lastTimings() const {
+    return impl->timings;
+}
+
+// 编译器
+
+Compiler::Compiler(const Options& options) : options(options) {}
+
+std::unique_ptr<Session> Compiler::createSession() const {
+    return createSession(options);
+}
+
+std::unique_ptr<Session> Compiler::createSession(const Options& options) const {
+    return std::unique_ptr<Session>(new Session(options));
+}
+
+} // namespace ppx
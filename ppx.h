@@ -0,0 +1,177 @@
+/**
+ * ppx.h
+ * PiPiXia 嵌入式 C++ API（libppx.a）
+ *
+ * 功能：
+ * - ppx::Compiler 保存编译选项并创建会话，可在多个线程间共享
+ * - ppx::Session 从内存中的源代码增量编译：每次 compile 生成一个 JIT 模块并立即执行其中的顶层语句，
+ *   之后编译的源代码可以引用之前定义的函数和全局变量
+ * - 诊断信息收集在会话中，可选同时输出到 stderr
+ * - 定义的函数以带签名检查的 C++ 可调用对象 ppx::Function<R(Args...)> 取出
+ *
+ * 示例：
+ *   ppx::Compiler compiler;
+ *   std::unique_ptr<ppx::Session> session = compiler.createSession();
+ *   if (!session->compile("func add(a: int, b: int): int { return a + b }")) {
+ *       for (const ppx::Diagnostic& d : session->diagnostics()) { ... }
+ *   }
+ *   ppx::Function<int(int, int)> add = session->function<int(int, int)>("add");
+ *   int sum = add(2, 3);
+ *
+ * 线程安全：不同的 Session 可以在不同线程中同时使用（各自拥有 LLVMContext、JIT 和诊断状态，
+ * 语法分析在内部依次进行）；同一个 Session 同一时刻只能在一个线程中使用
+ */
+
+#ifndef PPX_H
+#define PPX_H
+
+#include <csetjmp>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "error.h"
+
+namespace ppx {
+
+using ::Diagnostic;
+
+// 编译选项
+struct Options {
+    bool verbose = false;                                           // 输出 [IR Gen] 等详细日志（-v）
+    bool printDiagnostics = false;                                  // 诊断信息同时输出到 stderr（默认只收集）
+    bool enableAllWarnings = false;                                 // -Wall
+    bool warningsAsErrors = false;                                  // -Werror
+    bool suppressWarnings = false;                                  // -w
+    std::string sourceDirectory;                                    // import 查找模块的目录（为空时使用当前工作目录）
+};
+
+// PPX 代码在执行中调用了 exit（未捕获的异常、运行时错误等）
+class RuntimeError : public std::runtime_error {
+public:
+    explicit RuntimeError(int exitCode);
+    int exitCode() const { return code; }
+private:
+    int code;
+};
+
+// 最近一次 compile 各阶段的耗时（毫秒）
+struct Timings {
+    double parse = 0;                                               // 语法分析
+    double ir = 0;                                                  // 增量 IR 生成
+    double jit = 0;                                                 // JIT 编译
+    double run = 0;                                                 // 执行顶层语句
+};
+
+namespace detail {
+
+// exit 的跳转目标：调用 PPX 代码期间安装在当前线程，JIT 代码中的 exit 跳回最近的目标
+struct ExitTrap {
+    ExitTrap();
+    ~ExitTrap();
+    ExitTrap(const ExitTrap&) = delete;
+    ExitTrap& operator=(const ExitTrap&) = delete;
+
+    std::jmp_buf target;
+    int exitCode;
+    ExitTrap* previous;
+};
+
+// C++ 类型对应的 PPX 类型名（未列出的类型不能跨越边界，使用时编译报错）。
+// 定长数组参数按指针传递，T* 对应任意维度的定长数组，记为 "T[N]"（PPX 中的 T[] 是 list<T>，不能跨越边界）
+template <typename T> struct TypeName;
+template <> struct TypeName<void>        { static const char* get() { return "void"; } };
+template <> struct TypeName<int>         { static const char* get() { return "int"; } };
+template <> struct TypeName<double>      { static const char* get() { return "double"; } };
+template <> struct TypeName<bool>        { static const char* get() { return "bool"; } };
+template <> struct TypeName<char>        { static const char* get() { return "char"; } };
+template <> struct TypeName<const char*> { static const char* get() { return "string"; } };
+template <> struct TypeName<char*>       { static const char* get() { return "string"; } };
+template <> struct TypeName<int*>        { static const char* get() { return "int[N]"; } };
+template <> struct TypeName<double*>     { static const char* get() { return "double[N]"; } };
+template <> struct TypeName<bool*>       { static const char* get() { return "bool[N]"; } };
+
+template <typename Signature> struct SignatureOf;
+template <typename R, typename... Args>
+struct SignatureOf<R(Args...)> {
+    typedef R (*Pointer)(Args...);
+    static std::vector<const char*> names() { return {TypeName<R>::get(), TypeName<Args>::get()...}; }
+};
+
+} // namespace detail
+
+class Session;
+
+// PPX 函数的 C++ 可调用对象（会话销毁后失效）
+template <typename Signature> class Function;
+
+template <typename R, typename... Args>
+class Function<R(Args...)> {
+public:
+    Function() : entry(nullptr) {}
+    explicit operator bool() const { return entry != nullptr; }
+
+    // 调用 PPX 函数，函数中调用 exit 时抛出 RuntimeError
+    R operator()(Args... args) const {
+        detail::ExitTrap trap;
+        if (setjmp(trap.target) != 0) {
+            throw RuntimeError(trap.exitCode);
+        }
+        return entry(args...);
+    }
+
+private:
+    friend class Session;
+    explicit Function(R (*entry)(Args...)) : entry(entry) {}
+    R (*entry)(Args...);
+};
+
+// 编译会话：拥有独立的 JIT、已编译定义的符号表和诊断信息
+class Session {
+public:
+    ~Session();
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    // 编译一段源代码并执行其中的顶层语句；name 为诊断信息中显示的文件名
+    // 有错误或执行中调用 exit 时返回 false，之前成功编译的定义保持有效
+    bool compile(const std::string& source, const std::string& name = "<memory>");
+
+    // 取出已定义的函数，名称不存在或签名与 C++ 类型不一致时返回空对象并记录诊断信息
+    template <typename Signature>
+    Function<Signature> function(const std::string& name) {
+        void* address = lookupFunction(name, detail::SignatureOf<Signature>::names());
+        return Function<Signature>(reinterpret_cast<typename detail::SignatureOf<Signature>::Pointer>(address));
+    }
+
+    const std::vector<Diagnostic>& diagnostics() const;             // 收集的诊断信息
+    void clearDiagnostics();                                        // 清空诊断信息
+    const Timings& lastTimings() const;                             // 最近一次 compile 的耗时
+
+private:
+    friend class Compiler;
+    explicit Session(const Options& options);
+
+    void* lookupFunction(const std::string& name, const std::vector<const char*>& signature);
+
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// 编译器：保存默认选项并创建会话
+class Compiler {
+public:
+    explicit Compiler(const Options& options = Options());
+
+    std::unique_ptr<Session> createSession() const;                 // 使用默认选项
+    std::unique_ptr<Session> createSession(const Options& options) const;
+    const Options& getOptions() const { return options; }
+
+private:
+    Options options;
+};
+
+} // namespace ppx
+
+#endif // PPX_H
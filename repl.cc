@@ -0,0 +1,142 @@
+/**
+ * repl.cc
+ * PiPiXia 交互式解释器（REPL）实现
+ *
+ * 读取输入并判断是否完整；编译和执行由 ppx::Session 完成（见 ppx.cc），
+ * 每段输入的各阶段耗时来自 Session::lastTimings
+ */
+
+#include "repl.h"
+#include "error.h"
+
+#include <iostream>
+#include <unistd.h>
+
+ReplSession::ReplSession() : interactive(false), evaluatedCount(0), totalLatency(0) {}
+
+ReplSession::~ReplSession() {}
+
+bool ReplSession::isComplete(const std::string& text) {
+    int depth = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '#') {
+            // 单行注释
+            size_t end = text.find('\n', i);
+            if (end == std::string::npos) {
+                break;
+            }
+            i = end;
+        } else if (text.compare(i, 3, "/#/") == 0) {
+            size_t end = text.find("/#/", i + 3);
+            if (end == std::string::npos) {
+                return false;
+            }
+            i = end + 2;
+        } else if (c == '"' || c == '\'') {
+            size_t j = i + 1;
+            while (j < text.size() && text[j] != c) {
+                j += (text[j] == '\\') ? 2 : 1;
+            }
+            if (j >= text.size()) {
+                return c == '\'';       // 未闭合的字符串继续读取，错误的字符字面量交给词法分析报告
+            }
+            i = j;
+        } else if (c == '{' || c == '(' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ')' || c == ']') {
+            depth--;
+        }
+    }
+    return depth <= 0;
+}
+
+bool ReplSession::readChunk(FILE* input, std::string& chunk) {
+    chunk.clear();
+    char* line = nullptr;
+    size_t capacity = 0;
+    for (;;) {
+        if (interactive) {
+            std::cout << (chunk.empty() ? "ppx> " : "...> ") << std::flush;
+        }
+        ssize_t length = getline(&line, &capacity, input);
+        if (length < 0) {
+            free(line);
+            if (interactive) {
+                std::cout << std::endl;
+            }
+            return !chunk.empty();
+        }
+
+        std::string text(line, length);
+        size_t first = text.find_first_not_of(" \t\r\n");
+        if (chunk.empty()) {
+            if (first == std::string::npos) {
+                continue;
+            }
+            size_t last = text.find_last_not_of(" \t\r\n");
+            std::string command = text.substr(first, last - first + 1);
+            if (command == ":quit" || command == ":q") {
+                free(line);
+                return false;
+            }
+        }
+
+        chunk += text;
+        if (chunk.back() != '\n') {
+            chunk += '\n';
+        }
+        if (isComplete(chunk)) {
+            free(line);
+            return true;
+        }
+    }
+}
+
+void ReplSession::evaluate(const std::string& text) {
+    session->compile(text, "<repl>");
+
+    // 执行中 exit 的输入同样计入延迟统计（已经完成编译）
+    const ppx::Timings& timings = session->lastTimings();
+    if (timings.jit <= 0) {
+        return;
+    }
+    evaluatedCount++;
+    double latency = timings.parse + timings.ir + timings.jit;
+    totalLatency += latency;
+    if (g_verbose) {
+        std::cout << "[REPL] Input " << evaluatedCount << ": parse " << timings.parse << " ms, IR "
+                  << timings.ir << " ms, JIT " << timings.jit << " ms, run " << timings.run << " ms" << std::endl;
+    }
+}
+
+int ReplSession::run(FILE* input) {
+    // 诊断信息直接输出，警告选项沿用命令行设置
+    DiagnosticState& diagnostics = currentDiagnostics();
+    ppx::Options options;
+    options.verbose = g_verbose;
+    options.printDiagnostics = true;
+    options.enableAllWarnings = diagnostics.enableAllWarnings;
+    options.warningsAsErrors = diagnostics.warningsAsErrors;
+    options.suppressWarnings = diagnostics.suppressWarnings;
+    session = ppx::Compiler(options).createSession();
+    if (!session->diagnostics().empty()) {
+        // 会话初始化失败（错误信息已输出）
+        return 1;
+    }
+    interactive = isatty(fileno(input));
+    if (interactive) {
+        std::cout << "PiPiXia REPL（输入 :quit 退出）" << std::endl;
+    }
+
+    std::string chunk;
+    while (readChunk(input, chunk)) {
+        evaluate(chunk);
+    }
+
+    if (g_verbose && evaluatedCount > 0) {
+        std::cout << "[REPL] " << evaluatedCount << " input(s), average latency "
+                  << totalLatency / evaluatedCount << " ms (excluding execution)" << std::endl;
+    }
+    return 0;
+}
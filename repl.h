@@ -0,0 +1,41 @@
+/**
+ * repl.h
+ * PiPiXia 交互式解释器（REPL）
+ *
+ * 功能：
+ * - 逐段读取输入（括号未闭合时继续读取下一行），每段输入交给 ppx::Session 增量编译并执行
+ * - 增量模块只包含本段输入的定义，之前定义的函数和全局变量以外部声明引用，由 ORC JIT 的符号查找解析
+ * - 已编译的代码不会重新编译，单行输入的延迟只与本行代码量相关
+ * - 未捕获的异常和 exit 只结束当前输入，会话中的定义保持有效
+ */
+
+#ifndef REPL_H
+#define REPL_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "ppx.h"
+
+class ReplSession {
+public:
+    ReplSession();
+    ~ReplSession();
+
+    int run(FILE* input);                                           // 读取-求值-打印循环，返回退出码
+
+private:
+    std::unique_ptr<ppx::Session> session;                          // 编译会话（JIT 和已有定义）
+    bool interactive;                                               // 输入是否为终端（决定是否显示提示符）
+
+    // 延迟统计
+    unsigned evaluatedCount;                                        // 已求值的输入段数
+    double totalLatency;                                            // 累计延迟（毫秒）
+
+    bool readChunk(FILE* input, std::string& chunk);                // 读取一段完整输入，EOF 返回 false
+    static bool isComplete(const std::string& text);                // 括号是否已闭合（忽略字符串和注释）
+    void evaluate(const std::string& text);                         // 编译并执行一段输入，输出延迟统计
+};
+
+#endif // REPL_H
@@ -33,9 +33,16 @@ case "${CLEAN_TYPE}" in
         echo ""
         
         # 清理目标文件
-        if [ -f "lexical.o" ] || [ -f "syntax.o" ] || [ -f "main.o" ] || [ -f "codegen.o" ] || [ -f "error.o" ]; then
+        if [ -f "lexical.o" ] || [ -f "syntax.o" ] || [ -f "main.o" ] || [ -f "codegen.o" ] || [ -f "error.o" ] ||
+           [ -f "interp.o" ] || [ -f "tierjit.o" ] || [ -f "repl.o" ]; then
             echo -e "  ${YELLOW}→ 清理目标文件 (.o)${NC}"
-            rm -f lexical.o syntax.o main.o codegen.o error.o
+            rm -f lexical.o syntax.o main.o codegen.o error.o interp.o tierjit.o repl.o
+        fi
+        
+        # 清理嵌入式 API 静态库
+        if [ -f "ppx.o" ] || [ -f "libppx.a" ]; then
+            echo -e "  ${YELLOW}→ 清理嵌入式 API 静态库 (libppx.a)${NC}"
+            rm -f ppx.o libppx.a
         fi
         
         # 清理生成的源文件
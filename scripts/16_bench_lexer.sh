@@ -0,0 +1,127 @@
+#!/bin/bash
+
+# PiPiXia 词法分析器吞吐量基准测试
+# 生成包含大量多行注释、插值字符串和字符字面量的多 MB 源文件，
+# 测量 -tokens 模式的扫描速度，并校验 Token 数量（多行注释不能吞掉后续代码）
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+COMPILER="${PROJECT_ROOT}/compiler"
+BENCH_DIR="${PROJECT_ROOT}/output/bench"
+
+# 每个生成单元包含的 Token 数量（见 generate_source）
+TOKENS_PER_UNIT=42
+
+# 默认测试规模（MB）和重复次数
+SIZES=(1 4 16)
+RUNS=3
+
+print_usage() {
+    echo "用法: $0 [-r 次数] [大小MB ...]"
+    echo ""
+    echo "选项:"
+    echo "  -r, --runs N    每个规模重复运行 N 次，取最快一次（默认 ${RUNS}）"
+    echo "  -h, --help      显示帮助信息"
+    echo ""
+    echo "示例:"
+    echo "  $0              # 测试 1 4 16 MB"
+    echo "  $0 -r 5 8 32    # 测试 8 32 MB，每个规模运行 5 次"
+}
+
+# 解析参数
+CUSTOM_SIZES=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -r|--runs) RUNS="$2"; shift 2 ;;
+        -h|--help) print_usage; exit 0 ;;
+        *) CUSTOM_SIZES+=("$1"); shift ;;
+    esac
+done
+if [ ${#CUSTOM_SIZES[@]} -gt 0 ]; then
+    SIZES=("${CUSTOM_SIZES[@]}")
+fi
+
+# 检查编译器
+if [ ! -f "${COMPILER}" ]; then
+    echo -e "${RED}错误: 编译器不存在，请先运行 'make' 构建编译器${NC}"
+    exit 1
+fi
+
+mkdir -p "${BENCH_DIR}"
+
+# 生成约 $1 MB 的源文件，输出生成的单元数
+generate_source() {
+    local size_mb="$1"
+    local out="$2"
+    awk -v limit=$((size_mb * 1024 * 1024)) '
+    BEGIN {
+        bytes = 0; n = 0
+        while (bytes < limit) {
+            unit = sprintf("/#/ 块注释 %d\n   多行内容 / 斜杠 # 井号 ${不是插值}\n/#/\n", n)
+            unit = unit sprintf("func f_%d(x: int): int {\n", n)
+            unit = unit sprintf("    let s: string = \"value ${x + %d} and ${x * 2:d}\"\n", n)
+            unit = unit "    let t: string = \"plain /#/ not a comment\"\n"
+            unit = unit "    let c: char = '\''a'\''\n"
+            unit = unit "    # 行注释\n"
+            unit = unit sprintf("    return x + %d\n}\n", n)
+            printf "%s", unit > "'"${out}"'"
+            bytes += length(unit); n++
+        }
+        print n
+    }'
+}
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 词法分析器吞吐量基准测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+printf "%-10s %-12s %-12s %-12s %s\n" "Size(MB)" "Tokens" "Best(s)" "MB/s" "Check"
+echo "------------------------------------------------------------"
+
+FAILED=0
+for size in "${SIZES[@]}"; do
+    src="${BENCH_DIR}/lexer_${size}mb.ppx"
+    units=$(generate_source "${size}" "${src}")
+    expected=$((units * TOKENS_PER_UNIT))
+    actual_mb=$(awk -v b="$(wc -c < "${src}")" 'BEGIN { printf "%.2f", b / 1048576 }')
+
+    best=""
+    tokens=""
+    for ((i = 0; i < RUNS; i++)); do
+        start=$(date +%s.%N)
+        output=$("${COMPILER}" "${src}" -tokens -o "${BENCH_DIR}/lexer_${size}mb.tokens" 2>&1)
+        end=$(date +%s.%N)
+        elapsed=$(awk -v s="${start}" -v e="${end}" 'BEGIN { printf "%.3f", e - s }')
+        tokens=$(echo "${output}" | grep "Total tokens:" | awk '{ print $3 }')
+        if [ -z "${best}" ] || awk -v a="${elapsed}" -v b="${best}" 'BEGIN { exit !(a < b) }'; then
+            best="${elapsed}"
+        fi
+    done
+
+    throughput=$(awk -v m="${actual_mb}" -v t="${best}" 'BEGIN { if (t > 0) printf "%.1f", m / t; else print "-" }')
+    if [ "${tokens}" = "${expected}" ]; then
+        check="${GREEN}OK${NC}"
+    else
+        check="${RED}FAIL (expected ${expected})${NC}"
+        FAILED=$((FAILED + 1))
+    fi
+    printf "%-10s %-12s %-12s %-12s " "${actual_mb}" "${tokens:-?}" "${best}" "${throughput}"
+    echo -e "${check}"
+done
+
+echo ""
+if [ ${FAILED} -eq 0 ]; then
+    echo -e "${GREEN}基准测试完成${NC}"
+else
+    echo -e "${RED}${FAILED} 个规模的 Token 数量不符${NC}"
+    exit 1
+fi
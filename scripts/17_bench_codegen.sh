@@ -0,0 +1,147 @@
+#!/bin/bash
+
+# PiPiXia 并行代码生成基准测试
+# 生成包含大量函数的源文件，分别用不同的 -fcodegen-threads 编译为目标文件，
+# 输出耗时和相对单线程的加速比，并校验多线程生成的可执行文件与单线程行为一致
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+COMPILER="${PROJECT_ROOT}/compiler"
+BENCH_DIR="${PROJECT_ROOT}/output/bench"
+
+# 默认函数数量、线程数和重复次数
+FUNCTIONS=2000
+THREADS=(1 2 4 8)
+RUNS=3
+
+print_usage() {
+    echo "用法: $0 [-n 函数数量] [-r 次数] [线程数 ...]"
+    echo ""
+    echo "选项:"
+    echo "  -n, --functions N  生成 N 个函数（默认 ${FUNCTIONS}）"
+    echo "  -r, --runs N       每个线程数重复运行 N 次，取最快一次（默认 ${RUNS}）"
+    echo "  -h, --help         显示帮助信息"
+    echo ""
+    echo "示例:"
+    echo "  $0                 # 测试 1 2 4 8 线程"
+    echo "  $0 -n 5000 1 4 16  # 5000 个函数，测试 1 4 16 线程"
+}
+
+# 解析参数
+CUSTOM_THREADS=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -n|--functions) FUNCTIONS="$2"; shift 2 ;;
+        -r|--runs) RUNS="$2"; shift 2 ;;
+        -h|--help) print_usage; exit 0 ;;
+        *) CUSTOM_THREADS+=("$1"); shift ;;
+    esac
+done
+if [ ${#CUSTOM_THREADS[@]} -gt 0 ]; then
+    THREADS=("${CUSTOM_THREADS[@]}")
+fi
+
+# 检查编译器
+if [ ! -f "${COMPILER}" ]; then
+    echo -e "${RED}错误: 编译器不存在，请先运行 'make' 构建编译器${NC}"
+    exit 1
+fi
+
+mkdir -p "${BENCH_DIR}"
+
+# 生成包含 $1 个函数的源文件，main 依次调用所有函数并输出校验和
+generate_source() {
+    local count="$1"
+    local out="$2"
+    awk -v n="${count}" '
+    BEGIN {
+        for (i = 0; i < n; i++) {
+            printf "func f_%d(x: int): int {\n", i
+            printf "    let acc: int = x\n"
+            printf "    for j in 0..%d {\n", 8 + i % 8
+            printf "        if acc %% 3 == 0 {\n"
+            printf "            acc = acc // 3 + j * %d\n", i % 17 + 1
+            printf "        } else {\n"
+            printf "            acc = (acc * 7 + %d) %% 100003\n", i
+            printf "        }\n"
+            printf "    }\n"
+            printf "    return acc\n"
+            printf "}\n\n"
+        }
+        printf "func main(): int {\n"
+        printf "    let sum: int = 0\n"
+        for (i = 0; i < n; i++) {
+            printf "    sum = (sum + f_%d(%d)) %% 1000000007\n", i, i
+        }
+        printf "    print(\"checksum = ${sum}\")\n"
+        printf "    return 0\n"
+        printf "}\n"
+    }' > "${out}"
+}
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 并行代码生成基准测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+
+src="${BENCH_DIR}/codegen_${FUNCTIONS}f.ppx"
+generate_source "${FUNCTIONS}" "${src}"
+echo -e "${CYAN}源文件: ${src} (${FUNCTIONS} 个函数)${NC}"
+echo ""
+printf "%-10s %-12s %s\n" "Threads" "Best(s)" "Speedup"
+echo "----------------------------------------"
+
+base=""
+for threads in "${THREADS[@]}"; do
+    best=""
+    for ((i = 0; i < RUNS; i++)); do
+        start=$(date +%s.%N)
+        if ! "${COMPILER}" "${src}" -c -fcodegen-threads="${threads}" \
+                -o "${BENCH_DIR}/codegen_t${threads}.o" > /dev/null 2>&1; then
+            echo -e "${RED}错误: -fcodegen-threads=${threads} 编译失败${NC}"
+            exit 1
+        fi
+        end=$(date +%s.%N)
+        elapsed=$(awk -v s="${start}" -v e="${end}" 'BEGIN { printf "%.3f", e - s }')
+        if [ -z "${best}" ] || awk -v a="${elapsed}" -v b="${best}" 'BEGIN { exit !(a < b) }'; then
+            best="${elapsed}"
+        fi
+    done
+    if [ -z "${base}" ]; then
+        base="${best}"
+    fi
+    speedup=$(awk -v b="${base}" -v t="${best}" 'BEGIN { if (t > 0) printf "%.2fx", b / t; else print "-" }')
+    printf "%-10s %-12s %s\n" "${threads}" "${best}" "${speedup}"
+done
+
+# 行为一致性校验：单线程与最大线程数生成的可执行文件输出必须相同
+echo ""
+max_threads="${THREADS[${#THREADS[@]}-1]}"
+echo -e "${CYAN}校验 -fcodegen-threads=1 与 -fcodegen-threads=${max_threads} 的运行结果...${NC}"
+"${COMPILER}" "${src}" -fcodegen-threads=1 -o "${BENCH_DIR}/codegen_serial" > /dev/null 2>&1
+"${COMPILER}" "${src}" -fcodegen-threads="${max_threads}" -o "${BENCH_DIR}/codegen_parallel" > /dev/null 2>&1
+if [ ! -x "${BENCH_DIR}/codegen_serial" ] || [ ! -x "${BENCH_DIR}/codegen_parallel" ]; then
+    echo -e "${RED}错误: 生成可执行文件失败${NC}"
+    exit 1
+fi
+serial_output=$("${BENCH_DIR}/codegen_serial")
+parallel_output=$("${BENCH_DIR}/codegen_parallel")
+if [ "${serial_output}" = "${parallel_output}" ]; then
+    echo -e "${GREEN}输出一致: ${serial_output}${NC}"
+    echo ""
+    echo -e "${GREEN}基准测试完成${NC}"
+else
+    echo -e "${RED}输出不一致${NC}"
+    echo "  单线程: ${serial_output}"
+    echo "  多线程: ${parallel_output}"
+    exit 1
+fi
@@ -0,0 +1,181 @@
+#!/bin/bash
+
+# PiPiXia 交互式解释器延迟基准测试
+# 生成一段交互脚本（函数定义、全局变量、调用之前定义的函数的语句交替出现），
+# 通过管道输入 compiler --repl -v，统计每段输入从读入到可以执行的延迟（解析 + IR 生成 + JIT 编译），
+# 并与目标延迟比较，同时校验最后一行输出确认之前的定义在后续输入中可用
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+COMPILER="${PROJECT_ROOT}/compiler"
+BENCH_DIR="${PROJECT_ROOT}/output/bench"
+
+# 默认输入轮数和目标延迟
+ROUNDS=100
+TARGET_MS=20
+
+print_usage() {
+    echo "用法: $0 [-n 轮数] [-t 目标毫秒]"
+    echo ""
+    echo "选项:"
+    echo "  -n, --rounds N     生成 N 轮输入，每轮 3 段（默认 ${ROUNDS}）"
+    echo "  -t, --target MS    单段输入的目标延迟（默认 ${TARGET_MS} ms）"
+    echo "  -h, --help         显示帮助信息"
+    echo ""
+    echo "示例:"
+    echo "  $0                 # 300 段输入，目标 20 ms"
+    echo "  $0 -n 500 -t 10    # 1500 段输入，目标 10 ms"
+}
+
+# 解析参数
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -n|--rounds) ROUNDS="$2"; shift 2 ;;
+        -t|--target) TARGET_MS="$2"; shift 2 ;;
+        -h|--help) print_usage; exit 0 ;;
+        *) echo -e "${RED}错误: 未知参数 '$1'${NC}"; print_usage; exit 1 ;;
+    esac
+done
+
+# 检查编译器
+if [ ! -f "${COMPILER}" ]; then
+    echo -e "${RED}错误: 编译器不存在，请先运行 'make' 构建编译器${NC}"
+    exit 1
+fi
+
+mkdir -p "${BENCH_DIR}"
+
+# 每轮：定义一个调用上一轮函数的新函数，定义一个全局变量，输出一次累计结果
+generate_input() {
+    local rounds="$1"
+    local out="$2"
+    awk -v n="${rounds}" '
+    BEGIN {
+        printf "func f_0(x: int): int { return x + 1 }\n"
+        printf "let total: int = 0\n"
+        for (i = 1; i <= n; i++) {
+            printf "func f_%d(x: int): int {\n", i
+            printf "    let acc: int = f_%d(x)\n", i - 1
+            printf "    for j in 0..%d {\n", i % 5 + 1
+            printf "        acc = (acc * 3 + j) %% 1000003\n"
+            printf "    }\n"
+            printf "    return acc\n"
+            printf "}\n"
+            printf "let g_%d: int = f_%d(%d)\n", i, i, i
+            printf "total = (total + g_%d) %% 1000000007\n", i
+        }
+        printf "print(\"total = ${total}\")\n"
+    }' > "${out}"
+}
+
+# 同样的计算作为普通程序编译运行，得到期望输出
+generate_program() {
+    local rounds="$1"
+    local out="$2"
+    awk -v n="${rounds}" '
+    BEGIN {
+        printf "func f_0(x: int): int { return x + 1 }\n"
+        for (i = 1; i <= n; i++) {
+            printf "func f_%d(x: int): int {\n", i
+            printf "    let acc: int = f_%d(x)\n", i - 1
+            printf "    for j in 0..%d {\n", i % 5 + 1
+            printf "        acc = (acc * 3 + j) %% 1000003\n"
+            printf "    }\n"
+            printf "    return acc\n"
+            printf "}\n"
+        }
+        printf "func main(): int {\n"
+        printf "    let total: int = 0\n"
+        for (i = 1; i <= n; i++) {
+            printf "    total = (total + f_%d(%d)) %% 1000000007\n", i, i
+        }
+        printf "    print(\"total = ${total}\")\n"
+        printf "    return 0\n"
+        printf "}\n"
+    }' > "${out}"
+}
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 交互式解释器延迟基准测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+
+input="${BENCH_DIR}/repl_${ROUNDS}r.txt"
+generate_input "${ROUNDS}" "${input}"
+inputs=$((ROUNDS * 3 + 3))
+echo -e "${CYAN}输入脚本: ${input} (${inputs} 段输入)${NC}"
+
+log="${BENCH_DIR}/repl_${ROUNDS}r.log"
+if ! "${COMPILER}" --repl -v < "${input}" > "${log}" 2>&1; then
+    echo -e "${RED}错误: compiler --repl 运行失败，详见 ${log}${NC}"
+    exit 1
+fi
+
+# [REPL] Input N: parse A ms, IR B ms, JIT C ms, run D ms
+stats=$(grep '^\[REPL\] Input ' "${log}" | awk '
+    {
+        latency = $5 + $8 + $11
+        sum += latency
+        count++
+        values[count] = latency
+        if (latency > max) max = latency
+    }
+    END {
+        if (count == 0) { print "0"; exit }
+        # 插入排序求 p95（输入规模较小）
+        for (i = 2; i <= count; i++) {
+            v = values[i]
+            for (j = i - 1; j >= 1 && values[j] > v; j--) values[j + 1] = values[j]
+            values[j + 1] = v
+        }
+        p95 = values[int(count * 0.95 + 0.5) > 0 ? int(count * 0.95 + 0.5) : 1]
+        printf "%d %.3f %.3f %.3f\n", count, sum / count, p95, max
+    }')
+read -r count average p95 max <<< "${stats}"
+if [ "${count}" -eq 0 ]; then
+    echo -e "${RED}错误: 没有输入被成功求值，详见 ${log}${NC}"
+    exit 1
+fi
+
+echo ""
+printf "%-12s %s\n" "Inputs" "${count}"
+printf "%-12s %s ms\n" "Average" "${average}"
+printf "%-12s %s ms\n" "p95" "${p95}"
+printf "%-12s %s ms\n" "Max" "${max}"
+echo ""
+
+# 结果校验：与编译运行同样计算的普通程序比较
+program="${BENCH_DIR}/repl_${ROUNDS}r.ppx"
+generate_program "${ROUNDS}" "${program}"
+expected=""
+"${COMPILER}" "${program}" -o "${BENCH_DIR}/repl_${ROUNDS}r" > /dev/null 2>&1
+if [ -x "${BENCH_DIR}/repl_${ROUNDS}r" ]; then
+    expected=$("${BENCH_DIR}/repl_${ROUNDS}r")
+fi
+actual=$(grep '^total = ' "${log}" | tail -1)
+if [ -z "${expected}" ]; then
+    echo -e "${YELLOW}警告: 无法编译对照程序，跳过结果校验${NC}"
+elif [ "${actual}" = "${expected}" ]; then
+    echo -e "${GREEN}输出一致: ${actual}${NC}"
+else
+    echo -e "${RED}输出不一致${NC}"
+    echo "  REPL:   ${actual}"
+    echo "  编译:   ${expected}"
+    exit 1
+fi
+
+if awk -v a="${average}" -v t="${TARGET_MS}" 'BEGIN { exit !(a < t) }'; then
+    echo -e "${GREEN}平均延迟 ${average} ms < 目标 ${TARGET_MS} ms${NC}"
+else
+    echo -e "${RED}平均延迟 ${average} ms 超过目标 ${TARGET_MS} ms${NC}"
+    exit 1
+fi
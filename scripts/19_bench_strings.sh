@@ -0,0 +1,204 @@
+#!/bin/bash
+
+# PiPiXia 字符串内置函数基准测试
+# 对 find、count、split 分别生成两个程序：一个调用内置函数，一个用 PPX 循环逐个读取 s[i] 实现同样的计算，
+# 编译为可执行文件后比较运行时间，并校验两者输出的校验和一致
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+COMPILER="${PROJECT_ROOT}/compiler"
+BENCH_DIR="${PROJECT_ROOT}/output/bench"
+
+# 默认字符串大小（字节）、每个程序内的重复次数和运行次数
+SIZE=65536
+REPEAT=3
+RUNS=3
+KERNELS=(find count split)
+
+print_usage() {
+    echo "用法: $0 [-s 字节数] [-n 重复次数] [-r 次数] [函数 ...]"
+    echo ""
+    echo "选项:"
+    echo "  -s, --size N       被搜索字符串的大小（默认 ${SIZE} 字节）"
+    echo "  -n, --repeat N     每个程序内重复计算 N 次（默认 ${REPEAT}）"
+    echo "  -r, --runs N       每个程序运行 N 次，取最快一次（默认 ${RUNS}）"
+    echo "  -h, --help         显示帮助信息"
+    echo ""
+    echo "示例:"
+    echo "  $0                      # 测试 find count split"
+    echo "  $0 -s 262144 -n 1 find  # 256 KB 字符串，只测试 find"
+}
+
+# 解析参数
+CUSTOM_KERNELS=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -s|--size) SIZE="$2"; shift 2 ;;
+        -n|--repeat) REPEAT="$2"; shift 2 ;;
+        -r|--runs) RUNS="$2"; shift 2 ;;
+        -h|--help) print_usage; exit 0 ;;
+        find|count|split) CUSTOM_KERNELS+=("$1"); shift ;;
+        *) echo -e "${RED}错误: 未知参数 '$1'${NC}"; print_usage; exit 1 ;;
+    esac
+done
+if [ ${#CUSTOM_KERNELS[@]} -gt 0 ]; then
+    KERNELS=("${CUSTOM_KERNELS[@]}")
+fi
+
+# 检查编译器
+if [ ! -f "${COMPILER}" ]; then
+    echo -e "${RED}错误: 编译器不存在，请先运行 'make' 构建编译器${NC}"
+    exit 1
+fi
+
+mkdir -p "${BENCH_DIR}"
+
+# 生成程序：$1 为函数名，$2 为 builtin 或 loop
+generate_source() {
+    local kernel="$1"
+    local variant="$2"
+    local out="$3"
+    {
+        # 输入字符串：重复拼接到指定大小，末尾追加查找目标
+        echo 'func build(n: int): string {'
+        echo '    let s: string = "lorem ipsum dolor sit amet, ab "'
+        echo '    while (len(s) < n) {'
+        echo '        s = s + s'
+        echo '    }'
+        echo '    return s + "needle!"'
+        echo '}'
+        echo ''
+        if [ "${variant}" = "loop" ]; then
+            case "${kernel}" in
+                find)
+                    echo 'func work(s: string): int {'
+                    echo '    let sub: string = "needle!"'
+                    echo '    let n: int = len(s)'
+                    echo '    for i in 0..n - 6 {'
+                    echo '        let j: int = 0'
+                    echo '        while (j < 7 && s[i + j] == sub[j]) {'
+                    echo '            j += 1'
+                    echo '        }'
+                    echo '        if (j == 7) {'
+                    echo '            return i'
+                    echo '        }'
+                    echo '    }'
+                    echo '    return -1'
+                    echo '}'
+                    ;;
+                count)
+                    echo 'func work(s: string): int {'
+                    echo '    let n: int = len(s)'
+                    echo '    let total: int = 0'
+                    echo '    let i: int = 0'
+                    echo '    while (i + 2 <= n) {'
+                    echo '        if (s[i] == '"'"'a'"'"' && s[i + 1] == '"'"'b'"'"') {'
+                    echo '            total += 1'
+                    echo '            i += 2'
+                    echo '        } else {'
+                    echo '            i += 1'
+                    echo '        }'
+                    echo '    }'
+                    echo '    return total'
+                    echo '}'
+                    ;;
+                split)
+                    echo 'func work(s: string): int {'
+                    echo '    let fields: int = 1'
+                    echo '    for i in 0..len(s) {'
+                    echo '        if (s[i] == '"'"','"'"') {'
+                    echo '            fields += 1'
+                    echo '        }'
+                    echo '    }'
+                    echo '    return fields'
+                    echo '}'
+                    ;;
+            esac
+        else
+            case "${kernel}" in
+                find)  echo 'func work(s: string): int { return find(s, "needle!") }' ;;
+                count) echo 'func work(s: string): int { return count(s, "ab") }' ;;
+                split) echo 'func work(s: string): int { return len(split(s, ",")) }' ;;
+            esac
+        fi
+        echo ''
+        echo 'func main(): int {'
+        echo "    let text: string = build(${SIZE})"
+        echo '    let checksum: int = 0'
+        echo "    for r in 0..${REPEAT} {"
+        echo '        checksum += work(text)'
+        echo '    }'
+        echo '    print("checksum = ${checksum}")'
+        echo '    return 0'
+        echo '}'
+    } > "${out}"
+}
+
+# 运行可执行文件 RUNS 次，输出 "最快耗时 输出"
+time_program() {
+    local exe="$1"
+    local best=""
+    local output=""
+    for ((i = 0; i < RUNS; i++)); do
+        local start end elapsed
+        start=$(date +%s.%N)
+        output=$("${exe}")
+        end=$(date +%s.%N)
+        elapsed=$(awk -v s="${start}" -v e="${end}" 'BEGIN { printf "%.4f", e - s }')
+        if [ -z "${best}" ] || awk -v a="${elapsed}" -v b="${best}" 'BEGIN { exit !(a < b) }'; then
+            best="${elapsed}"
+        fi
+    done
+    echo "${best} ${output}"
+}
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 字符串内置函数基准测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+echo -e "${CYAN}字符串大小: ${SIZE} 字节，每个程序重复 ${REPEAT} 次${NC}"
+echo ""
+printf "%-10s %-12s %-12s %s\n" "Kernel" "Loop(s)" "Builtin(s)" "Speedup"
+echo "--------------------------------------------------"
+
+failed=0
+for kernel in "${KERNELS[@]}"; do
+    declare -A result=()
+    declare -A checksum=()
+    for variant in loop builtin; do
+        src="${BENCH_DIR}/strings_${kernel}_${variant}.ppx"
+        exe="${BENCH_DIR}/strings_${kernel}_${variant}"
+        generate_source "${kernel}" "${variant}" "${src}"
+        if ! "${COMPILER}" "${src}" -o "${exe}" > /dev/null 2>&1 || [ ! -x "${exe}" ]; then
+            echo -e "${RED}错误: ${src} 编译失败${NC}"
+            exit 1
+        fi
+        read -r elapsed output <<< "$(time_program "${exe}")"
+        result[${variant}]="${elapsed}"
+        checksum[${variant}]="${output}"
+    done
+    speedup=$(awk -v l="${result[loop]}" -v b="${result[builtin]}" 'BEGIN { if (b > 0) printf "%.1fx", l / b; else print "-" }')
+    printf "%-10s %-12s %-12s %s\n" "${kernel}" "${result[loop]}" "${result[builtin]}" "${speedup}"
+    if [ "${checksum[loop]}" != "${checksum[builtin]}" ]; then
+        echo -e "${RED}  校验和不一致: 循环 ${checksum[loop]}，内置函数 ${checksum[builtin]}${NC}"
+        failed=1
+    fi
+    unset result checksum
+done
+
+echo ""
+if [ ${failed} -eq 0 ]; then
+    echo -e "${GREEN}基准测试完成，内置函数与循环实现的结果一致${NC}"
+else
+    echo -e "${RED}基准测试失败${NC}"
+    exit 1
+fi
@@ -0,0 +1,226 @@
+#!/bin/bash
+
+# PiPiXia 排序内置函数基准测试
+# 对 int、double、char、string 分别生成两个程序：一个调用内置的 sort()，一个用 PPX 写的插入排序，
+# 编译为可执行文件后比较运行时间，并校验两者输出的校验和一致。
+# 插入排序是 O(n^2)，10^6 个元素需要数小时，因此默认只用 -m 指定的规模运行插入排序，
+# 再按 n^2 推算出 10^6 个元素的耗时；内置函数始终在 -n 指定的规模（默认 10^6）上运行
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+COMPILER="${PROJECT_ROOT}/compiler"
+BENCH_DIR="${PROJECT_ROOT}/output/bench"
+
+# 默认元素个数、插入排序的元素个数和运行次数
+SIZE=1000000
+LOOP_SIZE=20000
+RUNS=3
+TYPES=(int double char string)
+
+print_usage() {
+    echo "用法: $0 [-n 元素个数] [-m 插入排序元素个数] [-r 次数] [类型 ...]"
+    echo ""
+    echo "选项:"
+    echo "  -n, --size N       内置 sort() 排序的元素个数（默认 ${SIZE}）"
+    echo "  -m, --loop-size N  插入排序的元素个数（默认 ${LOOP_SIZE}，耗时按 n^2 推算到 -n 的规模）"
+    echo "  -r, --runs N       每个程序运行 N 次，取最快一次（默认 ${RUNS}）"
+    echo "  -h, --help         显示帮助信息"
+    echo ""
+    echo "示例:"
+    echo "  $0                         # 测试 int double char string"
+    echo "  $0 -m 1000000 int          # 插入排序也使用 10^6 个元素（需要很长时间）"
+    echo "  $0 -n 100000 -m 100000     # 两者都使用 10^5 个元素，校验和可以直接比较"
+}
+
+# 解析参数
+CUSTOM_TYPES=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -n|--size) SIZE="$2"; shift 2 ;;
+        -m|--loop-size) LOOP_SIZE="$2"; shift 2 ;;
+        -r|--runs) RUNS="$2"; shift 2 ;;
+        -h|--help) print_usage; exit 0 ;;
+        int|double|char|string) CUSTOM_TYPES+=("$1"); shift ;;
+        *) echo -e "${RED}错误: 未知参数 '$1'${NC}"; print_usage; exit 1 ;;
+    esac
+done
+if [ ${#CUSTOM_TYPES[@]} -gt 0 ]; then
+    TYPES=("${CUSTOM_TYPES[@]}")
+fi
+if [ "${LOOP_SIZE}" -gt "${SIZE}" ]; then
+    LOOP_SIZE="${SIZE}"
+fi
+
+# 检查编译器
+if [ ! -f "${COMPILER}" ]; then
+    echo -e "${RED}错误: 编译器不存在，请先运行 'make' 构建编译器${NC}"
+    exit 1
+fi
+
+mkdir -p "${BENCH_DIR}"
+
+# 生成程序：$1 为元素类型，$2 为 builtin 或 loop，$3 为元素个数
+generate_source() {
+    local type="$1"
+    local variant="$2"
+    local size="$3"
+    local out="$4"
+    {
+        # 输入数据：两个线性同余序列组合出 [0, 30000^2) 内的伪随机数
+        echo "func build(n: int): list<${type}> {"
+        echo "    let a: list<${type}> = []"
+        echo '    reserve(a, n)'
+        echo '    let letters: string = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"'
+        echo '    let x: int = 12345'
+        echo '    let y: int = 54321'
+        echo '    for i in 0..n {'
+        echo '        x = (x * 75 + 74) % 65537'
+        echo '        y = (y * 31 + 7) % 65521'
+        echo '        let v: int = x % 30000 * 30000 + y % 30000'
+        case "${type}" in
+            int)    echo '        a.push(v - 450000000)' ;;
+            double) echo '        a.push(v * 0.001 - 450000.0)' ;;
+            char)   echo '        a.push(letters[v % 62])' ;;
+            string) echo '        a.push("${letters[v % 62]}${letters[y % 62]}${v}")' ;;
+        esac
+        echo '    }'
+        echo '    return a'
+        echo '}'
+        echo ''
+        if [ "${variant}" = "loop" ]; then
+            echo "func work(a: list<${type}>): int {"
+            echo '    for i in 1..len(a) {'
+            # 动态数组中的字符串在元素被覆盖时释放，string 需要先复制一份
+            if [ "${type}" = "string" ]; then
+                echo '        let x: string = a[i] + ""'
+            else
+                echo "        let x: ${type} = a[i]"
+            fi
+            echo '        let j: int = i'
+            echo '        while (j > 0 && a[j - 1] > x) {'
+            echo '            a[j] = a[j - 1]'
+            echo '            j -= 1'
+            echo '        }'
+            echo '        a[j] = x'
+            echo '    }'
+            echo '    return 0'
+            echo '}'
+        else
+            echo "func work(a: list<${type}>): int { return sort(a) }"
+        fi
+        echo ''
+        # 校验和：检查有序，并按位置累加元素的摘要
+        echo 'func main(): int {'
+        echo "    let a: list<${type}> = build(${size})"
+        echo '    work(a)'
+        echo '    let checksum: int = 0'
+        echo '    for i in 0..len(a) {'
+        echo '        if (i > 0 && a[i - 1] > a[i]) {'
+        echo '            print("not sorted at ${i}")'
+        echo '            return 1'
+        echo '        }'
+        case "${type}" in
+            int)    echo '        checksum = (checksum * 31 + a[i]) % 1000000007' ;;
+            double) echo '        checksum = (checksum * 31 + to_int(a[i])) % 1000000007' ;;
+            char)   echo '        if (i > 0 && a[i - 1] != a[i]) {'
+                    echo '            checksum = (checksum * 31 + i) % 1000000007'
+                    echo '        }' ;;
+            string) echo '        checksum = (checksum * 31 + len(a[i])) % 1000000007'
+                    echo '        if (i > 0 && a[i - 1] != a[i]) {'
+                    echo '            checksum = (checksum + i) % 1000000007'
+                    echo '        }' ;;
+        esac
+        echo '    }'
+        echo '    print("checksum = ${checksum}")'
+        echo '    return 0'
+        echo '}'
+    } > "${out}"
+}
+
+# 运行可执行文件 RUNS 次，输出 "最快耗时 输出"
+time_program() {
+    local exe="$1"
+    local best=""
+    local output=""
+    for ((i = 0; i < RUNS; i++)); do
+        local start end elapsed
+        start=$(date +%s.%N)
+        output=$("${exe}")
+        end=$(date +%s.%N)
+        elapsed=$(awk -v s="${start}" -v e="${end}" 'BEGIN { printf "%.4f", e - s }')
+        if [ -z "${best}" ] || awk -v a="${elapsed}" -v b="${best}" 'BEGIN { exit !(a < b) }'; then
+            best="${elapsed}"
+        fi
+    done
+    echo "${best} ${output}"
+}
+
+# 编译并计时：$1 为类型，$2 为 builtin 或 loop，$3 为元素个数，输出 "耗时 输出"
+run_variant() {
+    local type="$1"
+    local variant="$2"
+    local size="$3"
+    local src="${BENCH_DIR}/sort_${type}_${variant}_${size}.ppx"
+    local exe="${BENCH_DIR}/sort_${type}_${variant}_${size}"
+    generate_source "${type}" "${variant}" "${size}" "${src}"
+    if ! "${COMPILER}" "${src}" -o "${exe}" > /dev/null 2>&1 || [ ! -x "${exe}" ]; then
+        echo -e "${RED}错误: ${src} 编译失败${NC}" >&2
+        return 1
+    fi
+    time_program "${exe}"
+}
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 排序内置函数基准测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+echo -e "${CYAN}sort(): ${SIZE} 个元素，插入排序: ${LOOP_SIZE} 个元素${NC}"
+if [ "${LOOP_SIZE}" -ne "${SIZE}" ]; then
+    echo -e "${YELLOW}插入排序的耗时按 n^2 推算到 ${SIZE} 个元素（包含生成数据和校验的时间，仅供参考）${NC}"
+fi
+echo ""
+printf "%-8s %-14s %-14s %-14s %s\n" "Type" "Insertion(s)" "Scaled(s)" "sort()(s)" "Speedup"
+echo "----------------------------------------------------------------"
+
+failed=0
+for type in "${TYPES[@]}"; do
+    loop_result=$(run_variant "${type}" loop "${LOOP_SIZE}") || exit 1
+    builtin_result=$(run_variant "${type}" builtin "${SIZE}") || exit 1
+    read -r loop_time loop_output <<< "${loop_result}"
+    read -r builtin_time builtin_output <<< "${builtin_result}"
+    scaled=$(awk -v t="${loop_time}" -v m="${LOOP_SIZE}" -v n="${SIZE}" 'BEGIN { printf "%.2f", t * (n / m) * (n / m) }')
+    speedup=$(awk -v l="${scaled}" -v b="${builtin_time}" 'BEGIN { if (b > 0) printf "%.0fx", l / b; else print "-" }')
+    printf "%-8s %-14s %-14s %-14s %s\n" "${type}" "${loop_time}" "${scaled}" "${builtin_time}" "${speedup}"
+
+    # 两个程序都检查结果有序；规模相同时再比较校验和，否则用内置函数在插入排序的规模上复核
+    if [[ "${loop_output}" != checksum* || "${builtin_output}" != checksum* ]]; then
+        echo -e "${RED}  排序结果错误: 插入排序 ${loop_output}，内置函数 ${builtin_output}${NC}"
+        failed=1
+        continue
+    fi
+    if [ "${LOOP_SIZE}" -ne "${SIZE}" ]; then
+        builtin_result=$(run_variant "${type}" builtin "${LOOP_SIZE}") || exit 1
+        read -r _ builtin_output <<< "${builtin_result}"
+    fi
+    if [ "${loop_output}" != "${builtin_output}" ]; then
+        echo -e "${RED}  校验和不一致: 插入排序 ${loop_output}，内置函数 ${builtin_output}${NC}"
+        failed=1
+    fi
+done
+
+echo ""
+if [ ${failed} -eq 0 ]; then
+    echo -e "${GREEN}基准测试完成，内置函数与插入排序的结果一致${NC}"
+else
+    echo -e "${RED}基准测试失败${NC}"
+    exit 1
+fi
@@ -0,0 +1,199 @@
+#!/bin/bash
+
+# PiPiXia 数组运算内置函数基准测试
+# 对 sum、dot、axpy 和 int、double 的每种组合生成两个程序：一个调用内置函数，一个用 for 循环逐个元素计算，
+# 编译为可执行文件后比较运行时间，并校验两者的输出一致。
+# double 数据取 0.5 的整数倍，逐个累加和成对求和都没有舍入误差，两个程序的结果可以直接比较
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+COMPILER="${PROJECT_ROOT}/compiler"
+BENCH_DIR="${PROJECT_ROOT}/output/bench"
+
+# 默认元素个数、重复次数和运行次数
+SIZE=1000000
+REPEAT=200
+RUNS=3
+OPS=(sum dot axpy)
+TYPES=(int double)
+
+print_usage() {
+    echo "用法: $0 [-n 元素个数] [-k 重复次数] [-r 次数] [运算 ...] [类型 ...]"
+    echo ""
+    echo "选项:"
+    echo "  -n, --size N     数组的元素个数（默认 ${SIZE}）"
+    echo "  -k, --repeat N   每个程序对同一数组重复计算 N 次（默认 ${REPEAT}）"
+    echo "  -r, --runs N     每个程序运行 N 次，取最快一次（默认 ${RUNS}）"
+    echo "  -h, --help       显示帮助信息"
+    echo ""
+    echo "示例:"
+    echo "  $0                         # 测试 sum dot axpy，int 和 double"
+    echo "  $0 -n 4096 -k 50000 dot    # 数组放得进缓存时的点积"
+    echo "  $0 sum double              # 只测试 double 求和"
+}
+
+# 解析参数
+CUSTOM_OPS=()
+CUSTOM_TYPES=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -n|--size) SIZE="$2"; shift 2 ;;
+        -k|--repeat) REPEAT="$2"; shift 2 ;;
+        -r|--runs) RUNS="$2"; shift 2 ;;
+        -h|--help) print_usage; exit 0 ;;
+        sum|dot|axpy) CUSTOM_OPS+=("$1"); shift ;;
+        int|double) CUSTOM_TYPES+=("$1"); shift ;;
+        *) echo -e "${RED}错误: 未知参数 '$1'${NC}"; print_usage; exit 1 ;;
+    esac
+done
+if [ ${#CUSTOM_OPS[@]} -gt 0 ]; then
+    OPS=("${CUSTOM_OPS[@]}")
+fi
+if [ ${#CUSTOM_TYPES[@]} -gt 0 ]; then
+    TYPES=("${CUSTOM_TYPES[@]}")
+fi
+
+# 检查编译器
+if [ ! -f "${COMPILER}" ]; then
+    echo -e "${RED}错误: 编译器不存在，请先运行 'make' 构建编译器${NC}"
+    exit 1
+fi
+
+mkdir -p "${BENCH_DIR}"
+
+# 生成程序：$1 为运算，$2 为元素类型，$3 为 builtin 或 loop
+generate_source() {
+    local op="$1"
+    local type="$2"
+    local variant="$3"
+    local out="$4"
+    {
+        # 输入数据：线性同余序列取 [0, 1000) 内的值（double 乘以 0.5）
+        echo "func build(n: int, seed: int): list<${type}> {"
+        echo "    let a: list<${type}> = []"
+        echo '    reserve(a, n)'
+        echo '    let x: int = seed'
+        echo '    for i in 0..n {'
+        echo '        x = (x * 75 + 74) % 65537'
+        if [ "${type}" = "double" ]; then
+            echo '        a.push(x % 1000 * 0.5)'
+        else
+            echo '        a.push(x % 1000)'
+        fi
+        echo '    }'
+        echo '    return a'
+        echo '}'
+        echo ''
+        # work 计算一次并返回结果（axpy 返回 0，最后统计 y 的和）
+        echo "func work(a: list<${type}>, b: list<${type}>): ${type} {"
+        if [ "${variant}" = "builtin" ]; then
+            case "${op}" in
+                sum)  echo '    return sum(a)' ;;
+                dot)  echo '    return dot(a, b)' ;;
+                axpy) echo '    axpy(a, 1, b)'
+                      echo '    return 0' ;;
+            esac
+        else
+            echo "    let acc: ${type} = 0"
+            echo '    for i in 0..len(a) {'
+            case "${op}" in
+                sum)  echo '        acc = acc + a[i]' ;;
+                dot)  echo '        acc = acc + a[i] * b[i]' ;;
+                axpy) echo '        a[i] = a[i] + b[i]' ;;
+            esac
+            echo '    }'
+            echo '    return acc'
+        fi
+        echo '}'
+        echo ''
+        echo 'func main(): int {'
+        echo "    let a: list<${type}> = build(${SIZE}, 12345)"
+        echo "    let b: list<${type}> = build(${SIZE}, 54321)"
+        echo "    let total: ${type} = 0"
+        echo "    for k in 0..${REPEAT} {"
+        echo '        total = total + work(a, b)'
+        echo '    }'
+        if [ "${op}" = "axpy" ]; then
+            echo '    for i in 0..len(a) {'
+            echo '        total = total + a[i]'
+            echo '    }'
+        fi
+        echo '    print("result = ${total}")'
+        echo '    return 0'
+        echo '}'
+    } > "${out}"
+}
+
+# 运行可执行文件 RUNS 次，输出 "最快耗时 输出"
+time_program() {
+    local exe="$1"
+    local best=""
+    local output=""
+    for ((i = 0; i < RUNS; i++)); do
+        local start end elapsed
+        start=$(date +%s.%N)
+        output=$("${exe}")
+        end=$(date +%s.%N)
+        elapsed=$(awk -v s="${start}" -v e="${end}" 'BEGIN { printf "%.4f", e - s }')
+        if [ -z "${best}" ] || awk -v a="${elapsed}" -v b="${best}" 'BEGIN { exit !(a < b) }'; then
+            best="${elapsed}"
+        fi
+    done
+    echo "${best} ${output}"
+}
+
+# 编译并计时：$1 为运算，$2 为类型，$3 为 builtin 或 loop，输出 "耗时 输出"
+run_variant() {
+    local op="$1"
+    local type="$2"
+    local variant="$3"
+    local src="${BENCH_DIR}/array_${op}_${type}_${variant}.ppx"
+    local exe="${BENCH_DIR}/array_${op}_${type}_${variant}"
+    generate_source "${op}" "${type}" "${variant}" "${src}"
+    if ! "${COMPILER}" "${src}" -o "${exe}" > /dev/null 2>&1 || [ ! -x "${exe}" ]; then
+        echo -e "${RED}错误: ${src} 编译失败${NC}" >&2
+        return 1
+    fi
+    time_program "${exe}"
+}
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 数组运算内置函数基准测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+echo -e "${CYAN}${SIZE} 个元素，每个程序重复 ${REPEAT} 次（包含生成数据的时间）${NC}"
+echo ""
+printf "%-8s %-8s %-12s %-12s %s\n" "Op" "Type" "Loop(s)" "Builtin(s)" "Speedup"
+echo "----------------------------------------------------"
+
+failed=0
+for op in "${OPS[@]}"; do
+    for type in "${TYPES[@]}"; do
+        loop_result=$(run_variant "${op}" "${type}" loop) || exit 1
+        builtin_result=$(run_variant "${op}" "${type}" builtin) || exit 1
+        read -r loop_time loop_output <<< "${loop_result}"
+        read -r builtin_time builtin_output <<< "${builtin_result}"
+        speedup=$(awk -v l="${loop_time}" -v b="${builtin_time}" 'BEGIN { if (b > 0) printf "%.1fx", l / b; else print "-" }')
+        printf "%-8s %-8s %-12s %-12s %s\n" "${op}" "${type}" "${loop_time}" "${builtin_time}" "${speedup}"
+        if [[ "${loop_output}" != result* || "${loop_output}" != "${builtin_output}" ]]; then
+            echo -e "${RED}  结果不一致: 循环 ${loop_output}，内置函数 ${builtin_output}${NC}"
+            failed=1
+        fi
+    done
+done
+
+echo ""
+if [ ${failed} -eq 0 ]; then
+    echo -e "${GREEN}基准测试完成，内置函数与循环的结果一致${NC}"
+else
+    echo -e "${RED}基准测试失败${NC}"
+    exit 1
+fi
@@ -0,0 +1,233 @@
+#!/bin/bash
+
+# PiPiXia 线程和通道基准测试
+# compute：把区间求和平均分给 T 个 spawn 的线程，与单线程的 for 循环比较运行时间，校验两者的结果一致
+# channel：P 个生产者通过通道发送 N 个整数，C 个消费者用 for x in c 接收，报告每秒传递的元素个数并校验总和
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+COMPILER="${PROJECT_ROOT}/compiler"
+BENCH_DIR="${PROJECT_ROOT}/output/bench"
+
+# 默认参数
+WORK=400000000
+MESSAGES=4000000
+CAPACITY=1024
+RUNS=3
+THREADS=(1 2 4 8)
+PAIRS=("1 1" "2 2" "4 4")
+
+print_usage() {
+    echo "用法: $0 [-w 求和区间长度] [-m 通道元素个数] [-c 通道容量] [-r 次数]"
+    echo ""
+    echo "选项:"
+    echo "  -w, --work N       compute 测试的求和区间长度（默认 ${WORK}）"
+    echo "  -m, --messages N   channel 测试传递的元素个数（默认 ${MESSAGES}）"
+    echo "  -c, --capacity N   channel 测试的通道容量（默认 ${CAPACITY}）"
+    echo "  -r, --runs N       每个程序运行 N 次，取最快一次（默认 ${RUNS}）"
+    echo "  -h, --help         显示帮助信息"
+    echo ""
+    echo "示例:"
+    echo "  $0                 # compute 使用 1/2/4/8 个线程，channel 使用 1/2/4 对生产者和消费者"
+    echo "  $0 -c 16           # 小容量通道，发送方和接收方频繁等待"
+}
+
+# 解析参数
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -w|--work) WORK="$2"; shift 2 ;;
+        -m|--messages) MESSAGES="$2"; shift 2 ;;
+        -c|--capacity) CAPACITY="$2"; shift 2 ;;
+        -r|--runs) RUNS="$2"; shift 2 ;;
+        -h|--help) print_usage; exit 0 ;;
+        *) echo -e "${RED}错误: 未知参数 '$1'${NC}"; print_usage; exit 1 ;;
+    esac
+done
+
+# 检查编译器
+if [ ! -f "${COMPILER}" ]; then
+    echo -e "${RED}错误: 编译器不存在，请先运行 'make' 构建编译器${NC}"
+    exit 1
+fi
+
+mkdir -p "${BENCH_DIR}"
+
+# compute 程序：$1 为线程数
+generate_compute() {
+    local threads="$1"
+    local out="$2"
+    {
+        echo 'func partial(from: int, to: int): int {'
+        echo '    let s: int = 0'
+        echo '    for i in from..to {'
+        echo '        s = s + i % 7 * (i % 3)'
+        echo '    }'
+        echo '    return s'
+        echo '}'
+        echo ''
+        echo 'func main(): int {'
+        echo "    let n: int = ${WORK}"
+        echo "    let step: int = n / ${threads}"
+        echo '    let total: int = 0'
+        if [ "${threads}" -eq 1 ]; then
+            echo '    total = partial(0, n)'
+        else
+            for ((t = 0; t < threads; t++)); do
+                local to="step * $((t + 1))"
+                if [ $((t + 1)) -eq "${threads}" ]; then
+                    to="n"
+                fi
+                echo "    let h${t}: future<int> = spawn partial(step * ${t}, ${to})"
+            done
+            for ((t = 0; t < threads; t++)); do
+                echo "    total = total + h${t}.join()"
+            done
+        fi
+        echo '    print("result = ${total}")'
+        echo '    return 0'
+        echo '}'
+    } > "${out}"
+}
+
+# channel 程序：$1 为生产者个数，$2 为消费者个数
+generate_channel() {
+    local producers="$1"
+    local consumers="$2"
+    local out="$3"
+    {
+        echo 'func produce(c: chan<int>, from: int, to: int) {'
+        echo '    for i in from..to {'
+        echo '        c.send(i)'
+        echo '    }'
+        echo '}'
+        echo ''
+        echo 'func consume(c: chan<int>): int {'
+        echo '    let s: int = 0'
+        echo '    for x in c {'
+        echo '        s = s + x'
+        echo '    }'
+        echo '    return s'
+        echo '}'
+        echo ''
+        echo 'func main(): int {'
+        echo "    let n: int = ${MESSAGES}"
+        echo "    let step: int = n / ${producers}"
+        echo "    let c: chan<int> = chan<int>(${CAPACITY})"
+        for ((k = 0; k < consumers; k++)); do
+            echo "    let r${k}: future<int> = spawn consume(c)"
+        done
+        for ((p = 0; p < producers; p++)); do
+            local to="step * $((p + 1))"
+            if [ $((p + 1)) -eq "${producers}" ]; then
+                to="n"
+            fi
+            echo "    let p${p}: future<void> = spawn produce(c, step * ${p}, ${to})"
+        done
+        for ((p = 0; p < producers; p++)); do
+            echo "    p${p}.join()"
+        done
+        echo '    close(c)'
+        echo '    let total: int = 0'
+        for ((k = 0; k < consumers; k++)); do
+            echo "    total = total + r${k}.join()"
+        done
+        echo '    print("result = ${total}")'
+        echo '    return 0'
+        echo '}'
+    } > "${out}"
+}
+
+# 运行可执行文件 RUNS 次，输出 "最快耗时 输出"
+time_program() {
+    local exe="$1"
+    local best=""
+    local output=""
+    for ((i = 0; i < RUNS; i++)); do
+        local start end elapsed
+        start=$(date +%s.%N)
+        output=$("${exe}")
+        end=$(date +%s.%N)
+        elapsed=$(awk -v s="${start}" -v e="${end}" 'BEGIN { printf "%.4f", e - s }')
+        if [ -z "${best}" ] || awk -v a="${elapsed}" -v b="${best}" 'BEGIN { exit !(a < b) }'; then
+            best="${elapsed}"
+        fi
+    done
+    echo "${best} ${output}"
+}
+
+# 编译并计时：$1 为源文件，输出 "耗时 输出"
+run_program() {
+    local src="$1"
+    local exe="${src%.ppx}"
+    if ! "${COMPILER}" "${src}" -o "${exe}" > /dev/null 2>&1 || [ ! -x "${exe}" ]; then
+        echo -e "${RED}错误: ${src} 编译失败${NC}" >&2
+        return 1
+    fi
+    time_program "${exe}"
+}
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 线程和通道基准测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+echo -e "${CYAN}本机 CPU 核数: $(nproc 2>/dev/null || echo '?')${NC}"
+echo ""
+
+failed=0
+
+echo -e "${CYAN}compute: 求和区间长度 ${WORK}${NC}"
+printf "%-10s %-12s %s\n" "Threads" "Time(s)" "Speedup"
+echo "--------------------------------"
+base_time=""
+base_output=""
+for threads in "${THREADS[@]}"; do
+    src="${BENCH_DIR}/threads_compute_${threads}.ppx"
+    generate_compute "${threads}" "${src}"
+    result=$(run_program "${src}") || exit 1
+    read -r elapsed output <<< "${result}"
+    if [ -z "${base_time}" ]; then
+        base_time="${elapsed}"
+        base_output="${output}"
+    fi
+    speedup=$(awk -v b="${base_time}" -v t="${elapsed}" 'BEGIN { if (t > 0) printf "%.2fx", b / t; else print "-" }')
+    printf "%-10s %-12s %s\n" "${threads}" "${elapsed}" "${speedup}"
+    if [[ "${output}" != result* || "${output}" != "${base_output}" ]]; then
+        echo -e "${RED}  结果不一致: ${output}，单线程 ${base_output}${NC}"
+        failed=1
+    fi
+done
+echo ""
+
+echo -e "${CYAN}channel: ${MESSAGES} 个元素，通道容量 ${CAPACITY}${NC}"
+printf "%-12s %-12s %s\n" "Prod/Cons" "Time(s)" "M elem/s"
+echo "--------------------------------"
+expected=$(awk -v n="${MESSAGES}" 'BEGIN { s = n * (n - 1) / 2 % 4294967296; if (s >= 2147483648) s -= 4294967296; printf "result = %d", s }')
+for pair in "${PAIRS[@]}"; do
+    read -r producers consumers <<< "${pair}"
+    src="${BENCH_DIR}/threads_channel_${producers}x${consumers}.ppx"
+    generate_channel "${producers}" "${consumers}" "${src}"
+    result=$(run_program "${src}") || exit 1
+    read -r elapsed output <<< "${result}"
+    rate=$(awk -v n="${MESSAGES}" -v t="${elapsed}" 'BEGIN { if (t > 0) printf "%.1f", n / t / 1e6; else print "-" }')
+    printf "%-12s %-12s %s\n" "${producers}/${consumers}" "${elapsed}" "${rate}"
+    if [ "${output}" != "${expected}" ]; then
+        echo -e "${RED}  结果不一致: ${output}，应为 ${expected}${NC}"
+        failed=1
+    fi
+done
+
+echo ""
+if [ ${failed} -eq 0 ]; then
+    echo -e "${GREEN}基准测试完成，结果一致${NC}"
+else
+    echo -e "${RED}基准测试失败${NC}"
+    exit 1
+fi
@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# PiPiXia 嵌入式 C++ API 测试
+# 构建 libppx.a，把 test/ppx_api_test.cc 作为宿主程序链接到静态库并运行：
+# 通过 ppx::Session 编译、调用函数，检查签名、编译错误的诊断信息和 ppx::RuntimeError
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+BLUE='\033[0;34m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+TEST_SRC="${PROJECT_ROOT}/test/ppx_api_test.cc"
+EXEC_DIR="${PROJECT_ROOT}/output/exec"
+TEST_BIN="${EXEC_DIR}/ppx_api_test"
+
+cd "${PROJECT_ROOT}"
+
+# 读取平台配置中的 LLVM 路径（与 Makefile 一致）
+if [ -f ".platform_config" ]; then
+    LLVM_CONFIG=$(grep '^LLVM_CONFIG' .platform_config | sed 's/^LLVM_CONFIG *= *//')
+fi
+if [ -z "${LLVM_CONFIG}" ]; then
+    if [ "$(uname)" = "Darwin" ]; then
+        LLVM_CONFIG=/opt/homebrew/opt/llvm/bin/llvm-config
+    else
+        LLVM_CONFIG=/usr/bin/llvm-config
+    fi
+fi
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 嵌入式 API 测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+
+# 构建静态库
+if ! make lib > /dev/null; then
+    echo -e "${RED}错误: 构建 libppx.a 失败${NC}"
+    exit 1
+fi
+
+# 链接宿主程序（ppx.h 不包含 LLVM 头文件，只需要 LLVM 的链接选项）
+mkdir -p "${EXEC_DIR}"
+if ! g++ -std=c++17 -Wall "${TEST_SRC}" -I. libppx.a \
+        $("${LLVM_CONFIG}" --ldflags --system-libs --libs core support bitreader bitwriter linker transformutils orcjit passes native) \
+        -ldl -o "${TEST_BIN}"; then
+    echo -e "${RED}错误: 链接 ${TEST_SRC} 失败${NC}"
+    exit 1
+fi
+
+if "${TEST_BIN}"; then
+    echo ""
+    echo -e "${GREEN}嵌入式 API 测试通过${NC}"
+else
+    echo ""
+    echo -e "${RED}嵌入式 API 测试失败${NC}"
+    exit 1
+fi
@@ -0,0 +1,74 @@
+#!/bin/bash
+
+# PiPiXia 分层执行测试
+# 以 -ftier-threshold=1 分层执行使用线程和通道的测试（函数在运行中途切换到 JIT 编译的本地代码），
+# 多次运行并与 -interp 的输出比较；崩溃或输出不一致时返回 1
+# 用法: ./scripts/24_test_tiered.sh [-n 次数]
+
+# 颜色定义
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+# 项目路径
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "${SCRIPT_DIR}")"
+COMPILER="${PROJECT_ROOT}/compiler"
+TEST_DIR="${PROJECT_ROOT}/test"
+
+# 参与分层执行测试的文件
+TIERED_TESTS=("48_threads.ppx")
+RUNS=3
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -n) RUNS="$2"; shift 2 ;;
+        *) echo "用法: $0 [-n 次数]"; exit 1 ;;
+    esac
+done
+
+# 检查编译器
+if [ ! -f "${COMPILER}" ]; then
+    echo -e "${RED}错误: 编译器不存在，请先运行 'make' 构建编译器${NC}"
+    exit 1
+fi
+
+echo -e "${BLUE}========================================${NC}"
+echo -e "${BLUE}  PiPiXia 分层执行测试${NC}"
+echo -e "${BLUE}========================================${NC}"
+echo ""
+
+FAILED=0
+for test_file in "${TIERED_TESTS[@]}"; do
+    echo -e "${CYAN}测试文件: ${test_file}${NC}"
+    expected=$("${COMPILER}" "${TEST_DIR}/${test_file}" -interp 2>&1)
+    if [ $? -ne 0 ]; then
+        echo -e "  ${RED}✗ 解释执行失败${NC}"
+        FAILED=$((FAILED + 1))
+        continue
+    fi
+    for run in $(seq 1 "${RUNS}"); do
+        actual=$("${COMPILER}" "${TEST_DIR}/${test_file}" -tiered -ftier-threshold=1 2>&1)
+        status=$?
+        if [ ${status} -ne 0 ]; then
+            echo -e "  ${RED}✗ 第 ${run} 次分层执行失败 (退出码: ${status})${NC}"
+            FAILED=$((FAILED + 1))
+        elif [ "${actual}" != "${expected}" ]; then
+            echo -e "  ${RED}✗ 第 ${run} 次分层执行的输出与解释执行不一致${NC}"
+            diff <(echo "${expected}") <(echo "${actual}") | head -n 10 | sed 's/^/    /'
+            FAILED=$((FAILED + 1))
+        else
+            echo -e "  ${GREEN}✓ 第 ${run} 次分层执行通过${NC}"
+        fi
+    done
+done
+
+echo ""
+if [ ${FAILED} -eq 0 ]; then
+    echo -e "${GREEN}分层执行测试通过${NC}"
+else
+    echo -e "${RED}分层执行测试失败: ${FAILED} 次${NC}"
+    exit 1
+fi
@@ -4,16 +4,18 @@
 #include <memory>
 #include <cctype>
 #include <cstring>
+#include <mutex>
 #include "node.h"
 #include "error.h"
 
 extern int yylex();
 extern int yylineno;
 extern char* yytext;  
-extern bool g_verbose;  
+extern void resetLexer(FILE* input);
 void yyerror(const char* s);
 
-std::shared_ptr<ProgramNode> root;
+// 当前分析结果（仅在 parseProgram 持有锁期间使用）
+static std::shared_ptr<ProgramNode> root;
 
 // 辅助函数：创建节点并自动设置行号
 template<typename T, typename... Args>
@@ -22,348 +24,6 @@ std::shared_ptr<T> makeNode(Args&&... args) {
     node->lineNumber = yylineno;
     return node;
 }
-
-// 插值字符串表达式解析器 - 简单表达式分词器
-class SimpleTokenizer {
-private:
-    std::string expr;
-    size_t pos;
-    
-public:
-    SimpleTokenizer(const std::string& e) : expr(e), pos(0) {}
-    
-    void skipWhitespace() {
-        while (pos < expr.length() && std::isspace(expr[pos])) pos++;
-    }
-    
-    char peek() {
-        skipWhitespace();
-        return pos < expr.length() ? expr[pos] : '\0';
-    }
-    
-    char peekNext() {
-        skipWhitespace();
-        return pos + 1 < expr.length() ? expr[pos + 1] : '\0';
-    }
-    
-    char consume() {
-        skipWhitespace();
-        return pos < expr.length() ? expr[pos++] : '\0';
-    }
-    
-    std::string consumeIdentifier() {
-        skipWhitespace();
-        std::string ident;
-        while (pos < expr.length() && (std::isalnum(expr[pos]) || expr[pos] == '_')) {
-            ident += expr[pos++];
-        }
-        return ident;
-    }
-    
-    std::string consumeNumber() {
-        skipWhitespace();
-        std::string num;
-        bool hasDot = false;
-        while (pos < expr.length() && (std::isdigit(expr[pos]) || expr[pos] == '.')) {
-            if (expr[pos] == '.') {
-                if (hasDot) break;
-                hasDot = true;
-            }
-            num += expr[pos++];
-        }
-        return num;
-    }
-    
-    bool hasMore() {
-        skipWhitespace();
-        return pos < expr.length();
-    }
-    
-    size_t getPos() const { return pos; }
-    void setPos(size_t p) { pos = p; }
-    
-    std::string peekString(size_t start, size_t length) const {
-        if (start >= expr.length()) return "";
-        return expr.substr(start, length);
-    }
-    
-    char charAt(size_t index) const {
-        return index < expr.length() ? expr[index] : '\0';
-    }
-    
-    size_t length() const { return expr.length(); }
-};
-
-// 表达式解析函数前向声明
-std::shared_ptr<ExprNode> parseSimpleExpr(SimpleTokenizer& tok);
-std::shared_ptr<ExprNode> parseSimpleMulDiv(SimpleTokenizer& tok);
-std::shared_ptr<ExprNode> parseSimpleAddSub(SimpleTokenizer& tok);
-std::shared_ptr<ExprNode> parseSimpleComparison(SimpleTokenizer& tok);
-std::shared_ptr<ExprNode> parseSimpleLogical(SimpleTokenizer& tok);
-
-// 解析基本表达式（字面量、标识符、括号表达式、数组访问）
-std::shared_ptr<ExprNode> parseSimpleExpr(SimpleTokenizer& tok) {
-    char ch = tok.peek();
-    
-    // 处理一元运算符 ! 和 -
-    if (ch == '!') {
-        tok.consume();
-        auto operand = parseSimpleExpr(tok);
-        if (!operand) return nullptr;
-        return std::make_shared<UnaryOpNode>("!", operand);
-    }
-    
-    if (ch == '-' && !std::isdigit(tok.peekNext())) {
-        tok.consume();
-        auto operand = parseSimpleExpr(tok);
-        if (!operand) return nullptr;
-        return std::make_shared<UnaryOpNode>("-", operand);
-    }
-    
-    if (ch == '(') {
-        tok.consume();
-        auto expr = parseSimpleLogical(tok);
-        if (tok.peek() == ')') tok.consume();
-        return expr;
-    }
-    
-    if (std::isdigit(ch) || (ch == '-' && std::isdigit(tok.peekNext()))) {
-        std::string numStr = tok.consumeNumber();
-        if (numStr.find('.') != std::string::npos) {
-            return std::make_shared<DoubleLiteralNode>(std::stod(numStr));
-        } else {
-            return std::make_shared<IntLiteralNode>(std::stoi(numStr));
-        }
-    }
-    
-    if (std::isalpha(ch) || ch == '_') {
-        std::string ident = tok.consumeIdentifier();
-        std::shared_ptr<ExprNode> expr = std::make_shared<IdentifierNode>(ident);
-        
-        // 处理数组访问，支持多维数组如 arr[i][j]
-        while (tok.peek() == '[') {
-            tok.consume();
-            auto indexExpr = parseSimpleAddSub(tok);
-            if (tok.peek() == ']') tok.consume();
-            expr = std::make_shared<ArrayAccessNode>(expr, indexExpr);
-        }
-        
-        return expr;
-    }
-    
-    return nullptr;
-}
-
-// 解析乘除模运算（*, /, //, %）
-std::shared_ptr<ExprNode> parseSimpleMulDiv(SimpleTokenizer& tok) {
-    auto left = parseSimpleExpr(tok);
-    if (!left) return nullptr;
-    
-    while (tok.hasMore()) {
-        char op = tok.peek();
-        if (op == '*' || op == '%') {
-            tok.consume();
-            auto right = parseSimpleExpr(tok);
-            if (!right) return nullptr;
-            std::string opStr(1, op);
-            left = std::make_shared<BinaryOpNode>(opStr, left, right);
-        } else if (op == '/') {
-            tok.consume();
-            std::string opStr = "/";
-            if (tok.peek() == '/') {
-                tok.consume();
-                opStr = "//";
-            }
-            auto right = parseSimpleExpr(tok);
-            if (!right) return nullptr;
-            left = std::make_shared<BinaryOpNode>(opStr, left, right);
-        } else {
-            break;
-        }
-    }
-    
-    return left;
-}
-
-// 解析加减运算（+, -）
-std::shared_ptr<ExprNode> parseSimpleAddSub(SimpleTokenizer& tok) {
-    auto left = parseSimpleMulDiv(tok);
-    if (!left) return nullptr;
-    
-    while (tok.hasMore()) {
-        char op = tok.peek();
-        if (op == '+' || op == '-') {
-            tok.consume();
-            auto right = parseSimpleMulDiv(tok);
-            if (!right) return nullptr;
-            std::string opStr(1, op);
-            left = std::make_shared<BinaryOpNode>(opStr, left, right);
-        } else {
-            break;
-        }
-    }
-    
-    return left;
-}
-
-// 解析比较运算（==, !=, <, >, <=, >=）
-std::shared_ptr<ExprNode> parseSimpleComparison(SimpleTokenizer& tok) {
-    auto left = parseSimpleAddSub(tok);
-    if (!left) return nullptr;
-    
-    tok.skipWhitespace();
-    if (tok.hasMore()) {
-        size_t currentPos = tok.getPos();
-        std::string op;
-        
-        // 尝试匹配双字符比较运算符
-        if (currentPos + 1 < tok.length()) {
-            std::string twoChar = tok.peekString(currentPos, 2);
-            if (twoChar == "==" || twoChar == "!=" || 
-                twoChar == "<=" || twoChar == ">=") {
-                op = twoChar;
-                tok.setPos(currentPos + 2);
-            }
-        }
-        
-        // 尝试匹配单字符比较运算符
-        if (op.empty() && currentPos < tok.length()) {
-            char ch = tok.charAt(currentPos);
-            if (ch == '<' || ch == '>') {
-                op = std::string(1, ch);
-                tok.setPos(currentPos + 1);
-            }
-        }
-        
-        // 找到比较运算符，解析右侧表达式
-        if (!op.empty()) {
-            auto right = parseSimpleAddSub(tok);
-            if (!right) return nullptr;
-            left = std::make_shared<BinaryOpNode>(op, left, right);
-        }
-    }
-    
-    return left;
-}
-
-// 解析逻辑运算（&&, ||）
-std::shared_ptr<ExprNode> parseSimpleLogical(SimpleTokenizer& tok) {
-    auto left = parseSimpleComparison(tok);
-    if (!left) return nullptr;
-    
-    tok.skipWhitespace();
-    while (tok.hasMore()) {
-        size_t currentPos = tok.getPos();
-        std::string op;
-        
-        // 尝试匹配逻辑运算符
-        if (currentPos + 1 < tok.length()) {
-            std::string twoChar = tok.peekString(currentPos, 2);
-            if (twoChar == "&&" || twoChar == "||") {
-                op = twoChar;
-                tok.setPos(currentPos + 2);
-            }
-        }
-        
-        if (!op.empty()) {
-            auto right = parseSimpleComparison(tok);
-            if (!right) return nullptr;
-            left = std::make_shared<BinaryOpNode>(op, left, right);
-        } else {
-            break;
-        }
-    }
-    
-    return left;
-}
-
-// 处理字符串中的转义序列
-std::string processEscapeSequences(const std::string& str) {
-    std::string processed;
-    for (size_t i = 0; i < str.length(); i++) {
-        if (str[i] == '\\' && i + 1 < str.length()) {
-            switch (str[i + 1]) {
-                case 'n':  processed += '\n'; i++; break;  // 换行
-                case 't':  processed += '\t'; i++; break;  // 制表符
-                case 'r':  processed += '\r'; i++; break;  // 回车
-                case '\\': processed += '\\'; i++; break;  // 反斜杠
-                case '"':  processed += '"';  i++; break;  // 双引号
-                case '\'': processed += '\''; i++; break;  // 单引号
-                case '0':  i++; break;                     // 空字符，跳过以避免截断
-                case 'b':  processed += '\b'; i++; break;  // 退格
-                case 'f':  processed += '\f'; i++; break;  // 换页
-                case 'v':  processed += '\v'; i++; break;  // 垂直制表符
-                default:   processed += str[i]; break;     // 未知转义序列保留原样
-            }
-        } else {
-            processed += str[i];
-        }
-    }
-    return processed;
-}
-
-// 解析插值字符串，提取表达式和格式说明符
-InterpolatedStringNode* parseInterpolatedString(const std::string& raw) {
-    auto node = std::make_unique<InterpolatedStringNode>();
-    
-    // 移除首尾引号
-    std::string str = raw;
-    if (str.length() >= 2 && str[0] == '"' && str[str.length()-1] == '"') {
-        str = str.substr(1, str.length() - 2);
-    }
-    
-    size_t pos = 0;
-    std::string currentLiteral;
-    
-    while (pos < str.length()) {
-        if (pos + 1 < str.length() && str[pos] == '$' && str[pos+1] == '{') {
-            // 找到插值开始，先处理之前的字面量部分
-            node->addStringPart(processEscapeSequences(currentLiteral));
-            currentLiteral.clear();
-            
-            // 解析 ${...} 中的表达式
-            size_t start = pos;
-            size_t end = str.find('}', start);
-            if (end != std::string::npos) {
-                std::string exprStr = str.substr(start + 2, end - start - 2);
-                
-                // 检查格式说明符 ${expr:format}
-                std::string formatSpec;
-                size_t colonPos = exprStr.find(':');
-                if (colonPos != std::string::npos) {
-                    formatSpec = exprStr.substr(colonPos + 1);
-                    exprStr = exprStr.substr(0, colonPos);
-                }
-                
-                SimpleTokenizer tok(exprStr);
-                auto expr = parseSimpleLogical(tok);
-                if (!expr) {
-                    std::cerr << "Error: Failed to parse expression '" << exprStr << "'" << std::endl;
-                    return nullptr;
-                }
-                
-                // 添加表达式及其格式说明符
-                if (formatSpec.empty()) {
-                    node->addExpression(expr);
-                } else {
-                    node->addExpression(expr, formatSpec);
-                }
-                
-                pos = end + 1;
-            } else {
-                yyerror("字符串插值语法错误：未闭合的 ${}");
-                return nullptr;
-            }
-        } else {
-            currentLiteral += str[pos];
-            pos++;
-        }
-    }
-    
-    // 处理最后一段字面量
-    node->addStringPart(processEscapeSequences(currentLiteral));
-    return node.release();
-}
 %}
 
 // 启用位置跟踪以获取正确的行号
@@ -389,25 +49,33 @@ InterpolatedStringNode* parseInterpolatedString(const std::string& raw) {
     ProgramNode* program;
     FunctionCallNode* funcCall;
     CaseNode* caseNode;
+    InterpolatedStringNode* interpStr;
+    MapLiteralNode* mapLit;
     std::vector<std::shared_ptr<ParameterNode>>* paramList;
     std::vector<std::shared_ptr<ExprNode>>* exprList;
     std::vector<int>* intList;
     std::vector<std::shared_ptr<CaseNode>>* caseList;
+    Annotation* annotation;
+    std::vector<Annotation>* annotationList;
 }
 
 // Token 定义
 %token <intVal> INT_LITERAL
 %token <doubleVal> DOUBLE_LITERAL
 %token <strVal> STRING_LITERAL
-%token <strVal> INTERPOLATED_STRING
+%token <strVal> INTERP_HEAD INTERP_MID INTERP_TAIL INTERP_FORMAT
 %token <charVal> CHAR_LITERAL
 %token <boolVal> BOOL_LITERAL
 %token <strVal> IDENTIFIER
 %token <strVal> TYPE
+%token <strVal> ANNOTATION
 
 // 关键字
 %token LET CONST FUNC RETURN IF ELSE WHILE FOR IN IMPORT AS TRY CATCH THROW
-%token BREAK CONTINUE SWITCH CASE DEFAULT
+%token BREAK CONTINUE SWITCH CASE DEFAULT MAP LIST
+%token SPAWN CHAN FUTURE
+%token YIELD GEN
+%token VEC
 
 // 运算符
 %token PLUS MINUS MULTIPLY DIVIDE FLOORDIV MODULO
@@ -427,9 +95,11 @@ InterpolatedStringNode* parseInterpolatedString(const std::string& raw) {
 %type <stmt> statement declaration function_decl var_decl
 %type <stmt> if_stmt while_stmt for_stmt return_stmt try_catch_stmt
 %type <stmt> assignment expr_stmt import_stmt throw_stmt
-%type <stmt> break_stmt continue_stmt switch_stmt
+%type <stmt> break_stmt continue_stmt switch_stmt yield_stmt
 %type <caseNode> case_clause
 %type <caseList> case_list
+%type <interpStr> interpolated_string
+%type <strVal> interp_format_opt
 %type <block> block statement_list
 %type <expr> expression primary_expr postfix_expr unary_expr
 %type <expr> multiplicative_expr additive_expr relational_expr
@@ -437,10 +107,13 @@ InterpolatedStringNode* parseInterpolatedString(const std::string& raw) {
 %type <expr> assignment_expr
 %type <funcCall> function_call
 %type <exprList> argument_list argument_list_opt array_elements
+%type <mapLit> map_entries
 %type <type> type_spec
 %type <intList> array_dimensions
 %type <param> parameter
 %type <paramList> parameter_list_opt parameter_list
+%type <annotation> annotation
+%type <annotationList> annotation_list
 
 // 错误时自动清理动态分配的内存
 %destructor { delete $$; } <strVal>
@@ -455,6 +128,8 @@ InterpolatedStringNode* parseInterpolatedString(const std::string& raw) {
 %destructor { delete $$; } <exprList>
 %destructor { delete $$; } <intList>
 %destructor { delete $$; } <caseList>
+%destructor { delete $$; } <interpStr>
+%destructor { delete $$; } <mapLit>
 
 // 运算符优先级和结合性（从低到高）
 %right ASSIGN PLUS_ASSIGN MINUS_ASSIGN MULT_ASSIGN DIV_ASSIGN MOD_ASSIGN
@@ -503,10 +178,26 @@ statement_list:
 statement:
     declaration
     | function_decl
+    | annotation_list function_decl {
+        static_cast<FunctionDeclNode*>($2)->annotations = std::move(*$1);
+        delete $1;
+        $$ = $2;
+    }
     | if_stmt
     | while_stmt
     | for_stmt
+    | annotation_list while_stmt {
+        static_cast<WhileStmtNode*>($2)->annotations = std::move(*$1);
+        delete $1;
+        $$ = $2;
+    }
+    | annotation_list for_stmt {
+        static_cast<ForStmtNode*>($2)->annotations = std::move(*$1);
+        delete $1;
+        $$ = $2;
+    }
     | return_stmt
+    | yield_stmt
     | break_stmt
     | continue_stmt
     | switch_stmt
@@ -567,6 +258,47 @@ type_spec:
         delete $1;
         delete $2;
     }
+    | MAP LT TYPE COMMA TYPE GT {
+        // 映射类型以 "map<K,V>" 作为类型名
+        $$ = new TypeNode("map<" + *$3 + "," + *$5 + ">");
+        delete $3;
+        delete $5;
+    }
+    | LIST LT TYPE GT {
+        // 动态数组类型以 "list<T>" 作为类型名
+        $$ = new TypeNode("list<" + *$3 + ">");
+        delete $3;
+    }
+    | CHAN LT TYPE GT {
+        // 通道类型以 "chan<T>" 作为类型名
+        $$ = new TypeNode("chan<" + *$3 + ">");
+        delete $3;
+    }
+    | FUTURE LT TYPE GT {
+        // spawn 的结果以 "future<T>" 作为类型名
+        $$ = new TypeNode("future<" + *$3 + ">");
+        delete $3;
+    }
+    | FUTURE LT IDENTIFIER GT {
+        // 没有返回值的函数：future<void>
+        $$ = new TypeNode("future<" + *$3 + ">");
+        delete $3;
+    }
+    | GEN LT TYPE GT {
+        // 生成器函数的返回类型以 "gen<T>" 作为类型名
+        $$ = new TypeNode("gen<" + *$3 + ">");
+        delete $3;
+    }
+    | VEC LT TYPE COMMA INT_LITERAL GT {
+        // SIMD 向量类型以 "vec<T,N>" 作为类型名
+        $$ = new TypeNode("vec<" + *$3 + "," + std::to_string($5) + ">");
+        delete $3;
+    }
+    | TYPE LBRACKET RBRACKET {
+        // T[] 是 list<T> 的简写
+        $$ = new TypeNode("list<" + *$1 + ">");
+        delete $1;
+    }
     ;
 
 array_dimensions:
@@ -662,6 +394,7 @@ while_stmt:
         }
         $$ = new WhileStmtNode(std::shared_ptr<ExprNode>($2), 
                                std::shared_ptr<StmtNode>($3));
+        $$->lineNumber = @1.first_line;
     }
     ;
 
@@ -673,10 +406,50 @@ for_stmt:
         $$ = new ForStmtNode(*$2, std::shared_ptr<ExprNode>($4),
                              std::shared_ptr<ExprNode>($6),
                              std::shared_ptr<StmtNode>($7));
+        $$->lineNumber = @1.first_line;
+        delete $2;
+    }
+    | FOR IDENTIFIER IN expression block {
+        if (g_verbose) {
+            std::cout << "[AST] Parsing for loop: " << *$2 << " in container" << std::endl;
+        }
+        $$ = new ForStmtNode(*$2, std::shared_ptr<ExprNode>($4),
+                             std::shared_ptr<StmtNode>($5));
+        $$->lineNumber = @1.first_line;
+        delete $2;
+    }
+    ;
+
+annotation_list:
+    annotation {
+        $$ = new std::vector<Annotation>();
+        $$->push_back(*$1);
+        delete $1;
+    }
+    | annotation_list annotation {
+        $$ = $1;
+        $$->push_back(*$2);
         delete $2;
     }
     ;
 
+annotation:
+    ANNOTATION {
+        $$ = new Annotation();
+        $$->name = *$1;
+        $$->lineNumber = @1.first_line;
+        delete $1;
+    }
+    | ANNOTATION LPAREN INT_LITERAL RPAREN {
+        $$ = new Annotation();
+        $$->name = *$1;
+        $$->argument = $3;
+        $$->hasArgument = true;
+        $$->lineNumber = @1.first_line;
+        delete $1;
+    }
+    ;
+
 return_stmt:
     RETURN expression {
         $$ = new ReturnStmtNode(std::shared_ptr<ExprNode>($2));
@@ -688,6 +461,13 @@ return_stmt:
     }
     ;
 
+yield_stmt:
+    YIELD expression {
+        $$ = new YieldStmtNode(std::shared_ptr<ExprNode>($2));
+        $$->lineNumber = @1.first_line;
+    }
+    ;
+
 break_stmt:
     BREAK {
         $$ = new BreakStmtNode();
@@ -826,10 +606,12 @@ equality_expr:
     | equality_expr EQ relational_expr {
         $$ = new BinaryOpNode("==", std::shared_ptr<ExprNode>($1), 
                               std::shared_ptr<ExprNode>($3));
+        $$->lineNumber = @1.first_line;
     }
     | equality_expr NE relational_expr {
         $$ = new BinaryOpNode("!=", std::shared_ptr<ExprNode>($1), 
                               std::shared_ptr<ExprNode>($3));
+        $$->lineNumber = @1.first_line;
     }
     ;
 
@@ -858,10 +640,12 @@ additive_expr:
     | additive_expr PLUS multiplicative_expr {
         $$ = new BinaryOpNode("+", std::shared_ptr<ExprNode>($1), 
                               std::shared_ptr<ExprNode>($3));
+        $$->lineNumber = @1.first_line;
     }
     | additive_expr MINUS multiplicative_expr {
         $$ = new BinaryOpNode("-", std::shared_ptr<ExprNode>($1), 
                               std::shared_ptr<ExprNode>($3));
+        $$->lineNumber = @1.first_line;
     }
     ;
 
@@ -870,6 +654,7 @@ multiplicative_expr:
     | multiplicative_expr MULTIPLY unary_expr {
         $$ = new BinaryOpNode("*", std::shared_ptr<ExprNode>($1), 
                               std::shared_ptr<ExprNode>($3));
+        $$->lineNumber = @1.first_line;
     }
     | multiplicative_expr DIVIDE unary_expr {
         $$ = new BinaryOpNode("/", std::shared_ptr<ExprNode>($1), 
@@ -905,6 +690,19 @@ postfix_expr:
                                  std::shared_ptr<ExprNode>($3));
         $$->lineNumber = @1.first_line;
     }
+    | postfix_expr LBRACKET expression DOTDOT expression RBRACKET {
+        $$ = new SliceNode(std::shared_ptr<ExprNode>($1), std::shared_ptr<ExprNode>($3),
+                           std::shared_ptr<ExprNode>($5));
+        $$->lineNumber = @1.first_line;
+    }
+    | postfix_expr LBRACKET expression DOTDOT RBRACKET {
+        $$ = new SliceNode(std::shared_ptr<ExprNode>($1), std::shared_ptr<ExprNode>($3), nullptr);
+        $$->lineNumber = @1.first_line;
+    }
+    | postfix_expr LBRACKET DOTDOT expression RBRACKET {
+        $$ = new SliceNode(std::shared_ptr<ExprNode>($1), nullptr, std::shared_ptr<ExprNode>($4));
+        $$->lineNumber = @1.first_line;
+    }
     | postfix_expr DOT IDENTIFIER {
         $$ = new MemberAccessNode(std::shared_ptr<ExprNode>($1), *$3);
         delete $3;
@@ -928,6 +726,7 @@ function_call:
     | postfix_expr DOT IDENTIFIER LPAREN argument_list_opt RPAREN {
         auto call = new FunctionCallNode(*$3);
         call->object = std::shared_ptr<ExprNode>($1);
+        call->lineNumber = @3.first_line;
         if ($5) {
             call->arguments = *$5;
             delete $5;
@@ -957,7 +756,11 @@ primary_expr:
     INT_LITERAL             { $$ = new IntLiteralNode($1); }
     | DOUBLE_LITERAL        { $$ = new DoubleLiteralNode($1); }
     | STRING_LITERAL        { $$ = new StringLiteralNode(*$1); delete $1; }
-    | INTERPOLATED_STRING   { $$ = parseInterpolatedString(*$1); delete $1; }
+    | interpolated_string INTERP_TAIL {
+        $1->addStringPart(*$2);
+        $$ = $1;
+        delete $2;
+    }
     | CHAR_LITERAL          { $$ = new CharLiteralNode($1); }
     | BOOL_LITERAL          { $$ = new BoolLiteralNode($1); }
     | IDENTIFIER            { 
@@ -970,13 +773,84 @@ primary_expr:
     }
     | LBRACKET array_elements RBRACKET {
         $$ = new ArrayLiteralNode(*$2);
+        $$->lineNumber = @1.first_line;
         delete $2;
     }
     | LBRACKET RBRACKET {
         $$ = new ArrayLiteralNode(std::vector<std::shared_ptr<ExprNode>>());
+        $$->lineNumber = @1.first_line;
+    }
+    | LBRACKET map_entries RBRACKET {
+        $$ = $2;
+    }
+    | LBRACKET COLON RBRACKET {
+        $$ = new MapLiteralNode();
+    }
+    | SPAWN IDENTIFIER LPAREN argument_list_opt RPAREN {
+        auto call = new FunctionCallNode(*$2);
+        call->lineNumber = @2.first_line;
+        if ($4) {
+            call->arguments = *$4;
+            delete $4;
+        }
+        delete $2;
+        $$ = new SpawnNode(std::shared_ptr<FunctionCallNode>(call));
+        $$->lineNumber = @1.first_line;
+    }
+    | CHAN LT TYPE GT LPAREN expression RPAREN {
+        $$ = new ChannelNode(*$3, std::shared_ptr<ExprNode>($6));
+        $$->lineNumber = @1.first_line;
+        delete $3;
+    }
+    | CHAN LT TYPE GT LPAREN RPAREN {
+        $$ = new ChannelNode(*$3, nullptr);
+        $$->lineNumber = @1.first_line;
+        delete $3;
+    }
+    | VEC LT TYPE COMMA INT_LITERAL GT LPAREN argument_list_opt RPAREN {
+        auto vec = new VecNode(*$3, $5);
+        vec->lineNumber = @1.first_line;
+        if ($8) {
+            vec->arguments = *$8;
+            delete $8;
+        }
+        delete $3;
+        $$ = vec;
     }
     ;
 
+/* 插值字符串：词法分析器在 ${ 和 } 处切分，内嵌表达式直接走完整的表达式文法 */
+interpolated_string:
+    INTERP_HEAD expression interp_format_opt {
+        $$ = new InterpolatedStringNode();
+        $$->lineNumber = @1.first_line;
+        $$->addStringPart(*$1);
+        if ($3) {
+            $$->addExpression(std::shared_ptr<ExprNode>($2), *$3);
+            delete $3;
+        } else {
+            $$->addExpression(std::shared_ptr<ExprNode>($2));
+        }
+        delete $1;
+    }
+    | interpolated_string INTERP_MID expression interp_format_opt {
+        $$ = $1;
+        $$->addStringPart(*$2);
+        if ($4) {
+            $$->addExpression(std::shared_ptr<ExprNode>($3), *$4);
+            delete $4;
+        } else {
+            $$->addExpression(std::shared_ptr<ExprNode>($3));
+        }
+        delete $2;
+    }
+    ;
+
+interp_format_opt:
+    /* 无格式说明符 */ { $$ = nullptr; }
+    | INTERP_FORMAT { $$ = $1; }
+    ;
+
 array_elements:
     expression {
         $$ = new std::vector<std::shared_ptr<ExprNode>>();
@@ -988,9 +862,41 @@ array_elements:
     }
     ;
 
+/* 映射字面量的键值对：key: value, ... */
+map_entries:
+    expression COLON expression {
+        $$ = new MapLiteralNode();
+        $$->lineNumber = @1.first_line;
+        $$->addEntry(std::shared_ptr<ExprNode>($1), std::shared_ptr<ExprNode>($3));
+    }
+    | map_entries COMMA expression COLON expression {
+        $1->addEntry(std::shared_ptr<ExprNode>($3), std::shared_ptr<ExprNode>($5));
+        $$ = $1;
+    }
+    ;
+
 %%
 
 // 语法错误处理函数（使用error模块）
 void yyerror(const char* s) {
     reportSyntaxError(s, yylineno, yylloc.first_column);
 }
+
+// 语法分析入口
+// 分析结果直接返回给调用者，root 只在持有锁期间使用
+std::shared_ptr<ProgramNode> parseProgram(FILE* input) {
+    static std::mutex parserMutex;
+    std::lock_guard<std::mutex> lock(parserMutex);
+
+    int syntaxErrors = currentDiagnostics().syntaxErrorCount;
+    resetLexer(input);
+    root = nullptr;
+    int parseResult = yyparse();
+    std::shared_ptr<ProgramNode> program = std::move(root);
+    root = nullptr;
+
+    if (parseResult != 0 || currentDiagnostics().syntaxErrorCount > syntaxErrors) {
+        return nullptr;
+    }
+    return program;
+}
@@ -0,0 +1,154 @@
+/**
+ * ppx_api_test.cc
+ * 嵌入式 C++ API（libppx.a）测试
+ *
+ * 目标：宿主程序通过 ppx::Session 增量编译源代码、取出并调用函数（标量和定长数组参数）、
+ *       检查签名不一致和编译错误的诊断信息、PPX 代码调用 exit 时抛出 ppx::RuntimeError
+ * 运行方式：./scripts/23_test_api.sh（构建 libppx.a，链接并运行本程序；有检查失败时返回 1）
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "ppx.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    std::cout << "  " << (ok ? "[通过] " : "[失败] ") << what << std::endl;
+    if (!ok) {
+        failures++;
+    }
+}
+
+// 诊断信息中是否有包含 text 的一条
+static bool hasDiagnostic(const ppx::Session& session, const std::string& text) {
+    for (const ppx::Diagnostic& d : session.diagnostics()) {
+        if (d.message.find(text) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main() {
+    std::cout << "=== 测试嵌入式 C++ API ===" << std::endl << std::endl;
+
+    ppx::Compiler compiler;
+    std::unique_ptr<ppx::Session> session = compiler.createSession();
+
+    // 测试1：编译并调用函数
+    std::cout << "测试1: 编译并调用函数" << std::endl;
+    bool compiled = session->compile(
+        "func add(a: int, b: int): int { return a + b }\n"
+        "func half(x: double): double { return x / 2.0 }\n"
+        "func greet(name: string): string { return \"hi \" + name }\n");
+    check(compiled && session->diagnostics().empty(), "compile 成功且没有诊断信息");
+    ppx::Function<int(int, int)> add = session->function<int(int, int)>("add");
+    check(add && add(2, 3) == 5, "add(2, 3) = 5");
+    ppx::Function<double(double)> half = session->function<double(double)>("half");
+    check(half && half(5.0) == 2.5, "half(5.0) = 2.5");
+    ppx::Function<const char*(const char*)> greet = session->function<const char*(const char*)>("greet");
+    check(greet && std::string(greet("ppx")) == "hi ppx", "greet(\"ppx\") = \"hi ppx\"");
+    std::cout << std::endl;
+
+    // 测试2：定长数组参数按指针传递（任意维度）
+    std::cout << "测试2: 定长数组参数" << std::endl;
+    compiled = session->compile(
+        "func total(v: int[4]): int {\n"
+        "    let s: int = 0\n"
+        "    for i in 0..4 {\n"
+        "        s += v[i]\n"
+        "    }\n"
+        "    return s\n"
+        "}\n"
+        "func corner(m: int[2][3]): int { return m[1][2] }\n"
+        "func fill(v: double[3], x: double) {\n"
+        "    for i in 0..3 {\n"
+        "        v[i] = x\n"
+        "    }\n"
+        "}\n");
+    check(compiled, "compile 成功");
+    int values[4] = {1, 2, 3, 4};
+    ppx::Function<int(int*)> total = session->function<int(int*)>("total");
+    check(total && total(values) == 10, "total({1, 2, 3, 4}) = 10");
+    int matrix[2][3] = {{1, 2, 3}, {4, 5, 6}};
+    ppx::Function<int(int*)> corner = session->function<int(int*)>("corner");
+    check(corner && corner(&matrix[0][0]) == 6, "corner({{1, 2, 3}, {4, 5, 6}}) = 6");
+    double buffer[3] = {0, 0, 0};
+    ppx::Function<void(double*, double)> fill = session->function<void(double*, double)>("fill");
+    if (fill) {
+        fill(buffer, 1.5);
+    }
+    check(fill && buffer[0] == 1.5 && buffer[2] == 1.5, "fill 修改宿主数组");
+    std::cout << std::endl;
+
+    // 测试3：签名不一致时返回空对象并记录诊断信息
+    std::cout << "测试3: 签名检查" << std::endl;
+    session->clearDiagnostics();
+    check(!session->function<int(int)>("add"), "add 按 int(int) 取出时为空");
+    check(hasDiagnostic(*session, "int(int, int)") && hasDiagnostic(*session, "int(int)"),
+          "诊断信息给出 PPX 签名和请求的签名");
+    check(!session->function<int(double*)>("corner"), "corner 按 int(double*) 取出时为空");
+    check(hasDiagnostic(*session, "int(int[2][3])") && hasDiagnostic(*session, "int(double[N])"),
+          "诊断信息写出数组的各维长度");
+    compiled = session->compile("func size(v: list<int>): int { return len(v) }");
+    check(compiled && !session->function<int(int*)>("size"), "list<int> 参数不能按 int* 取出");
+    check(!session->function<int()>("missing") && hasDiagnostic(*session, "missing"), "未定义的函数为空");
+    std::cout << std::endl;
+
+    // 测试4：编译错误收集在会话中，之前的定义保持有效
+    std::cout << "测试4: 编译错误" << std::endl;
+    session->clearDiagnostics();
+    compiled = session->compile("func broken(): int {\n    return unknownName\n}\n", "broken.ppx");
+    check(!compiled, "compile 返回 false");
+    bool located = false;
+    for (const ppx::Diagnostic& d : session->diagnostics()) {
+        located = located || (d.severity == ppx::Diagnostic::Error && d.file == "broken.ppx" && d.line == 2);
+    }
+    check(located, "错误诊断位于 broken.ppx 第 2 行");
+    check(!session->function<int()>("broken"), "出错的函数没有定义");
+    check(add(20, 22) == 42, "之前的 add 仍然可以调用");
+    std::cout << std::endl;
+
+    // 测试5：增量编译引用之前的定义和全局变量
+    std::cout << "测试5: 增量编译" << std::endl;
+    compiled = session->compile("let base: int = add(40, 2)");
+    compiled = compiled && session->compile("func offset(x: int): int { return base + x }");
+    ppx::Function<int(int)> offset = session->function<int(int)>("offset");
+    check(compiled && offset && offset(8) == 50, "offset(8) = 50");
+    std::cout << std::endl;
+
+    // 测试6：PPX 代码调用 exit 时抛出 RuntimeError，会话保持可用
+    std::cout << "测试6: 运行时错误" << std::endl;
+    compiled = session->compile("func fail(): int {\n    throw \"boom\"\n}\n");
+    ppx::Function<int()> fail = session->function<int()>("fail");
+    bool thrown = false;
+    try {
+        if (fail) {
+            fail();
+        }
+    } catch (const ppx::RuntimeError& e) {
+        thrown = e.exitCode() != 0;
+    }
+    check(compiled && thrown, "未捕获的异常抛出 ppx::RuntimeError");
+    check(add(1, 1) == 2, "之后仍然可以调用 add");
+    std::cout << std::endl;
+
+    // 测试7：不同会话的定义相互独立
+    std::cout << "测试7: 独立的会话" << std::endl;
+    std::unique_ptr<ppx::Session> other = compiler.createSession();
+    check(!other->function<int(int, int)>("add"), "新会话中没有 add");
+    check(other->compile("func add(a: int, b: int): int { return a * b }") &&
+          other->function<int(int, int)>("add")(2, 3) == 6 && add(2, 3) == 5,
+          "两个会话中的 add 各自调用");
+    std::cout << std::endl;
+
+    if (failures > 0) {
+        std::cout << "=== 嵌入式 API 测试失败：" << failures << " 项 ===" << std::endl;
+        return 1;
+    }
+    std::cout << "=== 嵌入式 API 测试全部通过 ===" << std::endl;
+    return 0;
+}
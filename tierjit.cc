@@ -0,0 +1,354 @@
+/**
+ * tierjit.cc
+ * PiPiXia 分层执行的后台 JIT 编译器实现
+ *
+ * 模块准备（后台线程首次收到请求时进行，不占用解释器启动时间）：
+ * 1. 将解释器正在执行的模块序列化为 bitcode，在 JIT 自己的 LLVMContext 中重新解析
+ * 2. 全局变量全部改为外部声明，以绝对地址符号指向解释器中的存储；exit 和 pthread_create 改用解释器一侧的实现
+ * 3. 每个函数定义克隆为单独的模块（其他函数为声明），并附加统一签名的入口包装函数
+ * 4. 所有模块加入 LLJIT，经 -O2 优化管线后按需编译
+ */
+
+#include "tierjit.h"
+#include "error.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <pthread.h>
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+static const char* const ENTRY_PREFIX = "__ppx_entry_";
+static const char* const GLOBAL_PREFIX = "__ppx_global_";
+
+static void reportJITError(const std::string& message) {
+    std::cerr << ErrorColors::YELLOW << "Warning" << ErrorColors::RESET << ": [Tier] " << message
+              << "，继续解释执行" << std::endl;
+}
+
+// 本地代码中的 exit：与解释器一致，刷新输出后直接结束进程
+static void tieredExit(int code) {
+    std::fflush(nullptr);
+    std::_Exit(code);
+}
+
+// 本地代码中的 pthread_create：由解释器创建线程并计数（进程中只有一个分层执行的解释器）
+static BytecodeInterpreter* tieredInterpreter = nullptr;
+
+static int tieredThreadCreate(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*), void* argument) {
+    return tieredInterpreter->spawnNative(thread, attr, start, argument);
+}
+
+bool TieredJIT::prepareModule(llvm::Module* module) {
+    auto targetBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!targetBuilder) {
+        reportJITError("无法检测本机目标: " + llvm::toString(targetBuilder.takeError()));
+        return false;
+    }
+    auto dataLayout = targetBuilder->getDefaultDataLayoutForTarget();
+    if (!dataLayout) {
+        reportJITError(llvm::toString(dataLayout.takeError()));
+        return false;
+    }
+    module->setDataLayout(*dataLayout);
+    module->setTargetTriple(targetBuilder->getTargetTriple());
+    return true;
+}
+
+TieredJIT::TieredJIT(llvm::Module* module, BytecodeInterpreter& interpreter)
+    : module(module), interpreter(interpreter), stopping(false),
+      initialized(false), failed(false), compiledCount(0) {}
+
+TieredJIT::~TieredJIT() {
+    stop();
+}
+
+void TieredJIT::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        queue.clear();
+    }
+    queueReady.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void TieredJIT::start() {
+    // 后台线程沿用启动线程的诊断状态和日志设置
+    DiagnosticState& diagnostics = currentDiagnostics();
+    bool verbose = g_verbose;
+    worker = std::thread([this, &diagnostics, verbose]() {
+        DiagnosticScope scope(diagnostics, verbose);
+        workerLoop();
+    });
+}
+
+void TieredJIT::request(unsigned index, const std::string& name) {
+    if (g_verbose) {
+        std::cout << "[Tier] Function '" << name << "' is hot, queued for JIT compilation" << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back({index, name});
+    }
+    queueReady.notify_one();
+}
+
+void TieredJIT::workerLoop() {
+    for (;;) {
+        std::pair<unsigned, std::string> item;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            item = queue.front();
+            queue.pop_front();
+        }
+        if (!initialized && !failed) {
+            failed = !initialize();
+            initialized = !failed;
+        }
+        if (failed) {
+            continue;
+        }
+        compile(item.first, item.second);
+    }
+}
+
+bool TieredJIT::isSupportedSignature(llvm::Function& function) {
+    auto supported = [](llvm::Type* type) {
+        return (type->isIntegerTy() && type->getIntegerBitWidth() <= 64) ||
+               type->isFloatTy() || type->isDoubleTy() || type->isPointerTy();
+    };
+    for (llvm::Type* param : function.getFunctionType()->params()) {
+        if (!supported(param)) {
+            return false;
+        }
+    }
+    llvm::Type* ret = function.getReturnType();
+    return ret->isVoidTy() || supported(ret);
+}
+
+// 入口包装函数：void __ppx_entry_<name>(ptr args, ptr result)
+// 参数和返回值按解释器寄存器的约定读写：整数符号扩展为 64 位（i1 为 0/1），浮点以 double 保存
+void TieredJIT::addEntryWrapper(llvm::Module& module, llvm::Function& function) {
+    llvm::LLVMContext& context = module.getContext();
+    llvm::Type* ptrType = llvm::PointerType::get(context, 0);
+    llvm::Type* i64Type = llvm::Type::getInt64Ty(context);
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(context);
+
+    llvm::FunctionType* wrapperType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(context), {ptrType, ptrType}, false);
+    llvm::Function* wrapper = llvm::Function::Create(
+        wrapperType, llvm::Function::ExternalLinkage, ENTRY_PREFIX + function.getName().str(), &module);
+
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", wrapper));
+    llvm::Value* argSlots = wrapper->getArg(0);
+    llvm::Value* resultSlot = wrapper->getArg(1);
+
+    std::vector<llvm::Value*> args;
+    for (unsigned i = 0; i < function.arg_size(); i++) {
+        llvm::Type* type = function.getFunctionType()->getParamType(i);
+        llvm::Value* slot = builder.CreateConstGEP1_64(i64Type, argSlots, i);
+        llvm::Value* value;
+        if (type->isPointerTy()) {
+            value = builder.CreateLoad(ptrType, slot);
+        } else if (type->isFloatingPointTy()) {
+            value = builder.CreateLoad(doubleType, slot);
+            if (type->isFloatTy()) {
+                value = builder.CreateFPTrunc(value, type);
+            }
+        } else {
+            value = builder.CreateLoad(i64Type, slot);
+            if (type->getIntegerBitWidth() < 64) {
+                value = builder.CreateTrunc(value, type);
+            }
+        }
+        args.push_back(value);
+    }
+
+    llvm::Value* result = builder.CreateCall(&function, args);
+    llvm::Type* retType = function.getReturnType();
+    if (retType->isFloatTy()) {
+        builder.CreateStore(builder.CreateFPExt(result, doubleType), resultSlot);
+    } else if (retType->isIntegerTy(1)) {
+        builder.CreateStore(builder.CreateZExt(result, i64Type), resultSlot);
+    } else if (retType->isIntegerTy() && retType->getIntegerBitWidth() < 64) {
+        builder.CreateStore(builder.CreateSExt(result, i64Type), resultSlot);
+    } else if (!retType->isVoidTy()) {
+        builder.CreateStore(result, resultSlot);
+    }
+    builder.CreateRetVoid();
+}
+
+bool TieredJIT::initialize() {
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto targetBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!targetBuilder) {
+        reportJITError("无法检测本机目标: " + llvm::toString(targetBuilder.takeError()));
+        return false;
+    }
+    targetBuilder->setCodeGenOptLevel(llvm::CodeGenOptLevel::Default);
+
+    auto created = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(*targetBuilder)).create();
+    if (!created) {
+        reportJITError("无法创建 JIT: " + llvm::toString(created.takeError()));
+        return false;
+    }
+    jit = std::move(*created);
+
+    // 外部 C 库函数从当前进程解析
+    auto processSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit->getDataLayout().getGlobalPrefix());
+    if (!processSymbols) {
+        reportJITError(llvm::toString(processSymbols.takeError()));
+        return false;
+    }
+    llvm::orc::JITDylib& dylib = jit->getMainJITDylib();
+    dylib.addGenerator(std::move(*processSymbols));
+
+    // 每个模块在加入 JIT 前经过 -O2 优化管线
+    jit->getIRTransformLayer().setTransform(
+        [](llvm::orc::ThreadSafeModule tsm, llvm::orc::MaterializationResponsibility&)
+            -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+            tsm.withModuleDo([](llvm::Module& m) {
+                llvm::LoopAnalysisManager loopAM;
+                llvm::FunctionAnalysisManager functionAM;
+                llvm::CGSCCAnalysisManager cgsccAM;
+                llvm::ModuleAnalysisManager moduleAM;
+                llvm::PassBuilder passBuilder;
+                passBuilder.registerModuleAnalyses(moduleAM);
+                passBuilder.registerCGSCCAnalyses(cgsccAM);
+                passBuilder.registerFunctionAnalyses(functionAM);
+                passBuilder.registerLoopAnalyses(loopAM);
+                passBuilder.crossRegisterProxies(loopAM, functionAM, cgsccAM, moduleAM);
+                passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2).run(m, moduleAM);
+            });
+            return std::move(tsm);
+        });
+
+    // 在 JIT 自己的上下文中复制模块
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream bitcodeStream(bitcode);
+    llvm::WriteBitcodeToFile(*module, bitcodeStream);
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto parsed = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), "tier"), *context);
+    if (!parsed) {
+        reportJITError("无法复制模块: " + llvm::toString(parsed.takeError()));
+        return false;
+    }
+    std::unique_ptr<llvm::Module> master = std::move(*parsed);
+    master->setDataLayout(jit->getDataLayout());
+    master->setTargetTriple(jit->getTargetTriple());
+
+    // 全局变量改为声明，按顺序对应解释器中的存储地址（bitcode 保持全局变量顺序）
+    llvm::orc::SymbolMap globalSymbols;
+    auto source = module->global_begin();
+    std::vector<llvm::GlobalVariable*> intrinsicGlobals;
+    unsigned globalCount = 0;
+    for (auto& global : master->globals()) {
+        const llvm::GlobalVariable& original = *source++;
+        if (global.getName().starts_with("llvm.")) {
+            intrinsicGlobals.push_back(&global);
+            continue;
+        }
+        void* address = interpreter.globalAddress(&original);
+        if (!address) {
+            continue;
+        }
+        global.setName(GLOBAL_PREFIX + std::to_string(globalCount++));
+        global.setInitializer(nullptr);
+        global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        global.setVisibility(llvm::GlobalValue::DefaultVisibility);
+        globalSymbols[jit->mangleAndIntern(global.getName())] =
+            llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(address), llvm::JITSymbolFlags::Exported);
+    }
+    globalSymbols[jit->mangleAndIntern("exit")] =
+        llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(&tieredExit), llvm::JITSymbolFlags::Exported);
+    tieredInterpreter = &interpreter;
+    globalSymbols[jit->mangleAndIntern("pthread_create")] =
+        llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(&tieredThreadCreate), llvm::JITSymbolFlags::Exported);
+
+    // 全局构造函数已由解释器执行
+    for (auto* global : intrinsicGlobals) {
+        global->eraseFromParent();
+    }
+    if (auto error = dylib.define(llvm::orc::absoluteSymbols(std::move(globalSymbols)))) {
+        reportJITError(llvm::toString(std::move(error)));
+        return false;
+    }
+
+    std::vector<llvm::Function*> definitions;
+    for (auto& function : master->functions()) {
+        if (function.isDeclaration()) {
+            continue;
+        }
+        function.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        function.setVisibility(llvm::GlobalValue::DefaultVisibility);
+        definitions.push_back(&function);
+    }
+
+    // 每个函数一个模块：调用其他函数时由 JIT 按需编译对应模块
+    llvm::orc::ThreadSafeContext threadSafeContext(std::move(context));
+    for (llvm::Function* function : definitions) {
+        llvm::ValueToValueMapTy valueMap;
+        std::unique_ptr<llvm::Module> part = llvm::CloneModule(
+            *master, valueMap, [function](const llvm::GlobalValue* gv) { return gv == function; });
+        llvm::Function* clone = part->getFunction(function->getName());
+        if (isSupportedSignature(*clone)) {
+            addEntryWrapper(*part, *clone);
+        }
+        if (auto error = jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(part), threadSafeContext))) {
+            reportJITError(llvm::toString(std::move(error)));
+            return false;
+        }
+    }
+
+    if (g_verbose) {
+        auto endTime = std::chrono::steady_clock::now();
+        std::cout << "[Tier] JIT initialized: " << definitions.size() << " function module(s), "
+                  << globalCount << " shared global(s) in "
+                  << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+    }
+    return true;
+}
+
+bool TieredJIT::compile(unsigned index, const std::string& name) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto symbol = jit->lookup(ENTRY_PREFIX + name);
+    if (!symbol) {
+        // 参数或返回值无法通过解释器寄存器传递的函数没有入口包装，保持解释执行
+        llvm::consumeError(symbol.takeError());
+        if (g_verbose) {
+            std::cout << "[Tier] Function '" << name << "' cannot be compiled, staying in interpreter" << std::endl;
+        }
+        return false;
+    }
+    NativeEntry entry = symbol->toPtr<NativeEntry>();
+    interpreter.installNativeEntry(index, entry);
+    compiledCount++;
+
+    if (g_verbose) {
+        auto endTime = std::chrono::steady_clock::now();
+        std::cout << "[Tier] Function '" << name << "' tiered up to native code ("
+                  << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms)" << std::endl;
+    }
+    return true;
+}
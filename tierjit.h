@@ -0,0 +1,63 @@
+/**
+ * tierjit.h
+ * PiPiXia 分层执行的后台 JIT 编译器
+ *
+ * 功能：
+ * - 接收解释器报告的热点函数，在后台线程中使用 ORC JIT 以 -O2 编译
+ * - 每个函数单独成为一个 JIT 模块，编译时按需连带编译其调用的函数
+ * - 全局变量直接映射到解释器中的内存，本地代码与解释器共享程序状态
+ * - 编译完成后生成统一签名的入口包装函数，并原子地写入解释器的分派表
+ */
+
+#ifndef TIERJIT_H
+#define TIERJIT_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <llvm/IR/Module.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+
+#include "interp.h"
+
+class TieredJIT {
+public:
+    TieredJIT(llvm::Module* module, BytecodeInterpreter& interpreter);
+    ~TieredJIT();
+
+    static bool prepareModule(llvm::Module* module);                // 使用本机数据布局（须在解释器 prepare 之前调用）
+    void start();                                                   // 启动后台编译线程
+    void request(unsigned index, const std::string& name);          // 提交热点函数（线程安全）
+    void stop();                                                    // 丢弃未开始的请求，等待当前编译结束
+    unsigned getCompiledCount() const { return compiledCount; }     // 已切换到本地代码的函数数
+
+private:
+    llvm::Module* module;                                           // 解释器正在执行的模块（只读）
+    BytecodeInterpreter& interpreter;
+
+    // 后台线程和请求队列
+    std::thread worker;
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<std::pair<unsigned, std::string>> queue;             // (函数下标, 函数名)
+    bool stopping;
+
+    // JIT 状态（仅由后台线程访问）
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    bool initialized;
+    bool failed;
+    unsigned compiledCount;
+
+    void workerLoop();                                              // 后台线程主循环
+    bool initialize();                                              // 创建 LLJIT，拆分模块并映射全局变量
+    bool compile(unsigned index, const std::string& name);          // 编译一个函数并切换分派入口
+    static bool isSupportedSignature(llvm::Function& function);     // 参数和返回值能否通过 InterpSlot 传递
+    static void addEntryWrapper(llvm::Module& module, llvm::Function& function);   // 生成统一签名的入口函数
+};
+
+#endif // TIERJIT_H